@@ -25,11 +25,14 @@
 #include "anki/core/Threadpool.h"
 #include "anki/core/NativeWindow.h"
 #include "anki/core/Counters.h"
+#include "anki/core/FramePipeline.h"
 #include "anki/Scene.h"
 #include "anki/Event.h"
 
 using namespace anki;
 
+static FramePipeline framePipeline;
+
 //==============================================================================
 void initSubsystems()
 {
@@ -94,7 +97,7 @@ void initSubsystems()
 	initializer.get("renderingQuality") = 1.0;
 	initializer.get("width") = NativeWindowSingleton::get().getWidth();
 	initializer.get("height") = NativeWindowSingleton::get().getHeight();
-	initializer.get("lodDistance") = 20.0;
+	initializer.get("lodMaxPixelError") = 1.0;
 	initializer.get("samples") = 16;
 
 //#if ANKI_GL == ANKI_GL_ES
@@ -442,6 +445,8 @@ static Bool mainLoopExtra()
 
 	if(in.getKey(KC_F1) == 1)
 	{
+		// It changes the renderer so wait for it
+		framePipeline.flush();
 		MainRendererSingleton::get().getDbg().setEnabled(
 			!MainRendererSingleton::get().getDbg().getEnabled());
 	}
@@ -455,44 +460,64 @@ static Bool mainLoopExtra()
 }
 
 //==============================================================================
-static void mainLoop()
+/// The state of the frame that updates
+struct MainLoopState
 {
-	ANKI_LOGI("Entering main loop");
+	HighRezTimer::Scalar m_prevUpdateTime;
+	HighRezTimer::Scalar m_crntTime;
+	Bool8 m_quit = false;
+};
 
-	HighRezTimer::Scalar prevUpdateTime = HighRezTimer::getCurrentTime();
-	HighRezTimer::Scalar crntTime = prevUpdateTime;
+//==============================================================================
+static void* updateFrame(void* userData, U64 /*frame*/)
+{
+	MainLoopState& state = *reinterpret_cast<MainLoopState*>(userData);
+	state.m_prevUpdateTime = state.m_crntTime;
+	state.m_crntTime = HighRezTimer::getCurrentTime();
 
-	SceneGraph& scene = SceneGraphSingleton::get();
-	MainRenderer& renderer = MainRendererSingleton::get();
 	Input& input = InputSingleton::get();
-	NativeWindow& window = NativeWindowSingleton::get();
+	input.handleEvents();
 
-	ANKI_COUNTER_START_TIMER(C_FPS);
-	while(true)
+	if(input.getEvent(Input::WINDOW_CLOSED_EVENT) > 0 || !mainLoopExtra())
 	{
-		HighRezTimer timer;
-		timer.start();
+		state.m_quit = true;
+	}
 
-		prevUpdateTime = crntTime;
-		crntTime = HighRezTimer::getCurrentTime();
+	SceneGraph& scene = SceneGraphSingleton::get();
+	scene.update(state.m_prevUpdateTime, state.m_crntTime, 
+		MainRendererSingleton::get());
 
-		// Update
-		input.handleEvents();
+	return const_cast<RenderSnapshot*>(&scene.getRenderSnapshot());
+}
 
-		if(input.getEvent(Input::WINDOW_CLOSED_EVENT) > 0)
-		{
-			break;
-		}
+//==============================================================================
+static void renderFrame(void* /*userData*/, void* snapshot, U64 /*frame*/)
+{
+	MainRendererSingleton::get().render(
+		*reinterpret_cast<const RenderSnapshot*>(snapshot));
 
-		if(!mainLoopExtra())
-		{
-			break;
-		}
+	NativeWindowSingleton::get().swapBuffers();
+}
+
+//==============================================================================
+static void mainLoop()
+{
+	ANKI_LOGI("Entering main loop");
 
-		scene.update(prevUpdateTime, crntTime, renderer);
-		renderer.render(scene);
+	MainLoopState state;
+	state.m_prevUpdateTime = HighRezTimer::getCurrentTime();
+	state.m_crntTime = state.m_prevUpdateTime;
 
-		window.swapBuffers();
+	framePipeline.init(true, updateFrame, renderFrame, &state);
+
+	ANKI_COUNTER_START_TIMER(C_FPS);
+	while(!state.m_quit)
+	{
+		HighRezTimer timer;
+		timer.start();
+
+		// Update this frame while the previous one renders
+		framePipeline.runFrame();
 		ANKI_COUNTERS_RESOLVE_FRAME();
 
 		// Sleep
@@ -507,6 +532,15 @@ static void mainLoop()
 		increaseGlobTimestamp();
 	}
 
+	framePipeline.flush();
+	ANKI_LOGI("Frame time %f ms, latency %f ms, update %f ms, render %f ms, "
+		"overlap %f%%",
+		framePipeline.getAverageFrameTime() * 1000.0,
+		framePipeline.getAverageLatency() * 1000.0,
+		framePipeline.getAverageUpdateTime() * 1000.0,
+		framePipeline.getAverageRenderTime() * 1000.0,
+		framePipeline.getOverlap() * 100.0);
+
 	// Counters end
 	ANKI_COUNTER_STOP_TIMER_INC(C_FPS);
 	ANKI_COUNTERS_FLUSH();
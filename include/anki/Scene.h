@@ -15,5 +15,6 @@
 #include "anki/scene/Light.h"
 #include "anki/scene/Path.h"
 #include "anki/scene/InstanceNode.h"
+#include "anki/scene/ScriptComponent.h"
 
 #endif
@@ -94,6 +94,9 @@ public:
 	/// Check if a collision shape @a b is inside the frustum
 	Bool insideFrustum(const CollisionShape& b);
 
+	/// Get the planes in world space. The inside is in front of them
+	const Array<Plane, (U)PlaneType::COUNT>& getPlanes();
+
 	/// Calculate the projection matrix
 	virtual Mat4 calculateProjectionMatrix() const = 0;
 
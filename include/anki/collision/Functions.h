@@ -8,6 +8,7 @@
 
 #include "anki/collision/Plane.h"
 #include "anki/collision/Frustum.h"
+#include "anki/collision/Aabb.h"
 
 namespace anki {
 
@@ -23,6 +24,16 @@ namespace anki {
 extern void extractClipPlanes(const Mat4& mvp, 
 	Plane* planes[(U)Frustum::PlaneType::COUNT]);
 
+/// Transform many planes. Same as Plane::getTransformed but the rotation and
+/// the origin are prepared once. The output may be the input
+extern void transformPlanes(const Transform& trf, const Plane* in, 
+	Plane* out, PtrSize count);
+
+/// Transform many boxes. Same as Aabb::getTransformed but the absolute of the
+/// rotation is calculated once. The output may be the input
+extern void transformAabbs(const Transform& trf, const Aabb* in, Aabb* out,
+	PtrSize count);
+
 /// @}
 
 } // end namespace anki
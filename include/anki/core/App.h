@@ -75,6 +75,13 @@ public:
 		return *m_threadpool;
 	}
 
+	/// The renderer has its own threadpool because it runs while the scene
+	/// updates the next frame on the other one
+	Threadpool& getRenderThreadpool()
+	{
+		return *m_renderThreadpool;
+	}
+
 	HeapAllocator<U8>& getAllocator()
 	{
 		return m_heapAlloc;
@@ -102,6 +109,7 @@ private:
 
 	// Misc
 	Threadpool* m_threadpool = nullptr;
+	Threadpool* m_renderThreadpool = nullptr;
 	String m_settingsPath; ///< The path that holds the configuration
 	String m_cachePath; ///< This is used as a cache
 	F32 m_timerTick;
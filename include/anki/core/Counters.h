@@ -20,7 +20,13 @@ enum class Counter
 	RENDERER_PPS_TIME,
 	RENDERER_SHADOW_PASSES,
 	RENDERER_LIGHTS_COUNT,
+	RENDERER_STATE_CHANGES,
+	RENDERER_TRIANGLES_COUNT,
+	RENDERER_LOD_TRIANGLES_SAVED,
+	RENDERER_CLUSTER_TRIANGLES_CULLED,
 	SCENE_UPDATE_TIME,
+	SCENE_OCCLUSION_TIME,
+	SCENE_OCCLUDED_NODES,
 	SWAP_BUFFERS_TIME,
 	GL_CLIENT_WAIT_TIME,
 	GL_SERVER_WAIT_TIME,
@@ -28,6 +34,9 @@ enum class Counter
 	GL_VERTICES_COUNT,
 	GL_QUEUES_SIZE,
 	GL_CLIENT_BUFFERS_SIZE,
+	GL_TRANSIENT_MEMORY_SIZE,
+	GL_TRANSIENT_WAITS_COUNT,
+	GL_HANDLE_ATOMIC_OPS,
 
 	COUNT
 };
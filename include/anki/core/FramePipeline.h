@@ -0,0 +1,159 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_CORE_FRAME_PIPELINE_H
+#define ANKI_CORE_FRAME_PIPELINE_H
+
+#include "anki/util/Thread.h"
+#include "anki/util/HighRezTimer.h"
+
+namespace anki {
+
+/// @addtogroup core
+/// @{
+
+/// Runs the update and the rendering of the frames. In pipelined mode the
+/// update of a frame runs in the caller's thread while the rendering of the
+/// previous frame runs in the pipeline's thread. The update hands the
+/// rendering an immutable snapshot of its frame so they don't share any state
+class FramePipeline: public NonCopyable
+{
+public:
+	/// Update a frame
+	/// @return The snapshot that the rendering of the frame will use
+	using UpdateCallback = void*(*)(void* userData, U64 frame);
+
+	/// Render the snapshot of a frame
+	using RenderCallback = void(*)(void* userData, void* snapshot, U64 frame);
+
+	FramePipeline();
+
+	/// It will wait for the last frame
+	~FramePipeline();
+
+	/// @param pipelined If false the rendering runs in the caller's thread
+	///                  right after the update
+	/// @param update The update callback. Always called in the caller's thread
+	/// @param render The render callback
+	/// @param userData Passed to the callbacks
+	void init(Bool pipelined, UpdateCallback update, RenderCallback render,
+		void* userData);
+
+	/// Update a new frame and hand it to the rendering. In pipelined mode it
+	/// waits for the rendering of the previous frame only after the update
+	void runFrame();
+
+	/// Wait for the rendering of the last frame
+	void flush();
+
+	Bool getPipelined() const
+	{
+		return m_pipelined;
+	}
+
+	/// @name Statistics. Safe to call while the frames run
+	/// @{
+	U64 getFramesCount() const
+	{
+		return getStats().m_framesCount;
+	}
+
+	/// The average time from the start of the update of a frame to the end
+	/// of its rendering
+	HighRezTimer::Scalar getAverageLatency() const
+	{
+		Stats stats = getStats();
+		return (stats.m_framesCount) 
+			? stats.m_latencySum / stats.m_framesCount : 0.0;
+	}
+
+	/// The average time between the end of the rendering of two frames
+	HighRezTimer::Scalar getAverageFrameTime() const
+	{
+		Stats stats = getStats();
+		return (stats.m_framesCount > 1)
+			? (stats.m_lastFrameEnd - stats.m_firstFrameEnd) 
+				/ (stats.m_framesCount - 1)
+			: 0.0;
+	}
+
+	/// The average time of the update callback
+	HighRezTimer::Scalar getAverageUpdateTime() const
+	{
+		Stats stats = getStats();
+		return (stats.m_updatesCount) 
+			? stats.m_updateTimeSum / stats.m_updatesCount : 0.0;
+	}
+
+	/// The average time of the render callback
+	HighRezTimer::Scalar getAverageRenderTime() const
+	{
+		Stats stats = getStats();
+		return (stats.m_framesCount) 
+			? stats.m_renderTimeSum / stats.m_framesCount : 0.0;
+	}
+
+	/// How much of the update and the rendering runs at the same time. It's
+	/// 0.0 if they run one after the other and 1.0 if the shortest of the
+	/// two is completely hidden
+	F64 getOverlap() const;
+	/// @}
+
+private:
+	Bool8 m_pipelined = false;
+	UpdateCallback m_update = nullptr;
+	RenderCallback m_render = nullptr;
+	void* m_userData = nullptr;
+
+	U64 m_crntFrame = 0; ///< The frame that will be updated next
+
+	/// @name Render thread
+	/// @{
+	Thread m_thread;
+	Mutex m_mtx;
+	ConditionVariable m_condVar; ///< Wakes the thread and the caller
+	void* m_snapshot = nullptr; ///< The snapshot to render
+	U64 m_snapshotFrame = 0;
+	HighRezTimer::Scalar m_snapshotStartTime = 0.0;
+	Bool8 m_pending = false; ///< A frame waits or is being rendered
+	Bool8 m_quit = false;
+	/// @}
+
+	/// The statistics. The caller writes the update times and the rendering
+	/// the rest so they are copied under a lock
+	class Stats
+	{
+	public:
+		U64 m_framesCount = 0; ///< The rendered frames
+		U64 m_updatesCount = 0;
+		HighRezTimer::Scalar m_latencySum = 0.0;
+		HighRezTimer::Scalar m_updateTimeSum = 0.0;
+		HighRezTimer::Scalar m_renderTimeSum = 0.0;
+		HighRezTimer::Scalar m_firstFrameEnd = 0.0;
+		HighRezTimer::Scalar m_lastFrameEnd = 0.0;
+	};
+
+	Stats m_stats;
+	mutable SpinLock m_statsLock;
+
+	Stats getStats() const
+	{
+		LockGuard<SpinLock> lock(m_statsLock);
+		return m_stats;
+	}
+
+	static I threadCallback(Thread::Info& info);
+
+	void threadLoop();
+
+	/// Render and gather statistics
+	void renderFrame(void* snapshot, U64 frame, HighRezTimer::Scalar start);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
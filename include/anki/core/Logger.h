@@ -9,7 +9,9 @@
 #include "anki/Config.h"
 #include "anki/util/Singleton.h"
 #include "anki/util/File.h"
-#include <mutex>
+#include "anki/util/Thread.h"
+#include "anki/util/Atomic.h"
+#include <cstdarg>
 
 namespace anki {
 
@@ -20,7 +22,15 @@ namespace anki {
 /// exceptions, it has to recover somehow. Its thread safe
 /// To add a new signal: 
 /// @code logger.addMessageHandler((void*)obj, &function) @endcode
-class Logger
+///
+/// The messages are formated by the caller into a lock-free ring and a 
+/// thread of the logger runs the handlers in batches. The callers never wait
+/// for I/O. A call site that repeats an info or a warning too often is rate
+/// limited and when the ring is full the non error messages are dropped. The
+/// errors are never lost. The handlers run on exit for the messages that are
+/// still in the ring. On a crash signal the messages are written to the
+/// stderr only
+class Logger: public NonCopyable
 {
 public:
 	/// Logger message type
@@ -67,9 +77,23 @@ public:
 	/// The message handler callback
 	using MessageHandlerCallback = void (*)(void*, const Info& info);
 
+	/// The messages that the ring holds
+	static const U32 RECORDS_COUNT = 1024;
+
+	/// Messages longer than that are allocated
+	static const U32 MESSAGE_SIZE = 216;
+
+	/// How many times a call site may log an info or a warning in a second
+	static const U32 MAX_MESSAGES_PER_SECOND = 8;
+
+	/// The call sites that are rate limited. The rest are not limited
+	static const U32 RATE_LIMITS_COUNT = 1024;
+
 	/// Initialize the logger
 	Logger(InitFlags flags, HeapAllocator<U8>& alloc);
 
+	~Logger();
+
 	/// Add a new message handler
 	void addMessageHandler(void* data, MessageHandlerCallback callback);
 
@@ -81,8 +105,51 @@ public:
 	void writeFormated(const char* file, int line, const char* func,
 		MessageType type, const char* fmt, ...);
 
+	/// Run the handlers for all the messages sent so far and flush the 
+	/// console and the log file. It blocks
+	void flush();
+
+	/// @name Statistics
+	/// @{
+
+	/// The messages that the rate limiting dropped
+	U32 getSuppressedMessagesCount() const
+	{
+		return m_suppressedTotal.load();
+	}
+
+	/// The messages that were dropped because the ring was full
+	U32 getDroppedMessagesCount() const
+	{
+		return m_droppedTotal.load();
+	}
+	/// @}
+
 private:
-	std::mutex m_mutex; ///< For thread safety
+	/// A message in the ring
+	class Record
+	{
+	public:
+		/// Vyukov's sequence. It tells if the record is free or written
+		Atomic<U64> m_sequence;
+		const char* m_file;
+		const char* m_func;
+		char* m_longMsg; ///< Allocated if the message didn't fit in m_msg
+		I32 m_line;
+		MessageType m_type;
+		Array<char, MESSAGE_SIZE> m_msg;
+	};
+
+	/// The messages of a call site in the current second. The call site is
+	/// set once when the first message of the site takes the slot
+	class RateLimit
+	{
+	public:
+		Atomic<const char*> m_file = {nullptr};
+		Atomic<I32> m_line = {MIN_I32}; ///< MIN_I32 until it's set
+		Atomic<U32> m_second = {0};
+		Atomic<U32> m_count = {0};
+	};
 
 	class Handler
 	{
@@ -91,10 +158,74 @@ private:
 		MessageHandlerCallback m_callback;
 	};
 
+	HeapAllocator<U8> m_alloc;
+
+	/// @name The ring
+	/// @{
+	Record* m_records = nullptr;
+	Atomic<U64> m_tail = {0}; ///< The next record to write
+	Atomic<U64> m_head = {0}; ///< The next record to handle
+	/// @}
+
+	/// Open addressing on the file and the line of the call site
+	Array<RateLimit, RATE_LIMITS_COUNT> m_rateLimits;
+	Atomic<U32> m_suppressed = {0}; ///< Not reported yet
+	Atomic<U32> m_dropped = {0}; ///< Not reported yet
+	Atomic<U32> m_suppressedTotal = {0};
+	Atomic<U32> m_droppedTotal = {0};
+
+	/// @name The sink thread
+	/// @{
+	Thread m_thread;
+	Mutex m_wakeMtx;
+	ConditionVariable m_wakeCond;
+	Atomic<Bool> m_sinkSleeping = {false};
+	Atomic<Bool> m_quit = {false};
+	/// @}
+
+	/// Protects the handlers and the consumer side of the ring
+	Mutex m_sinkMtx;
+
 	Vector<Handler> m_handlers;
 
 	File m_logfile;
-	
+
+	/// Format a message into the ring
+	void push(const char* file, int line, const char* func,
+		MessageType type, const char* fmt, va_list args);
+
+	/// Find the slot of a call site or take a free one
+	/// @return Null if all the slots are taken by other call sites
+	RateLimit* findRateLimit(const char* file, int line);
+
+	/// Check the rate of a call site
+	/// @return False if the message should be dropped
+	Bool rateLimit(const char* file, int line);
+
+	/// Run the handlers of the records in the ring. The m_sinkMtx should be
+	/// locked
+	void drain();
+
+	/// Flush the streams of the handlers. The m_sinkMtx should be locked
+	void flushHandlers();
+
+	void runHandlers(const Info& info);
+
+	Bool ringEmpty() const;
+
+	static I threadCallback(Thread::Info& info);
+
+	void threadLoop();
+
+	/// Drain the ring of the first logger on exit or on terminate
+	static void flushAtExit();
+	static void flushOnTerminate();
+
+	/// Write the ring of the first logger to the stderr. It only calls 
+	/// async signal safe functions
+	static void writeRingOnSignal();
+	static void flushOnSignal(int sig);
+
 	static void defaultSystemMessageHandler(void*, const Info& info);
 	static void logfileMessageHandler(void* vlogger, const Info& info);
 };
@@ -20,6 +20,18 @@ class SceneNode;
 /// @addtogroup Events
 /// @{
 
+/// Get a new event type ID. Don't use it directly
+U32 newEventTypeId();
+
+/// Get the ID of an event type. The EventManager keeps the events of the same
+/// type together
+template<typename TEvent>
+U32 getEventTypeId()
+{
+	static const U32 id = newEventTypeId();
+	return id;
+}
+
 /// The base class for all events
 class Event: public SceneObject, public Bitset<U8>
 {
@@ -125,6 +137,14 @@ protected:
 	/// Return the u between current time and when the event started
 	/// @return A number [0.0, 1.0]
 	F32 getDelta(F32 crntTime) const;
+
+private:
+	/// @name Bookkeeping of the EventManager
+	/// @{
+	U32 m_typeId = MAX_U32;
+	U32 m_index = MAX_U32; ///< In the schedule or in the active events
+	Bool8 m_active = false; ///< If false it's in the schedule
+	/// @}
 };
 /// @}
 
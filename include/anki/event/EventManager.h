@@ -9,6 +9,7 @@
 #include "anki/event/Event.h"
 #include "anki/util/Vector.h"
 #include "anki/util/StdTypes.h"
+#include "anki/util/Thread.h"
 #include "anki/scene/Common.h"
 #include "anki/Math.h"
 
@@ -20,13 +21,24 @@ class SceneGraph;
 /// @addtogroup Events
 /// @{
 
-/// This manager creates the events ands keeps tracks of them
+/// This manager creates the events ands keeps tracks of them.
+///
+/// The events that haven't started wait in a schedule ordered by start time
+/// so they cost nothing until they start. The events that run are kept per
+/// type and they are updated in parallel batches without virtual calls.
+/// Events of the same type that animate the same node at the same time
+/// should be avoided because they may update in different threads
 class EventManager
 {
+	friend class UpdateEventsTask;
+
 public:
-	typedef SceneVector<Event*> EventsContainer;
+	typedef Vector<Event*, HeapAllocator<Event*>> EventsContainer;
+
+	static const U MAX_EVENT_TYPES = 32;
 
-	EventManager(SceneGraph* scene);
+	EventManager(SceneGraph* scene, AllocAlignedCallback allocCb,
+		void* allocCbData);
 	~EventManager();
 
 	/// @name Accessors
@@ -42,26 +54,60 @@ public:
 
 	SceneAllocator<U8> getSceneAllocator() const;
 	SceneAllocator<U8> getSceneFrameAllocator() const;
+
+	/// The events that wait to start
+	U32 getScheduledEventsCount() const
+	{
+		return m_schedule.size();
+	}
+
+	/// The events that run
+	U32 getActiveEventsCount() const
+	{
+		return m_activeCount;
+	}
 	/// @}
 
 	/// Iterate events
 	template<typename Func>
 	void iterateEvents(Func func)
 	{
-		for(Event* e : events)
+		for(Event* e : m_schedule)
 		{
 			func(*e);
 		}
+
+		for(EventType* type : m_types)
+		{
+			if(type)
+			{
+				for(Event* e : type->m_active)
+				{
+					func(*e);
+				}
+			}
+		}
 	}
 
 	/// Create a new event
 	template<typename T, typename... Args>
 	void newEvent(T*& event, Args&&... args)
 	{
-		SceneAllocator<T> al = getSceneAllocator();
-		event = al.allocate(1);
-		al.construct(event, this, std::forward<Args>(args)...);
+		EventType& type = getEventType(getEventTypeId<T>(), sizeof(T),
+			alignof(T), &updateEvents<T>);
 
+		void* mem = type.allocate();
+		try
+		{
+			event = ::new(mem) T(this, std::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			type.free(mem);
+			throw;
+		}
+
+		event->m_typeId = getEventTypeId<T>();
 		registerEvent(event);
 	}
 
@@ -77,17 +123,137 @@ public:
 	/// Delete events that pending deletion
 	void deleteEventsMarkedForDeletion();
 
+	/// @privatesection
+	/// @{
+
+	/// SceneObject calls it when an event is marked for deletion. It's
+	/// thread safe
+	void _eventMarkedForDeletion(Event* event);
+	/// @}
+
 private:
+	/// Update a range of active events of a type. The dead events are
+	/// gathered for the manager to kill them
+	using UpdateCallback = void (*)(Event** events, PtrSize count,
+		F32 prevUpdateTime, F32 crntTime, SceneFrameVector<Event*>& dead);
+
+	/// A free slot of an event pool
+	class FreeEvent
+	{
+	public:
+		FreeEvent* m_next;
+	};
+
+	/// The events of a type. Their memory is carved out of chunks so the
+	/// events of a type stay close in memory
+	class EventType
+	{
+	public:
+		static const U EVENTS_PER_CHUNK = 128;
+
+		UpdateCallback m_update;
+		PtrSize m_eventSize;
+		PtrSize m_eventAlignment;
+		EventsContainer m_active; ///< Unordered
+
+		/// @name Pool
+		/// @{
+		Vector<void*, HeapAllocator<void*>> m_chunks;
+		U8* m_chunkPos = nullptr;
+		U8* m_chunkEnd = nullptr;
+		FreeEvent* m_freeEvents = nullptr;
+		/// @}
+
+		EventType(HeapAllocator<U8>& alloc, UpdateCallback update,
+			PtrSize eventSize, PtrSize eventAlignment);
+
+		~EventType();
+
+		/// @return The memory of a new event
+		void* allocate();
+
+		void free(void* ptr);
+
+	private:
+		HeapAllocator<U8> m_alloc;
+	};
+
 	SceneGraph* scene = nullptr;
-	EventsContainer events;
+	HeapAllocator<U8> m_alloc;
+	Array<EventType*, MAX_EVENT_TYPES> m_types = {{}};
+
+	/// The events that haven't started. A binary heap with the earliest
+	/// start on top
+	EventsContainer m_schedule;
+	U32 m_activeCount = 0;
+
+	EventsContainer m_markedForDeletion;
+	SpinLock m_markedForDeletionLock;
+
 	F32 prevUpdateTime;
 	F32 crntTime;
 
+	/// Get or create the events of a type
+	EventType& getEventType(U32 typeId, PtrSize eventSize,
+		PtrSize eventAlignment, UpdateCallback update);
+
 	/// Add an event to the local container
 	void registerEvent(Event* event);
 
 	/// Remove an event from the container
 	void unregisterEvent(Event* event);
+
+	/// @name Schedule
+	/// @{
+	static Bool startsBefore(const Event* a, const Event* b);
+	void scheduleEvent(Event* event);
+	void unscheduleEvent(Event* event);
+	void siftUp(U32 i);
+	void siftDown(U32 i);
+	void setScheduleEntry(U32 i, Event* event);
+	/// @}
+
+	/// @name Active events
+	/// @{
+	void activateEvent(Event* event);
+	void deactivateEvent(Event* event);
+	/// @}
+
+	/// Call onKilled for the dead events
+	void killEvents(SceneFrameVector<Event*>& dead);
+
+	/// Update a range of events of a type. It's instantiated per type so
+	/// update() is not a virtual call
+	template<typename T>
+	static void updateEvents(Event** events, PtrSize count,
+		F32 prevUpdateTime, F32 crntTime, SceneFrameVector<Event*>& dead)
+	{
+		for(PtrSize i = 0; i < count; i++)
+		{
+			Event& base = *events[i];
+			T& event = static_cast<T&>(base);
+
+			// The node of the event may be deleted
+			if(base.isMarkedForDeletion())
+			{
+				continue;
+			}
+
+			if(!base.isDead(crntTime))
+			{
+				event.T::update(prevUpdateTime, crntTime);
+			}
+			else if(base.bitsEnabled(Event::EF_REANIMATE))
+			{
+				base.startTime = prevUpdateTime;
+				event.T::update(prevUpdateTime, crntTime);
+			}
+			else
+			{
+				dead.push_back(&base);
+			}
+		}
+	}
 };
 /// @}
 
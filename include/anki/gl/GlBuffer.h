@@ -112,6 +112,13 @@ public:
 	/// @param[in] size The size in bytes we want to write
 	void write(void* buff, U32 offset, U32 size);
 
+	/// Copy a range of another buffer to this one
+	/// @param[in] src The buffer to copy from
+	/// @param srcOffset The offset in src
+	/// @param dstOffset The offset in this buffer
+	/// @param size The size in bytes we want to copy
+	void copy(const GlBuffer& src, U32 srcOffset, U32 dstOffset, U32 size);
+
 	/// Set the binding for this buffer
 	void setBinding(GLuint binding) const;
 
@@ -51,6 +51,12 @@ public:
 		GlClientBufferHandle& data, PtrSize readOffset,
 		PtrSize writeOffset, PtrSize size);
 
+	/// Copy a range of another buffer to this one
+	void copy(
+		GlCommandBufferHandle& commands,
+		GlBufferHandle& src, PtrSize srcOffset,
+		PtrSize dstOffset, PtrSize size);
+
 	/// Bind to the state as uniform/shader storage buffer
 	void bindShaderBuffer(GlCommandBufferHandle& commands, U32 bindingPoint)
 	{
@@ -7,30 +7,33 @@
 #define ANKI_GL_GL_COMMAND_BUFFER_H
 
 #include "anki/gl/GlCommon.h"
+#include "anki/gl/GlHandle.h"
+#include "anki/gl/GlRetirementList.h"
 #include "anki/util/Assert.h"
 #include "anki/util/Allocator.h"
+#include "anki/util/Functions.h"
+#include <cstring>
+#include <type_traits>
 
 namespace anki {
 
 // Forward 
 class GlQueue;
 class GlCommandBuffer;
+class GlTexture;
+class GlSampler;
+class GlBuffer;
+class GlProgramPipeline;
+class GlFramebuffer;
 
 /// @addtogroup opengl_private
 /// @{
 
-/// The base of all GL commands
+/// The base of all generic GL commands. The command buffer knows the type of
+/// every generic command so it doesn't need virtuals. A command should define
+/// a "void operator()(GlCommandBuffer*)"
 class GlCommand
-{
-public:
-	GlCommand* m_nextCommand = nullptr;
-
-	virtual ~GlCommand()
-	{}
-
-	/// Execute command
-	virtual void operator()(GlCommandBuffer*) = 0;
-};
+{};
 
 /// A common command that deletes an object
 template<typename T, typename TAlloc>
@@ -52,19 +55,161 @@ public:
 	}
 };
 
+/// The commands that GlCommandBuffer executes inline with a switch. The
+/// comments show their payload
+enum class GlCommandOpcode: U8
+{
+	GENERIC, ///< A GlCommand. See GlCommandBuffer::pushBackNewCommand
+	USER_CALLBACK, ///< GlUserCallbackCommandData
+	EXECUTE_COMMAND_BUFFER, ///< GlExecuteCommandBufferCommandData and values
+	ENABLE, ///< Array<U32, 2>: Capability and enable
+	CLEAR_COLOR, ///< Array<F32, 4>
+	CLEAR_DEPTH, ///< F32
+	CLEAR_STENCIL, ///< U32
+	CLEAR, ///< U32
+	VIEWPORT, ///< Array<U16, 4>
+	COLOR_MASK, ///< Array<Bool8, 4>
+	DEPTH_FUNCTION, ///< GLenum
+	DEPTH_MASK, ///< Bool8
+	STENCIL_FUNCTION, ///< Array<U32, 3>
+	STENCIL_MASK, ///< U32
+	STENCIL_OPERATIONS, ///< Array<GLenum, 3>
+	BLEND_EQUATION, ///< GLenum
+	BLEND_FUNCTIONS, ///< Array<GLenum, 2>
+	BLEND_COLOR, ///< Array<F32, 4>
+	PATCH_VERTEX_COUNT, ///< U32
+	CULL_FACE, ///< GLenum
+	POLYGON_OFFSET, ///< Array<F32, 2>
+	BIND_TEXTURE, ///< GlBindTextureCommandData
+	BIND_TEXTURES, ///< GlBindTexturesCommandData and the textures
+	BIND_SAMPLER, ///< GlBindSamplerCommandData
+	BIND_SHADER_BUFFER, ///< GlBindShaderBufferCommandData
+	BIND_VERTEX_BUFFER, ///< GlBindVertexBufferCommandData
+	BIND_INDEX_BUFFER, ///< GlBuffer*
+	BIND_PROGRAM_PIPELINE, ///< GlProgramPipeline*
+	BIND_FRAMEBUFFER, ///< GlBindFramebufferCommandData
+	DRAW_ELEMENTS, ///< GlDrawElementsCommandData
+	DRAW_ARRAYS, ///< GlDrawArraysCommandData
+	COUNT
+};
+
+/// @name Inline command payloads
+/// @{
+class GlUserCallbackCommandData
+{
+public:
+	void (*m_callback)(void*);
+	void* m_userData;
+};
+
+/// It's followed by the values of the parameters of the command buffer
+class GlExecuteCommandBufferCommandData
+{
+public:
+	GlCommandBuffer* m_commands;
+	U32 m_parametersSize;
+};
+
+class GlBindTextureCommandData
+{
+public:
+	const GlTexture* m_tex;
+	U32 m_unit;
+};
+
+/// It's followed by m_count const GlTexture pointers
+class GlBindTexturesCommandData
+{
+public:
+	U32 m_first;
+	U32 m_count;
+};
+
+class GlBindSamplerCommandData
+{
+public:
+	const GlSampler* m_sampler;
+	U32 m_unit;
+};
+
+class GlBindShaderBufferCommandData
+{
+public:
+	GlBuffer* m_buff;
+	I32 m_offset; ///< If -1 then bind from the beginning
+	I32 m_size; ///< If -1 then bind the whole buffer
+	U32 m_binding;
+};
+
+class GlBindVertexBufferCommandData
+{
+public:
+	GlBuffer* m_buff;
+	U32 m_elementSize;
+	GLenum m_type;
+	U32 m_stride;
+	U32 m_offset;
+	U32 m_attribLocation;
+	Bool8 m_normalized;
+};
+
+class GlBindFramebufferCommandData
+{
+public:
+	GlFramebuffer* m_fb;
+	Bool8 m_invalidate;
+};
+
+class GlDrawElementsCommandData
+{
+public:
+	GLenum m_mode;
+	U32 m_indexSize;
+	GlDrawElementsIndirectInfo m_info;
+};
+
+class GlDrawArraysCommandData
+{
+public:
+	GLenum m_mode;
+	GlDrawArraysIndirectInfo m_info;
+};
+/// @}
+
 /// Command buffer initialization hints. They are used to optimize the allocators
 /// of a command buffer
 class GlCommandBufferInitHints
 {
 	friend class GlCommandBuffer;
 
+public:
+	/// The command buffer will reference its objects through the 
+	/// GlRetirementList of the current frame instead of holding references
+	/// itself. It should be flushed before GlDevice::endFrame
+	void setFrameScoped(Bool frameScoped)
+	{
+		m_frameScoped = frameScoped;
+	}
+
 private:
 	static const PtrSize m_maxChunkSize = 4 * 1024 * 1024; // 1MB
 
 	PtrSize m_chunkSize = 1024;
+	Bool8 m_frameScoped = false;
 };
 
-/// A number of GL commands organized in a chain
+/// A number of GL commands packed in a linear stream. Every command is an
+/// opcode followed by its payload. The most common commands are executed 
+/// inline by a switch. The rest are GlCommand objects that are constructed in
+/// the stream and they are executed through a function pointer
+///
+/// The inline commands keep raw pointers to the GL objects. The command buffer
+/// holds the references of the objects so the handles are copied once per 
+/// command buffer and not once per command
+///
+/// A command buffer can be recorded once and executed by many others, like a
+/// bundle. Parts of its inline payloads can be declared as parameters that 
+/// the executing command buffer sets. See addParameter
 class GlCommandBuffer: public NonCopyable
 {
 public:
@@ -109,30 +254,117 @@ public:
 	/// Compute initialization hints
 	GlCommandBufferInitHints computeInitHints() const;
 
-	/// Create a new command and add it to the chain
+	/// Create a new generic command and add it to the stream
 	template<typename TCommand, typename... TArgs>
 	void pushBackNewCommand(TArgs&&... args)
+	{
+		static_assert(std::is_base_of<GlCommand, TCommand>::value, 
+			"Should be a GlCommand");
+
+		PtrSize padding = (alignof(TCommand) > COMMAND_ALIGNMENT) 
+			? alignof(TCommand) - COMMAND_ALIGNMENT : 0;
+
+		U8* mem = static_cast<U8*>(newCommand(GlCommandOpcode::GENERIC, 
+			sizeof(GenericCommand) + padding + sizeof(TCommand)));
+
+		U8* cmdMem = getAlignedRoundUp(
+			alignof(TCommand), mem + sizeof(GenericCommand));
+
+		GenericCommand& generic = *reinterpret_cast<GenericCommand*>(mem);
+		generic.m_command = 
+			::new(cmdMem) TCommand(std::forward<TArgs>(args)...);
+		generic.m_execute = executeCommand<TCommand>;
+		generic.m_destroy = 
+			(std::is_trivially_destructible<TCommand>::value)
+			? nullptr
+			: destroyCommand<TCommand>;
+	}
+
+	/// Add a command that the interpreter executes inline. The payload is 
+	/// copied as is so it should be trivially copyable
+	template<typename TData>
+	void pushBackInlineCommand(GlCommandOpcode opcode, const TData& data)
+	{
+		static_assert(alignof(TData) <= COMMAND_ALIGNMENT, 
+			"Payload alignment not supported");
+
+		void* mem = newCommand(opcode, sizeof(TData));
+		std::memcpy(mem, &data, sizeof(TData));
+	}
+
+	/// Allocate an inline command with a variable payload
+	/// @return The memory of the payload
+	void* newCommand(GlCommandOpcode opcode, PtrSize payloadSize)
 	{
 		ANKI_ASSERT(m_immutable == false);
-		TCommand* newCommand = 
-			m_alloc.template newInstance<TCommand>(std::forward<TArgs>(args)...);
+		ANKI_ASSERT(opcode < GlCommandOpcode::COUNT);
+
+		PtrSize size = getAlignedRoundUp(COMMAND_ALIGNMENT, 
+			sizeof(CommandHeader) + payloadSize);
 
-		if(m_firstCommand != nullptr)
+		if(ANKI_UNLIKELY(m_lastBlock == nullptr 
+			|| m_lastBlock->m_size + size > m_lastBlock->m_capacity))
 		{
-			ANKI_ASSERT(m_lastCommand != nullptr);
-			ANKI_ASSERT(m_lastCommand->m_nextCommand == nullptr);
-			m_lastCommand->m_nextCommand = newCommand;
-			m_lastCommand = newCommand;
+			newBlock(size);
+		}
+
+		U8* mem = m_lastBlock->getData() + m_lastBlock->m_size;
+		m_lastBlock->m_size += size;
+
+		CommandHeader& header = *reinterpret_cast<CommandHeader*>(mem);
+		header.m_opcode = opcode;
+		header.m_size = size;
+		m_lastCommand = &header;
+
+		return mem + sizeof(CommandHeader);
+	}
+
+	/// Keep a reference to an object until the command buffer is destroyed
+	/// or, if it's frame scoped, until the GPU is done with the frame. The 
+	/// inline commands don't hold handles so they should reference their 
+	/// objects with this
+	template<typename T>
+	void addReference(const GlHandle<T>& handle)
+	{
+		static_assert(sizeof(GlHandle<T>) == sizeof(Reference::m_handle),
+			"The handle should be a pointer");
+
+		if(isReferenceCached(handle._getIdentity()))
+		{
+			return;
+		}
+
+		if(m_retirement)
+		{
+			m_retirement->retain(handle);
 		}
 		else
 		{
-			m_firstCommand = newCommand;
-			m_lastCommand = newCommand;
+			Reference& ref = newReference();
+			::new(&ref.m_handle) GlHandle<T>(handle);
+			ref.m_release = releaseReference<T>;
 		}
 	}
 
+	/// Make a part of the payload of the last inline command a parameter. 
+	/// Every time the command buffer is executed by another one the value of 
+	/// the parameter overwrites that part first. If the value is a GL object
+	/// the executing command buffer should reference it
+	/// @param parameterOffset Where the value is in the parameters
+	/// @param payloadOffset Where the part is in the payload
+	/// @param size The size of the value
+	void addParameter(PtrSize parameterOffset, PtrSize payloadOffset, 
+		PtrSize size);
+
+	/// The size of the parameters that the executing command buffer passes
+	PtrSize getParametersSize() const
+	{
+		return m_parametersSize;
+	}
+
 	/// Execute all commands
-	void executeAllCommands();
+	/// @param parameters The values of the parameters. See addParameter
+	void executeAllCommands(const void* parameters = nullptr);
 
 	/// Fake that it's been executed
 	void makeExecuted()
@@ -149,10 +381,110 @@ public:
 	}
 
 private:
-	GlQueue* m_server;
-	GlCommand* m_firstCommand = nullptr;
-	GlCommand* m_lastCommand = nullptr;
+	static const PtrSize COMMAND_ALIGNMENT = 8;
+	static const PtrSize MAX_BLOCK_SIZE = 1024 * 1024;
+	static const U REFERENCE_CACHE_SIZE = 16;
+
+	/// The header of every command in the stream
+	class CommandHeader
+	{
+	public:
+		GlCommandOpcode m_opcode;
+		U32 m_size; ///< The size of the header and the payload
+	};
+
+	static_assert(sizeof(CommandHeader) == COMMAND_ALIGNMENT, "See file");
+
+	using ExecuteCallback = void(*)(GlCommand*, GlCommandBuffer*);
+	using DestroyCallback = void(*)(GlCommand*);
+
+	/// The payload of a GENERIC command. It's followed by the command
+	class GenericCommand
+	{
+	public:
+		GlCommand* m_command;
+		ExecuteCallback m_execute;
+		DestroyCallback m_destroy; ///< nullptr if it's trivially destructible
+	};
+
+	/// A piece of the command stream. The commands follow it
+	class Block
+	{
+	public:
+		Block* m_next = nullptr;
+		U32 m_size = 0;
+		U32 m_capacity = 0;
+
+		U8* getData()
+		{
+			return reinterpret_cast<U8*>(this) + sizeof(Block);
+		}
+	};
+
+	static_assert(sizeof(Block) % 16 == 0, "Will break the alignment");
+
+	/// A handle that is kept alive by the command buffer
+	class Reference
+	{
+	public:
+		void* m_handle; ///< Storage for a GlHandle
+		void (*m_release)(void*& handle);
+	};
+
+	class ReferenceBlock
+	{
+	public:
+		static const U REFERENCES_COUNT = 32;
+
+		ReferenceBlock* m_next = nullptr;
+		U32 m_count = 0;
+		Array<Reference, REFERENCES_COUNT> m_refs;
+	};
+
+	/// A part of a payload that is overwritten before the execution
+	class Parameter
+	{
+	public:
+		U8* m_payloadPart;
+		U32 m_offset; ///< Where the value is in the parameters
+		U32 m_size;
+	};
+
+	class ParameterBlock
+	{
+	public:
+		static const U PARAMETERS_COUNT = 16;
+
+		ParameterBlock* m_next = nullptr;
+		U32 m_count = 0;
+		Array<Parameter, PARAMETERS_COUNT> m_params;
+	};
+
+	GlQueue* m_server = nullptr;
 	GlCommandBufferAllocator<U8> m_alloc;
+
+	/// @name Command stream
+	/// @{
+	Block* m_firstBlock = nullptr;
+	Block* m_lastBlock = nullptr;
+	PtrSize m_nextBlockSize = 0;
+	CommandHeader* m_lastCommand = nullptr;
+	/// @}
+
+	/// @name Parameters
+	/// @{
+	ParameterBlock* m_paramBlocks = nullptr; ///< The newest first
+	U32 m_parametersSize = 0;
+	/// @}
+
+	/// @name References
+	/// @{
+	GlRetirementList* m_retirement = nullptr; ///< If it's frame scoped
+	ReferenceBlock* m_refBlocks = nullptr; ///< The newest first
+	/// The last objects that got referenced. To avoid most duplicates
+	Array<const void*, REFERENCE_CACHE_SIZE> m_refCache = {{}};
+	/// @}
+
 	Bool8 m_immutable = false;
 
 #if ANKI_DEBUG
@@ -160,6 +492,49 @@ private:
 #endif
 
 	void destroy();
+
+	/// Allocate a block that can hold at least a command of some size
+	void newBlock(PtrSize commandSize);
+
+	/// Check if the object got referenced recently and remember it
+	Bool isReferenceCached(const void* identity)
+	{
+		ANKI_ASSERT(identity);
+		const void*& cached = m_refCache[
+			(reinterpret_cast<PtrSize>(identity) >> 4) % REFERENCE_CACHE_SIZE];
+
+		if(cached == identity)
+		{
+			return true;
+		}
+
+		cached = identity;
+		return false;
+	}
+
+	/// Get a new reference
+	Reference& newReference();
+
+	/// Execute the commands of a block
+	void executeBlock(Block& block);
+
+	template<typename TCommand>
+	static void executeCommand(GlCommand* command, GlCommandBuffer* commands)
+	{
+		(*static_cast<TCommand*>(command))(commands);
+	}
+
+	template<typename TCommand>
+	static void destroyCommand(GlCommand* command)
+	{
+		static_cast<TCommand*>(command)->~TCommand();
+	}
+
+	template<typename T>
+	static void releaseReference(void*& handle)
+	{
+		reinterpret_cast<GlHandle<T>*>(&handle)->~GlHandle<T>();
+	}
 };
 
 /// @}
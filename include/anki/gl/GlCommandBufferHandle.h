@@ -36,8 +36,22 @@ public:
 	/// Add a user command at the end of the command buffer
 	void pushBackUserCommand(UserCallback callback, void* data);
 
-	/// Add another command buffer for execution
-	void pushBackOtherCommandBuffer(GlCommandBufferHandle& commands);
+	/// Add another command buffer for execution. The other command buffer 
+	/// becomes immutable and it can be added many times
+	/// @param commands The command buffer to execute
+	/// @param parameters The values of the parameters of the other command 
+	///                   buffer. They are copied. See addParameter
+	/// @param parametersSize The size of the parameters
+	void pushBackOtherCommandBuffer(GlCommandBufferHandle& commands,
+		const void* parameters = nullptr, PtrSize parametersSize = 0);
+
+	/// Make a part of the payload of the last command a parameter. See
+	/// GlCommandBuffer::addParameter
+	void addParameter(PtrSize parameterOffset, PtrSize payloadOffset, 
+		PtrSize size)
+	{
+		_get().addParameter(parameterOffset, payloadOffset, size);
+	}
 
 	/// Flush command buffer for deffered deletion
 	void flush();
@@ -174,10 +188,24 @@ public:
 			std::forward<TArgs>(args)...);
 	}
 
+	/// Add a new inline command. See GlCommandBuffer::pushBackInlineCommand
+	template<typename TData>
+	void _pushBackInlineCommand(GlCommandOpcode opcode, const TData& data)
+	{
+		_get().pushBackInlineCommand(opcode, data);
+	}
+
+	/// Keep alive an object that an inline command uses
+	template<typename T>
+	void _addReference(const GlHandle<T>& handle)
+	{
+		_get().addReference(handle);
+	}
+
 	/// Execute all commands
-	void _executeAllCommands()
+	void _executeAllCommands(const void* parameters = nullptr)
 	{
-		_get().executeAllCommands();
+		_get().executeAllCommands(parameters);
 	}
 	/// @}
 };
@@ -55,6 +55,15 @@ enum class GlTextureFilter: U8
 	TRILINEAR
 };
 
+/// The types of the transient memory that GlDevice manages
+enum class GlTransientMemoryType: U8
+{
+	UNIFORM, ///< For GL_UNIFORM_BUFFER
+	STORAGE, ///< For GL_SHADER_STORAGE_BUFFER
+	VERTEX, ///< For GL_ARRAY_BUFFER
+	COUNT
+};
+
 /// Split the initializer for re-using parts of it
 class GlTextureInitializerBase
 {
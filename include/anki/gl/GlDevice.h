@@ -12,6 +12,10 @@
 
 namespace anki {
 
+// Forward
+class GlRingBuffer;
+class GlBufferHandle;
+
 /// @addtogroup opengl_other
 /// @{
 
@@ -41,6 +45,28 @@ public:
 	/// Return the alignment of a buffer target
 	PtrSize getBufferOffsetAlignment(GLenum target);
 
+	/// Allocate memory that stays valid until the GPU is done with the 
+	/// current frame. It's thread safe
+	/// @param type The type of the memory
+	/// @param size The size of the allocation
+	/// @param[out] buff The buffer to bind
+	/// @param[out] offset The offset inside the buff
+	/// @return The persistently mapped address to write to
+	void* allocateTransientMemory(GlTransientMemoryType type, PtrSize size,
+		GlBufferHandle& buff, PtrSize& offset);
+
+	/// Fence the transient memory and the objects that the frame scoped 
+	/// command buffers used in the current frame. Call it once per frame 
+	/// with the last command buffer of the frame
+	void endFrame(GlCommandBufferHandle& commands);
+
+	/// Get the transient buffer of a type. For statistics
+	const GlRingBuffer& getTransientBuffer(GlTransientMemoryType type) const
+	{
+		ANKI_ASSERT(m_transientBuffers[(U)type] != nullptr);
+		return *m_transientBuffers[(U)type];
+	}
+
 	/// @privatesection
 	/// @{
 	HeapAllocator<U8> _getAllocator() const
@@ -69,6 +95,12 @@ private:
 	GlQueue* m_queue;
 	HeapAllocator<U8> m_alloc; ///< Keep it last to be deleted last
 	char* m_cacheDir = nullptr;
+	Array<GlRingBuffer*, (U)GlTransientMemoryType::COUNT> m_transientBuffers 
+		= {{}};
+
+#if ANKI_ENABLE_COUNTERS
+	U64 m_atomicOpsCount = 0; ///< The atomic operations until the last frame
+#endif
 
 	void destroy();
 };
@@ -13,6 +13,7 @@ namespace anki {
 
 // Forward
 class GlTexture;
+class GlBuffer;
 
 /// @addtogroup opengl_private
 /// @{
@@ -72,6 +73,11 @@ public:
 	void blit(const GlFramebuffer& fb, const Array<U32, 4>& sourceRect,
 		const Array<U32, 4>& destRect, GLbitfield attachmentMask, Bool linear);
 
+	/// Read a rectangle of the first color attachment to a buffer. The buffer
+	/// is bound to the GL_PIXEL_PACK_BUFFER so the read doesn't block
+	void readPixels(U32 x, U32 y, U32 width, U32 height, GLenum format, 
+		GLenum type, const GlBuffer& buff, PtrSize offset) const;
+
 private:
 	Array<GlTextureHandle, MAX_COLOR_ATTACHMENTS + 1> m_attachments;
 	Bool8 m_bindDefault = false;
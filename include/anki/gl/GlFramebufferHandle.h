@@ -13,6 +13,7 @@ namespace anki {
 
 // Forward
 class GlCommandBufferHandle;
+class GlBufferHandle;
 
 /// @addtogroup opengl_other
 /// @{
@@ -51,6 +52,19 @@ public:
 		const Array<U32, 4>& destRect, 
 		GLbitfield attachmentMask,
 		Bool linear);
+
+	/// Read a rectangle of the first color attachment to a buffer without
+	/// blocking. Use a fence to know when the data are ready
+	/// @param[in, out] commands The command buffer
+	/// @param x, y, width, height The rectangle
+	/// @param format The format of the pixels. Same as glReadPixels
+	/// @param type The type of the pixels. Same as glReadPixels
+	/// @param[in, out] buff The buffer to write to
+	/// @param offset Where to write inside the buff
+	void readPixels(GlCommandBufferHandle& commands,
+		U32 x, U32 y, U32 width, U32 height,
+		GLenum format, GLenum type,
+		GlBufferHandle& buff, PtrSize offset);
 };
 
 } // end namespace anki
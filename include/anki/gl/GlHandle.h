@@ -17,6 +17,16 @@ class GlDevice;
 /// @addtogroup opengl_private
 /// @{
 
+#if ANKI_ENABLE_COUNTERS
+/// The atomic operations of all the handles. For statistics
+extern Atomic<U64> glHandleAtomicOpsCount;
+
+#	define ANKI_GL_HANDLE_COUNT_ATOMIC_OP() \
+		glHandleAtomicOpsCount.fetch_add(1, std::memory_order_relaxed)
+#else
+#	define ANKI_GL_HANDLE_COUNT_ATOMIC_OP() ((void)0)
+#endif
+
 /// State of the handle
 enum class GlHandleState: U8
 {
@@ -101,6 +111,7 @@ public:
 
 		// Set common
 		m_cb->m_refcount = 1;
+		m_cb->m_retainFrame = 0;
 		m_cb->m_ptr = ptr;
 	}
 
@@ -146,6 +157,7 @@ public:
 			auto count = b.m_cb->m_refcount.fetch_add(1);
 			ANKI_ASSERT(count > 0);
 			(void)count;
+			ANKI_GL_HANDLE_COUNT_ATOMIC_OP();
 
 			m_cb = b.m_cb;
 		}
@@ -230,6 +242,29 @@ public:
 		return m_cb->getStateAtomically(&newVal);
 	}
 
+	/// Get something that identifies the object. Two handles of the same 
+	/// object have the same identity
+	const void* _getIdentity() const
+	{
+		return m_cb;
+	}
+
+	/// Mark the object as used by a frame. See GlRetirementList
+	/// @return False if it's already marked for that frame
+	Bool _markForFrame(U32 frame) const
+	{
+		ANKI_ASSERT(m_cb != nullptr && frame != 0);
+
+		// Check before the exchange to avoid the atomic operation
+		if(m_cb->m_retainFrame.load(std::memory_order_relaxed) == frame)
+		{
+			return false;
+		}
+
+		ANKI_GL_HANDLE_COUNT_ATOMIC_OP();
+		return m_cb->m_retainFrame.exchange(frame) != frame;
+	}
+
 	GlDevice& _getManager() const
 	{
 		ANKI_ASSERT(m_cb != nullptr && m_cb->getManager() != nullptr);
@@ -245,6 +280,8 @@ private:
 	public:
 		Y* m_ptr;
 		Atomic<I32> m_refcount;
+		/// The last frame that retained the object. See _markForFrame
+		Atomic<U32> m_retainFrame;
 
 		virtual ~CtrlBlockBase()
 		{}
@@ -355,6 +392,7 @@ private:
 		if(m_cb)
 		{
 			auto count = m_cb->m_refcount.fetch_sub(1);
+			ANKI_GL_HANDLE_COUNT_ATOMIC_OP();
 			if(count == 1)
 			{
 				m_cb->deletePtr();
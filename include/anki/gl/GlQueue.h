@@ -9,6 +9,7 @@
 #include "anki/gl/GlCommandBufferHandle.h"
 #include "anki/gl/GlSyncHandles.h"
 #include "anki/gl/GlState.h"
+#include "anki/gl/GlRetirementList.h"
 #include "anki/util/Thread.h"
 
 namespace anki {
@@ -65,6 +66,11 @@ public:
 	{
 		return m_state;
 	}
+
+	GlRetirementList& getRetirementList()
+	{
+		return m_retirement;
+	}
 	/// @}
 
 	/// Start the working thread
@@ -123,6 +129,9 @@ private:
 	GlState m_state;
 	GLuint m_defaultVao;
 
+	/// Keeps alive the objects of the frame scoped command buffers
+	GlRetirementList m_retirement;
+
 	/// A special command buffer that is called every time we want to wait for 
 	/// the server
 	GlCommandBufferHandle m_syncCommands;
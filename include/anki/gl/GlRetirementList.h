@@ -0,0 +1,145 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_GL_GL_RETIREMENT_LIST_H
+#define ANKI_GL_GL_RETIREMENT_LIST_H
+
+#include "anki/gl/GlHandle.h"
+#include "anki/gl/GlSyncHandles.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+// Forward
+class GlQueue;
+
+/// @addtogroup opengl_private
+/// @{
+
+/// Keeps alive the GL objects that the command buffers of a frame use until
+/// the GPU is done with the frame. An object is retained once per frame no
+/// matter how many command buffers use it, so the command buffers don't touch
+/// the reference counts of the objects. The references of a frame are
+/// released in bulk when the fence of the frame is signaled
+class GlRetirementList: public NonCopyable
+{
+public:
+	/// The number of frames the GPU may lag behind
+	static const U32 MAX_FRAMES_IN_FLIGHT = 3;
+
+	GlRetirementList(GlQueue* queue);
+
+	~GlRetirementList();
+
+	/// Keep an object alive until the GPU is done with the current frame.
+	/// It's thread safe
+	template<typename T>
+	void retain(const GlHandle<T>& handle)
+	{
+		static_assert(sizeof(GlHandle<T>) == sizeof(Reference::m_handle),
+			"The handle should be a pointer");
+
+		if(handle._markForFrame(m_crntFrame))
+		{
+			Reference& ref = newReference();
+			::new(&ref.m_handle) GlHandle<T>(handle);
+			ref.m_release = releaseReference<T>;
+		}
+	}
+
+	/// Fence the objects of the current frame and start a new frame. Release
+	/// the objects of the frames that the GPU is done with
+	/// @param commands The last command buffer of the frame
+	void endFrame(GlCommandBufferHandle& commands);
+
+	/// Release everything without waiting for the GPU. Use it when the
+	/// server is idle
+	void destroy();
+
+	/// @name Statistics
+	/// @{
+
+	/// The objects that the current frame retained so far
+	U32 getReferencesCount() const
+	{
+		return m_crntFrameRefsCount;
+	}
+
+	/// The objects that the last frame retained
+	U32 getLastFrameReferencesCount() const
+	{
+		return m_lastFrameRefsCount;
+	}
+	/// @}
+
+private:
+	/// A retained handle
+	class Reference
+	{
+	public:
+		void* m_handle; ///< Storage for a GlHandle
+		void (*m_release)(void*& handle);
+	};
+
+	class ReferenceBlock
+	{
+	public:
+		static const U REFERENCES_COUNT = 64;
+
+		ReferenceBlock* m_next = nullptr;
+		U32 m_count = 0;
+		Array<Reference, REFERENCES_COUNT> m_refs;
+	};
+
+	/// A frame that the GPU may still use
+	class Frame
+	{
+	public:
+		GlFenceHandle m_fence;
+		ReferenceBlock* m_refs = nullptr;
+	};
+
+	GlQueue* m_queue;
+	HeapAllocator<U8> m_alloc;
+
+	/// Never zero because that's the value of the objects that were never
+	/// retained
+	U32 m_crntFrame = 1;
+	ReferenceBlock* m_crntFrameRefs = nullptr; ///< The newest first
+	U32 m_crntFrameRefsCount = 0;
+	U32 m_lastFrameRefsCount = 0;
+	SpinLock m_lock; ///< Protects the references of the current frame
+
+	Array<Frame, MAX_FRAMES_IN_FLIGHT> m_frames;
+	U32 m_firstFrame = 0; ///< The oldest frame in m_frames
+	U32 m_framesCount = 0; ///< Frames in flight
+
+	ReferenceBlock* m_freeBlocks = nullptr; ///< Recycled blocks
+
+	/// Get a reference slot for the current frame
+	Reference& newReference();
+
+	/// Release and recycle a list of blocks
+	void releaseReferences(ReferenceBlock* blocks);
+
+	/// Release the frames that the GPU is done with
+	void retireFrames();
+
+	/// Block until the GPU is done with the oldest frame
+	void waitOldestFrame();
+
+	template<typename T>
+	static void releaseReference(void*& handle)
+	{
+		reinterpret_cast<GlHandle<T>*>(&handle)->~GlHandle<T>();
+	}
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
+
@@ -0,0 +1,183 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_GL_GL_RING_BUFFER_H
+#define ANKI_GL_GL_RING_BUFFER_H
+
+#include "anki/gl/GlBufferHandle.h"
+#include "anki/gl/GlSyncHandles.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup opengl_private
+/// @{
+
+/// The bookkeeping of GlRingBuffer. It doesn't touch GL. The positions grow
+/// forever and the offset in the buffer is pos % size
+class GlRingAllocator
+{
+public:
+	/// The number of frames the GPU may lag behind
+	static const U32 MAX_FRAMES_IN_FLIGHT = 3;
+
+	/// @param alignment The alignment of every allocation
+	/// @param size The size of the ring
+	void create(PtrSize alignment, PtrSize size);
+
+	/// Start over with a new size. There should be no frames in flight
+	void resize(PtrSize size);
+
+	/// Allocate memory for the current frame. It wraps if there is no room
+	/// at the end of the ring
+	/// @param[out] offset The offset of the allocation in the ring
+	/// @return False if it doesn't fit before the oldest frame in flight
+	Bool allocate(PtrSize size, PtrSize& offset);
+
+	/// The current frame goes in flight and a new one starts
+	/// @return The slot of the frame. See getOldestFrame
+	U32 endFrame();
+
+	/// The GPU is done with the oldest frame. Its memory is reused
+	void retireOldestFrame();
+
+	/// The slot of the oldest frame in flight. The slots are between 0 and
+	/// MAX_FRAMES_IN_FLIGHT - 1
+	U32 getOldestFrame() const
+	{
+		ANKI_ASSERT(m_framesCount > 0);
+		return m_firstFrame;
+	}
+
+	U32 getFramesCount() const
+	{
+		return m_framesCount;
+	}
+
+	/// A size that fits the current frame and an allocation of size
+	PtrSize getGrowSize(PtrSize size) const;
+
+	PtrSize getSize() const
+	{
+		return m_size;
+	}
+
+	/// Memory used by the current frame including the alignment and the
+	/// wrapping
+	PtrSize getFrameUsedSize() const
+	{
+		return m_frameUsedSize;
+	}
+
+private:
+	PtrSize m_alignment = 0;
+	PtrSize m_size = 0;
+	U64 m_head = 0; ///< Where the next allocation goes
+	U64 m_tail = 0; ///< The begining of the oldest frame in flight
+	Array<U64, MAX_FRAMES_IN_FLIGHT> m_frameEnds; ///< The m_head at the end
+	U32 m_firstFrame = 0; ///< The oldest frame in m_frameEnds
+	U32 m_framesCount = 0; ///< Frames in flight
+	PtrSize m_frameUsedSize = 0;
+};
+
+/// A persistently mapped buffer that is used as a ring for transient data.
+/// The memory allocated in a frame is fenced at the end of the frame and it's
+/// reused only after the GPU is done with it. If the ring is full it will wait
+/// for the GPU and if the frame alone doesn't fit it will grow
+class GlRingBuffer: public NonCopyable
+{
+public:
+	/// The number of frames the GPU may lag behind
+	static const U32 MAX_FRAMES_IN_FLIGHT = 
+		GlRingAllocator::MAX_FRAMES_IN_FLIGHT;
+
+	GlRingBuffer()
+	{}
+
+	~GlRingBuffer()
+	{}
+
+	/// Create the buffer
+	/// @param device The device
+	/// @param target The target of the buffer
+	/// @param alignment The alignment of every allocation
+	/// @param size The initial size
+	/// @param maxSize The size that the ring can grow to
+	void create(GlDevice* device, GLenum target, PtrSize alignment,
+		PtrSize size, PtrSize maxSize);
+
+	/// Release the buffer and the fences
+	void destroy();
+
+	/// Allocate memory for the current frame. It's thread safe
+	/// @param size The size of the allocation
+	/// @param[out] buff The buffer to bind
+	/// @param[out] offset The offset of the allocation inside the buff
+	/// @return The address to write to
+	void* allocate(PtrSize size, GlBufferHandle& buff, PtrSize& offset);
+
+	/// Fence the memory of the current frame and start a new frame
+	void endFrame(GlCommandBufferHandle& commands);
+
+	/// @name Statistics
+	/// @{
+	PtrSize getSize() const
+	{
+		return m_ring.getSize();
+	}
+
+	/// Memory used by the last frame
+	PtrSize getLastFrameUsedSize() const
+	{
+		return m_lastFrameUsedSize;
+	}
+
+	/// The maximum memory a frame used
+	PtrSize getHighWaterMark() const
+	{
+		return m_highWaterMark;
+	}
+
+	/// How many times the client waited for the GPU
+	U32 getWaitsCount() const
+	{
+		return m_waitsCount;
+	}
+	/// @}
+
+private:
+	GlDevice* m_device = nullptr;
+	GLenum m_target = GL_NONE;
+	PtrSize m_maxSize = 0;
+
+	GlBufferHandle m_buff;
+	U8* m_mapping = nullptr;
+
+	GlRingAllocator m_ring;
+	/// The fences of the frames in flight. Indexed by the slots of m_ring
+	Array<GlFenceHandle, MAX_FRAMES_IN_FLIGHT> m_fences;
+
+	PtrSize m_lastFrameUsedSize = 0;
+	PtrSize m_highWaterMark = 0;
+	U32 m_waitsCount = 0;
+
+	Mutex m_mtx;
+
+	/// Create a new buffer of a given size
+	void createBuffer(PtrSize size);
+
+	/// Release the frames that the GPU is done with
+	/// @return True if memory was released
+	Bool retireFrames();
+
+	/// Block until the GPU is done with the oldest frame
+	void waitOldestFrame();
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "anki/gl/GlCommon.h"
 #include "anki/util/Thread.h"
+#include "anki/util/Atomic.h"
 
 namespace anki {
 
@@ -32,6 +33,62 @@ private:
 	Barrier m_barrier;
 };
 
+/// GPU fence. It gets signaled when the GPU completes all the commands that 
+/// were issued before it
+class GlFence: public NonCopyable
+{
+public:
+	GlFence()
+	{
+		m_signaled.store(0);
+	}
+
+	~GlFence()
+	{
+		if(m_fence)
+		{
+			glDeleteSync(m_fence);
+		}
+	}
+
+	/// Insert the fence in the GL stream. Call it in the server thread
+	void create()
+	{
+		ANKI_ASSERT(m_fence == nullptr);
+		m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	/// Wait for the fence. Call it in the server thread
+	/// @param timeout The time to wait in nanoseconds. If zero it only checks
+	void serverWait(U64 timeout)
+	{
+		ANKI_ASSERT(m_fence);
+		if(isSignaled())
+		{
+			return;
+		}
+
+		GLenum out = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 
+			timeout);
+		ANKI_ASSERT(out != GL_WAIT_FAILED);
+
+		if(out == GL_ALREADY_SIGNALED || out == GL_CONDITION_SATISFIED)
+		{
+			m_signaled.store(1);
+		}
+	}
+
+	/// Safe to call from any thread
+	Bool isSignaled() const
+	{
+		return m_signaled.load() != 0;
+	}
+
+private:
+	GLsync m_fence = nullptr;
+	AtomicU32 m_signaled;
+};
+
 /// @}
 
 } // end namespace anki
@@ -12,6 +12,7 @@ namespace anki {
 
 // Forward
 class GlClientSync;
+class GlFence;
 class GlCommandBufferHandle;
 
 /// @addtogroup opengl_other
@@ -38,6 +39,30 @@ public:
 	void wait();
 };
 
+/// GPU fence handle
+class GlFenceHandle: public GlHandle<GlFence>
+{
+public:
+	using Base = GlHandle<GlFence>;
+
+	GlFenceHandle();
+
+	/// Create the fence and insert it in the command buffer
+	GlFenceHandle(GlCommandBufferHandle& commands);
+
+	~GlFenceHandle();
+
+	/// Fire a command that checks the fence without blocking the server
+	void poll(GlCommandBufferHandle& commands);
+
+	/// Fire a command that blocks the server until the fence is signaled. Use
+	/// it with GlDevice::syncClientServer to wait the GPU in the client
+	void wait(GlCommandBufferHandle& commands);
+
+	/// Return true if a previous poll or wait found the fence signaled
+	Bool isSignaled() const;
+};
+
 /// @}
 
 } // end namespace anki
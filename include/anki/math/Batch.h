@@ -0,0 +1,42 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_MATH_BATCH_H
+#define ANKI_MATH_BATCH_H
+
+#include "anki/Math.h"
+
+namespace anki {
+
+/// @addtogroup math
+/// @{
+
+/// @name Batch operations
+/// They work on arrays with SIMD. Most of them process 4 items at once (2
+/// points at once with AVX2 if the CPU has it). The output may be the input
+/// but the arrays shouldn't overlap otherwise
+/// @{
+
+/// out[i] = m * Vec4(in[i].xyz(), 1.0)
+void transformPoints(const Mat4& m, const Vec4* in, Vec4* out,
+	PtrSize count);
+
+/// out[i] = a[i].combineTransformations(b[i])
+void combineTransformations(const Transform* a, const Transform* b,
+	Transform* out, PtrSize count);
+
+/// out[i] = a[i].slerp(b[i], u[i]). The u should be between 0.0 and 1.0
+void slerp(const Quat* a, const Quat* b, const F32* u, Quat* out,
+	PtrSize count);
+
+/// out[i] = in[i].getInverse()
+void invert(const Mat4* in, Mat4* out, PtrSize count);
+/// @}
+
+/// @}
+
+} // end namespace anki
+
+#endif
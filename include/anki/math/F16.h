@@ -214,6 +214,18 @@ inline F32 operator/(const F32 f, const F16 h)
 	return f / h.toF32();
 }
 /// @}
+
+/// @name Bulk F16 conversions
+/// They use F16C or NEON when available and the result is the same as
+/// converting one by one
+/// @{
+
+/// out[i] = F16(in[i])
+void toF16(const F32* in, F16* out, PtrSize count);
+
+/// out[i] = in[i].toF32()
+void toF32(const F16* in, F32* out, PtrSize count);
+/// @}
 /// @}
 
 static_assert(sizeof(F16) == 2, "Incorrect size");
@@ -0,0 +1,281 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RENDERER_CLUSTERER_H
+#define ANKI_RENDERER_CLUSTERER_H
+
+#include "anki/Math.h"
+#include "anki/util/Vector.h"
+#include "anki/util/Array.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup renderer
+/// @{
+
+/// The light types that the Clusterer knows. The order is the order of the
+/// indices inside a cluster
+enum class ClustererLightType: U8
+{
+	POINT,
+	SPOT,
+	SPOT_TEX,
+	COUNT
+};
+
+/// A light to be binned. Everything is in view space
+class ClustererLight
+{
+public:
+	Vec4 m_posRadius; ///< xyz: position, w: radius
+	Vec4 m_dir; ///< Spots only. xyz: direction
+	F32 m_outerCos = 0.0; ///< Spots only. Cos of the half angle of the cone
+	F32 m_outerSin = 0.0; ///< Spots only. Sin of the half angle of the cone
+	U32 m_index = 0; ///< The index of the light in its GPU array
+	ClustererLightType m_type = ClustererLightType::POINT;
+};
+
+/// A cluster as it's stored in the GPU buffer
+class ClustererCluster
+{
+public:
+	U32 m_offset; ///< Where the light indices of the cluster start
+	U32 m_counts; ///< 16bit points, 8bit spots, 8bit spot tex lights
+
+	U32 getCount(ClustererLightType type) const
+	{
+		switch(type)
+		{
+		case ClustererLightType::POINT:
+			return m_counts & 0xFFFF;
+		case ClustererLightType::SPOT:
+			return (m_counts >> 16) & 0xFF;
+		default:
+			return m_counts >> 24;
+		}
+	}
+};
+
+/// Assigns lights to a 3D grid of clusters (froxels). The X and Y of the grid
+/// split the view like the renderer tiles and the Z splits the depth
+/// exponentially. The output is a cluster array and a light index array. The
+/// indices of a cluster are grouped by light type
+///
+/// The binning runs in parallel without atomics. Every thread takes a range of
+/// Z slices, tests a row of clusters at a time against every light (4 clusters
+/// per iteration with SIMD) and writes to its own bins. The bins are merged
+/// at the end
+///
+/// If the depth range of the geometry of every tile is known the empty clusters
+/// in front and behind the geometry are skipped
+class Clusterer
+{
+	friend class ClustererSetupTask;
+	friend class ClustererBinTask;
+	friend class ClustererMergeTask;
+
+public:
+	/// The limits of ClustererCluster::m_counts
+	static const U32 MAX_POINT_LIGHTS_PER_CLUSTER = 0xFFFF;
+	static const U32 MAX_SPOT_LIGHTS_PER_CLUSTER = 0xFF;
+
+	Clusterer();
+
+	~Clusterer();
+
+	/// @param alloc The allocator of the internal arrays
+	/// @param clustersX The count of the clusters in X
+	/// @param clustersY The count of the clusters in Y
+	/// @param clustersZ The count of the depth slices
+	/// @param maxLightsPerCluster The maximum lights of every type that a
+	///                            cluster can hold
+	void init(HeapAllocator<U8>& alloc, 
+		U32 clustersX, U32 clustersY, U32 clustersZ,
+		const Array<U32, U(ClustererLightType::COUNT)>& maxLightsPerCluster);
+
+	/// Set the frustum. It will recalculate the cluster shapes only if
+	/// something changed
+	/// @param near The near plane distance
+	/// @param far The far plane distance
+	/// @param tanHalfFovX Tan of the half horizontal FOV
+	/// @param tanHalfFovY Tan of the half vertical FOV
+	void prepare(F32 near, F32 far, F32 tanHalfFovX, F32 tanHalfFovY);
+
+	/// Set the depth range of the geometry of every tile (a column of
+	/// clusters). The clusters outside the range of their tile will not get
+	/// lights. Use it before bin
+	/// @param bounds X * Y positive view space depths (x: min, y: max). The
+	///               index of a tile is y * X + x. If it's nullptr there are no
+	///               bounds. It should stay alive until bin returns
+	void setTileDepthBounds(const Vec2* bounds)
+	{
+		m_tileDepthBounds = bounds;
+	}
+
+	/// Bin the lights. The lights should be sorted by type
+	void bin(const ClustererLight* lights, U32 lightsCount,
+		Threadpool& threadpool);
+
+	/// @name Accessors
+	/// @{
+	U32 getClustersCountX() const
+	{
+		return m_counts[0];
+	}
+
+	U32 getClustersCountY() const
+	{
+		return m_counts[1];
+	}
+
+	U32 getClustersCountZ() const
+	{
+		return m_counts[2];
+	}
+
+	U32 getClustersCount() const
+	{
+		return m_counts[0] * m_counts[1] * m_counts[2];
+	}
+
+	/// The result of bin. The index of a cluster is (z * Y + y) * X + x
+	const ClustererCluster* getClusters() const
+	{
+		return &m_clusters[0];
+	}
+
+	const ClustererCluster& getCluster(U x, U y, U z) const
+	{
+		return m_clusters[(z * m_counts[1] + y) * m_counts[0] + x];
+	}
+
+	/// The result of bin. The indices of all the clusters
+	const U32* getLightIndices() const
+	{
+		return (m_lightIndicesCount) ? &m_lightIndices[0] : nullptr;
+	}
+
+	U32 getLightIndicesCount() const
+	{
+		return m_lightIndicesCount;
+	}
+
+	/// Get the params to compute the depth slice of a view space depth in the
+	/// shaders. slice = log2(depth) * params.x + params.y
+	Vec2 getSliceParams() const
+	{
+		return Vec2(m_sliceScale, m_sliceBias);
+	}
+	/// @}
+
+	/// Find the Z slice of a positive view space depth
+	U32 getSlice(F32 depth) const;
+
+private:
+	/// The cluster ranges of a light
+	class LightBounds
+	{
+	public:
+		Array<U8, 3> m_begin; ///< xyz
+		Array<U8, 3> m_end; ///< xyz. If z is equal to begin z the light is out
+	};
+
+	/// A light that touches a row and the clusters it touches
+	class RowLight
+	{
+	public:
+		U32 m_light;
+		U32 m_mask; ///< Bit x is set if it touches cluster x
+	};
+
+	/// What every thread writes
+	class ThreadBins
+	{
+	public:
+		Vector<U32> m_lights; ///< The lights that touch the thread's slices
+		Vector<RowLight> m_rowLights;
+		Vector<U32> m_indices;
+		U32 m_beginSlice = 0;
+		U32 m_endSlice = 0;
+		U32 m_offset = 0; ///< Where m_indices go in the final array
+	};
+
+	HeapAllocator<U8> m_alloc;
+
+	Array<U32, 3> m_counts; ///< Clusters count in XYZ
+	Array<U32, U(ClustererLightType::COUNT)> m_maxLightsPerCluster;
+
+	/// @name Frustum
+	/// @{
+	F32 m_near = 0.0;
+	F32 m_far = 0.0;
+	F32 m_tanHalfFovX = 0.0;
+	F32 m_tanHalfFovY = 0.0;
+	F32 m_sliceScale = 0.0;
+	F32 m_sliceBias = 0.0;
+	/// @}
+
+	/// The planes that split X and Y. They pass from the origin so only the
+	/// normals are needed. SoA and padded to 4 for SIMD
+	Vector<F32> m_planesX; ///< xs and zs of the normals
+	Vector<F32> m_planesY; ///< ys and zs of the normals
+	U32 m_planesXStride = 0;
+	U32 m_planesYStride = 0;
+
+	/// The depth of every slice boundary. Size is Z + 1
+	Vector<F32> m_sliceDepths;
+
+	/// The bounding spheres of the clusters. For every (z, y) row there are
+	/// 4 arrays of m_rowStride floats. Center x, y, z and radius
+	Vector<F32> m_spheres;
+	U32 m_rowStride = 0;
+
+	Vector<LightBounds> m_lightBounds;
+
+	/// @name Depth bounds
+	/// @{
+	const Vec2* m_tileDepthBounds = nullptr;
+	Vector<U32> m_rowMasks; ///< For every (z, y) row the clusters with geometry
+	/// @}
+
+	Array<ThreadBins, Threadpool::MAX_THREADS> m_bins;
+
+	Vector<ClustererCluster> m_clusters;
+	Vector<U32> m_lightIndices;
+	U32 m_lightIndicesCount = 0;
+
+	const ClustererLight* m_lights = nullptr;
+	U32 m_lightsCount = 0;
+
+	/// Compute the bounds of a light. Called by the setup task
+	void computeLightBounds(const ClustererLight& light,
+		LightBounds& bounds) const;
+
+	/// Compute the begin and end of a sphere for some planes
+	void computeRange(const F32* nA, const F32* nZ, U32 planesCount,
+		U32 stride, F32 a, F32 z, F32 radius, U8& begin, U8& end) const;
+
+	/// Test a light against a row of clusters
+	/// @return A mask of the clusters in the range [begin, end)
+	U32 testRow(const ClustererLight& light, const F32* row,
+		U begin, U end) const;
+
+	/// Compute the mask of the clusters of a (z, y) row that overlap the depth
+	/// bounds of their tile. Called by the setup task
+	U32 computeRowMask(U z, U y) const;
+
+	/// Bin the slices of a thread
+	void binSlices(ThreadBins& bins);
+
+	/// Write the clusters of a row and their indices to the thread's bins
+	void writeRow(ThreadBins& bins, ClustererCluster* clusters);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -131,6 +131,7 @@ private:
 
 // Forward
 class Renderer;
+class DebugNodeSnapshot;
 
 /// This is a drawer for some scene nodes that need debug
 class SceneDebugDrawer
@@ -143,7 +144,8 @@ public:
 	~SceneDebugDrawer()
 	{}
 
-	void draw(SceneNode& node);
+	/// Draw the frustum and the visible spatials of a node
+	void draw(const DebugNodeSnapshot& node);
 
 	void draw(const Sector& sector);
 
@@ -155,10 +157,6 @@ public:
 private:
 	DebugDrawer* m_dbg;
 
-	void draw(FrustumComponent& fr) const;
-
-	void draw(SpatialComponent& sp) const;
-
 	void drawPath(const Path& path) const;
 };
 
@@ -8,8 +8,10 @@
 
 #include "anki/util/StdTypes.h"
 #include "anki/util/Ptr.h"
+#include "anki/util/Array.h"
 #include "anki/resource/RenderingKey.h"
 #include "anki/scene/Forward.h"
+#include "anki/scene/RenderComponent.h"
 #include "anki/Gl.h"
 
 namespace anki {
@@ -33,41 +35,76 @@ class RenderableDrawer
 	friend class SetupRenderableVariableVisitor;
 
 public:
-	static const U32 MAX_UNIFORM_BUFFER_SIZE = 1024 * 1024 * 1;
+	/// Texture units that the drawer tracks to avoid redundant binds
+	static const U32 MAX_TEXTURE_UNITS = 16;
 
 	/// The one and only constructor
 	RenderableDrawer(Renderer* r);
 
 	void prepareDraw(RenderingStage stage, Pass pass, GlCommandBufferHandle& jobs);
 
+	/// Render a single renderable
+	/// @param fr The frustum of the render snapshot
+	/// @param visible One of the visible nodes of fr
 	void render(
-		SceneNode& frsn,
+		const FrustumSnapshot& fr,
 		VisibleNode& visible);
 
+	/// Render a number of renderables. It sorts them by state first (and 
+	/// back to front for the blending stage) to minimize the state changes
+	void render(
+		const FrustumSnapshot& fr,
+		VisibleNode* begin,
+		VisibleNode* end);
+
 	void finishDraw();
 
 private:
 	Renderer* m_r;
-	GlBufferHandle m_uniformBuff;
 
 	/// @name State
 	/// @{
 	GlCommandBufferHandle m_jobs;
-	U8* m_uniformPtr;
-
-	/// Used to calc if the uni buffer is big enough. Zero it per swap buffers
-	U32 m_uniformsUsedSize; 
-	U32 m_uniformsUsedSizeFrame;
+	U8* m_uniformPtr; ///< The uniforms of the current renderable
 
 	RenderingStage m_stage;
 	Pass m_pass;
+
+	/// The pipeline and vertex state of m_jobs
+	RenderingState m_state;
+	GLenum m_blendSfactor;
+	GLenum m_blendDfactor;
+	Array<GlTextureHandle, MAX_TEXTURE_UNITS> m_textures;
+	U32 m_stateChanges; ///< Blend and texture changes
 	/// @}
 
 	void setupUniforms(
 		VisibleNode& visibleNode, 
-		RenderComponent& renderable,
-		FrustumComponent& fr,
+		const RenderableSnapshot& renderable,
+		const FrustumSnapshot& fr,
 		F32 flod);
+
+	/// Return false if the material is not drawn in the current stage
+	Bool acceptMaterial(const Material& mtl) const;
+
+	/// Compute the rendering key of a material
+	void computeRenderingKey(const Material& mtl, F32 flod, 
+		RenderingKey& key) const;
+
+	/// Bind a texture if it's not already bound to the unit
+	void bindTexture(GlTextureHandle& tex, U32 unit);
+
+	/// Do the actual rendering
+	/// @param mergedRenderStates The render states of the renderables that
+	///                           are drawn with this one. See 
+	///                           RenderComponent::getMergeKey
+	void renderInternal(
+		VisibleNode& visibleNode,
+		const RenderableSnapshot& renderable,
+		const FrustumSnapshot& fr,
+		F32 flod,
+		const void* const* mergedRenderStates,
+		U32 mergedRenderStatesCount);
 };
 
 /// @}
@@ -45,6 +45,7 @@ public:
 	void setBlurringIterationsCount(const U32 x)
 	{
 		m_blurringIterationsCount = x;
+		m_bundle = GlCommandBufferHandle(); // Record it again
 	}
 	/// @}
 
@@ -81,6 +82,10 @@ private:
 	Timestamp m_commonUboUpdateTimestamp = getGlobTimestamp();
 	GlBufferHandle m_commonBuff;
 
+	/// The commands of the passes. They are recorded once and every frame
+	/// replays them
+	GlCommandBufferHandle m_bundle;
+
 	Hdr(Renderer* r)
 	:	RenderingPass(r)
 	{}
@@ -94,6 +99,8 @@ private:
 	void initInternal(const ConfigSet& initializer);
 
 	void updateDefaultBlock(GlCommandBufferHandle& jobs);
+
+	void recordBundle();
 };
 
 /// @}
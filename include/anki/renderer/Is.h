@@ -13,6 +13,7 @@
 #include "anki/Gl.h"
 #include "anki/Math.h"
 #include "anki/renderer/Sm.h"
+#include "anki/renderer/Clusterer.h"
 #include "anki/util/StdTypes.h"
 #include "anki/util/Array.h"
 #include "anki/core/Timestamp.h"
@@ -20,10 +21,7 @@
 
 namespace anki {
 
-class Camera;
-class PerspectiveCamera;
-class PointLight;
-class SpotLight;
+class FrustumSnapshot;
 
 /// @addtogroup renderer
 /// @{
@@ -51,7 +49,8 @@ private:
 		POINT_LIGHTS_BLOCK_BINDING = 1,
 		SPOT_LIGHTS_BLOCK_BINDING = 2,
 		SPOT_TEX_LIGHTS_BLOCK_BINDING = 3,
-		TILES_BLOCK_BINDING = 4
+		CLUSTERS_BLOCK_BINDING = 4,
+		LIGHT_INDICES_BLOCK_BINDING = 5
 	};
 
 	/// The IS render target
@@ -61,19 +60,12 @@ private:
 	GlFramebufferHandle m_fb;
 
 	/// @name GPU buffers
+	/// The common data, the lights and the clusters are written to the 
+	/// transient memory of the GlDevice every frame
 	/// @{
 
-	/// Contains common data for all shader programs
-	GlBufferHandle m_commonBuff;
-
 	/// Track the updates of commonUbo
 	Timestamp m_commonBuffUpdateTimestamp = getGlobTimestamp();
-
-	/// Contains all the lights
-	GlBufferHandle m_lightsBuff;
-
-	/// Contains the number of lights per tile
-	GlBufferHandle m_tilesBuff;
 	/// @}
 
 	// Light shaders
@@ -81,11 +73,15 @@ private:
 	ProgramResourcePointer m_lightFrag;
 	GlProgramPipelineHandle m_lightPpline;
 
+	/// The commands of the light pass that don't change every frame. The 
+	/// ranges of the transient memory are its parameters
+	GlCommandBufferHandle m_bundle;
+
 	/// Shadow mapping
 	Sm m_sm;
 
 	/// Opt because many ask for it
-	Camera* m_cam;
+	const FrustumSnapshot* m_cam;
 
 	/// If enabled the ground emmits a light
 	Bool8 m_groundLightEnabled;
@@ -103,12 +99,17 @@ private:
 	U8 m_maxSpotLights;
 	U8 m_maxSpotTexLights;
 
+	/// Per cluster
 	U8 m_maxPointLightsPerTile;
 	U8 m_maxSpotLightsPerTile;
 	U8 m_maxSpotTexLightsPerTile;
 	/// @}
 
-	U32 m_tileSize; ///< Cache the value here
+	/// Bins the lights to the clusters
+	Clusterer m_clusterer;
+
+	/// The input of m_clusterer
+	Vector<ClustererLight> m_clustererLights;
 
 	Is(Renderer* r);
 	~Is();
@@ -128,10 +129,10 @@ private:
 	/// Calculate the size of the lights UBO
 	PtrSize calcLightsBufferSize() const;
 
-	/// Calculate the size of the tile
-	PtrSize calcTileSize() const;
+	/// Write the common block to the transient memory
+	void updateCommonBlock(GlBufferHandle& buff, PtrSize& offset);
 
-	void updateCommonBlock(GlCommandBufferHandle& jobs);
+	void recordBundle(GlBufferHandle& transientBuff);
 };
 
 /// @}
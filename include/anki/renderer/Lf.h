@@ -57,6 +57,12 @@ private:
 	U8 m_maxLightsWithFlares;
 	GlBufferHandle m_flareDataBuff;
 
+	/// @name Bundles
+	/// @{
+	GlCommandBufferHandle m_pseudoBundle;
+	GlCommandBufferHandle m_flareGroupBundle; ///< See FlareGroupParameters
+	/// @}
+
 	Lf(Renderer* r)
 	:	RenderingPass(r)
 	{}
@@ -67,6 +73,9 @@ private:
 	void run(GlCommandBufferHandle& jobs);
 	
 	void initInternal(const ConfigSet& initializer);
+
+	/// Record the commands that don't change every frame
+	void recordBundles();
 };
 
 /// @}
@@ -25,7 +25,10 @@ public:
 
 	~MainRenderer();
 
-	void render(SceneGraph& scene);
+	/// Render a frame
+	/// @param snapshot See SceneGraph::getRenderSnapshot. It may run in 
+	///                 another thread while the next frame updates
+	void render(const RenderSnapshot& snapshot);
 
 	/// Save the color buffer to a tga (lossless & uncompressed & slow)
 	/// or jpeg (lossy & compressed fast)
@@ -101,6 +101,13 @@ private:
 	GlProgramPipelineHandle m_ppline;
 	GlTextureHandle m_rt;
 
+	/// The commands of the final pass. They depend on the enabled passes, the
+	/// target and its size so they are recorded again when those change
+	GlCommandBufferHandle m_bundle;
+	U8 m_bundleKey = 0;
+	U32 m_bundleWidth = 0; ///< The viewport of m_bundle
+	U32 m_bundleHeight = 0;
+
 	Pps(Renderer* r);
 	~Pps();
 
@@ -108,6 +115,8 @@ private:
 	void run(GlCommandBufferHandle& jobs);
 
 	void initInternal(const ConfigSet& initializer);
+
+	void recordBundle(Bool drawToDefaultFbo);
 };
 
 /// @}
@@ -0,0 +1,103 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RENDERER_RENDER_QUEUE_H
+#define ANKI_RENDERER_RENDER_QUEUE_H
+
+#include "anki/util/StdTypes.h"
+#include "anki/resource/RenderingKey.h"
+#include "anki/scene/Common.h"
+#include "anki/scene/Forward.h"
+
+namespace anki {
+
+/// @addtogroup renderer
+/// @{
+
+/// An element of the RenderQueue. One per visible renderable
+class RenderQueueElement
+{
+public:
+	U64 m_key;
+	VisibleNode* m_node;
+	F32 m_flod;
+};
+
+/// A list of renderables of a single pass sorted using packed 64bit keys so
+/// that renderables that share state are drawn one after the other.
+///
+/// Key layout from MSB to LSB:
+/// @code
+/// | pass 2 | pipeline 16 | material 14 | mesh 16 | depth 16 |
+/// @endcode
+/// For blended renderables the inverted depth goes after the pass so they
+/// are drawn back to front
+class RenderQueue
+{
+public:
+	/// Depth buckets are 16 bits
+	static const U32 MAX_DEPTH_BUCKET = 0xFFFF;
+
+	RenderQueue(const SceneFrameAllocator<U8>& alloc, U32 maxElements);
+
+	~RenderQueue();
+
+	/// Pack a key
+	/// @param key The rendering key. Together with the programId they 
+	///            identify the program pipeline
+	/// @param programId Identifies the shader programs
+	/// @param materialId Identifies the material (textures, uniform values)
+	/// @param meshId Identifies the vertex buffers
+	/// @param depth The normalized depth. Between 0.0 and 1.0
+	/// @param blending If true sort back to front first
+	static U64 computeKey(const RenderingKey& key, U64 programId, 
+		U64 materialId, U64 meshId, F32 depth, Bool blending);
+
+	/// Add a new renderable
+	void pushBack(U64 key, VisibleNode* node, F32 flod)
+	{
+		ANKI_ASSERT(m_count < m_maxCount);
+		RenderQueueElement& el = m_elements[m_count++];
+		el.m_key = key;
+		el.m_node = node;
+		el.m_flod = flod;
+	}
+
+	/// Radix sort the elements by their keys
+	void sort();
+
+	U32 getSize() const
+	{
+		return m_count;
+	}
+
+	const RenderQueueElement& operator[](U32 i) const
+	{
+		ANKI_ASSERT(i < m_count);
+		return m_elements[i];
+	}
+
+	const RenderQueueElement* begin() const
+	{
+		return m_elements;
+	}
+
+	const RenderQueueElement* end() const
+	{
+		return m_elements + m_count;
+	}
+
+private:
+	SceneFrameAllocator<U8> m_alloc;
+	RenderQueueElement* m_elements = nullptr;
+	U32 m_count = 0;
+	U32 m_maxCount = 0;
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -118,13 +118,11 @@ public:
 		return m_framesNum;
 	}
 
-	const SceneGraph& getSceneGraph() const
+	/// The snapshot of the frame that renders
+	const RenderSnapshot& getRenderSnapshot() const
 	{
-		return *m_scene;
-	}
-	SceneGraph& getSceneGraph()
-	{
-		return *m_scene;
+		ANKI_ASSERT(m_snapshot);
+		return *m_snapshot;
 	}
 
 	const RenderableDrawer& getSceneDrawer() const
@@ -165,6 +163,21 @@ public:
 		return m_renderingQuality;
 	}
 
+	F32 getLodMaxPixelError() const
+	{
+		return m_lodMaxPixelError;
+	}
+
+	F32 getLodHysteresis() const
+	{
+		return m_lodHysteresis;
+	}
+
+	Bool getOcclusionCulling() const
+	{
+		return m_occlusionCulling;
+	}
+
 	const UVec2& getTilesCount() const
 	{
 		return m_tilesCount;
@@ -190,7 +203,9 @@ public:
 	void init(const ConfigSet& initializer);
 
 	/// This function does all the rendering stages and produces a final FAI
-	void render(SceneGraph& scene, 
+	/// @param snapshot The snapshot of the frame. See 
+	///                 SceneGraph::getRenderSnapshot
+	void render(const RenderSnapshot& snapshot, 
 		Array<GlCommandBufferHandle, JOB_CHAINS_COUNT>& jobs);
 
 	/// My version of gluUnproject
@@ -209,12 +224,6 @@ public:
 
 	void drawQuadInstanced(GlCommandBufferHandle& jobs, U32 primitiveCount);
 
-	/// Get the LOD given the distance of an object from the camera
-	F32 calculateLod(F32 distance) const
-	{
-		return distance / m_lodDistance;
-	}
-
 	/// Create a framebuffer attachment texture
 	void createRenderTarget(U32 w, U32 h, GLenum internalFormat, 
 		GLenum format, GLenum type, U32 samples, GlTextureHandle& rt);
@@ -248,10 +257,12 @@ private:
 	U32 m_width;
 	/// Height of the rendering. Don't confuse with the window height
 	U32 m_height;
-	F32 m_lodDistance; ///< Distance that used to calculate the LOD
+	F32 m_lodMaxPixelError; ///< The screen error of the LODs in pixels
+	F32 m_lodHysteresis; ///< The LOD changes when it's that far off
 	U8 m_samples; ///< Number of sample in multisampling
 	Bool8 m_isOffscreen; ///< Is offscreen renderer?
 	Bool8 m_tessellation;
+	Bool8 m_occlusionCulling; ///< See cullOccludedNodes
 	F32 m_renderingQuality; ///< Rendering quality. Relevant for offscreen 
 	UVec2 m_tilesCount;
 
@@ -273,7 +284,7 @@ private:
 	Timestamp m_projectionParamsUpdateTimestamp = getGlobTimestamp();
 	/// @}
 
-	SceneGraph* m_scene; ///< Current scene
+	const RenderSnapshot* m_snapshot = nullptr; ///< Current frame
 	RenderableDrawer m_sceneDrawer;
 
 	U m_framesNum; ///< Frame number
@@ -14,7 +14,7 @@
 
 namespace anki {
 
-class Light;
+class LightSnapshot;
 
 /// @addtogroup renderer
 /// @{
@@ -48,7 +48,7 @@ private:
 	{
 		U32 m_layerId;
 		GlFramebufferHandle m_fb;
-		Light* m_light = nullptr;
+		U64 m_lightUuid = 0; ///< Identifies the light. Zero if none
 		U32 m_timestamp = 0; ///< Timestamp of last render or light change
 	};
 
@@ -71,7 +71,9 @@ private:
 	{}
 
 	void init(const ConfigSet& initializer);
-	void run(Light* shadowCasters[], U32 shadowCastersCount, 
+	/// Render the shadow maps that are out of date and set the shadow map
+	/// indices of the lights
+	void run(LightSnapshot* shadowCasters[], U32 shadowCastersCount, 
 		GlCommandBufferHandle& jobs);
 
 	/// Get max shadow casters
@@ -84,9 +86,9 @@ private:
 	void finishDraw(GlCommandBufferHandle& jobs);
 
 	/// Find the best shadowmap for that light
-	Shadowmap& bestCandidate(Light& light);
+	Shadowmap& bestCandidate(U64 lightUuid);
 
-	Shadowmap* doLight(Light& light, GlCommandBufferHandle& jobs);
+	Shadowmap* doLight(LightSnapshot& light, GlCommandBufferHandle& jobs);
 };
 
 /// @}
@@ -45,6 +45,10 @@ private:
 	GlBufferHandle m_uniformsBuff;
 	GlTextureHandle m_noiseTex;
 
+	/// The commands of the passes. They are recorded once and every frame
+	/// replays them
+	GlCommandBufferHandle m_bundle;
+
 	Ssao(Renderer* r)
 	:	RenderingPass(r)
 	{}
@@ -59,6 +63,8 @@ private:
 
 	void createFb(GlFramebufferHandle& fb, GlTextureHandle& rt);
 	void initInternal(const ConfigSet& initializer);
+
+	void recordBundle();
 };
 
 /// @}
@@ -16,7 +16,8 @@
 namespace anki {
 
 class Renderer;
-class Camera;
+class FrustumSnapshot;
+class SceneNode;
 class ShaderProgramUniformVariable;
 class Frustumable;
 
@@ -38,11 +39,24 @@ public:
 
 	void init(Renderer* r);
 
-	/// Issue the GPU job
-	void runMinMax(const GlTextureHandle& depthMap);
+	/// Issue the GPU job that calculates the min/max depth of the tiles and
+	/// read the results asynchronously. The results are used a few frames
+	/// later by updateTiles
+	void runMinMax(const GlTextureHandle& depthMap, 
+		GlCommandBufferHandle& jobs);
 
 	/// Update the tiles before doing visibility tests
-	void updateTiles(Camera& cam);
+	/// @param cam The camera of the frame that renders
+	void updateTiles(const FrustumSnapshot& cam);
+
+	/// Get the depth range of the geometry of every tile in the view space of
+	/// the camera of the last updateTiles. x is the min and y the max positive
+	/// depth. The index of a tile is y * tilesX + x
+	/// @return nullptr if the bounds are not valid for this frame
+	const Vec2* getDepthBounds() const
+	{
+		return (m_depthBoundsValid) ? &m_depthBounds[0] : nullptr;
+	}
 
 	/// Test against all tiles
 	/// @param[in]  collisionShape The collision shape to test
@@ -55,6 +69,20 @@ public:
 		Bitset* mask) const;
 
 private:
+	/// The number of min/max results that may be in flight
+	static const U32 READBACKS_COUNT = 3;
+
+	/// A min/max result that the GPU writes to a part of m_pixelBuff
+	class Readback
+	{
+	public:
+		GlFenceHandle m_fence;
+		Transform m_camTrf; ///< The camera at the time of the min/max
+		F32 m_near = 0.0;
+		F32 m_far = 0.0;
+		Bool8 m_pending = false;
+	};
+
 	/// Tile planes
 	Vector<Plane> m_allPlanes;
 	Plane* m_planesY = nullptr;
@@ -71,9 +99,26 @@ private:
 	/// Main FB for the fai
 	GlFramebufferHandle m_fb;
 
-	/// PBO buffer that is used to read the data of fai asynchronously
+	/// PBO buffer that is used to read the data of fai asynchronously. It has
+	/// room for READBACKS_COUNT results
 	GlBufferHandle m_pixelBuff;
 
+	/// @name Depth bounds
+	/// @{
+	Array<Readback, READBACKS_COUNT> m_readbacks;
+	U32 m_crntReadback = 0; ///< The readback that runMinMax will write
+
+	/// The linear depths of the latest readback (x: min, y: max)
+	Vector<Vec2> m_readbackDepths;
+	Transform m_readbackCamTrf;
+	Bool8 m_readbackValid = false;
+
+	/// The bounds of the current frame. The m_readbackDepths corrected for
+	/// the motion of the camera
+	Vector<Vec2> m_depthBounds;
+	Bool8 m_depthBoundsValid = false;
+	/// @}
+
 	/// Main shader program
 	ProgramResourcePointer m_frag;
 	GlProgramPipelineHandle m_ppline;
@@ -81,13 +126,22 @@ private:
 	Renderer* m_r = nullptr;
 
 	/// Used to check if the camera is changed and we need to update the planes
-	const Camera* m_prevCam = nullptr;
+	U64 m_prevCamUuid = 0;
 
 	/// Timestamp for the same reason as prevCam
 	Timestamp m_planes4UpdateTimestamp = getGlobTimestamp();
 
 	void initInternal(Renderer* r);
 
+	/// Read the latest min/max result that the GPU finished
+	void readMinMax();
+
+	/// Check how much the camera moved since the latest min/max result
+	/// @param[out] translation The distance the camera travelled
+	/// @param[out] rotation The angle the camera rotated
+	void computeCameraMotion(const FrustumSnapshot& cam, F32& translation, 
+		F32& rotation) const;
+
 	void testRange(const CollisionShape& cs, Bool nearPlane,
 		U iFrom, U iTo, U jFrom, U jTo, Bitset& bitset) const;
 };
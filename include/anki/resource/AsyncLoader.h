@@ -0,0 +1,76 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_ASYNC_LOADER_H
+#define ANKI_RESOURCE_ASYNC_LOADER_H
+
+#include "anki/resource/Common.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// A task for the AsyncLoader
+class AsyncLoaderTask
+{
+	friend class AsyncLoader;
+
+public:
+	virtual ~AsyncLoaderTask()
+	{}
+
+	/// Do the work. It runs in the thread of the loader
+	virtual void operator()() = 0;
+
+private:
+	AsyncLoaderTask* m_next = nullptr;
+};
+
+/// Loads resources in its own thread. The tasks run one after the other in
+/// the order they were submitted
+class AsyncLoader: public NonCopyable
+{
+public:
+	AsyncLoader(const ResourceAllocator<U8>& alloc);
+
+	/// It runs the remaining tasks and then stops the thread
+	~AsyncLoader();
+
+	/// Create a new task and submit it. The loader deletes it after it runs
+	template<typename TTask, typename... TArgs>
+	void newTask(TArgs&&... args)
+	{
+		TTask* task =
+			m_alloc.template newInstance<TTask>(std::forward<TArgs>(args)...);
+		submitTask(task);
+	}
+
+	/// Wait for all the submitted tasks to finish
+	void flush();
+
+private:
+	ResourceAllocator<U8> m_alloc;
+	Thread m_thread;
+	Mutex m_mtx;
+	ConditionVariable m_condVar; ///< Wakes the thread and the waiters
+	AsyncLoaderTask* m_head = nullptr; ///< The queue of the tasks
+	AsyncLoaderTask* m_tail = nullptr;
+	Bool8 m_running = false; ///< A task runs right now
+	Bool8 m_quit = false;
+
+	void submitTask(AsyncLoaderTask* task);
+
+	static I threadCallback(Thread::Info& info);
+
+	void threadLoop();
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -10,6 +10,7 @@
 #include "anki/util/Functions.h"
 #include "anki/util/Vector.h"
 #include "anki/util/Enum.h"
+#include "anki/util/Array.h"
 
 namespace anki {
 
@@ -83,6 +84,13 @@ public:
 		return m_mipLevels;
 	}
 
+	/// The mip of the file that is the mip 0 of the image. Not zero if the
+	/// big mips were skipped because of the maxTextureSize
+	U getFirstMipLevel() const
+	{
+		return m_firstMipLevel;
+	}
+
 	U getDepth() const
 	{
 		ANKI_ASSERT(m_depth != 0);
@@ -105,19 +113,42 @@ public:
 	/// Load an image file
 	/// @param[in] filename The file to load
 	/// @param[in] maxTextureSize Only load mipmaps less or equal to that. Used
-	///                           with AnKi textures
+	///                           with AnKi textures. The smallest mip loads
+	///                           anyway
 	void load(const CString& filename, U32 maxTextureSize = MAX_U32);
 
 private:
 	/// [mip][depthFace]
 	ResourceVector<Surface> m_surfaces;
 	U8 m_mipLevels = 0;
+	U8 m_firstMipLevel = 0;
 	U8 m_depth = 0;
 	DataCompression m_compression = DataCompression::NONE;
 	ColorFormat m_colorFormat = ColorFormat::NONE;
 	TextureType m_textureType = TextureType::NONE;
 };
 
+/// The header of the AnKi texture files (ankitex). After the header come the
+/// RAW, S3TC and ETC data (the ones that are in m_compressionFormats). Each
+/// of them has all the mips (from the biggest) and every mip all the layers
+class AnkiTextureHeader
+{
+public:
+	Array<U8, 8> m_magic;
+	U32 m_width;
+	U32 m_height;
+	U32 m_depth;
+	Image::TextureType m_type;
+	Image::ColorFormat m_colorFormat;
+	Image::DataCompression m_compressionFormats;
+	U32 m_normal;
+	U32 m_mipLevels;
+	U8 m_padding[88];
+};
+
+static_assert(sizeof(AnkiTextureHeader) == 128, 
+	"Check sizeof AnkiTextureHeader");
+
 } // end namespace anki
 
 #endif
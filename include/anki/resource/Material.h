@@ -19,6 +19,7 @@ namespace anki {
 // Forward
 class XmlElement;
 class MaterialProgramCreator;
+class Threadpool;
 
 template<typename T>
 class MaterialVariableTemplate;
@@ -231,6 +232,17 @@ protected:
 	U8 m_lodsCount = 1;
 };
 
+/// Statistics of Material::warmup
+class MaterialWarmupStats
+{
+public:
+	U32 m_materialsCount = 0;
+	U32 m_permutationsCount = 0; ///< Pass x LOD x tessellation permutations
+	U32 m_pipelinesCount = 0; ///< Pipelines created by the warmup
+	F64 m_loadTime = 0.0; ///< Time of the parallel load in seconds
+	F64 m_pipelinesTime = 0.0; ///< Time of the pipeline creation in seconds
+};
+
 /// Material resource
 ///
 /// Every material keeps info of how to render a RenedrableNode. Using a node
@@ -331,6 +343,18 @@ public:
 
 	GlProgramPipelineHandle getProgramPipeline(const RenderingKey& key);
 
+	/// Get the number of pass x LOD x tessellation permutations
+	U32 getPermutationsCount() const
+	{
+		return m_pplines.size();
+	}
+
+	/// Create the program pipelines of all the permutations that are not 
+	/// created yet
+	/// @param cmdb The command buffer to record the creation
+	/// @return The number of pipelines created
+	U32 createProgramPipelines(GlCommandBufferHandle& cmdb);
+
 	/// Get by name
 	const MaterialVariable* findVariableByName(const CString& name) const
 	{
@@ -347,6 +371,27 @@ public:
 		return m_hash < b.m_hash;
 	}
 
+	/// Materials with the same shader sources have the same hash
+	U64 getHash() const
+	{
+		return m_hash;
+	}
+
+	/// Load a number of materials in parallel and then create the program 
+	/// pipelines of all their permutations using a single command buffer. 
+	/// Call it at load time to avoid the hitches of the lazy pipeline creation
+	/// in getProgramPipeline
+	/// @param[in] filenames The materials to load
+	/// @param[out] materials Array of size @a count with the loaded materials
+	/// @param count The number of materials
+	/// @param resources The resource manager
+	/// @param threadpool The threadpool to run the load on
+	/// @param[out] stats Counts and timings of the warmup
+	static void warmup(const CString* filenames, 
+		MaterialResourcePointer* materials, U32 count, 
+		ResourceManager& resources, Threadpool& threadpool, 
+		MaterialWarmupStats& stats);
+
 private:
 	/// Keep it to have access to some stuff at runtime
 	ResourceManager* m_resources = nullptr; 
@@ -365,6 +410,13 @@ private:
 	/// Get a program resource
 	ProgramResourcePointer& getProgram(const RenderingKey key, U32 shaderId);
 
+	/// Compute the index of a key in m_pplines
+	U getProgramPipelineIndex(const RenderingKey& key) const;
+
+	/// Record the creation of a pipeline
+	void createProgramPipeline(const RenderingKey& key, 
+		GlCommandBufferHandle& cmdb, GlProgramPipelineHandle& ppline);
+
 	/// Parse what is within the @code <material></material> @endcode
 	void parseMaterialTag(const XmlElement& el, ResourceInitializer& rinit);
 
@@ -10,6 +10,7 @@
 #include "anki/Math.h"
 #include "anki/Gl.h"
 #include "anki/collision/Obb.h"
+#include "anki/resource/MeshCluster.h"
 
 namespace anki {
 
@@ -88,6 +89,13 @@ public:
 		return m_subMeshes.size();
 	}
 
+	/// The clusters of the triangles. Only the big meshes without sub meshes
+	/// have them
+	const ResourceVector<MeshCluster>& getClusters() const
+	{
+		return m_clusters;
+	}
+
 	/// Get info on how to attach a GL buffer to the state
 	void getBufferInfo(
 		const VertexAttribute attrib, GlBufferHandle& buffer,
@@ -96,6 +104,10 @@ public:
 	/// Helper function for correct loading
 	Bool isCompatible(const Mesh& other) const;
 
+	/// The size of a vertex in the vertex buffer. The meshes with the same
+	/// texture channels and weights have the same layout
+	U32 calcVertexSize() const;
+
 	/// Load from a .mesh file
 	void load(const CString& filename, ResourceInitializer& init);
 
@@ -110,6 +122,7 @@ protected:
 	};
 
 	ResourceVector<SubMesh> m_subMeshes;
+	ResourceVector<MeshCluster> m_clusters;
 	U32 m_indicesCount;
 	U32 m_vertsCount;
 	Obb m_obb;
@@ -121,8 +134,6 @@ protected:
 
 	/// Create the VBOs using the mesh data
 	void createBuffers(const MeshLoader& loader, ResourceInitializer& init);
-
-	U32 calcVertexSize() const;
 };
 
 /// A mesh that behaves as a mesh and as a collection of separate meshes.
@@ -0,0 +1,61 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_MESH_CLUSTER_H
+#define ANKI_RESOURCE_MESH_CLUSTER_H
+
+#include "anki/resource/Common.h"
+#include "anki/Math.h"
+#include "anki/collision/Plane.h"
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// A cluster of neighbouring triangles of a mesh. Its triangles are
+/// consecutive in the index buffer so it can be drawn alone
+class MeshCluster
+{
+public:
+	/// The max triangles of a cluster
+	static const U32 MAX_TRIANGLES = 64;
+
+	/// The meshes with fewer triangles are not split
+	static const U32 MIN_MESH_TRIANGLES = MAX_TRIANGLES * 4;
+
+	Vec4 m_sphere; ///< The center of the bounding sphere and its radius
+	/// The average normal and the cutoff of the normal cone. The cutoff is
+	/// the sine of the widest angle between the normals and the axis. It's
+	/// 1.0 if the cone is too wide to be culled
+	Vec4 m_cone;
+	U32 m_firstIndex;
+	U32 m_indicesCount;
+};
+
+/// Reorder the triangles of a mesh to clusters of neighbouring triangles
+/// with similar normals and compute their bounds
+/// @param[in,out] indices Three per triangle. They are reordered.
+/// @param[out] clusters The clusters in the order of the indices.
+void buildMeshClusters(TempResourceAllocator<U8>& alloc,
+	const Vec3* positions, U32 positionsCount, U16* indices,
+	U32 indicesCount, TempResourceVector<MeshCluster>& clusters);
+
+/// Cull the clusters that are outside of some planes or that show their back
+/// to the eye. Four at a time with SIMD
+/// @param planes The inside of the planes is in front of them.
+/// @param eye Where the clusters are seen from. If it's nullptr the back
+///            facing clusters are not culled.
+/// @param[out] visible The indices of the visible clusters in order. It
+///                     should have room for count.
+/// @return The number of the visible.
+U32 cullMeshClusters(const MeshCluster* clusters, U32 count,
+	const Plane* planes, U planesCount, const Vec4* eye, U32* visible);
+
+/// @}
+
+} // end namespace anki
+
+#endif
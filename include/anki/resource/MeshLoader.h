@@ -7,6 +7,7 @@
 #define ANKI_RESOURCE_MESH_LOADER_H
 
 #include "anki/resource/Common.h"
+#include "anki/resource/MeshCluster.h"
 #include "anki/Math.h"
 #include "anki/util/Vector.h"
 #include "anki/util/Array.h"
@@ -118,9 +119,16 @@ public:
 	{
 		return m_vertIndices;
 	}
+
+	/// Empty if the mesh is small. See MeshCluster::MIN_MESH_TRIANGLES
+	const MLVector<MeshCluster>& getClusters() const
+	{
+		return m_clusters;
+	}
 	/// @}
 
-	/// Append data from another mesh loader. BucketMesh method
+	/// Append data from another mesh loader. BucketMesh method. The clusters
+	/// are dropped
 	void append(const MeshLoader& other);
 
 	/// Load the mesh data from a binary file
@@ -147,6 +155,8 @@ private:
 	/// Generated. Used for vertex arrays & VBOs
 	MLVector<U16> m_vertIndices;
 
+	MLVector<MeshCluster> m_clusters; ///< Generated
+
 	void createFaceNormals();
 	void createVertNormals();
 	void createAllNormals()
@@ -157,6 +167,9 @@ private:
 	void createVertTangents();
 	void createVertIndeces();
 
+	/// Reorder the indices to clusters for the big meshes
+	void createClusters();
+
 	/// This method does some sanity checks and creates normals,
 	/// tangents, VBOs etc
 	/// @exception Exception
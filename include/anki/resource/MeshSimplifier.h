@@ -0,0 +1,166 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_MESH_SIMPLIFIER_H
+#define ANKI_RESOURCE_MESH_SIMPLIFIER_H
+
+#include "anki/resource/Common.h"
+#include "anki/Math.h"
+#include "anki/util/Array.h"
+#include "anki/util/NonCopyable.h"
+#include <algorithm>
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// Simplifies triangle meshes with the quadric error metrics of Garland and
+/// Heckbert. It collapses edges into one of their vertices so the simplified
+/// mesh uses a subset of the vertices and their attributes stay valid.
+///
+/// The vertices of the open edges move only along them. The vertices that
+/// share their position with others (the seams of the texture coordinates)
+/// don't move at all. The collapses that flip triangles are skipped
+class MeshSimplifier: public NonCopyable
+{
+public:
+	/// @param positions The positions of the vertices. It keeps the pointer.
+	/// @param vertsCount The number of positions.
+	/// @param indices Three per triangle.
+	/// @param indicesCount The number of indices.
+	MeshSimplifier(ResourceAllocator<U8>& alloc, const Vec3* positions,
+		U32 vertsCount, const U32* indices, U32 indicesCount);
+
+	~MeshSimplifier();
+
+	/// Collapse edges until the mesh has that many indices or the next
+	/// collapse has bigger error. It continues from the previous call so call
+	/// it with decreasing targets to get a chain of LODs
+	/// @param targetIndicesCount The wanted indices.
+	/// @param maxError The max error in the units of the positions.
+	/// @return The indices count.
+	U32 simplify(U32 targetIndicesCount, F32 maxError);
+
+	/// Get the triangles that are left. They index the input vertices
+	void getIndices(ResourceVector<U32>& indices) const;
+
+	U32 getIndicesCount() const
+	{
+		return m_trisCount * 3;
+	}
+
+	/// The error so far. The square root of the biggest quadric error of
+	/// the collapses. About the distance from the original surface
+	F32 getError() const;
+
+	/// Keep only the vertices that the indices use
+	/// @param[in,out] indices The indices. They change to the new vertices.
+	/// @param vertsCount The number of the old vertices.
+	/// @param[out] remap The old index of every new vertex.
+	static void compactVertices(ResourceVector<U32>& indices, U32 vertsCount,
+		ResourceVector<U32>& remap);
+
+private:
+	/// A symmetric 4x4 matrix. The sum of the squared distances from some
+	/// planes
+	class Quadric
+	{
+	public:
+		Array<F64, 10> m_m;
+		F64 m_weight = 0.0; ///< The sum of the weights of the planes
+
+		Quadric()
+		{
+			std::fill(m_m.begin(), m_m.end(), 0.0);
+		}
+
+		/// Add a plane ax + by + cz + d = 0 with a weight
+		void addPlane(F64 a, F64 b, F64 c, F64 d, F64 weight);
+
+		Quadric& operator+=(const Quadric& b)
+		{
+			for(U i = 0; i < m_m.size(); i++)
+			{
+				m_m[i] += b.m_m[i];
+			}
+
+			m_weight += b.m_weight;
+
+			return *this;
+		}
+
+		/// The weighted mean of the squared distances of a point from the
+		/// planes
+		F64 evaluate(const Vec3& p) const;
+	};
+
+	/// An edge collapse
+	class Collapse
+	{
+	public:
+		F64 m_error;
+		U32 m_from;
+		U32 m_to;
+		U32 m_fromVersion;
+		U32 m_toVersion;
+	};
+
+	enum class VertexKind: U8
+	{
+		MANIFOLD,
+		BORDER, ///< On an open edge
+		LOCKED ///< On a seam, on a complex border or removed
+	};
+
+	ResourceAllocator<U8> m_alloc;
+	const Vec3* m_positions;
+	U32 m_vertsCount;
+	/// Three per triangle. The first of a removed triangle is MAX_U32
+	ResourceVector<U32> m_indices;
+	ResourceVector<Quadric> m_quadrics;
+	ResourceVector<ResourceVector<U32>> m_vertTris; ///< The tris of the verts
+	ResourceVector<U32> m_versions; ///< Changes with the quadric of a vert
+	ResourceVector<VertexKind> m_kinds;
+	ResourceVector<Collapse> m_heap; ///< The cheapest first
+	U32 m_trisCount = 0;
+	F64 m_error = 0.0; ///< Squared
+	Bool8 m_collapsedSinceRebuild = false;
+
+	/// Classify the vertices and add the planes of the borders
+	void initBorders();
+
+	/// Push all the possible collapses
+	void rebuildHeap();
+
+	/// Push the collapses of the edges of a vertex, both directions
+	void pushCollapses(U32 vert);
+
+	void pushCollapse(U32 from, U32 to);
+
+	Bool isAlive(U32 tri) const
+	{
+		return m_indices[tri * 3] != MAX_U32;
+	}
+
+	Bool triHasVertex(U32 tri, U32 vert) const;
+
+	/// Get the neighbour vertices. Unsorted but unique
+	void getNeighbours(U32 vert, ResourceVector<U32>& neighbours) const;
+
+	/// Count the alive triangles that share an edge
+	U countEdgeTris(U32 a, U32 b) const;
+
+	/// The collapse keeps the borders, the topology and the orientation
+	Bool canCollapse(U32 from, U32 to) const;
+
+	void collapse(const Collapse& c);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
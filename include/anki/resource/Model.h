@@ -18,6 +18,21 @@
 
 namespace anki {
 
+/// A few big triangles inside the surface of a model patch that hide what is
+/// behind them. The CPU rasterizes them for the occlusion culling so they
+/// stay in the memory
+class OccluderMesh
+{
+public:
+	ResourceVector<Vec3> m_positions;
+	ResourceVector<U16> m_indices;
+
+	OccluderMesh(ResourceAllocator<U8>& alloc)
+	:	m_positions(alloc),
+		m_indices(alloc)
+	{}
+};
+
 /// Model patch interface class. Its very important class and it binds the
 /// material with the mesh
 class ModelPatchBase
@@ -28,7 +43,9 @@ public:
 
 	ModelPatchBase(ResourceAllocator<U8>& alloc)
 	:	m_vertJobs(alloc),
-		m_meshes(alloc)
+		m_meshes(alloc),
+		m_lodErrors(alloc),
+		m_occluder(alloc)
 	{}
 
 	const Material& getMaterial() const
@@ -37,6 +54,11 @@ public:
 		return *m_mtl;
 	}
 
+	const MaterialResourcePointer& getMaterialResource() const
+	{
+		return m_mtlResource;
+	}
+
 	const Mesh& getMesh(const RenderingKey& key) const
 	{
 		ANKI_ASSERT(key.m_lod < m_meshes.size());
@@ -66,6 +88,27 @@ public:
 		return getMesh(key).getSubMeshesCount();
 	}
 
+	/// Return the maximum number of LODs
+	U getLodsCount() const;
+
+	/// The geometric error of a LOD in model space. About how far its
+	/// surface is from the surface of the LOD 0
+	F32 getLodError(U lod) const
+	{
+		ANKI_ASSERT(lod < m_lodErrors.size());
+		return m_lodErrors[lod];
+	}
+
+	/// The occluder of the patch in model space. Nullptr if it doesn't have
+	/// one
+	const OccluderMesh* getOccluder() const
+	{
+		return (m_occluder.m_indices.size() > 0) ? &m_occluder : nullptr;
+	}
+
+	/// Load the positions and the indices of a mesh file as the occluder
+	void loadOccluder(const CString& filename, ResourceManager& resources);
+
 	/// Get information for multiDraw rendering.
 	/// Given an array of submeshes that are visible return the correct indices
 	/// offsets and counts
@@ -79,27 +122,51 @@ public:
 		Array<PtrSize, ANKI_GL_MAX_SUB_DRAWCALLS>& indicesOffsetArray, 
 		U32& drawcallCount) const;
 
+	/// The index of the vertex descriptor of a key. There is one for every
+	/// LOD and pass
+	U getVertexDescIdx(const RenderingKey& key) const;
+
+	/// Get the mesh and the vertex shader of a key
+	void getMeshAndProgram(const RenderingKey& key, const Mesh*& mesh,
+		GlProgramHandle& prog) const;
+
+	/// Create a vertex descriptor like the ones of the patch but for other
+	/// buffers. They should hold a copy of the vertices and indices of the
+	/// mesh of the key
+	void createVertexDesc(
+		const RenderingKey& key,
+		const GlBufferHandle& vertBuff,
+		const GlBufferHandle& indicesBuff,
+		GlCommandBufferHandle& vertJobs) const;
+
 protected:
 	/// Array [lod][pass]
 	ResourceVector<GlCommandBufferHandle> m_vertJobs;
+	MaterialResourcePointer m_mtlResource;
 	Material* m_mtl = nullptr;
 	ResourceVector<Mesh*> m_meshes; ///< One for each LOD
+	ResourceVector<F32> m_lodErrors; ///< One for each LOD
+	OccluderMesh m_occluder;
 
 	/// Create vertex descriptors using a material and a mesh
-	void create(GlDevice* gl);
+	/// @param lodErrors The errors of the LODs after the first. If they are
+	///                  less than the LODs the rest are guessed from the
+	///                  size of the mesh.
+	void create(GlDevice* gl, const F32* lodErrors, U lodErrorsCount);
 
 private:
 	/// Called by @a create multiple times to create and populate a single
 	/// vertex descriptor
+	/// @param vertBuff If not nullptr it replaces the vertex buffer of the
+	///                 mesh.
+	/// @param indicesBuff If not nullptr it replaces the index buffer of 
+	///                    the mesh.
 	static void createVertexDesc(
 		const GlProgramHandle& prog,
 		const Mesh& mesh,
-		GlCommandBufferHandle& vertexJobs);
-
-	/// Return the maximum number of LODs
-	U getLodsCount() const;
-
-	U getVertexDescIdx(const RenderingKey& key) const;
+		GlCommandBufferHandle& vertexJobs,
+		const GlBufferHandle* vertBuff = nullptr,
+		const GlBufferHandle* indicesBuff = nullptr);
 };
 
 /// Its a chunk of a model. Its very important class and it binds the material
@@ -109,10 +176,13 @@ class ModelPatch: public ModelPatchBase
 {
 public:
 	/// Accepts a number of mesh filenames, one for each LOD
+	/// @param lodErrors See ModelPatchBase::create.
 	ModelPatch(
 		CString meshFNames[], 
 		U32 meshesCount,
 		const CString& mtlFName, 
+		const F32* lodErrors,
+		U32 lodErrorsCount,
 		ResourceManager* resources);
 
 	~ModelPatch()
@@ -120,7 +190,6 @@ public:
 
 private:
 	ResourceVector<MeshResourcePointerType> m_meshResources; ///< Geometries
-	MaterialResourcePointer m_mtlResource; ///< Material
 };
 
 /// Model is an entity that acts as a container for other resources. Models are
@@ -137,6 +206,8 @@ private:
 /// 			[<bucketMesh>path/to/mesh.bmesh</bucketMesh>
 ///				[<bucketMesh1>path/to/mesh_lod_1.bmesh</bucketMesh1>]
 ///				[<bucketMesh2>path/to/mesh_lod_2.bmesh</bucketMesh2>]]
+/// 			[<lodErrors>error_of_lod_1 error_of_lod_2</lodErrors>]
+/// 			[<occluder>path/to/occluder.mesh</occluder>]
 /// 			<material>path/to/material.mtl</material>
 /// 		</modelPatch>
 /// 		...
@@ -158,6 +229,10 @@ private:
 /// - If the materials need texture coords then mesh should have them
 /// - The skeleton and skelAnims are optional
 /// - Its an error to have skelAnims without skeleton
+/// - The lodErrors are the distances in model space of the surfaces of the
+///   LODs from the surface of the first mesh. The mesh tool writes them
+/// - The occluder should be inside the surface of the patch. Only the walls,
+///   the buildings and the big rocks need one
 class Model
 {
 public:
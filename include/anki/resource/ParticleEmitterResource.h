@@ -7,6 +7,7 @@
 #define ANKI_RESOURCE_PARTICLE_EMITTER_RSRC_H
 
 #include "anki/resource/ResourceManager.h"
+#include "anki/resource/Material.h"
 #include "anki/Math.h"
 
 namespace anki {
@@ -8,15 +8,19 @@
 
 #include "anki/resource/Common.h"
 #include "anki/resource/ResourcePointer.h"
+#include "anki/resource/AsyncLoader.h"
+#include "anki/resource/TextureResidency.h"
 #include "anki/util/Vector.h"
 #include "anki/util/Functions.h"
 #include "anki/util/String.h"
+#include "anki/util/Thread.h"
 
 namespace anki {
 
 // Forward
 class ConfigSet;
 class GlDevice;
+class GlTextureHandle;
 class ResourceManager;
 
 // NOTE: Add resources in 3 places
@@ -39,7 +43,8 @@ ANKI_RESOURCE(Model, ModelResourcePointer)
 /// @addtogroup resource
 /// @{
 
-/// Manage resources of a certain type
+/// Manage resources of a certain type. The registry is thread safe so 
+/// resources can be loaded from many threads at the same time
 template<typename Type, typename TResourceManager>
 class TypeResourceManager
 {
@@ -61,6 +66,7 @@ public:
 	/// @{
 	Bool _findLoadedResource(const CString& filename, ResourcePointerType& ptr)
 	{
+		LockGuard<Mutex> lock(m_mtx);
 		auto it = find(filename);
 		
 		if(it != m_ptrs.end())
@@ -74,16 +80,26 @@ public:
 		}
 	}
 
-	void _registerResource(ResourcePointerType& ptr)
+	/// Register a newly loaded resource
+	/// @return False if another thread registered the same resource while
+	///         this one was loading. The caller should drop its copy
+	Bool _registerResource(ResourcePointerType& ptr)
 	{
 		ANKI_ASSERT(ptr.getReferenceCount() == 1);
-		ANKI_ASSERT(find(ptr.getResourceName()) == m_ptrs.end());
+
+		LockGuard<Mutex> lock(m_mtx);
+		if(find(ptr.getResourceName()) != m_ptrs.end())
+		{
+			return false;
+		}
 	
 		m_ptrs.push_back(ptr);
+		return true;
 	}
 
 	void _unregisterResource(ResourcePointerType& ptr)
 	{
+		LockGuard<Mutex> lock(m_mtx);
 		auto it = find(ptr.getResourceName());
 		ANKI_ASSERT(it != m_ptrs.end());
 	
@@ -101,6 +117,7 @@ protected:
 
 private:
 	Container m_ptrs;
+	Mutex m_mtx; ///< Protect m_ptrs
 
 	typename Container::iterator find(const CString& filename)
 	{
@@ -147,6 +164,8 @@ public:
 
 	ResourceManager(Initializer& init);
 
+	~ResourceManager();
+
 	const ResourceString& getDataDirectory() const
 	{
 		return m_dataDir;
@@ -162,8 +181,23 @@ public:
 		return m_textureAnisotropy;
 	}
 
+	/// The max size of the mips that the streamed textures load at first.
+	/// Zero if the streaming is disabled
+	U32 getTextureStreamingTailSize() const
+	{
+		return m_textureStreamingTailSize;
+	}
+
 	TempResourceString fixResourceFilename(const CString& filename) const;
 
+	/// Decide what textures stream using the requests of the frame and start
+	/// the loads. Call it once per frame after the visibility tests
+	void updateTextureStreaming();
+
+	/// Switch to the textures that finished streaming. Call it in the
+	/// rendering thread before the rendering of the frame
+	void commitTextureStreaming();
+
 	/// @privatesection
 	/// @{
 	ResourceAllocator<U8>& _getAllocator()
@@ -171,9 +205,22 @@ public:
 		return m_alloc;
 	}
 
+	/// The temp allocator of the calling thread. It's the shared one unless
+	/// the thread set its own
 	TempResourceAllocator<U8>& _getTempAllocator()
 	{
-		return m_tmpAlloc;
+		return (m_threadTmpAlloc) ? *m_threadTmpAlloc : m_tmpAlloc;
+	}
+
+	/// Create a temp allocator of the same size as the shared one
+	TempResourceAllocator<U8> _newTempAllocator() const;
+
+	/// Make the loads of the calling thread use another temp allocator. The
+	/// shared one is LIFO and parallel loads would free it out of order.
+	/// Pass nullptr to go back to the shared one
+	static void _setThreadTempAllocator(TempResourceAllocator<U8>* alloc)
+	{
+		m_threadTmpAlloc = alloc;
 	}
 
 	GlDevice& _getGlDevice();
@@ -183,6 +230,25 @@ public:
 		return m_cacheDir;
 	}
 
+	AsyncLoader& _getAsyncLoader()
+	{
+		return m_asyncLoader;
+	}
+
+	TextureResidencyManager& _getTextureResidency()
+	{
+		ANKI_ASSERT(m_textureResidency);
+		return *m_textureResidency;
+	}
+
+	/// A streamed texture finished loading
+	/// @param tex The new GL texture. Null if the load failed.
+	void _textureStreamed(TextureResource& texture, 
+		const GlTextureHandle* tex);
+
+	/// Wait for the streaming of a texture and then forget it
+	void _unregisterStreamedTexture(TextureResource& texture);
+
 	template<typename T>
 	Bool _findLoadedResource(const CString& filename, 
 		ResourcePointer<T, ResourceManager>& ptr)
@@ -192,9 +258,9 @@ public:
 	}
 
 	template<typename T>
-	void _registerResource(ResourcePointer<T, ResourceManager>& ptr)
+	Bool _registerResource(ResourcePointer<T, ResourceManager>& ptr)
 	{
-		TypeResourceManager<T, ResourceManager>::_registerResource(ptr);
+		return TypeResourceManager<T, ResourceManager>::_registerResource(ptr);
 	}
 
 	template<typename T>
@@ -208,10 +274,27 @@ private:
 	GlDevice* m_gl = nullptr;
 	ResourceAllocator<U8> m_alloc;
 	TempResourceAllocator<U8> m_tmpAlloc;
+	AllocAlignedCallback m_allocCb;
+	void* m_allocCbData;
+	PtrSize m_tmpAllocSize;
 	ResourceString m_cacheDir;
 	ResourceString m_dataDir;
 	U32 m_maxTextureSize;
 	U32 m_textureAnisotropy;
+
+	AsyncLoader m_asyncLoader;
+
+	/// @name Texture streaming
+	/// @{
+	U32 m_textureStreamingTailSize;
+	TextureResidencyManager* m_textureResidency = nullptr;
+	ResourceVector<TextureResidencyManager::Action> m_streamActions;
+	ResourceVector<TextureResource*> m_streamedTextures; ///< To commit
+	Mutex m_streamMtx; ///< Protect m_streamedTextures
+	ConditionVariable m_streamCondVar; ///< Notified when a stream finishes
+	/// @}
+
+	static thread_local TempResourceAllocator<U8>* m_threadTmpAlloc;
 };
 
 #undef ANKI_RESOURCE
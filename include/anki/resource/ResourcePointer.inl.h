@@ -46,8 +46,15 @@ void ResourcePointer<T, TResourceManager>::load(
 		m_cb->m_resources = resources;
 		std::memcpy(&m_cb->m_uuid[0], &filename[0], len + 1);
 
-		// Register resource
-		resources->_registerResource(*this);
+		// Register resource. If someone else loaded the same resource in the
+		// meantime use theirs
+		if(!resources->_registerResource(*this))
+		{
+			reset();
+			found = resources->_findLoadedResource(filename, other);
+			ANKI_ASSERT(found);
+			*this = other;
+		}
 	}
 	else
 	{
@@ -81,7 +88,7 @@ void ResourcePointer<T, TResourceManager>::copy(const ResourcePointer& b)
 {
 	reset();
 	
-	if(b.m_cb == nullptr)
+	if(b.m_cb != nullptr)
 	{
 		auto count = b.m_cb->m_refcount.fetch_add(1);
 		ANKI_ASSERT(count > 0);
@@ -0,0 +1,52 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_TEXTURE_COMPRESSION_H
+#define ANKI_RESOURCE_TEXTURE_COMPRESSION_H
+
+#include "anki/resource/Common.h"
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// @name Texture compression
+/// Used by the TextureCooker. The texels are RGBA8 and the rows come one
+/// after the other. The blocks are 4x4 texels (64 bytes) with the same
+/// order
+/// @{
+
+/// Calculate some rows of the next mip by averaging 2x2 texels. The RGB is
+/// averaged in linear space (the texels are sRGB) and the alpha as is
+/// @param[in] in The previous mip.
+/// @param inWidth The width of the previous mip. Should be at least 2.
+/// @param inHeight The height of the previous mip. Should be at least 2.
+/// @param normal The RGB is a normal. Average and renormalize it.
+/// @param rowBegin The first row of the new mip.
+/// @param rowEnd One past the last row of the new mip.
+/// @param[out] out The new mip.
+void generateMipRows(const U8* in, U32 inWidth, U32 inHeight, Bool normal,
+	U32 rowBegin, U32 rowEnd, U8* out);
+
+/// Compress a block to BC1 (DXT1). Ignores the alpha. 8 bytes
+void compressBc1Block(const U8* texels, U8* out);
+
+/// Compress a block to BC3 (DXT5). 16 bytes
+void compressBc3Block(const U8* texels, U8* out);
+
+/// Compress a block to ETC2 RGB. Only the modes that ETC1 has are used.
+/// Ignores the alpha. 8 bytes
+void compressEtc2Block(const U8* texels, U8* out);
+
+/// Compress a block to ETC2 RGBA (EAC alpha plus ETC2 RGB). 16 bytes
+void compressEtc2EacBlock(const U8* texels, U8* out);
+/// @}
+
+/// @}
+
+} // end namespace anki
+
+#endif
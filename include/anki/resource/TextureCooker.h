@@ -0,0 +1,88 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_TEXTURE_COOKER_H
+#define ANKI_RESOURCE_TEXTURE_COOKER_H
+
+#include "anki/resource/Image.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// Creates AnKi textures (ankitex) out of images. It generates the mips and
+/// compresses them with all the compressions (RAW, S3TC and ETC). The work
+/// is split in rows of texels or blocks and goes to a Threadpool
+class TextureCooker
+{
+public:
+	TextureCooker(ResourceAllocator<U8>& alloc, Threadpool& threadpool);
+
+	/// Add a layer. A face for cube textures and a slice for 3D and 2D
+	/// array textures. All should have the same size
+	/// @param[in] data The texels. RGB8 or RGBA8.
+	/// @exception Exception
+	void addLayer(const U8* data, U32 width, U32 height,
+		Image::ColorFormat colorFormat);
+
+	/// Add the first surface of an image. See addLayer
+	/// @exception Exception
+	void addLayer(const Image& img);
+
+	/// Create the mips and compress everything
+	/// @param type The type of the texture.
+	/// @param normal The texture is a normal map.
+	/// @param alpha Keep the alpha. If false or the layers are RGB8 then the
+	///              texture is RGB8
+	/// @exception Exception
+	void cook(Image::TextureType type, Bool normal, Bool alpha);
+
+	/// Write the file. Call cook first
+	/// @exception Exception
+	void write(const CString& filename) const;
+
+	/// Get the data of a surface. RGB8 and RGBA8 for RAW
+	const ResourceVector<U8>& getSurfaceData(Image::DataCompression comp,
+		U mip, U layer) const;
+
+	U getMipLevelsCount() const
+	{
+		return m_mipLevels;
+	}
+
+	Image::ColorFormat getColorFormat() const
+	{
+		return m_colorFormat;
+	}
+
+private:
+	ResourceAllocator<U8> m_alloc;
+	Threadpool* m_threadpool;
+
+	/// The RGBA8 mips of the layers. [layer][mip]
+	ResourceVector<ResourceVector<ResourceVector<U8>>> m_layers;
+	U32 m_width = 0;
+	U32 m_height = 0;
+
+	Image::TextureType m_type = Image::TextureType::NONE;
+	Image::ColorFormat m_colorFormat = Image::ColorFormat::NONE;
+	Bool8 m_normal = false;
+	U8 m_mipLevels = 0;
+
+	/// The output. [compression][mip][layer]
+	Array<ResourceVector<ResourceVector<U8>>, 3> m_surfaces;
+
+	void generateMips(U layer);
+
+	void compress(Image::DataCompression comp);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -0,0 +1,162 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_RESOURCE_TEXTURE_RESIDENCY_H
+#define ANKI_RESOURCE_TEXTURE_RESIDENCY_H
+
+#include "anki/resource/Common.h"
+#include "anki/util/Array.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup resource
+/// @{
+
+/// Decides which mips of the streamed textures should be in memory. It
+/// doesn't touch the GPU. It gathers the requests of the frame, keeps the
+/// resident bytes under a budget and outputs the mips to load and to evict.
+///
+/// Every texture has a top resident mip. All the mips from that one down to
+/// the smallest are in memory. The tail mips (the ones the texture had when
+/// registered) are never evicted. A texture that wants a bigger mip can evict
+/// the mips of less important textures. The importance is the last frame the
+/// texture was requested and then its screen size. The mips that are bigger
+/// than wanted are evicted first. A texture that was never requested wants
+/// all of its mips with the lowest importance.
+///
+/// The actions are asynchronous. The texture is pending until actionDone is
+/// called and it's left alone until then
+class TextureResidencyManager: public NonCopyable
+{
+public:
+	using Handle = U32;
+
+	static const U MAX_MIPS = 16;
+
+	/// Change the top resident mip of a texture
+	class Action
+	{
+	public:
+		Handle m_texture;
+		U8 m_mip; ///< The new top resident mip
+		Bool8 m_load; ///< Load or evict
+		void* m_userData;
+	};
+
+	/// @param budget The max bytes of all the resident mips.
+	/// @param maxLoadBytesPerUpdate Limit the bytes of the loads of an
+	///                              update. At least one mip loads anyway
+	TextureResidencyManager(ResourceAllocator<U8>& alloc, PtrSize budget,
+		PtrSize maxLoadBytesPerUpdate);
+
+	~TextureResidencyManager();
+
+	/// Register a new texture. Thread safe
+	/// @param width The width of the mip 0.
+	/// @param height The height of the mip 0.
+	/// @param mipSizes The bytes of every mip (all the layers).
+	/// @param mipsCount The number of mips.
+	/// @param residentMip The top mip that is already in memory.
+	/// @param userData Passed back with the actions.
+	Handle registerTexture(U32 width, U32 height, const PtrSize* mipSizes,
+		U mipsCount, U residentMip, void* userData);
+
+	/// Remove a texture. It shouldn't be pending. Thread safe
+	void unregisterTexture(Handle texture);
+
+	/// Ask for a mip for this frame. The biggest request of the frame wins.
+	/// Thread safe
+	/// @param mip The wanted top mip.
+	/// @param priority Higher is more important. Usually the screen size.
+	void requestMip(Handle texture, U mip, F32 priority);
+
+	/// Ask for the mip that covers a screen size. Thread safe
+	/// @param screenSize The size of the texture on the screen in pixels.
+	void requestScreenSize(Handle texture, F32 screenSize);
+
+	/// Process the requests of the frame and decide. Thread safe
+	/// @param[out] actions The new actions. They are appended.
+	void update(ResourceVector<Action>& actions);
+
+	/// The action of a texture finished. Thread safe
+	/// @param success If false the load is reverted.
+	void actionDone(Handle texture, Bool success = true);
+
+	/// Thread safe
+	Bool isPending(Handle texture) const;
+
+	/// Thread safe
+	U getResidentMip(Handle texture) const;
+
+	/// The resident bytes plus the bytes of the pending loads. Thread safe
+	PtrSize getResidentBytes() const;
+
+	PtrSize getBudget() const
+	{
+		return m_budget;
+	}
+
+	/// The mip of a texture that covers a screen size
+	static U computeMip(U32 width, U32 height, U mipsCount,
+		F32 screenSize);
+
+private:
+	/// The state of a texture
+	class Texture
+	{
+	public:
+		Array<PtrSize, MAX_MIPS> m_mipSizes;
+		void* m_userData = nullptr;
+		U64 m_lastRequestFrame = 0; ///< Zero if never requested
+		F32 m_priority = 0.0; ///< The priority of the last request
+		F32 m_framePriority = 0.0; ///< The priority of this frame
+		U32 m_width = 0;
+		U32 m_height = 0;
+		U8 m_mipsCount = 0;
+		U8 m_tailMip = 0; ///< The top mip that is never evicted
+		U8 m_residentMip = 0;
+		U8 m_prevResidentMip = 0; ///< Before the pending load
+		U8 m_wantedMip = 0;
+		U8 m_frameMip = MAX_U8; ///< The request of this frame
+		Bool8 m_used = false;
+		Bool8 m_pending = false;
+		Bool8 m_evicted = false; ///< Evicted in this update
+	};
+
+	/// A mip that may be evicted
+	class EvictionCandidate
+	{
+	public:
+		U64 m_frame;
+		F32 m_priority;
+		Handle m_texture;
+		U8 m_mip;
+		Bool8 m_excess; ///< Bigger than the wanted mip
+	};
+
+	ResourceAllocator<U8> m_alloc;
+	ResourceVector<Texture> m_textures;
+	ResourceVector<Handle> m_freeHandles;
+	PtrSize m_budget;
+	PtrSize m_maxLoadBytesPerUpdate;
+	PtrSize m_residentBytes = 0;
+	U64 m_frame = 0; ///< Updates count
+	mutable Mutex m_mtx;
+
+	/// Get the bytes of a range of mips
+	static PtrSize getMipsSize(const Texture& tex, U begin, U end);
+
+	/// Evict the mips of the textures that are less important than a texture
+	/// to fit a load of some bytes. It evicts only if it can fit the load
+	Bool evict(ResourceVector<EvictionCandidate>& candidates,
+		U& candidatesBegin, const Texture& loadTex, PtrSize bytes);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -7,6 +7,7 @@
 #define ANKI_RESOURCE_TEXTURE_RESOURCE_H
 
 #include "anki/resource/Common.h"
+#include "anki/resource/TextureResidency.h"
 #include "anki/Gl.h"
 
 namespace anki {
@@ -21,9 +22,19 @@ class Image;
 ///
 /// It loads or creates an image and then loads it in the GPU. It supports 
 /// compressed and uncompressed TGAs and AnKi's texture format.
+///
+/// The 2D AnKi textures may be streamed. Then only the small mips load at
+/// first and the TextureResidencyManager of the ResourceManager decides when
+/// the bigger mips load and go. The new mips load in the AsyncLoader and the
+/// GL texture changes in ResourceManager::commitTextureStreaming
 class TextureResource
 {
 public:
+	TextureResource()
+	{}
+
+	~TextureResource();
+
 	/// Load a texture
 	void load(const CString& filename, ResourceInitializer& init);
 
@@ -39,9 +50,53 @@ public:
 		return m_tex;
 	}
 
+	Bool isStreamed() const
+	{
+		return m_resources != nullptr;
+	}
+
+	/// Ask for the mips that cover a size on the screen for this frame. It
+	/// does nothing if the texture is not streamed
+	void requestScreenSize(F32 screenSize) const;
+
+	/// @privatesection
+	/// @{
+	TextureResidencyManager::Handle _getResidencyHandle() const
+	{
+		ANKI_ASSERT(isStreamed());
+		return m_residencyHandle;
+	}
+
+	/// Load the mips from a mip and down and create a new GL texture. It
+	/// runs in the AsyncLoader
+	/// @param mip The mip of the TextureResidencyManager.
+	void _streamMips(U mip);
+
+	void _setStreamedTexture(const GlTextureHandle& tex)
+	{
+		m_streamedTex = tex;
+	}
+
+	/// Switch to the GL texture of the last _streamMips
+	void _commitStreamedTexture()
+	{
+		m_tex = m_streamedTex;
+		m_streamedTex = GlTextureHandle();
+	}
+	/// @}
+
 private:
 	GlTextureHandle m_tex;
 
+	/// @name Streaming
+	/// @{
+	ResourceManager* m_resources = nullptr; ///< Null if it's not streamed
+	ResourceString m_filename;
+	U32 m_maxSize = 0; ///< The size of the mip 0 of the residency manager
+	TextureResidencyManager::Handle m_residencyHandle = 0;
+	GlTextureHandle m_streamedTex; ///< Waits for the commit
+	/// @}
+
 	/// Load a texture
 	void loadInternal(const CString& filename, ResourceInitializer& init);
 };
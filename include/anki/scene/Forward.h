@@ -27,6 +27,9 @@ class Path;
 class SceneGraph;
 class VisibleNode;
 class Sector;
+class FrustumSnapshot;
+class LightSnapshot;
+class RenderSnapshot;
 
 } // end namespace anki
 
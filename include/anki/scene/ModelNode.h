@@ -36,8 +36,19 @@ public:
 	/// @name RenderComponent virtuals
 	/// @{
 
-	/// Implements RenderComponent::buildRendering
-	void buildRendering(RenderingBuildData& data);
+	/// Implements RenderComponent::getBuildRenderingCallback
+	BuildRenderingCallback getBuildRenderingCallback() override
+	{
+		return &buildRendering;
+	}
+
+	/// Overrides RenderComponent::snapshotRenderState. The resource outlives
+	/// the node
+	const void* snapshotRenderState(SceneFrameAllocator<U8>& alloc) override
+	{
+		(void)alloc;
+		return m_modelPatch;
+	}
 
 	/// Implements  RenderComponent::getMaterial
 	const Material& getMaterial()
@@ -45,6 +56,24 @@ public:
 		return m_modelPatch->getMaterial();
 	}
 
+	/// Overrides RenderComponent::getMeshId
+	U64 getMeshId() override
+	{
+		return (U64)(PtrSize)m_modelPatch;
+	}
+
+	/// Overrides RenderComponent::getLodsCount
+	U getLodsCount() override;
+
+	/// Overrides RenderComponent::getLodError
+	F32 getLodError(U lod) override;
+
+	/// Overrides RenderComponent::getOccluder
+	const OccluderMesh* getOccluder() override
+	{
+		return m_modelPatch->getOccluder();
+	}
+
 	/// Overrides RenderComponent::getRenderComponentWorldTransform
 	void getRenderWorldTransform(U index, Transform& trf) override;
 
@@ -72,6 +101,8 @@ public:
 private:
 	Obb m_obb; ///< In world space
 	const ModelPatchBase* m_modelPatch; ///< The resource
+
+	static void buildRendering(RenderingBuildData& data);
 };
 
 /// The model scene node
@@ -0,0 +1,110 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_SCENE_OCCLUSION_BUFFER_H
+#define ANKI_SCENE_OCCLUSION_BUFFER_H
+
+#include "anki/scene/Common.h"
+#include "anki/Math.h"
+#include "anki/collision/Aabb.h"
+#include "anki/util/Vector.h"
+#include "anki/util/Thread.h"
+
+namespace anki {
+
+/// @addtogroup Scene
+/// @{
+
+/// A small depth buffer that the CPU rasterizes the occluders into. A HiZ of
+/// it keeps the farthest depth of every tile so the bounding boxes are tested
+/// with a few reads. The depth is the normalized device Z
+class OcclusionBuffer
+{
+public:
+	static const U32 WIDTH = 256;
+	static const U32 HEIGHT = 128;
+
+	/// The levels of the HiZ. Every level is the quarter of the previous
+	/// and the first is the quarter of the buffer
+	static const U32 HIZ_LEVELS = 6;
+
+	/// The occluders of a frame stop at that many triangles
+	static const U32 MAX_TRIANGLES = 4096;
+
+	OcclusionBuffer(HeapAllocator<U8>& alloc);
+
+	~OcclusionBuffer();
+
+	/// Clear the buffer and the triangles of the previous frame
+	void clear(const Mat4& viewProjMat);
+
+	/// Transform the triangles of an occluder, clip them on the near plane
+	/// and set them up for the rasterization. The threads can add occluders
+	/// at the same time
+	/// @param threadId The triangles go to the bin of the thread.
+	/// @param mvp The model view projection matrix.
+	void addOccluder(U32 threadId, const Mat4& mvp, const Vec3* positions,
+		const U16* indices, U32 indicesCount);
+
+	/// Rasterize the triangles of all the threads in some rows of the
+	/// buffer. The threads can rasterize different rows at the same time
+	void rasterize(U32 firstRow, U32 rowsCount);
+
+	/// Build the HiZ. Call it after the rasterization
+	void buildHiZ();
+
+	/// Test a box against the HiZ. The boxes that cross the near plane are
+	/// never occluded
+	/// @return True if the occluders hide all of it.
+	Bool isOccluded(const Aabb& box) const;
+
+	/// The depth of a pixel. For the tests
+	F32 getDepth(U32 x, U32 y) const
+	{
+		ANKI_ASSERT(x < WIDTH && y < HEIGHT);
+		return m_depth[y * WIDTH + x];
+	}
+
+private:
+	/// A triangle ready for the rasterization. The edge functions and the
+	/// depth are planes in the pixel space
+	class Triangle
+	{
+	public:
+		/// The A, B and C of the edges. A pixel is inside if all the
+		/// A * x + B * y + C are positive
+		Array<Vec3, 3> m_edges;
+		Vec3 m_depth; ///< The depth is A * x + B * y + C
+		/// The min and max pixels of the triangle inside the buffer
+		Array<U16, 4> m_rect;
+	};
+
+	/// The triangles of a thread. They keep their memory between the frames
+	class Bin
+	{
+	public:
+		Vector<Triangle> m_triangles;
+		Vector<Vec4> m_clip; ///< Temp storage for the transformed vertices
+	};
+
+	HeapAllocator<U8> m_alloc;
+	F32* m_depth = nullptr;
+	/// All the levels of the HiZ one after the other
+	F32* m_hiz = nullptr;
+	Mat4 m_viewProjMat;
+	Array<Bin, Threadpool::MAX_THREADS> m_bins;
+
+	static void setupTriangle(const Vec4& a, const Vec4& b, const Vec4& c,
+		Vector<Triangle>& triangles);
+
+	/// Rasterize a triangle in the rows [firstRow, endRow)
+	void rasterize(const Triangle& tri, U32 firstRow, U32 endRow);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -10,151 +10,19 @@
 #include "anki/scene/MoveComponent.h"
 #include "anki/scene/SpatialComponent.h"
 #include "anki/scene/RenderComponent.h"
+#include "anki/scene/ParticleSimulation.h"
 #include "anki/resource/ParticleEmitterResource.h"
 
 namespace anki {
 
-class ParticleEmitter;
-
 /// @addtogroup scene
 /// @{
 
-/// Particle base
-class ParticleBase
-{
-	friend class ParticleEmitter;
-
-public:
-	ParticleBase()
-	{}
-
-	virtual ~ParticleBase()
-	{}
-
-	F32 getTimeOfBirth() const
-	{
-		return m_timeOfBirth;
-	}
-
-	F32& getTimeOfBirth()
-	{
-		return m_timeOfBirth;
-	}
-
-	void setTimeOfBirth(const F32 x)
-	{
-		m_timeOfBirth = x;
-	}
-
-	F32 getTimeOfDeath() const
-	{
-		return m_timeOfDeath;
-	}
-
-	F32& getTimeOfDeath()
-	{
-		return m_timeOfDeath;
-	}
-
-	void setTimeOfDeath(const F32 x)
-	{
-		m_timeOfDeath = x;
-	}
-
-	Bool isDead() const
-	{
-		return m_timeOfDeath < 0.0;
-	}
-
-	/// Kill the particle
-	virtual void kill()
-	{
-		ANKI_ASSERT(m_timeOfDeath > 0.0);
-		m_timeOfDeath = -1.0;
-	}
-
-	/// Revive the particle
-	virtual void revive(const ParticleEmitter& pe,
-		F32 prevUpdateTime, F32 crntTime);
-
-	/// Only relevant for non-bullet simulations
-	virtual void simulate(const ParticleEmitter& pe, 
-		F32 prevUpdateTime, F32 crntTime)
-	{
-		(void)pe;
-		(void)prevUpdateTime;
-		(void)crntTime;
-	}
-
-	virtual const Vec4& getPosition() const = 0;
-
-protected:
-	F32 m_timeOfBirth; ///< Keep the time of birth for nice effects
-	F32 m_timeOfDeath = -1.0; ///< Time of death. If < 0.0 then dead
-	F32 m_size = 1.0;
-	F32 m_alpha = 1.0;
-};
-
-/// Simple particle for simple simulation
-class ParticleSimple: public ParticleBase
-{
-public:
-	ParticleSimple()
-	{}
-
-	void revive(const ParticleEmitter& pe,
-		F32 prevUpdateTime, F32 crntTime) override;
-
-	void simulate(const ParticleEmitter& pe, F32 prevUpdateTime, 
-		F32 crntTime) override;
-
-	const Vec4& getPosition() const
-	{
-		return m_position;
-	}
-
-private:
-	/// The velocity
-	Vec4 m_velocity = Vec4(0.0);
-	Vec4 m_acceleration = Vec4(0.0);
-	Vec4 m_position;
-};
-
-#if 0
-/// Particle for bullet simulations
-class Particle: public ParticleBase
-{
-public:
-	Particle(
-		const char* name, SceneGraph* scene, // SceneNode
-		// RigidBody
-		PhysicsWorld* masterContainer, const RigidBody::Initializer& init); 
-
-	~Particle();
-
-	void kill()
-	{
-		ParticleBase::kill();
-		body->setActivationState(DISABLE_SIMULATION);
-	}
-
-	void revive(const ParticleEmitter& pe,
-		F32 prevUpdateTime, F32 crntTime);
-
-private:
-	RigidBody* m_body;
-};
-#endif
-
 /// The particle emitter scene node. This scene node emitts
 class ParticleEmitter: public SceneNode, public SpatialComponent, 
 	public MoveComponent, public RenderComponent, 
 	private ParticleEmitterProperties
 {
-	friend class ParticleBase;
-	friend class Particle;
-	friend class ParticleSimple;
-
 public:
 	ParticleEmitter(
 		const char* name, SceneGraph* scene, // SceneNode
@@ -188,10 +56,29 @@ public:
 	/// @name RenderComponent virtuals
 	/// @{
 
-	void buildRendering(RenderingBuildData& data);
+	BuildRenderingCallback getBuildRenderingCallback() override
+	{
+		return &buildRendering;
+	}
+
+	const void* snapshotRenderState(SceneFrameAllocator<U8>& alloc) override;
 
 	const Material& getMaterial();
 
+	U64 getMeshId() override
+	{
+		return (U64)(PtrSize)this;
+	}
+
+	/// The emitters that share the material are merged to one vertex stream
+	U64 getMergeKey() override
+	{
+		return (U64)(PtrSize)&getMaterial();
+	}
+
+	void sortBlendedPrimitives(const Mat4& viewMat,
+		Threadpool& threadpool) override;
+
 	void getRenderWorldTransform(U index, Transform& trf) override;
 
 	Bool getHasWorldTransforms() override;
@@ -205,8 +92,17 @@ private:
 		PHYSICS_ENGINE
 	};
 
+	/// What buildRendering needs from the update. It's in the frame memory
+	class RenderState
+	{
+	public:
+		Material* m_material = nullptr; ///< Owned by the resource
+		const F32* m_verts = nullptr;
+		U32 m_aliveParticlesCount = 0;
+	};
+
 	ParticleEmitterResourcePointer m_particleEmitterResource;
-	SceneVector<ParticleBase*> m_particles;
+	ParticleSimulation* m_simulation = nullptr;
 	F32 m_timeLeftForNextEmission;
 	Obb m_obb;
 	SceneVector<Transform> m_transforms; ///< InstanceTransforms
@@ -216,17 +112,17 @@ private:
 	// rotation is the identity
 	Bool8 m_identityRotation = true;
 
-	U32 m_aliveParticlesCount = 0;
-
-	GlBufferHandle m_vertBuff; ///< Hold the vertex data
-	U8* m_vertBuffMapping = nullptr; 
-
 	SimulationType m_simulationType = SimulationType::UNDEFINED;
 
 	void createParticlesSimulation(SceneGraph* scene);
 	void createParticlesSimpleSimulation(SceneGraph* scene);
 
+	/// The big simulations run in the sync update using all the threads
+	Bool simulatesInSyncUpdate() const;
+
 	void doInstancingCalcs();
+
+	static void buildRendering(RenderingBuildData& data);
 };
 
 /// @}
@@ -0,0 +1,164 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_SCENE_PARTICLE_SIMULATION_H
+#define ANKI_SCENE_PARTICLE_SIMULATION_H
+
+#include "anki/resource/ParticleEmitterResource.h"
+#include "anki/util/Allocator.h"
+#include "anki/util/Thread.h"
+#include "anki/Math.h"
+
+namespace anki {
+
+/// @addtogroup scene
+/// @{
+
+/// The simple (non physics) simulation of the particles of an emitter.
+///
+/// Every component of the particle state is in its own array so the kernels
+/// process 4 particles at once. The alive particles are packed at the front
+/// of the arrays: a dead particle is replaced by the last alive one and a
+/// new particle is appended
+class ParticleSimulation
+{
+	friend class SimulateParticlesTask;
+	friend class SortParticlesTask;
+
+public:
+	/// 3 position, 1 size, 1 alpha
+	static const U VERTEX_COMPONENTS = 3 + 1 + 1;
+
+	/// Below that the simulation runs in the calling thread
+	static const U MIN_PARTICLES_FOR_PARALLEL_UPDATE = 8192;
+
+	/// @param props The properties of the emitter. They should outlive the
+	///              simulation
+	ParticleSimulation(const ParticleEmitterProperties& props,
+		HeapAllocator<U8>& alloc);
+
+	~ParticleSimulation();
+
+	/// @name Accessors
+	/// @{
+	U32 getMaxParticlesCount() const
+	{
+		return m_maxParticlesCount;
+	}
+
+	U32 getAliveParticlesCount() const
+	{
+		return m_aliveCount;
+	}
+
+	/// The vertices that the last simulate() wrote. There are
+	/// VERTEX_COMPONENTS floats per particle. They stay valid during the
+	/// next simulate() so a frame can render while the next one updates
+	const F32* getVertices() const
+	{
+		return m_verts[m_crntVerts];
+	}
+
+	U32 getVerticesCount() const
+	{
+		return m_vertsCount;
+	}
+
+	/// The bounds of the particle positions of the last simulate(). Valid
+	/// only if there are vertices
+	const Vec4& getAabbMin() const
+	{
+		return m_aabbMin;
+	}
+
+	const Vec4& getAabbMax() const
+	{
+		return m_aabbMax;
+	}
+	/// @}
+
+	/// Kill the expired particles and move the rest. It writes the vertices
+	/// and the bounds of the moved particles
+	/// @param threadpool If not nullptr the big simulations are split to its
+	///                   threads. It can't be called by a task of the same
+	///                   threadpool
+	void simulate(F32 prevUpdateTime, F32 crntTime, Threadpool* threadpool);
+
+	/// Emit new particles. They move from the next simulate()
+	/// @param origin The world space origin of the emitter
+	/// @param count How many to emit. It's clamped to the free particles
+	void emit(F32 crntTime, const Vec4& origin, U32 count);
+
+	/// Sort the vertices of the last simulate() back to front. It's a radix
+	/// sort on the view space depth
+	/// @param viewMat The view matrix of the camera
+	/// @param threadpool If not nullptr the big sorts are split to its
+	///                   threads. It can't be called by a task of the same
+	///                   threadpool
+	void sortByDepth(const Mat4& viewMat, Threadpool* threadpool);
+
+private:
+	/// The components of the state of a particle. Each one has an array
+	enum Component
+	{
+		POSITION_X,
+		POSITION_Y,
+		POSITION_Z,
+		VELOCITY_X,
+		VELOCITY_Y,
+		VELOCITY_Z,
+		ACCELERATION_X,
+		ACCELERATION_Y,
+		ACCELERATION_Z,
+		TIME_OF_BIRTH,
+		TIME_OF_DEATH,
+		SIZE,
+		ALPHA,
+		COMPONENTS_COUNT
+	};
+
+	const ParticleEmitterProperties* m_props;
+	HeapAllocator<U8> m_alloc;
+
+	U32 m_maxParticlesCount;
+	U32 m_aliveCount = 0;
+	Array<F32*, COMPONENTS_COUNT> m_state = {{}};
+
+	/// Double buffered. One for the frame that updates and one for the frame
+	/// that renders
+	Array<F32*, 2> m_verts = {{}};
+	U8 m_crntVerts = 0;
+	U32 m_vertsCount = 0;
+
+	Vec4 m_aabbMin = Vec4(0.0);
+	Vec4 m_aabbMax = Vec4(0.0);
+
+	/// @name Sort
+	/// Allocated by the first sort. Only the blended emitters need them
+	/// @{
+	Array<U32*, 2> m_sortKeys = {{}};
+	Array<U32*, 2> m_sortIndices = {{}};
+	F32* m_sortedVerts = nullptr;
+	/// @}
+
+	/// Allocate aligned for the kernels
+	void* allocate(PtrSize size);
+
+	/// Replace a particle with the last alive
+	void removeParticle(U32 i);
+
+	/// Remove the particles that their time of death has passed
+	void killExpiredParticles(F32 crntTime);
+
+	/// Move the particles in [begin, end) and write their vertices
+	void simulateRange(U32 begin, U32 end, F32 prevUpdateTime, F32 crntTime,
+		Vec4& aabbMin, Vec4& aabbMax);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
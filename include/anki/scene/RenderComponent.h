@@ -34,6 +34,7 @@ enum class BuildinMaterialVariableId: U8
 
 // Forward
 class RenderComponentVariable;
+class Threadpool;
 
 template<typename T>
 class RenderComponentVariableTemplate;
@@ -117,6 +118,11 @@ public:
 		return m_mvar->getGlProgramVariable();
 	}
 
+	const MaterialVariable& getMaterialVariable() const
+	{
+		return *m_mvar;
+	}
+
 	Bool isInstanced() const
 	{
 		return m_mvar->isInstanced();
@@ -152,6 +158,11 @@ public:
 		ANKI_ASSERT(m_copy == nullptr && "Forgot to delete");
 	}
 
+	Bool hasValues() const
+	{
+		return m_copy != nullptr || m_mvar->hasValues();
+	}
+
 	const T* begin() const
 	{
 		ANKI_ASSERT((m_mvar->hasValues() || m_copy != nullptr)
@@ -211,6 +222,79 @@ private:
 	T* m_copy = nullptr; ///< Copy of the data
 };
 
+/// Remembers the last GL state that buildRendering set in a job chain. Used
+/// to skip redundant binds between consecutive renderables
+class RenderingState
+{
+public:
+	/// Bind a pipeline if it's not the one already bound
+	void bindProgramPipeline(GlProgramPipelineHandle& ppline,
+		GlCommandBufferHandle& jobs)
+	{
+		if(ppline != m_ppline)
+		{
+			ppline.bind(jobs);
+			m_ppline = ppline;
+			++m_stateChanges;
+		}
+	}
+
+	/// Push the vertex jobs if they are not the ones already pushed
+	void bindVertexJobs(GlCommandBufferHandle& vertJobs,
+		GlCommandBufferHandle& jobs)
+	{
+		if(vertJobs != m_vertJobs)
+		{
+			jobs.pushBackOtherCommandBuffer(vertJobs);
+			m_vertJobs = vertJobs;
+			++m_stateChanges;
+		}
+	}
+
+	/// Call it when the vertex state was changed without bindVertexJobs
+	void invalidateVertexJobs()
+	{
+		m_vertJobs = GlCommandBufferHandle();
+		++m_stateChanges;
+	}
+
+	/// Forget everything. Call it when a new job chain starts
+	void reset()
+	{
+		m_ppline = GlProgramPipelineHandle();
+		m_vertJobs = GlCommandBufferHandle();
+		m_stateChanges = 0;
+	}
+
+	U32 getStateChangesCount() const
+	{
+		return m_stateChanges;
+	}
+
+private:
+	GlProgramPipelineHandle m_ppline;
+	GlCommandBufferHandle m_vertJobs;
+	U32 m_stateChanges = 0;
+};
+
+/// A range of the index buffer
+class IndexRange
+{
+public:
+	U32 m_firstIndex;
+	U32 m_indicesCount;
+};
+
+/// The ranges of the index buffer that have the visible clusters of a
+/// renderable. See cullVisibleClusters
+class VisibleClusters
+{
+public:
+	IndexRange* m_ranges = nullptr;
+	U32 m_rangesCount = 0;
+	U32 m_culledIndicesCount = 0; ///< The indices of the culled clusters
+};
+
 /// Rendering data input and output. This is a structure because we don't want
 /// to change what buildRendering accepts all the time
 class RenderingBuildData
@@ -219,7 +303,54 @@ public:
 	RenderingKey m_key;
 	const U8* m_subMeshIndicesArray; ///< @note indices != drawing indices
 	U32 m_subMeshIndicesCount;
-	GlCommandBufferHandle m_jobs; ///< A job chain 
+	GlCommandBufferHandle m_jobs; ///< A job chain
+	RenderingState* m_state = nullptr; ///< The state of m_jobs
+	GlDevice* m_gl = nullptr; ///< For the transient memory
+	/// What RenderComponent::snapshotRenderState returned for the frame
+	const void* m_renderState = nullptr;
+	/// The render states of the renderables that are drawn together with
+	/// this one. See RenderComponent::getMergeKey
+	const void* const* m_mergedRenderStates = nullptr;
+	U32 m_mergedRenderStatesCount = 0;
+	/// If not nullptr draw only these. See RenderComponent::getClusters
+	const VisibleClusters* m_clusters = nullptr;
+};
+
+/// Build up the rendering of a renderable. Given an array of submeshes that
+/// are visible append jobs to the GL job chain. It runs while the next frame
+/// updates so it gets everything from the RenderingBuildData and it doesn't
+/// access the node
+using BuildRenderingCallback = void (*)(RenderingBuildData& data);
+
+/// A copy of the values of a variable of a RenderComponent
+class RenderComponentVariableSnapshot
+{
+public:
+	const MaterialVariable* m_mvar = nullptr; ///< Owned by the material
+	BuildinMaterialVariableId m_buildinId = 
+		BuildinMaterialVariableId::NO_BUILDIN;
+	/// An array of MaterialVariableTemplate::Type in the frame memory. Null
+	/// if the variable doesn't have values. The textures are not copied, it
+	/// points to the values of the variable
+	const void* m_values = nullptr;
+};
+
+/// What the drawer needs from a visible RenderComponent. It's copied at the 
+/// end of the update so the drawer doesn't access the node while the next
+/// frame updates. The pointers to the resources stay valid because the 
+/// scene deletes the nodes a frame later
+class RenderableSnapshot
+{
+public:
+	BuildRenderingCallback m_buildRendering = nullptr;
+	/// What RenderComponent::snapshotRenderState returned for the frame
+	const void* m_renderState = nullptr;
+	const Material* m_material = nullptr;
+	U64 m_meshId = 0; ///< See RenderComponent::getMeshId
+	U64 m_mergeKey = 0; ///< See RenderComponent::getMergeKey
+	/// In the order of the variables of the material
+	RenderComponentVariableSnapshot* m_variables = nullptr;
+	U32 m_variablesCount = 0;
 };
 
 /// RenderComponent interface. Implemented by renderable scene nodes
@@ -245,14 +376,102 @@ public:
 	}
 	/// @}
 
-	/// Build up the rendering.
-	/// Given an array of submeshes that are visible append jobs to the GL
-	/// job chain
-	virtual void buildRendering(RenderingBuildData& data) = 0;
+	/// Get the function that builds up the rendering
+	virtual BuildRenderingCallback getBuildRenderingCallback() = 0;
+
+	/// Copy the per frame state that buildRendering needs. The renderer may
+	/// call buildRendering while the next frame updates so the state should
+	/// have everything that it reads from the node. Called at the end of
+	/// the update for the visible renderables
+	/// @param alloc The frame allocator. The memory stays valid until the
+	///              frame is rendered
+	/// @return It will be passed to buildRendering in 
+	///         RenderingBuildData::m_renderState
+	virtual const void* snapshotRenderState(SceneFrameAllocator<U8>& alloc)
+	{
+		(void)alloc;
+		return nullptr;
+	}
 
 	/// Access the material
 	virtual const Material& getMaterial() = 0;
 
+	/// Copy what the drawer needs. Called at the end of the update for the
+	/// visible renderables
+	/// @param alloc The frame allocator
+	const RenderableSnapshot* snapshot(SceneFrameAllocator<U8>& alloc);
+
+	/// Identifies the vertex data. Renderables that share it return the same
+	/// value. Used to sort the renderables
+	virtual U64 getMeshId()
+	{
+		return 0;
+	}
+
+	/// The number of the LODs of the geometry
+	virtual U getLodsCount()
+	{
+		return 1;
+	}
+
+	/// The geometric error of a LOD in world units. About how far its 
+	/// surface is from the surface of the LOD 0. See selectLods
+	virtual F32 getLodError(U lod)
+	{
+		(void)lod;
+		return 0.0;
+	}
+
+	/// The clusters of the triangles of a LOD. They are culled one by one
+	/// after the spatials. They should be in world space so only the 
+	/// renderables without world transforms can have them. See 
+	/// cullVisibleClusters
+	/// @param[out] count The number of the clusters.
+	virtual const MeshCluster* getClusters(U lod, U32& count)
+	{
+		(void)lod;
+		count = 0;
+		return nullptr;
+	}
+
+	/// The occluder of the renderable. It's in the space of the first world
+	/// transform if the renderable has world transforms. See 
+	/// cullOccludedNodes
+	virtual const OccluderMesh* getOccluder()
+	{
+		return nullptr;
+	}
+
+	/// The LOD that the camera saw last. See selectLods
+	U getLod() const
+	{
+		return m_lod;
+	}
+
+	void setLod(U lod)
+	{
+		m_lod = lod;
+	}
+
+	/// Consecutive renderables without world transforms that return the same
+	/// non zero key are drawn by one buildRendering of the first. They should
+	/// share the material
+	virtual U64 getMergeKey()
+	{
+		return 0;
+	}
+
+	/// Sort the primitives back to front for the blending. Called after the
+	/// visibility tests for the visible renderables that blend
+	/// @param viewMat The view matrix of the camera
+	/// @param threadpool Its threads are idle. Use it for the big sorts
+	virtual void sortBlendedPrimitives(const Mat4& viewMat,
+		Threadpool& threadpool)
+	{
+		(void)viewMat;
+		(void)threadpool;
+	}
+
 	/// Information for movables. It's actualy an array of transformations.
 	/// @param index The index of the transform to get
 	/// @param[out] trf The transform to set
@@ -295,6 +514,7 @@ protected:
 
 private:
 	Variables m_vars;
+	U8 m_lod = 0;
 };
 /// @}
 
@@ -0,0 +1,169 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_SCENE_RENDER_SNAPSHOT_H
+#define ANKI_SCENE_RENDER_SNAPSHOT_H
+
+#include "anki/scene/Common.h"
+#include "anki/scene/Light.h"
+#include "anki/core/Timestamp.h"
+#include "anki/util/Array.h"
+#include "anki/Math.h"
+#include "anki/Collision.h"
+
+namespace anki {
+
+// Forward
+class SceneGraph;
+class SceneNode;
+class FrustumComponent;
+class VisibilityTestResults;
+
+/// @addtogroup Scene
+/// @{
+
+/// The state of a frustum that the renderer needs
+class FrustumSnapshot
+{
+public:
+	/// Identifies the frustum. See SceneNode::getUuid
+	U64 m_uuid = 0;
+
+	Mat4 m_projectionMat = Mat4::getIdentity();
+	Mat4 m_viewMat = Mat4::getIdentity();
+	Mat4 m_viewProjectionMat = Mat4::getIdentity();
+	Transform m_worldTransform = Transform::getIdentity();
+	Vec4 m_origin = Vec4(0.0);
+	F32 m_near = 0.0;
+	F32 m_far = 0.0;
+	F32 m_fovX = 0.0; ///< Perspective only
+	F32 m_fovY = 0.0; ///< Perspective only
+	Bool8 m_perspective = false;
+
+	/// When the shape of the frustum changed
+	Timestamp m_timestamp = 0;
+
+	/// The latest change of the frustum, its node or one of its visible
+	/// renderables
+	Timestamp m_lastUpdate = 0;
+
+	/// The visible nodes. They live in the frame memory. The renderer uses
+	/// the snapshot of the renderables and not the nodes
+	VisibilityTestResults* m_visible = nullptr;
+};
+
+/// The state of a visible light that the renderer needs
+class LightSnapshot
+{
+public:
+	/// Identifies the light. See SceneNode::getUuid
+	U64 m_uuid = 0;
+
+	Light::LightType m_type = Light::LT_POINT;
+	Transform m_worldTransform = Transform::getIdentity();
+	Vec4 m_diffuseColor = Vec4(1.0);
+	Vec4 m_specularColor = Vec4(1.0);
+	F32 m_radius = 0.0; ///< The radius of a point or the distance of a spot
+	F32 m_innerCos = 0.0; ///< Spot only
+	F32 m_outerCos = 0.0; ///< Spot only
+	/// Spot only. The far ends of the edges of the frustum in world space
+	Array<Vec4, 4> m_extendPoints;
+	Bool8 m_shadow = false;
+
+	/// The shadow map layer. Written by the renderer
+	U8 m_shadowMapIndex = 0xFF;
+
+	/// The frustum of a spot that casts shadow. Null for the rest
+	FrustumSnapshot* m_frustum = nullptr;
+
+	/// @name Lens flare
+	/// @{
+	const GlTextureHandle* m_lensFlareTex = nullptr; ///< Null if no flare
+	Vec2 m_lensFlaresSize = Vec2(0.0);
+	Vec2 m_lensFlaresStretchMultiplier = Vec2(0.0);
+	F32 m_lensFlaresAlpha = 0.0;
+	/// @}
+};
+
+/// What the debug stage draws for a node with spatials
+class DebugNodeSnapshot
+{
+public:
+	U64 m_uuid = 0; ///< See SceneNode::getUuid
+	/// A copy of the name in the frame memory. Null if the node has no name
+	const char* m_name = nullptr;
+	/// Identity if the node doesn't move
+	Transform m_worldTransform = Transform::getIdentity();
+
+	/// The boxes of the spatials that the camera sees
+	Aabb* m_aabbs = nullptr;
+	U32 m_aabbsCount = 0;
+
+	/// @name Frustum. Only if the node has one
+	/// @{
+	Bool8 m_hasFrustum = false;
+	Frustum::Type m_frustumType = Frustum::Type::PERSPECTIVE;
+	F32 m_fovX = 0.0; ///< Perspective
+	F32 m_fovY = 0.0; ///< Perspective
+	F32 m_near = 0.0; ///< Perspective
+	F32 m_far = 0.0; ///< Perspective
+	Obb m_frustumObb; ///< Orthographic
+	/// @}
+};
+
+/// An immutable copy of what the renderer needs to render a frame. It's
+/// built at the end of the update of the frame. After that the next update
+/// can start while the frame renders. Everything it points to lives in the
+/// frame allocator of the frame that the SceneGraph keeps alive until the
+/// next update completes or in the resources. The renderer doesn't access
+/// the nodes
+class RenderSnapshot
+{
+public:
+	/// The global timestamp of the update
+	Timestamp m_timestamp = 0;
+	F32 m_prevUpdateTime = 0.0;
+	F32 m_crntTime = 0.0;
+
+	FrustumSnapshot m_camera;
+	Timestamp m_cameraChangeTimestamp = 0;
+
+	Vec4 m_ambientColor = Vec4(0.0);
+
+	/// The visible lights in the order of m_camera.m_visible->m_lights
+	LightSnapshot* m_lights = nullptr;
+	U32 m_lightsCount = 0;
+
+	/// The nodes that the debug stage draws. Empty if it's disabled
+	DebugNodeSnapshot* m_debugNodes = nullptr;
+	U32 m_debugNodesCount = 0;
+
+	/// The allocator of the frame
+	SceneFrameAllocator<U8> m_frameAlloc;
+
+	/// Copy the state of the scene. Called at the end of the update after the
+	/// visibility tests
+	/// @param debug Copy what the debug stage draws as well.
+	void build(SceneGraph& scene, F32 prevUpdateTime, F32 crntTime,
+		Bool debug);
+
+	/// Find a debug node by name. Return nullptr if it's not there
+	const DebugNodeSnapshot* findDebugNode(CString name) const;
+
+private:
+	/// Copy the state of a frustum and of its visible renderables
+	void buildFrustum(SceneNode& node, FrustumSnapshot& out);
+
+	void buildLight(Light& light, LightSnapshot& out);
+
+	/// Copy the shapes of the nodes that have spatials
+	void buildDebug(SceneGraph& scene);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -26,10 +26,13 @@ public:
 		SPATIAL_COMPONENT,
 		LIGHT_COMPONENT,
 		INSTANCE_COMPONENT,
+		SCRIPT_COMPONENT,
 		RIGID_BODY,
 		LAST_COMPONENT_ID = RIGID_BODY
 	};
 
+	static const U COMPONENT_TYPES_COUNT = LAST_COMPONENT_ID + 1;
+
 	/// The update type
 	enum UpdateType
 	{
@@ -41,9 +44,10 @@ public:
 		ASYNC_UPDATE 
 	};
 
-	/// Construct the scene component. The x is bogus
+	/// Construct the scene component
+	/// @param node The node that will own it
 	SceneComponent(Type type_, SceneNode* node)
-		: type(type_)
+		: m_node(node), type(type_)
 	{}
 
 	Type getType() const
@@ -51,6 +55,23 @@ public:
 		return (Type)type;
 	}
 
+	/// The bit of the type in SceneNode's mask of component types
+	static constexpr U32 getTypeBit(Type type)
+	{
+		return 1U << type;
+	}
+
+	SceneNode& getSceneNode()
+	{
+		ANKI_ASSERT(m_node);
+		return *m_node;
+	}
+	const SceneNode& getSceneNode() const
+	{
+		ANKI_ASSERT(m_node);
+		return *m_node;
+	}
+
 	Timestamp getTimestamp() const
 	{
 		return timestamp;
@@ -85,10 +106,21 @@ public:
 		return *out;
 	}
 
+	/// @privatesection
+	/// @{
+	U32& _getRegistryIndex()
+	{
+		return m_registryIndex;
+	}
+	/// @}
+
 protected:
 	Timestamp timestamp; ///< Indicates when an update happened
 
 private:
+	SceneNode* m_node;
+	/// Its place in the SceneGraph's array of the components of its type
+	U32 m_registryIndex = MAX_U32;
 	U8 type;
 };
 
@@ -9,6 +9,7 @@
 #include "anki/scene/Common.h"
 #include "anki/scene/SceneNode.h"
 #include "anki/scene/Visibility.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/core/Timestamp.h"
 #include "anki/Math.h"
 #include "anki/util/Singleton.h"
@@ -16,6 +17,10 @@
 #include "anki/core/App.h"
 
 #include "anki/scene/Sector.h"
+#include "anki/scene/StaticGeometryPack.h"
+#include "anki/scene/OcclusionBuffer.h"
+#include "anki/resource/ResourceManager.h"
+#include "anki/resource/Material.h"
 #include "anki/physics/PhysicsWorld.h"
 #include "anki/event/EventManager.h"
 
@@ -37,8 +42,11 @@ class SceneGraph
 public:
 	/// @name Constructors/Destructor
 	/// @{
+	/// @param allocatorSize The size of the stack that the nodes and the
+	///        components live in. They are never freed before the scene.
 	SceneGraph(AllocAlignedCallback allocCb, void* allocCbData, 
-		Threadpool* threadpool);
+		Threadpool* threadpool, 
+		PtrSize allocatorSize = ANKI_SCENE_ALLOCATOR_SIZE);
 
 	~SceneGraph();
 	/// @}
@@ -51,10 +59,19 @@ public:
 		return m_alloc;
 	}
 
+	/// The allocator of the frame that updates. It's reset two updates later
+	/// so the rendering of the frame can use it while the next frame updates
 	/// @note Return a copy
 	SceneFrameAllocator<U8> getFrameAllocator() const
 	{
-		return m_frameAlloc;
+		return m_frameAllocs[m_crntFrame];
+	}
+
+	/// For the big buffers that don't fit the scene memory
+	/// @note Return a copy
+	HeapAllocator<U8> getHeapAllocator() const
+	{
+		return m_heapAlloc;
 	}
 
 	Vec4 getAmbientColor() const
@@ -122,6 +139,26 @@ public:
 		return m_sectorGroup;
 	}
 
+	StaticGeometryPack& getStaticGeometryPack()
+	{
+		return m_staticGeometry;
+	}
+	const StaticGeometryPack& getStaticGeometryPack() const
+	{
+		return m_staticGeometry;
+	}
+
+	OcclusionBuffer& getOcclusionBuffer()
+	{
+		return m_occlusion;
+	}
+
+	/// The warmups of the materials of the loaded nodes so far
+	const MaterialWarmupStats& getMaterialWarmupStats() const
+	{
+		return m_warmupStats;
+	}
+
 	Threadpool& _getThreadpool()
 	{
 		return *m_threadpool;
@@ -129,6 +166,14 @@ public:
 
 	void update(F32 prevUpdateTime, F32 crntTime, Renderer& renderer);
 
+	/// What the renderer needs to render the last updated frame. It stays
+	/// valid until the next update completes so the next update can run 
+	/// while the frame renders
+	const RenderSnapshot& getRenderSnapshot() const
+	{
+		return m_snapshots[m_crntFrame];
+	}
+
 	SceneNode& findSceneNode(const char* name);
 	SceneNode* tryFindSceneNode(const char* name);
 
@@ -155,6 +200,37 @@ public:
 		}
 	}
 
+	/// The number of the components of a type in the scene
+	U32 getComponentsCount(SceneComponent::Type type) const
+	{
+		return m_components[type].size();
+	}
+
+	/// Iterate all components of a type. They are packed per type so the 
+	/// systems that update one type go through them without visiting the
+	/// nodes
+	template<typename Component, typename Func>
+	void iterateComponentsOfType(Func func)
+	{
+		for(SceneComponent* comp : m_components[Component::getClassType()])
+		{
+			func(comp->downCast<Component>());
+		}
+	}
+
+	/// Iterate a range of the components of a type. Used to split them to 
+	/// threads
+	template<typename Component, typename Func>
+	void iterateComponentsOfType(PtrSize begin, PtrSize end, Func func)
+	{
+		const auto& comps = m_components[Component::getClassType()];
+		ANKI_ASSERT(begin <= end && end <= comps.size());
+		for(PtrSize i = begin; i < end; i++)
+		{
+			func(comps[i]->template downCast<Component>());
+		}
+	}
+
 	/// Create a new SceneNode
 	template<typename Node, typename... Args>
 	Node* newSceneNode(const char* name, Args&&... args)
@@ -178,7 +254,8 @@ public:
 	}
 	void decreaseObjectsMarkedForDeletion()
 	{
-		++m_objectsMarkedForDeletionCount;
+		ANKI_ASSERT(m_objectsMarkedForDeletionCount.load() > 0);
+		--m_objectsMarkedForDeletionCount;
 	}
 
 	/// @privatesection
@@ -189,6 +266,15 @@ public:
 	}
 
 	GlDevice& _getGlDevice();
+
+	U64 _getNextNodeUuid()
+	{
+		return ++m_nodesUuid;
+	}
+
+	/// Create the program pipelines of a material at the next update. The
+	/// nodes call it when they load so the first frames don't create them
+	void _addMaterialForWarmup(const MaterialResourcePointer& mtl);
 	/// @}
 
 private:
@@ -196,10 +282,24 @@ private:
 	ResourceManager* m_resources = nullptr;
 
 	SceneAllocator<U8> m_alloc;
-	SceneAllocator<U8> m_frameAlloc;
+	HeapAllocator<U8> m_heapAlloc;
+
+	/// @name Frame data
+	/// Double buffered. One for the frame that updates and one for the frame
+	/// that renders
+	/// @{
+	Array<SceneAllocator<U8>, 2> m_frameAllocs;
+	Array<RenderSnapshot, 2> m_snapshots;
+	U8 m_crntFrame = 0;
+	/// @}
 
 	SceneVector<SceneNode*> m_nodes;
 	SceneDictionary<SceneNode*> m_dict;
+	U64 m_nodesUuid = 0;
+
+	/// The nodes that are out of the scene but the frame that renders may 
+	/// still use them. They are deleted at the next update
+	SceneVector<SceneNode*> m_nodesPendingDeletion;
 
 	Vec3 m_ambientCol = Vec3(1.0); ///< The global ambient color
 	Timestamp m_ambiendColorUpdateTimestamp = getGlobTimestamp();
@@ -210,15 +310,37 @@ private:
 
 	SectorGroup m_sectorGroup;
 
+	StaticGeometryPack m_staticGeometry;
+
+	OcclusionBuffer m_occlusion;
+
+	/// The materials of the nodes that loaded since the last update
+	Vector<MaterialResourcePointer> m_warmupMaterials;
+	MaterialWarmupStats m_warmupStats;
+
 	EventManager m_events;
 
 	AtomicU32 m_objectsMarkedForDeletionCount;
 
+	/// All the components per type
+	Array<SceneVector<SceneComponent*>, SceneComponent::COMPONENT_TYPES_COUNT>
+		m_components;
+	/// The nodes may add components in the async updates
+	SpinLock m_componentsLock;
+
 	/// Put a node in the appropriate containers
 	void registerNode(SceneNode* node);
 	void unregisterNode(SceneNode* node);
 
-	/// Delete the nodes that are marked for deletion
+	/// Warm up the pending materials
+	void warmupMaterials();
+
+	/// Put a component to the array of its type
+	void registerComponent(SceneComponent* comp);
+	void unregisterComponent(SceneComponent* comp);
+
+	/// Delete the nodes that were taken out of the scene at the previous 
+	/// update and take out the nodes that are marked for deletion
 	void deleteNodesMarkedForDeletion();
 };
 
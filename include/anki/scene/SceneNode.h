@@ -9,6 +9,7 @@
 #include "anki/scene/Common.h"
 #include "anki/scene/SceneObject.h"
 #include "anki/scene/SceneComponent.h"
+#include "anki/util/Array.h"
 
 namespace anki {
 
@@ -47,6 +48,13 @@ public:
 		return (!m_name.isEmpty()) ? m_name.toCString() : CString();
 	}
 
+	/// A unique ID. Unlike the address it's never reused by another node.
+	/// The renderer uses it to identify the nodes of the snapshots
+	U64 getUuid() const
+	{
+		return m_uuid;
+	}
+
 	/// This is called by the scene every frame after logic and before
 	/// rendering. By default it does nothing
 	/// @param prevUpdateTime Timestamp of the previous update
@@ -96,6 +104,11 @@ public:
 	void iterateComponentsOfType(Func func)
 	{
 		SceneComponent::Type type = Component::getClassType();
+		if(!hasComponent<Component>())
+		{
+			return;
+		}
+
 		for(auto comp : m_components)
 		{
 			if(comp->getType() == type)
@@ -105,34 +118,28 @@ public:
 		}
 	}
 
+	/// Check the mask of the component types
+	template<typename Component>
+	Bool hasComponent() const
+	{
+		return (m_componentTypesMask 
+			& SceneComponent::getTypeBit(Component::getClassType())) != 0;
+	}
+
 	/// Try geting a pointer to the first component of the requested type
 	template<typename Component>
 	Component* tryGetComponent()
 	{
-		SceneComponent::Type type = Component::getClassType();
-		for(auto comp : m_components)
-		{
-			if(comp->getType() == type)
-			{
-				return &comp->downCast<Component>();
-			}
-		}
-		return nullptr;
+		SceneComponent* comp = m_firstComponents[Component::getClassType()];
+		return (comp) ? &comp->downCast<Component>() : nullptr;
 	}
 
 	/// Try geting a pointer to the first component of the requested type
 	template<typename Component>
 	const Component* tryGetComponent() const
 	{
-		SceneComponent::Type type = Component::getClassType();
-		for(auto comp : m_components)
-		{
-			if(comp->getType() == type)
-			{
-				return &comp->downCast<Component>();
-			}
-		}
-		return nullptr;
+		SceneComponent* comp = m_firstComponents[Component::getClassType()];
+		return (comp) ? &comp->downCast<Component>() : nullptr;
 	}
 
 	/// Get a pointer to the first component of the requested type
@@ -169,7 +176,15 @@ protected:
 
 private:
 	SceneString m_name; ///< A unique name
+	U64 m_uuid;
 	SceneVector<SceneComponent*> m_components;
+
+	/// @name Lookup
+	/// @{
+	U32 m_componentTypesMask = 0;
+	Array<SceneComponent*, SceneComponent::COMPONENT_TYPES_COUNT> 
+		m_firstComponents = {{}};
+	/// @}
 };
 
 /// @}
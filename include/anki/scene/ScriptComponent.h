@@ -0,0 +1,52 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_SCENE_SCRIPT_COMPONENT_H
+#define ANKI_SCENE_SCRIPT_COMPONENT_H
+
+#include "anki/scene/Common.h"
+#include "anki/scene/SceneComponent.h"
+#include "anki/scene/SceneNode.h"
+
+namespace anki {
+
+/// @addtogroup Scene
+/// @{
+
+/// A node with this component runs a script function every frame. The 
+/// ScriptManager calls the function with the node, the previous and the 
+/// current time. The calls of many nodes run in parallel so the function 
+/// should not touch other nodes
+class ScriptComponent: public SceneComponent
+{
+public:
+	/// @param node The node
+	/// @param function The name of a global function of the script states
+	ScriptComponent(SceneNode* node, const CString& function)
+	:	SceneComponent(SCRIPT_COMPONENT, node),
+		m_function(node->getSceneAllocator())
+	{
+		m_function = function;
+	}
+
+	CString getFunction() const
+	{
+		return m_function.toCString();
+	}
+
+	static constexpr Type getClassType()
+	{
+		return SCRIPT_COMPONENT;
+	}
+
+private:
+	SceneString m_function;
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -9,15 +9,16 @@
 #include "anki/scene/Common.h"
 #include "anki/scene/Visibility.h"
 #include "anki/Collision.h"
+#include "anki/util/Vector.h"
 
 namespace anki {
 
 // Forward
 class SceneNode;
 class SceneGraph;
+class SpatialComponent;
 class Sector;
 class SectorGroup;
-class Renderer;
 
 /// @addtogroup Scene
 /// @{
@@ -32,7 +33,18 @@ struct Portal
 	Portal();
 };
 
-/// A sector. It consists of an octree and some portals
+/// A node that the portals reach
+class PortalVisibleNode
+{
+public:
+	SceneNode* m_node;
+	/// The part of the screen that the portals show it through. It's in
+	/// NDC. The xy is the min and the zw the max
+	Vec4 m_rect;
+};
+
+/// A sector. It's a box with the spatials that overlap it and the portals to
+/// the other sectors
 class Sector
 {
 	friend class SectorGroup;
@@ -42,7 +54,8 @@ public:
 	static const U AVERAGE_PORTALS_PER_SECTOR = 3;
 
 	/// Default constructor
-	Sector(SectorGroup* group, const Aabb& box);
+	/// @param index The index of the sector in its group.
+	Sector(SectorGroup* group, const Aabb& box, U32 index);
 
 	const Aabb& getAabb() const
 	{
@@ -63,12 +76,23 @@ public:
 		return visibleBy;
 	}
 
-	/// Called when a node was moved or a change in shape happened
-	Bool placeSceneNode(SceneNode* sp);
+	const SceneVector<Portal*>& getPortals() const
+	{
+		return portals;
+	}
+
+	/// The spatials that overlap the sector
+	const Vector<SpatialComponent*>& getSpatials() const
+	{
+		return spatials;
+	}
 
 private:
 	SectorGroup* group; ///< Know your father
 	SceneVector<Portal*> portals;
+	/// The spatials move so they are not kept in the scene allocator
+	Vector<SpatialComponent*> spatials;
+	U32 index;
 	U8 visibleBy;
 	Aabb aabb;
 
@@ -109,14 +133,13 @@ public:
 	{
 		return sectors;
 	}
-	/// @}
-
-	/// Called when a node was moved or a change in shape happened. The node 
-	/// must be Spatial
-	void placeSceneNode(SceneNode* sp);
 
-	/// XXX
-	void doVisibilityTests(SceneNode& fr, VisibilityTest test, Renderer* r);
+	/// The spatials that are outside all the sectors
+	const Vector<SpatialComponent*>& getOutsideSpatials() const
+	{
+		return outsideSpatials;
+	}
+	/// @}
 
 	/// The owner of the pointer is the sector group
 	Sector* createNewSector(const Aabb& aabb);
@@ -124,14 +147,51 @@ public:
 	/// The owner of the pointer is the sector group
 	Portal* createNewPortal(Sector* a, Sector* b, const Obb& collisionShape);
 
+	/// Place the spatials that moved in the sectors that they overlap. Call
+	/// it after the spatials update
+	void update();
+
+	/// Remove a spatial from its sectors. The spatial calls it when it dies
+	void removeSpatial(SpatialComponent& sp);
+
+	/// Walk the open portals starting from the sector of the frustum origin.
+	/// Every portal that the frustum sees shrinks the screen rect that the
+	/// next sector is seen through. Gather the nodes of the reached sectors
+	/// and the nodes outside all sectors. Every node comes once
+	/// @param visibleBy The reached sectors are marked with it. The threads
+	///        pass VB_NONE and then the sectors are not written so many
+	///        threads may call it at the same time.
+	/// @param[out] nodes The nodes sorted by their address.
+	/// @return False if the origin is outside all the sectors. Then all the
+	///         nodes should be tested.
+	Bool findVisibleNodes(Frustum& frustum, const Mat4& viewProjMat,
+		VisibleBy visibleBy, SceneFrameVector<PortalVisibleNode>& nodes);
+
 private:
 	SceneGraph* scene; ///< Keep it here to access various allocators
 	SceneVector<Sector*> sectors;
 	SceneVector<Portal*> portals;
+	Vector<SpatialComponent*> outsideSpatials;
+
+	/// Place a spatial in the sectors that overlap its AABB
+	void placeSpatial(SpatialComponent& sp);
 
-	void doVisibilityTestsInternal(SceneNode& fr, VisibilityTest test,
-		Renderer* r, VisibleBy visibleBy);
+	/// Find the smallest sector that has the point
+	Sector* findSector(const Vec4& point);
 };
+
+/// Project some points and get the NDC rect that bounds them. The xy is the
+/// min and the zw the max
+/// @return False if a point is behind the eye. Then the rect is garbage.
+Bool projectToRect(const Vec4* points, U count, const Mat4& viewProjMat,
+	Vec4& rect);
+
+/// Is a box in the part of the screen that the portals show it through?
+/// The boxes that reach behind the eye are always in
+/// @param rect See PortalVisibleNode::m_rect.
+Bool insidePortalRect(const Aabb& box, const Mat4& viewProjMat,
+	const Vec4& rect);
+
 /// @}
 
 } // end namespace anki
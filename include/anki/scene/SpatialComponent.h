@@ -10,9 +10,13 @@
 #include "anki/scene/SceneComponent.h"
 #include "anki/Collision.h"
 #include "anki/util/Bitset.h"
+#include "anki/util/Vector.h"
 
 namespace anki {
 
+// Forward
+class Sector;
+
 /// @addtogroup Scene
 /// @{
 
@@ -37,7 +41,13 @@ public:
 		/// near plane when using the tiler for visibility tests.
 		SF_FULLY_TRANSPARENT = 1 << 3,
 
-		SF_MARKED_FOR_UPDATE = 1 << 4
+		SF_MARKED_FOR_UPDATE = 1 << 4,
+
+		/// The AABB changed so the sector group has to place it again
+		SF_MARKED_FOR_PLACEMENT = 1 << 5,
+
+		/// It's placed outside all the sectors
+		SF_OUTSIDE_SECTORS = 1 << 6
 	};
 
 	/// Pass the collision shape here so we can avoid the virtuals
@@ -45,7 +55,7 @@ public:
 	/// @param flags A mask of SpatialFlag
 	SpatialComponent(SceneNode* node, U32 flags = SF_NONE);
 
-	// Remove from current OctreeNode
+	/// Remove it from its sectors
 	~SpatialComponent();
 
 	/// @name Accessors
@@ -74,6 +84,12 @@ public:
 	/// Used for sorting spatials. In most object the origin is the center of
 	/// mess but for cameras the origin is the eye point
 	virtual Vec4 getSpatialOrigin() = 0;
+
+	/// The sectors that it overlaps
+	const Vector<Sector*>& getSectors() const
+	{
+		return sectors;
+	}
 	/// @}
 
 	/// The derived class has to manually call this method when the collision 
@@ -97,7 +113,10 @@ public:
 	}
 
 private:
+	friend class SectorGroup;
+
 	Aabb aabb; ///< A faster shape
+	Vector<Sector*> sectors;
 };
 /// @}
 
@@ -10,6 +10,7 @@
 #include "anki/scene/SceneNode.h"
 #include "anki/scene/SpatialComponent.h"
 #include "anki/scene/RenderComponent.h"
+#include "anki/scene/StaticGeometryPack.h"
 
 namespace anki {
 
@@ -40,6 +41,8 @@ private:
 class StaticGeometryPatchNode: public SceneNode, public SpatialComponent,
 	public RenderComponent
 {
+	friend class StaticGeometryPack;
+
 public:
 	/// @name Constructors/Destructor
 	/// @{
@@ -66,19 +69,66 @@ public:
 	/// @name RenderComponent virtuals
 	/// @{
 
-	/// Implements RenderComponent::buildRendering
-	void buildRendering(RenderingBuildData& data);
+	/// Implements RenderComponent::getBuildRenderingCallback
+	BuildRenderingCallback getBuildRenderingCallback() override
+	{
+		return &buildRendering;
+	}
+
+	/// Overrides RenderComponent::snapshotRenderState
+	const void* snapshotRenderState(SceneFrameAllocator<U8>& alloc) override;
 
 	/// Implements  RenderComponent::getMaterial
 	const Material& getMaterial()
 	{
 		return m_modelPatch->getMaterial();
 	}
+
+	/// Overrides RenderComponent::getLodsCount
+	U getLodsCount() override
+	{
+		return m_modelPatch->getLodsCount();
+	}
+
+	/// Overrides RenderComponent::getLodError. The static geometry is in 
+	/// world space already so there is no scale to apply
+	F32 getLodError(U lod) override
+	{
+		return m_modelPatch->getLodError(lod);
+	}
+
+	/// Overrides RenderComponent::getClusters
+	const MeshCluster* getClusters(U lod, U32& count) override;
+
+	/// Overrides RenderComponent::getOccluder
+	const OccluderMesh* getOccluder() override
+	{
+		return m_modelPatch->getOccluder();
+	}
+
+	/// Overrides RenderComponent::getMeshId
+	U64 getMeshId() override
+	{
+		return (U64)(PtrSize)m_modelPatch;
+	}
 	/// @}
 
 private:
 	const ModelPatchBase* m_modelPatch;
 	const Obb* m_obb; 
+	/// Set by the StaticGeometryPack. Null before it's packed
+	const StaticGeometryPack::Patch* m_packed = nullptr;
+
+	/// What buildRendering needs. It's in the frame memory
+	class RenderState
+	{
+	public:
+		const ModelPatchBase* m_modelPatch = nullptr; ///< The resource
+		/// Where the patch is in the buffers of the StaticGeometryPack
+		const StaticGeometryPack::Patch* m_packed = nullptr;
+	};
+
+	static void buildRendering(RenderingBuildData& data);
 };
 
 /// Static geometry scene node
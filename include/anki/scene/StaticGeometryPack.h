@@ -0,0 +1,195 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#ifndef ANKI_SCENE_STATIC_GEOMETRY_PACK_H
+#define ANKI_SCENE_STATIC_GEOMETRY_PACK_H
+
+#include "anki/scene/Common.h"
+#include "anki/collision/Obb.h"
+#include "anki/Gl.h"
+#include "anki/util/Vector.h"
+#include "anki/util/NonCopyable.h"
+
+namespace anki {
+
+// Forward
+class StaticGeometryPatchNode;
+
+/// @addtogroup scene
+/// @{
+
+/// Packs the meshes of the static geometry to a few big vertex and index
+/// buffers. The meshes with the same vertex layout share the buffers and
+/// the patches draw from them with base vertices. So the consecutive static
+/// patches that use the same program share the vertex descriptor and they
+/// don't rebind anything.
+///
+/// The meshes are copied so the other users of the mesh resources are not
+/// affected
+class StaticGeometryPack: public NonCopyable
+{
+public:
+	/// A mesh that is bigger gets a vertex buffer of its own
+	static const PtrSize MAX_BUFFER_SIZE = 32 * 1024 * 1024;
+
+	/// The layout and the size of a mesh to pack
+	class MeshInfo
+	{
+	public:
+		U32 m_layout; ///< The meshes with the same layout share buffers
+		U32 m_vertexSize;
+		U32 m_verticesCount;
+		U32 m_indicesCount;
+	};
+
+	/// Where a mesh is in the buffers. The draws add them to the indices
+	/// of the mesh
+	class MeshRange
+	{
+	public:
+		U32 m_buffer; ///< The index of the vertex and index buffers
+		U32 m_baseVertex;
+		U32 m_firstIndex;
+	};
+
+	/// The contents of a vertex and an index buffer
+	class BufferInfo
+	{
+	public:
+		U32 m_layout;
+		U32 m_vertexSize;
+		U32 m_verticesCount;
+		U32 m_indicesCount;
+	};
+
+	/// The same as the arguments of glDrawElementsIndirect
+	class DrawCommand
+	{
+	public:
+		U32 m_count;
+		U32 m_instanceCount;
+		U32 m_firstIndex;
+		U32 m_baseVertex;
+		U32 m_baseInstance;
+	};
+
+	/// A piece of the LOD 0 of a patch that can be culled and drawn alone.
+	/// It's a sub mesh or the whole mesh
+	class Cluster
+	{
+	public:
+		DrawCommand m_draw;
+		U32 m_buffer;
+		Obb m_bounds;
+		const StaticGeometryPatchNode* m_node;
+	};
+
+	/// A part of the buffers that holds a mesh. The patches that were packed
+	/// together share the blocks of the same meshes
+	class Block
+	{
+	public:
+		MeshRange m_range;
+		U32 m_verticesCount;
+		U32 m_indicesCount;
+		U32 m_users; ///< The patches that draw from it
+	};
+
+	/// What a patch needs to draw from the shared buffers
+	class Patch
+	{
+	public:
+		/// The vertex descriptors. See ModelPatchBase::getVertexDescIdx
+		Vector<GlCommandBufferHandle> m_vertJobs;
+		Vector<MeshRange> m_ranges; ///< One for every mesh LOD
+		Vector<Block*> m_blocks; ///< The blocks of m_ranges, once each
+
+		Patch(HeapAllocator<U8>& alloc)
+		:	m_vertJobs(alloc),
+			m_ranges(alloc),
+			m_blocks(alloc)
+		{}
+	};
+
+	StaticGeometryPack(HeapAllocator<U8>& alloc);
+
+	~StaticGeometryPack();
+
+	/// @name Accessors
+	/// @{
+	U32 getBuffersCount() const
+	{
+		return m_vertBuffs.size();
+	}
+
+	const GlBufferHandle& getVertexBuffer(U i) const
+	{
+		return m_vertBuffs[i];
+	}
+
+	const GlBufferHandle& getIndexBuffer(U i) const
+	{
+		return m_indicesBuffs[i];
+	}
+
+	/// The clusters of the packed patches. The clusters of a buffer are
+	/// consecutive
+	const Vector<Cluster>& getClusters() const
+	{
+		return m_clusters;
+	}
+
+	Bool hasPendingPatches() const
+	{
+		return m_pending.size() > 0;
+	}
+	/// @}
+
+	/// Called by the patch when it's created
+	void addPatch(StaticGeometryPatchNode* node);
+
+	/// Called by the patch when it's deleted. That happens after the last
+	/// frame that drew it. The blocks that no other patch uses become holes
+	/// and a buffer is released when all of it is holes
+	void removePatch(StaticGeometryPatchNode* node);
+
+	/// Copy the meshes of the patches that were added since the last build
+	/// to the holes of the buffers or to new buffers. The patches draw from
+	/// them after that. It waits for the copies to finish
+	void build(GlDevice& gl);
+
+	/// Decide where the meshes go. The meshes of the same layout are put
+	/// one after the other until the vertex buffer gets bigger than
+	/// maxBufferSize
+	/// @param[out] buffers The buffers to create.
+	/// @param[out] ranges One for every mesh.
+	static void plan(const MeshInfo* meshes, U meshesCount,
+		PtrSize maxBufferSize, Vector<BufferInfo>& buffers,
+		MeshRange* ranges);
+
+private:
+	HeapAllocator<U8> m_alloc;
+	Vector<GlBufferHandle> m_vertBuffs;
+	Vector<GlBufferHandle> m_indicesBuffs;
+	Vector<BufferInfo> m_buffers; ///< What every buffer was created for
+	Vector<U32> m_bufferBlocks; ///< The used blocks of every buffer
+	Vector<Block> m_freeBlocks; ///< The holes that new meshes may fill
+	Vector<Patch*> m_patches; ///< The packed
+	Vector<StaticGeometryPatchNode*> m_pending; ///< Not packed yet
+	Vector<Cluster> m_clusters;
+
+	/// Delete a patch and drop its blocks
+	void deletePatch(Patch* patch);
+
+	/// Put a mesh in a hole of the buffers of its layout. First fit
+	/// @return False if no hole is big enough
+	Bool takeFreeBlock(const MeshInfo& mesh, MeshRange& range);
+};
+
+/// @}
+
+} // end namespace anki
+
+#endif
@@ -45,10 +45,36 @@ public:
 	SceneNode* m_node;
 	/// An array of the visible spatials
 	U8* m_spatialIndices;
+	/// The distances of the visible spatials from the origin of the
+	/// frustum. Only the blended renderables with many spatials have them
+	/// so they can be sorted per spatial
+	F32* m_spatialDistances;
 	U8 m_spatialsCount;
 
+	/// @name Render snapshot
+	/// Set at the end of the update. The renderer uses them instead of the
+	/// node because the node may change or die while the frame renders
+	/// @{
+
+	/// The render world transforms of the visible spatials. Null if the 
+	/// renderable doesn't have world transforms
+	Transform* m_transforms;
+	/// Distance from the origin of the frustum
+	F32 m_distance;
+	/// The LOD. The fraction is how close the next LOD is. See selectLods
+	F32 m_lod;
+	/// See RenderComponent::snapshot
+	const RenderableSnapshot* m_renderable;
+	/// @}
+
+	/// The clusters that the frustum sees. See cullVisibleClusters
+	const VisibleClusters* m_clusters;
+
 	VisibleNode()
-		: m_node(nullptr), m_spatialIndices(nullptr), m_spatialsCount(0)
+		: m_node(nullptr), m_spatialIndices(nullptr),
+		m_spatialDistances(nullptr), m_spatialsCount(0),
+		m_transforms(nullptr), m_distance(0.0), m_lod(0.0),
+		m_renderable(nullptr), m_clusters(nullptr)
 	{}
 
 	VisibleNode(VisibleNode&& other)
@@ -60,11 +86,21 @@ public:
 	{
 		m_node = other.m_node;
 		m_spatialIndices = other.m_spatialIndices;
+		m_spatialDistances = other.m_spatialDistances;
 		m_spatialsCount = other.m_spatialsCount;
+		m_transforms = other.m_transforms;
+		m_distance = other.m_distance;
+		m_lod = other.m_lod;
+		m_renderable = other.m_renderable;
+		m_clusters = other.m_clusters;
 
 		other.m_node = nullptr;
 		other.m_spatialIndices = nullptr;
+		other.m_spatialDistances = nullptr;
 		other.m_spatialsCount = 0;
+		other.m_transforms = nullptr;
+		other.m_renderable = nullptr;
+		other.m_clusters = nullptr;
 
 		return *this;
 	}
@@ -158,10 +194,62 @@ public:
 	}
 };
 
-/// Do visibility tests bypassing portals 
+/// Do visibility tests. If the frustumable is in a sector only the nodes that
+/// the portals show are tested. The shadow casting lights do the same
 void doVisibilityTests(SceneNode& frustumable, SceneGraph& scene, 
 	Renderer& renderer);
 
+/// Rasterize the occluders that the frustumable sees on the CPU and cull the
+/// visible renderables and lights that they hide. The occluders themselves
+/// stay. In parallel. Call it after the visibility tests
+void cullOccludedNodes(SceneNode& frustumable, SceneGraph& scene);
+
+/// The transparency sort of the frame. Sort the primitives of the visible
+/// renderables that blend back to front. Call it after the visibility tests
+void sortBlendedPrimitives(SceneNode& frustumable, SceneGraph& scene);
+
+/// Ask the streamed textures of the visible renderables for the mips that
+/// cover their size on the screen. Call it after the visibility tests
+void requestVisibleTextures(SceneNode& frustumable, Renderer& renderer);
+
+/// The max LODs that selectLods gives
+const U MAX_LODS = 8;
+
+/// Select the coarsest LOD whose error on the screen is small enough. A LOD
+/// is picked when its error is less than maxPixelError * (1 - hysteresis)
+/// and it's kept until its error is more than maxPixelError * 
+/// (1 + hysteresis) so the LODs don't pop back and forth
+/// @param lodErrors The geometric errors of the LODs. The first is zero.
+/// @param lodsCount The number of lodErrors.
+/// @param pixelsPerUnit The pixels that a unit of error covers.
+/// @param prevLod The LOD of the previous frame.
+/// @return The LOD. The fraction goes from zero to one as the next LOD
+///         comes closer.
+F32 selectLod(const F32* lodErrors, U lodsCount, F32 pixelsPerUnit, 
+	F32 maxPixelError, F32 hysteresis, U prevLod);
+
+/// Select the LODs of the visible renderables of the frustumable and the
+/// lights that it sees from their screen space error. Call it after the
+/// visibility tests
+void selectLods(SceneNode& frustumable, Renderer& renderer);
+
+/// When the visible clusters of a renderable are scattered their ranges are
+/// joined so it's not drawn with more draw calls than that
+const U MAX_CLUSTER_RANGES = 16;
+
+/// Get the ranges of the index buffer that have the visible clusters. The
+/// consecutive clusters make one range. If they are more than maxRanges the
+/// ranges that have the fewest culled clusters between them are joined
+/// @param visible The indices of the visible clusters in order.
+/// @param[out] ranges It should have room for visibleCount.
+/// @return The number of the ranges.
+U32 getClusterRanges(const MeshCluster* clusters, const U32* visible,
+	U32 visibleCount, U32 maxRanges, IndexRange* ranges);
+
+/// Cull the clusters of the visible renderables of the frustumable and the
+/// lights that it sees. In parallel. Call it after selectLods
+void cullVisibleClusters(SceneNode& frustumable, SceneGraph& scene);
+
 /// @}
 
 } // end namespace anki
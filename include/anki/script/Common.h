@@ -15,10 +15,10 @@
 #define ANKI_SCRIPT_WRAP(x) \
 	void ankiScriptWrap##x(LuaBinder& lb)
 
-/// XXX
-#define ANKI_SCRIPT_CALL_WRAP(x) \
+/// Call the wrapper of a class for a LuaBinder
+#define ANKI_SCRIPT_CALL_WRAP(luaBinder_, x) \
 	extern void ankiScriptWrap##x(LuaBinder&); \
-	ankiScriptWrap##x(*this);
+	ankiScriptWrap##x(luaBinder_);
 
 /// XXX
 #define ANKI_SCRIPT_WRAP_SINGLETON(x) \
@@ -9,11 +9,15 @@
 #include "anki/util/Assert.h"
 #include "anki/util/StdTypes.h"
 #include "anki/util/Allocator.h"
+#include "anki/util/Array.h"
+#include "anki/util/Functions.h"
 #include <lua.hpp>
 #ifndef ANKI_LUA_HPP
 #	error "Wrong LUA header included"
 #endif
 #include <functional>
+#include <cstring>
+#include <type_traits>
 
 namespace anki {
 
@@ -44,7 +48,7 @@ public:
 	template<typename T>
 	using Allocator = HeapAllocator<T>;
 
-	LuaBinder(Allocator<U8>& alloc);
+	LuaBinder(const Allocator<U8>& alloc);
 	~LuaBinder();
 
 	/// @name Accessors
@@ -73,11 +77,48 @@ public:
 	static void stackDump(lua_State* l);
 
 private:
+	/// @name Pooled allocation
+	/// Lua allocates and frees lots of small objects. They are kept in free
+	/// lists of a few size classes that are carved out of big chunks. The 
+	/// state is used by one thread at a time so there is no locking
+	/// @{
+	static const U SIZE_CLASSES_COUNT = 8;
+	static const PtrSize MAX_SMALL_SIZE = 256;
+	static const PtrSize CHUNK_SIZE = 16 * 1024;
+
+	/// A free block of a size class
+	class FreeBlock
+	{
+	public:
+		FreeBlock* m_next;
+	};
+
+	/// The header of a chunk
+	class Chunk
+	{
+	public:
+		Chunk* m_next;
+	};
+
+	Array<FreeBlock*, SIZE_CLASSES_COUNT> m_freeBlocks = {{}};
+	Chunk* m_chunks = nullptr;
+	U8* m_chunkPos = nullptr; ///< The unused part of the newest chunk
+	U8* m_chunkEnd = nullptr;
+	/// @}
+
 	Allocator<U8> m_alloc;
 	lua_State* m_l = nullptr;
 
 	static void* luaAllocCallback(
 		void* userData, void* ptr, PtrSize osize, PtrSize nsize);
+
+	/// Get the size class of a small size
+	static U getSizeClass(PtrSize size);
+
+	/// @return Null if out of memory
+	void* allocate(PtrSize size);
+
+	void free(void* ptr, PtrSize size);
 };
 
 /// Internal lua stuff
@@ -101,7 +142,9 @@ struct ClassProxy
 
 	static void setName(const char* name)
 	{
-		ANKI_ASSERT(NAME == nullptr && "Class already wrapped elsewhere");
+		// Many states may wrap the same class
+		ANKI_ASSERT((NAME == nullptr || std::strcmp(NAME, name) == 0)
+			&& "Class already wrapped elsewhere with another name");
 		NAME = name;
 	}
 
@@ -110,18 +153,45 @@ struct ClassProxy
 		ANKI_ASSERT(NAME != nullptr && "Class not wrapped");
 		return NAME;
 	}
+
+	/// The key of the metatable of the class in the registry. It's faster
+	/// to look up than the name
+	static const void* getKey()
+	{
+		return &NAME;
+	}
 };
 
 template<typename Class>
 const char* ClassProxy<Class>::NAME = nullptr;
 
 //==============================================================================
+/// The objects of small classes that don't need a destructor are stored 
+/// inside the lua userdata. They cost a single lua allocation and no 
+/// finalizer
+template<typename Class>
+struct InlineStorage
+{
+	static const Bool VALUE = std::is_trivially_destructible<Class>::value
+		&& sizeof(Class) <= 128;
+};
+
+//==============================================================================
+
+/// Make sure that the arguments match the argsCount number
+void checkArgsCountFailed(lua_State* l, I argsCount);
 
 /// Make sure that the arguments match the argsCount number
-void checkArgsCount(lua_State* l, I argsCount);
+inline void checkArgsCount(lua_State* l, I argsCount)
+{
+	if(ANKI_UNLIKELY(lua_gettop(l) != argsCount))
+	{
+		checkArgsCountFailed(l, argsCount);
+	}
+}
 
 /// Create a new LUA class
-void createClass(lua_State* l, const char* className);
+void createClass(lua_State* l, const char* className, const void* key);
 
 /// Add new function in a class that it's already in the stack
 void pushCFunctionMethod(lua_State* l, const char* name,
@@ -131,23 +201,108 @@ void pushCFunctionMethod(lua_State* l, const char* name,
 void pushCFunctionStatic(lua_State* l, const char* className,
 	const char* name, lua_CFunction luafunc);
 
-//==============================================================================
-/// Used mainly to push a method's return value to the stack
-template<typename Class, BinderFlag flags>
-struct PushStack
+/// Set the metatable of Class to the object at the top of the stack
+template<typename Class>
+inline void setMetatable(lua_State* l)
 {
-	void operator()(lua_State* l, Class& x)
+	lua_rawgetp(l, LUA_REGISTRYINDEX, ClassProxy<Class>::getKey());
+	ANKI_ASSERT(lua_istable(l, -1) && "Class not wrapped");
+	lua_setmetatable(l, -2);
+}
+
+/// Get the userdata of a Class object from the stack or raise a lua error
+template<typename Class>
+inline UserData* checkUserData(lua_State* l, I stackIndex)
+{
+	UserData* d = (UserData*)lua_touserdata(l, stackIndex);
+	if(d && lua_getmetatable(l, stackIndex))
+	{
+		lua_rawgetp(l, LUA_REGISTRYINDEX, ClassProxy<Class>::getKey());
+		Bool same = lua_rawequal(l, -1, -2);
+		lua_pop(l, 2);
+
+		if(same)
+		{
+			return d;
+		}
+	}
+
+	luaL_error(l, "Expecting %s at argument %d", ClassProxy<Class>::getName(),
+		stackIndex);
+	return nullptr;
+}
+
+/// Push a new userdata for an object of Class. If the class has inline 
+/// storage the object will be placed right after the UserData
+template<typename Class>
+inline UserData* pushUserData(lua_State* l)
+{
+	UserData* d;
+
+	if(InlineStorage<Class>::VALUE)
+	{
+		d = (UserData*)lua_newuserdata(l, 
+			sizeof(UserData) + sizeof(Class) + alignof(Class) - 1);
+
+		PtrSize storage = reinterpret_cast<PtrSize>(d + 1);
+		alignRoundUp(alignof(Class), storage);
+		d->m_ptr = reinterpret_cast<void*>(storage);
+	}
+	else
 	{
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
+		d = (UserData*)lua_newuserdata(l, sizeof(UserData));
+		d->m_ptr = nullptr;
+	}
 
+	d->m_gc = false;
+	setMetatable<Class>(l);
+	return d;
+}
+
+/// Construct the object of a userdata that pushUserData created. The 
+/// arguments are already evaluated so a lua error will not leak the object
+template<typename Class, typename... Args>
+inline void constructObject(lua_State* l, UserData* d, Args&&... args)
+{
+	if(InlineStorage<Class>::VALUE)
+	{
+		::new(d->m_ptr) Class(std::forward<Args>(args)...);
+	}
+	else
+	{
 		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
 		ANKI_ASSERT(binder);
 		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
 
-		d->m_ptr = alloc.template newInstance<Class>(x);
+		d->m_ptr = alloc.template newInstance<Class>(
+			std::forward<Args>(args)...);
 		d->m_gc = true;
 	}
+}
+
+/// Push a userdata that points to an object that lives elsewhere
+template<typename Class, BinderFlag flags>
+inline void pushReference(lua_State* l, Class* x)
+{
+	UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
+	setMetatable<Class>(l);
+	d->m_ptr = x;
+	d->m_gc = (flags & BinderFlag::TRANFER_OWNERSHIP) != BinderFlag::NONE;
+
+	// Classes with inline storage have no finalizer
+	ANKI_ASSERT(!(d->m_gc && InlineStorage<Class>::VALUE));
+}
+
+//==============================================================================
+/// Used mainly to push a method's return value to the stack
+template<typename Class, BinderFlag flags>
+struct PushStack
+{
+	void operator()(lua_State* l, Class& x)
+	{
+		UserData* d = pushUserData<Class>(l);
+		constructObject<Class>(l, d, x);
+	}
 };
 
 // Specialization ref
@@ -156,10 +311,7 @@ struct PushStack<Class&, flags>
 {
 	void operator()(lua_State* l, Class& x)
 	{
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
-		d->m_ptr = &x;
-		d->m_gc = (flags & BinderFlag::TRANFER_OWNERSHIP) != BinderFlag::NONE;
+		pushReference<Class, flags>(l, &x);
 	}
 };
 
@@ -169,10 +321,7 @@ struct PushStack<const Class&, flags>
 {
 	void operator()(lua_State* l, const Class& x)
 	{
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
-		d->m_ptr = &const_cast<Class&>(x);
-		d->m_gc = (flags & BinderFlag::TRANFER_OWNERSHIP) != BinderFlag::NONE;
+		pushReference<Class, flags>(l, &const_cast<Class&>(x));
 	}
 };
 
@@ -182,10 +331,7 @@ struct PushStack<Class*, flags>
 {
 	void operator()(lua_State* l, Class* x)
 	{
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
-		d->m_ptr = x;
-		d->m_gc = (flags & BinderFlag::TRANFER_OWNERSHIP) != BinderFlag::NONE;
+		pushReference<Class, flags>(l, x);
 	}
 };
 
@@ -195,10 +341,7 @@ struct PushStack<const Class*, flags>
 {
 	void operator()(lua_State* l, Class* x)
 	{
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
-		d->m_ptr = const_cast<Class*>(x);
-		d->m_gc = (flags & BinderFlag::TRANFER_OWNERSHIP) != BinderFlag::NONE;
+		pushReference<Class, flags>(l, const_cast<Class*>(x));
 	}
 };
 
@@ -241,8 +384,7 @@ struct StackGet
 {
 	Class operator()(lua_State* l)
 	{
-		UserData* udata = (UserData*)luaL_checkudata(l, stackIndex, 
-			ClassProxy<Class>::getName());
+		UserData* udata = checkUserData<Class>(l, stackIndex);
 
 		const Class* a = reinterpret_cast<const Class*>(udata->m_ptr);
 		return Class(*a);
@@ -255,8 +397,7 @@ struct StackGet<const Class&, stackIndex>
 {
 	const Class& operator()(lua_State* l)
 	{
-		UserData* udata = (UserData*)luaL_checkudata(l, stackIndex, 
-			ClassProxy<Class>::getName());
+		UserData* udata = checkUserData<Class>(l, stackIndex);
 
 		const Class* a = reinterpret_cast<const Class*>(udata->m_ptr);
 		return *a;
@@ -269,8 +410,7 @@ struct StackGet<Class&, stackIndex>
 {
 	Class& operator()(lua_State* l)
 	{
-		UserData* udata = (UserData*)luaL_checkudata(l, stackIndex, 
-			ClassProxy<Class>::getName());
+		UserData* udata = checkUserData<Class>(l, stackIndex);
 
 		Class* a = reinterpret_cast<Class*>(udata->m_ptr);
 		return *a;
@@ -283,8 +423,7 @@ struct StackGet<const Class*, stackIndex>
 {
 	const Class* operator()(lua_State* l)
 	{
-		UserData* udata = (UserData*)luaL_checkudata(l, stackIndex, 
-			ClassProxy<Class>::getName());
+		UserData* udata = checkUserData<Class>(l, stackIndex);
 
 		const Class* a = reinterpret_cast<const Class*>(udata->m_ptr);
 		return a;
@@ -297,8 +436,7 @@ struct StackGet<Class*, stackIndex>
 {
 	Class* operator()(lua_State* l)
 	{
-		UserData* udata = (UserData*)luaL_checkudata(l, stackIndex, 
-			ClassProxy<Class>::getName());
+		UserData* udata = checkUserData<Class>(l, stackIndex);
 
 		Class* a = reinterpret_cast<Class*>(udata->m_ptr);
 		return a;
@@ -479,12 +617,9 @@ struct CallConstructor;
 template<typename Class>
 struct CallConstructor<Class>
 {
-	Class* operator()(lua_State* l)
+	void operator()(lua_State* l, UserData* d)
 	{
-		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
-		ANKI_ASSERT(binder);
-		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
-		return alloc.template newInstance<Class>();
+		constructObject<Class>(l, d);
 	}
 };
 
@@ -492,12 +627,9 @@ struct CallConstructor<Class>
 template<typename Class, typename Arg0>
 struct CallConstructor<Class, Arg0>
 {
-	Class* operator()(lua_State* l)
+	void operator()(lua_State* l, UserData* d)
 	{
-		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
-		ANKI_ASSERT(binder);
-		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
-		return alloc.template newInstance<Class>(StackGet<Arg0, 1>()(l));
+		constructObject<Class>(l, d, StackGet<Arg0, 1>()(l));
 	}
 };
 
@@ -505,12 +637,9 @@ struct CallConstructor<Class, Arg0>
 template<typename Class, typename Arg0, typename Arg1>
 struct CallConstructor<Class, Arg0, Arg1>
 {
-	Class* operator()(lua_State* l)
+	void operator()(lua_State* l, UserData* d)
 	{
-		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
-		ANKI_ASSERT(binder);
-		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
-		return alloc.template newInstance<Class>(StackGet<Arg0, 1>()(l),
+		constructObject<Class>(l, d, StackGet<Arg0, 1>()(l),
 			StackGet<Arg1, 2>()(l));
 	}
 };
@@ -519,12 +648,9 @@ struct CallConstructor<Class, Arg0, Arg1>
 template<typename Class, typename Arg0, typename Arg1, typename Arg2>
 struct CallConstructor<Class, Arg0, Arg1, Arg2>
 {
-	Class* operator()(lua_State* l)
+	void operator()(lua_State* l, UserData* d)
 	{
-		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
-		ANKI_ASSERT(binder);
-		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
-		return alloc.template newInstance<Class>(StackGet<Arg0, 1>()(l),
+		constructObject<Class>(l, d, StackGet<Arg0, 1>()(l),
 			StackGet<Arg1, 2>()(l), StackGet<Arg2, 3>()(l));
 	}
 };
@@ -534,12 +660,9 @@ template<typename Class, typename Arg0, typename Arg1, typename Arg2,
 	typename Arg3>
 struct CallConstructor<Class, Arg0, Arg1, Arg2, Arg3>
 {
-	Class* operator()(lua_State* l)
+	void operator()(lua_State* l, UserData* d)
 	{
-		LuaBinder* binder = (LuaBinder*)lua_getuserdata(l);
-		ANKI_ASSERT(binder);
-		LuaBinder::Allocator<U8> alloc = binder->_getAllocator();
-		return alloc.template newInstance<Class>(StackGet<Arg0, 1>()(l),
+		constructObject<Class>(l, d, StackGet<Arg0, 1>()(l),
 			StackGet<Arg1, 2>()(l), StackGet<Arg2, 3>()(l),
 			StackGet<Arg3, 4>()(l));
 	}
@@ -581,12 +704,8 @@ struct ConstructorSignature
 	static int luafunc(lua_State* l)
 	{
 		checkArgsCount(l, sizeof...(Args));
-		UserData* d = (UserData*)lua_newuserdata(l, sizeof(UserData));
-
-		luaL_setmetatable(l, ClassProxy<Class>::getName());
-
-		d->m_ptr = CallConstructor<Class, Args...>()(l);
-		d->m_gc = true;
+		UserData* d = pushUserData<Class>(l);
+		CallConstructor<Class, Args...>()(l, d);
 		return 1;
 	}
 };
@@ -599,8 +718,7 @@ struct DestructorSignature
 	static int luafunc(lua_State* l)
 	{
 		checkArgsCount(l, 1);
-		UserData* d = (UserData*)luaL_checkudata(l, 1, 
-			ClassProxy<Class>::getName());
+		UserData* d = checkUserData<Class>(l, 1);
 		if(d->m_gc)
 		{
 			Class* obj = reinterpret_cast<Class*>(d->m_ptr);
@@ -636,10 +754,12 @@ struct FunctionSignature<flags, TReturn (*)(TArgs...), f>
 //==============================================================================
 // Macros
 
-/// Don't use it directly
+/// Don't use it directly. Classes with inline storage don't need one
 #define ANKI_LUA_DESTRUCTOR() \
-	detail::pushCFunctionMethod(l_, "__gc", \
-		&detail::DestructorSignature<Class>::luafunc);
+	if(!detail::InlineStorage<Class>::VALUE) { \
+		detail::pushCFunctionMethod(l_, "__gc", \
+			&detail::DestructorSignature<Class>::luafunc); \
+	}
 
 /// Start wrapping a class. Don't add a destructor (if for example the class 
 /// has a private derstructor)
@@ -647,7 +767,8 @@ struct FunctionSignature<flags, TReturn (*)(TArgs...), f>
 	typedef Class_ Class; \
 	lua_State* l_ = luaBinder_._getLuaState(); \
 	detail::ClassProxy<Class>::setName(#Class_); \
-	detail::createClass(l_, detail::ClassProxy<Class>::getName());
+	detail::createClass(l_, detail::ClassProxy<Class>::getName(), \
+		detail::ClassProxy<Class>::getKey());
 
 /// Start wrapping a class
 #define ANKI_LUA_CLASS_BEGIN(luaBinder_, Class_) \
@@ -716,7 +837,7 @@ void LuaBinder::exposeVariable(const char* name, T* y)
 	UserData* d = (UserData*)lua_newuserdata(m_l, sizeof(UserData));
 	d->m_ptr = y;
 	d->m_gc = false;
-	luaL_setmetatable(m_l, ClassProxy<T>::getName());
+	setMetatable<T>(m_l);
 	lua_setglobal(m_l, name);
 }
 
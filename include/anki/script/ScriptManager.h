@@ -8,16 +8,58 @@
 
 #include "anki/script/LuaBinder.h"
 #include "anki/util/Singleton.h"
+#include "anki/util/Vector.h"
 
 namespace anki {
 
-/// The scripting manager
+// Forward
+class SceneGraph;
+
+/// The scripting manager. Besides its own state it may have a state per 
+/// thread of the threadpool of the scene. They run the script components in
+/// parallel. The thread states are sandboxed, they don't share globals with
+/// each other or with the main state
 class ScriptManager: public LuaBinder
 {
 public:
-	ScriptManager(HeapAllocator<U8>& alloc);
+	/// @param allocCb The allocation callback of the memory pools of the 
+	///                states. Every state has its own pool
+	/// @param allocCbData The user data of allocCb
+	/// @param threadStatesCount The states that run the script components. 
+	///                          Zero disables the parallel scripts
+	ScriptManager(AllocAlignedCallback allocCb, void* allocCbData, 
+		U32 threadStatesCount = 0);
 
 	~ScriptManager();
+
+	/// @name Parallel scripts
+	/// @{
+	U32 getThreadStatesCount() const
+	{
+		return m_threadStates.size();
+	}
+
+	LuaBinder& getThreadState(U32 i)
+	{
+		return *m_threadStates[i];
+	}
+
+	/// Evaluate a string in every thread state. Use it to define the 
+	/// functions of the script components
+	void evalStringInThreadStates(const char* str);
+
+	/// Call the functions of the script components of all the scene nodes.
+	/// Every thread of the threadpool of the scene uses its own state. Call
+	/// it before SceneGraph::update. It does nothing without thread states
+	void updateScriptComponents(SceneGraph& scene, F32 prevUpdateTime, 
+		F32 crntTime);
+	/// @}
+
+private:
+	Vector<LuaBinder*> m_threadStates;
+
+	/// Wrap the engine to a state
+	static void wrapEngine(LuaBinder& lb);
 };
 
 typedef SingletonInit<ScriptManager> ScriptManagerSingleton;
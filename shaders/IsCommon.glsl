@@ -5,14 +5,9 @@
 
 // Contains common structures for IS
 
-// Representation of a tile
-struct Tile
-{
-	uvec4 lightsCount;
-	uint pointLightIndices[MAX_POINT_LIGHTS_PER_TILE];
-	uint spotLightIndices[MAX_SPOT_LIGHTS_PER_TILE];
-	uint spotTexLightIndices[MAX_SPOT_TEX_LIGHTS_PER_TILE];
-};
+// Representation of a cluster. x: The offset of the light indices, y: 16bit 
+// point lights count, 8bit spot lights count, 8bit spot tex lights count
+#define Cluster uvec2
 
 // The base of all lights
 struct Light
@@ -56,4 +51,5 @@ layout(std140, row_major, binding = 0) readonly buffer commonBlock
 	vec4 uProjectionParams;
 	vec4 uSceneAmbientColor;
 	vec4 uGroundLightDir;
+	vec4 uClusterParams; // xy: Scale and bias to compute the cluster slice
 };
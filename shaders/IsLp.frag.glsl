@@ -30,9 +30,15 @@ layout(std140, binding = 3) readonly buffer spotTexLightsBlock
 	SpotTexLight uSpotTexLights[MAX_SPOT_TEX_LIGHTS];
 };
 
-layout(std430, binding = 4) readonly buffer tilesBlock
+layout(std430, binding = CLUSTERS_BLOCK_BINDING) readonly buffer clustersBlock
 {
-	Tile uTiles[TILES_COUNT];
+	Cluster uClusters[TILES_COUNT * CLUSTERS_Z_COUNT];
+};
+
+layout(std430, binding = LIGHT_INDICES_BLOCK_BINDING) 
+	readonly buffer lightIndicesBlock
+{
+	uint uLightIndices[];
 };
 
 layout(binding = 0) uniform sampler2D uMsRt0;
@@ -60,6 +66,15 @@ vec3 getFragPosVSpace()
 	return fragPosVspace;
 }
 
+//==============================================================================
+// Find the cluster of the fragment. The X and Y are the tile's
+Cluster getCluster(in float fragDepth)
+{
+	int slice = int(log2(fragDepth) * uClusterParams.x + uClusterParams.y);
+	slice = clamp(slice, 0, CLUSTERS_Z_COUNT - 1);
+	return uClusters[slice * TILES_COUNT + inInstanceId];
+}
+
 //==============================================================================
 float computeAttenuationFactor(
 	in vec3 fragPosVspace, 
@@ -168,14 +183,14 @@ void main()
 	// Ambient color
 	outColor = diffColor * uSceneAmbientColor.rgb;
 
-	//Tile tile = uTiles[inInstanceId];
-	#define tile uTiles[inInstanceId]
+	Cluster cluster = getCluster(-fragPosVspace.z);
+	uint indexOffset = cluster.x;
 
 	// Point lights
-	uint pointLightsCount = tile.lightsCount[0];
+	uint pointLightsCount = cluster.y & 0xFFFFU;
 	for(uint i = 0U; i < pointLightsCount; ++i)
 	{
-		uint lightId = tile.pointLightIndices[i];
+		uint lightId = uLightIndices[indexOffset++];
 		PointLight light = uPointLights[lightId];
 
 		vec3 ray;
@@ -188,11 +203,11 @@ void main()
 	}
 
 	// Spot lights
-	uint spotLightsCount = tile.lightsCount[2];
+	uint spotLightsCount = (cluster.y >> 16U) & 0xFFU;
 
 	for(uint i = 0U; i < spotLightsCount; ++i)
 	{
-		uint lightId = tile.spotLightIndices[i];
+		uint lightId = uLightIndices[indexOffset++];
 		SpotLight light = uSpotLights[lightId];
 
 		vec3 ray;
@@ -210,11 +225,11 @@ void main()
 	}
 
 	// Spot lights with shadow
-	uint spotTexLightsCount = tile.lightsCount[3];
+	uint spotTexLightsCount = cluster.y >> 24U;
 
 	for(uint i = 0U; i < spotTexLightsCount; ++i)
 	{
-		uint lightId = tile.spotTexLightIndices[i];
+		uint lightId = uLightIndices[indexOffset++];
 		SpotTexLight light = uSpotTexLights[lightId];
 
 		vec3 ray;
@@ -6,6 +6,7 @@
 #include "anki/collision/Frustum.h"
 #include "anki/collision/LineSegment.h"
 #include "anki/collision/Aabb.h"
+#include "anki/collision/Functions.h"
 #include <limits>
 
 namespace anki {
@@ -28,6 +29,20 @@ Frustum& Frustum::operator=(const Frustum& b)
 
 //==============================================================================
 Bool Frustum::insideFrustum(const CollisionShape& b)
+{
+	for(const Plane& plane : getPlanes())
+	{
+		if(b.testPlane(plane) < 0.0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//==============================================================================
+const Array<Plane, (U)Frustum::PlaneType::COUNT>& Frustum::getPlanes()
 {
 	if(m_frustumDirty)
 	{
@@ -38,15 +53,7 @@ Bool Frustum::insideFrustum(const CollisionShape& b)
 		transform(m_trf);
 	}
 
-	for(const Plane& plane : m_planes)
-	{
-		if(b.testPlane(plane) < 0.0)
-		{
-			return false;
-		}
-	}
-
-	return true;
+	return m_planes;
 }
 
 //==============================================================================
@@ -71,10 +78,7 @@ void Frustum::transform(const Transform& trf)
 	CompoundShape::transform(*useTrf);
 
 	// Transform the planes
-	for(Plane& p : m_planes)
-	{
-		p.transform(*useTrf);
-	}
+	transformPlanes(*useTrf, &m_planes[0], &m_planes[0], m_planes.size());
 }
 
 //==============================================================================
@@ -88,10 +92,7 @@ void Frustum::resetTransform(const Transform& trf)
 	CompoundShape::transform(m_trf);
 
 	// Transform the planes
-	for(Plane& p : m_planes)
-	{
-		p.transform(m_trf);
-	}
+	transformPlanes(m_trf, &m_planes[0], &m_planes[0], m_planes.size());
 }
 
 //==============================================================================
@@ -75,4 +75,57 @@ void extractClipPlanes(const Mat4& mvp,
 	}	
 }
 
+//==============================================================================
+void transformPlanes(const Transform& trf, const Plane* in, Plane* out,
+	PtrSize count)
+{
+	// The columns of the rotation
+	const Mat3x4& rot = trf.getRotation();
+	Array<Vec4, 3> cols;
+	for(U i = 0; i < 3; i++)
+	{
+		cols[i] = Vec4(rot(0, i), rot(1, i), rot(2, i), 0.0);
+	}
+
+	// The origin in the space of the planes
+	Mat3x4 invRot = rot;
+	invRot.transposeRotationPart();
+	const Vec4 origin(invRot * trf.getOrigin(), 0.0);
+	const F32 scale = trf.getScale();
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		const Vec4& n = in[i].getNormal();
+		F32 offset = in[i].getOffset() * scale + origin.dot(n);
+
+		out[i].setNormal(cols[0] * n.x() + cols[1] * n.y() + cols[2] * n.z());
+		out[i].setOffset(offset);
+	}
+}
+
+//==============================================================================
+void transformAabbs(const Transform& trf, const Aabb* in, Aabb* out,
+	PtrSize count)
+{
+	Mat3x4 absM;
+	for(U i = 0; i < 12; ++i)
+	{
+		absM[i] = fabs(trf.getRotation()[i]);
+	}
+
+	const F32 halfScale = trf.getScale() * 0.5;
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		Vec4 center = (in[i].getMin() + in[i].getMax()) * 0.5;
+		Vec4 extend = (in[i].getMax() - in[i].getMin()) * halfScale;
+
+		Vec4 newC = trf.transform(center);
+		Vec4 newE = Vec4(absM * extend, 0.0);
+
+		out[i].setMin(newC - newE);
+		out[i].setMax(newC + newE);
+	}
+}
+
 } // end namespace anki
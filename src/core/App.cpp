@@ -73,6 +73,8 @@ void App::init(const Config& config)
 
 	// Threadpool
 	m_threadpool = m_heapAlloc.newInstance<Threadpool>(getCpuCoresCount());
+	m_renderThreadpool =
+		m_heapAlloc.newInstance<Threadpool>(getCpuCoresCount());
 
 	// Scene
 	m_scene = m_heapAlloc.newInstance<SceneGraph>(
@@ -183,7 +185,7 @@ void App::mainLoop()
 		input.handleEvents();
 		scene.update(
 			prevUpdateTime, crntTime, MainRendererSingleton::get());
-		renderer.render(SceneGraphSingleton::get());
+		renderer.render(scene.getRenderSnapshot());
 
 		window.swapBuffers();
 		ANKI_COUNTERS_RESOLVE_FRAME();
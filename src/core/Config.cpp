@@ -32,6 +32,7 @@ Config::Config()
 	newOption("is.maxPointLightsPerTile", 48);
 	newOption("is.maxSpotLightsPerTile", 4);
 	newOption("is.maxSpotTexLightsPerTile", 4);
+	newOption("is.clusterSlicesCount", 16);
 
 	// Pps
 	newOption("pps.hdr.enabled", true);
@@ -68,7 +69,12 @@ Config::Config()
 	newOption("width", 0);
 	newOption("height", 0);
 	newOption("renderingQuality", 1.0); // Applies only to MainRenderer
-	newOption("lodDistance", 10.0); // Distance that used to calculate the LOD
+	// The screen error in pixels that a LOD can have
+	newOption("lodMaxPixelError", 1.0);
+	// How much the LOD error can go past lodMaxPixelError before it changes
+	newOption("lodHysteresis", 0.2);
+	// Rasterize the occluders on the CPU and cull what they hide
+	newOption("occlusionCulling", true);
 	newOption("samples", 1);
 	newOption("tilesXCount", 16);
 	newOption("tilesYCount", 16);
@@ -82,6 +88,9 @@ Config::Config()
 
 	newOption("maxTextureSize", 1024 * 1024);
 	newOption("textureAnisotropy", 8);
+	newOption("textureStreamingTailSize", 64); // Zero disables the streaming
+	newOption("textureStreamingBudget", 256 * 1024 * 1024);
+	newOption("textureStreamingMaxLoadPerFrame", 16 * 1024 * 1024);
 }
 
 //==============================================================================
@@ -39,14 +39,24 @@ static const Array<CounterInfo, (U)Counter::COUNT> cinfo = {{
 	{"RENDERER_PPS_TIME", CF_PER_FRAME | CF_PER_RUN | CF_F64},
 	{"RENDERER_SHADOW_PASSES", CF_PER_FRAME | CF_PER_RUN | CF_U64},
 	{"RENDERER_LIGHTS_COUNT", CF_PER_RUN | CF_U64},
+	{"RENDERER_STATE_CHANGES", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"RENDERER_TRIANGLES_COUNT", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"RENDERER_LOD_TRIANGLES_SAVED", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"RENDERER_CLUSTER_TRIANGLES_CULLED", 
+		CF_PER_FRAME | CF_PER_RUN | CF_U64},
 	{"SCENE_UPDATE_TIME", CF_PER_RUN | CF_F64},
+	{"SCENE_OCCLUSION_TIME", CF_PER_FRAME | CF_PER_RUN | CF_F64},
+	{"SCENE_OCCLUDED_NODES", CF_PER_FRAME | CF_PER_RUN | CF_U64},
 	{"SWAP_BUFFERS_TIME", CF_PER_RUN | CF_F64},
 	{"GL_CLIENT_WAIT_TIME", CF_PER_FRAME | CF_PER_RUN | CF_F64},
 	{"GL_SERVER_WAIT_TIME", CF_PER_FRAME | CF_PER_RUN | CF_F64},
 	{"GL_DRAWCALLS_COUNT", CF_PER_RUN | CF_U64},
 	{"GL_VERTICES_COUNT", CF_PER_FRAME | CF_PER_RUN | CF_U64},
 	{"GL_QUEUES_SIZE", CF_PER_FRAME | CF_PER_RUN | CF_U64},
-	{"GL_CLIENT_BUFFERS_SIZE", CF_PER_FRAME | CF_PER_RUN | CF_U64}
+	{"GL_CLIENT_BUFFERS_SIZE", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"GL_TRANSIENT_MEMORY_SIZE", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"GL_TRANSIENT_WAITS_COUNT", CF_PER_FRAME | CF_PER_RUN | CF_U64},
+	{"GL_HANDLE_ATOMIC_OPS", CF_PER_FRAME | CF_PER_RUN | CF_U64}
 }};
 
 #define MAX_NAME "24"
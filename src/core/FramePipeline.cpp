@@ -0,0 +1,194 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/core/FramePipeline.h"
+#include "anki/util/Assert.h"
+#include <algorithm>
+
+namespace anki {
+
+//==============================================================================
+FramePipeline::FramePipeline()
+:	m_thread("anki_render")
+{}
+
+//==============================================================================
+FramePipeline::~FramePipeline()
+{
+	if(m_pipelined)
+	{
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			while(m_pending)
+			{
+				m_condVar.wait(m_mtx);
+			}
+
+			m_quit = true;
+		}
+
+		m_condVar.notifyAll();
+		m_thread.join();
+	}
+}
+
+//==============================================================================
+void FramePipeline::init(Bool pipelined, UpdateCallback update,
+	RenderCallback render, void* userData)
+{
+	ANKI_ASSERT(update && render);
+	ANKI_ASSERT(m_update == nullptr && "Already initialized");
+
+	m_pipelined = pipelined;
+	m_update = update;
+	m_render = render;
+	m_userData = userData;
+
+	if(m_pipelined)
+	{
+		m_thread.start(this, threadCallback);
+	}
+}
+
+//==============================================================================
+void FramePipeline::runFrame()
+{
+	ANKI_ASSERT(m_update && "Not initialized");
+
+	HighRezTimer::Scalar start = HighRezTimer::getCurrentTime();
+	U64 frame = m_crntFrame++;
+
+	// Update. In pipelined mode the previous frame renders at the same time
+	void* snapshot = (*m_update)(m_userData, frame);
+
+	HighRezTimer::Scalar updateTime = HighRezTimer::getCurrentTime() - start;
+	{
+		LockGuard<SpinLock> lock(m_statsLock);
+		m_stats.m_updateTimeSum += updateTime;
+		++m_stats.m_updatesCount;
+	}
+
+	if(!m_pipelined)
+	{
+		renderFrame(snapshot, frame, start);
+		return;
+	}
+
+	// Wait for the previous frame and hand over the new one
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		while(m_pending)
+		{
+			m_condVar.wait(m_mtx);
+		}
+
+		m_snapshot = snapshot;
+		m_snapshotFrame = frame;
+		m_snapshotStartTime = start;
+		m_pending = true;
+	}
+
+	m_condVar.notifyAll();
+}
+
+//==============================================================================
+void FramePipeline::flush()
+{
+	if(m_pipelined)
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		while(m_pending)
+		{
+			m_condVar.wait(m_mtx);
+		}
+	}
+}
+
+//==============================================================================
+void FramePipeline::renderFrame(void* snapshot, U64 frame,
+	HighRezTimer::Scalar start)
+{
+	HighRezTimer::Scalar renderStart = HighRezTimer::getCurrentTime();
+	(*m_render)(m_userData, snapshot, frame);
+	HighRezTimer::Scalar end = HighRezTimer::getCurrentTime();
+
+	LockGuard<SpinLock> lock(m_statsLock);
+	if(m_stats.m_framesCount == 0)
+	{
+		m_stats.m_firstFrameEnd = end;
+	}
+
+	m_stats.m_lastFrameEnd = end;
+	m_stats.m_latencySum += end - start;
+	m_stats.m_renderTimeSum += end - renderStart;
+	++m_stats.m_framesCount;
+}
+
+//==============================================================================
+F64 FramePipeline::getOverlap() const
+{
+	HighRezTimer::Scalar update = getAverageUpdateTime();
+	HighRezTimer::Scalar render = getAverageRenderTime();
+	HighRezTimer::Scalar frame = getAverageFrameTime();
+	HighRezTimer::Scalar shortest = std::min(update, render);
+
+	if(shortest <= 0.0 || frame <= 0.0)
+	{
+		return 0.0;
+	}
+
+	// Serial frames take update + render. The overlapped time is hidden
+	HighRezTimer::Scalar hidden = update + render - frame;
+	return std::max(0.0, std::min(1.0, hidden / shortest));
+}
+
+//==============================================================================
+I FramePipeline::threadCallback(Thread::Info& info)
+{
+	FramePipeline* self = reinterpret_cast<FramePipeline*>(info.m_userData);
+	self->threadLoop();
+	return 0;
+}
+
+//==============================================================================
+void FramePipeline::threadLoop()
+{
+	while(1)
+	{
+		void* snapshot;
+		U64 frame;
+		HighRezTimer::Scalar start;
+
+		// Wait for a frame
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			while(!m_pending && !m_quit)
+			{
+				m_condVar.wait(m_mtx);
+			}
+
+			if(m_quit)
+			{
+				break;
+			}
+
+			snapshot = m_snapshot;
+			frame = m_snapshotFrame;
+			start = m_snapshotStartTime;
+		}
+
+		renderFrame(snapshot, frame, start);
+
+		// Let the next frame in
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			m_pending = false;
+		}
+
+		m_condVar.notifyAll();
+	}
+}
+
+} // end namespace anki
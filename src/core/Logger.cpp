@@ -5,17 +5,89 @@
 
 #include "anki/core/Logger.h"
 #include "anki/core/App.h"
+#include "anki/util/HighRezTimer.h"
 #include <cstring>
 #include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <exception>
+#include <thread>
+#include <iostream>
 #if ANKI_OS == ANKI_OS_ANDROID
 #	include <android/log.h>
 #endif
+#if ANKI_POSIX
+#	include <unistd.h>
+#endif
 
 namespace anki {
 
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The logger that the crash and exit handlers drain
+static Atomic<Logger*> gCrashLogger(nullptr);
+
+static std::terminate_handler gPrevTerminateHandler = nullptr;
+
+#if ANKI_POSIX
+//==============================================================================
+/// Write to the stderr. It's async signal safe
+static void writeToStderr(const char* str, PtrSize len)
+{
+	while(len > 0)
+	{
+		ssize_t n = ::write(STDERR_FILENO, str, len);
+		if(n <= 0)
+		{
+			break;
+		}
+
+		str += n;
+		len -= n;
+	}
+}
+
+//==============================================================================
+static void writeToStderr(const char* str)
+{
+	writeToStderr(str, std::strlen(str));
+}
+
+//==============================================================================
+/// Write a positive number. It's async signal safe
+static void writeToStderr(U32 num)
+{
+	char buff[16];
+	U i = sizeof(buff);
+	do
+	{
+		buff[--i] = '0' + num % 10;
+		num /= 10;
+	} while(num > 0);
+
+	writeToStderr(&buff[i], sizeof(buff) - i);
+}
+#endif
+
+//==============================================================================
+// Logger                                                                      =
+//==============================================================================
+
 //==============================================================================
 Logger::Logger(InitFlags flags, HeapAllocator<U8>& alloc)
+:	m_alloc(alloc),
+	m_thread("anki_logger"),
+	m_handlers(m_alloc)
 {
+	m_records = m_alloc.newArray<Record>(RECORDS_COUNT);
+	for(U i = 0; i < RECORDS_COUNT; i++)
+	{
+		m_records[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+
 	if((flags & InitFlags::WITH_SYSTEM_MESSAGE_HANDLER) != InitFlags::NONE)
 	{
 		addMessageHandler(this, &defaultSystemMessageHandler);
@@ -25,11 +97,54 @@ Logger::Logger(InitFlags flags, HeapAllocator<U8>& alloc)
 	{
 		addMessageHandler(this, &logfileMessageHandler);
 	}
+
+	m_thread.start(this, threadCallback);
+
+	// Install the crash handlers once. They serve the first logger
+	Logger* expected = nullptr;
+	if(gCrashLogger.compare_exchange_strong(expected, this))
+	{
+		static Bool installed = false;
+		if(!installed)
+		{
+			installed = true;
+
+			std::atexit(flushAtExit);
+			gPrevTerminateHandler = std::set_terminate(flushOnTerminate);
+
+			signal(SIGSEGV, flushOnSignal);
+			signal(SIGABRT, flushOnSignal);
+			signal(SIGFPE, flushOnSignal);
+			signal(SIGILL, flushOnSignal);
+#if ANKI_POSIX
+			signal(SIGBUS, flushOnSignal);
+#endif
+		}
+	}
+}
+
+//==============================================================================
+Logger::~Logger()
+{
+	Logger* expected = this;
+	gCrashLogger.compare_exchange_strong(expected, nullptr);
+
+	{
+		LockGuard<Mutex> lock(m_wakeMtx);
+		m_quit.store(true);
+		m_wakeCond.notifyOne();
+	}
+
+	m_thread.join();
+	flush();
+
+	m_alloc.deleteArray(m_records, RECORDS_COUNT);
 }
 
 //==============================================================================
 void Logger::addMessageHandler(void* data, MessageHandlerCallback callback)
 {
+	LockGuard<Mutex> lock(m_sinkMtx);
 	m_handlers.push_back(Handler{data, callback});
 }
 
@@ -37,29 +152,415 @@ void Logger::addMessageHandler(void* data, MessageHandlerCallback callback)
 void Logger::write(const char* file, int line, const char* func,
 	MessageType type, const char* msg)
 {
-	m_mutex.lock();
+	writeFormated(file, line, func, type, "%s", msg);
+}
+
+//==============================================================================
+void Logger::writeFormated(const char* file, int line, const char* func,
+	MessageType type, const char* fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	push(file, line, func, type, fmt, args);
+	va_end(args);
+}
+
+//==============================================================================
+Logger::RateLimit* Logger::findRateLimit(const char* file, int line)
+{
+	ANKI_ASSERT(line != MIN_I32);
+	PtrSize hash = (reinterpret_cast<PtrSize>(file) >> 3) 
+		^ (static_cast<PtrSize>(line) * 2654435761u);
+
+	// Linear probing. The slots are never freed so the probing stops at the
+	// first free one
+	for(U i = 0; i < RATE_LIMITS_COUNT; i++)
+	{
+		RateLimit& limit = m_rateLimits[(hash + i) % RATE_LIMITS_COUNT];
+
+		const char* limitFile = limit.m_file.load(std::memory_order_acquire);
+		if(limitFile == nullptr)
+		{
+			if(limit.m_file.compare_exchange_strong(limitFile, file, 
+				std::memory_order_acq_rel))
+			{
+				limit.m_line.store(line, std::memory_order_release);
+				return &limit;
+			}
+
+			// Another site took it. limitFile is the file of that site
+		}
+
+		if(limitFile != file)
+		{
+			continue;
+		}
+
+		// The thread that took the slot may not have set the line yet
+		I32 limitLine;
+		while((limitLine = limit.m_line.load(std::memory_order_acquire)) 
+			== MIN_I32)
+		{
+			std::this_thread::yield();
+		}
+
+		if(limitLine == line)
+		{
+			return &limit;
+		}
+	}
+
+	return nullptr;
+}
+
+//==============================================================================
+Bool Logger::rateLimit(const char* file, int line)
+{
+	// Every call site has its own limit
+	RateLimit* limit = findRateLimit(file, line);
+	if(limit == nullptr)
+	{
+		return true;
+	}
+
+	U32 second = static_cast<U32>(HighRezTimer::getCurrentTime());
+	U32 prevSecond = limit->m_second.load(std::memory_order_relaxed);
+	if(prevSecond != second 
+		&& limit->m_second.compare_exchange_strong(prevSecond, second, 
+		std::memory_order_relaxed))
+	{
+		limit->m_count.store(0, std::memory_order_relaxed);
+	}
+
+	return limit->m_count.fetch_add(1, std::memory_order_relaxed) 
+		< MAX_MESSAGES_PER_SECOND;
+}
+
+//==============================================================================
+void Logger::push(const char* file, int line, const char* func,
+	MessageType type, const char* fmt, va_list args)
+{
+	// Never lose an error
+	if(type != MessageType::ERROR && !rateLimit(file, line))
+	{
+		m_suppressed.fetch_add(1, std::memory_order_relaxed);
+		m_suppressedTotal.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Claim a record. It's Vyukov's bounded queue
+	Record* record;
+	U64 pos = m_tail.load(std::memory_order_relaxed);
+	while(1)
+	{
+		record = &m_records[pos % RECORDS_COUNT];
+		U64 seq = record->m_sequence.load(std::memory_order_acquire);
+		I64 diff = static_cast<I64>(seq) - static_cast<I64>(pos);
+
+		if(diff == 0)
+		{
+			if(m_tail.compare_exchange_weak(pos, pos + 1, 
+				std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if(diff < 0)
+		{
+			// The ring is full. Only the errors wait for the thread
+			if(type != MessageType::ERROR)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				m_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			{
+				LockGuard<Mutex> lock(m_wakeMtx);
+				m_wakeCond.notifyOne();
+			}
+
+			std::this_thread::yield();
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
 
-	Info inf = {file, line, func, type, msg};
+	// Format. The arguments may point to temporaries so it can't wait for
+	// the thread
+	record->m_file = file;
+	record->m_line = line;
+	record->m_func = func;
+	record->m_type = type;
+	record->m_longMsg = nullptr;
 
+	va_list args2;
+	va_copy(args2, args);
+	I len = vsnprintf(&record->m_msg[0], MESSAGE_SIZE, fmt, args);
+	if(len >= static_cast<I>(MESSAGE_SIZE))
+	{
+		try
+		{
+			record->m_longMsg = reinterpret_cast<char*>(
+				m_alloc.allocate(len + 1));
+			vsnprintf(record->m_longMsg, len + 1, fmt, args2);
+		}
+		catch(...)
+		{
+			// Keep it truncated
+		}
+	}
+	va_end(args2);
+
+	record->m_sequence.store(pos + 1, std::memory_order_release);
+
+	// Wake the thread if it sleeps. The fence pairs with the one in 
+	// threadLoop()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(m_sinkSleeping.load(std::memory_order_relaxed))
+	{
+		LockGuard<Mutex> lock(m_wakeMtx);
+		m_wakeCond.notifyOne();
+	}
+}
+
+//==============================================================================
+Bool Logger::ringEmpty() const
+{
+	U64 pos = m_head.load(std::memory_order_relaxed);
+	return m_records[pos % RECORDS_COUNT].m_sequence.load(
+		std::memory_order_acquire) != pos + 1;
+}
+
+//==============================================================================
+void Logger::runHandlers(const Info& info)
+{
 	for(Handler& handler : m_handlers)
 	{
-		handler.m_callback(handler.m_data, inf);
+		try
+		{
+			handler.m_callback(handler.m_data, info);
+		}
+		catch(...)
+		{
+			// The logger cannot throw
+		}
+	}
+}
+
+//==============================================================================
+void Logger::drain()
+{
+	U64 pos = m_head.load(std::memory_order_relaxed);
+
+	while(1)
+	{
+		Record& record = m_records[pos % RECORDS_COUNT];
+		if(record.m_sequence.load(std::memory_order_acquire) != pos + 1)
+		{
+			break;
+		}
+
+		Info info = {record.m_file, record.m_line, record.m_func, 
+			record.m_type, 
+			(record.m_longMsg) ? record.m_longMsg : &record.m_msg[0]};
+		runHandlers(info);
+
+		if(record.m_longMsg)
+		{
+			m_alloc.deallocate(record.m_longMsg, 
+				std::strlen(record.m_longMsg) + 1);
+			record.m_longMsg = nullptr;
+		}
+
+		// Free it for the lap after the next
+		record.m_sequence.store(pos + RECORDS_COUNT, 
+			std::memory_order_release);
+		++pos;
+		m_head.store(pos, std::memory_order_relaxed);
+	}
+
+	// Report what was lost
+	U32 suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+	U32 dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+	if(suppressed || dropped)
+	{
+		char msg[128];
+		std::snprintf(msg, sizeof(msg), "%u repeated messages suppressed, "
+			"%u messages dropped because the log was full", suppressed, 
+			dropped);
+
+		Info info = {ANKI_FILE, __LINE__, ANKI_FUNC, MessageType::WARNING, 
+			msg};
+		runHandlers(info);
 	}
+}
+
+//==============================================================================
+void Logger::flushHandlers()
+{
+	std::cout.flush();
+	std::cerr.flush();
 
-	m_mutex.unlock();
+	if(m_logfile.isOpen())
+	{
+		try
+		{
+			m_logfile.flush();
+		}
+		catch(...)
+		{}
+	}
 }
 
 //==============================================================================
-void Logger::writeFormated(const char* file, int line, const char* func,
-	MessageType type, const char* fmt, ...)
+void Logger::flush()
 {
-	char buffer[1024 * 20];
-	va_list args;
+	LockGuard<Mutex> lock(m_sinkMtx);
+	drain();
+	flushHandlers();
+}
 
-	va_start(args, fmt);
-	vsnprintf(buffer, sizeof(buffer), fmt, args);
-	write(file, line, func, type, buffer);
-	va_end(args);
+//==============================================================================
+I Logger::threadCallback(Thread::Info& info)
+{
+	Logger* logger = reinterpret_cast<Logger*>(info.m_userData);
+	logger->threadLoop();
+	return 0;
+}
+
+//==============================================================================
+void Logger::threadLoop()
+{
+	while(1)
+	{
+		// Sleep until there is something to write. The fence pairs with the
+		// one in push()
+		{
+			LockGuard<Mutex> lock(m_wakeMtx);
+			m_sinkSleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			while(!m_quit.load() && ringEmpty())
+			{
+				m_wakeCond.wait(m_wakeMtx);
+			}
+
+			m_sinkSleeping.store(false, std::memory_order_relaxed);
+		}
+
+		// Write everything in one batch
+		flush();
+
+		if(m_quit.load())
+		{
+			break;
+		}
+	}
+}
+
+//==============================================================================
+void Logger::flushAtExit()
+{
+	Logger* logger = gCrashLogger.load();
+	if(logger == nullptr)
+	{
+		return;
+	}
+
+	// The thread of the logger or the crashed thread may hold the lock. Don't
+	// wait for ever
+	for(U i = 0; i < 100; i++)
+	{
+		if(logger->m_sinkMtx.tryLock())
+		{
+			logger->drain();
+			logger->flushHandlers();
+			logger->m_sinkMtx.unlock();
+			break;
+		}
+
+		HighRezTimer::sleep(0.01);
+	}
+}
+
+//==============================================================================
+void Logger::flushOnTerminate()
+{
+	flushAtExit();
+
+	if(gPrevTerminateHandler)
+	{
+		gPrevTerminateHandler();
+	}
+
+	std::abort();
+}
+
+//==============================================================================
+void Logger::writeRingOnSignal()
+{
+#if ANKI_POSIX
+	Logger* logger = gCrashLogger.load();
+	if(logger == nullptr)
+	{
+		return;
+	}
+
+	// The records are formated already. Write them without the handlers, the 
+	// locks and the allocator. Leave the ring as is, the thread of the 
+	// logger may write some of them again
+	U64 pos = logger->m_head.load(std::memory_order_relaxed);
+	while(1)
+	{
+		const Record& record = logger->m_records[pos % RECORDS_COUNT];
+		if(record.m_sequence.load(std::memory_order_acquire) != pos + 1)
+		{
+			break;
+		}
+
+		const char* x = "Info";
+		switch(record.m_type)
+		{
+		case MessageType::NORMAL:
+			break;
+		case MessageType::ERROR:
+			x = "Error";
+			break;
+		case MessageType::WARNING:
+			x = "Warn";
+			break;
+		}
+
+		writeToStderr("(");
+		writeToStderr(record.m_file);
+		writeToStderr(":");
+		writeToStderr(static_cast<U32>(record.m_line));
+		writeToStderr(" ");
+		writeToStderr(record.m_func);
+		writeToStderr(") ");
+		writeToStderr(x);
+		writeToStderr(": ");
+		writeToStderr((record.m_longMsg) 
+			? record.m_longMsg : &record.m_msg[0]);
+		writeToStderr("\n");
+
+		++pos;
+	}
+#endif
+}
+
+//==============================================================================
+void Logger::flushOnSignal(int sig)
+{
+	writeRingOnSignal();
+
+	signal(sig, SIG_DFL);
+	raise(sig);
 }
 
 //==============================================================================
@@ -91,7 +592,7 @@ void Logger::defaultSystemMessageHandler(void*, const Info& info)
 
 	(*out) << terminalColor << "(" << info.m_file << ":" << info.m_line << " "
 		<< info.m_func << ") " << x << ": " << info.m_msg 
-		<< "\033[0m" << std::endl;
+		<< "\033[0m" << '\n';
 #elif ANKI_OS == ANKI_OS_ANDROID
 	U32 andMsgType = ANDROID_LOG_INFO;
 
@@ -133,7 +634,7 @@ void Logger::defaultSystemMessageHandler(void*, const Info& info)
 	}
 
 	(*out) << "(" << info.m_file << ":" << info.m_line << " "
-		<< info.m_func << ") " << x << ": " << info.m_msg << std::endl;
+		<< info.m_func << ") " << x << ": " << info.m_msg << '\n';
 #endif
 }
 
@@ -174,8 +675,6 @@ void Logger::logfileMessageHandler(void* vlogger, const Info& info)
 
 	logger->m_logfile.writeText("(%s:%d %s) %s: %s\n", 
 		info.m_file, info.m_line, info.m_func, x, info.m_msg);
-
-	logger->m_logfile.flush();
 }
 
 } // end namespace anki
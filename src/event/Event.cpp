@@ -10,6 +10,15 @@
 
 namespace anki {
 
+//==============================================================================
+U32 newEventTypeId()
+{
+	static AtomicU32 count(0);
+	U32 id = count.fetch_add(1);
+	ANKI_ASSERT(id < EventManager::MAX_EVENT_TYPES && "Too many event types");
+	return id;
+}
+
 //==============================================================================
 Event::Event(EventManager* manager, F32 startTime_, F32 duration_, 
 	SceneNode* node, U8 flags)
@@ -5,18 +5,145 @@
 
 #include "anki/event/EventManager.h"
 #include "anki/scene/SceneGraph.h"
+#include "anki/util/Exception.h"
 
 namespace anki {
 
 //==============================================================================
-EventManager::EventManager(SceneGraph* scene_)
-	: scene(scene_), events(getSceneAllocator())
+// Misc                                                                        =
+//==============================================================================
+
+/// Below that the events are updated in the thread that calls the update
+static const U32 MIN_EVENTS_FOR_PARALLEL_UPDATE = 512;
+
+/// Update a part of the active events of every type
+class UpdateEventsTask: public Threadpool::Task
+{
+public:
+	EventManager* m_manager = nullptr;
+	Barrier* m_barrier = nullptr;
+	SceneFrameVector<Event*>* m_dead = nullptr;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		EventManager& manager = *m_manager;
+
+		for(EventManager::EventType* type : manager.m_types)
+		{
+			if(type == nullptr || type->m_active.size() == 0)
+			{
+				continue;
+			}
+
+			PtrSize start, end;
+			choseStartEnd(
+				taskId, threadsCount, type->m_active.size(), start, end);
+
+			if(start < end)
+			{
+				(*type->m_update)(&type->m_active[start], end - start,
+					manager.prevUpdateTime, manager.crntTime, *m_dead);
+			}
+
+			// Events of different types may animate the same node
+			m_barrier->wait();
+		}
+	}
+};
+
+//==============================================================================
+// EventManager::EventType                                                     =
+//==============================================================================
+
+//==============================================================================
+EventManager::EventType::EventType(HeapAllocator<U8>& alloc,
+	UpdateCallback update, PtrSize eventSize, PtrSize eventAlignment)
+:	m_update(update),
+	m_eventSize(getAlignedRoundUp(eventAlignment,
+		std::max(eventSize, sizeof(FreeEvent)))),
+	m_eventAlignment(eventAlignment),
+	m_active(alloc),
+	m_chunks(alloc),
+	m_alloc(alloc)
 {}
 
 //==============================================================================
-EventManager::~EventManager()
+EventManager::EventType::~EventType()
+{
+	for(void* chunk : m_chunks)
+	{
+		m_alloc.getMemoryPool().free(chunk);
+	}
+}
+
+//==============================================================================
+void* EventManager::EventType::allocate()
+{
+	if(m_freeEvents)
+	{
+		FreeEvent* out = m_freeEvents;
+		m_freeEvents = out->m_next;
+		return out;
+	}
+
+	if(m_chunkPos == m_chunkEnd)
+	{
+		const PtrSize size = m_eventSize * EVENTS_PER_CHUNK;
+		U8* chunk = static_cast<U8*>(
+			m_alloc.getMemoryPool().allocate(size, m_eventAlignment));
+		if(chunk == nullptr)
+		{
+			throw ANKI_EXCEPTION("Out of memory");
+		}
+
+		m_chunks.push_back(chunk);
+		m_chunkPos = chunk;
+		m_chunkEnd = chunk + size;
+	}
+
+	void* out = m_chunkPos;
+	m_chunkPos += m_eventSize;
+	return out;
+}
+
+//==============================================================================
+void EventManager::EventType::free(void* ptr)
+{
+	FreeEvent* event = static_cast<FreeEvent*>(ptr);
+	event->m_next = m_freeEvents;
+	m_freeEvents = event;
+}
+
+//==============================================================================
+// EventManager                                                                =
+//==============================================================================
+
+//==============================================================================
+EventManager::EventManager(SceneGraph* scene_, AllocAlignedCallback allocCb,
+	void* allocCbData)
+:	scene(scene_),
+	m_alloc(HeapMemoryPool(allocCb, allocCbData)),
+	m_schedule(m_alloc),
+	m_markedForDeletion(m_alloc)
 {}
 
+//==============================================================================
+EventManager::~EventManager()
+{
+	iterateEvents([](Event& event)
+	{
+		event.~Event();
+	});
+
+	for(EventType* type : m_types)
+	{
+		if(type)
+		{
+			m_alloc.deleteInstance(type);
+		}
+	}
+}
+
 //==============================================================================
 SceneAllocator<U8> EventManager::getSceneAllocator() const
 {
@@ -29,115 +156,274 @@ SceneAllocator<U8> EventManager::getSceneFrameAllocator() const
 	return scene->getFrameAllocator();
 }
 
+//==============================================================================
+EventManager::EventType& EventManager::getEventType(U32 typeId,
+	PtrSize eventSize, PtrSize eventAlignment, UpdateCallback update)
+{
+	ANKI_ASSERT(typeId < MAX_EVENT_TYPES);
+	EventType*& type = m_types[typeId];
+
+	if(type == nullptr)
+	{
+		type = m_alloc.newInstance<EventType>(
+			m_alloc, update, eventSize, eventAlignment);
+	}
+
+	ANKI_ASSERT(type->m_update == update);
+	return *type;
+}
+
 //==============================================================================
 void EventManager::registerEvent(Event* event)
 {
 	ANKI_ASSERT(event);
-	ANKI_ASSERT(std::find(events.begin(), events.end(), event) == events.end());
-	events.push_back(event);
+	ANKI_ASSERT(event->m_index == MAX_U32 && "Already registered");
+	scheduleEvent(event);
 }
 
 //==============================================================================
 void EventManager::unregisterEvent(Event* event)
 {
 	ANKI_ASSERT(event);
-	
-	EventsContainer::iterator it = events.begin();
-	for(; it != events.end(); it++)
+	ANKI_ASSERT(event->m_index != MAX_U32
+		&& "Trying to unreg non-existing event");
+
+	if(event->m_active)
+	{
+		deactivateEvent(event);
+	}
+	else
+	{
+		unscheduleEvent(event);
+	}
+}
+
+//==============================================================================
+Bool EventManager::startsBefore(const Event* a, const Event* b)
+{
+	// The events with negative start time start now so they come first
+	return a->startTime < b->startTime;
+}
+
+//==============================================================================
+void EventManager::setScheduleEntry(U32 i, Event* event)
+{
+	m_schedule[i] = event;
+	event->m_index = i;
+}
+
+//==============================================================================
+void EventManager::siftUp(U32 i)
+{
+	Event* event = m_schedule[i];
+
+	while(i > 0)
 	{
-		if((*it) == event)
+		U32 parent = (i - 1) / 2;
+		if(!startsBefore(event, m_schedule[parent]))
 		{
 			break;
 		}
+
+		setScheduleEntry(i, m_schedule[parent]);
+		i = parent;
 	}
 
-	ANKI_ASSERT(it == events.end() && "Trying to unreg non-existing event");
-	events.erase(it);
+	setScheduleEntry(i, event);
 }
 
 //==============================================================================
-void EventManager::updateAllEvents(F32 prevUpdateTime_, F32 crntTime_)
+void EventManager::siftDown(U32 i)
 {
-	prevUpdateTime = prevUpdateTime_;
-	crntTime = crntTime_;
+	Event* event = m_schedule[i];
+	const U32 count = m_schedule.size();
 
-	EventsContainer::iterator it = events.begin();
-	for(; it != events.end(); it++)
+	while(true)
 	{
-		Event* pevent = *it;
+		U32 child = i * 2 + 1;
+		if(child >= count)
+		{
+			break;
+		}
 
-		// If event or the node's event is marked for deletion then dont 
-		// do anything else for that event
-		if(pevent->isMarkedForDeletion() 
-			|| (pevent->getSceneNode() != nullptr 
-				&& pevent->getSceneNode()->isMarkedForDeletion()))
+		if(child + 1 < count
+			&& startsBefore(m_schedule[child + 1], m_schedule[child]))
 		{
-			pevent->markForDeletion();
-			continue;
+			++child;
 		}
 
-		// Audjust starting time
-		if(pevent->startTime < 0.0)
+		if(!startsBefore(m_schedule[child], event))
 		{
-			pevent->startTime = crntTime;
+			break;
 		}
 
-		// Check if dead
-		if(!pevent->isDead(crntTime))
+		setScheduleEntry(i, m_schedule[child]);
+		i = child;
+	}
+
+	setScheduleEntry(i, event);
+}
+
+//==============================================================================
+void EventManager::scheduleEvent(Event* event)
+{
+	event->m_active = false;
+	m_schedule.push_back(event);
+	siftUp(m_schedule.size() - 1);
+}
+
+//==============================================================================
+void EventManager::unscheduleEvent(Event* event)
+{
+	U32 i = event->m_index;
+	ANKI_ASSERT(!event->m_active && m_schedule[i] == event);
+
+	Event* last = m_schedule.back();
+	m_schedule.pop_back();
+
+	if(last != event)
+	{
+		setScheduleEntry(i, last);
+		siftDown(i);
+		siftUp(last->m_index);
+	}
+
+	event->m_index = MAX_U32;
+}
+
+//==============================================================================
+void EventManager::activateEvent(Event* event)
+{
+	EventsContainer& active = m_types[event->m_typeId]->m_active;
+
+	event->m_active = true;
+	event->m_index = active.size();
+	active.push_back(event);
+	++m_activeCount;
+}
+
+//==============================================================================
+void EventManager::deactivateEvent(Event* event)
+{
+	EventsContainer& active = m_types[event->m_typeId]->m_active;
+	U32 i = event->m_index;
+	ANKI_ASSERT(event->m_active && active[i] == event);
+
+	// Move the last in its place
+	Event* last = active.back();
+	active[i] = last;
+	last->m_index = i;
+	active.pop_back();
+
+	event->m_active = false;
+	event->m_index = MAX_U32;
+	--m_activeCount;
+}
+
+//==============================================================================
+void EventManager::killEvents(SceneFrameVector<Event*>& dead)
+{
+	for(Event* event : dead)
+	{
+		if(event->onKilled(prevUpdateTime, crntTime))
 		{
-			// If not dead update it
+			event->markForDeletion();
+		}
+	}
+}
 
-			if(pevent->getStartTime() <= crntTime)
-			{
-				pevent->update(prevUpdateTime, crntTime);
-			}
+//==============================================================================
+void EventManager::updateAllEvents(F32 prevUpdateTime_, F32 crntTime_)
+{
+	prevUpdateTime = prevUpdateTime_;
+	crntTime = crntTime_;
+
+	// Start the events that their time has come
+	while(m_schedule.size() > 0)
+	{
+		Event* event = m_schedule[0];
+		if(event->startTime > crntTime)
+		{
+			break;
 		}
-		else
+
+		unscheduleEvent(event);
+
+		// Audjust starting time
+		if(event->startTime < 0.0)
 		{
-			// Dead
+			event->startTime = crntTime;
+		}
 
-			if(pevent->bitsEnabled(Event::EF_REANIMATE))
-			{
-				pevent->startTime = prevUpdateTime;
-				pevent->update(prevUpdateTime, crntTime);
-			}
-			else
+		activateEvent(event);
+	}
+
+	// Update the running events
+	SceneFrameAllocator<U8> frameAlloc = getSceneFrameAllocator();
+	Threadpool& threadpool = scene->_getThreadpool();
+
+	if(m_activeCount < MIN_EVENTS_FOR_PARALLEL_UPDATE
+		|| threadpool.getThreadsCount() == 1)
+	{
+		SceneFrameVector<Event*> dead(frameAlloc);
+
+		for(EventType* type : m_types)
+		{
+			if(type && type->m_active.size() > 0)
 			{
-				if(pevent->onKilled(prevUpdateTime, crntTime))
-				{
-					pevent->markForDeletion();
-				}
+				(*type->m_update)(&type->m_active[0], type->m_active.size(),
+					prevUpdateTime, crntTime, dead);
 			}
 		}
+
+		killEvents(dead);
 	}
-}
+	else
+	{
+		Array<UpdateEventsTask, Threadpool::MAX_THREADS> tasks;
+		Barrier barrier(threadpool.getThreadsCount());
 
-//==============================================================================
-void EventManager::deleteEventsMarkedForDeletion()
-{
-	SceneAllocator<Event> al = getSceneAllocator();
+		for(U i = 0; i < threadpool.getThreadsCount(); i++)
+		{
+			UpdateEventsTask& task = tasks[i];
+			task.m_manager = this;
+			task.m_barrier = &barrier;
+			task.m_dead =
+				frameAlloc.newInstance<SceneFrameVector<Event*>>(frameAlloc);
 
-	// Gather events for deletion
-	SceneFrameVector<EventsContainer::iterator> 
-		forDeletion(getSceneFrameAllocator());
+			threadpool.assignNewTask(i, &task);
+		}
 
-	for(EventsContainer::iterator it = events.begin(); it != events.end(); ++it)
-	{
-		Event* event = *it;
-		if(event->isMarkedForDeletion())
+		threadpool.waitForAllThreadsToFinish();
+
+		for(U i = 0; i < threadpool.getThreadsCount(); i++)
 		{
-			forDeletion.push_back(it);
+			killEvents(*tasks[i].m_dead);
 		}
 	}
+}
+
+//==============================================================================
+void EventManager::_eventMarkedForDeletion(Event* event)
+{
+	LockGuard<SpinLock> lock(m_markedForDeletionLock);
+	m_markedForDeletion.push_back(event);
+}
 
-	// Delete events
-	for(auto it : forDeletion)
+//==============================================================================
+void EventManager::deleteEventsMarkedForDeletion()
+{
+	// Deleting an event doesn't mark other events
+	for(Event* event : m_markedForDeletion)
 	{
-		Event* event = *it;
+		EventType& type = *m_types[event->m_typeId];
 
 		unregisterEvent(event);
-		al.deleteInstance(event);
+		event->~Event();
+		type.free(event);
 	}
+
+	m_markedForDeletion.clear();
 }
 
 } // end namespace anki
@@ -111,6 +111,20 @@ void GlBuffer::write(void* buff, U32 offset, U32 size)
 	glBufferSubData(m_target, offset, size, buff);
 }
 
+//==============================================================================
+void GlBuffer::copy(const GlBuffer& src, U32 srcOffset, U32 dstOffset, 
+	U32 size)
+{
+	ANKI_ASSERT(isCreated() && src.isCreated());
+	ANKI_ASSERT(srcOffset + size <= src.m_size);
+	ANKI_ASSERT(dstOffset + size <= m_size);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, src.m_glName);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_glName);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+		srcOffset, dstOffset, size);
+}
+
 //==============================================================================
 void GlBuffer::setBinding(GLuint binding) const
 {
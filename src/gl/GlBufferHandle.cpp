@@ -155,32 +155,50 @@ void GlBufferHandle::write(GlCommandBufferHandle& commands,
 }
 
 //==============================================================================
-void GlBufferHandle::bindShaderBufferInternal(GlCommandBufferHandle& commands,
-	I32 offset, I32 size, U32 bindingPoint)
+void GlBufferHandle::copy(GlCommandBufferHandle& commands, 
+	GlBufferHandle& src, PtrSize srcOffset, PtrSize dstOffset, PtrSize size)
 {
 	class Command: public GlCommand
 	{
 	public:
 		GlBufferHandle m_buff;
-		I32 m_offset;
-		I32 m_size;
-		U8 m_binding;
+		GlBufferHandle m_src;
+		PtrSize m_srcOffset;
+		PtrSize m_dstOffset;
+		PtrSize m_size;
 
-		Command(GlBufferHandle& buff, I32 offset, I32 size, U8 binding)
-			: m_buff(buff), m_offset(offset), m_size(size), m_binding(binding)
+		Command(GlBufferHandle& buff, GlBufferHandle& src, 
+			PtrSize srcOffset, PtrSize dstOffset, PtrSize size)
+			:	m_buff(buff), m_src(src), m_srcOffset(srcOffset), 
+				m_dstOffset(dstOffset), m_size(size)
 		{}
 
 		void operator()(GlCommandBuffer*)
 		{
-			U32 offset = (m_offset != -1) ? m_offset : 0;
-			U32 size = (m_size != -1) ? m_size : m_buff._get().getSize();
-
-			m_buff._get().setBindingRange(m_binding, offset, size);
+			m_buff._get().copy(
+				m_src._get(), m_srcOffset, m_dstOffset, m_size);
 		}
 	};
 
+	ANKI_ASSERT(isCreated() && src.isCreated());
+	commands._pushBackNewCommand<Command>(
+		*this, src, srcOffset, dstOffset, size);
+}
+
+//==============================================================================
+void GlBufferHandle::bindShaderBufferInternal(GlCommandBufferHandle& commands,
+	I32 offset, I32 size, U32 bindingPoint)
+{
 	ANKI_ASSERT(isCreated());
-	commands._pushBackNewCommand<Command>(*this, offset, size, bindingPoint);
+
+	GlBindShaderBufferCommandData cmd;
+	cmd.m_buff = &_get();
+	cmd.m_offset = offset;
+	cmd.m_size = size;
+	cmd.m_binding = bindingPoint;
+
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_SHADER_BUFFER, cmd);
 }
 
 //==============================================================================
@@ -193,74 +211,29 @@ void GlBufferHandle::bindVertexBuffer(
 	PtrSize offset,
 	U32 attribLocation)
 {
-	class Command: public GlCommand
-	{
-	public:
-		GlBufferHandle m_buff;
-		U32 m_elementSize;
-		GLenum m_type;
-		Bool8 m_normalized;
-		U32 m_stride;
-		U32 m_offset;
-		U32 m_attribLocation;
-
-		Command(GlBufferHandle& buff, U32 elementSize, GLenum type, 
-			Bool8 normalized, U32 stride, U32 offset, U32 attribLocation)
-		:	m_buff(buff), 
-			m_elementSize(elementSize), 
-			m_type(type), 
-			m_normalized(normalized), 
-			m_stride(stride),
-			m_offset(offset),
-			m_attribLocation(attribLocation)
-		{}
-
-		void operator()(GlCommandBuffer*)
-		{
-			GlBuffer& buff = m_buff._get();
-			ANKI_ASSERT(m_offset < m_buff.getSize());
-			
-			buff.setTarget(GL_ARRAY_BUFFER);
-			buff.bind();
-
-			glEnableVertexAttribArray(m_attribLocation);
-			glVertexAttribPointer(
-				m_attribLocation, 
-				m_elementSize, 
-				m_type, 
-				m_normalized,
-				m_stride, 
-				reinterpret_cast<const GLvoid*>(m_offset));
-		}
-	};
-
 	ANKI_ASSERT(isCreated());
-	commands._pushBackNewCommand<Command>(*this, elementSize, type, 
-		normalized, stride, offset, attribLocation);
+
+	GlBindVertexBufferCommandData cmd;
+	cmd.m_buff = &_get();
+	cmd.m_elementSize = elementSize;
+	cmd.m_type = type;
+	cmd.m_stride = stride;
+	cmd.m_offset = offset;
+	cmd.m_attribLocation = attribLocation;
+	cmd.m_normalized = normalized;
+
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_VERTEX_BUFFER, cmd);
 }
 
 //==============================================================================
 void GlBufferHandle::bindIndexBuffer(GlCommandBufferHandle& commands)
 {
-	class Command: public GlCommand
-	{
-	public:
-		GlBufferHandle m_buff;
-
-		Command(GlBufferHandle& buff)
-		:	m_buff(buff)
-		{}
-
-		void operator()(GlCommandBuffer*)
-		{
-			GlBuffer& buff = m_buff._get();
-			buff.setTarget(GL_ELEMENT_ARRAY_BUFFER);
-			buff.bind();
-		}
-	};
-
 	ANKI_ASSERT(isCreated());
-	commands._pushBackNewCommand<Command>(*this);
+
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_INDEX_BUFFER, 
+		&_get());
 }
 
 //==============================================================================
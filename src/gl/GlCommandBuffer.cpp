@@ -7,26 +7,39 @@
 #include "anki/gl/GlQueue.h"
 #include "anki/gl/GlDevice.h"
 #include "anki/gl/GlError.h"
+#include "anki/gl/GlTexture.h"
+#include "anki/gl/GlBuffer.h"
+#include "anki/gl/GlProgramPipeline.h"
+#include "anki/gl/GlFramebuffer.h"
 #include "anki/core/Logger.h"
 #include "anki/core/Counters.h"
-#include <cstring>
+#include <algorithm>
 
 namespace anki {
 
+//==============================================================================
+const PtrSize GlCommandBuffer::MAX_BLOCK_SIZE;
+
 //==============================================================================
 GlCommandBuffer::GlCommandBuffer(GlQueue* server, 
 	const GlCommandBufferInitHints& hints)
 :	m_server(server),
-	m_alloc(GlCommandBufferAllocator<GlCommand*>(ChainMemoryPool(
+	m_alloc(GlCommandBufferAllocator<U8>(ChainMemoryPool(
 		m_server->getAllocationCallback(),
 		m_server->getAllocationCallbackUserData(),
 		hints.m_chunkSize, 
 		hints.m_maxChunkSize, 
 		ChainMemoryPool::ChunkGrowMethod::ADD,
-		hints.m_chunkSize)))
+		hints.m_chunkSize))),
+	m_nextBlockSize(hints.m_chunkSize)
 {
 	//std::cout << hints.m_chunkSize << std::endl;
 	ANKI_ASSERT(m_server);
+
+	if(hints.m_frameScoped)
+	{
+		m_retirement = &m_server->getRetirementList();
+	}
 }
 
 //==============================================================================
@@ -35,15 +48,35 @@ GlCommandBuffer& GlCommandBuffer::operator=(GlCommandBuffer&& b)
 	destroy();
 	m_server = b.m_server; 
 	b.m_server = nullptr;
+
+	m_alloc = b.m_alloc;
+	b.m_alloc = GlCommandBufferAllocator<U8>();
 	
-	m_firstCommand = b.m_firstCommand;
-	b.m_firstCommand = nullptr;
+	m_firstBlock = b.m_firstBlock;
+	b.m_firstBlock = nullptr;
 	
+	m_lastBlock = b.m_lastBlock;
+	b.m_lastBlock = nullptr;
+
+	m_nextBlockSize = b.m_nextBlockSize;
+
 	m_lastCommand = b.m_lastCommand;
 	b.m_lastCommand = nullptr;
 
-	m_alloc = b.m_alloc;
-	b.m_alloc = GlCommandBufferAllocator<U8>();
+	m_paramBlocks = b.m_paramBlocks;
+	b.m_paramBlocks = nullptr;
+
+	m_parametersSize = b.m_parametersSize;
+	b.m_parametersSize = 0;
+
+	m_retirement = b.m_retirement;
+	b.m_retirement = nullptr;
+
+	m_refBlocks = b.m_refBlocks;
+	b.m_refBlocks = nullptr;
+
+	m_refCache = b.m_refCache;
+	b.m_refCache = {{}};
 
 	m_immutable = b.m_immutable;
 	b.m_immutable = false;
@@ -55,22 +88,78 @@ GlCommandBuffer& GlCommandBuffer::operator=(GlCommandBuffer&& b)
 void GlCommandBuffer::destroy()
 {
 #if ANKI_DEBUG
-	if(!m_executed && m_firstCommand)
+	if(!m_executed && m_firstBlock)
 	{
 		ANKI_LOGW("Chain contains commands but never executed. "
 			"This should only happen on exceptions");
 	}
 #endif
 
-	GlCommand* command = m_firstCommand;
-	while(command != nullptr)
+	// Destroy the generic commands and free the blocks
+	Block* block = m_firstBlock;
+	while(block != nullptr)
+	{
+		U8* it = block->getData();
+		U8* end = it + block->m_size;
+
+		while(it < end)
+		{
+			const CommandHeader& header = 
+				*reinterpret_cast<const CommandHeader*>(it);
+
+			if(header.m_opcode == GlCommandOpcode::GENERIC)
+			{
+				GenericCommand& generic = 
+					*reinterpret_cast<GenericCommand*>(it + sizeof(header));
+
+				if(generic.m_destroy)
+				{
+					(*generic.m_destroy)(generic.m_command);
+				}
+			}
+
+			it += header.m_size;
+		}
+
+		Block* next = block->m_next; // Get next before deleting
+		m_alloc.deallocate(block, sizeof(Block) + block->m_capacity);
+		block = next;
+	}
+
+	m_firstBlock = m_lastBlock = nullptr;
+	m_lastCommand = nullptr;
+
+	// Free the parameters
+	ParameterBlock* paramBlock = m_paramBlocks;
+	while(paramBlock != nullptr)
 	{
-		GlCommand* next = command->m_nextCommand; // Get next before deleting
-		m_alloc.deleteInstance(command);
-		command = next;
+		ParameterBlock* next = paramBlock->m_next;
+		m_alloc.deleteInstance(paramBlock);
+		paramBlock = next;
 	}
 
-	ANKI_ASSERT(m_alloc.getMemoryPool().getUsersCount() == 1 
+	m_paramBlocks = nullptr;
+	m_parametersSize = 0;
+
+	// Release the references
+	ReferenceBlock* refBlock = m_refBlocks;
+	while(refBlock != nullptr)
+	{
+		for(U i = 0; i < refBlock->m_count; i++)
+		{
+			Reference& ref = refBlock->m_refs[i];
+			(*ref.m_release)(ref.m_handle);
+		}
+
+		ReferenceBlock* next = refBlock->m_next;
+		m_alloc.deleteInstance(refBlock);
+		refBlock = next;
+	}
+
+	m_refBlocks = nullptr;
+
+	ANKI_ASSERT((m_server == nullptr 
+		|| m_alloc.getMemoryPool().getUsersCount() == 1)
 		&& "Someone is holding a reference to the command buffer's allocator");
 
 	m_alloc = GlCommandBufferAllocator<U8>();
@@ -83,30 +172,395 @@ GlGlobalHeapAllocator<U8> GlCommandBuffer::getGlobalAllocator() const
 }
 
 //==============================================================================
-void GlCommandBuffer::executeAllCommands()
+void GlCommandBuffer::newBlock(PtrSize commandSize)
+{
+	PtrSize capacity = std::max(m_nextBlockSize, commandSize);
+	PtrSize alignment = 16;
+
+	Block* block = reinterpret_cast<Block*>(
+		m_alloc.allocate(sizeof(Block) + capacity, &alignment));
+	::new(block) Block();
+	block->m_capacity = capacity;
+
+	if(m_lastBlock)
+	{
+		m_lastBlock->m_next = block;
+	}
+	else
+	{
+		m_firstBlock = block;
+	}
+
+	m_lastBlock = block;
+	m_nextBlockSize = std::min(m_nextBlockSize * 2, MAX_BLOCK_SIZE);
+}
+
+//==============================================================================
+GlCommandBuffer::Reference& GlCommandBuffer::newReference()
+{
+	if(m_refBlocks == nullptr 
+		|| m_refBlocks->m_count == ReferenceBlock::REFERENCES_COUNT)
+	{
+		ReferenceBlock* block = m_alloc.newInstance<ReferenceBlock>();
+		block->m_next = m_refBlocks;
+		m_refBlocks = block;
+	}
+
+	return m_refBlocks->m_refs[m_refBlocks->m_count++];
+}
+
+//==============================================================================
+void GlCommandBuffer::addParameter(PtrSize parameterOffset, 
+	PtrSize payloadOffset, PtrSize size)
+{
+	ANKI_ASSERT(m_immutable == false);
+	ANKI_ASSERT(m_lastCommand != nullptr 
+		&& m_lastCommand->m_opcode != GlCommandOpcode::GENERIC
+		&& "Only the payload of inline commands can be a parameter");
+	ANKI_ASSERT(sizeof(CommandHeader) + payloadOffset + size 
+		<= m_lastCommand->m_size);
+	ANKI_ASSERT(size > 0);
+
+	if(m_paramBlocks == nullptr 
+		|| m_paramBlocks->m_count == ParameterBlock::PARAMETERS_COUNT)
+	{
+		ParameterBlock* block = m_alloc.newInstance<ParameterBlock>();
+		block->m_next = m_paramBlocks;
+		m_paramBlocks = block;
+	}
+
+	Parameter& param = m_paramBlocks->m_params[m_paramBlocks->m_count++];
+	param.m_payloadPart = reinterpret_cast<U8*>(m_lastCommand) 
+		+ sizeof(CommandHeader) + payloadOffset;
+	param.m_offset = parameterOffset;
+	param.m_size = size;
+
+	m_parametersSize = 
+		std::max<U32>(m_parametersSize, parameterOffset + size);
+}
+
+//==============================================================================
+void GlCommandBuffer::executeAllCommands(const void* parameters)
 {
-	ANKI_ASSERT(m_firstCommand != nullptr && "Empty command buffer");
-	ANKI_ASSERT(m_lastCommand != nullptr && "Empty command buffer");
+	ANKI_ASSERT(m_firstBlock != nullptr && "Empty command buffer");
 #if ANKI_DEBUG
 	m_executed = true;
 #endif
+
+	// Patch the payloads. Only the server thread executes so it's safe
+	if(m_paramBlocks)
+	{
+		ANKI_ASSERT(parameters != nullptr && "Parameters are missing");
+		const U8* values = static_cast<const U8*>(parameters);
+
+		for(ParameterBlock* block = m_paramBlocks; block != nullptr; 
+			block = block->m_next)
+		{
+			for(U i = 0; i < block->m_count; i++)
+			{
+				const Parameter& param = block->m_params[i];
+				std::memcpy(param.m_payloadPart, values + param.m_offset, 
+					param.m_size);
+			}
+		}
+	}
 	
-	GlCommand* command = m_firstCommand;
+	for(Block* block = m_firstBlock; block != nullptr; block = block->m_next)
+	{
+		executeBlock(*block);
+	}
+}
+
+//==============================================================================
+void GlCommandBuffer::executeBlock(Block& block)
+{
+	const U8* it = block.getData();
+	const U8* end = it + block.m_size;
 
-	while(command != nullptr)
+	while(it < end)
 	{
-		(*command)(this);
-		ANKI_CHECK_GL_ERROR();
+		const CommandHeader& header = 
+			*reinterpret_cast<const CommandHeader*>(it);
+		const void* data = it + sizeof(CommandHeader);
+		const U32* u = static_cast<const U32*>(data);
+		const F32* f = static_cast<const F32*>(data);
+
+		switch(header.m_opcode)
+		{
+		case GlCommandOpcode::GENERIC:
+			{
+				const GenericCommand& generic = 
+					*static_cast<const GenericCommand*>(data);
+				(*generic.m_execute)(generic.m_command, this);
+			}
+			break;
+		case GlCommandOpcode::USER_CALLBACK:
+			{
+				const GlUserCallbackCommandData& cmd = 
+					*static_cast<const GlUserCallbackCommandData*>(data);
+				(*cmd.m_callback)(cmd.m_userData);
+			}
+			break;
+		case GlCommandOpcode::EXECUTE_COMMAND_BUFFER:
+			{
+				const GlExecuteCommandBufferCommandData& cmd = 
+					*static_cast<const GlExecuteCommandBufferCommandData*>(
+					data);
+				cmd.m_commands->executeAllCommands(
+					(cmd.m_parametersSize) ? &cmd + 1 : nullptr);
+			}
+			break;
+		case GlCommandOpcode::ENABLE:
+			if(u[1])
+			{
+				glEnable(u[0]);
+			}
+			else
+			{
+				glDisable(u[0]);
+			}
+			break;
+		case GlCommandOpcode::CLEAR_COLOR:
+			glClearColor(f[0], f[1], f[2], f[3]);
+			break;
+		case GlCommandOpcode::CLEAR_DEPTH:
+			glClearDepth(f[0]);
+			break;
+		case GlCommandOpcode::CLEAR_STENCIL:
+			glClearStencil(u[0]);
+			break;
+		case GlCommandOpcode::CLEAR:
+			glClear(u[0]);
+			break;
+		case GlCommandOpcode::VIEWPORT:
+			{
+				const U16* v = static_cast<const U16*>(data);
+				GlState& state = m_server->getState();
+
+				if(state.m_viewport[0] != v[0] 
+					|| state.m_viewport[1] != v[1]
+					|| state.m_viewport[2] != v[2] 
+					|| state.m_viewport[3] != v[3])
+				{
+					glViewport(v[0], v[1], v[2], v[3]);
+					state.m_viewport = {{v[0], v[1], v[2], v[3]}};
+				}
+			}
+			break;
+		case GlCommandOpcode::COLOR_MASK:
+			{
+				const Bool8* v = static_cast<const Bool8*>(data);
+				glColorMask(v[0], v[1], v[2], v[3]);
+			}
+			break;
+		case GlCommandOpcode::DEPTH_FUNCTION:
+			glDepthFunc(u[0]);
+			break;
+		case GlCommandOpcode::DEPTH_MASK:
+			glDepthMask(*static_cast<const Bool8*>(data));
+			break;
+		case GlCommandOpcode::STENCIL_FUNCTION:
+			glStencilFunc(u[0], u[1], u[2]);
+			break;
+		case GlCommandOpcode::STENCIL_MASK:
+			glStencilMask(u[0]);
+			break;
+		case GlCommandOpcode::STENCIL_OPERATIONS:
+			glStencilOp(u[0], u[1], u[2]);
+			break;
+		case GlCommandOpcode::BLEND_EQUATION:
+			glBlendEquation(u[0]);
+			break;
+		case GlCommandOpcode::BLEND_FUNCTIONS:
+			{
+				GlState& state = m_server->getState();
+
+				if(state.m_blendSfunc != u[0] || state.m_blendDfunc != u[1])
+				{
+					glBlendFunc(u[0], u[1]);
+
+					state.m_blendSfunc = u[0];
+					state.m_blendDfunc = u[1];
+				}
+			}
+			break;
+		case GlCommandOpcode::BLEND_COLOR:
+			glBlendColor(f[0], f[1], f[2], f[3]);
+			break;
+		case GlCommandOpcode::PATCH_VERTEX_COUNT:
+			glPatchParameteri(GL_PATCH_VERTICES, u[0]);
+			break;
+		case GlCommandOpcode::CULL_FACE:
+			glCullFace(u[0]);
+			break;
+		case GlCommandOpcode::POLYGON_OFFSET:
+			glPolygonOffset(f[0], f[1]);
+			break;
+		case GlCommandOpcode::BIND_TEXTURE:
+			{
+				const GlBindTextureCommandData& cmd = 
+					*static_cast<const GlBindTextureCommandData*>(data);
+				cmd.m_tex->bind(cmd.m_unit);
+			}
+			break;
+		case GlCommandOpcode::BIND_TEXTURES:
+			{
+				const GlBindTexturesCommandData& cmd = 
+					*static_cast<const GlBindTexturesCommandData*>(data);
+				const GlTexture* const* texes = 
+					reinterpret_cast<const GlTexture* const*>(&cmd + 1);
+
+				Array<GLuint, 16> names;
+				ANKI_ASSERT(cmd.m_count > 0 && cmd.m_count <= names.size());
+				for(U i = 0; i < cmd.m_count; i++)
+				{
+					names[i] = texes[i]->getGlName();
+				}
+
+				glBindTextures(cmd.m_first, cmd.m_count, &names[0]);
+			}
+			break;
+		case GlCommandOpcode::BIND_SAMPLER:
+			{
+				const GlBindSamplerCommandData& cmd = 
+					*static_cast<const GlBindSamplerCommandData*>(data);
+				cmd.m_sampler->bind(cmd.m_unit);
+			}
+			break;
+		case GlCommandOpcode::BIND_SHADER_BUFFER:
+			{
+				const GlBindShaderBufferCommandData& cmd = 
+					*static_cast<const GlBindShaderBufferCommandData*>(data);
+
+				U32 offset = (cmd.m_offset != -1) ? cmd.m_offset : 0;
+				U32 size = (cmd.m_size != -1) 
+					? cmd.m_size : cmd.m_buff->getSize();
+
+				cmd.m_buff->setBindingRange(cmd.m_binding, offset, size);
+			}
+			break;
+		case GlCommandOpcode::BIND_VERTEX_BUFFER:
+			{
+				const GlBindVertexBufferCommandData& cmd = 
+					*static_cast<const GlBindVertexBufferCommandData*>(data);
+				GlBuffer& buff = *cmd.m_buff;
+				ANKI_ASSERT(cmd.m_offset < buff.getSize());
+			
+				buff.setTarget(GL_ARRAY_BUFFER);
+				buff.bind();
 
-		command = command->m_nextCommand;
+				glEnableVertexAttribArray(cmd.m_attribLocation);
+				glVertexAttribPointer(
+					cmd.m_attribLocation, 
+					cmd.m_elementSize, 
+					cmd.m_type, 
+					cmd.m_normalized,
+					cmd.m_stride, 
+					reinterpret_cast<const GLvoid*>((PtrSize)cmd.m_offset));
+			}
+			break;
+		case GlCommandOpcode::BIND_INDEX_BUFFER:
+			{
+				GlBuffer& buff = **static_cast<GlBuffer* const*>(data);
+				buff.setTarget(GL_ELEMENT_ARRAY_BUFFER);
+				buff.bind();
+			}
+			break;
+		case GlCommandOpcode::BIND_PROGRAM_PIPELINE:
+			{
+				GlProgramPipeline& ppline = 
+					**static_cast<GlProgramPipeline* const*>(data);
+				GlState& state = m_server->getState();
+
+				if(state.m_crntPpline != ppline.getGlName())
+				{
+					ppline.bind();
+					state.m_crntPpline = ppline.getGlName();
+				}
+			}
+			break;
+		case GlCommandOpcode::BIND_FRAMEBUFFER:
+			{
+				const GlBindFramebufferCommandData& cmd = 
+					*static_cast<const GlBindFramebufferCommandData*>(data);
+				cmd.m_fb->bind(cmd.m_invalidate);
+			}
+			break;
+		case GlCommandOpcode::DRAW_ELEMENTS:
+			{
+				const GlDrawElementsCommandData& cmd = 
+					*static_cast<const GlDrawElementsCommandData*>(data);
+
+				GLenum indicesType = 0;
+				switch(cmd.m_indexSize)
+				{
+				case 1:
+					indicesType = GL_UNSIGNED_BYTE;
+					break;
+				case 2:
+					indicesType = GL_UNSIGNED_SHORT;
+					break;
+				case 4:
+					indicesType = GL_UNSIGNED_INT;
+					break;
+				default:
+					ANKI_ASSERT(0);
+					break;
+				};
+
+				glDrawElementsInstancedBaseVertexBaseInstance(
+					cmd.m_mode,
+					cmd.m_info.m_count,
+					indicesType,
+					(const void*)(PtrSize)(
+						cmd.m_info.m_firstIndex * cmd.m_indexSize),
+					cmd.m_info.m_instanceCount,
+					cmd.m_info.m_baseVertex,
+					cmd.m_info.m_baseInstance);
+
+				ANKI_COUNTER_INC(GL_DRAWCALLS_COUNT, (U64)1);
+			}
+			break;
+		case GlCommandOpcode::DRAW_ARRAYS:
+			{
+				const GlDrawArraysCommandData& cmd = 
+					*static_cast<const GlDrawArraysCommandData*>(data);
+
+				glDrawArraysInstancedBaseInstance(
+					cmd.m_mode,
+					cmd.m_info.m_first,
+					cmd.m_info.m_count,
+					cmd.m_info.m_instanceCount,
+					cmd.m_info.m_baseInstance);
+
+				ANKI_COUNTER_INC(GL_DRAWCALLS_COUNT, (U64)1);
+			}
+			break;
+		default:
+			ANKI_ASSERT(0 && "Wrong opcode");
+			break;
+		}
+
+		ANKI_CHECK_GL_ERROR();
+		it += header.m_size;
 	}
 }
 
 //==============================================================================
 GlCommandBufferInitHints GlCommandBuffer::computeInitHints() const
 {
+	// Fit the whole stream in the first block
+	PtrSize streamSize = 0;
+	for(Block* block = m_firstBlock; block != nullptr; block = block->m_next)
+	{
+		streamSize += block->m_size;
+	}
+
 	GlCommandBufferInitHints out;
-	out.m_chunkSize = m_alloc.getMemoryPool().getAllocatedSize() + 16;
+	out.m_frameScoped = m_retirement != nullptr;
+	out.m_chunkSize = std::max<PtrSize>(streamSize + sizeof(Block), 
+		out.m_chunkSize);
+	out.m_chunkSize = std::min(out.m_chunkSize, MAX_BLOCK_SIZE);
 
 	ANKI_COUNTER_INC(GL_QUEUES_SIZE, 
 		U64(m_alloc.getMemoryPool().getAllocatedSize()));
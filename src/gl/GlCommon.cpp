@@ -4,9 +4,15 @@
 // http://www.anki3d.org/LICENSE
 
 #include "anki/gl/GlCommon.h"
+#include "anki/gl/GlHandle.h"
 
 namespace anki {
 
+//==============================================================================
+#if ANKI_ENABLE_COUNTERS
+Atomic<U64> glHandleAtomicOpsCount(0);
+#endif
+
 //==============================================================================
 U computeShaderTypeIndex(const GLenum glType)
 {
@@ -4,11 +4,28 @@
 // http://www.anki3d.org/LICENSE
 
 #include "anki/gl/GlDevice.h"
+#include "anki/gl/GlRingBuffer.h"
 #include "anki/core/Timestamp.h"
+#include "anki/core/Counters.h"
 #include <cstring>
 
 namespace anki {
 
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The initial and the max sizes of the transient buffers
+static const Array<Array<PtrSize, 2>, (U)GlTransientMemoryType::COUNT> 
+	transientSizes = {{
+	{{1024 * 1024, 16 * 1024 * 1024}}, // UNIFORM
+	{{1024 * 1024, 32 * 1024 * 1024}}, // STORAGE
+	{{1024 * 1024, 16 * 1024 * 1024}}}}; // VERTEX
+
+//==============================================================================
+// GlDevice                                                                    =
+//==============================================================================
+
 //==============================================================================
 GlDevice::GlDevice(
 	GlCallback makeCurrentCallback, void* context,
@@ -33,13 +50,54 @@ GlDevice::GlDevice(
 		registerDebugMessages);
 
 	syncClientServer();
+
+	// Create the transient buffers
+	for(U i = 0; i < m_transientBuffers.size(); i++)
+	{
+		GLenum target;
+		PtrSize alignment;
+
+		switch((GlTransientMemoryType)i)
+		{
+		case GlTransientMemoryType::UNIFORM:
+			target = GL_UNIFORM_BUFFER;
+			alignment = getBufferOffsetAlignment(target);
+			break;
+		case GlTransientMemoryType::STORAGE:
+			target = GL_SHADER_STORAGE_BUFFER;
+			alignment = getBufferOffsetAlignment(target);
+			break;
+		default:
+			ANKI_ASSERT((GlTransientMemoryType)i 
+				== GlTransientMemoryType::VERTEX);
+			target = GL_ARRAY_BUFFER;
+			alignment = 16;
+			break;
+		}
+
+		m_transientBuffers[i] = m_alloc.newInstance<GlRingBuffer>();
+		m_transientBuffers[i]->create(this, target, alignment, 
+			transientSizes[i][0], transientSizes[i][1]);
+	}
 }
 
 //==============================================================================
 void GlDevice::destroy()
 {
+	// Release the transient buffers while the server is still running
+	for(GlRingBuffer*& buff : m_transientBuffers)
+	{
+		if(buff)
+		{
+			buff->destroy();
+			m_alloc.deleteInstance(buff);
+			buff = nullptr;
+		}
+	}
+
 	if(m_queue)
 	{
+		m_queue->getRetirementList().destroy();
 		m_queue->stop();
 		m_alloc.deleteInstance(m_queue);
 	}
@@ -78,4 +136,28 @@ PtrSize GlDevice::getBufferOffsetAlignment(GLenum target)
 	}
 }
 
+//==============================================================================
+void* GlDevice::allocateTransientMemory(GlTransientMemoryType type, 
+	PtrSize size, GlBufferHandle& buff, PtrSize& offset)
+{
+	return m_transientBuffers[(U)type]->allocate(size, buff, offset);
+}
+
+//==============================================================================
+void GlDevice::endFrame(GlCommandBufferHandle& commands)
+{
+	for(GlRingBuffer* buff : m_transientBuffers)
+	{
+		buff->endFrame(commands);
+	}
+
+	m_queue->getRetirementList().endFrame(commands);
+
+#if ANKI_ENABLE_COUNTERS
+	U64 atomicOps = glHandleAtomicOpsCount.load();
+	ANKI_COUNTER_INC(GL_HANDLE_ATOMIC_OPS, atomicOps - m_atomicOpsCount);
+	m_atomicOpsCount = atomicOps;
+#endif
+}
+
 } // end namespace anki
@@ -5,6 +5,7 @@
 
 #include "anki/gl/GlFramebuffer.h"
 #include "anki/gl/GlTexture.h"
+#include "anki/gl/GlBuffer.h"
 
 namespace anki {
 
@@ -212,5 +213,18 @@ void GlFramebuffer::blit(const GlFramebuffer& b,
 		linear ? GL_LINEAR : GL_NEAREST);
 }
 
+//==============================================================================
+void GlFramebuffer::readPixels(U32 x, U32 y, U32 width, U32 height, 
+	GLenum format, GLenum type, const GlBuffer& buff, PtrSize offset) const
+{
+	ANKI_ASSERT(offset < buff.getSize());
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_glName);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buff.getGlName());
+	glReadPixels(x, y, width, height, format, type, 
+		reinterpret_cast<void*>(offset));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
 } // end namespace anki
 
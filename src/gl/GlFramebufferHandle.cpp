@@ -5,6 +5,7 @@
 
 #include "anki/gl/GlFramebufferHandle.h"
 #include "anki/gl/GlHandleDeferredDeleter.h"
+#include "anki/gl/GlBufferHandle.h"
 
 namespace anki {
 
@@ -85,24 +86,14 @@ GlFramebufferHandle::~GlFramebufferHandle()
 //==============================================================================
 void GlFramebufferHandle::bind(GlCommandBufferHandle& commands, Bool invalidate)
 {
-	class Command: public GlCommand
-	{
-	public:
-		GlFramebufferHandle m_fb;
-		Bool8 m_invalidate;
+	ANKI_ASSERT(isCreated());
 
-		Command(GlFramebufferHandle& fb, Bool invalidate)
-		:	m_fb(fb), 
-			m_invalidate(invalidate)
-		{}
+	GlBindFramebufferCommandData cmd;
+	cmd.m_fb = &_get();
+	cmd.m_invalidate = invalidate;
 
-		void operator()(GlCommandBuffer*)
-		{
-			m_fb._get().bind(m_invalidate);
-		}
-	};
-
-	commands._pushBackNewCommand<Command>(*this, invalidate);
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_FRAMEBUFFER, cmd);
 }
 
 //==============================================================================
@@ -147,5 +138,42 @@ void GlFramebufferHandle::blit(GlCommandBufferHandle& commands,
 		*this, b, sourceRect, destRect, attachmentMask, linear);
 }
 
-} // end namespace anki
+//==============================================================================
+void GlFramebufferHandle::readPixels(GlCommandBufferHandle& commands,
+	U32 x, U32 y, U32 width, U32 height,
+	GLenum format, GLenum type,
+	GlBufferHandle& buff, PtrSize offset)
+{
+	class Command: public GlCommand
+	{
+	public:
+		GlFramebufferHandle m_fb;
+		GlBufferHandle m_buff;
+		Array<U32, 4> m_rect;
+		GLenum m_format;
+		GLenum m_type;
+		PtrSize m_offset;
+
+		Command(GlFramebufferHandle& fb, GlBufferHandle& buff,
+			const Array<U32, 4>& rect, GLenum format, GLenum type, 
+			PtrSize offset)
+		:	m_fb(fb),
+			m_buff(buff),
+			m_rect(rect),
+			m_format(format),
+			m_type(type),
+			m_offset(offset)
+		{}
 
+		void operator()(GlCommandBuffer*)
+		{
+			m_fb._get().readPixels(m_rect[0], m_rect[1], m_rect[2], m_rect[3],
+				m_format, m_type, m_buff._get(), m_offset);
+		}
+	};
+
+	commands._pushBackNewCommand<Command>(*this, buff, 
+		Array<U32, 4>{{x, y, width, height}}, format, type, offset);
+}
+
+} // end namespace anki
@@ -86,29 +86,9 @@ void GlProgramPipelineHandle::bind(GlCommandBufferHandle& commands)
 {
 	ANKI_ASSERT(isCreated());
 
-	class Command: public GlCommand
-	{
-	public:
-		GlProgramPipelineHandle m_ppline;
-
-		Command(GlProgramPipelineHandle& ppline)
-			: m_ppline(ppline)
-		{}
-
-		void operator()(GlCommandBuffer* commands)
-		{
-			GlState& state = commands->getQueue().getState();
-
-			if(state.m_crntPpline != m_ppline._get().getGlName())
-			{
-				m_ppline._get().bind();
-
-				state.m_crntPpline = m_ppline._get().getGlName();
-			}
-		}
-	};
-
-	commands._pushBackNewCommand<Command>(*this);
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_PROGRAM_PIPELINE, 
+		&_get());
 }
 
 //==============================================================================
@@ -21,7 +21,8 @@ GlQueue::GlQueue(GlDevice* device,
 	m_tail(0), 
 	m_head(0),
 	m_renderingThreadSignal(0),
-	m_thread("anki_gl")
+	m_thread("anki_gl"),
+	m_retirement(this)
 {
 	ANKI_ASSERT(m_device);
 }
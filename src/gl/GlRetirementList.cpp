@@ -0,0 +1,167 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/gl/GlRetirementList.h"
+#include "anki/gl/GlQueue.h"
+#include "anki/gl/GlDevice.h"
+
+namespace anki {
+
+//==============================================================================
+GlRetirementList::GlRetirementList(GlQueue* queue)
+:	m_queue(queue),
+	m_alloc(HeapMemoryPool(queue->getAllocationCallback(),
+		queue->getAllocationCallbackUserData()))
+{}
+
+//==============================================================================
+GlRetirementList::~GlRetirementList()
+{
+	destroy();
+
+	ReferenceBlock* block = m_freeBlocks;
+	while(block != nullptr)
+	{
+		ReferenceBlock* next = block->m_next;
+		m_alloc.deleteInstance(block);
+		block = next;
+	}
+
+	m_freeBlocks = nullptr;
+}
+
+//==============================================================================
+GlRetirementList::Reference& GlRetirementList::newReference()
+{
+	LockGuard<SpinLock> lock(m_lock);
+
+	if(m_crntFrameRefs == nullptr
+		|| m_crntFrameRefs->m_count == ReferenceBlock::REFERENCES_COUNT)
+	{
+		ReferenceBlock* block = m_freeBlocks;
+		if(block)
+		{
+			m_freeBlocks = block->m_next;
+			block->m_count = 0;
+		}
+		else
+		{
+			block = m_alloc.newInstance<ReferenceBlock>();
+		}
+
+		block->m_next = m_crntFrameRefs;
+		m_crntFrameRefs = block;
+	}
+
+	++m_crntFrameRefsCount;
+	return m_crntFrameRefs->m_refs[m_crntFrameRefs->m_count++];
+}
+
+//==============================================================================
+void GlRetirementList::releaseReferences(ReferenceBlock* blocks)
+{
+	while(blocks != nullptr)
+	{
+		for(U i = 0; i < blocks->m_count; i++)
+		{
+			Reference& ref = blocks->m_refs[i];
+			(*ref.m_release)(ref.m_handle);
+		}
+
+		ReferenceBlock* next = blocks->m_next;
+		blocks->m_next = m_freeBlocks;
+		m_freeBlocks = blocks;
+		blocks = next;
+	}
+}
+
+//==============================================================================
+void GlRetirementList::retireFrames()
+{
+	while(m_framesCount > 0)
+	{
+		Frame& frame = m_frames[m_firstFrame];
+		if(!frame.m_fence.isSignaled())
+		{
+			break;
+		}
+
+		releaseReferences(frame.m_refs);
+		frame.m_refs = nullptr;
+		frame.m_fence = GlFenceHandle();
+		m_firstFrame = (m_firstFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		--m_framesCount;
+	}
+}
+
+//==============================================================================
+void GlRetirementList::waitOldestFrame()
+{
+	ANKI_ASSERT(m_framesCount > 0);
+
+	GlCommandBufferHandle commands(&m_queue->getDevice());
+	m_frames[m_firstFrame].m_fence.wait(commands);
+	commands.finish();
+
+	retireFrames();
+}
+
+//==============================================================================
+void GlRetirementList::endFrame(GlCommandBufferHandle& commands)
+{
+	// Check the fences of the previous frames without blocking the server
+	for(U32 i = 0; i < m_framesCount; i++)
+	{
+		Frame& frame = m_frames[(m_firstFrame + i) % MAX_FRAMES_IN_FLIGHT];
+		frame.m_fence.poll(commands);
+	}
+
+	retireFrames();
+
+	// Don't let the GPU fall too far behind
+	if(m_framesCount == MAX_FRAMES_IN_FLIGHT)
+	{
+		waitOldestFrame();
+	}
+
+	// Fence the current frame
+	Frame& frame =
+		m_frames[(m_firstFrame + m_framesCount) % MAX_FRAMES_IN_FLIGHT];
+	frame.m_fence = GlFenceHandle(commands);
+	frame.m_refs = m_crntFrameRefs;
+	++m_framesCount;
+
+	m_crntFrameRefs = nullptr;
+	m_lastFrameRefsCount = m_crntFrameRefsCount;
+	m_crntFrameRefsCount = 0;
+
+	// Skip zero. See m_crntFrame
+	m_crntFrame = (m_crntFrame == MAX_U32) ? 1 : m_crntFrame + 1;
+}
+
+//==============================================================================
+void GlRetirementList::destroy()
+{
+	for(U32 i = 0; i < m_framesCount; i++)
+	{
+		Frame& frame = m_frames[(m_firstFrame + i) % MAX_FRAMES_IN_FLIGHT];
+		releaseReferences(frame.m_refs);
+		frame.m_refs = nullptr;
+		frame.m_fence = GlFenceHandle();
+	}
+
+	m_firstFrame = 0;
+	m_framesCount = 0;
+
+	releaseReferences(m_crntFrameRefs);
+	m_crntFrameRefs = nullptr;
+	m_crntFrameRefsCount = 0;
+
+	// The objects may be retained again
+	m_crntFrame = (m_crntFrame == MAX_U32) ? 1 : m_crntFrame + 1;
+}
+
+} // end namespace anki
+
@@ -0,0 +1,265 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/gl/GlRingBuffer.h"
+#include "anki/gl/GlDevice.h"
+#include "anki/util/Exception.h"
+#include "anki/util/Functions.h"
+#include "anki/core/Counters.h"
+#include "anki/core/Logger.h"
+
+namespace anki {
+
+//==============================================================================
+// GlRingAllocator                                                             =
+//==============================================================================
+
+//==============================================================================
+void GlRingAllocator::create(PtrSize alignment, PtrSize size)
+{
+	ANKI_ASSERT(isPowerOfTwo(alignment));
+	ANKI_ASSERT(size > 0 && size % alignment == 0);
+
+	m_alignment = alignment;
+	resize(size);
+}
+
+//==============================================================================
+void GlRingAllocator::resize(PtrSize size)
+{
+	ANKI_ASSERT(m_framesCount == 0);
+	ANKI_ASSERT(size > 0 && size % m_alignment == 0);
+
+	m_size = size;
+	m_head = m_tail = 0;
+}
+
+//==============================================================================
+Bool GlRingAllocator::allocate(PtrSize size, PtrSize& offset)
+{
+	ANKI_ASSERT(size > 0 && m_size > 0);
+
+	// Align and wrap if there is no room at the end of the buffer
+	U64 head = getAlignedRoundUp(m_alignment, m_head);
+	PtrSize off = head % m_size;
+	if(off + size > m_size)
+	{
+		head += m_size - off;
+		off = 0;
+	}
+
+	if(head + size - m_tail > m_size)
+	{
+		return false;
+	}
+
+	m_frameUsedSize += head + size - m_head;
+	m_head = head + size;
+	offset = off;
+	return true;
+}
+
+//==============================================================================
+U32 GlRingAllocator::endFrame()
+{
+	ANKI_ASSERT(m_framesCount < MAX_FRAMES_IN_FLIGHT);
+
+	U32 frame = (m_firstFrame + m_framesCount) % MAX_FRAMES_IN_FLIGHT;
+	m_frameEnds[frame] = m_head;
+	++m_framesCount;
+
+	m_frameUsedSize = 0;
+	return frame;
+}
+
+//==============================================================================
+void GlRingAllocator::retireOldestFrame()
+{
+	ANKI_ASSERT(m_framesCount > 0);
+
+	m_tail = m_frameEnds[m_firstFrame];
+	m_firstFrame = (m_firstFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	--m_framesCount;
+}
+
+//==============================================================================
+PtrSize GlRingAllocator::getGrowSize(PtrSize size) const
+{
+	return std::max(m_size * 2,
+		getAlignedRoundUp(m_alignment, m_frameUsedSize + size) * 2);
+}
+
+//==============================================================================
+// GlRingBuffer                                                                =
+//==============================================================================
+
+//==============================================================================
+void GlRingBuffer::create(GlDevice* device, GLenum target, PtrSize alignment,
+	PtrSize size, PtrSize maxSize)
+{
+	ANKI_ASSERT(device);
+	ANKI_ASSERT(size > 0 && size <= maxSize);
+	ANKI_ASSERT(maxSize % alignment == 0);
+
+	m_device = device;
+	m_target = target;
+	m_maxSize = maxSize;
+
+	createBuffer(size);
+	m_ring.create(alignment, size);
+}
+
+//==============================================================================
+void GlRingBuffer::destroy()
+{
+	for(GlFenceHandle& fence : m_fences)
+	{
+		fence = GlFenceHandle();
+	}
+
+	m_buff = GlBufferHandle();
+	m_mapping = nullptr;
+}
+
+//==============================================================================
+void GlRingBuffer::createBuffer(PtrSize size)
+{
+	GlCommandBufferHandle commands(m_device);
+	m_buff = GlBufferHandle(commands, m_target, size,
+		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+	commands.flush();
+
+	// That will serialize
+	m_mapping = static_cast<U8*>(m_buff.getPersistentMappingAddress());
+	ANKI_ASSERT(m_mapping);
+}
+
+//==============================================================================
+Bool GlRingBuffer::retireFrames()
+{
+	Bool released = false;
+
+	while(m_ring.getFramesCount() > 0)
+	{
+		GlFenceHandle& fence = m_fences[m_ring.getOldestFrame()];
+		if(!fence.isSignaled())
+		{
+			break;
+		}
+
+		fence = GlFenceHandle();
+		m_ring.retireOldestFrame();
+		released = true;
+	}
+
+	return released;
+}
+
+//==============================================================================
+void GlRingBuffer::waitOldestFrame()
+{
+	ANKI_ASSERT(m_ring.getFramesCount() > 0);
+
+	// Use a new client sync because more than one thread may wait
+	GlCommandBufferHandle commands(m_device);
+	GlClientSyncHandle sync(commands);
+	m_fences[m_ring.getOldestFrame()].wait(commands);
+	sync.sync(commands);
+	commands.flush();
+	sync.wait();
+
+	++m_waitsCount;
+	ANKI_COUNTER_INC(GL_TRANSIENT_WAITS_COUNT, U64(1));
+
+	Bool released = retireFrames();
+	(void)released;
+	ANKI_ASSERT(released);
+}
+
+//==============================================================================
+void* GlRingBuffer::allocate(PtrSize size, GlBufferHandle& buff,
+	PtrSize& offset)
+{
+	ANKI_ASSERT(size > 0);
+	LockGuard<Mutex> lock(m_mtx);
+
+	while(1)
+	{
+		if(m_ring.allocate(size, offset))
+		{
+			buff = m_buff;
+			return m_mapping + offset;
+		}
+
+		// Doesn't fit. Try to reclaim memory of past frames and if it's not
+		// possible wait for the GPU
+		if(retireFrames())
+		{
+			continue;
+		}
+
+		if(m_ring.getFramesCount() > 0)
+		{
+			waitOldestFrame();
+			continue;
+		}
+
+		// The current frame alone doesn't fit. Grow. The allocations of the
+		// current frame keep a reference to the old buffer
+		PtrSize newSize = m_ring.getGrowSize(size);
+
+		if(newSize > m_maxSize)
+		{
+			if(m_ring.getSize() >= m_maxSize)
+			{
+				throw ANKI_EXCEPTION("Transient buffer is out of memory. "
+					"Frame needs more than %u bytes", U32(m_maxSize));
+			}
+
+			newSize = m_maxSize;
+		}
+
+		ANKI_LOGW("Growing transient buffer from %u to %u bytes",
+			U32(m_ring.getSize()), U32(newSize));
+
+		createBuffer(newSize);
+		m_ring.resize(newSize);
+	}
+
+	ANKI_ASSERT(0);
+	return nullptr;
+}
+
+//==============================================================================
+void GlRingBuffer::endFrame(GlCommandBufferHandle& commands)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Check the fences of the previous frames without blocking the server
+	for(U32 i = 0; i < m_ring.getFramesCount(); i++)
+	{
+		U32 frame = (m_ring.getOldestFrame() + i) % MAX_FRAMES_IN_FLIGHT;
+		m_fences[frame].poll(commands);
+	}
+
+	retireFrames();
+
+	// Don't let the GPU fall too far behind
+	if(m_ring.getFramesCount() == MAX_FRAMES_IN_FLIGHT)
+	{
+		waitOldestFrame();
+	}
+
+	// Stats
+	m_lastFrameUsedSize = m_ring.getFrameUsedSize();
+	m_highWaterMark = std::max(m_highWaterMark, m_lastFrameUsedSize);
+	ANKI_COUNTER_INC(GL_TRANSIENT_MEMORY_SIZE, U64(m_lastFrameUsedSize));
+
+	// Fence the current frame
+	U32 frame = m_ring.endFrame();
+	m_fences[frame] = GlFenceHandle(commands);
+}
+
+} // end namespace anki
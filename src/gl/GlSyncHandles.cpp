@@ -7,6 +7,7 @@
 #include "anki/gl/GlSync.h"
 #include "anki/gl/GlCommandBufferHandle.h"
 #include "anki/gl/GlDevice.h"
+#include "anki/gl/GlHandleDeferredDeleter.h"
 #include "anki/core/Counters.h"
 
 
@@ -65,5 +66,94 @@ void GlClientSyncHandle::wait()
 	ANKI_COUNTER_STOP_TIMER_INC(GL_CLIENT_WAIT_TIME);
 }
 
+//==============================================================================
+/// Create fence command
+class GlFenceCreateCommand: public GlCommand
+{
+public:
+	GlFenceHandle m_fence;
+
+	GlFenceCreateCommand(const GlFenceHandle& fence)
+	:	m_fence(fence)
+	{}
+
+	void operator()(GlCommandBuffer*)
+	{
+		m_fence._get().create();
+	}
+};
+
+//==============================================================================
+/// Wait fence command
+class GlFenceWaitCommand: public GlCommand
+{
+public:
+	GlFenceHandle m_fence;
+	U64 m_timeout;
+
+	GlFenceWaitCommand(const GlFenceHandle& fence, U64 timeout)
+	:	m_fence(fence), 
+		m_timeout(timeout)
+	{}
+
+	void operator()(GlCommandBuffer*)
+	{
+		if(m_timeout > 0)
+		{
+			ANKI_COUNTER_START_TIMER(GL_SERVER_WAIT_TIME);
+			m_fence._get().serverWait(m_timeout);
+			ANKI_COUNTER_STOP_TIMER_INC(GL_SERVER_WAIT_TIME);
+		}
+		else
+		{
+			m_fence._get().serverWait(0);
+		}
+	}
+};
+
+//==============================================================================
+GlFenceHandle::GlFenceHandle()
+{}
+
+//==============================================================================
+GlFenceHandle::GlFenceHandle(GlCommandBufferHandle& commands)
+{
+	using Alloc = GlGlobalHeapAllocator<GlFence>;
+
+	using DeleteCommand = 
+		GlDeleteObjectCommand<GlFence, GlGlobalHeapAllocator<U8>>;
+
+	using Deleter = GlHandleDeferredDeleter<GlFence, Alloc, DeleteCommand>;
+
+	*static_cast<Base*>(this) = Base(
+		&commands._getQueue().getDevice(),
+		commands._getQueue().getDevice()._getAllocator(), 
+		Deleter());
+
+	commands._pushBackNewCommand<GlFenceCreateCommand>(*this);
+}
+
+//==============================================================================
+GlFenceHandle::~GlFenceHandle()
+{}
+
+//==============================================================================
+void GlFenceHandle::poll(GlCommandBufferHandle& commands)
+{
+	commands._pushBackNewCommand<GlFenceWaitCommand>(*this, 0);
+}
+
+//==============================================================================
+void GlFenceHandle::wait(GlCommandBufferHandle& commands)
+{
+	commands._pushBackNewCommand<GlFenceWaitCommand>(*this, MAX_U64);
+}
+
+//==============================================================================
+Bool GlFenceHandle::isSignaled() const
+{
+	return _get().isSignaled();
+}
+
 } // end namespace anki
 
@@ -117,25 +117,14 @@ GlTextureHandle::~GlTextureHandle()
 //==============================================================================
 void GlTextureHandle::bind(GlCommandBufferHandle& commands, U32 unit)
 {
-	class Command: public GlCommand
-	{
-	public:
-		GlTextureHandle m_tex;
-		U32 m_unit;
-
-		Command(GlTextureHandle& tex, U32 unit)
-		:	m_tex(tex), 
-			m_unit(unit)
-		{}
+	ANKI_ASSERT(isCreated());
 
-		void operator()(GlCommandBuffer*)
-		{
-			m_tex._get().bind(m_unit);
-		}
-	};
+	GlBindTextureCommandData cmd;
+	cmd.m_tex = &_get();
+	cmd.m_unit = unit;
 
-	ANKI_ASSERT(isCreated());
-	commands._pushBackNewCommand<Command>(*this, unit);
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_TEXTURE, cmd);
 }
 
 //==============================================================================
@@ -290,25 +279,14 @@ GlSamplerHandle::~GlSamplerHandle()
 //==============================================================================
 void GlSamplerHandle::bind(GlCommandBufferHandle& commands, U32 unit)
 {
-	class Command: public GlCommand
-	{
-	public:
-		GlSamplerHandle m_sampler;
-		U32 m_unit;
-
-		Command(GlSamplerHandle& sampler, U32 unit)
-		:	m_sampler(sampler), 
-			m_unit(unit)
-		{}
+	ANKI_ASSERT(isCreated());
 
-		void operator()(GlCommandBuffer*)
-		{
-			m_sampler._get().bind(m_unit);
-		}
-	};
+	GlBindSamplerCommandData cmd;
+	cmd.m_sampler = &_get();
+	cmd.m_unit = unit;
 
-	ANKI_ASSERT(isCreated());
-	commands._pushBackNewCommand<Command>(*this, unit);
+	commands._addReference(*this);
+	commands._pushBackInlineCommand(GlCommandOpcode::BIND_SAMPLER, cmd);
 }
 
 //==============================================================================
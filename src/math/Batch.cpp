@@ -0,0 +1,590 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/math/Batch.h"
+
+#if ANKI_SIMD == ANKI_SIMD_SSE && defined(__GNUC__) \
+	&& (defined(__x86_64__) || defined(__i386__))
+#	include <immintrin.h>
+#	define ANKI_BATCH_AVX2 1
+#else
+#	define ANKI_BATCH_AVX2 0
+#endif
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+static_assert(sizeof(Mat4) == 16 * sizeof(F32), "Mat4 should be packed");
+static_assert(sizeof(Mat3x4) == 12 * sizeof(F32), "Mat3x4 should be packed");
+
+/// The floats of a vector or a matrix. The rows of a matrix are contiguous
+template<typename T>
+static inline const F32* getFloats(const T& m)
+{
+	return reinterpret_cast<const F32*>(&m);
+}
+
+template<typename T>
+static inline F32* getFloats(T& m)
+{
+	return reinterpret_cast<F32*>(&m);
+}
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+
+// The kernels use the operators of the GCC vector extensions for the
+// arithmetic. Both the SSE and the NEON types have them
+
+#	if ANKI_SIMD == ANKI_SIMD_SSE
+
+typedef __m128 F32x4;
+typedef __m128 Mask4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return _mm_set1_ps(x);
+}
+
+//==============================================================================
+static inline F32x4 set(F32 a, F32 b, F32 c, F32 d)
+{
+	return _mm_setr_ps(a, b, c, d);
+}
+
+//==============================================================================
+static inline F32x4 load(const F32* p)
+{
+	return _mm_loadu_ps(p);
+}
+
+//==============================================================================
+static inline void store(F32* p, F32x4 a)
+{
+	_mm_storeu_ps(p, a);
+}
+
+//==============================================================================
+template<U LANE>
+static inline F32x4 splatLane(F32x4 a)
+{
+	return _mm_shuffle_ps(a, a, _MM_SHUFFLE(LANE, LANE, LANE, LANE));
+}
+
+//==============================================================================
+static inline F32x4 squareRoot(F32x4 a)
+{
+	return _mm_sqrt_ps(a);
+}
+
+//==============================================================================
+static inline Mask4 less(F32x4 a, F32x4 b)
+{
+	return _mm_cmplt_ps(a, b);
+}
+
+//==============================================================================
+/// mask ? a : b
+static inline F32x4 select(Mask4 mask, F32x4 a, F32x4 b)
+{
+	return _mm_blendv_ps(b, a, mask);
+}
+
+//==============================================================================
+/// The mask of the w
+static inline Mask4 lastLane()
+{
+	return _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+}
+
+//==============================================================================
+static inline void transpose(F32x4& a, F32x4& b, F32x4& c, F32x4& d)
+{
+	_MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+#	elif ANKI_SIMD == ANKI_SIMD_NEON
+
+typedef float32x4_t F32x4;
+typedef uint32x4_t Mask4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return vdupq_n_f32(x);
+}
+
+//==============================================================================
+static inline F32x4 set(F32 a, F32 b, F32 c, F32 d)
+{
+	F32x4 out = {a, b, c, d};
+	return out;
+}
+
+//==============================================================================
+static inline F32x4 load(const F32* p)
+{
+	return vld1q_f32(p);
+}
+
+//==============================================================================
+static inline void store(F32* p, F32x4 a)
+{
+	vst1q_f32(p, a);
+}
+
+//==============================================================================
+template<U LANE>
+static inline F32x4 splatLane(F32x4 a)
+{
+	return vdupq_n_f32(vgetq_lane_f32(a, LANE));
+}
+
+//==============================================================================
+static inline F32x4 squareRoot(F32x4 a)
+{
+	// Two Newton-Raphson steps on the reciprocal square root estimate
+	F32x4 r = vrsqrteq_f32(a);
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	return vbslq_f32(vceqq_f32(a, vdupq_n_f32(0.0)), a, vmulq_f32(a, r));
+}
+
+//==============================================================================
+static inline Mask4 less(F32x4 a, F32x4 b)
+{
+	return vcltq_f32(a, b);
+}
+
+//==============================================================================
+/// mask ? a : b
+static inline F32x4 select(Mask4 mask, F32x4 a, F32x4 b)
+{
+	return vbslq_f32(mask, a, b);
+}
+
+//==============================================================================
+/// The mask of the w
+static inline Mask4 lastLane()
+{
+	Mask4 out = {0, 0, 0, 0xFFFFFFFF};
+	return out;
+}
+
+//==============================================================================
+static inline void transpose(F32x4& a, F32x4& b, F32x4& c, F32x4& d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b);
+	float32x4x2_t cd = vtrnq_f32(c, d);
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#	endif
+
+//==============================================================================
+/// acos of [0.0, 1.0]. From Abramowitz and Stegun 4.4.46. The error is
+/// less than 2e-8
+static inline F32x4 acosPositive(F32x4 x)
+{
+	F32x4 p = splat(-0.0012624911);
+	p = p * x + splat(0.0066700901);
+	p = p * x + splat(-0.0170881256);
+	p = p * x + splat(0.0308918810);
+	p = p * x + splat(-0.0501743046);
+	p = p * x + splat(0.0889789874);
+	p = p * x + splat(-0.2145988016);
+	p = p * x + splat(1.5707963050);
+	return squareRoot(splat(1.0) - x) * p;
+}
+
+//==============================================================================
+/// sin of [0.0, PI/2]. Taylor up to the 11th power. The error is less than
+/// 6e-8
+static inline F32x4 sinQuadrant(F32x4 x)
+{
+	F32x4 x2 = x * x;
+	F32x4 p = splat(-1.0 / 39916800.0);
+	p = p * x2 + splat(1.0 / 362880.0);
+	p = p * x2 + splat(-1.0 / 5040.0);
+	p = p * x2 + splat(1.0 / 120.0);
+	p = p * x2 + splat(-1.0 / 6.0);
+	p = p * x2 + splat(1.0);
+	return p * x;
+}
+
+//==============================================================================
+/// Load the same row of 4 matrices. Column i of the row goes to out[i]
+static inline void loadRows(const F32* m0, const F32* m1, const F32* m2,
+	const F32* m3, F32x4 out[4])
+{
+	out[0] = load(m0);
+	out[1] = load(m1);
+	out[2] = load(m2);
+	out[3] = load(m3);
+	transpose(out[0], out[1], out[2], out[3]);
+}
+
+//==============================================================================
+/// The inverse of loadRows
+static inline void storeRows(F32x4 in[4], F32* m0, F32* m1, F32* m2,
+	F32* m3)
+{
+	transpose(in[0], in[1], in[2], in[3]);
+	store(m0, in[0]);
+	store(m1, in[1]);
+	store(m2, in[2]);
+	store(m3, in[3]);
+}
+
+#endif
+
+//==============================================================================
+// Points                                                                      =
+//==============================================================================
+
+#if ANKI_BATCH_AVX2
+
+//==============================================================================
+/// 2 points per register
+__attribute__((target("avx2,fma")))
+static void transformPointsAvx2(const Mat4& m, const Vec4* in, Vec4* out,
+	PtrSize count)
+{
+	const F32* mf = getFloats(m);
+	F32x4 c0 = load(mf);
+	F32x4 c1 = load(mf + 4);
+	F32x4 c2 = load(mf + 8);
+	F32x4 c3 = load(mf + 12);
+	transpose(c0, c1, c2, c3);
+
+	__m256 col0 = _mm256_set_m128(c0, c0);
+	__m256 col1 = _mm256_set_m128(c1, c1);
+	__m256 col2 = _mm256_set_m128(c2, c2);
+	__m256 col3 = _mm256_set_m128(c3, c3);
+
+	PtrSize i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m256 p = _mm256_loadu_ps(getFloats(in[i]));
+
+		__m256 r = _mm256_fmadd_ps(col0, _mm256_permute_ps(p, 0x00), col3);
+		r = _mm256_fmadd_ps(col1, _mm256_permute_ps(p, 0x55), r);
+		r = _mm256_fmadd_ps(col2, _mm256_permute_ps(p, 0xAA), r);
+
+		_mm256_storeu_ps(getFloats(out[i]), r);
+	}
+
+	if(i < count)
+	{
+		out[i] = m * in[i].xyz1();
+	}
+}
+
+//==============================================================================
+static Bool hasAvx2()
+{
+	static const Bool has =
+		__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	return has;
+}
+
+#endif
+
+//==============================================================================
+void transformPoints(const Mat4& m, const Vec4* in, Vec4* out, PtrSize count)
+{
+#if ANKI_BATCH_AVX2
+	if(hasAvx2())
+	{
+		transformPointsAvx2(m, in, out, count);
+		return;
+	}
+#endif
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	const F32* mf = getFloats(m);
+	F32x4 c0 = load(mf);
+	F32x4 c1 = load(mf + 4);
+	F32x4 c2 = load(mf + 8);
+	F32x4 c3 = load(mf + 12);
+	transpose(c0, c1, c2, c3);
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		F32x4 p = load(getFloats(in[i]));
+		F32x4 r = c0 * splatLane<0>(p) + c1 * splatLane<1>(p)
+			+ c2 * splatLane<2>(p) + c3;
+		store(getFloats(out[i]), r);
+	}
+#else
+	for(PtrSize i = 0; i < count; i++)
+	{
+		out[i] = m * in[i].xyz1();
+	}
+#endif
+}
+
+//==============================================================================
+// Transforms                                                                  =
+//==============================================================================
+
+//==============================================================================
+void combineTransformations(const Transform* a, const Transform* b,
+	Transform* out, PtrSize count)
+{
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	// The items are independent so do one at a time with the rows in
+	// registers. It avoids the transposes of a 4 wide version
+	const F32x4 zero = splat(0.0);
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		const F32* ar = getFloats(a[i].getRotation());
+		const F32* br = getFloats(b[i].getRotation());
+		F32 as = a[i].getScale();
+		F32 os = as * b[i].getScale();
+
+		F32x4 arow[3] = {load(ar), load(ar + 4), load(ar + 8)};
+		F32x4 brow[3] = {load(br), load(br + 4), load(br + 8)};
+		F32x4 ao = load(getFloats(a[i].getOrigin()));
+		F32x4 bo = load(getFloats(b[i].getOrigin())) * splat(as);
+
+		// The origin: a.rotation * (b.origin * a.scale) + a.origin. The w of
+		// the origins is zero so it drops the translations of the rows
+		F32x4 dots[4] = {arow[0] * bo, arow[1] * bo, arow[2] * bo,
+			zero};
+		transpose(dots[0], dots[1], dots[2], dots[3]);
+		F32x4 oo = dots[0] + dots[1] + dots[2] + dots[3] + ao;
+
+		// The rotation. The translation of a's row is added to the w
+		F32x4 orow[3];
+		for(U j = 0; j < 3; j++)
+		{
+			F32x4 t = select(lastLane(), arow[j], zero);
+			orow[j] = splatLane<0>(arow[j]) * brow[0]
+				+ splatLane<1>(arow[j]) * brow[1]
+				+ splatLane<2>(arow[j]) * brow[2] + t;
+		}
+
+		// Write at the end since the output may be one of the inputs
+		F32* or_ = getFloats(out[i].getRotation());
+		store(or_, orow[0]);
+		store(or_ + 4, orow[1]);
+		store(or_ + 8, orow[2]);
+		store(getFloats(out[i].getOrigin()), oo);
+		out[i].setScale(os);
+	}
+#else
+	for(PtrSize i = 0; i < count; i++)
+	{
+		out[i] = a[i].combineTransformations(b[i]);
+	}
+#endif
+}
+
+//==============================================================================
+// Quaternions                                                                 =
+//==============================================================================
+
+//==============================================================================
+void slerp(const Quat* a, const Quat* b, const F32* u, Quat* out,
+	PtrSize count)
+{
+	PtrSize i = 0;
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	const F32x4 zero = splat(0.0);
+	const F32x4 one = splat(1.0);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		// The x, y, z and w of 4 quaternions
+		F32x4 q0[4], q1[4];
+		loadRows(getFloats(a[i]), getFloats(a[i + 1]), getFloats(a[i + 2]),
+			getFloats(a[i + 3]), &q0[0]);
+		loadRows(getFloats(b[i]), getFloats(b[i + 1]), getFloats(b[i + 2]),
+			getFloats(b[i + 3]), &q1[0]);
+		F32x4 t = load(u + i);
+
+		F32x4 cosHalfTheta = q0[0] * q1[0] + q0[1] * q1[1]
+			+ q0[2] * q1[2] + q0[3] * q1[3];
+
+		// Take the shortest path
+		Mask4 negative = less(cosHalfTheta, zero);
+		for(U j = 0; j < 4; j++)
+		{
+			q1[j] = select(negative, zero - q1[j], q1[j]);
+		}
+		cosHalfTheta = select(negative, zero - cosHalfTheta, cosHalfTheta);
+
+		// The same rotation
+		Mask4 general = less(cosHalfTheta, one);
+		cosHalfTheta = select(general, cosHalfTheta, one);
+
+		F32x4 halfTheta = acosPositive(cosHalfTheta);
+		F32x4 sinHalfTheta =
+			squareRoot(one - cosHalfTheta * cosHalfTheta);
+
+		// Close rotations are averaged
+		Mask4 close = less(sinHalfTheta, splat(0.001));
+		sinHalfTheta = select(close, one, sinHalfTheta);
+
+		F32x4 ratioA = sinQuadrant((one - t) * halfTheta) / sinHalfTheta;
+		F32x4 ratioB = sinQuadrant(t * halfTheta) / sinHalfTheta;
+
+		F32x4 sum[4];
+		for(U j = 0; j < 4; j++)
+		{
+			sum[j] = q0[j] * ratioA + q1[j] * ratioB;
+		}
+
+		F32x4 len = squareRoot(sum[0] * sum[0] + sum[1] * sum[1]
+			+ sum[2] * sum[2] + sum[3] * sum[3]);
+
+		for(U j = 0; j < 4; j++)
+		{
+			F32x4 average = (q0[j] + q1[j]) * splat(0.5);
+			F32x4 r = select(close, average, sum[j] / len);
+			sum[j] = select(general, r, q0[j]);
+		}
+
+		storeRows(&sum[0], getFloats(out[i]), getFloats(out[i + 1]),
+			getFloats(out[i + 2]), getFloats(out[i + 3]));
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		out[i] = a[i].slerp(b[i], u[i]);
+	}
+}
+
+//==============================================================================
+// Matrices                                                                    =
+//==============================================================================
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+
+//==============================================================================
+/// Mat4::getInverse of 4 matrices. in[j][i] is the element (j, i) of the 4
+static void invert4(const F32x4 in[4][4], F32x4 m4[4][4])
+{
+	F32x4 tmp[12];
+
+	tmp[0] = in[2][2] * in[3][3];
+	tmp[1] = in[3][2] * in[2][3];
+	tmp[2] = in[1][2] * in[3][3];
+	tmp[3] = in[3][2] * in[1][3];
+	tmp[4] = in[1][2] * in[2][3];
+	tmp[5] = in[2][2] * in[1][3];
+	tmp[6] = in[0][2] * in[3][3];
+	tmp[7] = in[3][2] * in[0][3];
+	tmp[8] = in[0][2] * in[2][3];
+	tmp[9] = in[2][2] * in[0][3];
+	tmp[10] = in[0][2] * in[1][3];
+	tmp[11] = in[1][2] * in[0][3];
+
+	m4[0][0] = (tmp[0] * in[1][1] + tmp[3] * in[2][1] + tmp[4] * in[3][1])
+		- (tmp[1] * in[1][1] + tmp[2] * in[2][1] + tmp[5] * in[3][1]);
+	m4[0][1] = (tmp[1] * in[0][1] + tmp[6] * in[2][1] + tmp[9] * in[3][1])
+		- (tmp[0] * in[0][1] + tmp[7] * in[2][1] + tmp[8] * in[3][1]);
+	m4[0][2] = (tmp[2] * in[0][1] + tmp[7] * in[1][1] + tmp[10] * in[3][1])
+		- (tmp[3] * in[0][1] + tmp[6] * in[1][1] + tmp[11] * in[3][1]);
+	m4[0][3] = (tmp[5] * in[0][1] + tmp[8] * in[1][1] + tmp[11] * in[2][1])
+		- (tmp[4] * in[0][1] + tmp[9] * in[1][1] + tmp[10] * in[2][1]);
+	m4[1][0] = (tmp[1] * in[1][0] + tmp[2] * in[2][0] + tmp[5] * in[3][0])
+		- (tmp[0] * in[1][0] + tmp[3] * in[2][0] + tmp[4] * in[3][0]);
+	m4[1][1] = (tmp[0] * in[0][0] + tmp[7] * in[2][0] + tmp[8] * in[3][0])
+		- (tmp[1] * in[0][0] + tmp[6] * in[2][0] + tmp[9] * in[3][0]);
+	m4[1][2] = (tmp[3] * in[0][0] + tmp[6] * in[1][0] + tmp[11] * in[3][0])
+		- (tmp[2] * in[0][0] + tmp[7] * in[1][0] + tmp[10] * in[3][0]);
+	m4[1][3] = (tmp[4] * in[0][0] + tmp[9] * in[1][0] + tmp[10] * in[2][0])
+		- (tmp[5] * in[0][0] + tmp[8] * in[1][0] + tmp[11] * in[2][0]);
+
+	tmp[0] = in[2][0] * in[3][1];
+	tmp[1] = in[3][0] * in[2][1];
+	tmp[2] = in[1][0] * in[3][1];
+	tmp[3] = in[3][0] * in[1][1];
+	tmp[4] = in[1][0] * in[2][1];
+	tmp[5] = in[2][0] * in[1][1];
+	tmp[6] = in[0][0] * in[3][1];
+	tmp[7] = in[3][0] * in[0][1];
+	tmp[8] = in[0][0] * in[2][1];
+	tmp[9] = in[2][0] * in[0][1];
+	tmp[10] = in[0][0] * in[1][1];
+	tmp[11] = in[1][0] * in[0][1];
+
+	m4[2][0] = (tmp[0] * in[1][3] + tmp[3] * in[2][3] + tmp[4] * in[3][3])
+		- (tmp[1] * in[1][3] + tmp[2] * in[2][3] + tmp[5] * in[3][3]);
+	m4[2][1] = (tmp[1] * in[0][3] + tmp[6] * in[2][3] + tmp[9] * in[3][3])
+		- (tmp[0] * in[0][3] + tmp[7] * in[2][3] + tmp[8] * in[3][3]);
+	m4[2][2] = (tmp[2] * in[0][3] + tmp[7] * in[1][3] + tmp[10] * in[3][3])
+		- (tmp[3] * in[0][3] + tmp[6] * in[1][3] + tmp[11] * in[3][3]);
+	m4[2][3] = (tmp[5] * in[0][3] + tmp[8] * in[1][3] + tmp[11] * in[2][3])
+		- (tmp[4] * in[0][3] + tmp[9] * in[1][3] + tmp[10] * in[2][3]);
+	m4[3][0] = (tmp[2] * in[2][2] + tmp[5] * in[3][2] + tmp[1] * in[1][2])
+		- (tmp[4] * in[3][2] + tmp[0] * in[1][2] + tmp[3] * in[2][2]);
+	m4[3][1] = (tmp[8] * in[3][2] + tmp[0] * in[0][2] + tmp[7] * in[2][2])
+		- (tmp[6] * in[2][2] + tmp[9] * in[3][2] + tmp[1] * in[0][2]);
+	m4[3][2] = (tmp[6] * in[1][2] + tmp[11] * in[3][2] + tmp[3] * in[0][2])
+		- (tmp[10] * in[3][2] + tmp[2] * in[0][2] + tmp[7] * in[1][2]);
+	m4[3][3] = (tmp[10] * in[2][2] + tmp[4] * in[0][2] + tmp[9] * in[1][2])
+		- (tmp[8] * in[1][2] + tmp[11] * in[2][2] + tmp[5] * in[0][2]);
+
+	F32x4 det = in[0][0] * m4[0][0] + in[1][0] * m4[0][1]
+		+ in[2][0] * m4[0][2] + in[3][0] * m4[0][3];
+	det = splat(1.0) / det;
+
+	for(U j = 0; j < 4; j++)
+	{
+		for(U k = 0; k < 4; k++)
+		{
+			m4[j][k] = m4[j][k] * det;
+		}
+	}
+}
+
+#endif
+
+//==============================================================================
+void invert(const Mat4* in, Mat4* out, PtrSize count)
+{
+	PtrSize i = 0;
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	for(; i + 4 <= count; i += 4)
+	{
+		F32x4 m[4][4], inv[4][4];
+		for(U j = 0; j < 4; j++)
+		{
+			loadRows(&getFloats(in[i])[j * 4], &getFloats(in[i + 1])[j * 4],
+				&getFloats(in[i + 2])[j * 4], &getFloats(in[i + 3])[j * 4],
+				&m[j][0]);
+		}
+
+		invert4(m, inv);
+
+		for(U j = 0; j < 4; j++)
+		{
+			storeRows(&inv[j][0], &getFloats(out[i])[j * 4],
+				&getFloats(out[i + 1])[j * 4], &getFloats(out[i + 2])[j * 4],
+				&getFloats(out[i + 3])[j * 4]);
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		out[i] = in[i].getInverse();
+	}
+}
+
+} // end namespace anki
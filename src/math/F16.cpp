@@ -5,6 +5,20 @@
 
 #include "anki/math/F16.h"
 
+#if ANKI_SIMD == ANKI_SIMD_SSE && defined(__GNUC__) \
+	&& (defined(__x86_64__) || defined(__i386__))
+#	include <immintrin.h>
+#	define ANKI_F16C 1
+#else
+#	define ANKI_F16C 0
+#endif
+
+#if ANKI_SIMD == ANKI_SIMD_NEON && defined(__ARM_FP) && (__ARM_FP & 2)
+#	define ANKI_F16_NEON 1
+#else
+#	define ANKI_F16_NEON 0
+#endif
+
 namespace anki {
 
 //==============================================================================
@@ -134,4 +148,221 @@ F32 F16::toF32(F16 h)
 	return v32.f;
 }
 
+//==============================================================================
+// Bulk                                                                        =
+//==============================================================================
+
+// F16::toF16 rounds to the nearest and the ties away from zero. The hardware
+// can't do that so the kernels add half of the F16 ulp to the bits and then
+// truncate. That is exact for the floats that become normal halfs. The zeros
+// become +0 like in F16::toF16 and all the rest (denormals, overflows, inf,
+// NaN) go to F16::toF16
+
+/// The bits of the smallest normal half
+static const U32 MIN_NORMAL_BITS = 0x38800000;
+/// The bits of the first float that rounds to infinity
+static const U32 MAX_FINITE_BITS = 0x477ff000;
+/// Half of the F16 ulp in the mantissa of a float
+static const U32 HALF_ULP_BITS = 0x00001000;
+
+#if ANKI_F16C
+
+//==============================================================================
+__attribute__((target("f16c")))
+static void toF16F16c(const F32* in, F16* out, PtrSize count)
+{
+	const __m128i absMask = _mm_set1_epi32(0x7fffffff);
+	const __m128i minBits = _mm_set1_epi32(MIN_NORMAL_BITS - 1);
+	const __m128i maxBits = _mm_set1_epi32(MAX_FINITE_BITS);
+	const __m128i halfUlp = _mm_set1_epi32(HALF_ULP_BITS);
+	const __m128i zero = _mm_setzero_si128();
+
+	PtrSize i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i bits = 
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i abs = _mm_and_si128(bits, absMask);
+
+		__m128i normal = _mm_and_si128(_mm_cmpgt_epi32(abs, minBits), 
+			_mm_cmplt_epi32(abs, maxBits));
+		__m128i fast = _mm_or_si128(normal, _mm_cmpeq_epi32(abs, zero));
+
+		// The zeros and the slow lanes become +0
+		__m128i rounded = 
+			_mm_and_si128(_mm_add_epi32(bits, halfUlp), normal);
+		__m128i h = _mm_cvtps_ph(_mm_castsi128_ps(rounded), 
+			_MM_FROUND_TO_ZERO);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), h);
+
+		if(_mm_movemask_ps(_mm_castsi128_ps(fast)) != 0xf)
+		{
+			for(U j = 0; j < 4; j++)
+			{
+				out[i + j] = F16(in[i + j]);
+			}
+		}
+	}
+
+	for(; i < count; i++)
+	{
+		out[i] = F16(in[i]);
+	}
+}
+
+//==============================================================================
+__attribute__((target("f16c")))
+static void toF32F16c(const F16* in, F32* out, PtrSize count)
+{
+	const __m128i absMask = _mm_set1_epi16(0x7fff);
+	const __m128i inf = _mm_set1_epi16(0x7c00);
+
+	PtrSize i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+		_mm_storeu_ps(out + i, _mm_cvtph_ps(h));
+
+		// The hardware makes the signaling NaNs quiet, F16::toF32 doesn't
+		__m128i nan = _mm_cmpgt_epi16(_mm_and_si128(h, absMask), inf);
+		if(_mm_movemask_epi8(nan) & 0xff)
+		{
+			for(U j = 0; j < 4; j++)
+			{
+				out[i + j] = in[i + j].toF32();
+			}
+		}
+	}
+
+	for(; i < count; i++)
+	{
+		out[i] = in[i].toF32();
+	}
+}
+
+//==============================================================================
+static Bool hasF16c()
+{
+	static const Bool has = __builtin_cpu_supports("f16c");
+	return has;
+}
+
+#elif ANKI_F16_NEON
+
+//==============================================================================
+/// True if all the lanes of the mask are set
+static inline Bool allSet(uint16x4_t mask)
+{
+	return vget_lane_u64(vreinterpret_u64_u16(mask), 0) == ~U64(0);
+}
+
+//==============================================================================
+static void toF16Neon(const F32* in, F16* out, PtrSize count)
+{
+	// NEON converts with the rounding of the FPSCR so do the rounding and the
+	// rebias of the exponent with integers
+	const uint32x4_t absMask = vdupq_n_u32(0x7fffffff);
+	const uint32x4_t minBits = vdupq_n_u32(MIN_NORMAL_BITS);
+	const uint32x4_t maxBits = vdupq_n_u32(MAX_FINITE_BITS);
+	const uint32x4_t bias = vdupq_n_u32((127 - 15) << 23);
+
+	PtrSize i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(in + i));
+		uint32x4_t abs = vandq_u32(bits, absMask);
+
+		uint32x4_t normal = 
+			vandq_u32(vcgeq_u32(abs, minBits), vcltq_u32(abs, maxBits));
+		uint32x4_t fast = vorrq_u32(normal, vceqq_u32(abs, vdupq_n_u32(0)));
+
+		uint32x4_t h = vaddq_u32(abs, vdupq_n_u32(HALF_ULP_BITS));
+		h = vshrq_n_u32(vsubq_u32(h, bias), 13);
+		h = vorrq_u32(h, vshrq_n_u32(vbicq_u32(bits, absMask), 16));
+		h = vandq_u32(h, normal);
+		vst1_u16(reinterpret_cast<U16*>(out + i), vmovn_u32(h));
+
+		if(!allSet(vmovn_u32(fast)))
+		{
+			for(U j = 0; j < 4; j++)
+			{
+				out[i + j] = F16(in[i + j]);
+			}
+		}
+	}
+
+	for(; i < count; i++)
+	{
+		out[i] = F16(in[i]);
+	}
+}
+
+//==============================================================================
+static void toF32Neon(const F16* in, F32* out, PtrSize count)
+{
+	PtrSize i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		uint16x4_t h = vld1_u16(reinterpret_cast<const U16*>(in + i));
+		vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(h)));
+
+		// The hardware makes the signaling NaNs quiet, F16::toF32 doesn't
+		uint16x4_t abs = vand_u16(h, vdup_n_u16(0x7fff));
+		if(!allSet(vcle_u16(abs, vdup_n_u16(0x7c00))))
+		{
+			for(U j = 0; j < 4; j++)
+			{
+				out[i + j] = in[i + j].toF32();
+			}
+		}
+	}
+
+	for(; i < count; i++)
+	{
+		out[i] = in[i].toF32();
+	}
+}
+
+#endif
+
+//==============================================================================
+void toF16(const F32* in, F16* out, PtrSize count)
+{
+#if ANKI_F16C
+	if(hasF16c())
+	{
+		toF16F16c(in, out, count);
+		return;
+	}
+#elif ANKI_F16_NEON
+	toF16Neon(in, out, count);
+	return;
+#endif
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		out[i] = F16(in[i]);
+	}
+}
+
+//==============================================================================
+void toF32(const F16* in, F32* out, PtrSize count)
+{
+#if ANKI_F16C
+	if(hasF16c())
+	{
+		toF32F16c(in, out, count);
+		return;
+	}
+#elif ANKI_F16_NEON
+	toF32Neon(in, out, count);
+	return;
+#endif
+
+	for(PtrSize i = 0; i < count; i++)
+	{
+		out[i] = in[i].toF32();
+	}
+}
+
 } // end namespace anki
@@ -6,7 +6,7 @@
 #include "anki/renderer/Bs.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/scene/Camera.h"
+#include "anki/scene/RenderSnapshot.h"
 
 namespace anki {
 
@@ -30,12 +30,11 @@ void Bs::run(GlCommandBufferHandle& jobs)
 	RenderableDrawer& drawer = m_r->getSceneDrawer();
 	drawer.prepareDraw(RenderingStage::BLEND, Pass::COLOR, jobs);
 
-	Camera& cam = m_r->getSceneGraph().getActiveCamera();
+	const FrustumSnapshot& cam = m_r->getRenderSnapshot().m_camera;
+	VisibilityTestResults& vi = *cam.m_visible;
 
-	for(auto& it : cam.getVisibilityTestResults().m_renderables)
-	{
-		drawer.render(cam, it);
-	}
+	drawer.render(cam, vi.m_renderables.data(), 
+		vi.m_renderables.data() + vi.m_renderables.size());
 
 	drawer.finishDraw();
 
@@ -0,0 +1,625 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/renderer/Clusterer.h"
+#include "anki/math/Simd.h"
+#include "anki/util/Functions.h"
+#include <cstring>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// Compute the bounds of the lights and the masks of the depth bounds
+class ClustererSetupTask: public Threadpool::Task
+{
+public:
+	Clusterer* m_clusterer = nullptr;
+
+	void operator()(U32 threadId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+		choseStartEnd(
+			threadId, threadsCount, m_clusterer->m_lightsCount, start, end);
+
+		for(PtrSize i = start; i < end; i++)
+		{
+			m_clusterer->computeLightBounds(m_clusterer->m_lights[i],
+				m_clusterer->m_lightBounds[i]);
+		}
+
+		if(m_clusterer->m_tileDepthBounds)
+		{
+			U32 countY = m_clusterer->m_counts[1];
+			choseStartEnd(threadId, threadsCount, 
+				countY * m_clusterer->m_counts[2], start, end);
+
+			for(PtrSize i = start; i < end; i++)
+			{
+				m_clusterer->m_rowMasks[i] = 
+					m_clusterer->computeRowMask(i / countY, i % countY);
+			}
+		}
+	}
+};
+
+//==============================================================================
+/// Bin the lights of a number of slices to the thread's bins
+class ClustererBinTask: public Threadpool::Task
+{
+public:
+	Clusterer* m_clusterer = nullptr;
+
+	void operator()(U32 threadId, PtrSize threadsCount)
+	{
+		Clusterer::ThreadBins& bins = m_clusterer->m_bins[threadId];
+
+		PtrSize start, end;
+		choseStartEnd(
+			threadId, threadsCount, m_clusterer->m_counts[2], start, end);
+		bins.m_beginSlice = start;
+		bins.m_endSlice = end;
+
+		m_clusterer->binSlices(bins);
+	}
+};
+
+//==============================================================================
+/// Copy the thread bins to the final array
+class ClustererMergeTask: public Threadpool::Task
+{
+public:
+	Clusterer* m_clusterer = nullptr;
+
+	void operator()(U32 threadId, PtrSize threadsCount)
+	{
+		Clusterer::ThreadBins& bins = m_clusterer->m_bins[threadId];
+		U32 clustersPerSlice =
+			m_clusterer->m_counts[0] * m_clusterer->m_counts[1];
+
+		if(bins.m_indices.size() > 0)
+		{
+			memcpy(&m_clusterer->m_lightIndices[bins.m_offset],
+				&bins.m_indices[0], bins.m_indices.getSizeInBytes());
+		}
+
+		if(bins.m_offset > 0)
+		{
+			U32 begin = bins.m_beginSlice * clustersPerSlice;
+			U32 end = bins.m_endSlice * clustersPerSlice;
+			for(U32 i = begin; i < end; i++)
+			{
+				m_clusterer->m_clusters[i].m_offset += bins.m_offset;
+			}
+		}
+	}
+};
+
+//==============================================================================
+// Clusterer                                                                   =
+//==============================================================================
+
+//==============================================================================
+Clusterer::Clusterer()
+{}
+
+//==============================================================================
+Clusterer::~Clusterer()
+{}
+
+//==============================================================================
+void Clusterer::init(HeapAllocator<U8>& alloc, 
+	U32 clustersX, U32 clustersY, U32 clustersZ,
+	const Array<U32, U(ClustererLightType::COUNT)>& maxLightsPerCluster)
+{
+	// The masks of the rows are 32bit and the ranges 8bit
+	ANKI_ASSERT(clustersX > 0 && clustersX <= 32);
+	ANKI_ASSERT(clustersY > 0 && clustersY <= 0xFF);
+	ANKI_ASSERT(clustersZ > 0 && clustersZ <= 0xFF);
+
+	m_counts[0] = clustersX;
+	m_counts[1] = clustersY;
+	m_counts[2] = clustersZ;
+
+	m_maxLightsPerCluster = maxLightsPerCluster;
+	m_maxLightsPerCluster[U(ClustererLightType::POINT)] = std::min(
+		m_maxLightsPerCluster[U(ClustererLightType::POINT)],
+		U32(MAX_POINT_LIGHTS_PER_CLUSTER));
+	m_maxLightsPerCluster[U(ClustererLightType::SPOT)] = std::min(
+		m_maxLightsPerCluster[U(ClustererLightType::SPOT)],
+		U32(MAX_SPOT_LIGHTS_PER_CLUSTER));
+	m_maxLightsPerCluster[U(ClustererLightType::SPOT_TEX)] = std::min(
+		m_maxLightsPerCluster[U(ClustererLightType::SPOT_TEX)],
+		U32(MAX_SPOT_LIGHTS_PER_CLUSTER));
+
+	m_alloc = alloc;
+	m_planesX = Vector<F32>(m_alloc);
+	m_planesY = Vector<F32>(m_alloc);
+	m_sliceDepths = Vector<F32>(m_alloc);
+	m_spheres = Vector<F32>(m_alloc);
+	m_lightBounds = Vector<LightBounds>(m_alloc);
+	m_rowMasks = Vector<U32>(m_alloc);
+	m_clusters = Vector<ClustererCluster>(m_alloc);
+	m_lightIndices = Vector<U32>(m_alloc);
+	m_lightIndicesCount = 0;
+
+	for(ThreadBins& bins : m_bins)
+	{
+		bins.m_lights = Vector<U32>(m_alloc);
+		bins.m_rowLights = Vector<RowLight>(m_alloc);
+		bins.m_indices = Vector<U32>(m_alloc);
+	}
+
+	// Only the inner planes are needed
+	m_planesXStride = getAlignedRoundUp(4, clustersX - 1);
+	m_planesYStride = getAlignedRoundUp(4, clustersY - 1);
+	m_planesX.resize(std::max<U32>(m_planesXStride * 2, 1), 0.0);
+	m_planesY.resize(std::max<U32>(m_planesYStride * 2, 1), 0.0);
+
+	m_sliceDepths.resize(clustersZ + 1);
+
+	m_rowStride = getAlignedRoundUp(4, clustersX);
+	m_spheres.resize(m_rowStride * 4 * clustersY * clustersZ, 0.0);
+
+	m_rowMasks.resize(clustersY * clustersZ, 0);
+
+	m_clusters.resize(getClustersCount());
+
+	m_near = m_far = 0.0;
+}
+
+//==============================================================================
+void Clusterer::prepare(F32 near, F32 far, F32 tanHalfFovX, F32 tanHalfFovY)
+{
+	ANKI_ASSERT(near > 0.0 && far > near);
+
+	if(near == m_near && far == m_far && tanHalfFovX == m_tanHalfFovX
+		&& tanHalfFovY == m_tanHalfFovY)
+	{
+		return;
+	}
+
+	m_near = near;
+	m_far = far;
+	m_tanHalfFovX = tanHalfFovX;
+	m_tanHalfFovY = tanHalfFovY;
+
+	// The slices: depth(k) = near * (far / near) ^ (k / Z)
+	U32 countZ = m_counts[2];
+	m_sliceScale = F32(countZ) / log2(far / near);
+	m_sliceBias = -log2(near) * m_sliceScale;
+
+	for(U z = 0; z <= countZ; z++)
+	{
+		m_sliceDepths[z] = near * pow(far / near, F32(z) / F32(countZ));
+	}
+
+	// The planes. Plane i passes from x = t * depth where
+	// t = tanHalfFov * (2 * i / count - 1)
+	auto planes = [](U32 count, U32 stride, F32 tanHalfFov, F32* n)
+	{
+		for(U i = 1; i < count; i++)
+		{
+			F32 t = tanHalfFov * (2.0 * F32(i) / F32(count) - 1.0);
+			F32 invLen = 1.0 / sqrt(1.0 + t * t);
+			n[i - 1] = invLen;
+			n[stride + i - 1] = t * invLen;
+		}
+	};
+
+	planes(m_counts[0], m_planesXStride, tanHalfFovX, &m_planesX[0]);
+	planes(m_counts[1], m_planesYStride, tanHalfFovY, &m_planesY[0]);
+
+	// The bounding spheres of the clusters. Bound the AABB of every cluster
+	for(U z = 0; z < countZ; z++)
+	{
+		F32 d0 = m_sliceDepths[z];
+		F32 d1 = m_sliceDepths[z + 1];
+
+		for(U y = 0; y < m_counts[1]; y++)
+		{
+			F32 ty0 = tanHalfFovY * (2.0 * F32(y) / F32(m_counts[1]) - 1.0);
+			F32 ty1 =
+				tanHalfFovY * (2.0 * F32(y + 1) / F32(m_counts[1]) - 1.0);
+			F32 minY = std::min(ty0 * d0, ty0 * d1);
+			F32 maxY = std::max(ty1 * d0, ty1 * d1);
+
+			F32* row = &m_spheres[(z * m_counts[1] + y) * 4 * m_rowStride];
+
+			for(U x = 0; x < m_counts[0]; x++)
+			{
+				F32 tx0 =
+					tanHalfFovX * (2.0 * F32(x) / F32(m_counts[0]) - 1.0);
+				F32 tx1 =
+					tanHalfFovX * (2.0 * F32(x + 1) / F32(m_counts[0]) - 1.0);
+				F32 minX = std::min(tx0 * d0, tx0 * d1);
+				F32 maxX = std::max(tx1 * d0, tx1 * d1);
+
+				Vec3 half((maxX - minX) * 0.5, (maxY - minY) * 0.5,
+					(d1 - d0) * 0.5);
+
+				row[x] = (minX + maxX) * 0.5;
+				row[m_rowStride + x] = (minY + maxY) * 0.5;
+				row[m_rowStride * 2 + x] = -(d0 + d1) * 0.5;
+				row[m_rowStride * 3 + x] = half.getLength();
+			}
+		}
+	}
+}
+
+//==============================================================================
+U32 Clusterer::getSlice(F32 depth) const
+{
+	F32 k = log2(std::max(depth, m_near)) * m_sliceScale + m_sliceBias;
+	return std::min(U32(std::max(k, 0.0f)), m_counts[2] - 1);
+}
+
+//==============================================================================
+void Clusterer::computeRange(const F32* nA, const F32* nZ, U32 planesCount,
+	U32 stride, F32 a, F32 z, F32 radius, U8& begin, U8& end) const
+{
+	// The distances from the planes decrease with i. Count the planes that
+	// are fully on the positive and fully on the negative side. The padding
+	// planes have zero normals and they don't count
+	U32 positive = 0;
+	U32 negative = 0;
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+	__m128 va = _mm_set1_ps(a);
+	__m128 vz = _mm_set1_ps(z);
+	__m128 vr = _mm_set1_ps(radius);
+	__m128 vnr = _mm_set1_ps(-radius);
+
+	for(U i = 0; i < stride; i += 4)
+	{
+		__m128 d = _mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(nA + i), va),
+			_mm_mul_ps(_mm_loadu_ps(nZ + i), vz));
+
+		positive += countBits(
+			_mm_movemask_ps(_mm_cmpgt_ps(d, vr)));
+		negative += countBits(
+			_mm_movemask_ps(_mm_cmplt_ps(d, vnr)));
+	}
+#else
+	for(U i = 0; i < stride; i++)
+	{
+		F32 d = nA[i] * a + nZ[i] * z;
+		positive += (d > radius) ? 1 : 0;
+		negative += (d < -radius) ? 1 : 0;
+	}
+#endif
+
+	begin = positive;
+	end = planesCount + 1 - negative;
+}
+
+//==============================================================================
+void Clusterer::computeLightBounds(const ClustererLight& light,
+	LightBounds& bounds) const
+{
+	const Vec4& pos = light.m_posRadius;
+	F32 radius = pos.w();
+	ANKI_ASSERT(radius > 0.0);
+
+	// Z. The depth is -z
+	F32 minDepth = -pos.z() - radius;
+	F32 maxDepth = -pos.z() + radius;
+
+	if(maxDepth <= m_near || minDepth >= m_far)
+	{
+		bounds.m_begin[2] = bounds.m_end[2] = 0;
+		return;
+	}
+
+	bounds.m_begin[2] = getSlice(minDepth);
+	bounds.m_end[2] = getSlice(std::min(maxDepth, m_far)) + 1;
+
+	// X and Y
+	computeRange(&m_planesX[0], &m_planesX[m_planesXStride], m_counts[0] - 1,
+		m_planesXStride, pos.x(), pos.z(), radius,
+		bounds.m_begin[0], bounds.m_end[0]);
+
+	computeRange(&m_planesY[0], &m_planesY[m_planesYStride], m_counts[1] - 1,
+		m_planesYStride, pos.y(), pos.z(), radius,
+		bounds.m_begin[1], bounds.m_end[1]);
+
+	if(bounds.m_begin[0] >= bounds.m_end[0]
+		|| bounds.m_begin[1] >= bounds.m_end[1])
+	{
+		bounds.m_begin[2] = bounds.m_end[2] = 0;
+	}
+}
+
+//==============================================================================
+U32 Clusterer::testRow(const ClustererLight& light, const F32* row,
+	U begin, U end) const
+{
+	const F32* cx = row;
+	const F32* cy = row + m_rowStride;
+	const F32* cz = row + m_rowStride * 2;
+	const F32* cr = row + m_rowStride * 3;
+	const Vec4& pos = light.m_posRadius;
+	Bool spot = light.m_type != ClustererLightType::POINT;
+
+	U32 mask = 0;
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+	__m128 px = _mm_set1_ps(pos.x());
+	__m128 py = _mm_set1_ps(pos.y());
+	__m128 pz = _mm_set1_ps(pos.z());
+	__m128 pr = _mm_set1_ps(pos.w());
+	__m128 dx = _mm_set1_ps(light.m_dir.x());
+	__m128 dy = _mm_set1_ps(light.m_dir.y());
+	__m128 dz = _mm_set1_ps(light.m_dir.z());
+	__m128 cosA = _mm_set1_ps(light.m_outerCos);
+	__m128 sinA = _mm_set1_ps(light.m_outerSin);
+	__m128 zero = _mm_setzero_ps();
+
+	for(U i = begin & ~3U; i < end; i += 4)
+	{
+		__m128 r = _mm_loadu_ps(cr + i);
+
+		// Cluster sphere vs light sphere
+		__m128 vx = _mm_sub_ps(_mm_loadu_ps(cx + i), px);
+		__m128 vy = _mm_sub_ps(_mm_loadu_ps(cy + i), py);
+		__m128 vz = _mm_sub_ps(_mm_loadu_ps(cz + i), pz);
+		__m128 lenSq = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 sumR = _mm_add_ps(r, pr);
+		__m128 hit = _mm_cmple_ps(lenSq, _mm_mul_ps(sumR, sumR));
+
+		if(spot)
+		{
+			// Cluster sphere vs cone. The distance of the sphere center from
+			// the cone is cos * |v x dir| - sin * (v . dir)
+			__m128 v1Len = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(vx, dx), _mm_mul_ps(vy, dy)), _mm_mul_ps(vz, dz));
+			__m128 perp = _mm_sqrt_ps(_mm_max_ps(
+				_mm_sub_ps(lenSq, _mm_mul_ps(v1Len, v1Len)), zero));
+			__m128 dist = _mm_sub_ps(
+				_mm_mul_ps(cosA, perp), _mm_mul_ps(sinA, v1Len));
+
+			hit = _mm_and_ps(hit, _mm_cmple_ps(dist, r));
+			hit = _mm_and_ps(hit,
+				_mm_cmpge_ps(v1Len, _mm_sub_ps(zero, r)));
+		}
+
+		mask |= U32(_mm_movemask_ps(hit)) << i;
+	}
+#else
+	for(U i = begin; i < end; i++)
+	{
+		F32 r = cr[i];
+		Vec3 v(cx[i] - pos.x(), cy[i] - pos.y(), cz[i] - pos.z());
+		F32 lenSq = v.getLengthSquared();
+		Bool hit = lenSq <= (r + pos.w()) * (r + pos.w());
+
+		if(spot && hit)
+		{
+			F32 v1Len = v.dot(light.m_dir.xyz());
+			F32 perp = sqrt(std::max(lenSq - v1Len * v1Len, 0.0f));
+			F32 dist = light.m_outerCos * perp - light.m_outerSin * v1Len;
+
+			hit = dist <= r && v1Len >= -r;
+		}
+
+		mask |= U32(hit) << i;
+	}
+#endif
+
+	// Keep the range only
+	U32 rangeMask = (end == 32) ? 0xFFFFFFFF : ((1U << end) - 1);
+	rangeMask &= ~((1U << begin) - 1);
+	return mask & rangeMask;
+}
+
+//==============================================================================
+U32 Clusterer::computeRowMask(U z, U y) const
+{
+	ANKI_ASSERT(m_tileDepthBounds);
+	F32 d0 = m_sliceDepths[z];
+	F32 d1 = m_sliceDepths[z + 1];
+	const Vec2* bounds = m_tileDepthBounds + y * m_counts[0];
+
+	U32 mask = 0;
+	for(U x = 0; x < m_counts[0]; x++)
+	{
+		Bool overlaps = d0 <= bounds[x].y() && d1 >= bounds[x].x();
+		mask |= U32(overlaps) << x;
+	}
+
+	return mask;
+}
+
+//==============================================================================
+void Clusterer::binSlices(ThreadBins& bins)
+{
+	const U32 countX = m_counts[0];
+	const U32 countY = m_counts[1];
+
+	bins.m_indices.clear();
+	bins.m_lights.clear();
+
+	// Gather the lights that touch the slices of the thread
+	for(U32 i = 0; i < m_lightsCount; i++)
+	{
+		const LightBounds& b = m_lightBounds[i];
+		if(b.m_begin[2] < bins.m_endSlice && b.m_end[2] > bins.m_beginSlice)
+		{
+			bins.m_lights.push_back(i);
+		}
+	}
+
+	for(U32 z = bins.m_beginSlice; z < bins.m_endSlice; z++)
+	{
+		for(U32 y = 0; y < countY; y++)
+		{
+			U32 rowIdx = z * countY + y;
+			const F32* row = &m_spheres[rowIdx * 4 * m_rowStride];
+			U32 rowMask = 
+				(m_tileDepthBounds) ? m_rowMasks[rowIdx] : 0xFFFFFFFF;
+
+			// Test the lights against the row
+			bins.m_rowLights.clear();
+			if(rowMask == 0)
+			{
+				// No geometry in the whole row
+				writeRow(bins, &m_clusters[rowIdx * countX]);
+				continue;
+			}
+
+			for(U32 l : bins.m_lights)
+			{
+				const LightBounds& b = m_lightBounds[l];
+				if(z < b.m_begin[2] || z >= b.m_end[2]
+					|| y < b.m_begin[1] || y >= b.m_end[1])
+				{
+					continue;
+				}
+
+				U32 mask = testRow(m_lights[l], row, b.m_begin[0], b.m_end[0]);
+				mask &= rowMask;
+				if(mask)
+				{
+					bins.m_rowLights.push_back(RowLight{l, mask});
+				}
+			}
+
+			writeRow(bins, &m_clusters[rowIdx * countX]);
+		}
+	}
+}
+
+//==============================================================================
+void Clusterer::writeRow(ThreadBins& bins, ClustererCluster* clusters)
+{
+	const U32 countX = m_counts[0];
+	const U TYPES = U(ClustererLightType::COUNT);
+
+	// Count the lights of every cluster. Visit only the set bits
+	Array<Array<U32, TYPES>, 32> counts;
+	memset(&counts[0][0], 0, sizeof(counts[0]) * countX);
+
+	for(const RowLight& rl : bins.m_rowLights)
+	{
+		U type = U(m_lights[rl.m_light].m_type);
+		for(U32 mask = rl.m_mask; mask; mask &= mask - 1)
+		{
+			U x = countBits((mask & (~mask + 1)) - 1);
+			++counts[x][type];
+		}
+	}
+
+	// Allocate the indices of the clusters. The lights are sorted by type so 
+	// the indices end up grouped by type
+	Array<Array<U32, TYPES>, 32> cursors;
+	U32 offset = bins.m_indices.size();
+	for(U x = 0; x < countX; x++)
+	{
+		clusters[x].m_offset = offset;
+
+		for(U t = 0; t < TYPES; t++)
+		{
+			counts[x][t] = std::min(counts[x][t], m_maxLightsPerCluster[t]);
+			cursors[x][t] = offset;
+			offset += counts[x][t];
+		}
+
+		clusters[x].m_counts = counts[x][0] | (counts[x][1] << 16)
+			| (counts[x][2] << 24);
+	}
+
+	bins.m_indices.resize(offset);
+
+	// Write the indices
+	for(const RowLight& rl : bins.m_rowLights)
+	{
+		const ClustererLight& light = m_lights[rl.m_light];
+		U type = U(light.m_type);
+		for(U32 mask = rl.m_mask; mask; mask &= mask - 1)
+		{
+			U x = countBits((mask & (~mask + 1)) - 1);
+			if(counts[x][type] > 0)
+			{
+				bins.m_indices[cursors[x][type]++] = light.m_index;
+				--counts[x][type];
+			}
+		}
+	}
+}
+
+//==============================================================================
+void Clusterer::bin(const ClustererLight* lights, U32 lightsCount,
+	Threadpool& threadpool)
+{
+	ANKI_ASSERT(m_near > 0.0 && "Forgot to call prepare");
+
+#if ANKI_ASSERTIONS == 1
+	for(U32 i = 1; i < lightsCount; i++)
+	{
+		ANKI_ASSERT(lights[i - 1].m_type <= lights[i].m_type
+			&& "The lights should be sorted by type");
+	}
+#endif
+
+	m_lights = lights;
+	m_lightsCount = lightsCount;
+	if(m_lightBounds.size() < lightsCount)
+	{
+		m_lightBounds.resize(lightsCount);
+	}
+
+	U32 threadsCount = threadpool.getThreadsCount();
+	Array<ClustererSetupTask, Threadpool::MAX_THREADS> setupTasks;
+	Array<ClustererBinTask, Threadpool::MAX_THREADS> binTasks;
+	Array<ClustererMergeTask, Threadpool::MAX_THREADS> mergeTasks;
+
+	// Compute the bounds of the lights
+	for(U32 i = 0; i < threadsCount; i++)
+	{
+		setupTasks[i].m_clusterer = this;
+		threadpool.assignNewTask(i, &setupTasks[i]);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
+
+	// Bin
+	for(U32 i = 0; i < threadsCount; i++)
+	{
+		binTasks[i].m_clusterer = this;
+		threadpool.assignNewTask(i, &binTasks[i]);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
+
+	// Find where the bins of the threads go
+	U32 offset = 0;
+	for(U32 i = 0; i < threadsCount; i++)
+	{
+		m_bins[i].m_offset = offset;
+		offset += m_bins[i].m_indices.size();
+	}
+
+	m_lightIndicesCount = offset;
+	if(m_lightIndices.size() < offset)
+	{
+		m_lightIndices.resize(offset);
+	}
+
+	// Merge
+	for(U32 i = 0; i < threadsCount; i++)
+	{
+		mergeTasks[i].m_clusterer = this;
+		threadpool.assignNewTask(i, &mergeTasks[i]);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
+}
+
+} // end namespace anki
@@ -6,9 +6,7 @@
 #include "anki/renderer/Dbg.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/resource/ProgramResource.h"
-#include "anki/scene/SceneGraph.h"
-#include "anki/scene/Camera.h"
-#include "anki/scene/Light.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/core/Logger.h"
 #include "anki/util/Enum.h"
 
@@ -69,31 +67,32 @@ void Dbg::run(GlCommandBufferHandle& jobs)
 {
 	ANKI_ASSERT(m_enabled);
 
-	SceneGraph& scene = m_r->getSceneGraph();
+	// The next frame may update while this one renders so draw what the
+	// snapshot copied
+	const RenderSnapshot& snapshot = m_r->getRenderSnapshot();
 
 	m_fb.bind(jobs, false);
 	jobs.enableDepthTest(m_depthTest);
 
-	Camera& cam = scene.getActiveCamera();
 	m_drawer->prepareDraw(jobs);
-	m_drawer->setViewProjectionMatrix(cam.getViewProjectionMatrix());
+	m_drawer->setViewProjectionMatrix(snapshot.m_camera.m_viewProjectionMat);
 	m_drawer->setModelMatrix(Mat4::getIdentity());
 	//drawer->drawGrid();
 
-	scene.iterateSceneNodes([&](SceneNode& node)
+	for(U i = 0; i < snapshot.m_debugNodesCount; i++)
 	{
-		SpatialComponent* sp = node.tryGetComponent<SpatialComponent>();
+		const DebugNodeSnapshot& node = snapshot.m_debugNodes[i];
 
-		if(&cam.getComponent<SpatialComponent>() == sp)
+		if(node.m_uuid == snapshot.m_camera.m_uuid)
 		{
-			return;
+			continue;
 		}
 
-		if(bitsEnabled(enumToValue(Flag::SPATIAL)) && sp)
+		if(bitsEnabled(enumToValue(Flag::SPATIAL)))
 		{
 			m_sceneDrawer->draw(node);
 		}
-	});
+	}
 
 	// XXX
 #if 0
@@ -175,14 +174,14 @@ void Dbg::run(GlCommandBufferHandle& jobs)
 #endif
 
 #if 1
+	const DebugNodeSnapshot* shape0 = snapshot.findDebugNode("shape0");
+	const DebugNodeSnapshot* shape1 = snapshot.findDebugNode("shape1");
+	if(shape0 && shape1)
 	{
-		Vec4 pos0 = scene.findSceneNode("shape0").
-			getComponent<MoveComponent>().getWorldTransform().getOrigin();
+		Vec4 pos0 = shape0->m_worldTransform.getOrigin();
 
-		Vec4 pos1 = scene.findSceneNode("shape1").
-			getComponent<MoveComponent>().getWorldTransform().getOrigin();
-		Mat3x4 rot1 = scene.findSceneNode("shape1").
-			getComponent<MoveComponent>().getWorldTransform().getRotation();
+		Vec4 pos1 = shape1->m_worldTransform.getOrigin();
+		Mat3x4 rot1 = shape1->m_worldTransform.getRotation();
 
 		Aabb s0(pos0 - Vec4(1.0, 1.0, 2.0, 0.0), pos0 + Vec4(1.0, 1.0, 2.0, 0.0));
 		Obb s1(pos1, rot1, Vec4(1.0, 0.5, 2.5, 0.0));
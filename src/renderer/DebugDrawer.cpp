@@ -8,6 +8,7 @@
 #include "anki/resource/ProgramResource.h"
 #include "anki/Collision.h"
 #include "anki/Scene.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/resource/TextureResource.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/core/Logger.h"
@@ -434,51 +435,32 @@ void CollisionDebugDrawer::visit(const Frustum& f)
 //==============================================================================
 
 //==============================================================================
-void SceneDebugDrawer::draw(SceneNode& node)
+void SceneDebugDrawer::draw(const DebugNodeSnapshot& node)
 {
-	MoveComponent* mv = node.tryGetComponent<MoveComponent>();
-	if(mv)
-	{
-		m_dbg->setModelMatrix(Mat4(mv->getWorldTransform()));
-	}
-	else
-	{
-		m_dbg->setModelMatrix(Mat4::getIdentity());
-	}
-
-	FrustumComponent* fr = node.tryGetComponent<FrustumComponent>();
-	if(fr)
-	{
-		draw(*fr);
-	}
-
-	node.iterateComponentsOfType<SpatialComponent>([&](SpatialComponent& sp)
-	{
-		draw(sp);
-	});
-}
-
-//==============================================================================
-void SceneDebugDrawer::draw(FrustumComponent& fr) const
-{
-	const Frustum& fs = fr.getFrustum();
-
-	m_dbg->setColor(Vec3(1.0, 1.0, 0.0));
+	m_dbg->setModelMatrix(Mat4(node.m_worldTransform));
 	CollisionDebugDrawer coldraw(m_dbg);
-	fs.accept(coldraw);
-}
 
-//==============================================================================
-void SceneDebugDrawer::draw(SpatialComponent& x) const
-{
-	if(!x.bitsEnabled(SpatialComponent::SF_VISIBLE_CAMERA))
+	if(node.m_hasFrustum)
 	{
-		return;
+		m_dbg->setColor(Vec3(1.0, 1.0, 0.0));
+
+		if(node.m_frustumType == Frustum::Type::PERSPECTIVE)
+		{
+			PerspectiveFrustum fs(
+				node.m_fovX, node.m_fovY, node.m_near, node.m_far);
+			fs.accept(coldraw);
+		}
+		else
+		{
+			node.m_frustumObb.accept(coldraw);
+		}
 	}
 
 	m_dbg->setColor(Vec3(1.0, 0.0, 1.0));
-	CollisionDebugDrawer coldraw(m_dbg);
-	x.getAabb().accept(coldraw);
+	for(U i = 0; i < node.m_aabbsCount; i++)
+	{
+		node.m_aabbs[i].accept(coldraw);
+	}
 }
 
 //==============================================================================
@@ -4,12 +4,12 @@
 // http://www.anki3d.org/LICENSE
 
 #include "anki/renderer/Drawer.h"
+#include "anki/renderer/RenderQueue.h"
 #include "anki/resource/ProgramResource.h"
-#include "anki/scene/FrustumComponent.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/resource/Material.h"
 #include "anki/scene/RenderComponent.h"
 #include "anki/scene/Visibility.h"
-#include "anki/scene/SceneGraph.h"
 #include "anki/resource/TextureResource.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/core/Counters.h"
@@ -25,10 +25,11 @@ public:
 	// Used to get the visible spatials
 	Ptr<VisibleNode> m_visibleNode;
 
-	Ptr<RenderComponent> m_renderable; ///< To get the transforms
-	Ptr<RenderComponentVariable> m_rvar;
-	Ptr<const FrustumComponent> m_fr;
+	Ptr<const RenderableSnapshot> m_renderable; ///< To get the material
+	Ptr<const RenderComponentVariableSnapshot> m_var;
+	Ptr<const FrustumSnapshot> m_fr;
 	Ptr<RenderableDrawer> m_drawer;
+	SceneFrameAllocator<U8> m_alloc; ///< The allocator of the frame
 	U8 m_instanceCount;
 	GlCommandBufferHandle m_jobs;
 
@@ -41,20 +42,22 @@ public:
 	{
 		uni.writeClientMemory(
 			m_drawer->m_uniformPtr,
-			m_renderable->getMaterial().getDefaultBlockSize(),
+			m_renderable->m_material->getDefaultBlockSize(),
 			value, 
 			size);
 	}
 
-	template<typename TRenderableVariableTemplate>
-	void visit(const TRenderableVariableTemplate& rvar)
+	template<typename TMaterialVariableTemplate>
+	void visit(const TMaterialVariableTemplate& mvar)
 	{
-		typedef typename TRenderableVariableTemplate::Type DataType;
-		const GlProgramVariable& glvar = rvar.getGlProgramVariable();
+		typedef typename TMaterialVariableTemplate::Type DataType;
+		const GlProgramVariable& glvar = mvar.getGlProgramVariable();
+		const DataType* values = 
+			static_cast<const DataType*>(m_var->m_values);
 
 		// Array size
 		U arraySize;
-		if(rvar.isInstanced())
+		if(mvar.isInstanced())
 		{
 			arraySize = std::min<U>(m_instanceCount, glvar.getArraySize());
 		}
@@ -65,29 +68,25 @@ public:
 
 		// Set uniform
 		//
-		Bool hasWorldTrfs = m_renderable->getHasWorldTransforms();
-		const Mat4& vp = m_fr->getViewProjectionMatrix();
-		const Mat4& v = m_fr->getViewMatrix();
+		const Transform* worldTrfs = m_visibleNode->m_transforms;
+		Bool hasWorldTrfs = worldTrfs != nullptr;
+		const Mat4& vp = m_fr->m_viewProjectionMat;
+		const Mat4& v = m_fr->m_viewMat;
 
-		switch(rvar.getBuildinId())
+		switch(m_var->m_buildinId)
 		{
 		case BuildinMaterialVariableId::NO_BUILDIN:
-			uniSet<DataType>(glvar, rvar.begin(), arraySize);
+			ANKI_ASSERT(values);
+			uniSet<DataType>(glvar, values, arraySize);
 			break;
 		case BuildinMaterialVariableId::MVP_MATRIX:
 			if(hasWorldTrfs)
 			{
-				Mat4* mvp = m_drawer->m_r->getSceneGraph().getFrameAllocator().
-					newInstance<Mat4>(arraySize);
+				Mat4* mvp = m_alloc.newInstance<Mat4>(arraySize);
 
 				for(U i = 0; i < arraySize; i++)
 				{
-					Transform worldTrf;
-
-					m_renderable->getRenderWorldTransform(
-						m_visibleNode->getSpatialIndex(i), worldTrf);
-
-					mvp[i] = vp * Mat4(worldTrf);
+					mvp[i] = vp * Mat4(worldTrfs[i]);
 				}
 
 				uniSet(glvar, &mvp[0], arraySize);
@@ -101,17 +100,11 @@ public:
 		case BuildinMaterialVariableId::MV_MATRIX:
 			{
 				ANKI_ASSERT(hasWorldTrfs);
-				Mat4* mv = m_drawer->m_r->getSceneGraph().getFrameAllocator().
-					newInstance<Mat4>(arraySize);
+				Mat4* mv = m_alloc.newInstance<Mat4>(arraySize);
 
 				for(U i = 0; i < arraySize; i++)
 				{
-					Transform worldTrf;
-
-					m_renderable->getRenderWorldTransform(
-						m_visibleNode->getSpatialIndex(i), worldTrf);
-
-					mv[i] = v * Mat4(worldTrf);
+					mv[i] = v * Mat4(worldTrfs[i]);
 				}
 
 				uniSet(glvar, &mv[0], arraySize);
@@ -123,18 +116,11 @@ public:
 		case BuildinMaterialVariableId::NORMAL_MATRIX:
 			if(hasWorldTrfs)
 			{
-				Mat3* normMats = 
-					m_drawer->m_r->getSceneGraph().getFrameAllocator().
-					newInstance<Mat3>(arraySize);
+				Mat3* normMats = m_alloc.newInstance<Mat3>(arraySize);
 
 				for(U i = 0; i < arraySize; i++)
 				{
-					Transform worldTrf;
-
-					m_renderable->getRenderWorldTransform(
-						m_visibleNode->getSpatialIndex(i), worldTrf);
-
-					Mat4 mv = v * Mat4(worldTrf);
+					Mat4 mv = v * Mat4(worldTrfs[i]);
 					normMats[i] = mv.getRotationPart();
 					normMats[i].reorthogonalize();
 				}
@@ -153,18 +139,16 @@ public:
 			break;
 		case BuildinMaterialVariableId::BILLBOARD_MVP_MATRIX:
 			{
+				ANKI_ASSERT(hasWorldTrfs);
+
 				// Calc the billboard rotation matrix
-				Mat3 rot =
-					m_fr->getViewMatrix().getRotationPart().getTransposed();
+				Mat3 rot = v.getRotationPart().getTransposed();
 
-				Mat4* bmvp = 
-					m_drawer->m_r->getSceneGraph().getFrameAllocator().
-					newInstance<Mat4>(arraySize);
+				Mat4* bmvp = m_alloc.newInstance<Mat4>(arraySize);
 
 				for(U i = 0; i < arraySize; i++)
 				{
-					Transform trf;
-					m_renderable->getRenderWorldTransform(i, trf);
+					Transform trf = worldTrfs[i];
 					trf.setRotation(Mat3x4(rot));
 					bmvp[i] = vp * Mat4(trf);
 				}
@@ -174,8 +158,8 @@ public:
 			break;
 		case BuildinMaterialVariableId::MAX_TESS_LEVEL:
 			{
-				F32 maxtess = 
-					rvar.RenderComponentVariable:: template operator[]<F32>(0);
+				ANKI_ASSERT(values);
+				F32 maxtess = *reinterpret_cast<const F32*>(values);
 				F32 tess = 0.0;
 				
 				if(m_flod >= 1.0)
@@ -201,7 +185,8 @@ public:
 			{
 				auto unit = glvar.getTextureUnit();
 
-				m_drawer->m_r->getMs()._getSmallDepthRt().bind(m_jobs, unit);
+				m_drawer->bindTexture(
+					m_drawer->m_r->getMs()._getSmallDepthRt(), unit);
 			}
 			break;
 		default:
@@ -221,55 +206,30 @@ void SetupRenderableVariableVisitor::uniSet<TextureResourcePointer>(
 	GlTextureHandle tex = (*values)->getGlTexture();
 	auto unit = uni.getTextureUnit();
 
-	tex.bind(m_jobs, unit);
+	m_drawer->bindTexture(tex, unit);
 }
 
 //==============================================================================
 RenderableDrawer::RenderableDrawer(Renderer* r)
 	: m_r(r)
-{
-	// Create the uniform buffer
-	GlDevice& gl = GlDeviceSingleton::get();
-	GlCommandBufferHandle jobs(&gl);
-	m_uniformBuff = GlBufferHandle(jobs, GL_UNIFORM_BUFFER, 
-		MAX_UNIFORM_BUFFER_SIZE,
-		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-	jobs.flush();
-
-	m_uniformPtr = (U8*)m_uniformBuff.getPersistentMappingAddress();
-	ANKI_ASSERT(m_uniformPtr != nullptr);
-	ANKI_ASSERT(isAligned(gl.getBufferOffsetAlignment(
-		m_uniformBuff.getTarget()), m_uniformPtr));
-
-	// Set some other values
-	m_uniformsUsedSize = 0;
-	m_uniformsUsedSizeFrame = 0;
-}
+{}
 
 //==============================================================================
 void RenderableDrawer::setupUniforms(
 	VisibleNode& visibleNode, 
-	RenderComponent& renderable,
-	FrustumComponent& fr,
+	const RenderableSnapshot& renderable,
+	const FrustumSnapshot& fr,
 	F32 flod)
 {
-	const Material& mtl = renderable.getMaterial();
+	const Material& mtl = *renderable.m_material;
 	U blockSize = mtl.getDefaultBlockSize();
-	U8* persistent = (U8*)m_uniformBuff.getPersistentMappingAddress();
 
-	// Find a place to write the uniforms
+	// Get memory for the uniforms
 	//
-	U8* prevUniformPtr = m_uniformPtr;
-	alignRoundUp(GlDeviceSingleton::get().getBufferOffsetAlignment(
-		m_uniformBuff.getTarget()), m_uniformPtr);
-	U diff = m_uniformPtr - prevUniformPtr;
-
-	if(m_uniformPtr + blockSize >= persistent + m_uniformBuff.getSize())
-	{
-		// Rewind
-		m_uniformPtr = persistent;
-		diff = 0;
-	}
+	GlBufferHandle buff;
+	PtrSize offset;
+	m_uniformPtr = (U8*)m_r->_getGlDevice().allocateTransientMemory(
+		GlTransientMemoryType::UNIFORM, blockSize, buff, offset);
 
 	// Call the visitor
 	//
@@ -279,77 +239,90 @@ void RenderableDrawer::setupUniforms(
 	vis.m_renderable = &renderable;
 	vis.m_fr = &fr;
 	vis.m_drawer = this;
+	vis.m_alloc = m_r->getRenderSnapshot().m_frameAlloc;
 	vis.m_instanceCount = visibleNode.m_spatialsCount;
 	vis.m_jobs = m_jobs;
 	vis.m_flod = flod;
 
-	for(auto it = renderable.getVariablesBegin();
-		it != renderable.getVariablesEnd(); ++it)
+	for(U i = 0; i < renderable.m_variablesCount; i++)
 	{
-		RenderComponentVariable* rvar = *it;
+		const RenderComponentVariableSnapshot& var = 
+			renderable.m_variables[i];
 
-		vis.m_rvar = rvar;
-		rvar->acceptVisitor(vis);
+		vis.m_var = &var;
+		var.m_mvar->acceptVisitor(vis);
 	}
 
 	// Update the uniform descriptor
 	//
-	m_uniformBuff.bindShaderBuffer(
-		m_jobs, 
-		m_uniformPtr - persistent,
-		mtl.getDefaultBlockSize(),
-		0);
-
-	// Advance the uniform ptr
-	m_uniformPtr += blockSize;
-	m_uniformsUsedSize += blockSize + diff;
+	buff.bindShaderBuffer(m_jobs, offset, blockSize, 0);
 }
 
 //==============================================================================
-void RenderableDrawer::render(SceneNode& frsn, VisibleNode& visibleNode)
+void RenderableDrawer::bindTexture(GlTextureHandle& tex, U32 unit)
 {
-	RenderingBuildData build;
+	if(unit < MAX_TEXTURE_UNITS)
+	{
+		if(m_textures[unit] == tex)
+		{
+			return;
+		}
 
-	// Get components
-	FrustumComponent& fr = frsn.getComponent<FrustumComponent>();
-	RenderComponent& renderable = 
-		visibleNode.m_node->getComponent<RenderComponent>();
-	const Material& mtl = renderable.getMaterial();
+		m_textures[unit] = tex;
+	}
 
-	// Calculate the key
-	RenderingKey key;
+	tex.bind(m_jobs, unit);
+	++m_stateChanges;
+}
 
-	Vec4 camPos = fr.getFrustumOrigin();
+//==============================================================================
+Bool RenderableDrawer::acceptMaterial(const Material& mtl) const
+{
+	Bool blending = mtl.isBlendingEnabled();
+	return (blending && m_stage == RenderingStage::BLEND)
+		|| (!blending && m_stage != RenderingStage::BLEND);
+}
 
-	F32 dist = (visibleNode.m_node->getComponent<SpatialComponent>().
-		getSpatialOrigin() - camPos).getLength();
-	F32 flod = m_r->calculateLod(dist);
-	build.m_key.m_lod = flod;
-	build.m_key.m_pass = m_pass;
-	build.m_key.m_tessellation = 
+//==============================================================================
+void RenderableDrawer::computeRenderingKey(const Material& mtl, F32 flod, 
+	RenderingKey& key) const
+{
+	key.m_lod = flod;
+	key.m_pass = m_pass;
+	key.m_tessellation = 
 		m_r->usesTessellation() 
 		&& mtl.getTessellation()
-		&& build.m_key.m_lod == 0;
+		&& key.m_lod == 0;
+}
+
+//==============================================================================
+void RenderableDrawer::renderInternal(
+	VisibleNode& visibleNode,
+	const RenderableSnapshot& renderable,
+	const FrustumSnapshot& fr,
+	F32 flod,
+	const void* const* mergedRenderStates,
+	U32 mergedRenderStatesCount)
+{
+	RenderingBuildData build;
+	const Material& mtl = *renderable.m_material;
+
+	computeRenderingKey(mtl, flod, build.m_key);
 
 	// Blending
-	Bool blending = mtl.isBlendingEnabled();
-	if(!blending)
+	if(mtl.isBlendingEnabled())
 	{
-		if(m_stage == RenderingStage::BLEND)
+		GLenum sfactor = mtl.getBlendingSfactor();
+		GLenum dfactor = mtl.getBlendingDfactor();
+
+		if(sfactor != m_blendSfactor || dfactor != m_blendDfactor)
 		{
-			return;
+			m_jobs.setBlendFunctions(sfactor, dfactor);
+			m_blendSfactor = sfactor;
+			m_blendDfactor = dfactor;
+			++m_stateChanges;
 		}
 	}
-	else
-	{
-		if(m_stage != RenderingStage::BLEND)
-		{
-			return;
-		}
-
-		m_jobs.setBlendFunctions(
-			mtl.getBlendingSfactor(), mtl.getBlendingDfactor());
-	}
 
 #if ANKI_GL == ANKI_GL_DESKTOP
 	// TODO Set wireframe
@@ -362,8 +335,142 @@ void RenderableDrawer::render(SceneNode& frsn, VisibleNode& visibleNode)
 	build.m_subMeshIndicesArray = &visibleNode.m_spatialIndices[0];
 	build.m_subMeshIndicesCount = visibleNode.m_spatialsCount;
 	build.m_jobs = m_jobs;
+	build.m_state = &m_state;
+	build.m_gl = &m_r->_getGlDevice();
+	build.m_renderState = renderable.m_renderState;
+	build.m_clusters = visibleNode.m_clusters;
+	build.m_mergedRenderStates = mergedRenderStates;
+	build.m_mergedRenderStatesCount = mergedRenderStatesCount;
+
+	renderable.m_buildRendering(build);
+}
 
-	renderable.buildRendering(build);
+//==============================================================================
+void RenderableDrawer::render(const FrustumSnapshot& fr, 
+	VisibleNode& visibleNode)
+{
+	const RenderableSnapshot& renderable = *visibleNode.m_renderable;
+
+	if(!acceptMaterial(*renderable.m_material))
+	{
+		return;
+	}
+
+	renderInternal(visibleNode, renderable, fr, visibleNode.m_lod, nullptr, 0);
+}
+
+//==============================================================================
+void RenderableDrawer::render(
+	const FrustumSnapshot& fr,
+	VisibleNode* begin,
+	VisibleNode* end)
+{
+	ANKI_ASSERT(begin <= end);
+	if(begin == end)
+	{
+		return;
+	}
+
+	F32 far = fr.m_far;
+	SceneFrameAllocator<U8> alloc = m_r->getRenderSnapshot().m_frameAlloc;
+
+	// The blended spatials are sorted one by one
+	U32 elementsCount = 0;
+	for(VisibleNode* it = begin; it != end; ++it)
+	{
+		elementsCount += 
+			(it->m_spatialDistances) ? it->m_spatialsCount : 1;
+	}
+
+	RenderQueue queue(alloc, elementsCount);
+
+	// Compute the keys
+	for(VisibleNode* it = begin; it != end; ++it)
+	{
+		const RenderableSnapshot& renderable = *it->m_renderable;
+		const Material& mtl = *renderable.m_material;
+
+		if(!acceptMaterial(mtl))
+		{
+			continue;
+		}
+
+		F32 flod = it->m_lod;
+
+		RenderingKey key;
+		computeRenderingKey(mtl, flod, key);
+
+		if(it->m_spatialDistances == nullptr || !mtl.isBlendingEnabled())
+		{
+			U64 sortKey = RenderQueue::computeKey(key, mtl.getHash(), 
+				(U64)(PtrSize)&mtl, renderable.m_meshId, 
+				it->m_distance / far, mtl.isBlendingEnabled());
+
+			queue.pushBack(sortKey, it, flod);
+			continue;
+		}
+
+		// A view of every spatial so it's drawn in its depth order
+		VisibleNode* views = alloc.newArray<VisibleNode>(it->m_spatialsCount);
+		for(U i = 0; i < it->m_spatialsCount; i++)
+		{
+			VisibleNode& view = views[i];
+			view.m_spatialIndices = &it->m_spatialIndices[i];
+			view.m_spatialsCount = 1;
+			view.m_transforms = 
+				(it->m_transforms) ? &it->m_transforms[i] : nullptr;
+			view.m_distance = it->m_spatialDistances[i];
+			view.m_lod = it->m_lod;
+			view.m_renderable = it->m_renderable;
+			view.m_clusters = it->m_clusters;
+
+			U64 sortKey = RenderQueue::computeKey(key, mtl.getHash(), 
+				(U64)(PtrSize)&mtl, renderable.m_meshId, 
+				view.m_distance / far, true);
+
+			queue.pushBack(sortKey, &view, flod);
+		}
+	}
+
+	queue.sort();
+
+	// Draw
+	const void** mergedStates = nullptr;
+	const RenderQueueElement* it = queue.begin();
+	while(it != queue.end())
+	{
+		const RenderQueueElement& el = *it;
+		const RenderableSnapshot& renderable = *el.m_node->m_renderable;
+		++it;
+
+		// Gather the next renderables that can be drawn with this one
+		U32 mergedCount = 0;
+		U64 mergeKey = (el.m_node->m_transforms == nullptr) 
+			? renderable.m_mergeKey : 0;
+
+		while(mergeKey != 0 && it != queue.end() 
+			&& it->m_node->m_transforms == nullptr
+			&& U8(it->m_flod) == U8(el.m_flod))
+		{
+			const RenderableSnapshot& next = *it->m_node->m_renderable;
+			if(next.m_mergeKey != mergeKey 
+				|| next.m_material != renderable.m_material)
+			{
+				break;
+			}
+
+			if(mergedStates == nullptr)
+			{
+				mergedStates = alloc.newArray<const void*>(queue.getSize());
+			}
+
+			mergedStates[mergedCount++] = next.m_renderState;
+			++it;
+		}
+
+		renderInternal(*el.m_node, renderable, fr, el.m_flod, 
+			mergedStates, mergedCount);
+	}
 }
 
 //==============================================================================
@@ -375,23 +482,29 @@ void RenderableDrawer::prepareDraw(RenderingStage stage, Pass pass,
 	m_pass = pass;
 	m_jobs = jobs;
 
-	if(m_r->getFramesCount() > m_uniformsUsedSizeFrame)
+	// Forget the state of the previous job chain
+	m_state.reset();
+	m_blendSfactor = GL_NONE;
+	m_blendDfactor = GL_NONE;
+	for(GlTextureHandle& tex : m_textures)
 	{
-		// New frame, reset used size
-		m_uniformsUsedSize = 0;
-		m_uniformsUsedSizeFrame = m_r->getFramesCount();
+		tex = GlTextureHandle();
 	}
+	m_stateChanges = 0;
 }
 
 //==============================================================================
 void RenderableDrawer::finishDraw()
 {
-	// Release the job chain
-	m_jobs = GlCommandBufferHandle();
+	ANKI_COUNTER_INC(RENDERER_STATE_CHANGES, 
+		U64(m_stateChanges + m_state.getStateChangesCount()));
 
-	if(m_uniformsUsedSize > MAX_UNIFORM_BUFFER_SIZE / 3)
+	// Release the job chain and the state that holds references
+	m_jobs = GlCommandBufferHandle();
+	m_state.reset();
+	for(GlTextureHandle& tex : m_textures)
 	{
-		ANKI_LOGW("Increase the uniform buffer to avoid corruption");
+		tex = GlTextureHandle();
 	}
 }
 
@@ -7,7 +7,7 @@
 #include "anki/renderer/Renderer.h"
 #include "anki/core/App.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/scene/Camera.h"
+#include "anki/scene/RenderSnapshot.h"
 
 namespace anki {
 
@@ -23,10 +23,8 @@ void Ez::run(GlCommandBufferHandle& jobs)
 {
 	ANKI_ASSERT(m_enabled);
 
-	SceneGraph& scene = m_r->getSceneGraph();
-	Camera& cam = scene.getActiveCamera();
-
-	VisibilityTestResults& vi = cam.getVisibilityTestResults();
+	const FrustumSnapshot& cam = m_r->getRenderSnapshot().m_camera;
+	VisibilityTestResults& vi = *cam.m_visible;
 
 	m_r->getSceneDrawer().prepareDraw(
 		RenderingStage::MATERIAL, Pass::DEPTH, jobs);
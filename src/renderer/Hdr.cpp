@@ -129,6 +129,26 @@ void Hdr::run(GlCommandBufferHandle& jobs)
 {
 	ANKI_ASSERT(m_enabled);
 
+	if(m_parameterUpdateTimestamp > m_commonUboUpdateTimestamp)
+	{
+		updateDefaultBlock(jobs);
+		m_commonUboUpdateTimestamp = getGlobTimestamp();
+	}
+
+	if(!m_bundle.isCreated())
+	{
+		recordBundle();
+	}
+
+	jobs.pushBackOtherCommandBuffer(m_bundle);
+}
+
+//==============================================================================
+void Hdr::recordBundle()
+{
+	m_bundle = GlCommandBufferHandle(&getGlDevice());
+	GlCommandBufferHandle& jobs = m_bundle;
+
 	// For the passes it should be NEAREST
 	//vblurFai.setFiltering(Texture::TFrustumType::NEAREST);
 
@@ -137,12 +157,6 @@ void Hdr::run(GlCommandBufferHandle& jobs)
 	jobs.setViewport(0, 0, m_width, m_height);
 	m_tonePpline.bind(jobs);
 
-	if(m_parameterUpdateTimestamp > m_commonUboUpdateTimestamp)
-	{
-		updateDefaultBlock(jobs);
-		m_commonUboUpdateTimestamp = getGlobTimestamp();
-	}
-
 	m_r->getIs()._getRt().bind(jobs, 0);
 	m_commonBuff.bindShaderBuffer(jobs, 0);
 
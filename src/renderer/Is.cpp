@@ -6,11 +6,12 @@
 #include "anki/renderer/Is.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/scene/Camera.h"
-#include "anki/scene/Light.h"
+#include "anki/scene/RenderSnapshot.h"
+#include "anki/math/Batch.h"
 #include "anki/core/Counters.h"
 #include "anki/core/Logger.h"
 #include <sstream>
+#include <cstddef>
 
 namespace anki {
 
@@ -64,10 +65,27 @@ public:
 	Vec4 m_projectionParams;
 	Vec4 m_sceneAmbientColor;
 	Vec4 m_groundLightDir;
+	Vec4 m_clusterParams; ///< xy: The slice params of the Clusterer
 };
 
 } // end namespace shader
 
+//==============================================================================
+/// The parameters of the bundle of the light pass. The offsets and the sizes
+/// in the transient memory
+class LightPassParameters
+{
+public:
+	/// The transient buffers. The ring buffer creates a new one when it
+	/// grows so they may differ from frame to frame
+	const GlBuffer* m_commonBuff;
+	const GlBuffer* m_clustersBuff;
+	const GlBuffer* m_indicesBuff;
+	Array<I32, 2> m_commonRange;
+	Array<I32, 2> m_clustersRange;
+	Array<I32, 2> m_indicesRange;
+};
+
 //==============================================================================
 /// Write the lights to a client buffer
 class WriteLightsJob: public Threadpool::Task
@@ -77,64 +95,37 @@ public:
 	shader::SpotLight* m_spotLights = nullptr;
 	shader::SpotTexLight* m_spotTexLights = nullptr;
 
-	U8* m_tileBuffer = nullptr;
+	/// The input of the Clusterer. The point lights go first, then the spots
+	/// and then the spot tex lights
+	ClustererLight* m_clustererLights = nullptr;
 
-	VisibilityTestResults::Container::const_iterator m_lightsBegin;
-	VisibilityTestResults::Container::const_iterator m_lightsEnd;
+	const LightSnapshot* m_lights = nullptr;
+	U32 m_lightsCount = 0;
 
 	std::atomic<U32>* m_pointLightsCount = nullptr;
 	std::atomic<U32>* m_spotLightsCount = nullptr;
 	std::atomic<U32>* m_spotTexLightsCount = nullptr;
-		
-	Array2d<std::atomic<U32>, 
-		ANKI_RENDERER_MAX_TILES_Y, 
-		ANKI_RENDERER_MAX_TILES_X>
-		* m_tilePointLightsCount = nullptr,
-		* m_tileSpotLightsCount = nullptr,
-		* m_tileSpotTexLightsCount = nullptr;
-
-	Tiler* m_tiler = nullptr;
-	Is* m_is = nullptr;
 
-	/// Bin lights on CPU path
-	Bool m_binLights = true;
+	Is* m_is = nullptr;
 
 	void operator()(U32 threadId, PtrSize threadsCount)
 	{
-		U ligthsCount = m_lightsEnd - m_lightsBegin;
-
 		// Count job bounds
 		PtrSize start, end;
-		choseStartEnd(threadId, threadsCount, ligthsCount, start, end);
+		choseStartEnd(threadId, threadsCount, m_lightsCount, start, end);
 
 		// Run all lights
 		for(U64 i = start; i < end; i++)
 		{
-			SceneNode* snode = (*(m_lightsBegin + i)).m_node;
-			Light* light = staticCastPtr<Light*>(snode);
+			const LightSnapshot& light = m_lights[i];
 
-			switch(light->getLightType())
+			switch(light.m_type)
 			{
 			case Light::LT_POINT:
-				{
-					PointLight& l = 
-						*staticCastPtr<PointLight*>(light);
-					I pos = doLight(l);
-					if(m_binLights && pos != -1)
-					{
-						binLight(l, pos);
-					}
-				}
+				doPointLight(light);
 				break;
 			case Light::LT_SPOT:
-				{
-					SpotLight& l = *staticCastPtr<SpotLight*>(light);
-					I pos = doLight(l);
-					if(m_binLights && pos != -1)
-					{
-						binLight(l, pos);
-					}
-				}
+				doSpotLight(light);
 				break;
 			default:
 				ANKI_ASSERT(0);
@@ -144,7 +135,7 @@ public:
 	}
 
 	/// Copy CPU light to GPU buffer
-	I doLight(const PointLight& light)
+	I doPointLight(const LightSnapshot& light)
 	{
 		// Get GPU light
 		I i = m_pointLightsCount->fetch_add(1);
@@ -155,26 +146,31 @@ public:
 
 		shader::PointLight& slight = m_pointLights[i];
 
-		const Camera* cam = m_is->m_cam;
+		const FrustumSnapshot* cam = m_is->m_cam;
 		ANKI_ASSERT(cam);
 	
-		Vec4 pos = 
-			cam->getViewMatrix() * light.getWorldTransform().getOrigin().xyz1();
+		Vec4 pos = cam->m_viewMat * light.m_worldTransform.getOrigin().xyz1();
+
+		slight.m_posRadius = Vec4(pos.xyz(), -1.0 / light.m_radius);
+		slight.m_diffuseColorShadowmapId = light.m_diffuseColor;
+		slight.m_specularColorTexId = light.m_specularColor;
 
-		slight.m_posRadius = Vec4(pos.xyz(), -1.0 / light.getRadius());
-		slight.m_diffuseColorShadowmapId = light.getDiffuseColor();
-		slight.m_specularColorTexId = light.getSpecularColor();
+		ClustererLight& clight = m_clustererLights[i];
+		clight.m_posRadius = Vec4(pos.xyz(), light.m_radius);
+		clight.m_index = i;
+		clight.m_type = ClustererLightType::POINT;
 
 		return i;
 	}
 
 	/// Copy CPU spot light to GPU buffer
-	I doLight(const SpotLight& light)
+	I doSpotLight(const LightSnapshot& light)
 	{
-		const Camera* cam = m_is->m_cam;
-		Bool isTexLight = light.getShadowEnabled();
+		const FrustumSnapshot* cam = m_is->m_cam;
+		Bool isTexLight = light.m_frustum != nullptr;
 		I i;
 		shader::SpotLight* baseslight = nullptr;
+		ClustererLight* clight = nullptr;
 
 		if(isTexLight)
 		{
@@ -189,6 +185,10 @@ public:
 			shader::SpotTexLight& slight = m_spotTexLights[i];
 			baseslight = &slight;
 
+			clight = &m_clustererLights[
+				m_is->m_maxPointLights + m_is->m_maxSpotLights + i];
+			clight->m_type = ClustererLightType::SPOT_TEX;
+
 			// Write matrix
 			static const Mat4 biasMat4(
 				0.5, 0.0, 0.0, 0.5, 
@@ -196,9 +196,10 @@ public:
 				0.0, 0.0, 0.5, 0.5, 
 				0.0, 0.0, 0.0, 1.0);
 			// bias * proj_l * view_l * world_c
-			slight.m_texProjectionMat = biasMat4 * light.getProjectionMatrix() 
-				* Mat4::combineTransformations(light.getViewMatrix(),
-				Mat4(cam->getWorldTransform()));
+			slight.m_texProjectionMat = biasMat4 
+				* light.m_frustum->m_projectionMat 
+				* Mat4::combineTransformations(light.m_frustum->m_viewMat,
+				Mat4(cam->m_worldTransform));
 
 			// Transpose because of driver bug
 			slight.m_texProjectionMat.transpose();
@@ -215,153 +216,51 @@ public:
 
 			shader::SpotLight& slight = m_spotLights[i];
 			baseslight = &slight;
+
+			clight = &m_clustererLights[m_is->m_maxPointLights + i];
+			clight->m_type = ClustererLightType::SPOT;
 		}
 
 		// Write common stuff
 		ANKI_ASSERT(baseslight);
 
 		// Pos & dist
-		Vec4 pos = 
-			cam->getViewMatrix() * light.getWorldTransform().getOrigin().xyz1();
-		baseslight->m_posRadius = Vec4(pos.xyz(), -1.0 / light.getDistance());
+		Vec4 pos = cam->m_viewMat * light.m_worldTransform.getOrigin().xyz1();
+		baseslight->m_posRadius = Vec4(pos.xyz(), -1.0 / light.m_radius);
 
 		// Diff color and shadowmap ID now
 		baseslight->m_diffuseColorShadowmapId = 
-			Vec4(light.getDiffuseColor().xyz(), (F32)light.getShadowMapIndex());
+			Vec4(light.m_diffuseColor.xyz(), (F32)light.m_shadowMapIndex);
 
 		// Spec color
-		baseslight->m_specularColorTexId = light.getSpecularColor();
+		baseslight->m_specularColorTexId = light.m_specularColor;
 
 		// Light dir
-		Vec3 lightDir = -light.getWorldTransform().getRotation().getZAxis();
-		lightDir = cam->getViewMatrix().getRotationPart() * lightDir;
+		Vec3 lightDir = -light.m_worldTransform.getRotation().getZAxis();
+		lightDir = cam->m_viewMat.getRotationPart() * lightDir;
 		baseslight->m_lightDir = Vec4(lightDir, 0.0);
 		
 		// Angles
 		baseslight->m_outerCosInnerCos = Vec4(
-			light.getOuterAngleCos(),
-			light.getInnerAngleCos(), 
+			light.m_outerCos,
+			light.m_innerCos, 
 			1.0, 
 			1.0);
 
 		// extend points
-		const PerspectiveFrustum& frustum = light.getFrustum();
-
-		for(U i = 0; i < 4; i++)
-		{
-			Vec4 extendPoint = light.getWorldTransform().getOrigin() 
-				+ frustum.getLineSegments()[i].getDirection();
+		transformPoints(cam->m_viewMat, &light.m_extendPoints[0], 
+			&baseslight->m_extendPoints[0], 4);
 
-			extendPoint = cam->getViewMatrix() * extendPoint.xyz1();
-			baseslight->m_extendPoints[i] = extendPoint;
-		}
+		// The clusterer input
+		clight->m_posRadius = Vec4(pos.xyz(), light.m_radius);
+		clight->m_dir = Vec4(lightDir, 0.0);
+		clight->m_outerCos = light.m_outerCos;
+		clight->m_outerSin = sqrt(std::max(0.0f, 
+			1.0f - clight->m_outerCos * clight->m_outerCos));
+		clight->m_index = i;
 
 		return i;
 	}
-
-	// Bin point light
-	void binLight(PointLight& light, U pos)
-	{
-		// Do the tests
-		Tiler::Bitset bitset;
-		m_tiler->test(light.getSpatialCollisionShape(), true, &bitset);
-
-		// Bin to the correct tiles
-		PtrSize tilesCount = 
-			m_is->m_r->getTilesCount().x() * m_is->m_r->getTilesCount().y();
-		for(U t = 0; t < tilesCount; t++)
-		{
-			// If not in tile bye
-			if(!bitset.test(t))
-			{
-				continue;
-			}
-
-			U x = t % m_is->m_r->getTilesCount().x();
-			U y = t / m_is->m_r->getTilesCount().x();
-
-			U tilePos = (*m_tilePointLightsCount)[y][x].fetch_add(1);
-
-			if(tilePos < m_is->m_maxPointLightsPerTile)
-			{
-				writeIndexToTileBuffer(0, pos, tilePos, t);
-			}
-		}
-	}
-
-	// Bin spot light
-	void binLight(SpotLight& light, U pos)
-	{
-		// Do the tests
-		Tiler::Bitset bitset;
-		m_tiler->test(light.getSpatialCollisionShape(), true, &bitset);
-
-		// Bin to the correct tiles
-		PtrSize tilesCount = 
-			m_is->m_r->getTilesCount().x() * m_is->m_r->getTilesCount().y();
-		for(U t = 0; t < tilesCount; t++)
-		{
-			// If not in tile bye
-			if(!bitset.test(t))
-			{
-				continue;
-			}
-
-			U x = t % m_is->m_r->getTilesCount().x();
-			U y = t / m_is->m_r->getTilesCount().x();
-
-			if(light.getShadowEnabled())
-			{
-				U tilePos = (*m_tileSpotTexLightsCount)[y][x].fetch_add(1);
-
-				if(tilePos < m_is->m_maxSpotTexLightsPerTile)
-				{
-					writeIndexToTileBuffer(2, pos, tilePos, t);
-				}
-			}
-			else
-			{
-				U tilePos = (*m_tileSpotLightsCount)[y][x].fetch_add(1);
-
-				if(tilePos < m_is->m_maxSpotLightsPerTile)
-				{
-					writeIndexToTileBuffer(1, pos, tilePos, t);
-				}
-			}
-		}
-	}
-
-	/// The "Tile" structure varies so this custom function writes to it
-	void writeIndexToTileBuffer(
-		U lightType, U lightIndex, U indexInTileArray, U tileIndex)
-	{
-		PtrSize offset = 
-			tileIndex * m_is->calcTileSize() 
-			+ sizeof(UVec4); // Tile header
-
-		// Move to the correct light section
-		switch(lightType)
-		{
-		case 0:
-			break;
-		case 1:
-			offset += m_is->m_maxPointLightsPerTile * sizeof(U32);
-			break;
-		case 2:
-			offset += 
-				(m_is->m_maxSpotLightsPerTile + m_is->m_maxPointLightsPerTile)
-				* sizeof(U32);
-			break;
-		default:
-			ANKI_ASSERT(0);
-		}
-
-		// Move to the array offset
-		offset += sizeof(U32) * indexInTileArray;
-
-		// Write the lightIndex
-		*((U32*)(m_tileBuffer + offset)) = lightIndex;
-	}
 };
 
 //==============================================================================
@@ -405,15 +304,29 @@ void Is::initInternal(const ConfigSet& initializer)
 
 	if(m_maxPointLightsPerTile < 1 
 		|| m_maxSpotLightsPerTile < 1 
-		|| m_maxSpotTexLightsPerTile < 1
-		|| m_maxPointLightsPerTile % 4 != 0 
-		|| m_maxSpotLightsPerTile % 4 != 0
-		|| m_maxSpotTexLightsPerTile % 4 != 0)
+		|| m_maxSpotTexLightsPerTile < 1)
 	{
 		throw ANKI_EXCEPTION("Incorrect number of max lights per tile");
 	}
 
-	m_tileSize = calcTileSize();
+	//
+	// Init the clusterer. X and Y follow the tiles
+	//
+	U32 clusterSlicesCount = initializer.get("is.clusterSlicesCount");
+	if(clusterSlicesCount < 1 || clusterSlicesCount > 0xFF)
+	{
+		throw ANKI_EXCEPTION("Incorrect number of cluster slices");
+	}
+
+	m_clusterer.init(getAllocator(), 
+		m_r->getTilesCount().x(), m_r->getTilesCount().y(), 
+		clusterSlicesCount, 
+		{{m_maxPointLightsPerTile, m_maxSpotLightsPerTile, 
+		m_maxSpotTexLightsPerTile}});
+
+	m_clustererLights = Vector<ClustererLight>(getAllocator());
+	m_clustererLights.resize(
+		m_maxPointLights + m_maxSpotLights + m_maxSpotTexLights);
 
 	//
 	// Init the passes
@@ -431,17 +344,14 @@ void Is::initInternal(const ConfigSet& initializer)
 		<< (m_r->getTilesCount().x() * m_r->getTilesCount().y())
 		<< "\n#define RENDERER_WIDTH " << m_r->getWidth()
 		<< "\n#define RENDERER_HEIGHT " << m_r->getHeight()
-		<< "\n#define MAX_POINT_LIGHTS_PER_TILE " 
-		<< (U32)m_maxPointLightsPerTile
-		<< "\n#define MAX_SPOT_LIGHTS_PER_TILE " 
-		<< (U32)m_maxSpotLightsPerTile
-		<< "\n#define MAX_SPOT_TEX_LIGHTS_PER_TILE " 
-		<< (U32)m_maxSpotTexLightsPerTile
+		<< "\n#define CLUSTERS_Z_COUNT " << clusterSlicesCount
 		<< "\n#define MAX_POINT_LIGHTS " << (U32)m_maxPointLights
 		<< "\n#define MAX_SPOT_LIGHTS " << (U32)m_maxSpotLights 
 		<< "\n#define MAX_SPOT_TEX_LIGHTS " << (U32)m_maxSpotTexLights
 		<< "\n#define GROUND_LIGHT " << (U32)m_groundLightEnabled
-		<< "\n#define TILES_BLOCK_BINDING " << TILES_BLOCK_BINDING
+		<< "\n#define CLUSTERS_BLOCK_BINDING " << CLUSTERS_BLOCK_BINDING
+		<< "\n#define LIGHT_INDICES_BLOCK_BINDING " 
+		<< LIGHT_INDICES_BLOCK_BINDING
 		<< "\n";
 
 	if(m_sm.getPoissonEnabled())
@@ -486,21 +396,6 @@ void Is::initInternal(const ConfigSet& initializer)
 	m_quadPositionsVertBuff = GlBufferHandle(jobs, GL_ARRAY_BUFFER,
 		tempBuff, 0);
 
-	//
-	// Create UBOs
-	//
-	const GLbitfield bufferBits = GL_DYNAMIC_STORAGE_BIT;
-
-	m_commonBuff = GlBufferHandle(jobs, GL_SHADER_STORAGE_BUFFER, 
-		sizeof(shader::CommonUniforms), bufferBits);
-
-	m_lightsBuff = GlBufferHandle(jobs, GL_SHADER_STORAGE_BUFFER, 
-		calcLightsBufferSize(), bufferBits);
-
-	m_tilesBuff = GlBufferHandle(jobs, GL_SHADER_STORAGE_BUFFER,
-		m_r->getTilesCount().x() * m_r->getTilesCount().y() * m_tileSize,
-		bufferBits);
-
 	// Last thing to do
 	jobs.flush();
 }
@@ -509,8 +404,8 @@ void Is::initInternal(const ConfigSet& initializer)
 void Is::lightPass(GlCommandBufferHandle& jobs)
 {
 	Threadpool& threadPool = m_r->_getThreadpool();
-	m_cam = &m_r->getSceneGraph().getActiveCamera();
-	VisibilityTestResults& vi = m_cam->getVisibilityTestResults();
+	const RenderSnapshot& snapshot = m_r->getRenderSnapshot();
+	m_cam = &snapshot.m_camera;
 
 	//
 	// Quickly get the lights
@@ -518,23 +413,21 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 	U visiblePointLightsCount = 0;
 	U visibleSpotLightsCount = 0;
 	U visibleSpotTexLightsCount = 0;
-	Array<Light*, Sm::MAX_SHADOW_CASTERS> shadowCasters;
+	Array<LightSnapshot*, Sm::MAX_SHADOW_CASTERS> shadowCasters;
 
-	for(auto& it : vi.m_lights)
+	for(U i = 0; i < snapshot.m_lightsCount; i++)
 	{
-		Light* light = staticCastPtr<Light*>(it.m_node);
-		switch(light->getLightType())
+		LightSnapshot& light = snapshot.m_lights[i];
+		switch(light.m_type)
 		{
 		case Light::LT_POINT:
 			++visiblePointLightsCount;
 			break;
 		case Light::LT_SPOT:
 			{
-				SpotLight* slight = staticCastPtr<SpotLight*>(light);
-				
-				if(slight->getShadowEnabled())
+				if(light.m_frustum)
 				{
-					shadowCasters[visibleSpotTexLightsCount++] = slight;
+					shadowCasters[visibleSpotTexLightsCount++] = &light;
 				}
 				else
 				{
@@ -564,10 +457,10 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 	m_sm.run(&shadowCasters[0], visibleSpotTexLightsCount, jobs);
 
 	//
-	// Write the lights and tiles UBOs
+	// Write the lights
 	//
 	GlDevice& gl = GlDeviceSingleton::get();
-	U32 blockAlignment = gl.getBufferOffsetAlignment(m_lightsBuff.getTarget());
+	U32 blockAlignment = gl.getBufferOffsetAlignment(GL_SHADER_STORAGE_BUFFER);
 
 	// Get the offsets and sizes of each uniform block
 	PtrSize pointLightsOffset = 0;
@@ -588,36 +481,23 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 	// Fire the super jobs
 	Array<WriteLightsJob, Threadpool::MAX_THREADS> tjobs;
 
-	GlClientBufferHandle lightsClientBuff;
+	// Write directly to transient memory. The offsets of the blocks are
+	// relative to lightsOffset
+	GlBufferHandle lightsBuff;
+	PtrSize lightsOffset = 0;
+	U8* lightsMem = nullptr;
 	if(totalLightsCount > 0)
 	{
-		lightsClientBuff = GlClientBufferHandle(
-			jobs, spotTexLightsOffset + spotTexLightsSize, nullptr);
+		lightsMem = (U8*)gl.allocateTransientMemory(
+			GlTransientMemoryType::STORAGE, 
+			spotTexLightsOffset + spotTexLightsSize,
+			lightsBuff, lightsOffset);
 	}
 
-	GlClientBufferHandle tilesClientBuff(jobs, m_tilesBuff.getSize(), nullptr);
-
 	std::atomic<U32> pointLightsAtomicCount(0);
 	std::atomic<U32> spotLightsAtomicCount(0);
 	std::atomic<U32> spotTexLightsAtomicCount(0);
 
-	Array2d<std::atomic<U32>, 
-		ANKI_RENDERER_MAX_TILES_Y, 
-		ANKI_RENDERER_MAX_TILES_X> 
-		tilePointLightsCount,
-		tileSpotLightsCount,
-		tileSpotTexLightsCount;
-
-	for(U y = 0; y < m_r->getTilesCount().y(); y++)
-	{
-		for(U x = 0; x < m_r->getTilesCount().x(); x++)
-		{
-			tilePointLightsCount[y][x].store(0);
-			tileSpotLightsCount[y][x].store(0);
-			tileSpotTexLightsCount[y][x].store(0);
-		}
-	}
-
 	for(U i = 0; i < threadPool.getThreadsCount(); i++)
 	{
 		WriteLightsJob& job = tjobs[i];
@@ -627,30 +507,22 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 			if(totalLightsCount > 0)
 			{
 				job.m_pointLights = (shader::PointLight*)(
-					(U8*)lightsClientBuff.getBaseAddress() 
-					+ pointLightsOffset);
+					lightsMem + pointLightsOffset);
 				job.m_spotLights = (shader::SpotLight*)(
-					(U8*)lightsClientBuff.getBaseAddress() 
-					+ spotLightsOffset);
+					lightsMem + spotLightsOffset);
 				job.m_spotTexLights = (shader::SpotTexLight*)(
-					(U8*)lightsClientBuff.getBaseAddress() 
-					+ spotTexLightsOffset);
+					lightsMem + spotTexLightsOffset);
 			}
 
-			job.m_tileBuffer = (U8*)tilesClientBuff.getBaseAddress();
+			job.m_clustererLights = &m_clustererLights[0];
 
-			job.m_lightsBegin = vi.m_lights.begin();
-			job.m_lightsEnd = vi.m_lights.end();
+			job.m_lights = snapshot.m_lights;
+			job.m_lightsCount = snapshot.m_lightsCount;
 
 			job.m_pointLightsCount = &pointLightsAtomicCount;
 			job.m_spotLightsCount = &spotLightsAtomicCount;
 			job.m_spotTexLightsCount = &spotTexLightsAtomicCount;
 
-			job.m_tilePointLightsCount = &tilePointLightsCount;
-			job.m_tileSpotLightsCount = &tileSpotLightsCount;
-			job.m_tileSpotTexLightsCount = &tileSpotTexLightsCount;
-
-			job.m_tiler = &m_r->getTiler();
 			job.m_is = this;
 		}
 		else
@@ -669,68 +541,128 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 	// Sync
 	threadPool.waitForAllThreadsToFinish();
 
-	// Write the light count for each tile
-	for(U y = 0; y < m_r->getTilesCount().y(); y++)
+	//
+	// Bin the lights to the clusters
+	//
+	// Make the clusterer input contiguous. It's sorted by type already
+	ClustererLight* clights = &m_clustererLights[0];
+	std::copy(clights + m_maxPointLights, 
+		clights + m_maxPointLights + visibleSpotLightsCount,
+		clights + visiblePointLightsCount);
+
+	std::copy(clights + m_maxPointLights + m_maxSpotLights, 
+		clights + m_maxPointLights + m_maxSpotLights 
+		+ visibleSpotTexLightsCount,
+		clights + visiblePointLightsCount + visibleSpotLightsCount);
+
+	const Vec4& projParams = m_r->getProjectionParameters();
+	m_clusterer.prepare(m_cam->m_near, m_cam->m_far, 
+		-projParams.x(), -projParams.y());
+	// Skip the clusters in front and behind the geometry of the tiles
+	m_clusterer.setTileDepthBounds(m_r->getTiler().getDepthBounds());
+	m_clusterer.bin(clights, totalLightsCount, threadPool);
+
+	GlBufferHandle clustersBuff;
+	PtrSize clustersOffset;
+	PtrSize clustersSize = 
+		m_clusterer.getClustersCount() * sizeof(ClustererCluster);
+	void* clustersMem = gl.allocateTransientMemory(
+		GlTransientMemoryType::STORAGE, clustersSize, clustersBuff, 
+		clustersOffset);
+	memcpy(clustersMem, m_clusterer.getClusters(), clustersSize);
+
+	GlBufferHandle indicesBuff;
+	PtrSize indicesOffset;
+	PtrSize indicesSize = 
+		std::max<U32>(m_clusterer.getLightIndicesCount(), 1) * sizeof(U32);
+	void* indicesMem = gl.allocateTransientMemory(
+		GlTransientMemoryType::STORAGE, indicesSize, indicesBuff, 
+		indicesOffset);
+	if(m_clusterer.getLightIndicesCount() > 0)
 	{
-		for(U x = 0; x < m_r->getTilesCount().x(); x++)
-		{
-			UVec4* vec;
-
-			vec = (UVec4*)(
-				(U8*)tilesClientBuff.getBaseAddress() 
-				+ (y * m_r->getTilesCount().x() + x) * m_tileSize);
-
-			vec->x() = tilePointLightsCount[y][x].load();
-			clamp(vec->x(), m_maxPointLightsPerTile);
-
-			vec->y() = 0;
-
-			vec->z() = tileSpotLightsCount[y][x].load();
-			clamp(vec->z(), m_maxSpotLightsPerTile);
-
-			vec->w() = tileSpotTexLightsCount[y][x].load();
-			clamp(vec->w(), m_maxSpotTexLightsPerTile);
-		}
+		memcpy(indicesMem, m_clusterer.getLightIndices(), 
+			m_clusterer.getLightIndicesCount() * sizeof(U32));
 	}
 
-	// Write BOs
-	if(totalLightsCount > 0)
-	{
-		m_lightsBuff.write(jobs,
-			lightsClientBuff, 0, 0, spotTexLightsOffset + spotTexLightsSize);
-	}
-	m_tilesBuff.write(jobs, tilesClientBuff, 0, 0, tilesClientBuff.getSize());
+	GlBufferHandle commonBuff;
+	PtrSize commonOffset;
+	updateCommonBlock(commonBuff, commonOffset);
 
 	//
 	// Setup uniforms
 	//
 
-	// shader prog
-
-	updateCommonBlock(jobs);
-
-	m_commonBuff.bindShaderBuffer(jobs, COMMON_UNIFORMS_BLOCK_BINDING);
-
 	if(pointLightsSize > 0)
 	{
-		m_lightsBuff.bindShaderBuffer(jobs, 
-			pointLightsOffset, pointLightsSize, POINT_LIGHTS_BLOCK_BINDING);
+		lightsBuff.bindShaderBuffer(jobs, lightsOffset + pointLightsOffset, 
+			pointLightsSize, POINT_LIGHTS_BLOCK_BINDING);
 	}
 
 	if(spotLightsSize > 0)
 	{
-		m_lightsBuff.bindShaderBuffer(jobs, 
-			spotLightsOffset, spotLightsSize, SPOT_LIGHTS_BLOCK_BINDING);
+		lightsBuff.bindShaderBuffer(jobs, lightsOffset + spotLightsOffset, 
+			spotLightsSize, SPOT_LIGHTS_BLOCK_BINDING);
 	}
 
 	if(spotTexLightsSize > 0)
 	{
-		m_lightsBuff.bindShaderBuffer(jobs,
-			spotTexLightsOffset, spotTexLightsSize, 
-			SPOT_TEX_LIGHTS_BLOCK_BINDING);
+		lightsBuff.bindShaderBuffer(jobs, lightsOffset + spotTexLightsOffset, 
+			spotTexLightsSize, SPOT_TEX_LIGHTS_BLOCK_BINDING);
+	}
+
+	//
+	// Draw. Only the transient buffers change every frame
+	//
+
+	if(!m_bundle.isCreated())
+	{
+		recordBundle(clustersBuff);
 	}
 
-	m_tilesBuff.bindShaderBuffer(jobs, TILES_BLOCK_BINDING); 
+	// The bundle doesn't reference the buffers of the parameters
+	jobs._addReference(commonBuff);
+	jobs._addReference(clustersBuff);
+	jobs._addReference(indicesBuff);
+
+	LightPassParameters params;
+	params.m_commonBuff = &commonBuff._get();
+	params.m_clustersBuff = &clustersBuff._get();
+	params.m_indicesBuff = &indicesBuff._get();
+	params.m_commonRange = 
+		{{I32(commonOffset), I32(sizeof(shader::CommonUniforms))}};
+	params.m_clustersRange = {{I32(clustersOffset), I32(clustersSize)}};
+	params.m_indicesRange = {{I32(indicesOffset), I32(indicesSize)}};
+
+	jobs.pushBackOtherCommandBuffer(m_bundle, &params, sizeof(params));
+}
+
+//==============================================================================
+void Is::recordBundle(GlBufferHandle& transientBuff)
+{
+	m_bundle = GlCommandBufferHandle(&getGlDevice());
+	GlCommandBufferHandle& jobs = m_bundle;
+
+	// The buffers and the ranges are parameters. Record them with any value
+	transientBuff.bindShaderBuffer(jobs, 0, 1, COMMON_UNIFORMS_BLOCK_BINDING);
+	jobs.addParameter(offsetof(LightPassParameters, m_commonBuff),
+		offsetof(GlBindShaderBufferCommandData, m_buff), sizeof(GlBuffer*));
+	jobs.addParameter(offsetof(LightPassParameters, m_commonRange),
+		offsetof(GlBindShaderBufferCommandData, m_offset), 
+		sizeof(Array<I32, 2>));
+
+	transientBuff.bindShaderBuffer(jobs, 0, 1, CLUSTERS_BLOCK_BINDING);
+	jobs.addParameter(offsetof(LightPassParameters, m_clustersBuff),
+		offsetof(GlBindShaderBufferCommandData, m_buff), sizeof(GlBuffer*));
+	jobs.addParameter(offsetof(LightPassParameters, m_clustersRange),
+		offsetof(GlBindShaderBufferCommandData, m_offset), 
+		sizeof(Array<I32, 2>));
+
+	transientBuff.bindShaderBuffer(jobs, 0, 1, LIGHT_INDICES_BLOCK_BINDING);
+	jobs.addParameter(offsetof(LightPassParameters, m_indicesBuff),
+		offsetof(GlBindShaderBufferCommandData, m_buff), sizeof(GlBuffer*));
+	jobs.addParameter(offsetof(LightPassParameters, m_indicesRange),
+		offsetof(GlBindShaderBufferCommandData, m_offset), 
+		sizeof(Array<I32, 2>));
 
 	// The binding points should much the shader
 	jobs.bindTextures(0, {
@@ -739,10 +671,6 @@ void Is::lightPass(GlCommandBufferHandle& jobs)
 		m_r->getMs()._getDepthRt(),
 		m_sm.m_sm2DArrayTex});
 
-	//
-	// Draw
-	//
-
 	m_lightPpline.bind(jobs);
 
 	m_quadPositionsVertBuff.bindVertexBuffer(jobs, 
@@ -781,27 +709,28 @@ void Is::run(GlCommandBufferHandle& jobs)
 }
 
 //==============================================================================
-void Is::updateCommonBlock(GlCommandBufferHandle& jobs)
+void Is::updateCommonBlock(GlBufferHandle& buff, PtrSize& offset)
 {
-	SceneGraph& scene = m_r->getSceneGraph();
+	const RenderSnapshot& snapshot = m_r->getRenderSnapshot();
 
-	GlClientBufferHandle cbuff(jobs, sizeof(shader::CommonUniforms), nullptr);
-	shader::CommonUniforms& blk = 
-		*(shader::CommonUniforms*)cbuff.getBaseAddress();
+	shader::CommonUniforms& blk = *(shader::CommonUniforms*)
+		m_r->_getGlDevice().allocateTransientMemory(
+		GlTransientMemoryType::STORAGE, sizeof(shader::CommonUniforms),
+		buff, offset);
 
 	// Start writing
 	blk.m_projectionParams = m_r->getProjectionParameters();
 
-	blk.m_sceneAmbientColor = scene.getAmbientColor();
+	blk.m_sceneAmbientColor = snapshot.m_ambientColor;
 
 	Vec3 groundLightDir;
 	if(m_groundLightEnabled)
 	{
 		blk.m_groundLightDir = 
-			Vec4(-m_cam->getViewMatrix().getColumn(1).xyz(), 1.0);
+			Vec4(-m_cam->m_viewMat.getColumn(1).xyz(), 1.0);
 	}
 
-	m_commonBuff.write(jobs, cbuff, 0, 0, cbuff.getSize());
+	blk.m_clusterParams = Vec4(m_clusterer.getSliceParams(), 0.0, 0.0);
 }
 
 //==============================================================================
@@ -826,14 +755,4 @@ PtrSize Is::calcLightsBufferSize() const
 	return size;
 }
 
-//==============================================================================
-PtrSize Is::calcTileSize() const
-{
-	return 
-		sizeof(U32) * 4 
-		+ m_maxPointLightsPerTile * sizeof(U32)
-		+ m_maxSpotLightsPerTile * sizeof(U32)
-		+ m_maxSpotTexLightsPerTile * sizeof(U32);
-}
-
 } // end namespace anki
@@ -6,10 +6,9 @@
 #include "anki/renderer/Lf.h"
 #include "anki/renderer/Renderer.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/scene/MoveComponent.h"
-#include "anki/scene/Camera.h"
-#include "anki/scene/Light.h"
+#include "anki/scene/RenderSnapshot.h"
 #include <sstream>
+#include <cstddef>
 
 namespace anki {
 
@@ -30,17 +29,35 @@ public:
 	U32 m_padding[2];
 };
 
+//==============================================================================
+/// The parameters of the bundle of the first pass
+class PseudoPassParameters
+{
+public:
+	/// The streaming replaces the texture of the resource
+	const GlTexture* m_lensDirtTex;
+};
+
+//==============================================================================
+/// The parameters of the bundle that draws a group of flares
+class FlareGroupParameters
+{
+public:
+	const GlTexture* m_tex;
+	Array<I32, 2> m_flaresRange; ///< Offset and size in the flares buffer
+	U32 m_flaresCount;
+};
+
 //==============================================================================
 class LightSortFunctor
 {
 public:
-	Bool operator()(const Light* lightA, const Light* lightB)
+	Bool operator()(const LightSnapshot* lightA, const LightSnapshot* lightB)
 	{
 		ANKI_ASSERT(lightA && lightB);
-		ANKI_ASSERT(lightA->hasLensFlare() && lightB->hasLensFlare());
+		ANKI_ASSERT(lightA->m_lensFlareTex && lightB->m_lensFlareTex);
 
-		return lightA->getLensFlareTexture() <
-			lightB->getLensFlareTexture();
+		return *lightA->m_lensFlareTex < *lightB->m_lensFlareTex;
 	}
 };
 
@@ -150,42 +167,41 @@ void Lf::run(GlCommandBufferHandle& jobs)
 	// First pass
 	//
 
-	// Set the common state
-	m_fb.bind(jobs, true);
-	jobs.setViewport(0, 0, m_r->getPps().getHdr()._getRt().getWidth(), 
-		m_r->getPps().getHdr()._getRt().getHeight());
-
-	m_pseudoPpline.bind(jobs);
+	if(!m_pseudoBundle.isCreated())
+	{
+		recordBundles();
+	}
 
-	jobs.bindTextures(0, {
-		m_r->getPps().getHdr()._getRt(), 
-		m_lensDirtTex->getGlTexture()});
+	// The bundle doesn't reference the texture of the parameter
+	const GlTextureHandle& lensDirtTex = m_lensDirtTex->getGlTexture();
+	jobs._addReference(lensDirtTex);
 
-	m_r->drawQuad(jobs);
+	PseudoPassParameters pseudoParams;
+	pseudoParams.m_lensDirtTex = &lensDirtTex._get();
+	jobs.pushBackOtherCommandBuffer(
+		m_pseudoBundle, &pseudoParams, sizeof(pseudoParams));
 
 	//
 	// Rest of the passes
 	//
 
 	// Retrieve some things
-	SceneGraph& scene = m_r->getSceneGraph();
-	Camera& cam = scene.getActiveCamera();
-	VisibilityTestResults& vi = cam.getVisibilityTestResults();
+	const RenderSnapshot& snapshot = m_r->getRenderSnapshot();
+	const FrustumSnapshot& cam = snapshot.m_camera;
+	SceneFrameAllocator<U8> frameAlloc = snapshot.m_frameAlloc;
 
 	// Iterate the visible light and get those that have lens flare
-	SceneFrameVector<Light*> lights(
-		m_maxLightsWithFlares, nullptr, scene.getFrameAllocator());
+	SceneFrameVector<const LightSnapshot*> lights(
+		m_maxLightsWithFlares, nullptr, frameAlloc);
 
 	U lightsCount = 0;
-	for(auto& it : vi.m_lights)
+	for(U i = 0; i < snapshot.m_lightsCount; i++)
 	{
-		SceneNode& sn = *it.m_node;
-		ANKI_ASSERT(sn.tryGetComponent<LightComponent>() != nullptr);
-		Light* light = staticCastPtr<Light*>(&sn);
+		const LightSnapshot& light = snapshot.m_lights[i];
 
-		if(light->hasLensFlare())
+		if(light.m_lensFlareTex)
 		{
-			lights[lightsCount++] = light;
+			lights[lightsCount++] = &light;
 
 			if(lightsCount == m_maxLightsWithFlares)
 			{
@@ -209,9 +225,9 @@ void Lf::run(GlCommandBufferHandle& jobs)
 		U flaresCount = 0;
 
 		// Contains the number of flares per flare texture
-		SceneFrameVector<U> groups(lightsCount, 0U, scene.getFrameAllocator());
+		SceneFrameVector<U> groups(lightsCount, 0U, frameAlloc);
 		SceneFrameVector<const GlTextureHandle*> texes(
-			lightsCount, nullptr, scene.getFrameAllocator());
+			lightsCount, nullptr, frameAlloc);
 		U groupsCount = 0;
 
 		GlTextureHandle lastTex;
@@ -219,13 +235,13 @@ void Lf::run(GlCommandBufferHandle& jobs)
 		// Iterate all lights and update the flares as well as the groups
 		while(lightsCount-- != 0)
 		{
-			Light& light = *lights[lightsCount];
-			const GlTextureHandle& tex = light.getLensFlareTexture();
+			const LightSnapshot& light = *lights[lightsCount];
+			const GlTextureHandle& tex = *light.m_lensFlareTex;
 			const U depth = tex.getDepth();
 
 			// Transform
-			Vec3 posWorld = light.getWorldTransform().getOrigin().xyz();
-			Vec4 posClip = cam.getViewProjectionMatrix() * Vec4(posWorld, 1.0);
+			Vec3 posWorld = light.m_worldTransform.getOrigin().xyz();
+			Vec4 posClip = cam.m_viewProjectionMat * Vec4(posWorld, 1.0);
 
 			if(posClip.x() > posClip.w() || posClip.x() < -posClip.w()
 				|| posClip.y() > posClip.w() || posClip.y() < -posClip.w())
@@ -253,16 +269,15 @@ void Lf::run(GlCommandBufferHandle& jobs)
 			F32 stretchFactor = 1.0 - posNdc.getLength();
 			stretchFactor *= stretchFactor;
 
-			Vec2 stretch = 
-				light.getLensFlaresStretchMultiplier() * stretchFactor;
+			Vec2 stretch = light.m_lensFlaresStretchMultiplier * stretchFactor;
 
 			flares[flaresCount].m_pos = posNdc;
 			flares[flaresCount].m_scale =
-				light.getLensFlaresSize() * Vec2(1.0, m_r->getAspectRatio())
+				light.m_lensFlaresSize * Vec2(1.0, m_r->getAspectRatio())
 				* stretch;
 			flares[flaresCount].m_depth = 0.0;
 			flares[flaresCount].m_alpha = 
-				light.getLensFlaresAlpha() * stretchFactor;
+				light.m_lensFlaresAlpha * stretchFactor;
 			++flaresCount;
 			++groups[groupsCount - 1];
 
@@ -277,12 +292,12 @@ void Lf::run(GlCommandBufferHandle& jobs)
 				flares[flaresCount].m_pos = posNdc + dir * flen;
 
 				flares[flaresCount].m_scale =
-					light.getLensFlaresSize() * Vec2(1.0, m_r->getAspectRatio())
+					light.m_lensFlaresSize * Vec2(1.0, m_r->getAspectRatio())
 					* ((len - flen) * 2.0);
 
 				flares[flaresCount].m_depth = d;
 
-				flares[flaresCount].m_alpha = light.getLensFlaresAlpha();
+				flares[flaresCount].m_alpha = light.m_lensFlaresAlpha;
 
 				// Advance
 				++flaresCount;
@@ -306,14 +321,20 @@ void Lf::run(GlCommandBufferHandle& jobs)
 		PtrSize offset = 0;
 		for(U i = 0; i < groupsCount; i++)
 		{
-			GlTextureHandle tex = *texes[i];
+			const GlTextureHandle& tex = *texes[i];
 			U instances = groups[i];
 			PtrSize buffSize = sizeof(Flare) * instances;
 
-			tex.bind(jobs, 0);
-			m_flareDataBuff.bindShaderBuffer(jobs, offset, buffSize, 0);
+			// The bundle doesn't reference the texture of the parameter
+			jobs._addReference(tex);
+
+			FlareGroupParameters params;
+			params.m_tex = &tex._get();
+			params.m_flaresRange = {{I32(offset), I32(buffSize)}};
+			params.m_flaresCount = instances;
 
-			m_r->drawQuadInstanced(jobs, instances);
+			jobs.pushBackOtherCommandBuffer(
+				m_flareGroupBundle, &params, sizeof(params));
 
 			offset += buffSize;
 		}
@@ -335,4 +356,50 @@ void Lf::run(GlCommandBufferHandle& jobs)
 	jobs.enableBlend(false);
 }
 
+//==============================================================================
+void Lf::recordBundles()
+{
+	GlDevice& gl = getGlDevice();
+
+	// The first pass
+	m_pseudoBundle = GlCommandBufferHandle(&gl);
+	GlCommandBufferHandle& jobs = m_pseudoBundle;
+
+	m_fb.bind(jobs, true);
+	jobs.setViewport(0, 0, m_r->getPps().getHdr()._getRt().getWidth(), 
+		m_r->getPps().getHdr()._getRt().getHeight());
+
+	m_pseudoPpline.bind(jobs);
+
+	// The lens dirt is a parameter. Record it with any texture so the bundle
+	// doesn't keep the one that the streaming will replace
+	GlTextureHandle& hdrRt = m_r->getPps().getHdr()._getRt();
+	hdrRt.bind(jobs, 0);
+	hdrRt.bind(jobs, 1);
+	jobs.addParameter(offsetof(PseudoPassParameters, m_lensDirtTex),
+		offsetof(GlBindTextureCommandData, m_tex), sizeof(GlTexture*));
+
+	m_r->drawQuad(jobs);
+
+	// A group of flares. The texture, the part of the buffer and the count 
+	// are parameters. Record them with any value
+	m_flareGroupBundle = GlCommandBufferHandle(&gl);
+	GlCommandBufferHandle& group = m_flareGroupBundle;
+
+	hdrRt.bind(group, 0);
+	group.addParameter(offsetof(FlareGroupParameters, m_tex),
+		offsetof(GlBindTextureCommandData, m_tex), sizeof(GlTexture*));
+
+	m_flareDataBuff.bindShaderBuffer(group, 0, sizeof(Flare), 0);
+	group.addParameter(offsetof(FlareGroupParameters, m_flaresRange),
+		offsetof(GlBindShaderBufferCommandData, m_offset), 
+		sizeof(Array<I32, 2>));
+
+	m_r->drawQuadInstanced(group, 1);
+	group.addParameter(offsetof(FlareGroupParameters, m_flaresCount),
+		offsetof(GlDrawArraysCommandData, m_info) 
+		+ offsetof(GlDrawArraysIndirectInfo, m_instanceCount), 
+		sizeof(U32));
+}
+
 } // end namespace anki
@@ -16,7 +16,7 @@ namespace anki {
 
 //==============================================================================
 MainRenderer::MainRenderer(App* app, const ConfigSet& initializer)
-:	Renderer(&app->getThreadpool())
+:	Renderer(&app->getRenderThreadpool())
 {
 	init(initializer);
 }
@@ -39,6 +39,13 @@ void MainRenderer::init(const ConfigSet& initializer_)
 
 	initGl();
 
+	// The command buffers of the frames don't hold references. The frames 
+	// keep their objects alive
+	for(GlCommandBufferInitHints& hints : m_jobsInitHints)
+	{
+		hints.setFrameScoped(true);
+	}
+
 	Renderer::init(initializer);
 	m_deformer.reset(new Deformer);
 
@@ -51,7 +58,7 @@ void MainRenderer::init(const ConfigSet& initializer_)
 }
 
 //==============================================================================
-void MainRenderer::render(SceneGraph& scene)
+void MainRenderer::render(const RenderSnapshot& snapshot)
 {
 	ANKI_COUNTER_START_TIMER(MAIN_RENDERER_TIME);
 
@@ -64,7 +71,7 @@ void MainRenderer::render(SceneGraph& scene)
 		jobs[i] = GlCommandBufferHandle(&gl, m_jobsInitHints[i]);
 	}
 
-	Renderer::render(scene, jobs);
+	Renderer::render(snapshot, jobs);
 
 	Bool notDrawnToDefault = 
 		getRenderingQuality() != 1.0 || getDbg().getEnabled();
@@ -102,6 +109,9 @@ void MainRenderer::render(SceneGraph& scene)
 		m_jobsInitHints[i] = jobs[i].computeInitHints();	
 	}
 
+	// Fence the transient memory that the frame used
+	gl.endFrame(lastJobs);
+
 	// Flush the last job chain
 	ANKI_ASSERT(lastJobs.getReferenceCount() == 1);
 	lastJobs.flush();
@@ -8,7 +8,7 @@
 #include "anki/renderer/Renderer.h"
 
 #include "anki/core/Logger.h"
-#include "anki/scene/Camera.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/scene/SceneGraph.h"
 
 namespace anki {
@@ -121,14 +121,11 @@ void Ms::run(GlCommandBufferHandle& jobs)
 	m_r->getSceneDrawer().prepareDraw(RenderingStage::MATERIAL, Pass::COLOR,
 		jobs);
 
-	VisibilityTestResults& vi =
-		m_r->getSceneGraph().getActiveCamera().getVisibilityTestResults();
+	const FrustumSnapshot& cam = m_r->getRenderSnapshot().m_camera;
+	VisibilityTestResults& vi = *cam.m_visible;
 
-	Camera& cam = m_r->getSceneGraph().getActiveCamera();
-	for(auto& it : vi.m_renderables)
-	{
-		m_r->getSceneDrawer().render(cam, it);
-	}
+	m_r->getSceneDrawer().render(cam, vi.m_renderables.data(), 
+		vi.m_renderables.data() + vi.m_renderables.size());
 
 	m_r->getSceneDrawer().finishDraw();
 
@@ -115,6 +115,35 @@ void Pps::run(GlCommandBufferHandle& jobs)
 		&& !m_r->getIsOffscreen()
 		&& m_r->getRenderingQuality() == 1.0;
 
+	U8 key = (1 << 4) 
+		| (drawToDefaultFbo << 3)
+		| (m_ssao.getEnabled() << 2)
+		| (m_lf.getEnabled() << 1)
+		| m_hdr.getEnabled();
+
+	// The window may resize
+	U32 width = (drawToDefaultFbo) ? m_r->getWindowWidth() : m_r->getWidth();
+	U32 height = 
+		(drawToDefaultFbo) ? m_r->getWindowHeight() : m_r->getHeight();
+
+	if(key != m_bundleKey || width != m_bundleWidth 
+		|| height != m_bundleHeight)
+	{
+		recordBundle(drawToDefaultFbo);
+		m_bundleKey = key;
+		m_bundleWidth = width;
+		m_bundleHeight = height;
+	}
+
+	jobs.pushBackOtherCommandBuffer(m_bundle);
+}
+
+//==============================================================================
+void Pps::recordBundle(Bool drawToDefaultFbo)
+{
+	m_bundle = GlCommandBufferHandle(&getGlDevice());
+	GlCommandBufferHandle& jobs = m_bundle;
+
 	if(drawToDefaultFbo)
 	{
 		m_r->getDefaultFramebuffer().bind(jobs, true);
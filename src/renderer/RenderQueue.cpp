@@ -0,0 +1,155 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/renderer/RenderQueue.h"
+#include "anki/util/Array.h"
+#include <cstring>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// Fold a 64bit ID to a number of bits
+static U64 foldId(U64 id, U bits)
+{
+	id ^= id >> 32;
+	id ^= id >> 16;
+	return id & ((U64(1) << bits) - 1);
+}
+
+//==============================================================================
+// RenderQueue                                                                 =
+//==============================================================================
+
+//==============================================================================
+RenderQueue::RenderQueue(const SceneFrameAllocator<U8>& alloc, U32 maxElements)
+:	m_alloc(alloc),
+	m_maxCount(maxElements)
+{
+	if(m_maxCount > 0)
+	{
+		m_elements = m_alloc.newArray<RenderQueueElement>(m_maxCount);
+	}
+}
+
+//==============================================================================
+RenderQueue::~RenderQueue()
+{
+	if(m_elements)
+	{
+		m_alloc.deleteArray(m_elements, m_maxCount);
+	}
+}
+
+//==============================================================================
+U64 RenderQueue::computeKey(const RenderingKey& key, U64 programId, 
+	U64 materialId, U64 meshId, F32 depth, Bool blending)
+{
+	ANKI_ASSERT((U)key.m_pass < 4);
+	ANKI_ASSERT(key.m_lod < 8);
+	U64 passBits = U64(key.m_pass) << 62;
+	U64 pipelineBits = (foldId(programId, 12) << 4) 
+		| (U64(key.m_lod) << 1) 
+		| U64(key.m_tessellation ? 1 : 0);
+	U64 materialBits = foldId(materialId, 14);
+	U64 meshBits = foldId(meshId, 16);
+
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+	U64 depthBits = U64(depth * F32(MAX_DEPTH_BUCKET));
+
+	U64 out;
+	if(!blending)
+	{
+		// State first and then front to back
+		out = passBits
+			| (pipelineBits << 46)
+			| (materialBits << 32)
+			| (meshBits << 16)
+			| depthBits;
+	}
+	else
+	{
+		// Back to front first
+		out = passBits
+			| ((MAX_DEPTH_BUCKET - depthBits) << 46)
+			| (pipelineBits << 30)
+			| (materialBits << 16)
+			| meshBits;
+	}
+
+	return out;
+}
+
+//==============================================================================
+void RenderQueue::sort()
+{
+	const U DIGIT_BITS = 8;
+	const U BUCKETS = 1 << DIGIT_BITS;
+	const U DIGITS = sizeof(U64) * 8 / DIGIT_BITS;
+
+	if(m_count < 2)
+	{
+		return;
+	}
+
+	// Compute the histograms of all digits with one pass
+	Array<Array<U32, BUCKETS>, DIGITS> histograms;
+	memset(&histograms[0][0], 0, sizeof(histograms));
+
+	for(U32 i = 0; i < m_count; i++)
+	{
+		U64 key = m_elements[i].m_key;
+		for(U d = 0; d < DIGITS; d++)
+		{
+			++histograms[d][(key >> (d * DIGIT_BITS)) & (BUCKETS - 1)];
+		}
+	}
+
+	RenderQueueElement* tmp =
+		m_alloc.newArray<RenderQueueElement>(m_count);
+	RenderQueueElement* src = m_elements;
+	RenderQueueElement* dst = tmp;
+
+	// LSD sort. Skip the digits that are the same in all keys
+	for(U d = 0; d < DIGITS; d++)
+	{
+		Array<U32, BUCKETS>& hist = histograms[d];
+		U shift = d * DIGIT_BITS;
+
+		if(hist[(src[0].m_key >> shift) & (BUCKETS - 1)] == m_count)
+		{
+			continue;
+		}
+
+		// Prefix sum
+		U32 offset = 0;
+		for(U b = 0; b < BUCKETS; b++)
+		{
+			U32 count = hist[b];
+			hist[b] = offset;
+			offset += count;
+		}
+
+		// Scatter
+		for(U32 i = 0; i < m_count; i++)
+		{
+			U b = (src[i].m_key >> shift) & (BUCKETS - 1);
+			dst[hist[b]++] = src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	if(src != m_elements)
+	{
+		memcpy(m_elements, src, sizeof(RenderQueueElement) * m_count);
+	}
+
+	m_alloc.deleteArray(tmp, m_count);
+}
+
+} // end namespace anki
@@ -4,6 +4,7 @@
 // http://www.anki3d.org/LICENSE
 
 #include "anki/renderer/Renderer.h"
+#include "anki/resource/ResourceManager.h"
 #include "anki/util/Exception.h"
 #include "anki/scene/Camera.h"
 #include "anki/scene/SceneGraph.h"
@@ -33,7 +34,9 @@ void Renderer::init(const ConfigSet& initializer)
 	// Set from the initializer
 	m_width = initializer.get("width");
 	m_height = initializer.get("height");
-	m_lodDistance = initializer.get("lodDistance");
+	m_lodMaxPixelError = initializer.get("lodMaxPixelError");
+	m_lodHysteresis = initializer.get("lodHysteresis");
+	m_occlusionCulling = initializer.get("occlusionCulling");
 	m_framesNum = 0;
 	m_samples = initializer.get("samples");
 	m_isOffscreen = initializer.get("offscreen");
@@ -93,32 +96,37 @@ void Renderer::init(const ConfigSet& initializer)
 }
 
 //==============================================================================
-void Renderer::render(SceneGraph& scene, 
+void Renderer::render(const RenderSnapshot& snapshot, 
 	Array<GlCommandBufferHandle, JOB_CHAINS_COUNT>& jobs)
 {
-	m_scene = &scene;
-	Camera& cam = m_scene->getActiveCamera();
+	// Switch to the textures that finished streaming. The previous frame
+	// doesn't use them any more
+	_getResourceManager().commitTextureStreaming();
+
+	m_snapshot = &snapshot;
+	const FrustumSnapshot& cam = snapshot.m_camera;
 
 	// Calc a few vars
 	//
-	Timestamp camUpdateTimestamp = cam.FrustumComponent::getTimestamp();
-	if(m_projectionParamsUpdateTimestamp 
-			< m_scene->getActiveCameraChangeTimestamp()
-		|| m_projectionParamsUpdateTimestamp < camUpdateTimestamp
+	if(m_projectionParamsUpdateTimestamp < snapshot.m_cameraChangeTimestamp
+		|| m_projectionParamsUpdateTimestamp < cam.m_timestamp
 		|| m_projectionParamsUpdateTimestamp == 1)
 	{
-		ANKI_ASSERT(cam.getCameraType() == Camera::Type::PERSPECTIVE);
-		computeProjectionParams(cam.getProjectionMatrix());
-		m_projectionParamsUpdateTimestamp = getGlobTimestamp();
+		ANKI_ASSERT(cam.m_perspective);
+		computeProjectionParams(cam.m_projectionMat);
+		m_projectionParamsUpdateTimestamp = snapshot.m_timestamp;
 	}
 
+	// Update the tile planes for the camera of the frame
+	m_tiler.updateTiles(cam);
+
 	ANKI_COUNTER_START_TIMER(RENDERER_MS_TIME);
 	m_ms.run(jobs[0]);
 	ANKI_ASSERT(jobs[0].getReferenceCount() == 1);
 	jobs[0].flush();
 	ANKI_COUNTER_STOP_TIMER_INC(RENDERER_MS_TIME);
 
-	m_tiler.runMinMax(m_ms._getDepthRt());
+	m_tiler.runMinMax(m_ms._getDepthRt(), jobs[1]);
 
 	ANKI_COUNTER_START_TIMER(RENDERER_IS_TIME);
 	m_is.run(jobs[1]);
@@ -153,7 +161,7 @@ void Renderer::drawQuadInstanced(
 {
 	m_quadPositionsBuff.bindVertexBuffer(jobs, 2, GL_FLOAT, false, 0, 0, 0);
 
-	dc.drawArrays(GL_TRIANGLE_STRIP, 4, primitiveCount);
+	jobs.drawArrays(GL_TRIANGLE_STRIP, 4, primitiveCount);
 }
 
 //==============================================================================
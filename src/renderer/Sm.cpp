@@ -8,8 +8,7 @@
 #include "anki/core/App.h"
 #include "anki/core/Counters.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/scene/Camera.h"
-#include "anki/scene/Light.h"
+#include "anki/scene/RenderSnapshot.h"
 
 namespace anki {
 
@@ -105,7 +104,7 @@ void Sm::finishDraw(GlCommandBufferHandle& jobs)
 }
 
 //==============================================================================
-void Sm::run(Light* shadowCasters[], U32 shadowCastersCount, 
+void Sm::run(LightSnapshot* shadowCasters[], U32 shadowCastersCount, 
 	GlCommandBufferHandle& jobs)
 {
 	ANKI_ASSERT(m_enabled);
@@ -124,12 +123,12 @@ void Sm::run(Light* shadowCasters[], U32 shadowCastersCount,
 }
 
 //==============================================================================
-Sm::Shadowmap& Sm::bestCandidate(Light& light)
+Sm::Shadowmap& Sm::bestCandidate(U64 lightUuid)
 {
 	// Allready there
 	for(Shadowmap& sm : m_sms)
 	{
-		if(&light == sm.m_light)
+		if(lightUuid == sm.m_lightUuid)
 		{
 			return sm;
 		}
@@ -138,9 +137,9 @@ Sm::Shadowmap& Sm::bestCandidate(Light& light)
 	// Find a null
 	for(Shadowmap& sm : m_sms)
 	{
-		if(sm.m_light == nullptr)
+		if(sm.m_lightUuid == 0)
 		{
-			sm.m_light = &light;
+			sm.m_lightUuid = lightUuid;
 			sm.m_timestamp = 0;
 			return sm;
 		}
@@ -156,56 +155,28 @@ Sm::Shadowmap& Sm::bestCandidate(Light& light)
 		}
 	}
 
-	sm->m_light = &light;
+	sm->m_lightUuid = lightUuid;
 	sm->m_timestamp = 0;
 	return *sm;
 }
 
 //==============================================================================
-Sm::Shadowmap* Sm::doLight(Light& light, GlCommandBufferHandle& jobs)
+Sm::Shadowmap* Sm::doLight(LightSnapshot& light, 
+	GlCommandBufferHandle& jobs)
 {
-	Shadowmap& sm = bestCandidate(light);
-
-	FrustumComponent& fr = light.getComponent<FrustumComponent>();
-	VisibilityTestResults& vi = fr.getVisibilityTestResults();
-
-	//
-	// Find last update
-	//
-	U32 lastUpdate = light.MoveComponent::getTimestamp();
-	lastUpdate = std::max(lastUpdate, fr.getTimestamp());
-
-	for(auto& it : vi.m_renderables)
-	{
-		SceneNode* node = it.m_node;
-		MoveComponent* bmov = node->tryGetComponent<MoveComponent>();
-		FrustumComponent* bfr = node->tryGetComponent<FrustumComponent>();
-		SpatialComponent* sp = node->tryGetComponent<SpatialComponent>();
-
-		if(bfr)
-		{
-			lastUpdate = std::max(lastUpdate, bfr->getTimestamp());
-		}
+	ANKI_ASSERT(light.m_frustum);
+	Shadowmap& sm = bestCandidate(light.m_uuid);
+	light.m_shadowMapIndex = &sm - &m_sms[0];
 
-		if(bmov)
-		{
-			lastUpdate = std::max(lastUpdate, bmov->getTimestamp());
-		}
-
-		if(sp)
-		{
-			lastUpdate = std::max(lastUpdate, sp->getTimestamp());
-		}
-	}
-
-	Bool shouldUpdate = lastUpdate >= sm.m_timestamp;
+	// The snapshot has the last change of the light and of what it sees
+	const FrustumSnapshot& fr = *light.m_frustum;
+	Bool shouldUpdate = fr.m_lastUpdate >= sm.m_timestamp;
 	if(!shouldUpdate)
 	{
 		return &sm;
 	}
 
-	sm.m_timestamp = getGlobTimestamp();
-	light.setShadowMapIndex(&sm - &m_sms[0]);
+	sm.m_timestamp = m_r->getRenderSnapshot().m_timestamp;
 
 	//
 	// Render
@@ -214,10 +185,9 @@ Sm::Shadowmap* Sm::doLight(Light& light, GlCommandBufferHandle& jobs)
 	jobs.setViewport(0, 0, m_resolution, m_resolution);
 	jobs.clearBuffers(GL_DEPTH_BUFFER_BIT);
 
-	for(auto& it : vi.m_renderables)
-	{
-		m_r->getSceneDrawer().render(light, it);
-	}
+	VisibilityTestResults& vi = *fr.m_visible;
+	m_r->getSceneDrawer().render(fr, vi.m_renderables.data(), 
+		vi.m_renderables.data() + vi.m_renderables.size());
 
 	ANKI_COUNTER_INC(RENDERER_SHADOW_PASSES, (U64)1);
 
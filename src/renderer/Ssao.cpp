@@ -5,8 +5,7 @@
 
 #include "anki/renderer/Ssao.h"
 #include "anki/renderer/Renderer.h"
-#include "anki/scene/Camera.h"
-#include "anki/scene/SceneGraph.h"
+#include "anki/scene/RenderSnapshot.h"
 #include "anki/util/Functions.h"
 #include <sstream>
 
@@ -233,26 +232,13 @@ void Ssao::run(GlCommandBufferHandle& jobs)
 {
 	ANKI_ASSERT(m_enabled);
 
-	const Camera& cam = m_r->getSceneGraph().getActiveCamera();
-
-	jobs.setViewport(0, 0, m_width, m_height);
-
-	// 1st pass
-	//
-	m_vblurFb.bind(jobs, true);
-	m_ssaoPpline.bind(jobs);
-
-	m_uniformsBuff.bindShaderBuffer(jobs, 0);
-
-	jobs.bindTextures(0, {
-		m_r->getMs()._getSmallDepthRt(),
-		m_r->getMs()._getRt1(),
-		m_noiseTex});
+	const RenderSnapshot& snapshot = m_r->getRenderSnapshot();
+	const FrustumSnapshot& cam = snapshot.m_camera;
 
 	// Write common block
 	if(m_commonUboUpdateTimestamp 
 			< m_r->getProjectionParametersUpdateTimestamp()
-		|| m_commonUboUpdateTimestamp < cam.FrustumComponent::getTimestamp()
+		|| m_commonUboUpdateTimestamp < cam.m_timestamp
 		|| m_commonUboUpdateTimestamp == 1)
 	{
 		GlClientBufferHandle tmpBuff(jobs, sizeof(ShaderCommonUniforms),
@@ -263,12 +249,40 @@ void Ssao::run(GlCommandBufferHandle& jobs)
 
 		blk.m_projectionParams = m_r->getProjectionParameters();
 
-		blk.m_projectionMatrix = cam.getProjectionMatrix().getTransposed();
+		blk.m_projectionMatrix = cam.m_projectionMat.getTransposed();
 
 		m_uniformsBuff.write(jobs, tmpBuff, 0, 0, tmpBuff.getSize());
-		m_commonUboUpdateTimestamp = getGlobTimestamp();
+		m_commonUboUpdateTimestamp = snapshot.m_timestamp;
 	}
 
+	if(!m_bundle.isCreated())
+	{
+		recordBundle();
+	}
+
+	jobs.pushBackOtherCommandBuffer(m_bundle);
+}
+
+//==============================================================================
+void Ssao::recordBundle()
+{
+	m_bundle = GlCommandBufferHandle(&getGlDevice());
+	GlCommandBufferHandle& jobs = m_bundle;
+
+	jobs.setViewport(0, 0, m_width, m_height);
+
+	// 1st pass
+	//
+	m_vblurFb.bind(jobs, true);
+	m_ssaoPpline.bind(jobs);
+
+	m_uniformsBuff.bindShaderBuffer(jobs, 0);
+
+	jobs.bindTextures(0, {
+		m_r->getMs()._getSmallDepthRt(),
+		m_r->getMs()._getRt1(),
+		m_noiseTex});
+
 	// Draw
 	m_r->drawQuad(jobs);
 
@@ -5,13 +5,11 @@
 
 #include "anki/renderer/Tiler.h"
 #include "anki/renderer/Renderer.h"
+#include "anki/collision/Functions.h"
 #include "anki/resource/ProgramResource.h"
-#include "anki/scene/Camera.h"
+#include "anki/scene/RenderSnapshot.h"
 #include <sstream>
 
-// Default should be 0
-#define ANKI_TILER_ENABLE_GPU 0
-
 namespace anki {
 
 //==============================================================================
@@ -26,28 +24,25 @@ namespace anki {
 struct UpdatePlanesPerspectiveCameraJob: Threadpool::Task
 {
 	Tiler* m_tiler = nullptr;
-	PerspectiveCamera* m_cam = nullptr;
+	const FrustumSnapshot* m_cam = nullptr;
 	Bool m_frustumChanged;
-#if ANKI_TILER_ENABLE_GPU
-	const PixelArray* m_pixels = nullptr;
-#endif
+	F32 m_translation = 0.0; ///< Camera motion since the min/max readback
+	F32 m_rotation = 0.0; ///< Camera motion since the min/max readback
 
 	void operator()(U32 threadId, PtrSize threadsCount)
 	{
-#if ANKI_TILER_ENABLE_GPU
-		ANKI_ASSERT(tiler && cam && pixels);
-#endif
+		ANKI_ASSERT(m_tiler && m_cam);
 
 		PtrSize start, end;
-		Transform trf = Transform(m_cam->getWorldTransform());
+		Transform trf = m_cam->m_worldTransform;
 
 		if(m_frustumChanged)
 		{
 			// Re-calculate the planes in local space
 
-			const F32 fx = m_cam->getFovX();
-			const F32 fy = m_cam->getFovY();
-			const F32 n = m_cam->getNear();
+			const F32 fx = m_cam->m_fovX;
+			const F32 fy = m_cam->m_fovY;
+			const F32 n = m_cam->m_near;
 
 			// Calculate l6 and o6 used to rotate the planes
 			F32 l = 2.0 * n * tan(fx / 2.0);
@@ -63,11 +58,6 @@ struct UpdatePlanesPerspectiveCameraJob: Threadpool::Task
 			for(U i = start; i < end; i++)
 			{
 				calcPlaneI(i, o6);
-
-				CHECK_PLANE_PTR(&m_tiler->m_planesYW[i]);
-				CHECK_PLANE_PTR(&m_tiler->m_planesY[i]);
-				m_tiler->m_planesYW[i] =
-					m_tiler->m_planesY[i].getTransformed(trf);
 			}
 
 			// Then the right looking planes
@@ -78,88 +68,124 @@ struct UpdatePlanesPerspectiveCameraJob: Threadpool::Task
 			for(U j = start; j < end; j++)
 			{
 				calcPlaneJ(j, l6);
-
-				CHECK_PLANE_PTR(&m_tiler->m_planesXW[j]);
-				CHECK_PLANE_PTR(&m_tiler->m_planesX[j]);
-				m_tiler->m_planesXW[j] =
-					m_tiler->m_planesX[j].getTransformed(trf);
 			}
 		}
-		else
-		{
-			// Only transform planes
 
-			// First the top looking planes
+		// Transform the planes of this thread. The ranges are the same as
+		// above
+
+		// First the top looking planes
+		choseStartEnd(
+			threadId, threadsCount, m_tiler->m_r->getTilesCount().y() - 1,
+			start, end);
+		transformPlaneRange(m_tiler->m_planesY, m_tiler->m_planesYW, start, 
+			end, trf);
+
+		// Then the right looking planes
+		choseStartEnd(
+			threadId, threadsCount, m_tiler->m_r->getTilesCount().x() - 1,
+			start, end);
+		transformPlaneRange(m_tiler->m_planesX, m_tiler->m_planesXW, start, 
+			end, trf);
+
+		// Update the depth bounds and the near far planes
+		if(m_tiler->m_depthBoundsValid)
+		{
 			choseStartEnd(
-				threadId, threadsCount, m_tiler->m_r->getTilesCount().y() - 1,
+				threadId, threadsCount, 
+				m_tiler->m_r->getTilesCount().x() 
+				* m_tiler->m_r->getTilesCount().y(), 
 				start, end);
 
-			for(U i = start; i < end; i++)
+			for(U k = start; k < end; ++k)
 			{
-				CHECK_PLANE_PTR(&m_tiler->m_planesYW[i]);
-				CHECK_PLANE_PTR(&m_tiler->m_planesY[i]);
-				m_tiler->m_planesYW[i] =
-					m_tiler->m_planesY[i].getTransformed(trf);
+				updateDepthBounds(k, trf);
 			}
+		}
+	}
 
-			// Then the right looking planes
-			choseStartEnd(
-				threadId, threadsCount, m_tiler->m_r->getTilesCount().x() - 1,
-				start, end);
-
-			for(U j = start; j < end; j++)
+	/// Correct the depth bounds of a tile for the camera motion and calculate
+	/// the near and far planes
+	void updateDepthBounds(U k, const Transform& trf)
+	{
+		const I countX = m_tiler->m_r->getTilesCount().x();
+		const I countY = m_tiler->m_r->getTilesCount().y();
+		const I x = k % countX;
+		const I y = k / countX;
+
+		// The geometry of the neighbour tiles may have moved inside this tile
+		// so take their bounds as well
+		Vec2 b(MAX_F32, 0.0);
+		const I yEnd = std::min(y + 1, countY - 1);
+		const I xEnd = std::min(x + 1, countX - 1);
+		for(I j = std::max<I>(y - 1, 0); j <= yEnd; j++)
+		{
+			for(I i = std::max<I>(x - 1, 0); i <= xEnd; i++)
 			{
-				CHECK_PLANE_PTR(&m_tiler->m_planesXW[j]);
-				CHECK_PLANE_PTR(&m_tiler->m_planesX[j]);
-				m_tiler->m_planesXW[j] =
-					m_tiler->m_planesX[j].getTransformed(trf);
+				const Vec2& d = m_tiler->m_readbackDepths[j * countX + i];
+				b.x() = std::min(b.x(), d.x());
+				b.y() = std::max(b.y(), d.y());
 			}
 		}
 
-		// Update the near far planes
-#if ANKI_TILER_ENABLE_GPU
-		Vec2 rplanes;
-		Renderer::calcPlanes(Vec2(cam->getNear(), cam->getFar()), rplanes);
+		// The neighbours cover a motion of up to one tile on the screen. The 
+		// motion is in the tangent space of the projection and the geometry 
+		// that is closer to the camera moves more
+		const F32 tanX = tan(m_cam->m_fovX / 2.0);
+		const F32 tanY = tan(m_cam->m_fovY / 2.0);
+		const F32 tanMax = std::max(tanX, tanY);
+		const F32 tileSize = 
+			std::min(2.0 * tanX / countX, 2.0 * tanY / countY);
+
+		F32 shift = MAX_F32;
+		if(b.x() > m_translation)
+		{
+			shift = m_rotation * (1.0 + tanMax * tanMax)
+				+ m_translation * (1.0 + tanMax) / (b.x() - m_translation);
+		}
 
-		choseStartEnd(
-			threadId, threadsCount, 
-			tiler->r->getTilesCount().x() * tiler->r->getTilesCount().y(), 
-			start, end);
+		if(shift < tileSize)
+		{
+			b.x() -= m_translation;
+			b.y() += m_translation;
+		}
+		else
+		{
+			// Moved too much
+			b = Vec2(0.0, m_cam->m_far);
+		}
 
-		Plane* nearPlanesW = tiler->nearPlanesW + start;
-		Plane* farPlanesW = tiler->farPlanesW + start;
-		for(U k = start; k < end; ++k)
+		m_tiler->m_depthBounds[k] = b;
+
+		// Calc the planes and tranform them
+		Plane nearPlane(Vec4(0.0, 0.0, -1.0, 0.0), b.x());
+		Plane farPlane(Vec4(0.0, 0.0, 1.0, 0.0), -b.y());
+
+		CHECK_PLANE_PTR(&m_tiler->m_nearPlanesW[k]);
+		m_tiler->m_nearPlanesW[k] = nearPlane.getTransformed(trf);
+		CHECK_PLANE_PTR(&m_tiler->m_farPlanesW[k]);
+		m_tiler->m_farPlanesW[k] = farPlane.getTransformed(trf);
+	}
+
+	/// Transform the [start, end) local planes to world space
+	void transformPlaneRange(const Plane* local, Plane* world, PtrSize start,
+		PtrSize end, const Transform& trf)
+	{
+		if(start < end)
 		{
-			U j = k % tiler->r->getTilesCount().x();
-			U i = k / tiler->r->getTilesCount().x();
-
-			// Calculate depth as you do it for the vertex position inside
-			// the shaders
-			F32 minZ = rplanes.y() / (rplanes.x() + (*pixels)[i][j][0]);
-			F32 maxZ = rplanes.y() / (rplanes.x() + (*pixels)[i][j][1]);
-
-			// Calc the planes
-			Plane nearPlane = Plane(Vec3(0.0, 0.0, -1.0), minZ);
-			Plane farPlane = Plane(Vec3(0.0, 0.0, 1.0), -maxZ);
-
-			// Tranform them
-			CHECK_PLANE_PTR(nearPlanesW);
-			*nearPlanesW = nearPlane.getTransformed(trf);
-			CHECK_PLANE_PTR(farPlanesW);
-			*farPlanesW = farPlane.getTransformed(trf);
-
-			// Advance
-			++nearPlanesW;
-			++farPlanesW;
+			CHECK_PLANE_PTR(&local[start]);
+			CHECK_PLANE_PTR(&local[end - 1]);
+			CHECK_PLANE_PTR(&world[start]);
+			CHECK_PLANE_PTR(&world[end - 1]);
+			transformPlanes(trf, &local[start], &world[start], end - start);
 		}
-#endif
 	}
 
 	/// Calculate and set a top looking plane
 	void calcPlaneI(U i, const F32 o6)
 	{
 		Vec4 a, b;
-		const F32 n = m_cam->getNear();
+		const F32 n = m_cam->m_near;
 		Plane& plane = m_tiler->m_planesY[i];
 		CHECK_PLANE_PTR(&plane);
 
@@ -178,7 +204,7 @@ struct UpdatePlanesPerspectiveCameraJob: Threadpool::Task
 	void calcPlaneJ(U j, const F32 l6)
 	{
 		Vec4 a, b;
-		const F32 n = m_cam->getNear();
+		const F32 n = m_cam->m_near;
 		Plane& plane = m_tiler->m_planesX[j];
 		CHECK_PLANE_PTR(&plane);
 
@@ -248,12 +274,18 @@ void Tiler::initInternal(Renderer* r)
 	m_fb = GlFramebufferHandle(jobs, {{m_rt, GL_COLOR_ATTACHMENT0}});
 
 	// Create PBO
-	U pixelBuffSize = m_r->getTilesCount().x() * m_r->getTilesCount().y();
+	U tilesCount = m_r->getTilesCount().x() * m_r->getTilesCount().y();
+	U pixelBuffSize = tilesCount;
 	pixelBuffSize *= 2 * sizeof(F32); // The pixel size
-	pixelBuffSize *= 4; // Because it will be always mapped
+	pixelBuffSize *= READBACKS_COUNT; // Because it will be always mapped
 	m_pixelBuff = GlBufferHandle(jobs, GL_PIXEL_PACK_BUFFER, pixelBuffSize,
 		GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
 
+	m_readbackDepths = Vector<Vec2>(m_r->_getAllocator());
+	m_readbackDepths.resize(tilesCount);
+	m_depthBounds = Vector<Vec2>(m_r->_getAllocator());
+	m_depthBounds.resize(tilesCount);
+
 	// Init planes. One plane for each direction, plus near/far plus the world
 	// space of those
 	U planesCount = 
@@ -279,78 +311,173 @@ void Tiler::initInternal(Renderer* r)
 }
 
 //==============================================================================
-void Tiler::runMinMax(const GlTextureHandle& depthMap)
+void Tiler::runMinMax(const GlTextureHandle& depthMap, 
+	GlCommandBufferHandle& jobs)
 {
-#if ANKI_TILER_ENABLE_GPU
-	ANKI_ASSERT(depthMap.getFiltering() == Texture::TFrustumType::NEAREST);
+	// Check the results in flight without blocking
+	for(Readback& readback : m_readbacks)
+	{
+		if(readback.m_pending)
+		{
+			readback.m_fence.poll(jobs);
+		}
+	}
+
+	Readback& readback = m_readbacks[m_crntReadback];
+	if(readback.m_pending)
+	{
+		// The GPU is too far behind. Don't wait, skip the frame
+		return;
+	}
+
+	const U tilesX = m_r->getTilesCount().x();
+	const U tilesY = m_r->getTilesCount().y();
+	const FrustumSnapshot& cam = m_r->getRenderSnapshot().m_camera;
 
 	// Issue the min/max job
-	fbo.bind();
-	GlStateSingleton::get().setViewport(
-		0, 0, r->getTilesCount().x(), r->getTilesCount().y());
-	r->clearAfterBindingFbo(GL_COLOR_BUFFER_BIT);
-	prog->bind();
-	ANKI_ASSERT(depthMapUniform);
-	depthMapUniform->set(depthMap);
+	m_fb.bind(jobs, true);
+	jobs.setViewport(0, 0, tilesX, tilesY);
+	m_ppline.bind(jobs);
+	jobs.bindTextures(0, {depthMap});
 
-	r->drawQuad();
+	m_r->drawQuad(jobs);
 
 	// Issue the async pixel read
-	pbo.bind();
-	glReadPixels(0, 0, r->getTilesCount().x(), r->getTilesCount().y(), 
-		GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
-	pbo.unbind();
-#endif
+	PtrSize offset = m_crntReadback * tilesX * tilesY * 2 * sizeof(F32);
+	m_fb.readPixels(jobs, 0, 0, tilesX, tilesY, GL_RG_INTEGER, 
+		GL_UNSIGNED_INT, m_pixelBuff, offset);
+
+	readback.m_fence = GlFenceHandle(jobs);
+	readback.m_camTrf = cam.m_worldTransform;
+	readback.m_near = cam.m_near;
+	readback.m_far = cam.m_far;
+	readback.m_pending = true;
+
+	m_crntReadback = (m_crntReadback + 1) % READBACKS_COUNT;
 }
 
 //==============================================================================
-void Tiler::updateTiles(Camera& cam)
+void Tiler::readMinMax()
+{
+	// Find the newest result that is ready. The oldest is at m_crntReadback
+	I newest = -1;
+	for(U i = 0; i < READBACKS_COUNT; i++)
+	{
+		U idx = (m_crntReadback + i) % READBACKS_COUNT;
+		Readback& readback = m_readbacks[idx];
+
+		if(readback.m_pending && readback.m_fence.isSignaled())
+		{
+			readback.m_pending = false;
+			readback.m_fence = GlFenceHandle();
+			newest = idx;
+		}
+	}
+
+	if(newest == -1)
+	{
+		return;
+	}
+
+	// Convert the raw depth to view space depth
+	const Readback& readback = m_readbacks[newest];
+	const U tilesCount = m_r->getTilesCount().x() * m_r->getTilesCount().y();
+	const F32* pixels = 
+		static_cast<const F32*>(m_pixelBuff.getPersistentMappingAddress())
+		+ newest * tilesCount * 2;
+
+	const F32 n = readback.m_near;
+	const F32 f = readback.m_far;
+	auto linearize = [n, f](F32 depth) -> F32
+	{
+		F32 ndc = depth * 2.0 - 1.0;
+		return (2.0 * n * f) / (f + n - ndc * (f - n));
+	};
+
+	for(U k = 0; k < tilesCount; k++)
+	{
+		m_readbackDepths[k] = 
+			Vec2(linearize(pixels[k * 2]), linearize(pixels[k * 2 + 1]));
+	}
+
+	m_readbackCamTrf = readback.m_camTrf;
+	m_readbackValid = true;
+}
+
+//==============================================================================
+void Tiler::computeCameraMotion(const FrustumSnapshot& cam, 
+	F32& translation, F32& rotation) const
+{
+	const Transform& trf = cam.m_worldTransform;
+
+	translation = 
+		(trf.getOrigin() - m_readbackCamTrf.getOrigin()).xyz().getLength();
+
+	// The angle between the old and new axes. It's the maximum angle that
+	// a direction rotated
+	F32 minCos = 1.0;
+	for(U i = 0; i < 3; i++)
+	{
+		Vec3 a = trf.getRotation().getColumn(i);
+		Vec3 b = m_readbackCamTrf.getRotation().getColumn(i);
+		minCos = std::min(minCos, a.dot(b));
+	}
+
+	rotation = acos(std::max(std::min(minCos, 1.0f), -1.0f));
+}
+
+//==============================================================================
+void Tiler::updateTiles(const FrustumSnapshot& cam)
 {
 	//
-	// Read the results from the minmax job. It will block
+	// Read the results from the minmax job. It will not block
 	//
-#if ANKI_TILER_ENABLE_GPU
-	PixelArray pixels;
-	pbo.read(&pixels[0][0]);
-#endif
+	readMinMax();
+
+	F32 translation = 0.0;
+	F32 rotation = 0.0;
+	m_depthBoundsValid = false;
+	if(m_readbackValid && cam.m_perspective)
+	{
+		computeCameraMotion(cam, translation, rotation);
+		m_depthBoundsValid = true;
+	}
 
 	//
 	// Issue parallel jobs
 	//
 	Array<UpdatePlanesPerspectiveCameraJob, Threadpool::MAX_THREADS> jobs;
-	U32 camTimestamp = cam.FrustumComponent::getTimestamp();
+	U32 camTimestamp = cam.m_timestamp;
 
 	// Do a job that transforms only the planes when:
 	// - it is the same camera as before and
 	// - the camera frustum have not changed
 	Bool frustumChanged =
-		camTimestamp >= m_planes4UpdateTimestamp || m_prevCam != &cam;
+		camTimestamp >= m_planes4UpdateTimestamp || m_prevCamUuid != cam.m_uuid;
 
 	Threadpool& threadPool = m_r->_getThreadpool();
 
-	switch(cam.getCameraType())
+	if(cam.m_perspective)
 	{
-	case Camera::Type::PERSPECTIVE:
 		for(U i = 0; i < threadPool.getThreadsCount(); i++)
 		{
 			jobs[i].m_tiler = this;
-			jobs[i].m_cam = static_cast<PerspectiveCamera*>(&cam);
-#if ANKI_TILER_ENABLE_GPU
-			jobs[i].m_pixels = &pixels;
-#endif
+			jobs[i].m_cam = &cam;
 			jobs[i].m_frustumChanged = frustumChanged;
+			jobs[i].m_translation = translation;
+			jobs[i].m_rotation = rotation;
 			threadPool.assignNewTask(i, &jobs[i]);
 		}
-		break;
-	default:
+	}
+	else
+	{
 		ANKI_ASSERT(0 && "Unimplemented");
-		break;
 	}
 
 	// Update timestamp
 	if(frustumChanged)
 	{
-		m_planes4UpdateTimestamp = getGlobTimestamp();
+		m_planes4UpdateTimestamp = m_r->getRenderSnapshot().m_timestamp;
 	}
 
 	// Sync threads
@@ -359,7 +486,7 @@ void Tiler::updateTiles(Camera& cam)
 	// 
 	// Misc
 	// 
-	m_prevCam = &cam;
+	m_prevCamUuid = cam.m_uuid;
 }
 
 //==============================================================================
@@ -398,32 +525,18 @@ void Tiler::testRange(const CollisionShape& cs, Bool nearPlane,
 
 		Bool inside = true;
 
-#if ANKI_TILER_ENABLE_GPU
-		if(cs.testPlane(farPlanesW[tileId]) >= 0.0)
+		if(m_depthBoundsValid)
 		{
-			// Inside on far but check near
-
-			if(nearPlane)
+			// Check against the depth bounds of the tile
+			if(cs.testPlane(m_farPlanesW[tileId]) < 0.0)
 			{
-				if(cs.testPlane(nearPlanesW[tileId]) >= 0)
-				{
-					// Inside
-				}
-				else
-				{
-					inside = false;
-				}
+				inside = false;
 			}
-			else
+			else if(nearPlane && cs.testPlane(m_nearPlanesW[tileId]) < 0.0)
 			{
-				// Inside
+				inside = false;
 			}
 		}
-		else
-		{
-			inside = false;
-		}
-#endif
 
 		bitset.set(tileId, inside);
 		return;
@@ -0,0 +1,125 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/AsyncLoader.h"
+#include "anki/core/Logger.h"
+
+namespace anki {
+
+//==============================================================================
+AsyncLoader::AsyncLoader(const ResourceAllocator<U8>& alloc)
+:	m_alloc(alloc),
+	m_thread("anki_asyload")
+{
+	m_thread.start(this, threadCallback);
+}
+
+//==============================================================================
+AsyncLoader::~AsyncLoader()
+{
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		m_quit = true;
+	}
+
+	m_condVar.notifyAll();
+	m_thread.join();
+
+	ANKI_ASSERT(m_head == nullptr);
+}
+
+//==============================================================================
+void AsyncLoader::submitTask(AsyncLoaderTask* task)
+{
+	ANKI_ASSERT(task);
+
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		ANKI_ASSERT(!m_quit);
+
+		if(m_tail)
+		{
+			m_tail->m_next = task;
+		}
+		else
+		{
+			m_head = task;
+		}
+
+		m_tail = task;
+	}
+
+	m_condVar.notifyAll();
+}
+
+//==============================================================================
+void AsyncLoader::flush()
+{
+	LockGuard<Mutex> lock(m_mtx);
+	while(m_head || m_running)
+	{
+		m_condVar.wait(m_mtx);
+	}
+}
+
+//==============================================================================
+I AsyncLoader::threadCallback(Thread::Info& info)
+{
+	AsyncLoader* self = reinterpret_cast<AsyncLoader*>(info.m_userData);
+	self->threadLoop();
+	return 0;
+}
+
+//==============================================================================
+void AsyncLoader::threadLoop()
+{
+	while(1)
+	{
+		AsyncLoaderTask* task;
+
+		// Wait for a task. Quit only when the queue is empty
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			while(!m_head && !m_quit)
+			{
+				m_condVar.wait(m_mtx);
+			}
+
+			if(!m_head)
+			{
+				break;
+			}
+
+			task = m_head;
+			m_head = task->m_next;
+			if(!m_head)
+			{
+				m_tail = nullptr;
+			}
+
+			m_running = true;
+		}
+
+		try
+		{
+			(*task)();
+		}
+		catch(const std::exception& e)
+		{
+			ANKI_LOGE("Async loader task failed: %s", e.what());
+		}
+
+		m_alloc.deleteInstance(task);
+
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			m_running = false;
+		}
+
+		m_condVar.notifyAll();
+	}
+}
+
+} // end namespace anki
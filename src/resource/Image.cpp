@@ -173,25 +173,6 @@ static void loadTga(const CString& filename,
 // ANKI                                                                        =
 //==============================================================================
 
-//==============================================================================
-class AnkiTextureHeader
-{
-public:
-	Array<U8, 8> m_magic;
-	U32 m_width;
-	U32 m_height;
-	U32 m_depth;
-	Image::TextureType m_type;
-	Image::ColorFormat m_colorFormat;
-	Image::DataCompression m_compressionFormats;
-	U32 m_normal;
-	U32 m_mipLevels;
-	U8 m_padding[88];
-};
-
-static_assert(sizeof(AnkiTextureHeader) == 128, 
-	"Check sizeof AnkiTextureHeader");
-
 //==============================================================================
 /// Get the size in bytes of a single surface
 static PtrSize calcSurfaceSize(const U width, const U height, 
@@ -212,7 +193,8 @@ static PtrSize calcSurfaceSize(const U width, const U height,
 		                                                   // block size
 		break;
 	case Image::DataCompression::ETC:
-		out = (width / 4) * (height / 4) * 8;
+		out = (width / 4) * (height / 4) 
+			* ((cf == Image::ColorFormat::RGB8) ? 8 : 16); // RGBA has EAC
 		break;
 	default:
 		ANKI_ASSERT(0);
@@ -275,6 +257,7 @@ static void loadAnkiTexture(
 	ResourceVector<Image::Surface>& surfaces, 
 	U8& depth, 
 	U8& mipLevels, 
+	U8& firstMipLevel,
 	Image::TextureType& textureType,
 	Image::ColorFormat& colorFormat)
 {
@@ -354,6 +337,14 @@ static void loadAnkiTexture(
 		throw ANKI_EXCEPTION("Incorrect number of mip levels");
 	}
 
+	// Keep the smallest mip even if it's bigger than the max size
+	if(mipLevels == 0)
+	{
+		mipLevels = 1;
+	}
+
+	firstMipLevel = tmpMipLevels - mipLevels;
+
 	colorFormat = header.m_colorFormat;
 
 	switch(header.m_type)
@@ -434,9 +425,9 @@ static void loadAnkiTexture(
 				header.m_colorFormat);
 
 			// Check if this mipmap can be skipped because of size
-			if(std::max(mipWidth, mipHeight) <= maxTextureSize)
+			if(mip >= firstMipLevel)
 			{
-				U index = (mip - tmpMipLevels + mipLevels) * depth + d;
+				U index = (mip - firstMipLevel) * depth + d;
 				ANKI_ASSERT(index < surfaces.size());
 				Image::Surface& surf = surfaces[index];
 				surf.m_width = mipWidth;
@@ -512,7 +503,7 @@ void Image::load(const CString& filename, U32 maxTextureSize)
 
 			loadAnkiTexture(filename, maxTextureSize, 
 				m_compression, m_surfaces, m_depth, 
-				m_mipLevels, m_textureType, m_colorFormat);
+				m_mipLevels, m_firstMipLevel, m_textureType, m_colorFormat);
 
 		}
 		else
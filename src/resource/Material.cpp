@@ -12,6 +12,8 @@
 #include "anki/util/Hash.h"
 #include "anki/util/File.h"
 #include "anki/util/Filesystem.h"
+#include "anki/util/Thread.h"
+#include "anki/util/HighRezTimer.h"
 #include "anki/misc/Xml.h"
 #include <functional> // TODO
 #include <algorithm>
@@ -101,6 +103,46 @@ static GLenum blendToEnum(const CString& str)
 #undef TXT_AND_ENUM
 }
 
+//==============================================================================
+/// Serialize the creation of the cached program sources. Materials that are
+/// loaded in parallel may produce the same permutation source
+static Mutex gCacheMtx;
+
+//==============================================================================
+/// Load a batch of materials in parallel
+class MaterialLoadTask: public Threadpool::Task
+{
+public:
+	const CString* m_filenames = nullptr;
+	MaterialResourcePointer* m_materials = nullptr;
+	U32 m_count = 0;
+	ResourceManager* m_resources = nullptr;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+		choseStartEnd(taskId, threadsCount, m_count, start, end);
+
+		if(start == end)
+		{
+			return;
+		}
+
+		// Every worker has its own temp memory. Nothing outlives a load in
+		// it so reset it after every material
+		TempResourceAllocator<U8> tmpAlloc = m_resources->_newTempAllocator();
+		ResourceManager::_setThreadTempAllocator(&tmpAlloc);
+
+		for(PtrSize i = start; i < end; ++i)
+		{
+			m_materials[i].load(m_filenames[i], m_resources);
+			tmpAlloc.getMemoryPool().reset();
+		}
+
+		ResourceManager::_setThreadTempAllocator(nullptr);
+	}
+};
+
 //==============================================================================
 // MaterialVariable                                                            =
 //==============================================================================
@@ -212,46 +254,58 @@ ProgramResourcePointer& Material::getProgram(
 }
 
 //==============================================================================
-GlProgramPipelineHandle Material::getProgramPipeline(
-	const RenderingKey& key)
+U Material::getProgramPipelineIndex(const RenderingKey& key) const
 {
 	ANKI_ASSERT((U)key.m_pass < m_passesCount);
 	ANKI_ASSERT(key.m_lod < m_lodsCount);
 
-	U tessCount = 1;
 	if(key.m_tessellation)
 	{
 		ANKI_ASSERT(m_tessellation);
-		tessCount = 2;
 	}
 
+	U tessCount = m_tessellation ? 2 : 1;
 	U idx = (U)key.m_pass * m_lodsCount * tessCount
 		+ key.m_lod * tessCount + key.m_tessellation;
 
 	ANKI_ASSERT(idx < m_pplines.size());
-	GlProgramPipelineHandle& ppline = m_pplines[idx];
+	return idx;
+}
 
-	// Lazily create it
-	if(ANKI_UNLIKELY(!ppline.isCreated()))
+//==============================================================================
+void Material::createProgramPipeline(const RenderingKey& key, 
+	GlCommandBufferHandle& cmdBuff, GlProgramPipelineHandle& ppline)
+{
+	Array<GlProgramHandle, 5> progs;
+	U progCount = 0;
+
+	progs[progCount++] = getProgram(key, 0)->getGlProgram();
+
+	if(key.m_tessellation)
 	{
-		Array<GlProgramHandle, 5> progs;
-		U progCount = 0;
+		progs[progCount++] = getProgram(key, 1)->getGlProgram();
+		progs[progCount++] = getProgram(key, 2)->getGlProgram();
+	}
 
-		progs[progCount++] = getProgram(key, 0)->getGlProgram();
+	progs[progCount++] = getProgram(key, 4)->getGlProgram();
 
-		if(key.m_tessellation)
-		{
-			progs[progCount++] = getProgram(key, 1)->getGlProgram();
-			progs[progCount++] = getProgram(key, 2)->getGlProgram();
-		}
+	ppline = GlProgramPipelineHandle(
+		cmdBuff, &progs[0], &progs[0] + progCount);
+}
 
-		progs[progCount++] = getProgram(key, 4)->getGlProgram();
+//==============================================================================
+GlProgramPipelineHandle Material::getProgramPipeline(
+	const RenderingKey& key)
+{
+	GlProgramPipelineHandle& ppline = m_pplines[getProgramPipelineIndex(key)];
 
+	// Lazily create it. Material::warmup should have created it already
+	if(ANKI_UNLIKELY(!ppline.isCreated()))
+	{
 		GlDevice& gl = m_resources->_getGlDevice();
 		GlCommandBufferHandle cmdBuff(&gl);
 
-		ppline = GlProgramPipelineHandle(
-			cmdBuff, &progs[0], &progs[0] + progCount);
+		createProgramPipeline(key, cmdBuff, ppline);
 
 		cmdBuff.flush();
 	}
@@ -259,11 +313,102 @@ GlProgramPipelineHandle Material::getProgramPipeline(
 	return ppline;
 }
 
+//==============================================================================
+U32 Material::createProgramPipelines(GlCommandBufferHandle& cmdb)
+{
+	U32 count = 0;
+	U tessCount = m_tessellation ? 2 : 1;
+
+	for(U pid = 0; pid < m_passesCount; ++pid)
+	{
+		for(U level = 0; level < m_lodsCount; ++level)
+		{
+			for(U tess = 0; tess < tessCount; ++tess)
+			{
+				RenderingKey key((Pass)pid, level, tess);
+				GlProgramPipelineHandle& ppline = 
+					m_pplines[getProgramPipelineIndex(key)];
+
+				if(!ppline.isCreated())
+				{
+					createProgramPipeline(key, cmdb, ppline);
+					++count;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+//==============================================================================
+void Material::warmup(const CString* filenames, 
+	MaterialResourcePointer* materials, U32 count, 
+	ResourceManager& resources, Threadpool& threadpool, 
+	MaterialWarmupStats& stats)
+{
+	ANKI_ASSERT(filenames && materials);
+
+	// Load in parallel. That includes the XML parsing, the generation and 
+	// hashing of the permutation sources and the variable setup
+	HighRezTimer timer;
+	timer.start();
+
+	Array<MaterialLoadTask, Threadpool::MAX_THREADS> jobs;
+	for(U i = 0; i < threadpool.getThreadsCount(); i++)
+	{
+		jobs[i].m_filenames = filenames;
+		jobs[i].m_materials = materials;
+		jobs[i].m_count = count;
+		jobs[i].m_resources = &resources;
+
+		threadpool.assignNewTask(i, &jobs[i]);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
+
+	timer.stop();
+	stats.m_loadTime += timer.getElapsedTime();
+
+	// Create all the pipelines using a single command buffer
+	timer.start();
+
+	GlCommandBufferHandle cmdb(&resources._getGlDevice());
+	U32 permutations = 0;
+	U32 pipelines = 0;
+	for(U32 i = 0; i < count; ++i)
+	{
+		if(!materials[i].isLoaded())
+		{
+			continue;
+		}
+
+		permutations += materials[i]->getPermutationsCount();
+		pipelines += materials[i]->createProgramPipelines(cmdb);
+	}
+
+	cmdb.finish();
+
+	timer.stop();
+	stats.m_pipelinesTime += timer.getElapsedTime();
+
+	stats.m_materialsCount += count;
+	stats.m_permutationsCount += permutations;
+	stats.m_pipelinesCount += pipelines;
+
+	ANKI_LOGI("Material warmup: %u materials, %u permutations, "
+		"%u new pipelines. Load %f sec, pipelines %f sec", 
+		count, permutations, pipelines, 
+		stats.m_loadTime, stats.m_pipelinesTime);
+}
+
 //==============================================================================
 void Material::load(const CString& filename, ResourceInitializer& init)
 {
 	try
 	{
+		m_resources = &init.m_resources;
+
 		m_vars = std::move(ResourceVector<MaterialVariable*>(init.m_alloc));
 
 		Dictionary<MaterialVariable*> dict(10, 
@@ -400,6 +545,7 @@ void Material::parseMaterialTag(const XmlElement& materialEl,
 						"#define PASS %u\n"
 						"#define TESSELLATION %u\n", 
 						level, pid, tess);
+					src += mspc.getProgramSource(shader);
 
 					TempResourceString filename =
 						createProgramSourceToChache(src);
@@ -439,6 +585,7 @@ TempResourceString Material::createProgramSourceToChache(
 		&prefix[0]);
 
 	// If file not exists write it
+	LockGuard<Mutex> lock(gCacheMtx);
 	if(!fileExists(newfPathName.toCString()))
 	{
 		// If not create it
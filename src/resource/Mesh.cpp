@@ -44,6 +44,10 @@ void Mesh::load(const CString& filename, ResourceInitializer& init)
 		m_texChannelsCount = loader.getTextureChannelsCount();
 		m_weights = loader.getWeights().size() > 1;
 
+		const auto& clusters = loader.getClusters();
+		m_clusters = ResourceVector<MeshCluster>(
+			clusters.begin(), clusters.end(), init.m_alloc);
+
 		createBuffers(loader, init);
 	}
 	catch(std::exception& e)
@@ -0,0 +1,482 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/MeshCluster.h"
+#include "anki/math/Simd.h"
+#include <algorithm>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The cones that are wider than that are not culled
+static const F32 MIN_CONE_COS = 0.1;
+
+//==============================================================================
+/// The bounds of the triangles of a cluster
+static void computeBounds(const Vec3* positions, const U16* indices,
+	const Vec3* normals, const U32* tris, U32 trisCount,
+	MeshCluster& cluster)
+{
+	// The sphere around the box
+	Vec3 min(MAX_F32);
+	Vec3 max(-MAX_F32);
+	for(U i = 0; i < trisCount; i++)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			const Vec3& p = positions[indices[tris[i] * 3 + j]];
+			for(U k = 0; k < 3; k++)
+			{
+				min[k] = std::min(min[k], p[k]);
+				max[k] = std::max(max[k], p[k]);
+			}
+		}
+	}
+
+	Vec3 center = (min + max) * 0.5;
+	F32 radius2 = 0.0;
+	for(U i = 0; i < trisCount; i++)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			const Vec3& p = positions[indices[tris[i] * 3 + j]];
+			radius2 = std::max(radius2, (p - center).getLengthSquared());
+		}
+	}
+
+	cluster.m_sphere = Vec4(center, sqrt(radius2));
+
+	// The cone. The degenerate triangles have zero normals and they are
+	// not drawn anyway
+	Vec3 axis(0.0);
+	for(U i = 0; i < trisCount; i++)
+	{
+		axis += normals[tris[i]];
+	}
+
+	F32 minCos = -1.0;
+	F32 length = axis.getLength();
+	if(length > getEpsilon<F32>())
+	{
+		axis /= length;
+
+		minCos = 1.0;
+		for(U i = 0; i < trisCount; i++)
+		{
+			const Vec3& n = normals[tris[i]];
+			if(n != Vec3(0.0))
+			{
+				minCos = std::min(minCos, n.dot(axis));
+			}
+		}
+	}
+
+	F32 cutoff = (minCos > MIN_CONE_COS) 
+		? sqrt(1.0 - minCos * minCos) 
+		: 1.0;
+	cluster.m_cone = Vec4(axis, cutoff);
+}
+
+//==============================================================================
+/// The scalar version of the culling
+static Bool isVisible(const MeshCluster& cluster, const Plane* planes,
+	U planesCount, const Vec4* eye)
+{
+	Vec4 center = cluster.m_sphere.xyz0();
+	F32 radius = cluster.m_sphere.w();
+
+	for(U i = 0; i < planesCount; i++)
+	{
+		if(planes[i].test(center) < -radius)
+		{
+			return false;
+		}
+	}
+
+	if(eye)
+	{
+		// All the triangles face away if the direction to the sphere is
+		// inside the cone mirrored
+		Vec4 dir = center - eye->xyz0();
+		F32 d = dir.dot(cluster.m_cone.xyz0()) - radius;
+		F32 cutoff = cluster.m_cone.w();
+
+		if(d > 0.0 && d * d > cutoff * cutoff * dir.getLengthSquared())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+
+static_assert(sizeof(Vec4) == 4 * sizeof(F32), "Vec4 should be packed");
+
+//==============================================================================
+static inline const F32* getFloats(const Vec4& v)
+{
+	return reinterpret_cast<const F32*>(&v);
+}
+
+#endif
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+
+typedef __m128 F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return _mm_set1_ps(x);
+}
+
+//==============================================================================
+static inline void loadTransposed(const Vec4& a, const Vec4& b,
+	const Vec4& c, const Vec4& d, F32x4 out[4])
+{
+	out[0] = _mm_loadu_ps(getFloats(a));
+	out[1] = _mm_loadu_ps(getFloats(b));
+	out[2] = _mm_loadu_ps(getFloats(c));
+	out[3] = _mm_loadu_ps(getFloats(d));
+	_MM_TRANSPOSE4_PS(out[0], out[1], out[2], out[3]);
+}
+
+//==============================================================================
+/// a < b
+static inline F32x4 less(F32x4 a, F32x4 b)
+{
+	return _mm_cmplt_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 maskOr(F32x4 a, F32x4 b)
+{
+	return _mm_or_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 maskAnd(F32x4 a, F32x4 b)
+{
+	return _mm_and_ps(a, b);
+}
+
+//==============================================================================
+/// One bit for every lane
+static inline U getBits(F32x4 mask)
+{
+	return _mm_movemask_ps(mask);
+}
+
+#elif ANKI_SIMD == ANKI_SIMD_NEON
+
+typedef float32x4_t F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return vdupq_n_f32(x);
+}
+
+//==============================================================================
+static inline void loadTransposed(const Vec4& a, const Vec4& b,
+	const Vec4& c, const Vec4& d, F32x4 out[4])
+{
+	float32x4x2_t ab =
+		vtrnq_f32(vld1q_f32(getFloats(a)), vld1q_f32(getFloats(b)));
+	float32x4x2_t cd =
+		vtrnq_f32(vld1q_f32(getFloats(c)), vld1q_f32(getFloats(d)));
+	out[0] = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	out[1] = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	out[2] =
+		vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	out[3] =
+		vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+//==============================================================================
+/// a < b
+static inline F32x4 less(F32x4 a, F32x4 b)
+{
+	return vreinterpretq_f32_u32(vcltq_f32(a, b));
+}
+
+//==============================================================================
+static inline F32x4 maskOr(F32x4 a, F32x4 b)
+{
+	return vreinterpretq_f32_u32(
+		vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+//==============================================================================
+static inline F32x4 maskAnd(F32x4 a, F32x4 b)
+{
+	return vreinterpretq_f32_u32(
+		vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+//==============================================================================
+/// One bit for every lane
+static inline U getBits(F32x4 mask)
+{
+	uint32x4_t m = vreinterpretq_u32_f32(mask);
+	return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2)
+		| (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8);
+}
+
+#endif
+
+//==============================================================================
+// Building                                                                    =
+//==============================================================================
+
+//==============================================================================
+void buildMeshClusters(TempResourceAllocator<U8>& alloc,
+	const Vec3* positions, U32 positionsCount, U16* indices,
+	U32 indicesCount, TempResourceVector<MeshCluster>& clusters)
+{
+	ANKI_ASSERT(positions && indices && indicesCount % 3 == 0);
+	U32 trisCount = indicesCount / 3;
+
+	// The unit normals and the centers of the triangles
+	TempResourceVector<Vec3> normals(trisCount, Vec3(0.0), alloc);
+	TempResourceVector<Vec3> centers(trisCount, Vec3(0.0), alloc);
+	for(U32 t = 0; t < trisCount; t++)
+	{
+		const Vec3& a = positions[indices[t * 3]];
+		const Vec3& b = positions[indices[t * 3 + 1]];
+		const Vec3& c = positions[indices[t * 3 + 2]];
+
+		Vec3 n = (b - a).cross(c - a);
+		F32 length = n.getLength();
+		if(length > getEpsilon<F32>())
+		{
+			normals[t] = n / length;
+		}
+
+		centers[t] = (a + b + c) / 3.0;
+	}
+
+	// The triangles of every vertex. The ones of the vertex i are from
+	// vertTrisOffsets[i] to vertTrisOffsets[i + 1]
+	TempResourceVector<U32> vertTrisOffsets(positionsCount + 1, 0, alloc);
+	for(U32 i = 0; i < indicesCount; i++)
+	{
+		ANKI_ASSERT(indices[i] < positionsCount);
+		++vertTrisOffsets[indices[i] + 1];
+	}
+
+	for(U32 i = 0; i < positionsCount; i++)
+	{
+		vertTrisOffsets[i + 1] += vertTrisOffsets[i];
+	}
+
+	TempResourceVector<U32> vertTris(indicesCount, 0, alloc);
+	{
+		TempResourceVector<U32> crnt(vertTrisOffsets.begin(),
+			vertTrisOffsets.end() - 1, alloc);
+		for(U32 i = 0; i < indicesCount; i++)
+		{
+			vertTris[crnt[indices[i]]++] = i / 3;
+		}
+	}
+
+	// Grow the clusters. A cluster takes the neighbour that is the closest
+	// to its center and the closest to its normal. The next starts from
+	// the neighbours of the last so the consecutive clusters are neighbours
+	// as well
+	TempResourceVector<U8> assigned(trisCount, 0, alloc);
+	TempResourceVector<U16> newIndices(alloc);
+	newIndices.reserve(indicesCount);
+	TempResourceVector<U32> clusterTris(alloc);
+	TempResourceVector<U32> candidates(alloc);
+	U32 firstFree = 0;
+	U32 seed = MAX_U32;
+
+	while(newIndices.size() < indicesCount)
+	{
+		if(seed == MAX_U32)
+		{
+			while(assigned[firstFree])
+			{
+				++firstFree;
+			}
+			seed = firstFree;
+		}
+
+		clusterTris.clear();
+		candidates.clear();
+		Vec3 centerSum(0.0);
+		Vec3 normalSum(0.0);
+
+		auto add = [&](U32 t)
+		{
+			assigned[t] = 1;
+			clusterTris.push_back(t);
+			centerSum += centers[t];
+			normalSum += normals[t];
+
+			for(U j = 0; j < 3; j++)
+			{
+				U16 v = indices[t * 3 + j];
+				newIndices.push_back(v);
+
+				for(U32 k = vertTrisOffsets[v]; k < vertTrisOffsets[v + 1];
+					k++)
+				{
+					if(!assigned[vertTris[k]])
+					{
+						candidates.push_back(vertTris[k]);
+					}
+				}
+			}
+		};
+
+		add(seed);
+
+		while(clusterTris.size() < MeshCluster::MAX_TRIANGLES)
+		{
+			// Drop the ones that were taken
+			candidates.erase(
+				std::remove_if(candidates.begin(), candidates.end(),
+				[&](U32 t) -> Bool
+				{
+					return assigned[t];
+				}),
+				candidates.end());
+
+			if(candidates.size() == 0)
+			{
+				break;
+			}
+
+			Vec3 center = centerSum / F32(clusterTris.size());
+			Vec3 axis = normalSum;
+			F32 length = axis.getLength();
+			if(length > getEpsilon<F32>())
+			{
+				axis /= length;
+			}
+
+			U32 best = candidates[0];
+			F32 bestScore = MAX_F32;
+			for(U32 t : candidates)
+			{
+				F32 score = (centers[t] - center).getLength()
+					* (2.0 - normals[t].dot(axis));
+				if(score < bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+
+			add(best);
+		}
+
+		// The next starts where this stopped
+		seed = MAX_U32;
+		for(U32 t : candidates)
+		{
+			if(!assigned[t])
+			{
+				seed = t;
+				break;
+			}
+		}
+
+		// Emit the cluster
+		MeshCluster cluster;
+		cluster.m_indicesCount = clusterTris.size() * 3;
+		cluster.m_firstIndex = newIndices.size() - cluster.m_indicesCount;
+		computeBounds(positions, indices, &normals[0], &clusterTris[0],
+			clusterTris.size(), cluster);
+
+		clusters.push_back(cluster);
+	}
+
+	std::copy(newIndices.begin(), newIndices.end(), indices);
+}
+
+//==============================================================================
+// Culling                                                                     =
+//==============================================================================
+
+//==============================================================================
+U32 cullMeshClusters(const MeshCluster* clusters, U32 count,
+	const Plane* planes, U planesCount, const Vec4* eye, U32* visible)
+{
+	ANKI_ASSERT(clusters && visible);
+	U32 visibleCount = 0;
+	U32 i = 0;
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	for(; i + 4 <= count; i += 4)
+	{
+		const MeshCluster* c = &clusters[i];
+
+		// The spheres of the 4 clusters
+		F32x4 s[4];
+		loadTransposed(c[0].m_sphere, c[1].m_sphere, c[2].m_sphere,
+			c[3].m_sphere, s);
+		F32x4 minusRadius = splat(0.0) - s[3];
+
+		F32x4 culled = splat(0.0);
+		for(U p = 0; p < planesCount; p++)
+		{
+			const Vec4& n = planes[p].getNormal();
+			F32x4 dist = s[0] * splat(n.x()) + s[1] * splat(n.y())
+				+ s[2] * splat(n.z()) - splat(planes[p].getOffset());
+
+			culled = maskOr(culled, less(dist, minusRadius));
+		}
+
+		if(eye)
+		{
+			F32x4 cones[4];
+			loadTransposed(c[0].m_cone, c[1].m_cone, c[2].m_cone,
+				c[3].m_cone, cones);
+
+			F32x4 dx = s[0] - splat(eye->x());
+			F32x4 dy = s[1] - splat(eye->y());
+			F32x4 dz = s[2] - splat(eye->z());
+
+			// See isVisible
+			F32x4 d = dx * cones[0] + dy * cones[1] + dz * cones[2] - s[3];
+			F32x4 cutoff2 = cones[3] * cones[3];
+			F32x4 length2 = dx * dx + dy * dy + dz * dz;
+
+			F32x4 back = maskAnd(less(splat(0.0), d),
+				less(cutoff2 * length2, d * d));
+			culled = maskOr(culled, back);
+		}
+
+		U bits = getBits(culled);
+		for(U j = 0; j < 4; j++)
+		{
+			if(!(bits & (1 << j)))
+			{
+				visible[visibleCount++] = i + j;
+			}
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		if(isVisible(clusters[i], planes, planesCount, eye))
+		{
+			visible[visibleCount++] = i;
+		}
+	}
+
+	return visibleCount;
+}
+
+} // end namespace anki
@@ -49,6 +49,32 @@ using FixNormalsMap = std::unordered_map<
 	Vec3, MapValue, Hasher, Equal, 
 	TempResourceAllocator<std::pair<Vec3, MapValue>>>;
 
+/// Convert the F32 vectors to F16 vectors. In one go if the vectors are packed
+template<typename TVecArray, typename THVecArray>
+static void compressVectors(const TVecArray& in, THVecArray& out)
+{
+	using TVec = typename TVecArray::value_type;
+	using THVec = typename THVecArray::value_type;
+	const U size = TVec::SIZE;
+	static_assert(sizeof(TVec) == size * sizeof(F32), "Should be packed");
+
+	out.resize(in.size());
+	if(in.size() > 0 && sizeof(THVec) == size * sizeof(F16))
+	{
+		toF16(reinterpret_cast<const F32*>(&in[0]), 
+			reinterpret_cast<F16*>(&out[0]), in.size() * size);
+	}
+	else
+	{
+		// The half vectors are padded (HVec4)
+		for(PtrSize i = 0; i < in.size(); i++)
+		{
+			toF16(reinterpret_cast<const F32*>(&in[i]), 
+				reinterpret_cast<F16*>(&out[i]), size);
+		}
+	}
+}
+
 //==============================================================================
 // MeshLoader                                                                  =
 //==============================================================================
@@ -64,7 +90,8 @@ MeshLoader::MeshLoader(TempResourceAllocator<U8>& alloc)
 	m_texCoordsF16(alloc),
 	m_weights(alloc),
 	m_tris(alloc),
-	m_vertIndices(alloc)
+	m_vertIndices(alloc),
+	m_clusters(alloc)
 {}
 
 //==============================================================================
@@ -223,6 +250,7 @@ void MeshLoader::doPostLoad()
 	}
 
 	createVertIndeces();
+	createClusters();
 	compressBuffers();
 }
 
@@ -241,6 +269,21 @@ void MeshLoader::createVertIndeces()
 	}
 }
 
+//==============================================================================
+void MeshLoader::createClusters()
+{
+	m_clusters.clear();
+
+	if(m_tris.size() < MeshCluster::MIN_MESH_TRIANGLES)
+	{
+		return;
+	}
+
+	TempResourceAllocator<U8> alloc = m_clusters.get_allocator();
+	buildMeshClusters(alloc, &m_positions[0], m_positions.size(),
+		&m_vertIndices[0], m_vertIndices.size(), m_clusters);
+}
+
 //==============================================================================
 void MeshLoader::createFaceNormals()
 {
@@ -457,6 +500,8 @@ void MeshLoader::append(const MeshLoader& other)
 	{
 		m_vertIndices.push_back(bias + index);
 	}
+
+	m_clusters.clear();
 }
 
 //==============================================================================
@@ -464,38 +509,9 @@ void MeshLoader::compressBuffers()
 {
 	ANKI_ASSERT(m_positions.size() > 0);
 
-	// Normals
-	m_normalsF16.resize(m_normals.size());
-
-	for(U i = 0; i < m_normals.size(); i++)
-	{
-		for(U j = 0; j < 3; j++)
-		{
-			m_normalsF16[i][j] = F16(m_normals[i][j]);
-		}
-	}
-
-	// Tangents
-	m_tangentsF16.resize(m_tangents.size());
-
-	for(U i = 0; i < m_tangents.size(); i++)
-	{
-		for(U j = 0; j < 4; j++)
-		{
-			m_tangentsF16[i][j] = F16(m_tangents[i][j]);
-		}
-	}
-
-	// Texture coords
-	m_texCoordsF16.resize(m_texCoords.size());	
-
-	for(U i = 0; i < m_texCoords.size(); i++)
-	{
-		for(U j = 0; j < 2; j++)
-		{
-			m_texCoordsF16[i][j] = F16(m_texCoords[i][j]);
-		}
-	}
+	compressVectors(m_normals, m_normalsF16);
+	compressVectors(m_tangents, m_tangentsF16);
+	compressVectors(m_texCoords, m_texCoordsF16);
 }
 
 } // end namespace anki
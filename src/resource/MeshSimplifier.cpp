@@ -0,0 +1,565 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/MeshSimplifier.h"
+#include <cmath>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The weight of the planes that keep the borders in place
+static const F64 BORDER_WEIGHT = 10.0;
+
+/// Reject the collapses that turn a triangle more than that. The cosine of
+/// the angle
+static const F32 MIN_NORMAL_DOT = 0.2;
+
+/// The cheapest on the top of the heap
+static Bool heapLess(F64 errorA, F64 errorB)
+{
+	return errorA > errorB;
+}
+
+//==============================================================================
+static U64 edgeKey(U32 a, U32 b)
+{
+	return (a < b)
+		? ((U64(a) << 32) | U64(b))
+		: ((U64(b) << 32) | U64(a));
+}
+
+//==============================================================================
+// MeshSimplifier::Quadric                                                     =
+//==============================================================================
+
+//==============================================================================
+void MeshSimplifier::Quadric::addPlane(F64 a, F64 b, F64 c, F64 d,
+	F64 weight)
+{
+	m_m[0] += a * a * weight;
+	m_m[1] += a * b * weight;
+	m_m[2] += a * c * weight;
+	m_m[3] += a * d * weight;
+	m_m[4] += b * b * weight;
+	m_m[5] += b * c * weight;
+	m_m[6] += b * d * weight;
+	m_m[7] += c * c * weight;
+	m_m[8] += c * d * weight;
+	m_m[9] += d * d * weight;
+	m_weight += weight;
+}
+
+//==============================================================================
+F64 MeshSimplifier::Quadric::evaluate(const Vec3& p) const
+{
+	F64 x = p.x();
+	F64 y = p.y();
+	F64 z = p.z();
+
+	F64 err = m_m[0] * x * x + 2.0 * m_m[1] * x * y + 2.0 * m_m[2] * x * z
+		+ 2.0 * m_m[3] * x + m_m[4] * y * y + 2.0 * m_m[5] * y * z
+		+ 2.0 * m_m[6] * y + m_m[7] * z * z + 2.0 * m_m[8] * z + m_m[9];
+
+	// The mean of the planes so it's a squared distance. Clamp for the 
+	// precision
+	return (m_weight > 0.0) ? std::max(err / m_weight, 0.0) : 0.0;
+}
+
+//==============================================================================
+// MeshSimplifier                                                              =
+//==============================================================================
+
+//==============================================================================
+MeshSimplifier::MeshSimplifier(ResourceAllocator<U8>& alloc,
+	const Vec3* positions, U32 vertsCount, const U32* indices,
+	U32 indicesCount)
+:	m_alloc(alloc),
+	m_positions(positions),
+	m_vertsCount(vertsCount),
+	m_indices(indices, indices + indicesCount, alloc),
+	m_quadrics(vertsCount, Quadric(), alloc),
+	m_vertTris(vertsCount, ResourceVector<U32>(alloc), alloc),
+	m_versions(vertsCount, 0, alloc),
+	m_kinds(vertsCount, VertexKind::MANIFOLD, alloc),
+	m_heap(alloc)
+{
+	ANKI_ASSERT(positions && indices && indicesCount % 3 == 0);
+
+	U32 trisCount = indicesCount / 3;
+	for(U32 tri = 0; tri < trisCount; tri++)
+	{
+		U32* idx = &m_indices[tri * 3];
+		ANKI_ASSERT(idx[0] < vertsCount && idx[1] < vertsCount
+			&& idx[2] < vertsCount);
+
+		// Drop the degenerate
+		if(idx[0] == idx[1] || idx[1] == idx[2] || idx[2] == idx[0])
+		{
+			idx[0] = MAX_U32;
+			continue;
+		}
+
+		++m_trisCount;
+		for(U i = 0; i < 3; i++)
+		{
+			m_vertTris[idx[i]].push_back(tri);
+		}
+
+		// The plane of the triangle weighted by its area
+		const Vec3& p0 = positions[idx[0]];
+		Vec3 n = (positions[idx[1]] - p0).cross(positions[idx[2]] - p0);
+		F32 len = n.getLength();
+		if(len == 0.0)
+		{
+			continue;
+		}
+
+		n /= len;
+		F64 d = -n.dot(p0);
+		for(U i = 0; i < 3; i++)
+		{
+			m_quadrics[idx[i]].addPlane(n.x(), n.y(), n.z(), d, len * 0.5);
+		}
+	}
+
+	initBorders();
+	rebuildHeap();
+}
+
+//==============================================================================
+MeshSimplifier::~MeshSimplifier()
+{}
+
+//==============================================================================
+void MeshSimplifier::initBorders()
+{
+	// The open edges are in one triangle only
+	ResourceVector<U64> edges(m_alloc);
+	edges.reserve(m_trisCount * 3);
+	for(U32 tri = 0; tri < m_indices.size() / 3; tri++)
+	{
+		if(!isAlive(tri))
+		{
+			continue;
+		}
+
+		const U32* idx = &m_indices[tri * 3];
+		for(U i = 0; i < 3; i++)
+		{
+			edges.push_back(edgeKey(idx[i], idx[(i + 1) % 3]));
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	ResourceVector<U8> borderEdgesCount(m_vertsCount, 0, m_alloc);
+	for(U i = 0; i < edges.size(); i++)
+	{
+		if((i > 0 && edges[i - 1] == edges[i])
+			|| (i + 1 < edges.size() && edges[i + 1] == edges[i]))
+		{
+			continue;
+		}
+
+		U32 a = edges[i] >> 32;
+		U32 b = edges[i] & MAX_U32;
+		borderEdgesCount[a] = std::min(borderEdgesCount[a] + 1, 0xFF);
+		borderEdgesCount[b] = std::min(borderEdgesCount[b] + 1, 0xFF);
+
+		// A plane that is perpendicular to the triangle keeps the edge
+		U32 tri = MAX_U32;
+		for(U32 t : m_vertTris[a])
+		{
+			if(triHasVertex(t, b))
+			{
+				tri = t;
+				break;
+			}
+		}
+		ANKI_ASSERT(tri != MAX_U32);
+
+		const U32* idx = &m_indices[tri * 3];
+		const Vec3& p0 = m_positions[idx[0]];
+		Vec3 triN = (m_positions[idx[1]] - p0).cross(m_positions[idx[2]] - p0);
+		Vec3 edge = m_positions[b] - m_positions[a];
+		Vec3 n = edge.cross(triN);
+		F32 len = n.getLength();
+		if(len == 0.0)
+		{
+			continue;
+		}
+
+		n /= len;
+		F64 d = -n.dot(m_positions[a]);
+		F64 weight = BORDER_WEIGHT * edge.getLengthSquared();
+		m_quadrics[a].addPlane(n.x(), n.y(), n.z(), d, weight);
+		m_quadrics[b].addPlane(n.x(), n.y(), n.z(), d, weight);
+	}
+
+	for(U32 v = 0; v < m_vertsCount; v++)
+	{
+		if(borderEdgesCount[v] == 2)
+		{
+			m_kinds[v] = VertexKind::BORDER;
+		}
+		else if(borderEdgesCount[v] > 0)
+		{
+			m_kinds[v] = VertexKind::LOCKED;
+		}
+	}
+
+	// The vertices with the same position are split because of their
+	// attributes. Moving one would open a crack
+	ResourceVector<U32> sorted(m_alloc);
+	sorted.reserve(m_vertsCount);
+	for(U32 v = 0; v < m_vertsCount; v++)
+	{
+		sorted.push_back(v);
+	}
+
+	auto posLess = [&](U32 a, U32 b) -> Bool
+	{
+		const Vec3& pa = m_positions[a];
+		const Vec3& pb = m_positions[b];
+		if(pa.x() != pb.x())
+		{
+			return pa.x() < pb.x();
+		}
+		else if(pa.y() != pb.y())
+		{
+			return pa.y() < pb.y();
+		}
+
+		return pa.z() < pb.z();
+	};
+
+	std::sort(sorted.begin(), sorted.end(), posLess);
+	for(U i = 1; i < sorted.size(); i++)
+	{
+		if(m_positions[sorted[i - 1]] == m_positions[sorted[i]])
+		{
+			m_kinds[sorted[i - 1]] = VertexKind::LOCKED;
+			m_kinds[sorted[i]] = VertexKind::LOCKED;
+		}
+	}
+}
+
+//==============================================================================
+Bool MeshSimplifier::triHasVertex(U32 tri, U32 vert) const
+{
+	const U32* idx = &m_indices[tri * 3];
+	return idx[0] == vert || idx[1] == vert || idx[2] == vert;
+}
+
+//==============================================================================
+void MeshSimplifier::getNeighbours(U32 vert,
+	ResourceVector<U32>& neighbours) const
+{
+	neighbours.clear();
+	for(U32 tri : m_vertTris[vert])
+	{
+		if(!isAlive(tri))
+		{
+			continue;
+		}
+
+		const U32* idx = &m_indices[tri * 3];
+		for(U i = 0; i < 3; i++)
+		{
+			if(idx[i] != vert && std::find(neighbours.begin(),
+				neighbours.end(), idx[i]) == neighbours.end())
+			{
+				neighbours.push_back(idx[i]);
+			}
+		}
+	}
+}
+
+//==============================================================================
+U MeshSimplifier::countEdgeTris(U32 a, U32 b) const
+{
+	U count = 0;
+	for(U32 tri : m_vertTris[a])
+	{
+		if(isAlive(tri) && triHasVertex(tri, b))
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+//==============================================================================
+void MeshSimplifier::pushCollapse(U32 from, U32 to)
+{
+	VertexKind kind = m_kinds[from];
+	if(kind == VertexKind::LOCKED
+		|| (kind == VertexKind::BORDER && countEdgeTris(from, to) != 1))
+	{
+		return;
+	}
+
+	Quadric q = m_quadrics[from];
+	q += m_quadrics[to];
+
+	m_heap.push_back(Collapse{q.evaluate(m_positions[to]), from, to,
+		m_versions[from], m_versions[to]});
+	std::push_heap(m_heap.begin(), m_heap.end(),
+		[](const Collapse& a, const Collapse& b) -> Bool
+	{
+		return heapLess(a.m_error, b.m_error);
+	});
+}
+
+//==============================================================================
+void MeshSimplifier::pushCollapses(U32 vert)
+{
+	ResourceVector<U32> neighbours(m_alloc);
+	getNeighbours(vert, neighbours);
+
+	for(U32 n : neighbours)
+	{
+		pushCollapse(vert, n);
+		pushCollapse(n, vert);
+	}
+}
+
+//==============================================================================
+void MeshSimplifier::rebuildHeap()
+{
+	m_heap.clear();
+
+	ResourceVector<U32> neighbours(m_alloc);
+	for(U32 v = 0; v < m_vertsCount; v++)
+	{
+		getNeighbours(v, neighbours);
+		for(U32 n : neighbours)
+		{
+			pushCollapse(v, n);
+		}
+	}
+
+	m_collapsedSinceRebuild = false;
+}
+
+//==============================================================================
+Bool MeshSimplifier::canCollapse(U32 from, U32 to) const
+{
+	// The vertices that both see should be the ones of the triangles of the
+	// edge. If not the mesh will fold
+	ResourceVector<U32> fromNeighbours(m_alloc);
+	ResourceVector<U32> toNeighbours(m_alloc);
+	getNeighbours(from, fromNeighbours);
+	getNeighbours(to, toNeighbours);
+
+	U common = 0;
+	for(U32 n : fromNeighbours)
+	{
+		if(std::find(toNeighbours.begin(), toNeighbours.end(), n)
+			!= toNeighbours.end())
+		{
+			++common;
+		}
+	}
+
+	if(common != countEdgeTris(from, to))
+	{
+		return false;
+	}
+
+	// The triangles that move shouldn't flip or become thin
+	const Vec3& newPos = m_positions[to];
+	for(U32 tri : m_vertTris[from])
+	{
+		if(!isAlive(tri) || triHasVertex(tri, to))
+		{
+			continue;
+		}
+
+		const U32* idx = &m_indices[tri * 3];
+		Array<Vec3, 3> p;
+		for(U i = 0; i < 3; i++)
+		{
+			p[i] = m_positions[idx[i]];
+		}
+
+		Vec3 oldN = (p[1] - p[0]).cross(p[2] - p[0]);
+
+		for(U i = 0; i < 3; i++)
+		{
+			if(idx[i] == from)
+			{
+				p[i] = newPos;
+			}
+		}
+
+		Vec3 newN = (p[1] - p[0]).cross(p[2] - p[0]);
+
+		F32 oldLen = oldN.getLength();
+		F32 newLen = newN.getLength();
+		if(newLen == 0.0 || oldLen == 0.0)
+		{
+			return false;
+		}
+
+		if(oldN.dot(newN) < MIN_NORMAL_DOT * oldLen * newLen)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//==============================================================================
+void MeshSimplifier::collapse(const Collapse& c)
+{
+	U32 from = c.m_from;
+	U32 to = c.m_to;
+
+	ResourceVector<U32>& toTris = m_vertTris[to];
+
+	for(U32 tri : m_vertTris[from])
+	{
+		if(!isAlive(tri))
+		{
+			continue;
+		}
+
+		U32* idx = &m_indices[tri * 3];
+		if(triHasVertex(tri, to))
+		{
+			idx[0] = MAX_U32;
+			--m_trisCount;
+			continue;
+		}
+
+		for(U i = 0; i < 3; i++)
+		{
+			if(idx[i] == from)
+			{
+				idx[i] = to;
+			}
+		}
+
+		toTris.push_back(tri);
+	}
+
+	// Forget the removed
+	toTris.erase(std::remove_if(toTris.begin(), toTris.end(),
+		[&](U32 tri) -> Bool
+	{
+		return !isAlive(tri);
+	}), toTris.end());
+
+	m_vertTris[from].clear();
+	m_quadrics[to] += m_quadrics[from];
+	m_kinds[from] = VertexKind::LOCKED;
+	++m_versions[from];
+	++m_versions[to];
+	m_error = std::max(m_error, c.m_error);
+	m_collapsedSinceRebuild = true;
+
+	pushCollapses(to);
+}
+
+//==============================================================================
+U32 MeshSimplifier::simplify(U32 targetIndicesCount, F32 maxError)
+{
+	F64 maxErrorSq = F64(maxError) * F64(maxError);
+	auto less = [](const Collapse& a, const Collapse& b) -> Bool
+	{
+		return heapLess(a.m_error, b.m_error);
+	};
+
+	while(m_trisCount * 3 > targetIndicesCount)
+	{
+		if(m_heap.size() == 0)
+		{
+			// The collapses that were rejected may work now
+			if(!m_collapsedSinceRebuild)
+			{
+				break;
+			}
+
+			rebuildHeap();
+			continue;
+		}
+
+		std::pop_heap(m_heap.begin(), m_heap.end(), less);
+		Collapse c = m_heap.back();
+		m_heap.pop_back();
+
+		if(c.m_fromVersion != m_versions[c.m_from]
+			|| c.m_toVersion != m_versions[c.m_to])
+		{
+			continue;
+		}
+
+		if(c.m_error > maxErrorSq)
+		{
+			// It's the cheapest. Keep it for the next call
+			m_heap.push_back(c);
+			std::push_heap(m_heap.begin(), m_heap.end(), less);
+			break;
+		}
+
+		if(canCollapse(c.m_from, c.m_to))
+		{
+			collapse(c);
+		}
+	}
+
+	return getIndicesCount();
+}
+
+//==============================================================================
+void MeshSimplifier::getIndices(ResourceVector<U32>& indices) const
+{
+	indices.clear();
+	indices.reserve(getIndicesCount());
+
+	for(U32 tri = 0; tri < m_indices.size() / 3; tri++)
+	{
+		if(isAlive(tri))
+		{
+			indices.insert(indices.end(), &m_indices[tri * 3],
+				&m_indices[tri * 3] + 3);
+		}
+	}
+}
+
+//==============================================================================
+F32 MeshSimplifier::getError() const
+{
+	return std::sqrt(m_error);
+}
+
+//==============================================================================
+void MeshSimplifier::compactVertices(ResourceVector<U32>& indices,
+	U32 vertsCount, ResourceVector<U32>& remap)
+{
+	ResourceVector<U32> newIndices(vertsCount, MAX_U32,
+		indices.get_allocator());
+	remap.clear();
+
+	for(U32& idx : indices)
+	{
+		ANKI_ASSERT(idx < vertsCount);
+		if(newIndices[idx] == MAX_U32)
+		{
+			newIndices[idx] = remap.size();
+			remap.push_back(idx);
+		}
+
+		idx = newIndices[idx];
+	}
+}
+
+} // end namespace anki
@@ -6,6 +6,7 @@
 #include "anki/resource/Model.h"
 #include "anki/resource/Material.h"
 #include "anki/resource/Mesh.h"
+#include "anki/resource/MeshLoader.h"
 #include "anki/resource/ProgramResource.h"
 #include "anki/misc/Xml.h"
 #include "anki/core/Logger.h"
@@ -39,7 +40,9 @@ static const Array<Attrib, static_cast<U>(VertexAttribute::COUNT) - 1>
 void ModelPatchBase::createVertexDesc(
 	const GlProgramHandle& prog,
 	const Mesh& mesh,
-	GlCommandBufferHandle& vertexJobs)
+	GlCommandBufferHandle& vertexJobs,
+	const GlBufferHandle* vertBuff,
+	const GlBufferHandle* indicesBuff)
 {
 	GlBufferHandle vbo;
 	U32 size;
@@ -68,6 +71,11 @@ void ModelPatchBase::createVertexDesc(
 			throw ANKI_EXCEPTION("Material asks for attribute that the mesh "
 				"does not have: %s", attrib.m_name);
 		}
+
+		if(vertBuff)
+		{
+			vbo = *vertBuff;
+		}
 		
 		vbo.bindVertexBuffer(vertexJobs, size, type, false, stride,
 			offset, static_cast<U>(attrib.m_location));
@@ -84,6 +92,11 @@ void ModelPatchBase::createVertexDesc(
 	mesh.getBufferInfo(VertexAttribute::INDICES, vbo, size, type,
 			stride, offset);
 
+	if(indicesBuff)
+	{
+		vbo = *indicesBuff;
+	}
+
 	ANKI_ASSERT(vbo.isCreated());
 	vbo.bindIndexBuffer(vertexJobs);
 }
@@ -161,7 +174,8 @@ void ModelPatchBase::getRenderingDataSub(
 }
 
 //==============================================================================
-void ModelPatchBase::create(GlDevice* gl)
+void ModelPatchBase::create(GlDevice* gl, const F32* lodErrors, 
+	U lodErrorsCount)
 {
 	const Material& mtl = getMaterial();
 	U lodsCount = getLodsCount();
@@ -175,22 +189,7 @@ void ModelPatchBase::create(GlDevice* gl)
 			RenderingKey key((Pass)pass, lod, false);
 			GlProgramHandle prog;
 			const Mesh* mesh;
-
-			// Get mesh
-			ANKI_ASSERT(getMeshesCount() > 0);
-			RenderingKey meshKey = key;
-			meshKey.m_lod = std::min(key.m_lod, (U8)(getMeshesCount() - 1));
-			mesh = &getMesh(meshKey);
-
-			// Get shader prog
-			ANKI_ASSERT(getMaterial().getLevelsOfDetail() > 0);
-			RenderingKey shaderKey = key;
-			shaderKey.m_lod = std::min(key.m_lod, 
-				(U8)(getMaterial().getLevelsOfDetail() - 1));
-
-			GlProgramPipelineHandle ppline =
-				m_mtl->getProgramPipeline(shaderKey);
-			prog = ppline.getAttachedProgram(GL_VERTEX_SHADER);
+			getMeshAndProgram(key, mesh, prog);
 			
 			// Create vert descriptor
 			GlCommandBufferHandle vertJobs(gl);
@@ -199,6 +198,67 @@ void ModelPatchBase::create(GlDevice* gl)
 			m_vertJobs[getVertexDescIdx(key)] = vertJobs;
 		}
 	}
+
+	// The errors of the LODs. Guess the missing ones from the size. Every
+	// LOD has about the quarter of the triangles of the previous so the
+	// error grows 4 times
+	m_lodErrors.resize(lodsCount);
+	m_lodErrors[0] = 0.0;
+	F32 radius = getBoundingShape().getExtend().xyz().getLength();
+	for(U lod = 1; lod < lodsCount; ++lod)
+	{
+		m_lodErrors[lod] = (lod <= lodErrorsCount) 
+			? lodErrors[lod - 1]
+			: radius * 0.01 * pow(4.0, F32(lod - 1));
+	}
+}
+
+//==============================================================================
+void ModelPatchBase::getMeshAndProgram(const RenderingKey& key, 
+	const Mesh*& mesh, GlProgramHandle& prog) const
+{
+	// Get mesh
+	ANKI_ASSERT(getMeshesCount() > 0);
+	RenderingKey meshKey = key;
+	meshKey.m_lod = std::min(key.m_lod, (U8)(getMeshesCount() - 1));
+	mesh = &getMesh(meshKey);
+
+	// Get shader prog
+	ANKI_ASSERT(getMaterial().getLevelsOfDetail() > 0);
+	RenderingKey shaderKey = key;
+	shaderKey.m_lod = std::min(key.m_lod, 
+		(U8)(getMaterial().getLevelsOfDetail() - 1));
+
+	GlProgramPipelineHandle ppline = m_mtl->getProgramPipeline(shaderKey);
+	prog = ppline.getAttachedProgram(GL_VERTEX_SHADER);
+}
+
+//==============================================================================
+void ModelPatchBase::createVertexDesc(
+	const RenderingKey& key,
+	const GlBufferHandle& vertBuff,
+	const GlBufferHandle& indicesBuff,
+	GlCommandBufferHandle& vertJobs) const
+{
+	GlProgramHandle prog;
+	const Mesh* mesh;
+	getMeshAndProgram(key, mesh, prog);
+
+	createVertexDesc(prog, *mesh, vertJobs, &vertBuff, &indicesBuff);
+}
+
+//==============================================================================
+void ModelPatchBase::loadOccluder(const CString& filename, 
+	ResourceManager& resources)
+{
+	MeshLoader loader(resources.fixResourceFilename(filename).toCString(),
+		resources._getTempAllocator());
+
+	const auto& positions = loader.getPositions();
+	const auto& indices = loader.getIndices();
+
+	m_occluder.m_positions.assign(positions.begin(), positions.end());
+	m_occluder.m_indices.assign(indices.begin(), indices.end());
 }
 
 //==============================================================================
@@ -233,6 +293,8 @@ ModelPatch<MeshResourcePointerType>::ModelPatch(
 	CString meshFNames[], 
 	U32 meshesCount, 
 	const CString& mtlFName,
+	const F32* lodErrors,
+	U32 lodErrorsCount,
 	ResourceManager* resources)
 :	ModelPatchBase(resources->_getAllocator()),
 	m_meshResources(resources->_getAllocator())
@@ -260,7 +322,7 @@ ModelPatch<MeshResourcePointerType>::ModelPatch(
 	m_mtl = m_mtlResource.get();
 
 	// Create VAOs
-	create(&resources->_getGlDevice());
+	create(&resources->_getGlDevice(), lodErrors, lodErrorsCount);
 }
 
 //==============================================================================
@@ -334,6 +396,22 @@ void Model::load(const CString& filename, ResourceInitializer& init)
 			U meshesCount = 1;
 			ModelPatchBase* patch;
 
+			// <lodErrors>
+			Array<F32, 2> lodErrors;
+			U lodErrorsCount = 0;
+			XmlElement lodErrorsEl = 
+				modelPatchEl.getChildElementOptional("lodErrors");
+			if(lodErrorsEl)
+			{
+				auto floats = lodErrorsEl.getFloats();
+				lodErrorsCount = 
+					std::min<U>(floats.size(), lodErrors.getSize());
+				for(U i = 0; i < lodErrorsCount; i++)
+				{
+					lodErrors[i] = floats[i];
+				}
+			}
+
 			// Try mesh
 			XmlElement meshEl = modelPatchEl.getChildElementOptional("mesh");
 			if(meshEl)
@@ -360,7 +438,7 @@ void Model::load(const CString& filename, ResourceInitializer& init)
 				patch = init.m_alloc.newInstance<
 					ModelPatch<MeshResourcePointer>>(
 					&meshesFnames[0], meshesCount, materialEl.getText(),
-					&init.m_resources);
+					&lodErrors[0], lodErrorsCount, &init.m_resources);
 			}
 			else
 			{
@@ -388,11 +466,19 @@ void Model::load(const CString& filename, ResourceInitializer& init)
 				patch = init.m_alloc.newInstance<
 					ModelPatch<BucketMeshResourcePointer>>(
 					&meshesFnames[0], meshesCount, materialEl.getText(),
-					&init.m_resources);
+					&lodErrors[0], lodErrorsCount, &init.m_resources);
 			}
 
 			m_modelPatches.push_back(patch);
 
+			// <occluder>
+			XmlElement occluderEl = 
+				modelPatchEl.getChildElementOptional("occluder");
+			if(occluderEl)
+			{
+				patch->loadOccluder(occluderEl.getText(), init.m_resources);
+			}
+
 			// Move to next
 			modelPatchEl = modelPatchEl.getNextSiblingElement("modelPatch");
 		} while(modelPatchEl);
@@ -13,9 +13,41 @@
 #include "anki/resource/TextureResource.h"
 #include "anki/core/Logger.h"
 #include "anki/misc/ConfigSet.h"
+#include <algorithm>
 
 namespace anki {
 
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// Change the resident mips of a streamed texture
+class TextureStreamTask: public AsyncLoaderTask
+{
+public:
+	TextureResource* m_texture;
+	U8 m_mip;
+
+	TextureStreamTask(TextureResource* texture, U mip)
+	:	m_texture(texture),
+		m_mip(mip)
+	{}
+
+	void operator()()
+	{
+		m_texture->_streamMips(m_mip);
+	}
+};
+
+//==============================================================================
+// ResourceManager                                                             =
+//==============================================================================
+
+//==============================================================================
+thread_local TempResourceAllocator<U8>* ResourceManager::m_threadTmpAlloc = 
+	nullptr;
+
 //==============================================================================
 ResourceManager::ResourceManager(Initializer& init)
 :	m_gl(init.m_gl),
@@ -23,8 +55,14 @@ ResourceManager::ResourceManager(Initializer& init)
 	m_tmpAlloc(StackMemoryPool(
 		init.m_allocCallback, init.m_allocCallbackData, 
 		init.m_tempAllocatorMemorySize)),
+	m_allocCb(init.m_allocCallback),
+	m_allocCbData(init.m_allocCallbackData),
+	m_tmpAllocSize(init.m_tempAllocatorMemorySize),
 	m_cacheDir(m_alloc),
-	m_dataDir(init.m_cacheDir, m_alloc)
+	m_dataDir(init.m_cacheDir, m_alloc),
+	m_asyncLoader(m_alloc),
+	m_streamActions(m_alloc),
+	m_streamedTextures(m_alloc)
 {
 	// Init the data path
 	//
@@ -49,6 +87,16 @@ ResourceManager::ResourceManager(Initializer& init)
 	m_maxTextureSize = init.m_config->get("maxTextureSize");
 	m_textureAnisotropy = init.m_config->get("textureAnisotropy");
 
+	m_textureStreamingTailSize = 
+		init.m_config->get("textureStreamingTailSize");
+	if(m_textureStreamingTailSize > 0)
+	{
+		m_textureResidency = m_alloc.newInstance<TextureResidencyManager>(
+			m_alloc, 
+			PtrSize(init.m_config->get("textureStreamingBudget")),
+			PtrSize(init.m_config->get("textureStreamingMaxLoadPerFrame")));
+	}
+
 	// Init type resource managers
 	//
 #define ANKI_RESOURCE(type_) \
@@ -67,11 +115,32 @@ ResourceManager::ResourceManager(Initializer& init)
 #undef ANKI_RESOURCE
 }
 
+//==============================================================================
+ResourceManager::~ResourceManager()
+{
+	// Finish the streaming before the residency manager goes
+	m_asyncLoader.flush();
+
+	if(m_textureResidency)
+	{
+		m_alloc.deleteInstance(m_textureResidency);
+	}
+}
+
+//==============================================================================
+TempResourceAllocator<U8> ResourceManager::_newTempAllocator() const
+{
+	return TempResourceAllocator<U8>(
+		StackMemoryPool(m_allocCb, m_allocCbData, m_tmpAllocSize));
+}
+
 //==============================================================================
 TempResourceString ResourceManager::fixResourceFilename(
 	const CString& filename) const
 {
-	TempResourceString newFname(m_tmpAlloc);
+	const TempResourceAllocator<U8>& tmpAlloc = 
+		(m_threadTmpAlloc) ? *m_threadTmpAlloc : m_tmpAlloc;
+	TempResourceString newFname(tmpAlloc);
 
 	// If the filename is in cache then dont append the data path
 	if(filename.find(m_cacheDir.toCString()) != TempResourceString::NPOS)
@@ -80,11 +149,100 @@ TempResourceString ResourceManager::fixResourceFilename(
 	}
 	else
 	{
-		newFname = TempResourceString(m_dataDir.toCString(), m_tmpAlloc) 
+		newFname = TempResourceString(m_dataDir.toCString(), tmpAlloc) 
 			+ filename;
 	}
 
 	return newFname;
 }
 
+//==============================================================================
+void ResourceManager::updateTextureStreaming()
+{
+	if(m_textureResidency == nullptr)
+	{
+		return;
+	}
+
+	m_streamActions.clear();
+	m_textureResidency->update(m_streamActions);
+
+	// The loads and the evictions both create a new GL texture
+	for(const TextureResidencyManager::Action& action : m_streamActions)
+	{
+		TextureResource* texture = 
+			reinterpret_cast<TextureResource*>(action.m_userData);
+
+		try
+		{
+			m_asyncLoader.newTask<TextureStreamTask>(texture, action.m_mip);
+		}
+		catch(const std::exception& e)
+		{
+			ANKI_LOGE("Failed to stream texture: %s", e.what());
+			m_textureResidency->actionDone(action.m_texture, false);
+		}
+	}
+}
+
+//==============================================================================
+void ResourceManager::commitTextureStreaming()
+{
+	LockGuard<Mutex> lock(m_streamMtx);
+
+	for(TextureResource* texture : m_streamedTextures)
+	{
+		texture->_commitStreamedTexture();
+	}
+
+	m_streamedTextures.clear();
+}
+
+//==============================================================================
+void ResourceManager::_textureStreamed(TextureResource& texture, 
+	const GlTextureHandle* tex)
+{
+	{
+		LockGuard<Mutex> lock(m_streamMtx);
+
+		if(tex)
+		{
+			texture._setStreamedTexture(*tex);
+
+			auto it = std::find(m_streamedTextures.begin(), 
+				m_streamedTextures.end(), &texture);
+			if(it == m_streamedTextures.end())
+			{
+				m_streamedTextures.push_back(&texture);
+			}
+		}
+
+		m_textureResidency->actionDone(
+			texture._getResidencyHandle(), tex != nullptr);
+	}
+
+	m_streamCondVar.notifyAll();
+}
+
+//==============================================================================
+void ResourceManager::_unregisterStreamedTexture(TextureResource& texture)
+{
+	LockGuard<Mutex> lock(m_streamMtx);
+
+	TextureResidencyManager::Handle handle = texture._getResidencyHandle();
+	while(m_textureResidency->isPending(handle))
+	{
+		m_streamCondVar.wait(m_streamMtx);
+	}
+
+	auto it = std::find(m_streamedTextures.begin(), m_streamedTextures.end(), 
+		&texture);
+	if(it != m_streamedTextures.end())
+	{
+		m_streamedTextures.erase(it);
+	}
+
+	m_textureResidency->unregisterTexture(handle);
+}
+
 } // end namespace anki
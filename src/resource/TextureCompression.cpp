@@ -0,0 +1,700 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/TextureCompression.h"
+#include "anki/Math.h"
+#include "anki/util/Array.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The steps of the linear to sRGB table. Enough to cover the darkest sRGB
+/// steps
+static const U LINEAR_STEPS = 16384;
+
+/// The sRGB to linear and back tables
+class GammaTables
+{
+public:
+	Array<F32, 256> m_toLinear;
+	Array<U8, LINEAR_STEPS> m_toSrgb;
+
+	GammaTables()
+	{
+		for(U i = 0; i < m_toLinear.size(); i++)
+		{
+			F32 c = F32(i) / 255.0;
+			m_toLinear[i] = (c <= 0.04045)
+				? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+		}
+
+		for(U i = 0; i < m_toSrgb.size(); i++)
+		{
+			F32 l = F32(i) / F32(LINEAR_STEPS - 1);
+			F32 c = (l <= 0.0031308)
+				? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+			m_toSrgb[i] = U8(c * 255.0 + 0.5);
+		}
+	}
+};
+
+static const GammaTables& getGammaTables()
+{
+	static const GammaTables tables;
+	return tables;
+}
+
+/// From [0.0, 1.0] to [0, 255]
+static U8 toUnorm8(F32 x)
+{
+	return U8(std::min(std::max(x, 0.0f), 1.0f) * 255.0 + 0.5);
+}
+
+/// Write a number as little endian
+template<typename T>
+static void writeLittleEndian(T x, U8* out)
+{
+	for(U i = 0; i < sizeof(T); i++)
+	{
+		out[i] = (x >> (i * 8)) & 0xff;
+	}
+}
+
+/// Write a number as big endian
+template<typename T>
+static void writeBigEndian(T x, U8* out)
+{
+	for(U i = 0; i < sizeof(T); i++)
+	{
+		out[i] = (x >> ((sizeof(T) - 1 - i) * 8)) & 0xff;
+	}
+}
+
+//==============================================================================
+// Mips                                                                        =
+//==============================================================================
+
+//==============================================================================
+void generateMipRows(const U8* in, U32 inWidth, U32 inHeight, Bool normal,
+	U32 rowBegin, U32 rowEnd, U8* out)
+{
+	ANKI_ASSERT(inWidth >= 2 && inHeight >= 2);
+	ANKI_ASSERT(rowEnd <= inHeight / 2);
+	const GammaTables& tables = getGammaTables();
+	const U32 outWidth = inWidth / 2;
+
+	for(U32 y = rowBegin; y < rowEnd; y++)
+	{
+		for(U32 x = 0; x < outWidth; x++)
+		{
+			// Sum the 2x2 texels
+			Vec4 sum(0.0);
+			U32 alphaSum = 0;
+			for(U j = 0; j < 2; j++)
+			{
+				const U8* row = in + ((y * 2 + j) * inWidth + x * 2) * 4;
+				for(U i = 0; i < 2; i++)
+				{
+					const U8* t = row + i * 4;
+					if(normal)
+					{
+						sum += Vec4(t[0], t[1], t[2], 0.0) * (1.0 / 127.5)
+							- Vec4(1.0, 1.0, 1.0, 0.0);
+					}
+					else
+					{
+						sum += Vec4(tables.m_toLinear[t[0]],
+							tables.m_toLinear[t[1]], tables.m_toLinear[t[2]],
+							0.0);
+					}
+
+					alphaSum += t[3];
+				}
+			}
+
+			U8* o = out + (y * outWidth + x) * 4;
+			Vec4 avg = sum * 0.25;
+			o[3] = (alphaSum + 2) / 4;
+
+			if(normal)
+			{
+				Vec3 n = avg.xyz();
+				F32 len = n.getLength();
+				n = (len > getEpsilon<F32>()) ? n / len : Vec3(0.0, 0.0, 1.0);
+				n = n * 0.5 + 0.5;
+
+				o[0] = toUnorm8(n.x());
+				o[1] = toUnorm8(n.y());
+				o[2] = toUnorm8(n.z());
+			}
+			else
+			{
+				for(U i = 0; i < 3; i++)
+				{
+					F32 l = std::min(std::max(avg[i], 0.0f), 1.0f);
+					o[i] = tables.m_toSrgb[U(l * (LINEAR_STEPS - 1) + 0.5)];
+				}
+			}
+		}
+	}
+}
+
+//==============================================================================
+// BC                                                                          =
+//==============================================================================
+
+/// The RGB of the texels of a block
+using BlockColors = Array<Vec4, 16>;
+
+//==============================================================================
+static U16 toRgb565(const Vec4& c)
+{
+	U r = U(std::min(std::max(c.x(), 0.0f), 255.0f) * (31.0 / 255.0) + 0.5);
+	U g = U(std::min(std::max(c.y(), 0.0f), 255.0f) * (63.0 / 255.0) + 0.5);
+	U b = U(std::min(std::max(c.z(), 0.0f), 255.0f) * (31.0 / 255.0) + 0.5);
+	return (r << 11) | (g << 5) | b;
+}
+
+//==============================================================================
+static Vec4 fromRgb565(U16 c)
+{
+	U r = (c >> 11) & 31;
+	U g = (c >> 5) & 63;
+	U b = c & 31;
+	return Vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2),
+		0.0);
+}
+
+//==============================================================================
+/// Pick the indices of the 4 color mode for some endpoints
+/// @return The squared error
+static F32 pickBc1Indices(const BlockColors& colors, U16 c0, U16 c1,
+	Array<U8, 16>& indices)
+{
+	Array<Vec4, 4> palette;
+	palette[0] = fromRgb565(c0);
+	palette[1] = fromRgb565(c1);
+	palette[2] = (palette[0] * 2.0 + palette[1]) * (1.0 / 3.0);
+	palette[3] = (palette[0] + palette[1] * 2.0) * (1.0 / 3.0);
+
+	F32 error = 0.0;
+	for(U i = 0; i < 16; i++)
+	{
+		F32 minDist = MAX_F32;
+		for(U j = 0; j < 4; j++)
+		{
+			Vec4 d = colors[i] - palette[j];
+			F32 dist = d.dot(d);
+			if(dist < minDist)
+			{
+				minDist = dist;
+				indices[i] = j;
+			}
+		}
+
+		error += minDist;
+	}
+
+	return error;
+}
+
+//==============================================================================
+/// Find the endpoints that fit the indices best with least squares
+/// @return False if it can't
+static Bool fitBc1Endpoints(const BlockColors& colors,
+	const Array<U8, 16>& indices, Vec4& e0, Vec4& e1)
+{
+	static const Array<F32, 4> WEIGHTS = {{1.0, 0.0, 2.0 / 3.0, 1.0 / 3.0}};
+
+	F32 aa = 0.0, bb = 0.0, ab = 0.0;
+	Vec4 ax(0.0), bx(0.0);
+	for(U i = 0; i < 16; i++)
+	{
+		F32 a = WEIGHTS[indices[i]];
+		F32 b = 1.0 - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		ax += colors[i] * a;
+		bx += colors[i] * b;
+	}
+
+	F32 det = aa * bb - ab * ab;
+	if(fabs(det) < getEpsilon<F32>())
+	{
+		return false;
+	}
+
+	F32 invDet = 1.0 / det;
+	e0 = (ax * bb - bx * ab) * invDet;
+	e1 = (bx * aa - ax * ab) * invDet;
+	return true;
+}
+
+//==============================================================================
+/// Compress the colors of a block. Always the 4 color mode
+static void compressBc1Colors(const U8* texels, U8* out)
+{
+	BlockColors colors;
+	Vec4 mean(0.0), minc(255.0), maxc(0.0);
+	for(U i = 0; i < 16; i++)
+	{
+		const U8* t = texels + i * 4;
+		colors[i] = Vec4(t[0], t[1], t[2], 0.0);
+		mean += colors[i];
+		for(U j = 0; j < 3; j++)
+		{
+			minc[j] = std::min(minc[j], colors[i][j]);
+			maxc[j] = std::max(maxc[j], colors[i][j]);
+		}
+	}
+	mean = mean * (1.0 / 16.0);
+
+	// The principal axis of the colors with a few power iterations on the
+	// covariance matrix
+	Mat3 cov(0.0);
+	for(U i = 0; i < 16; i++)
+	{
+		Vec3 d = (colors[i] - mean).xyz();
+		for(U j = 0; j < 3; j++)
+		{
+			for(U k = 0; k < 3; k++)
+			{
+				cov(j, k) += d[j] * d[k];
+			}
+		}
+	}
+
+	Vec3 axis = (maxc - minc).xyz();
+	for(U i = 0; i < 8 && axis.getLengthSquared() > getEpsilon<F32>(); i++)
+	{
+		axis = cov * axis;
+		F32 m = std::max(fabs(axis.x()),
+			std::max(fabs(axis.y()), fabs(axis.z())));
+		axis = (m > getEpsilon<F32>()) ? axis / m : Vec3(0.0);
+	}
+
+	Vec4 e0 = maxc, e1 = minc;
+	if(axis.getLengthSquared() > getEpsilon<F32>())
+	{
+		// The endpoints are the extremes along the axis, a bit inwards
+		axis.normalize();
+		F32 tmin = MAX_F32, tmax = -MAX_F32;
+		for(U i = 0; i < 16; i++)
+		{
+			F32 t = (colors[i] - mean).xyz().dot(axis);
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+
+		F32 inset = (tmax - tmin) / 16.0;
+		e0 = mean + Vec4(axis * (tmax - inset), 0.0);
+		e1 = mean + Vec4(axis * (tmin + inset), 0.0);
+	}
+
+	U16 c0 = toRgb565(e0);
+	U16 c1 = toRgb565(e1);
+	Array<U8, 16> indices;
+	F32 error = pickBc1Indices(colors, c0, c1, indices);
+
+	// Refine the endpoints
+	for(U i = 0; i < 2 && error > 0.0; i++)
+	{
+		if(!fitBc1Endpoints(colors, indices, e0, e1))
+		{
+			break;
+		}
+
+		U16 newC0 = toRgb565(e0);
+		U16 newC1 = toRgb565(e1);
+		Array<U8, 16> newIndices;
+		F32 newError = pickBc1Indices(colors, newC0, newC1, newIndices);
+		if(newError >= error)
+		{
+			break;
+		}
+
+		c0 = newC0;
+		c1 = newC1;
+		indices = newIndices;
+		error = newError;
+	}
+
+	// The 4 color mode needs c0 > c1
+	if(c0 < c1)
+	{
+		std::swap(c0, c1);
+		for(U8& idx : indices)
+		{
+			idx ^= 1;
+		}
+	}
+	else if(c0 == c1)
+	{
+		std::fill(indices.begin(), indices.end(), 0);
+	}
+
+	U32 bits = 0;
+	for(U i = 0; i < 16; i++)
+	{
+		bits |= U32(indices[i]) << (i * 2);
+	}
+
+	writeLittleEndian(c0, out);
+	writeLittleEndian(c1, out + 2);
+	writeLittleEndian(bits, out + 4);
+}
+
+//==============================================================================
+void compressBc1Block(const U8* texels, U8* out)
+{
+	compressBc1Colors(texels, out);
+}
+
+//==============================================================================
+void compressBc3Block(const U8* texels, U8* out)
+{
+	// The alpha. The 8 alphas mode with the min and max
+	U8 amin = 255, amax = 0;
+	for(U i = 0; i < 16; i++)
+	{
+		amin = std::min(amin, texels[i * 4 + 3]);
+		amax = std::max(amax, texels[i * 4 + 3]);
+	}
+
+	Array<I32, 8> palette;
+	palette[0] = amax;
+	palette[1] = amin;
+	for(U i = 1; i < 7; i++)
+	{
+		palette[i + 1] = ((7 - i) * amax + i * amin) / 7;
+	}
+
+	U64 bits = 0;
+	if(amin != amax)
+	{
+		for(U i = 0; i < 16; i++)
+		{
+			I32 a = texels[i * 4 + 3];
+			U best = 0;
+			for(U j = 1; j < 8; j++)
+			{
+				if(std::abs(palette[j] - a) < std::abs(palette[best] - a))
+				{
+					best = j;
+				}
+			}
+
+			bits |= U64(best) << (i * 3);
+		}
+	}
+
+	out[0] = amax;
+	out[1] = amin;
+	for(U i = 0; i < 6; i++)
+	{
+		out[2 + i] = (bits >> (i * 8)) & 0xff;
+	}
+
+	compressBc1Colors(texels, out + 8);
+}
+
+//==============================================================================
+// ETC                                                                         =
+//==============================================================================
+
+/// The modifiers of the ETC tables. The selectors 0 to 3 are +a, +b, -a, -b
+static const I32 ETC_MODIFIERS[8][2] = {
+	{2, 8}, {5, 17}, {9, 29}, {13, 42},
+	{18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+/// The modifiers of the EAC tables
+static const I32 EAC_MODIFIERS[16][8] = {
+	{-3, -6, -9, -15, 2, 5, 8, 14},
+	{-3, -7, -10, -13, 2, 6, 9, 12},
+	{-2, -5, -8, -13, 1, 4, 7, 12},
+	{-2, -4, -6, -13, 1, 3, 5, 12},
+	{-3, -6, -8, -12, 2, 5, 7, 11},
+	{-3, -7, -9, -11, 2, 6, 8, 10},
+	{-4, -7, -8, -11, 3, 6, 7, 10},
+	{-3, -5, -8, -11, 2, 4, 7, 10},
+	{-2, -6, -8, -10, 1, 5, 7, 9},
+	{-2, -5, -8, -10, 1, 4, 7, 9},
+	{-2, -4, -8, -10, 1, 3, 7, 9},
+	{-2, -5, -7, -10, 1, 4, 6, 9},
+	{-3, -4, -7, -10, 2, 3, 6, 9},
+	{-1, -2, -3, -10, 0, 1, 2, 9},
+	{-4, -6, -8, -9, 3, 5, 7, 8},
+	{-3, -5, -7, -9, 2, 4, 6, 8}};
+
+/// The sub block that a texel belongs to. [flip][texel]
+static Bool inSecondSubBlock(U flip, U texel)
+{
+	return flip ? (texel / 4 >= 2) : (texel % 4 >= 2);
+}
+
+/// The result of encoding a sub block
+class EtcSubBlock
+{
+public:
+	U32 m_error = MAX_U32;
+	U8 m_table = 0;
+	Array<U8, 16> m_selectors; ///< Only the texels of the sub block are set
+};
+
+//==============================================================================
+static I32 clampByte(I32 x)
+{
+	return std::min(std::max(x, 0), 255);
+}
+
+//==============================================================================
+/// Find the best table and selectors of a sub block for a base color
+static void encodeEtcSubBlock(const U8* texels, U flip, U subBlock,
+	const Array<I32, 3>& base, EtcSubBlock& out)
+{
+	out.m_error = MAX_U32;
+
+	for(U t = 0; t < 8; t++)
+	{
+		Array<I32, 4> mods = {{ETC_MODIFIERS[t][0], ETC_MODIFIERS[t][1],
+			-ETC_MODIFIERS[t][0], -ETC_MODIFIERS[t][1]}};
+		Array<Array<I32, 3>, 4> palette;
+		for(U s = 0; s < 4; s++)
+		{
+			for(U c = 0; c < 3; c++)
+			{
+				palette[s][c] = clampByte(base[c] + mods[s]);
+			}
+		}
+
+		U32 error = 0;
+		Array<U8, 16> selectors;
+		for(U i = 0; i < 16 && error < out.m_error; i++)
+		{
+			if(inSecondSubBlock(flip, i) != (subBlock == 1))
+			{
+				continue;
+			}
+
+			U32 minDist = MAX_U32;
+			for(U s = 0; s < 4; s++)
+			{
+				U32 dist = 0;
+				for(U c = 0; c < 3; c++)
+				{
+					I32 d = palette[s][c] - texels[i * 4 + c];
+					dist += d * d;
+				}
+
+				if(dist < minDist)
+				{
+					minDist = dist;
+					selectors[i] = s;
+				}
+			}
+
+			error += minDist;
+		}
+
+		if(error < out.m_error)
+		{
+			out.m_error = error;
+			out.m_table = t;
+			out.m_selectors = selectors;
+		}
+	}
+}
+
+//==============================================================================
+void compressEtc2Block(const U8* texels, U8* out)
+{
+	U32 bestError = MAX_U32;
+	U32 bestHigh = 0, bestLow = 0;
+
+	for(U flip = 0; flip < 2; flip++)
+	{
+		// The averages of the 2 sub blocks
+		Array<Array<F32, 3>, 2> avg;
+		for(U b = 0; b < 2; b++)
+		{
+			for(U c = 0; c < 3; c++)
+			{
+				U32 sum = 0;
+				for(U i = 0; i < 16; i++)
+				{
+					if(inSecondSubBlock(flip, i) == (b == 1))
+					{
+						sum += texels[i * 4 + c];
+					}
+				}
+
+				avg[b][c] = F32(sum) / (8.0 * 255.0);
+			}
+		}
+
+		// Try the differential (5 bit colors) and the individual (4 bit
+		// colors) modes
+		for(U diff = 0; diff < 2; diff++)
+		{
+			const U bits = diff ? 5 : 4;
+			const I32 maxq = (1 << bits) - 1;
+			Array<Array<I32, 3>, 2> q, base;
+			for(U b = 0; b < 2; b++)
+			{
+				for(U c = 0; c < 3; c++)
+				{
+					q[b][c] = I32(avg[b][c] * maxq + 0.5);
+					base[b][c] = diff
+						? (q[b][c] << 3) | (q[b][c] >> 2)
+						: (q[b][c] << 4) | q[b][c];
+				}
+			}
+
+			if(diff)
+			{
+				Bool fits = true;
+				for(U c = 0; c < 3; c++)
+				{
+					I32 d = q[1][c] - q[0][c];
+					fits = fits && d >= -4 && d <= 3;
+				}
+
+				if(!fits)
+				{
+					continue;
+				}
+			}
+
+			Array<EtcSubBlock, 2> sub;
+			encodeEtcSubBlock(texels, flip, 0, base[0], sub[0]);
+			encodeEtcSubBlock(texels, flip, 1, base[1], sub[1]);
+			U32 error = sub[0].m_error + sub[1].m_error;
+			if(error >= bestError)
+			{
+				continue;
+			}
+
+			bestError = error;
+
+			U32 high = (sub[0].m_table << 5) | (sub[1].m_table << 2)
+				| (diff << 1) | flip;
+			for(U c = 0; c < 3; c++)
+			{
+				U shift = 24 - c * 8;
+				if(diff)
+				{
+					high |= q[0][c] << (shift + 3);
+					high |= ((q[1][c] - q[0][c]) & 7) << shift;
+				}
+				else
+				{
+					high |= q[0][c] << (shift + 4);
+					high |= q[1][c] << shift;
+				}
+			}
+
+			// The selectors go by columns
+			U32 low = 0;
+			for(U i = 0; i < 16; i++)
+			{
+				U s = sub[inSecondSubBlock(flip, i)].m_selectors[i];
+				U bit = (i % 4) * 4 + i / 4;
+				low |= U32(s >> 1) << (16 + bit);
+				low |= U32(s & 1) << bit;
+			}
+
+			bestHigh = high;
+			bestLow = low;
+		}
+	}
+
+	writeBigEndian(bestHigh, out);
+	writeBigEndian(bestLow, out + 4);
+}
+
+//==============================================================================
+void compressEtc2EacBlock(const U8* texels, U8* out)
+{
+	I32 amin = 255, amax = 0;
+	for(U i = 0; i < 16; i++)
+	{
+		amin = std::min<I32>(amin, texels[i * 4 + 3]);
+		amax = std::max<I32>(amax, texels[i * 4 + 3]);
+	}
+
+	// The table 13 has a zero modifier for the blocks of one alpha
+	U32 bestError = MAX_U32;
+	U64 best = (U64(amin) << 56) | (U64(1) << 52) | (U64(13) << 48);
+	for(U i = 0; i < 16; i++)
+	{
+		best |= U64(4) << (45 - ((i % 4) * 4 + i / 4) * 3);
+	}
+
+	for(U t = 0; t < 16 && amin != amax; t++)
+	{
+		const I32* mods = EAC_MODIFIERS[t];
+		I32 modRange = mods[7] - mods[3];
+		I32 mult0 = (amax - amin) / modRange;
+
+		for(I32 mult = std::max(mult0, 1); mult <= std::min(mult0 + 1, 15);
+			mult++)
+		{
+			I32 base0 = (amin + amax - (mods[3] + mods[7]) * mult) / 2;
+
+			for(I32 base = base0 - 1; base <= base0 + 1; base++)
+			{
+				if(base < 0 || base > 255)
+				{
+					continue;
+				}
+
+				Array<I32, 8> palette;
+				for(U s = 0; s < 8; s++)
+				{
+					palette[s] = clampByte(base + mods[s] * mult);
+				}
+
+				U32 error = 0;
+				U64 bits = (U64(base) << 56) | (U64(mult) << 52)
+					| (U64(t) << 48);
+				for(U i = 0; i < 16 && error < bestError; i++)
+				{
+					I32 a = texels[i * 4 + 3];
+					U32 minDist = MAX_U32;
+					U sel = 0;
+					for(U s = 0; s < 8; s++)
+					{
+						I32 d = palette[s] - a;
+						if(U32(d * d) < minDist)
+						{
+							minDist = d * d;
+							sel = s;
+						}
+					}
+
+					error += minDist;
+					bits |= U64(sel) << (45 - ((i % 4) * 4 + i / 4) * 3);
+				}
+
+				if(error < bestError)
+				{
+					bestError = error;
+					best = bits;
+				}
+			}
+		}
+	}
+
+	writeBigEndian(best, out);
+	compressEtc2Block(texels, out + 8);
+}
+
+} // end namespace anki
@@ -0,0 +1,345 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/TextureCooker.h"
+#include "anki/resource/TextureCompression.h"
+#include "anki/util/Exception.h"
+#include "anki/util/File.h"
+#include "anki/util/Functions.h"
+#include <cstring>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// Generate some rows of a mip
+class MipTask: public Threadpool::Task
+{
+public:
+	const U8* m_in = nullptr;
+	U32 m_inWidth = 0;
+	U32 m_inHeight = 0;
+	Bool8 m_normal = false;
+	U8* m_out = nullptr;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+		choseStartEnd(taskId, threadsCount, m_inHeight / 2, start, end);
+
+		generateMipRows(
+			m_in, m_inWidth, m_inHeight, m_normal, start, end, m_out);
+	}
+};
+
+/// Compress some rows of blocks
+class CompressTask: public Threadpool::Task
+{
+public:
+	const U8* m_in = nullptr;
+	U32 m_width = 0;
+	U32 m_height = 0;
+	void (*m_compressBlock)(const U8*, U8*) = nullptr;
+	U32 m_blockSize = 0;
+	U8* m_out = nullptr;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		const U32 blocksX = m_width / 4;
+		PtrSize start, end;
+		choseStartEnd(taskId, threadsCount, m_height / 4, start, end);
+
+		Array<U8, 16 * 4> block;
+		for(PtrSize by = start; by < end; by++)
+		{
+			for(U32 bx = 0; bx < blocksX; bx++)
+			{
+				for(U y = 0; y < 4; y++)
+				{
+					std::memcpy(&block[y * 16],
+						m_in + ((by * 4 + y) * m_width + bx * 4) * 4, 16);
+				}
+
+				m_compressBlock(
+					&block[0], m_out + (by * blocksX + bx) * m_blockSize);
+			}
+		}
+	}
+};
+
+//==============================================================================
+/// Give the task to all the threads and wait
+static void runTask(Threadpool& threadpool, Threadpool::Task& task)
+{
+	for(U i = 0; i < threadpool.getThreadsCount(); i++)
+	{
+		threadpool.assignNewTask(i, &task);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
+}
+
+//==============================================================================
+/// The index of the compression in the file and in m_surfaces
+static U getCompressionIndex(Image::DataCompression comp)
+{
+	switch(comp)
+	{
+	case Image::DataCompression::RAW:
+		return 0;
+	case Image::DataCompression::S3TC:
+		return 1;
+	case Image::DataCompression::ETC:
+		return 2;
+	default:
+		ANKI_ASSERT(0);
+		return 0;
+	}
+}
+
+//==============================================================================
+// TextureCooker                                                               =
+//==============================================================================
+
+//==============================================================================
+TextureCooker::TextureCooker(
+	ResourceAllocator<U8>& alloc, Threadpool& threadpool)
+:	m_alloc(alloc),
+	m_threadpool(&threadpool),
+	m_layers(alloc)
+{
+	for(auto& surfaces : m_surfaces)
+	{
+		surfaces = ResourceVector<ResourceVector<U8>>(alloc);
+	}
+}
+
+//==============================================================================
+void TextureCooker::addLayer(const U8* data, U32 width, U32 height,
+	Image::ColorFormat colorFormat)
+{
+	if(width < 4 || !isPowerOfTwo(width)
+		|| height < 4 || !isPowerOfTwo(height))
+	{
+		throw ANKI_EXCEPTION("The size should be power of two and at least 4");
+	}
+
+	if(m_layers.size() > 0 && (width != m_width || height != m_height))
+	{
+		throw ANKI_EXCEPTION("The layers should have the same size");
+	}
+
+	if(colorFormat != Image::ColorFormat::RGB8
+		&& colorFormat != Image::ColorFormat::RGBA8)
+	{
+		throw ANKI_EXCEPTION("Unsupported color format");
+	}
+
+	m_width = width;
+	m_height = height;
+
+	// Keep it as RGBA8. The alpha stays only if all layers have it
+	if(m_layers.size() == 0 || colorFormat == Image::ColorFormat::RGB8)
+	{
+		m_colorFormat = colorFormat;
+	}
+
+	const U components = (colorFormat == Image::ColorFormat::RGB8) ? 3 : 4;
+	const PtrSize texels = width * height;
+
+	m_layers.emplace_back(m_alloc);
+	m_layers.back().emplace_back(texels * 4, 0, m_alloc);
+	U8* out = &m_layers.back()[0][0];
+
+	for(PtrSize i = 0; i < texels; i++)
+	{
+		out[i * 4 + 0] = data[i * components + 0];
+		out[i * 4 + 1] = data[i * components + 1];
+		out[i * 4 + 2] = data[i * components + 2];
+		out[i * 4 + 3] = (components == 4) ? data[i * components + 3] : 255;
+	}
+}
+
+//==============================================================================
+void TextureCooker::addLayer(const Image& img)
+{
+	if(img.getCompression() != Image::DataCompression::RAW)
+	{
+		throw ANKI_EXCEPTION("The image should be uncompressed");
+	}
+
+	const Image::Surface& surf = img.getSurface(0, 0);
+	addLayer(&surf.m_data[0], surf.m_width, surf.m_height,
+		img.getColorFormat());
+}
+
+//==============================================================================
+void TextureCooker::cook(Image::TextureType type, Bool normal, Bool alpha)
+{
+	U layers = m_layers.size();
+	if(layers == 0
+		|| (type == Image::TextureType::_2D && layers != 1)
+		|| (type == Image::TextureType::CUBE && layers != 6))
+	{
+		throw ANKI_EXCEPTION("Wrong number of layers for the texture type");
+	}
+
+	m_type = type;
+	m_normal = normal;
+	if(!alpha)
+	{
+		m_colorFormat = Image::ColorFormat::RGB8;
+	}
+
+	// The mips go down to 4x4 like the loader wants
+	m_mipLevels = 0;
+	for(U size = std::min(m_width, m_height); size >= 4; size /= 2)
+	{
+		++m_mipLevels;
+	}
+
+	for(U l = 0; l < layers; l++)
+	{
+		generateMips(l);
+	}
+
+	compress(Image::DataCompression::RAW);
+	compress(Image::DataCompression::S3TC);
+	compress(Image::DataCompression::ETC);
+}
+
+//==============================================================================
+void TextureCooker::generateMips(U layer)
+{
+	ResourceVector<ResourceVector<U8>>& mips = m_layers[layer];
+	mips.resize(1, ResourceVector<U8>(m_alloc));
+
+	U32 width = m_width;
+	U32 height = m_height;
+	for(U mip = 1; mip < m_mipLevels; mip++)
+	{
+		mips.emplace_back((width / 2) * (height / 2) * 4, 0, m_alloc);
+
+		MipTask task;
+		task.m_in = &mips[mip - 1][0];
+		task.m_inWidth = width;
+		task.m_inHeight = height;
+		task.m_normal = m_normal;
+		task.m_out = &mips[mip][0];
+		runTask(*m_threadpool, task);
+
+		width /= 2;
+		height /= 2;
+	}
+}
+
+//==============================================================================
+void TextureCooker::compress(Image::DataCompression comp)
+{
+	const Bool rgba = m_colorFormat == Image::ColorFormat::RGBA8;
+	ResourceVector<ResourceVector<U8>>& surfaces =
+		m_surfaces[getCompressionIndex(comp)];
+	surfaces.clear();
+
+	CompressTask task;
+	switch(comp)
+	{
+	case Image::DataCompression::S3TC:
+		task.m_compressBlock = rgba ? compressBc3Block : compressBc1Block;
+		task.m_blockSize = rgba ? 16 : 8;
+		break;
+	case Image::DataCompression::ETC:
+		task.m_compressBlock =
+			rgba ? compressEtc2EacBlock : compressEtc2Block;
+		task.m_blockSize = rgba ? 16 : 8;
+		break;
+	default:
+		break;
+	}
+
+	U32 width = m_width;
+	U32 height = m_height;
+	for(U mip = 0; mip < m_mipLevels; mip++)
+	{
+		for(U l = 0; l < m_layers.size(); l++)
+		{
+			const U8* in = &m_layers[l][mip][0];
+			const PtrSize texels = width * height;
+
+			if(comp == Image::DataCompression::RAW)
+			{
+				const U components = rgba ? 4 : 3;
+				surfaces.emplace_back(texels * components, 0, m_alloc);
+				U8* out = &surfaces.back()[0];
+
+				for(PtrSize i = 0; i < texels; i++)
+				{
+					std::memcpy(out + i * components, in + i * 4, components);
+				}
+			}
+			else
+			{
+				surfaces.emplace_back(
+					(width / 4) * (height / 4) * task.m_blockSize, 0, m_alloc);
+
+				task.m_in = in;
+				task.m_width = width;
+				task.m_height = height;
+				task.m_out = &surfaces.back()[0];
+				runTask(*m_threadpool, task);
+			}
+		}
+
+		width /= 2;
+		height /= 2;
+	}
+}
+
+//==============================================================================
+const ResourceVector<U8>& TextureCooker::getSurfaceData(
+	Image::DataCompression comp, U mip, U layer) const
+{
+	const ResourceVector<ResourceVector<U8>>& surfaces =
+		m_surfaces[getCompressionIndex(comp)];
+	U index = mip * m_layers.size() + layer;
+	ANKI_ASSERT(index < surfaces.size());
+	return surfaces[index];
+}
+
+//==============================================================================
+void TextureCooker::write(const CString& filename) const
+{
+	ANKI_ASSERT(m_mipLevels > 0 && "Call cook first");
+
+	AnkiTextureHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(&header.m_magic[0], "ANKITEX1", 8);
+	header.m_width = m_width;
+	header.m_height = m_height;
+	header.m_depth = m_layers.size();
+	header.m_type = m_type;
+	header.m_colorFormat = m_colorFormat;
+	header.m_compressionFormats = Image::DataCompression::RAW
+		| Image::DataCompression::S3TC | Image::DataCompression::ETC;
+	header.m_normal = m_normal;
+	header.m_mipLevels = m_mipLevels;
+
+	File file(filename, File::OpenFlag::WRITE | File::OpenFlag::BINARY);
+	file.write(&header, sizeof(header));
+
+	// All the compressions in the order of the loader. The surfaces are
+	// already [mip][layer]
+	for(const auto& surfaces : m_surfaces)
+	{
+		for(const ResourceVector<U8>& surf : surfaces)
+		{
+			file.write(const_cast<U8*>(&surf[0]), surf.size());
+		}
+	}
+}
+
+} // end namespace anki
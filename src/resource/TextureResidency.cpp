@@ -0,0 +1,416 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/TextureResidency.h"
+#include <algorithm>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The importance of a texture. The last request and then the priority
+static Bool lessImportant(U64 frameA, F32 priorityA, U64 frameB,
+	F32 priorityB)
+{
+	return frameA < frameB || (frameA == frameB && priorityA < priorityB);
+}
+
+//==============================================================================
+// TextureResidencyManager                                                     =
+//==============================================================================
+
+//==============================================================================
+TextureResidencyManager::TextureResidencyManager(
+	ResourceAllocator<U8>& alloc, PtrSize budget,
+	PtrSize maxLoadBytesPerUpdate)
+:	m_alloc(alloc),
+	m_textures(alloc),
+	m_freeHandles(alloc),
+	m_budget(budget),
+	m_maxLoadBytesPerUpdate(maxLoadBytesPerUpdate)
+{}
+
+//==============================================================================
+TextureResidencyManager::~TextureResidencyManager()
+{
+	ANKI_ASSERT(m_textures.size() == m_freeHandles.size()
+		&& "Forgot to unregister some textures");
+}
+
+//==============================================================================
+PtrSize TextureResidencyManager::getMipsSize(
+	const Texture& tex, U begin, U end)
+{
+	PtrSize size = 0;
+	for(U mip = begin; mip < end; mip++)
+	{
+		size += tex.m_mipSizes[mip];
+	}
+
+	return size;
+}
+
+//==============================================================================
+U TextureResidencyManager::computeMip(U32 width, U32 height, U mipsCount,
+	F32 screenSize)
+{
+	ANKI_ASSERT(mipsCount > 0);
+	if(screenSize <= 0.0)
+	{
+		return mipsCount - 1;
+	}
+
+	// The mip that has at least as many texels as the pixels
+	F32 ratio = F32(std::max(width, height)) / screenSize;
+	U mip = 0;
+	while(ratio >= 2.0 && mip < mipsCount - 1)
+	{
+		ratio /= 2.0;
+		++mip;
+	}
+
+	return mip;
+}
+
+//==============================================================================
+TextureResidencyManager::Handle TextureResidencyManager::registerTexture(
+	U32 width, U32 height, const PtrSize* mipSizes, U mipsCount,
+	U residentMip, void* userData)
+{
+	ANKI_ASSERT(mipsCount > 0 && mipsCount <= MAX_MIPS);
+	ANKI_ASSERT(residentMip < mipsCount);
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	Handle handle;
+	if(m_freeHandles.size() > 0)
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		m_textures[handle] = Texture();
+	}
+	else
+	{
+		handle = m_textures.size();
+		m_textures.emplace_back();
+	}
+
+	Texture& tex = m_textures[handle];
+	std::copy(mipSizes, mipSizes + mipsCount, tex.m_mipSizes.begin());
+	tex.m_userData = userData;
+	tex.m_width = width;
+	tex.m_height = height;
+	tex.m_mipsCount = mipsCount;
+	tex.m_tailMip = residentMip;
+	tex.m_residentMip = residentMip;
+	tex.m_prevResidentMip = residentMip;
+	tex.m_wantedMip = 0;
+	tex.m_used = true;
+
+	// The tail is always in memory even if it doesn't fit
+	m_residentBytes += getMipsSize(tex, residentMip, mipsCount);
+
+	return handle;
+}
+
+//==============================================================================
+void TextureResidencyManager::unregisterTexture(Handle texture)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	Texture& tex = m_textures[texture];
+	ANKI_ASSERT(tex.m_used && !tex.m_pending);
+
+	m_residentBytes -= getMipsSize(tex, tex.m_residentMip, tex.m_mipsCount);
+	tex.m_used = false;
+	tex.m_userData = nullptr;
+	m_freeHandles.push_back(texture);
+}
+
+//==============================================================================
+void TextureResidencyManager::requestMip(Handle texture, U mip, F32 priority)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	Texture& tex = m_textures[texture];
+	ANKI_ASSERT(tex.m_used);
+
+	mip = std::min<U>(mip, tex.m_mipsCount - 1);
+	tex.m_frameMip = std::min<U>(tex.m_frameMip, mip);
+	tex.m_framePriority = std::max(tex.m_framePriority, priority);
+}
+
+//==============================================================================
+void TextureResidencyManager::requestScreenSize(
+	Handle texture, F32 screenSize)
+{
+	U32 width, height;
+	U mipsCount;
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		const Texture& tex = m_textures[texture];
+		width = tex.m_width;
+		height = tex.m_height;
+		mipsCount = tex.m_mipsCount;
+	}
+
+	requestMip(texture, computeMip(width, height, mipsCount, screenSize),
+		screenSize);
+}
+
+//==============================================================================
+Bool TextureResidencyManager::evict(
+	ResourceVector<EvictionCandidate>& candidates, U& candidatesBegin,
+	const Texture& loadTex, PtrSize bytes)
+{
+	// See how much can go. The candidates are sorted so stop at the first
+	// that is not less important
+	PtrSize freed = 0;
+	U end = candidatesBegin;
+	for(; end < candidates.size() && freed < bytes; end++)
+	{
+		const EvictionCandidate& c = candidates[end];
+		if(!c.m_excess && !lessImportant(c.m_frame, c.m_priority,
+			loadTex.m_lastRequestFrame, loadTex.m_priority))
+		{
+			break;
+		}
+
+		const Texture& tex = m_textures[c.m_texture];
+		if(!tex.m_pending)
+		{
+			freed += tex.m_mipSizes[c.m_mip];
+		}
+	}
+
+	if(freed < bytes)
+	{
+		return false;
+	}
+
+	// Now evict
+	for(U i = candidatesBegin; i < end; i++)
+	{
+		const EvictionCandidate& c = candidates[i];
+		Texture& tex = m_textures[c.m_texture];
+		if(tex.m_pending)
+		{
+			continue;
+		}
+
+		ANKI_ASSERT(tex.m_residentMip == c.m_mip);
+		tex.m_residentMip = c.m_mip + 1;
+		tex.m_evicted = true;
+		m_residentBytes -= tex.m_mipSizes[c.m_mip];
+	}
+
+	candidatesBegin = end;
+	return true;
+}
+
+//==============================================================================
+void TextureResidencyManager::update(ResourceVector<Action>& actions)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	++m_frame;
+
+	// Gather the requests and the textures that want to load
+	ResourceVector<Handle> loads(m_alloc);
+	for(Handle h = 0; h < m_textures.size(); h++)
+	{
+		Texture& tex = m_textures[h];
+		if(!tex.m_used)
+		{
+			continue;
+		}
+
+		if(tex.m_frameMip != MAX_U8)
+		{
+			tex.m_wantedMip = tex.m_frameMip;
+			tex.m_lastRequestFrame = m_frame;
+			tex.m_priority = tex.m_framePriority;
+			tex.m_frameMip = MAX_U8;
+			tex.m_framePriority = 0.0;
+		}
+
+		if(!tex.m_pending && tex.m_wantedMip < tex.m_residentMip)
+		{
+			loads.push_back(h);
+		}
+	}
+
+	if(loads.size() == 0)
+	{
+		return;
+	}
+
+	// The most important first
+	std::sort(loads.begin(), loads.end(), [&](Handle a, Handle b) -> Bool
+	{
+		const Texture& ta = m_textures[a];
+		const Texture& tb = m_textures[b];
+		return lessImportant(tb.m_lastRequestFrame, tb.m_priority,
+			ta.m_lastRequestFrame, ta.m_priority);
+	});
+
+	ResourceVector<EvictionCandidate> candidates(m_alloc);
+	Bool candidatesReady = false;
+	U candidatesBegin = 0;
+	PtrSize loadBytes = 0;
+
+	for(Handle h : loads)
+	{
+		Texture& tex = m_textures[h];
+		if(tex.m_evicted)
+		{
+			continue;
+		}
+
+		// The biggest mip that fits the load limit. One mip loads anyway
+		U mip = tex.m_wantedMip;
+		while(mip + 1 < tex.m_residentMip
+			&& loadBytes + getMipsSize(tex, mip, tex.m_residentMip)
+			> m_maxLoadBytesPerUpdate)
+		{
+			++mip;
+		}
+
+		PtrSize bytes = getMipsSize(tex, mip, tex.m_residentMip);
+		if(loadBytes > 0 && loadBytes + bytes > m_maxLoadBytesPerUpdate)
+		{
+			continue;
+		}
+
+		// Make room. If it doesn't fit try smaller loads
+		while(mip < tex.m_residentMip && m_residentBytes + bytes > m_budget)
+		{
+			if(!candidatesReady)
+			{
+				// All the mips that can go. The excess mips first and then
+				// the least important
+				for(Handle c = 0; c < m_textures.size(); c++)
+				{
+					const Texture& ctex = m_textures[c];
+					if(!ctex.m_used || ctex.m_pending)
+					{
+						continue;
+					}
+
+					for(U m = ctex.m_residentMip; m < ctex.m_tailMip; m++)
+					{
+						candidates.push_back(EvictionCandidate{
+							ctex.m_lastRequestFrame, ctex.m_priority,
+							c, U8(m), m < ctex.m_wantedMip});
+					}
+				}
+
+				std::sort(candidates.begin(), candidates.end(),
+					[](const EvictionCandidate& a, const EvictionCandidate& b)
+					-> Bool
+				{
+					if(a.m_excess != b.m_excess)
+					{
+						return a.m_excess;
+					}
+
+					if(a.m_frame != b.m_frame || a.m_priority != b.m_priority)
+					{
+						return lessImportant(a.m_frame, a.m_priority,
+							b.m_frame, b.m_priority);
+					}
+
+					return (a.m_texture != b.m_texture)
+						? a.m_texture < b.m_texture : a.m_mip < b.m_mip;
+				});
+
+				candidatesReady = true;
+			}
+
+			if(evict(candidates, candidatesBegin, tex,
+				m_residentBytes + bytes - m_budget))
+			{
+				break;
+			}
+
+			++mip;
+			bytes = getMipsSize(tex, mip, tex.m_residentMip);
+		}
+
+		if(mip == tex.m_residentMip)
+		{
+			continue;
+		}
+
+		tex.m_prevResidentMip = tex.m_residentMip;
+		tex.m_residentMip = mip;
+		tex.m_pending = true;
+		m_residentBytes += bytes;
+		loadBytes += bytes;
+
+		actions.push_back(Action{h, U8(mip), true, tex.m_userData});
+	}
+
+	// The evictions
+	if(candidatesReady)
+	{
+		for(Handle h = 0; h < m_textures.size(); h++)
+		{
+			Texture& tex = m_textures[h];
+			if(tex.m_evicted)
+			{
+				tex.m_evicted = false;
+				tex.m_pending = true;
+				tex.m_prevResidentMip = tex.m_residentMip;
+
+				actions.push_back(
+					Action{h, tex.m_residentMip, false, tex.m_userData});
+			}
+		}
+	}
+}
+
+//==============================================================================
+void TextureResidencyManager::actionDone(Handle texture, Bool success)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	Texture& tex = m_textures[texture];
+	ANKI_ASSERT(tex.m_used && tex.m_pending);
+
+	if(!success && tex.m_residentMip < tex.m_prevResidentMip)
+	{
+		m_residentBytes -=
+			getMipsSize(tex, tex.m_residentMip, tex.m_prevResidentMip);
+		tex.m_residentMip = tex.m_prevResidentMip;
+	}
+
+	tex.m_pending = false;
+}
+
+//==============================================================================
+Bool TextureResidencyManager::isPending(Handle texture) const
+{
+	LockGuard<Mutex> lock(m_mtx);
+	return m_textures[texture].m_pending;
+}
+
+//==============================================================================
+U TextureResidencyManager::getResidentMip(Handle texture) const
+{
+	LockGuard<Mutex> lock(m_mtx);
+	return m_textures[texture].m_residentMip;
+}
+
+//==============================================================================
+PtrSize TextureResidencyManager::getResidentBytes() const
+{
+	LockGuard<Mutex> lock(m_mtx);
+	return m_residentBytes;
+}
+
+} // end namespace anki
@@ -25,34 +25,25 @@ static void deleteImageCallback(void* data)
 }
 
 //==============================================================================
-void TextureResource::load(const CString& filename, ResourceInitializer& init)
+/// Only the ankitex files have the mips that can stream
+static Bool isAnkiTexture(const CString& filename)
 {
-	try
-	{
-		loadInternal(filename, init);
-	}
-	catch(std::exception& e)
-	{
-		throw ANKI_EXCEPTION("Failed to load texture") << e;
-	}
+	const CString ext = ".ankitex";
+	U len = filename.getLength();
+	U extLen = ext.getLength();
+	return len > extLen && CString(&filename[len - extLen]) == ext;
 }
 
 //==============================================================================
-void TextureResource::loadInternal(const CString& filename, 
-	ResourceInitializer& rinit)
+/// Create a GL texture out of an image. The image is deleted when the GL
+/// texture is created
+static void createGlTexture(Image* imgPtr, GlCommandBufferHandle& jobs,
+	ResourceManager& resources, GlTextureHandle& tex)
 {
-	GlDevice& gl = rinit.m_resources._getGlDevice();
-	GlCommandBufferHandle jobs(&gl); // Always first to avoid assertions (
-	                                 // because of the check of the allocator)
-
 	GlTextureHandle::Initializer init;
 	U layers = 0;
 	Bool driverShouldGenMipmaps = false;
-
-	// Load image
-	Image* imgPtr = rinit.m_alloc.newInstance<Image>(rinit.m_alloc);
 	Image& img = *imgPtr;
-	img.load(filename, rinit.m_resources.getMaxTextureSize());
 	
 	// width + height
 	init.m_width = img.getSurface(0, 0).m_width;
@@ -173,7 +164,7 @@ void TextureResource::loadInternal(const CString& filename,
 	init.m_repeat = true;
 
 	// anisotropyLevel
-	init.m_anisotropyLevel = rinit.m_resources.getTextureAnisotropy();
+	init.m_anisotropyLevel = resources.getTextureAnisotropy();
 
 	// genMipmaps
 	if(init.m_mipmapsCount == 1 || driverShouldGenMipmaps)
@@ -200,7 +191,7 @@ void TextureResource::loadInternal(const CString& filename,
 	}
 
 	// Add the GL job to create the texture
-	m_tex = GlTextureHandle(jobs, init);
+	tex = GlTextureHandle(jobs, init);
 
 	// Add cleanup job
 	jobs.pushBackUserCommand(deleteImageCallback, imgPtr);
@@ -209,4 +200,132 @@ void TextureResource::loadInternal(const CString& filename,
 	jobs.flush();
 }
 
+//==============================================================================
+// TextureResource                                                             =
+//==============================================================================
+
+//==============================================================================
+TextureResource::~TextureResource()
+{
+	if(m_resources)
+	{
+		m_resources->_unregisterStreamedTexture(*this);
+	}
+}
+
+//==============================================================================
+void TextureResource::load(const CString& filename, ResourceInitializer& init)
+{
+	try
+	{
+		loadInternal(filename, init);
+	}
+	catch(std::exception& e)
+	{
+		throw ANKI_EXCEPTION("Failed to load texture") << e;
+	}
+}
+
+//==============================================================================
+void TextureResource::loadInternal(const CString& filename, 
+	ResourceInitializer& rinit)
+{
+	ResourceManager& resources = rinit.m_resources;
+	GlDevice& gl = resources._getGlDevice();
+	GlCommandBufferHandle jobs(&gl); // Always first to avoid assertions (
+	                                 // because of the check of the allocator)
+
+	// Load image. If it may be streamed load only the small mips
+	U32 maxSize = resources.getMaxTextureSize();
+	U32 tailSize = resources.getTextureStreamingTailSize();
+	Bool tryStream = tailSize > 0 && tailSize < maxSize
+		&& isAnkiTexture(filename);
+	Bool stream = false;
+
+	Image* imgPtr = rinit.m_alloc.newInstance<Image>(rinit.m_alloc);
+	imgPtr->load(filename, tryStream ? tailSize : maxSize);
+
+	if(tryStream && imgPtr->getTextureType() == Image::TextureType::_2D)
+	{
+		// The mips of the file that are allowed. The residency manager sees
+		// them as its mips
+		U tailFileMip = imgPtr->getFirstMipLevel();
+		U32 width = imgPtr->getSurface(0, 0).m_width << tailFileMip;
+		U32 height = imgPtr->getSurface(0, 0).m_height << tailFileMip;
+		U firstFileMip = 0;
+		while(firstFileMip < tailFileMip
+			&& (std::max(width, height) >> firstFileMip) > maxSize)
+		{
+			++firstFileMip;
+		}
+
+		U tailMip = tailFileMip - firstFileMip;
+		U mipsCount = tailMip + imgPtr->getMipLevelsCount();
+		if(tailMip > 0 && mipsCount <= TextureResidencyManager::MAX_MIPS)
+		{
+			// The bigger mips have 4 times the size of the next one
+			Array<PtrSize, TextureResidencyManager::MAX_MIPS> mipSizes;
+			for(U mip = 0; mip < mipsCount; mip++)
+			{
+				mipSizes[mip] = (mip < tailMip)
+					? imgPtr->getSurface(0, 0).m_data.size()
+						<< (2 * (tailMip - mip))
+					: imgPtr->getSurface(mip - tailMip, 0).m_data.size();
+			}
+
+			m_filename = ResourceString(filename, rinit.m_alloc);
+			m_maxSize = std::max(width, height) >> firstFileMip;
+			m_residencyHandle =
+				resources._getTextureResidency().registerTexture(
+				width >> firstFileMip, height >> firstFileMip, &mipSizes[0],
+				mipsCount, tailMip, this);
+			m_resources = &resources;
+			stream = true;
+		}
+	}
+	
+	if(tryStream && !stream && imgPtr->getFirstMipLevel() > 0)
+	{
+		// It can't stream. Load the rest of the mips
+		imgPtr->load(filename, maxSize);
+	}
+
+	createGlTexture(imgPtr, jobs, resources, m_tex);
+}
+
+//==============================================================================
+void TextureResource::requestScreenSize(F32 screenSize) const
+{
+	if(m_resources)
+	{
+		m_resources->_getTextureResidency().requestScreenSize(
+			m_residencyHandle, screenSize);
+	}
+}
+
+//==============================================================================
+void TextureResource::_streamMips(U mip)
+{
+	ANKI_ASSERT(m_resources);
+	GlTextureHandle tex;
+
+	try
+	{
+		GlCommandBufferHandle jobs(&m_resources->_getGlDevice());
+
+		ResourceAllocator<U8>& alloc = m_resources->_getAllocator();
+		Image* imgPtr = alloc.newInstance<Image>(alloc);
+		imgPtr->load(m_filename.toCString(), m_maxSize >> mip);
+
+		createGlTexture(imgPtr, jobs, *m_resources, tex);
+	}
+	catch(const std::exception& e)
+	{
+		m_resources->_textureStreamed(*this, nullptr);
+		throw ANKI_EXCEPTION("Failed to stream texture") << e;
+	}
+
+	m_resources->_textureStreamed(*this, &tex);
+}
+
 } // end namespace anki
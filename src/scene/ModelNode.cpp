@@ -10,6 +10,7 @@
 #include "anki/resource/Model.h"
 #include "anki/resource/Skeleton.h"
 #include "anki/physics/PhysicsWorld.h"
+#include "anki/core/Counters.h"
 
 namespace anki {
 
@@ -39,9 +40,13 @@ ModelPatchNode::~ModelPatchNode()
 //==============================================================================
 void ModelPatchNode::buildRendering(RenderingBuildData& data)
 {
+	const ModelPatchBase* modelPatch = 
+		static_cast<const ModelPatchBase*>(data.m_renderState);
+	ANKI_ASSERT(modelPatch);
+
 	// That will not work on multi-draw and instanced at the same time. Make
 	// sure that there is no multi-draw anywhere
-	ANKI_ASSERT(m_modelPatch->getSubMeshesCount() == 0);
+	ANKI_ASSERT(modelPatch->getSubMeshesCount() == 0);
 
 	auto instancesCount = data.m_subMeshIndicesCount;
 
@@ -52,7 +57,7 @@ void ModelPatchNode::buildRendering(RenderingBuildData& data)
 	GlCommandBufferHandle vertJobs;
 	GlProgramPipelineHandle ppline;
 
-	m_modelPatch->getRenderingDataSub(
+	modelPatch->getRenderingDataSub(
 		data.m_key, vertJobs, ppline, 
 		nullptr, 0,
 		indicesCountArray, indicesOffsetArray, drawcallCount);
@@ -61,8 +66,8 @@ void ModelPatchNode::buildRendering(RenderingBuildData& data)
 	ANKI_ASSERT(drawcallCount == 1);
 
 	// Set jobs
-	ppline.bind(data.m_jobs);
-	data.m_jobs.pushBackOtherCommandBuffer(vertJobs);
+	data.m_state->bindProgramPipeline(ppline, data.m_jobs);
+	data.m_state->bindVertexJobs(vertJobs, data.m_jobs);
 	
 	// Drawcall
 	U32 offset = indicesOffsetArray[0] / sizeof(U16);
@@ -72,6 +77,36 @@ void ModelPatchNode::buildRendering(RenderingBuildData& data)
 		indicesCountArray[0],
 		instancesCount,
 		offset);
+
+#if ANKI_ENABLE_COUNTERS
+	// The triangles that the LOD didn't draw
+	RenderingKey key0 = data.m_key;
+	key0.m_lod = 0;
+	U32 lod0IndicesCount = modelPatch->getMesh(key0).getIndicesCount();
+	ANKI_ASSERT(lod0IndicesCount >= indicesCountArray[0]);
+
+	ANKI_COUNTER_INC(RENDERER_TRIANGLES_COUNT, 
+		U64(indicesCountArray[0] / 3 * instancesCount));
+	ANKI_COUNTER_INC(RENDERER_LOD_TRIANGLES_SAVED, 
+		U64((lod0IndicesCount - indicesCountArray[0]) / 3 * instancesCount));
+#endif
+}
+
+//==============================================================================
+U ModelPatchNode::getLodsCount()
+{
+	return m_modelPatch->getLodsCount();
+}
+
+//==============================================================================
+F32 ModelPatchNode::getLodError(U lod)
+{
+	// The error grows with the scale of the model
+	SceneNode* parent = &getParent()->downCast<SceneNode>();
+	ANKI_ASSERT(parent);
+	const MoveComponent& move = parent->getComponent<MoveComponent>();
+
+	return m_modelPatch->getLodError(lod) * move.getWorldTransform().getScale();
 }
 
 //==============================================================================
@@ -224,6 +259,8 @@ ModelNode::ModelNode(
 
 	for(const ModelPatchBase* patch : m_model->getModelPatches())
 	{
+		getSceneGraph()._addMaterialForWarmup(patch->getMaterialResource());
+
 		ModelPatchNode* mpn = 
 			getSceneGraph().newSceneNode<ModelPatchNode>(nullptr, patch);
 
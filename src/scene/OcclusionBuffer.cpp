@@ -0,0 +1,498 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/scene/OcclusionBuffer.h"
+#include "anki/math/Simd.h"
+#include <algorithm>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+static_assert(OcclusionBuffer::WIDTH % 4 == 0, "Rasterizing 4 at a time");
+static_assert((OcclusionBuffer::WIDTH >> OcclusionBuffer::HIZ_LEVELS) > 0
+	&& (OcclusionBuffer::HEIGHT >> OcclusionBuffer::HIZ_LEVELS) > 0,
+	"Too many levels");
+
+/// The alignment of the buffers for the SIMD loads
+static const PtrSize BUFFER_ALIGNMENT = 16;
+
+//==============================================================================
+/// The offset of a level of the HiZ. The level 0 is the buffer
+static U32 getHiZOffset(U level)
+{
+	ANKI_ASSERT(level > 0 && level <= OcclusionBuffer::HIZ_LEVELS + 1);
+	U32 offset = 0;
+	for(U l = 1; l < level; l++)
+	{
+		offset += (OcclusionBuffer::WIDTH >> l)
+			* (OcclusionBuffer::HEIGHT >> l);
+	}
+
+	return offset;
+}
+
+//==============================================================================
+// SIMD                                                                        =
+//==============================================================================
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+
+typedef __m128 F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return _mm_set1_ps(x);
+}
+
+//==============================================================================
+/// x, x + 1, x + 2, x + 3
+static inline F32x4 ramp(F32 x)
+{
+	return _mm_setr_ps(x, x + 1.0, x + 2.0, x + 3.0);
+}
+
+//==============================================================================
+/// a * b + c
+static inline F32x4 madd(F32x4 a, F32x4 b, F32x4 c)
+{
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+//==============================================================================
+static inline F32x4 add(F32x4 a, F32x4 b)
+{
+	return _mm_add_ps(a, b);
+}
+
+//==============================================================================
+/// All three are not negative
+static inline F32x4 allNotNegative(F32x4 a, F32x4 b, F32x4 c)
+{
+	F32x4 zero = _mm_setzero_ps();
+	return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(a, zero),
+		_mm_cmpge_ps(b, zero)), _mm_cmpge_ps(c, zero));
+}
+
+//==============================================================================
+/// Write the min of the depth and z where the mask is set
+static inline void depthTest(F32* depth, F32x4 z, F32x4 mask)
+{
+	F32x4 d = _mm_load_ps(depth);
+	_mm_store_ps(depth, _mm_blendv_ps(d, _mm_min_ps(d, z), mask));
+}
+
+#elif ANKI_SIMD == ANKI_SIMD_NEON
+
+typedef float32x4_t F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return vdupq_n_f32(x);
+}
+
+//==============================================================================
+/// x, x + 1, x + 2, x + 3
+static inline F32x4 ramp(F32 x)
+{
+	static const F32 offsets[4] = {0.0, 1.0, 2.0, 3.0};
+	return vaddq_f32(vdupq_n_f32(x), vld1q_f32(offsets));
+}
+
+//==============================================================================
+/// a * b + c
+static inline F32x4 madd(F32x4 a, F32x4 b, F32x4 c)
+{
+	return vmlaq_f32(c, a, b);
+}
+
+//==============================================================================
+static inline F32x4 add(F32x4 a, F32x4 b)
+{
+	return vaddq_f32(a, b);
+}
+
+//==============================================================================
+/// All three are not negative
+static inline F32x4 allNotNegative(F32x4 a, F32x4 b, F32x4 c)
+{
+	F32x4 zero = vdupq_n_f32(0.0);
+	uint32x4_t m = vandq_u32(vandq_u32(vcgeq_f32(a, zero),
+		vcgeq_f32(b, zero)), vcgeq_f32(c, zero));
+	return vreinterpretq_f32_u32(m);
+}
+
+//==============================================================================
+/// Write the min of the depth and z where the mask is set
+static inline void depthTest(F32* depth, F32x4 z, F32x4 mask)
+{
+	F32x4 d = vld1q_f32(depth);
+	vst1q_f32(depth,
+		vbslq_f32(vreinterpretq_u32_f32(mask), vminq_f32(d, z), d));
+}
+
+#endif
+
+//==============================================================================
+// OcclusionBuffer                                                             =
+//==============================================================================
+
+//==============================================================================
+OcclusionBuffer::OcclusionBuffer(HeapAllocator<U8>& alloc)
+:	m_alloc(alloc)
+{
+	PtrSize alignment = BUFFER_ALIGNMENT;
+
+	m_depth = reinterpret_cast<F32*>(m_alloc.allocate(
+		WIDTH * HEIGHT * sizeof(F32), &alignment));
+	m_hiz = reinterpret_cast<F32*>(m_alloc.allocate(
+		getHiZOffset(HIZ_LEVELS + 1) * sizeof(F32), &alignment));
+
+	for(Bin& bin : m_bins)
+	{
+		bin.m_triangles = Vector<Triangle>(m_alloc);
+		bin.m_clip = Vector<Vec4>(m_alloc);
+	}
+
+	clear(Mat4::getIdentity());
+}
+
+//==============================================================================
+OcclusionBuffer::~OcclusionBuffer()
+{
+	m_alloc.deallocate(reinterpret_cast<U8*>(m_depth),
+		WIDTH * HEIGHT * sizeof(F32));
+	m_alloc.deallocate(reinterpret_cast<U8*>(m_hiz),
+		getHiZOffset(HIZ_LEVELS + 1) * sizeof(F32));
+}
+
+//==============================================================================
+void OcclusionBuffer::clear(const Mat4& viewProjMat)
+{
+	m_viewProjMat = viewProjMat;
+	std::fill(m_depth, m_depth + WIDTH * HEIGHT, 1.0);
+
+	for(Bin& bin : m_bins)
+	{
+		bin.m_triangles.clear();
+	}
+}
+
+//==============================================================================
+/// Set up a triangle that is in front of the near plane
+void OcclusionBuffer::setupTriangle(const Vec4& a, const Vec4& b, 
+	const Vec4& c, Vector<Triangle>& triangles)
+{
+	const F32 width = OcclusionBuffer::WIDTH;
+	const F32 height = OcclusionBuffer::HEIGHT;
+
+	// To pixels
+	Array<Vec3, 3> v;
+	const Vec4* clip[3] = {&a, &b, &c};
+	for(U i = 0; i < 3; i++)
+	{
+		F32 invW = 1.0 / clip[i]->w();
+		v[i] = Vec3((clip[i]->x() * invW * 0.5 + 0.5) * width,
+			(clip[i]->y() * invW * 0.5 + 0.5) * height,
+			clip[i]->z() * invW);
+	}
+
+	// Both windings are drawn. Make it counter clockwise
+	F32 area = (v[1].x() - v[0].x()) * (v[2].y() - v[0].y())
+		- (v[2].x() - v[0].x()) * (v[1].y() - v[0].y());
+	if(fabs(area) < getEpsilon<F32>())
+	{
+		return;
+	}
+
+	if(area < 0.0)
+	{
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	F32 minX = std::min(v[0].x(), std::min(v[1].x(), v[2].x()));
+	F32 maxX = std::max(v[0].x(), std::max(v[1].x(), v[2].x()));
+	F32 minY = std::min(v[0].y(), std::min(v[1].y(), v[2].y()));
+	F32 maxY = std::max(v[0].y(), std::max(v[1].y(), v[2].y()));
+	if(maxX < 0.0 || maxY < 0.0 || minX >= width || minY >= height)
+	{
+		return;
+	}
+
+	Triangle tri;
+	tri.m_rect[0] = std::max(minX, 0.0f);
+	tri.m_rect[1] = std::max(minY, 0.0f);
+	tri.m_rect[2] = std::min(maxX, width - 1.0f);
+	tri.m_rect[3] = std::min(maxY, height - 1.0f);
+
+	for(U i = 0; i < 3; i++)
+	{
+		const Vec3& from = v[i];
+		const Vec3& to = v[(i + 1) % 3];
+
+		F32 edgeA = from.y() - to.y();
+		F32 edgeB = to.x() - from.x();
+		tri.m_edges[i] = Vec3(edgeA, edgeB,
+			-edgeA * from.x() - edgeB * from.y());
+	}
+
+	Vec3 d1 = v[1] - v[0];
+	Vec3 d2 = v[2] - v[0];
+	F32 dzdx = (d1.z() * d2.y() - d2.z() * d1.y()) / area;
+	F32 dzdy = (d2.z() * d1.x() - d1.z() * d2.x()) / area;
+	tri.m_depth = Vec3(dzdx, dzdy,
+		v[0].z() - dzdx * v[0].x() - dzdy * v[0].y());
+
+	triangles.push_back(tri);
+}
+
+//==============================================================================
+void OcclusionBuffer::addOccluder(U32 threadId, const Mat4& mvp, 
+	const Vec3* positions, const U16* indices, U32 indicesCount)
+{
+	ANKI_ASSERT(positions && indices && indicesCount % 3 == 0);
+	ANKI_ASSERT(threadId < m_bins.getSize());
+	Vector<Triangle>& triangles = m_bins[threadId].m_triangles;
+	Vector<Vec4>& clip = m_bins[threadId].m_clip;
+
+	// Transform the vertices once
+	U32 positionsCount = *std::max_element(indices, indices + indicesCount)
+		+ 1;
+	clip.resize(positionsCount);
+	for(U32 i = 0; i < positionsCount; i++)
+	{
+		clip[i] = mvp * Vec4(positions[i], 1.0);
+	}
+
+	for(U32 i = 0; i < indicesCount; i += 3)
+	{
+		Array<Vec4, 3> v = {{
+			clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]}};
+
+		// The distances from the near plane
+		Array<F32, 3> dist;
+		U inside = 0;
+		for(U j = 0; j < 3; j++)
+		{
+			dist[j] = v[j].z() + v[j].w();
+			inside += (dist[j] >= 0.0);
+		}
+
+		if(inside == 3)
+		{
+			setupTriangle(v[0], v[1], v[2], triangles);
+			continue;
+		}
+		else if(inside == 0)
+		{
+			continue;
+		}
+
+		// Clip it. It becomes a triangle or a quad
+		Array<Vec4, 4> poly;
+		U polyCount = 0;
+		for(U j = 0; j < 3; j++)
+		{
+			U k = (j + 1) % 3;
+
+			if(dist[j] >= 0.0)
+			{
+				poly[polyCount++] = v[j];
+			}
+
+			if((dist[j] >= 0.0) != (dist[k] >= 0.0))
+			{
+				F32 t = dist[j] / (dist[j] - dist[k]);
+				poly[polyCount++] = v[j] + (v[k] - v[j]) * t;
+			}
+		}
+
+		for(U j = 2; j < polyCount; j++)
+		{
+			setupTriangle(poly[0], poly[j - 1], poly[j], triangles);
+		}
+	}
+}
+
+//==============================================================================
+void OcclusionBuffer::rasterize(U32 firstRow, U32 rowsCount)
+{
+	ANKI_ASSERT(firstRow + rowsCount <= HEIGHT);
+	U32 endRow = firstRow + rowsCount;
+
+	for(const Bin& bin : m_bins)
+	{
+		for(const Triangle& tri : bin.m_triangles)
+		{
+			rasterize(tri, firstRow, endRow);
+		}
+	}
+}
+
+//==============================================================================
+void OcclusionBuffer::rasterize(const Triangle& tri, U32 firstRow, 
+	U32 endRow)
+{
+	U32 y0 = std::max<U32>(tri.m_rect[1], firstRow);
+	U32 y1 = std::min<U32>(tri.m_rect[3] + 1, endRow);
+	if(y0 >= y1)
+	{
+		return;
+	}
+
+	// Evaluate in the centers of the pixels
+	U32 x0 = tri.m_rect[0] & ~3u;
+	U32 x1 = tri.m_rect[2] + 1;
+	const Vec3& e0 = tri.m_edges[0];
+	const Vec3& e1 = tri.m_edges[1];
+	const Vec3& e2 = tri.m_edges[2];
+	const Vec3& z = tri.m_depth;
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	F32x4 px = ramp(F32(x0) + 0.5);
+	F32x4 step0 = splat(e0.x() * 4.0);
+	F32x4 step1 = splat(e1.x() * 4.0);
+	F32x4 step2 = splat(e2.x() * 4.0);
+	F32x4 stepz = splat(z.x() * 4.0);
+
+	for(U32 y = y0; y < y1; y++)
+	{
+		F32 py = F32(y) + 0.5;
+		F32x4 w0 = madd(splat(e0.x()), px, splat(e0.y() * py + e0.z()));
+		F32x4 w1 = madd(splat(e1.x()), px, splat(e1.y() * py + e1.z()));
+		F32x4 w2 = madd(splat(e2.x()), px, splat(e2.y() * py + e2.z()));
+		F32x4 depth = madd(splat(z.x()), px, splat(z.y() * py + z.z()));
+
+		F32* row = m_depth + y * WIDTH;
+		for(U32 x = x0; x < x1; x += 4)
+		{
+			depthTest(row + x, depth, allNotNegative(w0, w1, w2));
+
+			w0 = add(w0, step0);
+			w1 = add(w1, step1);
+			w2 = add(w2, step2);
+			depth = add(depth, stepz);
+		}
+	}
+#else
+	for(U32 y = y0; y < y1; y++)
+	{
+		F32 py = F32(y) + 0.5;
+		F32* row = m_depth + y * WIDTH;
+		for(U32 x = x0; x < x1; x++)
+		{
+			F32 px = F32(x) + 0.5;
+			if(e0.x() * px + e0.y() * py + e0.z() >= 0.0
+				&& e1.x() * px + e1.y() * py + e1.z() >= 0.0
+				&& e2.x() * px + e2.y() * py + e2.z() >= 0.0)
+			{
+				row[x] = std::min(row[x], z.x() * px + z.y() * py + z.z());
+			}
+		}
+	}
+#endif
+}
+
+//==============================================================================
+void OcclusionBuffer::buildHiZ()
+{
+	const F32* prev = m_depth;
+	U32 prevWidth = WIDTH;
+
+	for(U level = 1; level <= HIZ_LEVELS; level++)
+	{
+		F32* crnt = m_hiz + getHiZOffset(level);
+		U32 width = WIDTH >> level;
+		U32 height = HEIGHT >> level;
+
+		// The farthest of the 4
+		for(U32 y = 0; y < height; y++)
+		{
+			const F32* row0 = prev + (y * 2) * prevWidth;
+			const F32* row1 = row0 + prevWidth;
+
+			for(U32 x = 0; x < width; x++)
+			{
+				crnt[y * width + x] =
+					std::max(std::max(row0[x * 2], row0[x * 2 + 1]),
+					std::max(row1[x * 2], row1[x * 2 + 1]));
+			}
+		}
+
+		prev = crnt;
+		prevWidth = width;
+	}
+}
+
+//==============================================================================
+Bool OcclusionBuffer::isOccluded(const Aabb& box) const
+{
+	const Vec4& min = box.getMin();
+	const Vec4& max = box.getMax();
+
+	// The rect on the screen and the closest depth of the corners
+	Vec3 rectMin(MAX_F32);
+	Vec3 rectMax(-MAX_F32);
+	for(U i = 0; i < 8; i++)
+	{
+		Vec4 corner((i & 1) ? max.x() : min.x(), (i & 2) ? max.y() : min.y(),
+			(i & 4) ? max.z() : min.z(), 1.0);
+		Vec4 clip = m_viewProjMat * corner;
+
+		if(clip.z() < -clip.w())
+		{
+			return false;
+		}
+
+		Vec3 ndc = clip.xyz() / clip.w();
+		for(U j = 0; j < 3; j++)
+		{
+			rectMin[j] = std::min(rectMin[j], ndc[j]);
+			rectMax[j] = std::max(rectMax[j], ndc[j]);
+		}
+	}
+
+	I32 x0 = std::max<I32>(floor((rectMin.x() * 0.5 + 0.5) * WIDTH), 0);
+	I32 y0 = std::max<I32>(floor((rectMin.y() * 0.5 + 0.5) * HEIGHT), 0);
+	I32 x1 = std::min<I32>(floor((rectMax.x() * 0.5 + 0.5) * WIDTH),
+		WIDTH - 1);
+	I32 y1 = std::min<I32>(floor((rectMax.y() * 0.5 + 0.5) * HEIGHT),
+		HEIGHT - 1);
+	if(x0 > x1 || y0 > y1)
+	{
+		return false;
+	}
+
+	// Go up the HiZ until the rect covers up to 4x4 texels
+	U level = 0;
+	while(level < HIZ_LEVELS
+		&& ((x1 >> level) - (x0 >> level) >= 4
+		|| (y1 >> level) - (y0 >> level) >= 4))
+	{
+		++level;
+	}
+
+	const F32* texels = (level == 0) ? m_depth : m_hiz + getHiZOffset(level);
+	U32 width = WIDTH >> level;
+	for(I32 y = y0 >> level; y <= (y1 >> level); y++)
+	{
+		for(I32 x = x0 >> level; x <= (x1 >> level); x++)
+		{
+			if(texels[y * width + x] >= rectMin.z())
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+} // end namespace anki
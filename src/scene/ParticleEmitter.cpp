@@ -18,182 +18,7 @@ namespace anki {
 // Misc                                                                        =
 //==============================================================================
 
-const U COMPONENTS = 3 + 1 + 1; // 3 position, 1 size, 1 alpha
-const PtrSize VERT_SIZE = COMPONENTS * sizeof(F32);
-
-//==============================================================================
-static F32 getRandom(F32 initial, F32 deviation)
-{
-	return (deviation == 0.0) 
-		? initial
-		: initial + randFloat(deviation) * 2.0 - deviation;
-}
-
-//==============================================================================
-static Vec3 getRandom(const Vec3& initial, const Vec3& deviation)
-{
-	if(deviation == Vec3(0.0))
-	{
-		return initial;
-	}
-	else
-	{
-		Vec3 out;
-		for(U i = 0; i < 3; i++)
-		{
-			out[i] = getRandom(initial[i], deviation[i]);
-		}
-		return out;
-	}
-}
-
-//==============================================================================
-// ParticleBase                                                                =
-//==============================================================================
-
-//==============================================================================
-void ParticleBase::revive(const ParticleEmitter& pe,
-	F32 /*prevUpdateTime*/, F32 crntTime)
-{
-	ANKI_ASSERT(isDead());
-	const ParticleEmitterProperties& props = pe;
-
-	// life
-	m_timeOfDeath = getRandom(crntTime + props.m_particle.m_life,
-		props.m_particle.m_lifeDeviation);
-	m_timeOfBirth = crntTime;
-}
-
-//==============================================================================
-// ParticleSimple                                                              =
-//==============================================================================
-
-//==============================================================================
-void ParticleSimple::simulate(const ParticleEmitter& pe,
-	F32 prevUpdateTime, F32 crntTime)
-{
-	F32 dt = crntTime - prevUpdateTime;
-
-	ANKI_ASSERT(
-		static_cast<const ParticleEmitterProperties&>(pe).
-		m_particle.m_gravity.getLength() > 0.0);
-
-	Vec4 xp = m_position;
-	Vec4 xc = m_acceleration * (dt * dt) + m_velocity * dt + xp;
-
-	m_position = xc;
-
-	m_velocity += m_acceleration * dt;
-}
-
-//==============================================================================
-void ParticleSimple::revive(const ParticleEmitter& pe,
-	F32 prevUpdateTime, F32 crntTime)
-{
-	ParticleBase::revive(pe, prevUpdateTime, crntTime);
-	m_velocity = Vec4(0.0);
-
-	const ParticleEmitterProperties& props = pe;
-
-	m_acceleration = getRandom(props.m_particle.m_gravity,
-			props.m_particle.m_gravityDeviation).xyz0();
-
-	// Set the initial position
-	m_position = getRandom(props.m_particle.m_startingPos,
-		props.m_particle.m_startingPosDeviation).xyz0();
-
-	m_position += pe.getWorldTransform().getOrigin();
-}
-
-//==============================================================================
-// Particle                                                                    =
-//==============================================================================
-
-#if 0
-
-//==============================================================================
-Particle::Particle(
-	const char* name, SceneGraph* scene, // SceneNode
-	// RigidBody
-	PhysicsWorld* masterContainer, const RigidBody::Initializer& init_)
-	:	ParticleBase(name, scene, PT_PHYSICS)
-{
-	RigidBody::Initializer init = init_;
-
-	getSceneGraph().getPhysics().newPhysicsObject<RigidBody>(body, init);
-
-	sceneNodeProtected.rigidBodyC = body;
-}
-
-//==============================================================================
-Particle::~Particle()
-{
-	getSceneGraph().getPhysics().deletePhysicsObject(body);
-}
-
-//==============================================================================
-void Particle::revive(const ParticleEmitter& pe,
-	F32 prevUpdateTime, F32 crntTime)
-{
-	ParticleBase::revive(pe, prevUpdateTime, crntTime);
-
-	const ParticleEmitterProperties& props = pe;
-
-	// pre calculate
-	Bool forceFlag = props.forceEnabled;
-	Bool worldGravFlag = props.wordGravityEnabled;
-
-	// activate it (Bullet stuff)
-	body->forceActivationState(ACTIVE_TAG);
-	body->activate();
-	body->clearForces();
-	body->setLinearVelocity(btVector3(0.0, 0.0, 0.0));
-	body->setAngularVelocity(btVector3(0.0, 0.0, 0.0));
-
-	// force
-	if(forceFlag)
-	{
-		Vec3 forceDir = getRandom(props.particle.forceDirection,
-			props.particle.forceDirectionDeviation);
-		forceDir.normalize();
-
-		if(!pe.identityRotation)
-		{
-			// the forceDir depends on the particle emitter rotation
-			forceDir = pe.getWorldTransform().getRotation() * forceDir;
-		}
-
-		F32 forceMag = getRandom(props.particle.forceMagnitude,
-			props.particle.forceMagnitudeDeviation);
-
-		body->applyCentralForce(toBt(forceDir * forceMag));
-	}
-
-	// gravity
-	if(!worldGravFlag)
-	{
-		body->setGravity(toBt(getRandom(props.particle.gravity,
-			props.particle.gravityDeviation)));
-	}
-
-	// Starting pos. In local space
-	Vec3 pos = getRandom(props.particle.startingPos,
-		props.particle.startingPosDeviation);
-
-	if(pe.identityRotation)
-	{
-		pos += pe.getWorldTransform().getOrigin();
-	}
-	else
-	{
-		pos.transform(pe.getWorldTransform());
-	}
-
-	btTransform trf(
-		toBt(Transform(pos, pe.getWorldTransform().getRotation(), 1.0)));
-	body->setWorldTransform(trf);
-}
-#endif
+const PtrSize VERT_SIZE = ParticleSimulation::VERTEX_COMPONENTS * sizeof(F32);
 
 //==============================================================================
 // ParticleEmitter                                                             =
@@ -207,7 +32,6 @@ ParticleEmitter::ParticleEmitter(
 	SpatialComponent(this),
 	MoveComponent(this),
 	RenderComponent(this),
-	m_particles(getSceneAllocator()),
 	m_transforms(getSceneAllocator())
 {
 	addComponent(static_cast<MoveComponent*>(this));
@@ -240,42 +64,33 @@ ParticleEmitter::ParticleEmitter(
 
 	m_timeLeftForNextEmission = 0.0;
 	RenderComponent::init();
-
-	// Create the vertex buffer and object
-	//
-	PtrSize buffSize = m_maxNumOfParticles * VERT_SIZE * 3;
-
-	GlDevice& gl = getSceneGraph()._getGlDevice();
-	GlCommandBufferHandle jobs(&gl);
-
-	m_vertBuff = GlBufferHandle(jobs, GL_ARRAY_BUFFER, buffSize, 
-		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-
-	// TODO Optimize that to avoid serialization
-	jobs.finish();
-
-	m_vertBuffMapping = (U8*)m_vertBuff.getPersistentMappingAddress();
 }
 
 //==============================================================================
 ParticleEmitter::~ParticleEmitter()
 {
-	// Delete simple particles
-	if(m_simulationType == SimulationType::SIMPLE)
+	if(m_simulation)
 	{
-		for(ParticleBase* part : m_particles)
-		{
-			getSceneAllocator().deleteInstance(part);
-		}
+		getSceneAllocator().deleteInstance(m_simulation);
 	}
 }
 
 //==============================================================================
 void ParticleEmitter::buildRendering(RenderingBuildData& data)
 {
-	ANKI_ASSERT(data.m_subMeshIndicesCount <= m_transforms.size() + 1);
+	const RenderState* state = 
+		static_cast<const RenderState*>(data.m_renderState);
+	ANKI_ASSERT(state && data.m_gl);
+
+	// The merged emitters append their particles
+	U32 particlesCount = state->m_aliveParticlesCount;
+	for(U i = 0; i < data.m_mergedRenderStatesCount; i++)
+	{
+		particlesCount += static_cast<const RenderState*>(
+			data.m_mergedRenderStates[i])->m_aliveParticlesCount;
+	}
 
-	if(m_aliveParticlesCount == 0)
+	if(particlesCount == 0)
 	{
 		return;
 	}
@@ -284,29 +99,81 @@ void ParticleEmitter::buildRendering(RenderingBuildData& data)
 	key.m_lod = 0;
 
 	GlProgramPipelineHandle ppline = 
-		m_particleEmitterResource->getMaterial().getProgramPipeline(key);
+		state->m_material->getProgramPipeline(key);
+
+	data.m_state->bindProgramPipeline(ppline, data.m_jobs);
 
-	ppline.bind(data.m_jobs);
+	// Copy the vertex data of the frame to transient memory
+	GlBufferHandle vertBuff;
+	PtrSize offset;
+	U8* mem = static_cast<U8*>(data.m_gl->allocateTransientMemory(
+		GlTransientMemoryType::VERTEX, particlesCount * VERT_SIZE, 
+		vertBuff, offset));
 
-	PtrSize offset = (getGlobTimestamp() % 3) * (m_vertBuff.getSize() / 3);
+	PtrSize size = state->m_aliveParticlesCount * VERT_SIZE;
+	memcpy(mem, state->m_verts, size);
+	mem += size;
+
+	for(U i = 0; i < data.m_mergedRenderStatesCount; i++)
+	{
+		const RenderState* merged = 
+			static_cast<const RenderState*>(data.m_mergedRenderStates[i]);
+		size = merged->m_aliveParticlesCount * VERT_SIZE;
+		memcpy(mem, merged->m_verts, size);
+		mem += size;
+	}
 
 	// Position
-	m_vertBuff.bindVertexBuffer(data.m_jobs, 
+	vertBuff.bindVertexBuffer(data.m_jobs, 
 		3, GL_FLOAT, false, VERT_SIZE, offset + 0, 0);
 
 	// Scale
-	m_vertBuff.bindVertexBuffer(data.m_jobs, 
+	vertBuff.bindVertexBuffer(data.m_jobs, 
 		1, GL_FLOAT, false, VERT_SIZE, offset + sizeof(F32) * 3, 6);
 
 	// Alpha
-	m_vertBuff.bindVertexBuffer(data.m_jobs, 
+	vertBuff.bindVertexBuffer(data.m_jobs, 
 		1, GL_FLOAT, false, VERT_SIZE, offset + sizeof(F32) * 4, 7);
 
+	// The vertex buffers are bound by hand, the next renderable has to set its
+	// own
+	data.m_state->invalidateVertexJobs();
+
 	data.m_jobs.drawArrays(GL_POINTS, 
-		m_aliveParticlesCount,
+		particlesCount,
 		data.m_subMeshIndicesCount);
 }
 
+//==============================================================================
+const void* ParticleEmitter::snapshotRenderState(
+	SceneFrameAllocator<U8>& alloc)
+{
+	// The next frame simulates while this one renders. Copy the vertices
+	RenderState* state = alloc.newInstance<RenderState>();
+	state->m_material = &m_particleEmitterResource->getMaterial();
+	if(m_simulation && m_simulation->getVerticesCount() > 0)
+	{
+		U32 count = m_simulation->getVerticesCount();
+		F32* verts = alloc.newArray<F32>(
+			count * ParticleSimulation::VERTEX_COMPONENTS);
+		memcpy(verts, m_simulation->getVertices(), count * VERT_SIZE);
+
+		state->m_verts = verts;
+		state->m_aliveParticlesCount = count;
+	}
+	return state;
+}
+
+//==============================================================================
+void ParticleEmitter::sortBlendedPrimitives(const Mat4& viewMat,
+	Threadpool& threadpool)
+{
+	if(m_simulation)
+	{
+		m_simulation->sortByDepth(viewMat, &threadpool);
+	}
+}
+
 //==============================================================================
 const Material& ParticleEmitter::getMaterial()
 {
@@ -356,19 +223,19 @@ void ParticleEmitter::createParticlesSimulation(SceneGraph* scene)
 //==============================================================================
 void ParticleEmitter::createParticlesSimpleSimulation(SceneGraph* scene)
 {
-	m_particles.resize(m_maxNumOfParticles);
+	// The particles don't fit the scene memory
+	HeapAllocator<U8> alloc = scene->getHeapAllocator();
+	const ParticleEmitterProperties& props = *this;
 
-	for(U i = 0; i < m_maxNumOfParticles; i++)
-	{
-		ParticleSimple* part = 
-			getSceneAllocator().newInstance<ParticleSimple>();
-
-		part->m_size = getRandom(m_particle.m_size, m_particle.m_sizeDeviation);
-		part->m_alpha = 
-			getRandom(m_particle.m_alpha, m_particle.m_alphaDeviation);
+	m_simulation =
+		getSceneAllocator().newInstance<ParticleSimulation>(props, alloc);
+}
 
-		m_particles[i] = part;
-	}
+//==============================================================================
+Bool ParticleEmitter::simulatesInSyncUpdate() const
+{
+	return m_simulation && m_simulation->getMaxParticlesCount()
+		>= ParticleSimulation::MIN_PARTICLES_FOR_PARALLEL_UPDATE;
 }
 
 //==============================================================================
@@ -377,83 +244,31 @@ void ParticleEmitter::frameUpdate(F32 prevUpdateTime, F32 crntTime,
 {
 	if(uptype == SceneNode::SYNC_UPDATE)
 	{
+		// The threads of the scene are idle in the sync update so the big
+		// simulations can use them all
+		if(simulatesInSyncUpdate())
+		{
+			m_simulation->simulate(prevUpdateTime, crntTime,
+				&getSceneGraph()._getThreadpool());
+		}
+
 		return;
 	}
 
-	// - Deactivate the dead particles
+	// - Kill the dead particles and move the rest
 	// - Calc the AABB
-	// - Calc the instancing stuff
+	// - Write the vertices
 	//
-	Vec4 aabbmin(MAX_F32, MAX_F32, MAX_F32, 0.0);
-	Vec4 aabbmax(MIN_F32, MIN_F32, MIN_F32, 0.0);
-	m_aliveParticlesCount = 0;
-
-	F32* verts = (F32*)(m_vertBuffMapping 
-		+ (getGlobTimestamp() % 3) * (m_vertBuff.getSize() / 3));
-	F32* verts_base = verts;
-	(void)verts_base;
-
-	for(ParticleBase* p : m_particles)
+	if(m_simulation && !simulatesInSyncUpdate())
 	{
-		if(p->isDead())
-		{
-			// if its already dead so dont deactivate it again
-			continue;
-		}
-
-		if(p->getTimeOfDeath() < crntTime)
-		{
-			// Just died
-			p->kill();
-		}
-		else
-		{
-			// It's alive
-
-			// Do checks
-			ANKI_ASSERT(((PtrSize)verts + VERT_SIZE 
-				- (PtrSize)m_vertBuffMapping) <= m_vertBuff.getSize());
-
-			// This will calculate a new world transformation
-			p->simulate(*this, prevUpdateTime, crntTime);
-
-			const Vec4& origin = p->getPosition();
-
-			for(U i = 0; i < 3; i++)
-			{
-				aabbmin[i] = std::min(aabbmin[i], origin[i]);
-				aabbmax[i] = std::max(aabbmax[i], origin[i]);
-			}
-
-			F32 lifePercent = (crntTime - p->getTimeOfBirth())
-				/ (p->getTimeOfDeath() - p->getTimeOfBirth());
-
-			verts[0] = origin.x();
-			verts[1] = origin.y();
-			verts[2] = origin.z();
-
-			// XXX set a flag for scale
-			verts[3] = p->m_size + (lifePercent * m_particle.m_sizeAnimation);
-
-			// Set alpha
-			if(m_particle.m_alphaAnimation)
-			{
-				verts[4] = sin((lifePercent) * getPi<F32>()) * p->m_alpha;
-			}
-			else
-			{
-				verts[4] = p->m_alpha;
-			}
-
-			++m_aliveParticlesCount;
-			verts += 5;
-		}
+		m_simulation->simulate(prevUpdateTime, crntTime, nullptr);
 	}
 
-	if(m_aliveParticlesCount != 0)
+	if(m_simulation && m_simulation->getVerticesCount() != 0)
 	{
-		Vec4 min = aabbmin - m_particle.m_size;
-		Vec4 max = aabbmax + m_particle.m_size;
+		Vec4 min = m_simulation->getAabbMin() - m_particle.m_size;
+		Vec4 max = m_simulation->getAabbMax() + m_particle.m_size;
+		min.w() = max.w() = 0.0;
 		Vec4 center = (min + max) / 2.0;
 
 		m_obb = Obb(center, Mat3x4::getIdentity(), max - center);
@@ -469,28 +284,15 @@ void ParticleEmitter::frameUpdate(F32 prevUpdateTime, F32 crntTime,
 	//
 	if(m_timeLeftForNextEmission <= 0.0)
 	{
-		U particlesCount = 0; // How many particles I am allowed to emmit
-		for(ParticleBase* pp : m_particles)
+		// The physics simulation doesn't emit yet
+		if(m_simulation)
 		{
-			ParticleBase& p = *pp;
-			if(!p.isDead())
-			{
-				// its alive so skip it
-				continue;
-			}
-
-			p.revive(*this, prevUpdateTime, crntTime);
-
-			// do the rest
-			++particlesCount;
-			if(particlesCount >= m_particlesPerEmittion)
-			{
-				break;
-			}
-		} // end for all particles
+			m_simulation->emit(crntTime, getWorldTransform().getOrigin(),
+				m_particlesPerEmittion);
+		}
 
 		m_timeLeftForNextEmission = m_emissionPeriod;
-	} // end if can emit
+	}
 	else
 	{
 		m_timeLeftForNextEmission -= crntTime - prevUpdateTime;
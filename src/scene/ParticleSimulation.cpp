@@ -0,0 +1,807 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/scene/ParticleSimulation.h"
+#include "anki/util/Functions.h"
+#include "anki/util/Exception.h"
+#include "anki/math/Simd.h"
+#include <cstring>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// Update the particles of a part of the simulation
+class SimulateParticlesTask: public Threadpool::Task
+{
+public:
+	ParticleSimulation* m_sim = nullptr;
+	F32 m_prevUpdateTime;
+	F32 m_crntTime;
+	Vec4 m_aabbMin;
+	Vec4 m_aabbMax;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		// Split in groups of 4 so only the last range has a remainder
+		const U32 count = m_sim->m_vertsCount;
+		PtrSize start, end;
+		choseStartEnd(taskId, threadsCount, (count + 3) / 4, start, end);
+
+		m_sim->simulateRange(start * 4, std::min<U32>(end * 4, count),
+			m_prevUpdateTime, m_crntTime, m_aabbMin, m_aabbMax);
+	}
+};
+
+/// Radix sort with digits of 11 bits. 3 passes cover the 32bit keys
+static const U SORT_DIGIT_BITS = 11;
+static const U SORT_BUCKETS = 1 << SORT_DIGIT_BITS;
+static const U SORT_DIGITS = 3;
+
+/// Sort a part of the particles. Every pass of the radix sort scatters the
+/// range of each task after the ranges of the previous tasks so the sort is
+/// stable
+class SortParticlesTask: public Threadpool::Task
+{
+public:
+	ParticleSimulation* m_sim = nullptr;
+	Barrier* m_barrier = nullptr;
+	/// SORT_DIGITS * SORT_BUCKETS per task. All the tasks read them
+	U32* m_histograms = nullptr;
+	/// The row of the view matrix that gives the view space z
+	Vec4 m_zRow;
+
+	static U32 getDigit(U32 key, U d)
+	{
+		return (key >> (d * SORT_DIGIT_BITS)) & (SORT_BUCKETS - 1);
+	}
+
+	U32* getHistogram(U32 taskId, U d) const
+	{
+		return m_histograms + (taskId * SORT_DIGITS + d) * SORT_BUCKETS;
+	}
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		const U COMPONENTS = ParticleSimulation::VERTEX_COMPONENTS;
+		ParticleSimulation& sim = *m_sim;
+		const U32 count = sim.m_vertsCount;
+		const F32* verts = sim.m_verts[sim.m_crntVerts];
+		PtrSize start, end;
+		choseStartEnd(taskId, threadsCount, count, start, end);
+
+		// The keys and the histograms of all the digits with one pass. The
+		// farthest particle has the smallest view space z so it goes first
+		U32* keys = sim.m_sortKeys[0];
+		U32* indices = sim.m_sortIndices[0];
+		memset(getHistogram(taskId, 0), 0,
+			SORT_DIGITS * SORT_BUCKETS * sizeof(U32));
+
+		for(PtrSize i = start; i < end; i++)
+		{
+			const F32* vert = verts + i * COMPONENTS;
+			F32 z = m_zRow.x() * vert[0] + m_zRow.y() * vert[1]
+				+ m_zRow.z() * vert[2] + m_zRow.w();
+
+			U32 key = floatToSortKey(z);
+			keys[i] = key;
+			indices[i] = i;
+
+			for(U d = 0; d < SORT_DIGITS; d++)
+			{
+				++getHistogram(taskId, d)[getDigit(key, d)];
+			}
+		}
+
+		m_barrier->wait();
+
+		// Skip the digits that are the same in all keys. Decide before any
+		// histogram changes
+		Array<Bool8, SORT_DIGITS> skip;
+		for(U d = 0; d < SORT_DIGITS; d++)
+		{
+			U32 b = getDigit(keys[0], d);
+			U32 total = 0;
+			for(U t = 0; t < threadsCount; t++)
+			{
+				total += getHistogram(t, d)[b];
+			}
+
+			skip[d] = total == count;
+		}
+
+		U src = 0;
+		Bool first = true;
+		Array<U32, SORT_BUCKETS> offsets;
+		for(U d = 0; d < SORT_DIGITS; d++)
+		{
+			if(skip[d])
+			{
+				continue;
+			}
+
+			const U32* srcKeys = sim.m_sortKeys[src];
+			const U32* srcIndices = sim.m_sortIndices[src];
+			U32* dstKeys = sim.m_sortKeys[src ^ 1];
+			U32* dstIndices = sim.m_sortIndices[src ^ 1];
+
+			// The previous pass moved the keys between the ranges
+			if(!first)
+			{
+				U32* hist = getHistogram(taskId, d);
+				memset(hist, 0, SORT_BUCKETS * sizeof(U32));
+				for(PtrSize i = start; i < end; i++)
+				{
+					++hist[getDigit(srcKeys[i], d)];
+				}
+
+				m_barrier->wait();
+			}
+
+			// A bucket of this task goes after the smaller buckets and after
+			// the same bucket of the previous tasks
+			U32 offset = 0;
+			for(U b = 0; b < SORT_BUCKETS; b++)
+			{
+				for(U t = 0; t < threadsCount; t++)
+				{
+					if(t == taskId)
+					{
+						offsets[b] = offset;
+					}
+
+					offset += getHistogram(t, d)[b];
+				}
+			}
+
+			for(PtrSize i = start; i < end; i++)
+			{
+				U32 pos = offsets[getDigit(srcKeys[i], d)]++;
+				dstKeys[pos] = srcKeys[i];
+				dstIndices[pos] = srcIndices[i];
+			}
+
+			m_barrier->wait();
+			src ^= 1;
+			first = false;
+		}
+
+		// Gather the vertices
+		const U32* sorted = sim.m_sortIndices[src];
+		for(PtrSize i = start; i < end; i++)
+		{
+			memcpy(sim.m_sortedVerts + i * COMPONENTS,
+				verts + sorted[i] * COMPONENTS, COMPONENTS * sizeof(F32));
+		}
+	}
+
+	/// Turn a float to a key that sorts like the float
+	static U32 floatToSortKey(F32 f)
+	{
+		U32 u;
+		memcpy(&u, &f, sizeof(u));
+		return (u & 0x80000000) ? ~u : (u | 0x80000000);
+	}
+};
+
+//==============================================================================
+static F32 getRandom(F32 initial, F32 deviation)
+{
+	return (deviation == 0.0)
+		? initial
+		: initial + randFloat(deviation) * 2.0 - deviation;
+}
+
+//==============================================================================
+static Vec3 getRandom(const Vec3& initial, const Vec3& deviation)
+{
+	if(deviation == Vec3(0.0))
+	{
+		return initial;
+	}
+	else
+	{
+		Vec3 out;
+		for(U i = 0; i < 3; i++)
+		{
+			out[i] = getRandom(initial[i], deviation[i]);
+		}
+		return out;
+	}
+}
+
+//==============================================================================
+/// Approximate sin(x * PI) for x in [0, 1]. The error is less than 0.002
+static F32 sinPi(F32 x)
+{
+	F32 q = x * (1.0 - x);
+	return (16.0 * q) / (5.0 - 4.0 * q);
+}
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+
+typedef __m128 F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return _mm_set1_ps(x);
+}
+
+//==============================================================================
+static inline F32x4 load(const F32* p)
+{
+	return _mm_load_ps(p);
+}
+
+//==============================================================================
+static inline void store(F32* p, F32x4 a)
+{
+	_mm_store_ps(p, a);
+}
+
+//==============================================================================
+static inline void storeUnaligned(F32* p, F32x4 a)
+{
+	_mm_storeu_ps(p, a);
+}
+
+//==============================================================================
+static inline F32x4 add(F32x4 a, F32x4 b)
+{
+	return _mm_add_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 sub(F32x4 a, F32x4 b)
+{
+	return _mm_sub_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 mul(F32x4 a, F32x4 b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 div(F32x4 a, F32x4 b)
+{
+	return _mm_div_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 min(F32x4 a, F32x4 b)
+{
+	return _mm_min_ps(a, b);
+}
+
+//==============================================================================
+static inline F32x4 max(F32x4 a, F32x4 b)
+{
+	return _mm_max_ps(a, b);
+}
+
+//==============================================================================
+static inline Bool anyLess(F32x4 a, F32x4 b)
+{
+	return _mm_movemask_ps(_mm_cmplt_ps(a, b)) != 0;
+}
+
+//==============================================================================
+static inline void transpose(F32x4& a, F32x4& b, F32x4& c, F32x4& d)
+{
+	_MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+#elif ANKI_SIMD == ANKI_SIMD_NEON
+
+typedef float32x4_t F32x4;
+
+//==============================================================================
+static inline F32x4 splat(F32 x)
+{
+	return vdupq_n_f32(x);
+}
+
+//==============================================================================
+static inline F32x4 load(const F32* p)
+{
+	return vld1q_f32(p);
+}
+
+//==============================================================================
+static inline void store(F32* p, F32x4 a)
+{
+	vst1q_f32(p, a);
+}
+
+//==============================================================================
+static inline void storeUnaligned(F32* p, F32x4 a)
+{
+	vst1q_f32(p, a);
+}
+
+//==============================================================================
+static inline F32x4 add(F32x4 a, F32x4 b)
+{
+	return vaddq_f32(a, b);
+}
+
+//==============================================================================
+static inline F32x4 sub(F32x4 a, F32x4 b)
+{
+	return vsubq_f32(a, b);
+}
+
+//==============================================================================
+static inline F32x4 mul(F32x4 a, F32x4 b)
+{
+	return vmulq_f32(a, b);
+}
+
+//==============================================================================
+static inline F32x4 div(F32x4 a, F32x4 b)
+{
+	// No division in ARMv7. Refine the reciprocal estimate twice
+	F32x4 r = vrecpeq_f32(b);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	r = vmulq_f32(vrecpsq_f32(b, r), r);
+	return vmulq_f32(a, r);
+}
+
+//==============================================================================
+static inline F32x4 min(F32x4 a, F32x4 b)
+{
+	return vminq_f32(a, b);
+}
+
+//==============================================================================
+static inline F32x4 max(F32x4 a, F32x4 b)
+{
+	return vmaxq_f32(a, b);
+}
+
+//==============================================================================
+static inline Bool anyLess(F32x4 a, F32x4 b)
+{
+	uint32x4_t m = vcltq_f32(a, b);
+	uint32x2_t m2 = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+	return vget_lane_u32(vpmax_u32(m2, m2), 0) != 0;
+}
+
+//==============================================================================
+static inline void transpose(F32x4& a, F32x4& b, F32x4& c, F32x4& d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b);
+	float32x4x2_t cd = vtrnq_f32(c, d);
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#endif
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+
+//==============================================================================
+static inline F32x4 sinPi(F32x4 x)
+{
+	F32x4 q = mul(x, sub(splat(1.0), x));
+	return div(mul(splat(16.0), q), sub(splat(5.0), mul(splat(4.0), q)));
+}
+
+//==============================================================================
+static inline F32 minComponent(F32x4 a)
+{
+	Array<F32, 4> v;
+	storeUnaligned(&v[0], a);
+	return std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+}
+
+//==============================================================================
+static inline F32 maxComponent(F32x4 a)
+{
+	Array<F32, 4> v;
+	storeUnaligned(&v[0], a);
+	return std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+}
+
+#endif
+
+//==============================================================================
+// ParticleSimulation                                                          =
+//==============================================================================
+
+//==============================================================================
+ParticleSimulation::ParticleSimulation(const ParticleEmitterProperties& props,
+	HeapAllocator<U8>& alloc)
+:	m_props(&props),
+	m_alloc(alloc),
+	m_maxParticlesCount(props.m_maxNumOfParticles)
+{
+	// Whole groups of 4 particles
+	const PtrSize stride = getAlignedRoundUp(4, m_maxParticlesCount);
+
+	for(F32*& arr : m_state)
+	{
+		arr = static_cast<F32*>(allocate(stride * sizeof(F32)));
+	}
+
+	for(F32*& verts : m_verts)
+	{
+		verts = static_cast<F32*>(
+			allocate(stride * VERTEX_COMPONENTS * sizeof(F32)));
+	}
+}
+
+//==============================================================================
+ParticleSimulation::~ParticleSimulation()
+{
+	auto free = [&](void* ptr)
+	{
+		if(ptr)
+		{
+			m_alloc.getMemoryPool().free(ptr);
+		}
+	};
+
+	for(F32* arr : m_state)
+	{
+		free(arr);
+	}
+
+	for(F32* verts : m_verts)
+	{
+		free(verts);
+	}
+
+	for(U i = 0; i < 2; i++)
+	{
+		free(m_sortKeys[i]);
+		free(m_sortIndices[i]);
+	}
+
+	free(m_sortedVerts);
+}
+
+//==============================================================================
+void* ParticleSimulation::allocate(PtrSize size)
+{
+	void* out = m_alloc.getMemoryPool().allocate(size, 16);
+	if(out == nullptr)
+	{
+		throw ANKI_EXCEPTION("Out of memory");
+	}
+
+	return out;
+}
+
+//==============================================================================
+void ParticleSimulation::removeParticle(U32 i)
+{
+	ANKI_ASSERT(i < m_aliveCount);
+	--m_aliveCount;
+
+	for(F32* arr : m_state)
+	{
+		arr[i] = arr[m_aliveCount];
+	}
+}
+
+//==============================================================================
+void ParticleSimulation::killExpiredParticles(F32 crntTime)
+{
+	const F32* death = m_state[TIME_OF_DEATH];
+	U32 i = 0;
+
+	while(i < m_aliveCount)
+	{
+		U32 end = std::min<U32>(i + 4, m_aliveCount);
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+		// Most of the groups have no dead. Skip them with one test
+		if(end - i == 4 && !anyLess(load(death + i), splat(crntTime)))
+		{
+			i = end;
+			continue;
+		}
+#endif
+
+		while(i < end)
+		{
+			if(death[i] < crntTime)
+			{
+				// The last takes its place. Test it in the next iteration
+				removeParticle(i);
+				end = std::min(end, m_aliveCount);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+}
+
+//==============================================================================
+void ParticleSimulation::simulateRange(U32 begin, U32 end,
+	F32 prevUpdateTime, F32 crntTime, Vec4& aabbMin, Vec4& aabbMax)
+{
+	const F32 dt = crntTime - prevUpdateTime;
+	const F32 sizeAnimation = m_props->m_particle.m_sizeAnimation;
+	const Bool alphaAnimation = m_props->m_particle.m_alphaAnimation;
+
+	F32* px = m_state[POSITION_X];
+	F32* py = m_state[POSITION_Y];
+	F32* pz = m_state[POSITION_Z];
+	F32* vx = m_state[VELOCITY_X];
+	F32* vy = m_state[VELOCITY_Y];
+	F32* vz = m_state[VELOCITY_Z];
+	const F32* ax = m_state[ACCELERATION_X];
+	const F32* ay = m_state[ACCELERATION_Y];
+	const F32* az = m_state[ACCELERATION_Z];
+	const F32* birth = m_state[TIME_OF_BIRTH];
+	const F32* death = m_state[TIME_OF_DEATH];
+	const F32* size = m_state[SIZE];
+	const F32* alpha = m_state[ALPHA];
+	F32* verts = m_verts[m_crntVerts];
+
+	Vec4 bmin(MAX_F32, MAX_F32, MAX_F32, 0.0);
+	Vec4 bmax(MIN_F32, MIN_F32, MIN_F32, 0.0);
+
+	U32 i = begin;
+
+#if ANKI_SIMD != ANKI_SIMD_NONE
+	ANKI_ASSERT((begin % 4) == 0);
+	const F32x4 vdt = splat(dt);
+	const F32x4 vdt2 = splat(dt * dt);
+	const F32x4 vcrntTime = splat(crntTime);
+	const F32x4 vsizeAnimation = splat(sizeAnimation);
+	F32x4 minx = splat(MAX_F32), miny = minx, minz = minx;
+	F32x4 maxx = splat(MIN_F32), maxy = maxx, maxz = maxx;
+
+	for(; i + 4 <= end; i += 4)
+	{
+		// x = a * dt^2 + v * dt + x and v = a * dt + v
+		F32x4 a = load(ax + i);
+		F32x4 v = load(vx + i);
+		F32x4 x = add(add(mul(a, vdt2), mul(v, vdt)), load(px + i));
+		store(px + i, x);
+		store(vx + i, add(mul(a, vdt), v));
+
+		a = load(ay + i);
+		v = load(vy + i);
+		F32x4 y = add(add(mul(a, vdt2), mul(v, vdt)), load(py + i));
+		store(py + i, y);
+		store(vy + i, add(mul(a, vdt), v));
+
+		a = load(az + i);
+		v = load(vz + i);
+		F32x4 z = add(add(mul(a, vdt2), mul(v, vdt)), load(pz + i));
+		store(pz + i, z);
+		store(vz + i, add(mul(a, vdt), v));
+
+		minx = min(minx, x);
+		miny = min(miny, y);
+		minz = min(minz, z);
+		maxx = max(maxx, x);
+		maxy = max(maxy, y);
+		maxz = max(maxz, z);
+
+		// Size and alpha
+		F32x4 b = load(birth + i);
+		F32x4 lifePercent = div(sub(vcrntTime, b), sub(load(death + i), b));
+		F32x4 s = add(load(size + i), mul(lifePercent, vsizeAnimation));
+		F32x4 al = load(alpha + i);
+		if(alphaAnimation)
+		{
+			al = mul(sinPi(lifePercent), al);
+		}
+
+		// Interleave. After the transpose every vector is a vertex
+		transpose(x, y, z, s);
+		Array<F32, 4> alphas;
+		storeUnaligned(&alphas[0], al);
+
+		F32* vert = verts + i * VERTEX_COMPONENTS;
+		storeUnaligned(vert, x);
+		vert[4] = alphas[0];
+		storeUnaligned(vert + 5, y);
+		vert[9] = alphas[1];
+		storeUnaligned(vert + 10, z);
+		vert[14] = alphas[2];
+		storeUnaligned(vert + 15, s);
+		vert[19] = alphas[3];
+	}
+
+	bmin = Vec4(minComponent(minx), minComponent(miny), minComponent(minz),
+		0.0);
+	bmax = Vec4(maxComponent(maxx), maxComponent(maxy), maxComponent(maxz),
+		0.0);
+#endif
+
+	// The remainder or everything if there is no SIMD
+	for(; i < end; i++)
+	{
+		px[i] += ax[i] * (dt * dt) + vx[i] * dt;
+		py[i] += ay[i] * (dt * dt) + vy[i] * dt;
+		pz[i] += az[i] * (dt * dt) + vz[i] * dt;
+		vx[i] += ax[i] * dt;
+		vy[i] += ay[i] * dt;
+		vz[i] += az[i] * dt;
+
+		bmin.x() = std::min(bmin.x(), px[i]);
+		bmin.y() = std::min(bmin.y(), py[i]);
+		bmin.z() = std::min(bmin.z(), pz[i]);
+		bmax.x() = std::max(bmax.x(), px[i]);
+		bmax.y() = std::max(bmax.y(), py[i]);
+		bmax.z() = std::max(bmax.z(), pz[i]);
+
+		F32 lifePercent = (crntTime - birth[i]) / (death[i] - birth[i]);
+
+		F32* vert = verts + i * VERTEX_COMPONENTS;
+		vert[0] = px[i];
+		vert[1] = py[i];
+		vert[2] = pz[i];
+		vert[3] = size[i] + lifePercent * sizeAnimation;
+		vert[4] = (alphaAnimation) ? sinPi(lifePercent) * alpha[i] : alpha[i];
+	}
+
+	aabbMin = bmin;
+	aabbMax = bmax;
+}
+
+//==============================================================================
+void ParticleSimulation::simulate(F32 prevUpdateTime, F32 crntTime,
+	Threadpool* threadpool)
+{
+	killExpiredParticles(crntTime);
+
+	m_crntVerts = (m_crntVerts + 1) % m_verts.size();
+	m_vertsCount = m_aliveCount;
+
+	if(m_vertsCount == 0)
+	{
+		return;
+	}
+
+	if(threadpool == nullptr || threadpool->getThreadsCount() == 1
+		|| m_vertsCount < MIN_PARTICLES_FOR_PARALLEL_UPDATE)
+	{
+		simulateRange(0, m_vertsCount, prevUpdateTime, crntTime,
+			m_aabbMin, m_aabbMax);
+	}
+	else
+	{
+		Array<SimulateParticlesTask, Threadpool::MAX_THREADS> tasks;
+		const U threadsCount = threadpool->getThreadsCount();
+
+		for(U i = 0; i < threadsCount; i++)
+		{
+			SimulateParticlesTask& task = tasks[i];
+			task.m_sim = this;
+			task.m_prevUpdateTime = prevUpdateTime;
+			task.m_crntTime = crntTime;
+
+			threadpool->assignNewTask(i, &task);
+		}
+
+		threadpool->waitForAllThreadsToFinish();
+
+		// Merge the bounds. The empty ranges have inverted bounds
+		m_aabbMin = tasks[0].m_aabbMin;
+		m_aabbMax = tasks[0].m_aabbMax;
+		for(U i = 1; i < threadsCount; i++)
+		{
+			for(U j = 0; j < 3; j++)
+			{
+				m_aabbMin[j] = std::min(m_aabbMin[j], tasks[i].m_aabbMin[j]);
+				m_aabbMax[j] = std::max(m_aabbMax[j], tasks[i].m_aabbMax[j]);
+			}
+		}
+	}
+}
+
+//==============================================================================
+void ParticleSimulation::emit(F32 crntTime, const Vec4& origin, U32 count)
+{
+	const auto& props = m_props->m_particle;
+	count = std::min(count, m_maxParticlesCount - m_aliveCount);
+
+	while(count-- != 0)
+	{
+		const U32 i = m_aliveCount++;
+
+		Vec3 pos = getRandom(props.m_startingPos, props.m_startingPosDeviation)
+			+ origin.xyz();
+		Vec3 acc = getRandom(props.m_gravity, props.m_gravityDeviation);
+
+		m_state[POSITION_X][i] = pos.x();
+		m_state[POSITION_Y][i] = pos.y();
+		m_state[POSITION_Z][i] = pos.z();
+		m_state[VELOCITY_X][i] = 0.0;
+		m_state[VELOCITY_Y][i] = 0.0;
+		m_state[VELOCITY_Z][i] = 0.0;
+		m_state[ACCELERATION_X][i] = acc.x();
+		m_state[ACCELERATION_Y][i] = acc.y();
+		m_state[ACCELERATION_Z][i] = acc.z();
+		m_state[TIME_OF_BIRTH][i] = crntTime;
+		m_state[TIME_OF_DEATH][i] =
+			getRandom(crntTime + props.m_life, props.m_lifeDeviation);
+		m_state[SIZE][i] = getRandom(props.m_size, props.m_sizeDeviation);
+		m_state[ALPHA][i] = getRandom(props.m_alpha, props.m_alphaDeviation);
+	}
+}
+
+//==============================================================================
+void ParticleSimulation::sortByDepth(const Mat4& viewMat,
+	Threadpool* threadpool)
+{
+	if(m_vertsCount < 2)
+	{
+		return;
+	}
+
+	if(m_sortedVerts == nullptr)
+	{
+		const PtrSize stride = getAlignedRoundUp(4, m_maxParticlesCount);
+		for(U i = 0; i < 2; i++)
+		{
+			m_sortKeys[i] = static_cast<U32*>(allocate(stride * sizeof(U32)));
+			m_sortIndices[i] =
+				static_cast<U32*>(allocate(stride * sizeof(U32)));
+		}
+
+		m_sortedVerts = static_cast<F32*>(
+			allocate(stride * VERTEX_COMPONENTS * sizeof(F32)));
+	}
+
+	U threadsCount = 1;
+	if(threadpool && m_vertsCount >= MIN_PARTICLES_FOR_PARALLEL_UPDATE)
+	{
+		threadsCount = threadpool->getThreadsCount();
+	}
+
+	U32* histograms = static_cast<U32*>(allocate(
+		threadsCount * SORT_DIGITS * SORT_BUCKETS * sizeof(U32)));
+
+	Array<SortParticlesTask, Threadpool::MAX_THREADS> tasks;
+	Barrier barrier(threadsCount);
+
+	for(U i = 0; i < threadsCount; i++)
+	{
+		SortParticlesTask& task = tasks[i];
+		task.m_sim = this;
+		task.m_barrier = &barrier;
+		task.m_histograms = histograms;
+		task.m_zRow = Vec4(viewMat(2, 0), viewMat(2, 1), viewMat(2, 2),
+			viewMat(2, 3));
+	}
+
+	if(threadsCount == 1)
+	{
+		tasks[0](0, 1);
+	}
+	else
+	{
+		for(U i = 0; i < threadsCount; i++)
+		{
+			threadpool->assignNewTask(i, &tasks[i]);
+		}
+
+		threadpool->waitForAllThreadsToFinish();
+	}
+
+	m_alloc.getMemoryPool().free(histograms);
+
+	// The sorted vertices replace the vertices of the frame
+	std::swap(m_verts[m_crntVerts], m_sortedVerts);
+}
+
+} // end namespace anki
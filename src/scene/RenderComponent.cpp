@@ -34,6 +34,43 @@ struct CreateNewRenderComponentVariableVisitor
 	}
 };
 
+/// Copy the values of a RenderComponentVariable to the frame memory
+struct SnapshotRenderComponentVariableVisitor
+{
+	RenderComponentVariableSnapshot* m_out = nullptr;
+	SceneFrameAllocator<U8>* m_alloc = nullptr;
+
+	template<typename TRenderComponentVariableTemplate>
+	void visit(const TRenderComponentVariableTemplate& rvar) const
+	{
+		typedef typename TRenderComponentVariableTemplate::Type Type;
+
+		if(!rvar.hasValues())
+		{
+			m_out->m_values = nullptr;
+			return;
+		}
+
+		U32 size = rvar.getArraySize();
+		Type* values = m_alloc->template newArray<Type>(size);
+		for(U i = 0; i < size; i++)
+		{
+			values[i] = rvar[i];
+		}
+
+		m_out->m_values = values;
+	}
+};
+
+/// The frame memory is not destroyed so it doesn't hold references to the 
+/// textures. They belong to the node that the scene deletes a frame later
+template<>
+void SnapshotRenderComponentVariableVisitor::visit(
+	const RenderComponentVariableTemplate<TextureResourcePointer>& rvar) const
+{
+	m_out->m_values = (rvar.hasValues()) ? rvar.begin() : nullptr;
+}
+
 /// The names of the buildins
 static Array<const char*, (U)BuildinMaterialVariableId::COUNT - 1> 
 	buildinNames = {{
@@ -105,6 +142,42 @@ RenderComponent::~RenderComponent()
 	}
 }
 
+//==============================================================================
+const RenderableSnapshot* RenderComponent::snapshot(
+	SceneFrameAllocator<U8>& alloc)
+{
+	RenderableSnapshot* out = alloc.newInstance<RenderableSnapshot>();
+
+	out->m_buildRendering = getBuildRenderingCallback();
+	out->m_renderState = snapshotRenderState(alloc);
+	out->m_material = &getMaterial();
+	out->m_meshId = getMeshId();
+	out->m_mergeKey = getMergeKey();
+
+	out->m_variablesCount = m_vars.size();
+	out->m_variables = (out->m_variablesCount) 
+		? alloc.newArray<RenderComponentVariableSnapshot>(
+			out->m_variablesCount)
+		: nullptr;
+
+	SnapshotRenderComponentVariableVisitor vis;
+	vis.m_alloc = &alloc;
+
+	for(U i = 0; i < out->m_variablesCount; i++)
+	{
+		const RenderComponentVariable& rvar = *m_vars[i];
+		RenderComponentVariableSnapshot& var = out->m_variables[i];
+
+		var.m_mvar = &rvar.getMaterialVariable();
+		var.m_buildinId = rvar.getBuildinId();
+
+		vis.m_out = &var;
+		rvar.acceptVisitor(vis);
+	}
+
+	return out;
+}
+
 //==============================================================================
 void RenderComponent::init()
 {
@@ -0,0 +1,277 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/scene/RenderSnapshot.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/scene/Camera.h"
+#include "anki/scene/Visibility.h"
+#include "anki/scene/FrustumComponent.h"
+#include "anki/scene/RenderComponent.h"
+
+namespace anki {
+
+//==============================================================================
+void RenderSnapshot::build(SceneGraph& scene, F32 prevUpdateTime,
+	F32 crntTime, Bool debug)
+{
+	m_timestamp = getGlobTimestamp();
+	m_prevUpdateTime = prevUpdateTime;
+	m_crntTime = crntTime;
+	m_frameAlloc = scene.getFrameAllocator();
+
+	Camera& cam = scene.getActiveCamera();
+	buildFrustum(cam, m_camera);
+	m_cameraChangeTimestamp = scene.getActiveCameraChangeTimestamp();
+
+	m_ambientColor = scene.getAmbientColor();
+
+	// The lights
+	VisibilityTestResults& vi = *m_camera.m_visible;
+	m_lightsCount = vi.m_lights.size();
+	m_lights = (m_lightsCount)
+		? m_frameAlloc.newArray<LightSnapshot>(m_lightsCount)
+		: nullptr;
+
+	for(U i = 0; i < m_lightsCount; i++)
+	{
+		SceneNode* node = vi.m_lights[i].m_node;
+		ANKI_ASSERT(node->tryGetComponent<LightComponent>() != nullptr);
+		buildLight(*staticCastPtr<Light*>(node), m_lights[i]);
+	}
+
+	m_debugNodes = nullptr;
+	m_debugNodesCount = 0;
+	if(debug)
+	{
+		buildDebug(scene);
+	}
+}
+
+//==============================================================================
+const DebugNodeSnapshot* RenderSnapshot::findDebugNode(CString name) const
+{
+	for(U i = 0; i < m_debugNodesCount; i++)
+	{
+		const DebugNodeSnapshot& node = m_debugNodes[i];
+		if(node.m_name && name == CString(node.m_name))
+		{
+			return &node;
+		}
+	}
+
+	return nullptr;
+}
+
+//==============================================================================
+void RenderSnapshot::buildFrustum(SceneNode& node, FrustumSnapshot& out)
+{
+	FrustumComponent& fr = node.getComponent<FrustumComponent>();
+	const Frustum& frustum = fr.getFrustum();
+
+	out.m_uuid = node.getUuid();
+	out.m_projectionMat = fr.getProjectionMatrix();
+	out.m_viewMat = fr.getViewMatrix();
+	out.m_viewProjectionMat = fr.getViewProjectionMatrix();
+	out.m_worldTransform = frustum.getTransform();
+	out.m_origin = fr.getFrustumOrigin();
+	out.m_near = frustum.getNear();
+	out.m_far = frustum.getFar();
+	out.m_perspective = frustum.getType() == Frustum::Type::PERSPECTIVE;
+
+	if(out.m_perspective)
+	{
+		const PerspectiveFrustum& pfrustum =
+			static_cast<const PerspectiveFrustum&>(frustum);
+		out.m_fovX = pfrustum.getFovX();
+		out.m_fovY = pfrustum.getFovY();
+	}
+
+	out.m_timestamp = fr.getTimestamp();
+	out.m_lastUpdate = out.m_timestamp;
+
+	MoveComponent* move = node.tryGetComponent<MoveComponent>();
+	if(move)
+	{
+		out.m_worldTransform = move->getWorldTransform();
+		out.m_lastUpdate = std::max(out.m_lastUpdate, move->getTimestamp());
+	}
+
+	out.m_visible = &fr.getVisibilityTestResults();
+
+	// Copy what the renderer reads from the visible renderables
+	for(VisibleNode& vnode : out.m_visible->m_renderables)
+	{
+		SceneNode& rnode = *vnode.m_node;
+		RenderComponent& renderable = rnode.getComponent<RenderComponent>();
+
+		if(renderable.getHasWorldTransforms())
+		{
+			vnode.m_transforms =
+				m_frameAlloc.newArray<Transform>(vnode.m_spatialsCount);
+
+			for(U i = 0; i < vnode.m_spatialsCount; i++)
+			{
+				renderable.getRenderWorldTransform(
+					vnode.getSpatialIndex(i), vnode.m_transforms[i]);
+			}
+		}
+
+		vnode.m_distance = (rnode.getComponent<SpatialComponent>().
+			getSpatialOrigin() - out.m_origin).getLength();
+
+		vnode.m_renderable = renderable.snapshot(m_frameAlloc);
+
+		// Find the last update
+		MoveComponent* bmove = rnode.tryGetComponent<MoveComponent>();
+		FrustumComponent* bfr = rnode.tryGetComponent<FrustumComponent>();
+		SpatialComponent* sp = rnode.tryGetComponent<SpatialComponent>();
+
+		if(bmove)
+		{
+			out.m_lastUpdate =
+				std::max(out.m_lastUpdate, bmove->getTimestamp());
+		}
+
+		if(bfr)
+		{
+			out.m_lastUpdate = std::max(out.m_lastUpdate, bfr->getTimestamp());
+		}
+
+		if(sp)
+		{
+			out.m_lastUpdate = std::max(out.m_lastUpdate, sp->getTimestamp());
+		}
+	}
+}
+
+//==============================================================================
+void RenderSnapshot::buildLight(Light& light, LightSnapshot& out)
+{
+	out.m_uuid = light.getUuid();
+	out.m_type = light.getLightType();
+	out.m_worldTransform = light.getWorldTransform();
+	out.m_diffuseColor = light.getDiffuseColor();
+	out.m_specularColor = light.getSpecularColor();
+	out.m_shadow = light.getShadowEnabled();
+
+	if(light.hasLensFlare())
+	{
+		out.m_lensFlareTex = &light.getLensFlareTexture();
+		out.m_lensFlaresSize = light.getLensFlaresSize();
+		out.m_lensFlaresStretchMultiplier =
+			light.getLensFlaresStretchMultiplier();
+		out.m_lensFlaresAlpha = light.getLensFlaresAlpha();
+	}
+
+	switch(out.m_type)
+	{
+	case Light::LT_POINT:
+		out.m_radius = staticCastPtr<PointLight*>(&light)->getRadius();
+		break;
+	case Light::LT_SPOT:
+		{
+			SpotLight& spot = *staticCastPtr<SpotLight*>(&light);
+			out.m_radius = spot.getDistance();
+			out.m_innerCos = spot.getInnerAngleCos();
+			out.m_outerCos = spot.getOuterAngleCos();
+
+			const PerspectiveFrustum& frustum = spot.getFrustum();
+			for(U i = 0; i < 4; i++)
+			{
+				out.m_extendPoints[i] = out.m_worldTransform.getOrigin()
+					+ frustum.getLineSegments()[i].getDirection();
+			}
+
+			if(out.m_shadow)
+			{
+				out.m_frustum = m_frameAlloc.newInstance<FrustumSnapshot>();
+				buildFrustum(spot, *out.m_frustum);
+			}
+		}
+		break;
+	default:
+		ANKI_ASSERT(0);
+		break;
+	}
+}
+
+//==============================================================================
+void RenderSnapshot::buildDebug(SceneGraph& scene)
+{
+	if(scene.getSceneNodesCount() == 0)
+	{
+		return;
+	}
+
+	m_debugNodes = 
+		m_frameAlloc.newArray<DebugNodeSnapshot>(scene.getSceneNodesCount());
+
+	scene.iterateSceneNodes([&](SceneNode& node)
+	{
+		U spatialsCount = 0;
+		node.iterateComponentsOfType<SpatialComponent>([&](SpatialComponent&)
+		{
+			++spatialsCount;
+		});
+
+		if(spatialsCount == 0)
+		{
+			return;
+		}
+
+		DebugNodeSnapshot& out = m_debugNodes[m_debugNodesCount++];
+		out.m_uuid = node.getUuid();
+
+		CString name = node.getName();
+		if(name)
+		{
+			PtrSize size = name.getLength() + 1;
+			char* copy = m_frameAlloc.newArray<char>(size);
+			memcpy(copy, name.get(), size);
+			out.m_name = copy;
+		}
+
+		MoveComponent* move = node.tryGetComponent<MoveComponent>();
+		if(move)
+		{
+			out.m_worldTransform = move->getWorldTransform();
+		}
+
+		FrustumComponent* fr = node.tryGetComponent<FrustumComponent>();
+		if(fr)
+		{
+			const Frustum& frustum = fr->getFrustum();
+
+			out.m_hasFrustum = true;
+			out.m_frustumType = frustum.getType();
+			if(out.m_frustumType == Frustum::Type::PERSPECTIVE)
+			{
+				const PerspectiveFrustum& pfrustum =
+					static_cast<const PerspectiveFrustum&>(frustum);
+				out.m_fovX = pfrustum.getFovX();
+				out.m_fovY = pfrustum.getFovY();
+				out.m_near = pfrustum.getNear();
+				out.m_far = pfrustum.getFar();
+			}
+			else
+			{
+				out.m_frustumObb = 
+					static_cast<const OrthographicFrustum&>(frustum).getObb();
+			}
+		}
+
+		out.m_aabbs = m_frameAlloc.newArray<Aabb>(spatialsCount);
+		node.iterateComponentsOfType<SpatialComponent>(
+			[&](SpatialComponent& sp)
+		{
+			if(sp.bitsEnabled(SpatialComponent::SF_VISIBLE_CAMERA))
+			{
+				out.m_aabbs[out.m_aabbsCount++] = sp.getAabb();
+			}
+		});
+	});
+}
+
+} // end namespace anki
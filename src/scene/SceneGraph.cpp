@@ -10,6 +10,7 @@
 #include "anki/util/Exception.h"
 #include "anki/core/Counters.h"
 #include "anki/renderer/Renderer.h"
+#include "anki/resource/ResourceManager.h"
 #include "anki/misc/Xml.h"
 
 namespace anki {
@@ -32,24 +33,25 @@ struct UpdateSceneNodesJob: Threadpool::Task
 	{
 		ANKI_ASSERT(scene);
 		PtrSize start, end;
-		choseStartEnd(
-			taskId, threadsCount, scene->getSceneNodesCount(), start, end);
 
 		// First update the move components
-		scene->iterateSceneNodes(start, end, [&](SceneNode& node)
-		{
-			MoveComponent* move = node.tryGetComponent<MoveComponent>();
+		choseStartEnd(taskId, threadsCount, 
+			scene->getComponentsCount(MoveComponent::getClassType()), 
+			start, end);
 
-			if(move)
-			{
-				move->updateReal(node, prevUpdateTime, crntTime,
-					SceneComponent::ASYNC_UPDATE);
-			}
+		scene->iterateComponentsOfType<MoveComponent>(start, end, 
+			[&](MoveComponent& move)
+		{
+			move.updateReal(move.getSceneNode(), prevUpdateTime, crntTime,
+				SceneComponent::ASYNC_UPDATE);
 		});
 
 		barrier->wait();
 
 		// Update the rest of the components
+		choseStartEnd(
+			taskId, threadsCount, scene->getSceneNodesCount(), start, end);
+
 		auto moveComponentTypeId = MoveComponent::getClassType();
 		scene->iterateSceneNodes(start, end, [&](SceneNode& node)
 		{
@@ -78,21 +80,34 @@ struct UpdateSceneNodesJob: Threadpool::Task
 
 //==============================================================================
 SceneGraph::SceneGraph(AllocAlignedCallback allocCb, void* allocCbData, 
-	Threadpool* threadpool)
-:	m_alloc(StackMemoryPool(allocCb, allocCbData, ANKI_SCENE_ALLOCATOR_SIZE)),
-	m_frameAlloc(StackMemoryPool(allocCb, allocCbData, 
-		ANKI_SCENE_FRAME_ALLOCATOR_SIZE)),
+	Threadpool* threadpool, PtrSize allocatorSize)
+:	m_alloc(StackMemoryPool(allocCb, allocCbData, allocatorSize)),
+	m_heapAlloc(HeapMemoryPool(allocCb, allocCbData)),
+	m_frameAllocs{{
+		SceneAllocator<U8>(StackMemoryPool(allocCb, allocCbData, 
+			ANKI_SCENE_FRAME_ALLOCATOR_SIZE)),
+		SceneAllocator<U8>(StackMemoryPool(allocCb, allocCbData, 
+			ANKI_SCENE_FRAME_ALLOCATOR_SIZE))}},
 	m_nodes(m_alloc),
 	m_dict(10, DictionaryHasher(), DictionaryEqual(), m_alloc),
+	m_nodesPendingDeletion(m_alloc),
 	m_physics(),
 	m_sectorGroup(this),
-	m_events(this),
+	m_staticGeometry(m_heapAlloc),
+	m_occlusion(m_heapAlloc),
+	m_warmupMaterials(m_heapAlloc),
+	m_events(this, allocCb, allocCbData),
 	m_threadpool(threadpool)
 {
 	m_nodes.reserve(ANKI_SCENE_OPTIMAL_SCENE_NODES_COUNT);
 
 	m_objectsMarkedForDeletionCount.store(0);
 
+	for(SceneVector<SceneComponent*>& comps : m_components)
+	{
+		comps = SceneVector<SceneComponent*>(m_alloc);
+	}
+
 	m_ambientCol = Vec3(0.0);
 }
 
@@ -138,6 +153,11 @@ void SceneGraph::unregisterNode(SceneNode* node)
 	ANKI_ASSERT(it != m_nodes.end());
 	m_nodes.erase(it);
 
+	node->iterateComponents([&](SceneComponent& comp)
+	{
+		unregisterComponent(&comp);
+	});
+
 	// Remove from dict
 	if(node->getName())
 	{
@@ -148,6 +168,73 @@ void SceneGraph::unregisterNode(SceneNode* node)
 	}
 }
 
+//==============================================================================
+void SceneGraph::registerComponent(SceneComponent* comp)
+{
+	ANKI_ASSERT(comp->_getRegistryIndex() == MAX_U32 && "Already registered");
+	LockGuard<SpinLock> lock(m_componentsLock);
+
+	SceneVector<SceneComponent*>& comps = m_components[comp->getType()];
+	comp->_getRegistryIndex() = comps.size();
+	comps.push_back(comp);
+}
+
+//==============================================================================
+void SceneGraph::unregisterComponent(SceneComponent* comp)
+{
+	LockGuard<SpinLock> lock(m_componentsLock);
+
+	// Move the last in its place
+	SceneVector<SceneComponent*>& comps = m_components[comp->getType()];
+	U32 i = comp->_getRegistryIndex();
+	ANKI_ASSERT(i < comps.size() && comps[i] == comp);
+
+	SceneComponent* last = comps.back();
+	comps[i] = last;
+	last->_getRegistryIndex() = i;
+	comps.pop_back();
+
+	comp->_getRegistryIndex() = MAX_U32;
+}
+
+//==============================================================================
+void SceneGraph::_addMaterialForWarmup(const MaterialResourcePointer& mtl)
+{
+	// The nodes of a model share the materials
+	for(const MaterialResourcePointer& other : m_warmupMaterials)
+	{
+		if(other.get() == mtl.get())
+		{
+			return;
+		}
+	}
+
+	m_warmupMaterials.push_back(mtl);
+}
+
+//==============================================================================
+void SceneGraph::warmupMaterials()
+{
+	// The materials are loaded already. The warmup finds them in the 
+	// resource manager and creates all their pipelines at once
+	U32 count = m_warmupMaterials.size();
+	SceneFrameAllocator<U8> frameAlloc = getFrameAllocator();
+	SceneFrameVector<CString> filenames(frameAlloc);
+	SceneFrameVector<MaterialResourcePointer> materials(count, 
+		MaterialResourcePointer(), frameAlloc);
+
+	filenames.reserve(count);
+	for(const MaterialResourcePointer& mtl : m_warmupMaterials)
+	{
+		filenames.push_back(mtl.getResourceName());
+	}
+
+	Material::warmup(&filenames[0], &materials[0], count, *m_resources, 
+		*m_threadpool, m_warmupStats);
+
+	m_warmupMaterials.clear();
+}
+
 //==============================================================================
 SceneNode& SceneGraph::findSceneNode(const char* name)
 {
@@ -165,33 +252,37 @@ SceneNode* SceneGraph::tryFindSceneNode(const char* name)
 //==============================================================================
 void SceneGraph::deleteNodesMarkedForDeletion()
 {
-	SceneAllocator<SceneNode> al = m_alloc;
+	// At this point all scene threads should have finished their tasks and
+	// the frame that used the nodes pending deletion finished rendering
+	for(SceneNode* node : m_nodesPendingDeletion)
+	{
+		m_alloc.deleteInstance(node);
+	}
+
+	m_nodesPendingDeletion.clear();
 
-	/// Delete all nodes pending deletion. At this point all scene threads 
-	/// should have finished their tasks
-	while(m_objectsMarkedForDeletionCount > 0)
+	// Deleting a node may mark events
+	m_events.deleteEventsMarkedForDeletion();
+
+	if(m_objectsMarkedForDeletionCount == 0)
 	{
-		// First gather the nodes that will be deleted
-		SceneFrameVector<decltype(m_nodes)::iterator> forDeletion;
-		for(auto it = m_nodes.begin(); it != m_nodes.end(); it++)
-		{
-			if((*it)->isMarkedForDeletion())
-			{
-				forDeletion.push_back(it);
-			}
-		}
+		return;
+	}
 
-		// Now delete nodes
-		for(auto& it : forDeletion)
+	// The frame that renders while this one updates may use the nodes that
+	// were marked since. Take them out of the scene now and delete them at
+	// the next update
+	for(SceneNode* node : m_nodes)
+	{
+		if(node->isMarkedForDeletion())
 		{
-			// Remove it
-			unregisterNode(*it);
-
-			m_alloc.deleteInstance(*it);
+			m_nodesPendingDeletion.push_back(node);
 		}
+	}
 
-		// Do the same for events
-		m_events.deleteEventsMarkedForDeletion();
+	for(SceneNode* node : m_nodesPendingDeletion)
+	{
+		unregisterNode(node);
 	}
 }
 
@@ -206,12 +297,20 @@ void SceneGraph::update(F32 prevUpdateTime, F32 crntTime, Renderer& renderer)
 	// Sync point. Here we wait for all scene's threads
 	//
 
-	// Reset the framepool
-	m_frameAlloc.getMemoryPool().reset();
+	// Reset the framepool of the frame before the previous. The previous
+	// frame may still render using the other
+	m_crntFrame = (m_crntFrame + 1) % m_frameAllocs.size();
+	m_frameAllocs[m_crntFrame].getMemoryPool().reset();
 
 	// Delete nodes
 	deleteNodesMarkedForDeletion();
 
+	// Before the nodes render for the first time
+	if(!m_warmupMaterials.empty())
+	{
+		warmupMaterials();
+	}
+
 	// Sync updates
 	iterateSceneNodes([&](SceneNode& node)
 	{
@@ -230,7 +329,6 @@ void SceneGraph::update(F32 prevUpdateTime, F32 crntTime, Renderer& renderer)
 
 	// XXX Do that in parallel
 	//m_physics.update(prevUpdateTime, crntTime);
-	renderer.getTiler().updateTiles(*m_mainCam);
 	m_events.updateAllEvents(prevUpdateTime, crntTime);
 
 	// Then the rest
@@ -251,7 +349,31 @@ void SceneGraph::update(F32 prevUpdateTime, F32 crntTime, Renderer& renderer)
 
 	threadPool.waitForAllThreadsToFinish();
 
+	// The spatials that moved change sectors
+	m_sectorGroup.update();
+
+	// The static patches that were loaded since the last update
+	if(m_staticGeometry.hasPendingPatches())
+	{
+		m_staticGeometry.build(_getGlDevice());
+	}
+
 	doVisibilityTests(*m_mainCam, *this, renderer);
+	if(renderer.getOcclusionCulling())
+	{
+		cullOccludedNodes(*m_mainCam, *this);
+	}
+	sortBlendedPrimitives(*m_mainCam, *this);
+	selectLods(*m_mainCam, renderer);
+	cullVisibleClusters(*m_mainCam, *this);
+
+	// The visible textures decide what streams
+	requestVisibleTextures(*m_mainCam, renderer);
+	m_resources->updateTextureStreaming();
+
+	// Last thing. After that the renderer doesn't need the scene
+	m_snapshots[m_crntFrame].build(*this, prevUpdateTime, crntTime,
+		renderer.getDbg().getEnabled());
 
 	ANKI_COUNTER_STOP_TIMER_INC(SCENE_UPDATE_TIME);
 }
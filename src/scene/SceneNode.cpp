@@ -12,6 +12,7 @@ namespace anki {
 SceneNode::SceneNode(const CString& name, SceneGraph* scene)
 :	SceneObject(SCENE_NODE_TYPE, nullptr, scene),
 	m_name(getSceneAllocator()),
+	m_uuid(scene->_getNextNodeUuid()),
 	m_components(getSceneAllocator())
 {
 	ANKI_ASSERT(scene);
@@ -51,7 +52,17 @@ U32 SceneNode::getLastUpdateFrame() const
 void SceneNode::addComponent(SceneComponent* comp)
 {
 	ANKI_ASSERT(comp);
+	ANKI_ASSERT(&comp->getSceneNode() == this);
 	m_components.push_back(comp);
+
+	SceneComponent::Type type = comp->getType();
+	m_componentTypesMask |= SceneComponent::getTypeBit(type);
+	if(m_firstComponents[type] == nullptr)
+	{
+		m_firstComponents[type] = comp;
+	}
+
+	getSceneGraph().registerComponent(comp);
 }
 
 //==============================================================================
@@ -60,6 +71,23 @@ void SceneNode::removeComponent(SceneComponent* comp)
 	auto it = std::find(m_components.begin(), m_components.end(), comp);
 	ANKI_ASSERT(it != m_components.end());
 	m_components.erase(it);
+
+	getSceneGraph().unregisterComponent(comp);
+
+	// Find the next of the same type
+	SceneComponent::Type type = comp->getType();
+	m_firstComponents[type] = nullptr;
+	m_componentTypesMask &= ~SceneComponent::getTypeBit(type);
+
+	for(SceneComponent* other : m_components)
+	{
+		if(other->getType() == type)
+		{
+			m_firstComponents[type] = other;
+			m_componentTypesMask |= SceneComponent::getTypeBit(type);
+			break;
+		}
+	}
 }
 
 //==============================================================================
@@ -20,7 +20,10 @@ SceneObject::SceneObject(Type type, SceneObject* parent, SceneGraph* scene_)
 //==============================================================================
 SceneObject::~SceneObject()
 {
-	scene->decreaseObjectsMarkedForDeletion();
+	if(isMarkedForDeletion())
+	{
+		scene->decreaseObjectsMarkedForDeletion();
+	}
 }
 
 //==============================================================================
@@ -46,6 +49,13 @@ void SceneObject::markForDeletion()
 	{
 		flags |= MARKED_FOR_DELETION;
 		scene->increaseObjectsMarkedForDeletion();
+
+		// The event manager doesn't search for them
+		if(getType() == EVENT_TYPE)
+		{
+			scene->getEventManager()._eventMarkedForDeletion(
+				static_cast<Event*>(this));
+		}
 	}
 
 	visitChildren([](SceneObject& obj)
@@ -6,58 +6,168 @@
 #include "anki/scene/Sector.h"
 #include "anki/scene/SpatialComponent.h"
 #include "anki/scene/SceneNode.h"
-#include "anki/scene/RenderComponent.h"
-#include "anki/scene/Light.h"
-#include "anki/scene/Visibility.h"
-#include "anki/scene/FrustumComponent.h"
 #include "anki/scene/SceneGraph.h"
-#include "anki/core/Logger.h"
-#include "anki/renderer/Renderer.h"
+#include <algorithm>
 
 namespace anki {
 
 //==============================================================================
-// Portal                                                                      =
+// Misc                                                                        =
 //==============================================================================
 
 //==============================================================================
-Portal::Portal()
+/// The rect of the whole screen
+static const Vec4 FULL_RECT(-1.0, -1.0, 1.0, 1.0);
+
+/// A rect that adds nothing to a union
+static const Vec4 EMPTY_RECT(MAX_F32, MAX_F32, -MAX_F32, -MAX_F32);
+
+//==============================================================================
+static Bool isRectEmpty(const Vec4& a)
 {
-	sectors[0] = sectors[1] = nullptr;
-	open = true;
+	return a.x() >= a.z() || a.y() >= a.w();
 }
 
 //==============================================================================
-// Sector                                                                      =
+static Bool rectContains(const Vec4& a, const Vec4& b)
+{
+	return a.x() <= b.x() && a.y() <= b.y()
+		&& a.z() >= b.z() && a.w() >= b.w();
+}
+
+//==============================================================================
+static Vec4 intersectRects(const Vec4& a, const Vec4& b)
+{
+	return Vec4(std::max(a.x(), b.x()), std::max(a.y(), b.y()),
+		std::min(a.z(), b.z()), std::min(a.w(), b.w()));
+}
+
 //==============================================================================
+static Vec4 uniteRects(const Vec4& a, const Vec4& b)
+{
+	return Vec4(std::min(a.x(), b.x()), std::min(a.y(), b.y()),
+		std::max(a.z(), b.z()), std::max(a.w(), b.w()));
+}
 
 //==============================================================================
-Sector::Sector(SectorGroup* group_, const Aabb& box)
-	:	group(group_),
-		portals(group->getSceneGraph().getAllocator())
+static Bool aabbsOverlap(const Aabb& a, const Aabb& b)
 {
-	// Reserve some space for portals
-	portals.reserve(AVERAGE_PORTALS_PER_SECTOR);
+	for(U i = 0; i < 3; i++)
+	{
+		if(a.getMin()[i] > b.getMax()[i] || a.getMax()[i] < b.getMin()[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//==============================================================================
+/// The side planes meet on the eye so the shapes behind it are out
+static Bool insideSidePlanes(Frustum& frustum, const CollisionShape& cs)
+{
+	const auto& planes = frustum.getPlanes();
+	for(U i = (U)Frustum::PlaneType::LEFT; i < planes.getSize(); i++)
+	{
+		if(cs.testPlane(planes[i]) < 0.0)
+		{
+			return false;
+		}
+	}
+
+	return true;
 }
 
 //==============================================================================
-Bool Sector::placeSceneNode(SceneNode* sn)
+/// Swap the last element in the place of the removed
+template<typename T>
+static void removeFromVector(Vector<T>& vec, const T& value)
 {
-#if 0
-	// XXX Optimize
+	auto it = std::find(vec.begin(), vec.end(), value);
+	ANKI_ASSERT(it != vec.end());
+	*it = vec.back();
+	vec.pop_back();
+}
 
-	SpatialComponent* sp = sn->getSpatialComponent();
-	ANKI_ASSERT(sp);
-	if(!sp->getAabb().collide(octree.getRoot().getAabb()))
+//==============================================================================
+Bool projectToRect(const Vec4* points, U count, const Mat4& viewProjMat,
+	Vec4& rect)
+{
+	rect = EMPTY_RECT;
+	for(U i = 0; i < count; i++)
 	{
-		return false;
+		Vec4 p = viewProjMat * Vec4(points[i].xyz(), 1.0);
+		if(p.w() <= getEpsilon<F32>())
+		{
+			return false;
+		}
+
+		F32 x = p.x() / p.w();
+		F32 y = p.y() / p.w();
+		rect = uniteRects(rect, Vec4(x, y, x, y));
 	}
 
-	octree.placeSceneNode(sn);
-#endif
 	return true;
 }
 
+//==============================================================================
+Bool insidePortalRect(const Aabb& box, const Mat4& viewProjMat,
+	const Vec4& rect)
+{
+	// The frustum test is enough for the whole screen
+	if(rectContains(rect, FULL_RECT))
+	{
+		return true;
+	}
+
+	const Vec4& min = box.getMin();
+	const Vec4& max = box.getMax();
+	Array<Vec4, 8> points;
+	for(U i = 0; i < points.getSize(); i++)
+	{
+		points[i] = Vec4((i & 1) ? max.x() : min.x(),
+			(i & 2) ? max.y() : min.y(), (i & 4) ? max.z() : min.z(), 0.0);
+	}
+
+	Vec4 boxRect;
+	if(!projectToRect(&points[0], points.getSize(), viewProjMat, boxRect))
+	{
+		return true;
+	}
+
+	return boxRect.x() <= rect.z() && boxRect.z() >= rect.x()
+		&& boxRect.y() <= rect.w() && boxRect.w() >= rect.y();
+}
+
+//==============================================================================
+// Portal                                                                      =
+//==============================================================================
+
+//==============================================================================
+Portal::Portal()
+{
+	sectors[0] = sectors[1] = nullptr;
+	open = true;
+}
+
+//==============================================================================
+// Sector                                                                      =
+//==============================================================================
+
+//==============================================================================
+Sector::Sector(SectorGroup* group_, const Aabb& box, U32 index_)
+	:	group(group_),
+		portals(group->getSceneGraph().getAllocator()),
+		spatials(group->getSceneGraph().getHeapAllocator()),
+		index(index_),
+		visibleBy(VB_NONE),
+		aabb(box)
+{
+	// Reserve some space for portals
+	portals.reserve(AVERAGE_PORTALS_PER_SECTOR);
+}
+
 //==============================================================================
 void Sector::addNewPortal(Portal* portal)
 {
@@ -88,7 +198,8 @@ void Sector::removePortal(Portal* portal)
 SectorGroup::SectorGroup(SceneGraph* scene_)
 	:	scene(scene_),
 		sectors(scene->getAllocator()),
-		portals(scene->getAllocator())
+		portals(scene->getAllocator()),
+		outsideSpatials(scene->getHeapAllocator())
 {
 	ANKI_ASSERT(scene != nullptr);
 }
@@ -96,37 +207,41 @@ SectorGroup::SectorGroup(SceneGraph* scene_)
 //==============================================================================
 SectorGroup::~SectorGroup()
 {
-#if 0
+	SceneAllocator<U8> alloc = scene->getAllocator();
+
 	for(Sector* sector : sectors)
 	{
-		ANKI_DELETE(sector, scene->getAllocator());
+		alloc.deleteInstance(sector);
 	}
 
 	for(Portal* portal : portals)
 	{
-		ANKI_DELETE(portal, scene->getAllocator());
+		alloc.deleteInstance(portal);
 	}
-#endif
 }
 
 //==============================================================================
 Sector* SectorGroup::createNewSector(const Aabb& aabb)
 {
-#if 0
-	Sector* out = ANKI_NEW(Sector, scene->getAllocator(), this, aabb);
+	Sector* out = scene->getAllocator().newInstance<Sector>(
+		this, aabb, sectors.size());
 	sectors.push_back(out);
+
+	// The spatials that were placed may overlap the new sector
+	scene->iterateComponentsOfType<SpatialComponent>([](SpatialComponent& sp)
+	{
+		sp.enableBits(SpatialComponent::SF_MARKED_FOR_PLACEMENT);
+	});
+
 	return out;
-#endif
-	return nullptr;
 }
 
 //==============================================================================
-Portal* SectorGroup::createNewPortal(Sector* a, Sector* b, 
+Portal* SectorGroup::createNewPortal(Sector* a, Sector* b,
 	const Obb& collisionShape)
 {
-#if 0
 	ANKI_ASSERT(a && b);
-	Portal* out = ANKI_NEW_0(Portal, scene->getAllocator());
+	Portal* out = scene->getAllocator().newInstance<Portal>();
 
 	out->sectors[0] = a;
 	out->sectors[1] = b;
@@ -138,291 +253,228 @@ Portal* SectorGroup::createNewPortal(Sector* a, Sector* b,
 	b->addNewPortal(out);
 
 	return out;
-#endif
-	return nullptr;
 }
 
 //==============================================================================
-void SectorGroup::placeSceneNode(SceneNode* sn)
+void SectorGroup::update()
 {
-#if 0
-	ANKI_ASSERT(sn != nullptr);
-	SpatialComponent* sp = sn->getSpatial();
-	ANKI_ASSERT(sp);
-	const Vec3& spPos = sp->getSpatialOrigin();
-
-	// Find the candidates first. Sectors overlap, chose the smaller(??!!??)
-	Sector* sector = nullptr;
-	for(Sector* s : sectors)
+	for(Sector* sector : sectors)
 	{
-		// Find if the spatia's position is inside the sector
-		Bool inside = true;
-		for(U i = 0; i < 3; i++)
+		sector->visibleBy = VB_NONE;
+	}
+
+	// Without sectors the spatials wait to be placed when the first comes
+	if(sectors.size() == 0)
+	{
+		return;
+	}
+
+	scene->iterateComponentsOfType<SpatialComponent>([&](SpatialComponent& sp)
+	{
+		if(sp.bitsEnabled(SpatialComponent::SF_MARKED_FOR_PLACEMENT))
 		{
-			if(spPos[i] > s->getAabb().getMax()[i]
-				|| spPos[i] < s->getAabb().getMin()[i])
-			{
-				inside = false;
-				continue;
-			}
+			placeSpatial(sp);
+			sp.disableBits(SpatialComponent::SF_MARKED_FOR_PLACEMENT);
 		}
+	});
+}
+
+//==============================================================================
+void SectorGroup::placeSpatial(SpatialComponent& sp)
+{
+	removeSpatial(sp);
 
-		if(!inside)
+	for(Sector* sector : sectors)
+	{
+		if(aabbsOverlap(sector->aabb, sp.getAabb()))
 		{
-			// continue
+			sector->spatials.push_back(&sp);
+			sp.sectors.push_back(sector);
 		}
-		else
-		{
-			// No other candidate?
-			if(sector == nullptr)
-			{
-				sector = s;
-			}
-			else
-			{
-				// Other candidata so chose the smaller
-				F32 lengthSqA = (sector->getAabb().getMax()
-					- sector->getAabb().getMin()).getLengthSquared();
-
-				F32 lengthSqB = (s->getAabb().getMax()
-					- s->getAabb().getMin()).getLengthSquared();
+	}
 
-				if(lengthSqB < lengthSqA)
-				{
-					sector = s;
-				}
-			}
-		} // end if inside
+	if(sp.sectors.size() == 0)
+	{
+		outsideSpatials.push_back(&sp);
+		sp.enableBits(SpatialComponent::SF_OUTSIDE_SECTORS);
 	}
+}
 
-	// Ask the octree to place it
-	if(sector != nullptr)
+//==============================================================================
+void SectorGroup::removeSpatial(SpatialComponent& sp)
+{
+	for(Sector* sector : sp.sectors)
 	{
-		sector->octree.placeSceneNode(sn);
+		removeFromVector(sector->spatials, &sp);
 	}
-	else
+	sp.sectors.clear();
+
+	if(sp.bitsEnabled(SpatialComponent::SF_OUTSIDE_SECTORS))
 	{
-		ANKI_LOGW("Spatial outside all sectors");
+		removeFromVector(outsideSpatials, &sp);
+		sp.disableBits(SpatialComponent::SF_OUTSIDE_SECTORS);
 	}
-#endif
 }
 
 //==============================================================================
-void SectorGroup::doVisibilityTests(SceneNode& sn, VisibilityTest test,
-	Renderer* r)
+Sector* SectorGroup::findSector(const Vec4& point)
 {
-#if 0
-	// Set all sectors to not visible
+	// The sectors overlap so chose the smaller
+	Sector* out = nullptr;
+	F32 minSize = MAX_F32;
 	for(Sector* sector : sectors)
 	{
-		sector->visibleBy = VB_NONE;
+		const Aabb& box = sector->aabb;
+		Bool inside = true;
+		for(U i = 0; i < 3; i++)
+		{
+			if(point[i] > box.getMax()[i] || point[i] < box.getMin()[i])
+			{
+				inside = false;
+				break;
+			}
+		}
+
+		F32 size = (box.getMax() - box.getMin()).getLengthSquared();
+		if(inside && size < minSize)
+		{
+			out = sector;
+			minSize = size;
+		}
 	}
 
-	doVisibilityTestsInternal(sn, test, r, VB_CAMERA);
-#endif
+	return out;
 }
 
 //==============================================================================
-void SectorGroup::doVisibilityTestsInternal(SceneNode& sn, VisibilityTest test,
-	Renderer* r, VisibleBy visibleBy)
+Bool SectorGroup::findVisibleNodes(Frustum& frustum, const Mat4& viewProjMat,
+	VisibleBy visibleBy, SceneFrameVector<PortalVisibleNode>& nodes)
 {
-#if 0
-	Frustumable* fr = sn.getFrustumable();
-	ANKI_ASSERT(fr != nullptr && "sn should be frustumable");
-	fr->visible = nullptr;
-
-	SpatialComponent* sp = sn.getSpatial();
-	ANKI_ASSERT(sp != nullptr && "sn should be spatial as well");
-
-	// sn is not placed in any octree
-	if(sp->getOctreeNode() == nullptr)
+	Sector* first = findSector(frustum.getTransform().getOrigin());
+	if(first == nullptr)
 	{
-		return;
+		return false;
 	}
 
-	//
-	// Find the visible sectors
-	//
+	SceneFrameAllocator<U8> alloc = nodes.get_allocator();
+
+	// The screen rect that every sector is seen through. A sector is walked
+	// again only if it's seen through more of the screen
+	SceneFrameVector<Vec4> sectorRects(sectors.size(), EMPTY_RECT, alloc);
 
-	SceneFrameVector<Sector*> visibleSectors(scene->getFrameAllocator());
+	struct StackEntry
+	{
+		Sector* m_sector;
+		Vec4 m_rect;
+	};
 
-	// Find the sector that contains the frustumable
-	Sector& containerSector = sp->getOctreeNode()->getOctree().getSector();
-	containerSector.visibleBy |= visibleBy;
-	visibleSectors.push_back(&containerSector);
+	SceneFrameVector<StackEntry> stack(alloc);
+	stack.reserve(sectors.size());
+	stack.push_back(StackEntry{first, FULL_RECT});
 
-	// Loop all sector portals and add other sectors
-	for(Portal* portal : containerSector.portals)
+	while(stack.size() > 0)
 	{
-		if(ANKI_UNLIKELY(!portal->open))
+		StackEntry entry = stack.back();
+		stack.pop_back();
+
+		Sector& sector = *entry.m_sector;
+		Vec4& sectorRect = sectorRects[sector.index];
+		if(rectContains(sectorRect, entry.m_rect))
 		{
 			continue;
 		}
 
-		// Get the "other" sector of that portal
-		Sector* testAgainstSector;
+		sectorRect = uniteRects(sectorRect, entry.m_rect);
 
-		if(portal->sectors[0] == &containerSector)
+		// The threads of the visibility tests walk the same sectors at the
+		// same time. They don't mark them so they don't write to them
+		if(visibleBy != VB_NONE)
 		{
-			testAgainstSector = portal->sectors[1];
+			sector.visibleBy |= visibleBy;
 		}
-		else
-		{
-			ANKI_ASSERT(portal->sectors[1] == &containerSector);
-			testAgainstSector = portal->sectors[0];
-		}
-		ANKI_ASSERT(testAgainstSector != nullptr);
-
-		// Search if portal is in the container from another portal
-		SceneVector<Sector*>::iterator it = std::find(visibleSectors.begin(),
-			visibleSectors.end(), testAgainstSector);
 
-		if(it == visibleSectors.end())
+		for(Portal* portal : sector.portals)
 		{
-			// Not found so test the portal
-
-			// Portal is visible
-			if(fr->insideFrustum(portal->shape))
+			if(!portal->open)
 			{
-				/*if(r == nullptr || r->doVisibilityTests(portal->shape))*/
-				{
-					testAgainstSector->visibleBy |= visibleBy;
-					visibleSectors.push_back(testAgainstSector);
-				}
+				continue;
 			}
-		}
-	}
-
-	//
-	// For all visible sectors do the tests
-	//
-
-	// Create a few VisibilityTestResults to pass to every octree
-	SceneVector<VisibilityTestResults> testResults(scene->getFrameAllocator());
-	testResults.resize(visibleSectors.size(), 
-		VisibilityTestResults(scene->getFrameAllocator()));
-	U renderablesCount = 0;
-	U lightsCount = 0;
-
-	// Run tests for every octree
-	for(U i = 0; i < visibleSectors.size(); i++)
-	{
-		Sector* sector = visibleSectors[i];
-
-		sector->octree.doVisibilityTests(sn, test, testResults[i]);
-
-		renderablesCount += testResults[i].renderables.size();
-		lightsCount += testResults[i].lights.size();
-	}
-
-	// If you don't want lights then the octree should do tests with them
-	ANKI_ASSERT(!((test & VT_LIGHTS) == 0 && lightsCount != 0));
-	// Same as ^
-	ANKI_ASSERT(!((test & VT_RENDERABLES) == 0 && renderablesCount != 0));
-
-	//
-	// Combine test results and try doing renderer tests
-	//
 
-	// Create the visibility container
-	VisibilityTestResults* visible =
-		ANKI_NEW(VisibilityTestResults, scene->getFrameAllocator(),
-		scene->getFrameAllocator());
-
-	// Set the sizes to save some moves
-	visible->renderables.reserve(renderablesCount);
-	visible->lights.reserve(lightsCount);
-
-	// Iterate previous test results and append to the combined one
-	if(r == nullptr)
-	{
-		for(VisibilityTestResults& testResult : testResults)
-		{
-			visible->renderables.insert(
-				visible->renderables.end(), 
-				testResult.renderables.begin(), 
-				testResult.renderables.end());
-
-			visible->lights.insert(
-				visible->lights.end(), 
-				testResult.lights.begin(), 
-				testResult.lights.end());
-		}
-	}
-	else
-	{
-		for(VisibilityTestResults& testResult : testResults)
-		{
-			// First the renderables
-			for(VisibleNode& renderable : testResult.renderables)
+			Array<Vec4, 8> points;
+			portal->shape.getExtremePoints(points);
+			Vec4 rect;
+			if(projectToRect(&points[0], points.getSize(), viewProjMat, rect))
 			{
-				/*XXX if(r->getTiler().test2(
-					renderable->getSpatial()->getOptimalCollisionShape()))*/
+				rect = intersectRects(rect, entry.m_rect);
+				if(isRectEmpty(rect)
+					|| !frustum.insideFrustum(portal->shape))
 				{
-					visible->renderables.push_back(renderable);
+					continue;
 				}
 			}
-
-			// Then the lights
-			for(VisibleNode& light : testResult.lights)
+			else
 			{
-				/*XXX if(r->doVisibilityTests(
-					light->getSpatial()->getOptimalCollisionShape()))*/
+				// The eye may stand in the portal so it can't shrink the
+				// rect. The near plane would cull it
+				if(!insideSidePlanes(frustum, portal->shape))
 				{
-					visible->lights.push_back(light);
+					continue;
 				}
+
+				rect = entry.m_rect;
 			}
+
+			Sector* other = (portal->sectors[0] == &sector)
+				? portal->sectors[1] : portal->sectors[0];
+			ANKI_ASSERT(other != nullptr);
+			stack.push_back(StackEntry{other, rect});
 		}
 	}
 
-	// The given frustumable is finished
-	fr->visible = visible;
-
-	//
-	// Sort
-	//
-
-	Threadpool.h& threadPool = Threadpool.hSingleton::get();
+	// Gather the nodes. The nodes that span sectors and the nodes with many
+	// spatials come many times
+	for(Sector* sector : sectors)
+	{
+		const Vec4& rect = sectorRects[sector->index];
+		if(isRectEmpty(rect))
+		{
+			continue;
+		}
 
-	// Sort the renderables in a another thread
-	DistanceSortJob dsjob;
-	dsjob.nodes = visible->renderables.begin();
-	dsjob.nodesCount = visible->renderables.size();
-	dsjob.origin = sp->getSpatialOrigin();
-	threadPool.assignNewJob(0, &dsjob);
+		for(SpatialComponent* sp : sector->spatials)
+		{
+			nodes.push_back(PortalVisibleNode{&sp->getSceneNode(), rect});
+		}
+	}
 
-	// The rest of the jobs are dummy
-	Array<ThreadJobDummy, Threadpool.h::MAX_THREADS>  dummyjobs;
-	for(U i = 1; i < threadPool.getThreadsCount(); i++)
+	for(SpatialComponent* sp : outsideSpatials)
 	{
-		threadPool.assignNewJob(i, &dummyjobs[i]);
+		nodes.push_back(PortalVisibleNode{&sp->getSceneNode(), FULL_RECT});
 	}
 
-	// Sort the lights in the main thread
-	std::sort(visible->lights.begin(),
-		visible->lights.end(), DistanceSortFunctor{sp->getSpatialOrigin()});
-
-	threadPool.waitForAllJobsToFinish();
-
-	//
-	// Continue by testing the lights
-	//
-
-	for(VisibleNode& lsn : visible->lights)
+	// Keep one of every node with all of its rects
+	std::sort(nodes.begin(), nodes.end(),
+		[](const PortalVisibleNode& a, const PortalVisibleNode& b)
 	{
-		Light* l = lsn.node->getLight();
-		ANKI_ASSERT(l != nullptr);
+		return a.m_node < b.m_node;
+	});
 
-		if(l->getShadowEnabled())
+	U count = 0;
+	for(U i = 0; i < nodes.size(); i++)
+	{
+		if(count > 0 && nodes[count - 1].m_node == nodes[i].m_node)
 		{
-			ANKI_ASSERT(lsn.node->getFrustumable() != nullptr);
-
-			doVisibilityTestsInternal(*lsn.node,
-				(VisibilityTest)(VT_RENDERABLES | VT_ONLY_SHADOW_CASTERS),
-				nullptr, VB_LIGHT);
+			nodes[count - 1].m_rect =
+				uniteRects(nodes[count - 1].m_rect, nodes[i].m_rect);
+		}
+		else
+		{
+			nodes[count++] = nodes[i];
 		}
 	}
-#endif
+	nodes.resize(count);
+
+	return true;
 }
 
 } // end namespace anki
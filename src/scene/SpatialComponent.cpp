@@ -5,19 +5,24 @@
 
 #include "anki/scene/SpatialComponent.h"
 #include "anki/scene/SceneNode.h"
+#include "anki/scene/SceneGraph.h"
 
 namespace anki {
 
 //==============================================================================
 SpatialComponent::SpatialComponent(SceneNode* node, U32 flags)
-	: SceneComponent(SPATIAL_COMPONENT, node), Bitset<U8>(flags)
+	:	SceneComponent(SPATIAL_COMPONENT, node),
+		Bitset<U8>(flags),
+		sectors(node->getSceneGraph().getHeapAllocator())
 {
 	markForUpdate();
 }
 
 //==============================================================================
 SpatialComponent::~SpatialComponent()
-{}
+{
+	getSceneNode().getSceneGraph().getSectorGroup().removeSpatial(*this);
+}
 
 //==============================================================================
 Bool SpatialComponent::update(SceneNode&, F32, F32, UpdateType uptype)
@@ -31,6 +36,7 @@ Bool SpatialComponent::update(SceneNode&, F32, F32, UpdateType uptype)
 		{
 			getSpatialCollisionShape().computeAabb(aabb);
 			disableBits(SF_MARKED_FOR_UPDATE);
+			enableBits(SF_MARKED_FOR_PLACEMENT);
 		}
 	}
 
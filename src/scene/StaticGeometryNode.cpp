@@ -5,6 +5,7 @@
 
 #include "anki/scene/StaticGeometryNode.h"
 #include "anki/scene/SceneGraph.h"
+#include "anki/core/Counters.h"
 
 namespace anki {
 
@@ -58,11 +59,15 @@ StaticGeometryPatchNode::StaticGeometryPatchNode(
 
 		m_obb = &modelPatch->getBoundingShape();
 	}
+
+	getSceneGraph().getStaticGeometryPack().addPatch(this);
 }
 
 //==============================================================================
 StaticGeometryPatchNode::~StaticGeometryPatchNode()
 {
+	getSceneGraph().getStaticGeometryPack().removePatch(this);
+
 	U i = 0;
 	iterateComponentsOfType<SpatialComponent>([&](SpatialComponent& spatial)
 	{
@@ -77,28 +82,77 @@ StaticGeometryPatchNode::~StaticGeometryPatchNode()
 //==============================================================================
 void StaticGeometryPatchNode::buildRendering(RenderingBuildData& data)
 {
+	const RenderState* state = 
+		static_cast<const RenderState*>(data.m_renderState);
+	ANKI_ASSERT(state);
+	const ModelPatchBase* modelPatch = state->m_modelPatch;
+
 	Array<U32, ANKI_GL_MAX_SUB_DRAWCALLS> indicesCountArray;
 	Array<PtrSize, ANKI_GL_MAX_SUB_DRAWCALLS> indicesOffsetArray;
 	U32 drawCount;
 	GlCommandBufferHandle vertJobs;
 	GlProgramPipelineHandle ppline;
 
-	m_modelPatch->getRenderingDataSub(
+	modelPatch->getRenderingDataSub(
 		data.m_key, vertJobs, ppline, 
 		data.m_subMeshIndicesArray, data.m_subMeshIndicesCount, 
 		indicesCountArray, indicesOffsetArray, drawCount);
 
-	ppline.bind(data.m_jobs);
-	data.m_jobs.pushBackOtherCommandBuffer(vertJobs);
+	// Draw from the shared buffers if it's packed. The patches that share
+	// the buffer and the program share the vertex jobs as well
+	U32 firstIndex = 0;
+	U32 baseVertex = 0;
+	const StaticGeometryPack::Patch* packed = state->m_packed;
+	if(packed)
+	{
+		const StaticGeometryPack::MeshRange& range = packed->m_ranges[
+			std::min<U>(data.m_key.m_lod, packed->m_ranges.size() - 1)];
+
+		vertJobs = 
+			packed->m_vertJobs[modelPatch->getVertexDescIdx(data.m_key)];
+		firstIndex = range.m_firstIndex;
+		baseVertex = range.m_baseVertex;
+	}
+
+	data.m_state->bindProgramPipeline(ppline, data.m_jobs);
+	data.m_state->bindVertexJobs(vertJobs, data.m_jobs);
+
+	GLenum mode = data.m_key.m_tessellation ? GL_PATCHES : GL_TRIANGLES;
 
-	if(drawCount == 1)
+	if(data.m_clusters)
+	{
+		// Draw the ranges of the visible clusters
+		ANKI_ASSERT(drawCount == 1 && indicesOffsetArray[0] == 0);
+		const VisibleClusters& clusters = *data.m_clusters;
+
+		for(U i = 0; i < clusters.m_rangesCount; i++)
+		{
+			const IndexRange& range = clusters.m_ranges[i];
+
+			data.m_jobs.drawElements(mode, sizeof(U16),
+				range.m_indicesCount, 1, firstIndex + range.m_firstIndex,
+				baseVertex);
+		}
+
+#if ANKI_ENABLE_COUNTERS
+		U32 culled = clusters.m_culledIndicesCount;
+		ANKI_COUNTER_INC(RENDERER_TRIANGLES_COUNT, 
+			U64((indicesCountArray[0] - culled) / 3));
+		ANKI_COUNTER_INC(RENDERER_CLUSTER_TRIANGLES_CULLED, U64(culled / 3));
+#endif
+	}
+	else if(drawCount == 1)
 	{
 		data.m_jobs.drawElements(
-			data.m_key.m_tessellation ? GL_PATCHES : GL_TRIANGLES,
+			mode,
 			sizeof(U16),
 			indicesCountArray[0],
 			1,
-			indicesOffsetArray[0] / sizeof(U16));
+			firstIndex + indicesOffsetArray[0] / sizeof(U16),
+			baseVertex);
+
+		ANKI_COUNTER_INC(RENDERER_TRIANGLES_COUNT, 
+			U64(indicesCountArray[0] / 3));
 	}
 	else if(drawCount == 0)
 	{
@@ -109,6 +163,44 @@ void StaticGeometryPatchNode::buildRendering(RenderingBuildData& data)
 		// TODO Make it indirect
 		ANKI_ASSERT(0 && "TODO");
 	}
+
+#if ANKI_ENABLE_COUNTERS
+	// The triangles that the LOD didn't draw. Only the whole patch has a
+	// count to compare with
+	if(data.m_key.m_lod > 0 && drawCount == 1 
+		&& data.m_subMeshIndicesCount == 0)
+	{
+		RenderingKey key0 = data.m_key;
+		key0.m_lod = 0;
+		U32 lod0IndicesCount = modelPatch->getMesh(key0).getIndicesCount();
+		ANKI_ASSERT(lod0IndicesCount >= indicesCountArray[0]);
+
+		ANKI_COUNTER_INC(RENDERER_LOD_TRIANGLES_SAVED, 
+			U64((lod0IndicesCount - indicesCountArray[0]) / 3));
+	}
+#endif
+}
+
+//==============================================================================
+const void* StaticGeometryPatchNode::snapshotRenderState(
+	SceneFrameAllocator<U8>& alloc)
+{
+	RenderState* state = alloc.newInstance<RenderState>();
+	state->m_modelPatch = m_modelPatch;
+	state->m_packed = m_packed;
+	return state;
+}
+
+//==============================================================================
+const MeshCluster* StaticGeometryPatchNode::getClusters(U lod, U32& count)
+{
+	RenderingKey key(Pass::COLOR, 
+		std::min<U>(lod, m_modelPatch->getMeshesCount() - 1), false);
+	const ResourceVector<MeshCluster>& clusters = 
+		m_modelPatch->getMesh(key).getClusters();
+
+	count = clusters.size();
+	return (count) ? &clusters[0] : nullptr;
 }
 
 //==============================================================================
@@ -0,0 +1,442 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/scene/StaticGeometryPack.h"
+#include "anki/scene/StaticGeometryNode.h"
+#include "anki/resource/Model.h"
+#include <algorithm>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// A vertex descriptor of a buffer and a vertex program
+class VertJobsEntry
+{
+public:
+	U32 m_buffer;
+	GlProgramHandle m_prog;
+	GlCommandBufferHandle m_vertJobs;
+};
+
+//==============================================================================
+// StaticGeometryPack                                                          =
+//==============================================================================
+
+//==============================================================================
+StaticGeometryPack::StaticGeometryPack(HeapAllocator<U8>& alloc)
+:	m_alloc(alloc),
+	m_vertBuffs(alloc),
+	m_indicesBuffs(alloc),
+	m_buffers(alloc),
+	m_bufferBlocks(alloc),
+	m_freeBlocks(alloc),
+	m_patches(alloc),
+	m_pending(alloc),
+	m_clusters(alloc)
+{}
+
+//==============================================================================
+StaticGeometryPack::~StaticGeometryPack()
+{
+	for(Patch* patch : m_patches)
+	{
+		deletePatch(patch);
+	}
+}
+
+//==============================================================================
+void StaticGeometryPack::addPatch(StaticGeometryPatchNode* node)
+{
+	ANKI_ASSERT(node);
+	m_pending.push_back(node);
+}
+
+//==============================================================================
+void StaticGeometryPack::removePatch(StaticGeometryPatchNode* node)
+{
+	m_pending.erase(
+		std::remove(m_pending.begin(), m_pending.end(), node),
+		m_pending.end());
+
+	if(node->m_packed)
+	{
+		auto it = std::find(m_patches.begin(), m_patches.end(), 
+			node->m_packed);
+		ANKI_ASSERT(it != m_patches.end());
+
+		deletePatch(*it);
+		m_patches.erase(it);
+		node->m_packed = nullptr;
+	}
+
+	m_clusters.erase(
+		std::remove_if(m_clusters.begin(), m_clusters.end(),
+		[&](const Cluster& c) -> Bool
+		{
+			return c.m_node == node;
+		}),
+		m_clusters.end());
+}
+
+//==============================================================================
+void StaticGeometryPack::deletePatch(Patch* patch)
+{
+	for(Block* block : patch->m_blocks)
+	{
+		ANKI_ASSERT(block->m_users > 0);
+		if(--block->m_users > 0)
+		{
+			continue;
+		}
+
+		U32 buffer = block->m_range.m_buffer;
+		ANKI_ASSERT(m_bufferBlocks[buffer] > 0);
+		if(--m_bufferBlocks[buffer] == 0)
+		{
+			// Nothing draws from the buffer. Release it with its holes. The
+			// index stays so the ranges of the other buffers don't change
+			m_vertBuffs[buffer] = GlBufferHandle();
+			m_indicesBuffs[buffer] = GlBufferHandle();
+
+			m_freeBlocks.erase(
+				std::remove_if(m_freeBlocks.begin(), m_freeBlocks.end(),
+				[&](const Block& b) -> Bool
+				{
+					return b.m_range.m_buffer == buffer;
+				}),
+				m_freeBlocks.end());
+		}
+		else
+		{
+			m_freeBlocks.push_back(*block);
+		}
+
+		m_alloc.deleteInstance(block);
+	}
+
+	m_alloc.deleteInstance(patch);
+}
+
+//==============================================================================
+Bool StaticGeometryPack::takeFreeBlock(const MeshInfo& mesh, 
+	MeshRange& range)
+{
+	for(auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it)
+	{
+		Block& hole = *it;
+		const BufferInfo& buffer = m_buffers[hole.m_range.m_buffer];
+
+		if(buffer.m_layout != mesh.m_layout
+			|| hole.m_verticesCount < mesh.m_verticesCount
+			|| hole.m_indicesCount < mesh.m_indicesCount)
+		{
+			continue;
+		}
+
+		ANKI_ASSERT(buffer.m_vertexSize == mesh.m_vertexSize);
+		range = hole.m_range;
+
+		// The rest of the hole stays free
+		hole.m_range.m_baseVertex += mesh.m_verticesCount;
+		hole.m_range.m_firstIndex += mesh.m_indicesCount;
+		hole.m_verticesCount -= mesh.m_verticesCount;
+		hole.m_indicesCount -= mesh.m_indicesCount;
+
+		if(hole.m_verticesCount == 0 || hole.m_indicesCount == 0)
+		{
+			m_freeBlocks.erase(it);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+//==============================================================================
+void StaticGeometryPack::plan(const MeshInfo* meshes, U meshesCount,
+	PtrSize maxBufferSize, Vector<BufferInfo>& buffers, MeshRange* ranges)
+{
+	ANKI_ASSERT(meshes && ranges);
+
+	// The buffer of every layout that takes meshes
+	Vector<U32> open(buffers.get_allocator());
+
+	for(U i = 0; i < meshesCount; i++)
+	{
+		const MeshInfo& mesh = meshes[i];
+		PtrSize meshSize = PtrSize(mesh.m_verticesCount) * mesh.m_vertexSize;
+
+		// Find the buffer of the layout
+		auto it = std::find_if(open.begin(), open.end(), [&](U32 b) -> Bool
+		{
+			return buffers[b].m_layout == mesh.m_layout;
+		});
+
+		// Start a new one if it doesn't fit. An empty buffer takes it
+		// anyway
+		if(it != open.end())
+		{
+			const BufferInfo& b = buffers[*it];
+			PtrSize size = PtrSize(b.m_verticesCount) * b.m_vertexSize;
+			if(size + meshSize > maxBufferSize)
+			{
+				open.erase(it);
+				it = open.end();
+			}
+		}
+
+		if(it == open.end())
+		{
+			BufferInfo b;
+			b.m_layout = mesh.m_layout;
+			b.m_vertexSize = mesh.m_vertexSize;
+			b.m_verticesCount = 0;
+			b.m_indicesCount = 0;
+			buffers.push_back(b);
+
+			open.push_back(buffers.size() - 1);
+			it = open.end() - 1;
+		}
+
+		BufferInfo& b = buffers[*it];
+		ANKI_ASSERT(b.m_vertexSize == mesh.m_vertexSize);
+
+		ranges[i].m_buffer = *it;
+		ranges[i].m_baseVertex = b.m_verticesCount;
+		ranges[i].m_firstIndex = b.m_indicesCount;
+
+		b.m_verticesCount += mesh.m_verticesCount;
+		b.m_indicesCount += mesh.m_indicesCount;
+	}
+}
+
+//==============================================================================
+void StaticGeometryPack::build(GlDevice& gl)
+{
+	if(m_pending.size() == 0)
+	{
+		return;
+	}
+
+	// Gather the meshes. The patches and the LODs may share them
+	Vector<const Mesh*> meshes(m_alloc);
+	for(StaticGeometryPatchNode* node : m_pending)
+	{
+		const ModelPatchBase& mpatch = *node->m_modelPatch;
+		for(U lod = 0; lod < mpatch.getMeshesCount(); lod++)
+		{
+			RenderingKey key(Pass::COLOR, lod, false);
+			const Mesh* mesh = &mpatch.getMesh(key);
+			if(std::find(meshes.begin(), meshes.end(), mesh) == meshes.end())
+			{
+				meshes.push_back(mesh);
+			}
+		}
+	}
+
+	Vector<MeshInfo> infos(meshes.size(), MeshInfo(), m_alloc);
+	for(U i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& mesh = *meshes[i];
+		MeshInfo& info = infos[i];
+
+		info.m_layout = mesh.getTextureChannelsCount()
+			| (U32(mesh.hasWeights()) << 8);
+		info.m_vertexSize = mesh.calcVertexSize();
+		info.m_verticesCount = mesh.getVerticesCount();
+		info.m_indicesCount = mesh.getIndicesCount();
+	}
+
+	// Fill the holes of the old buffers first. The rest go to new buffers
+	Vector<MeshRange> ranges(meshes.size(), MeshRange(), m_alloc);
+	Vector<MeshInfo> newInfos(m_alloc);
+	Vector<U32> newMeshes(m_alloc);
+	for(U i = 0; i < meshes.size(); i++)
+	{
+		if(!takeFreeBlock(infos[i], ranges[i]))
+		{
+			newInfos.push_back(infos[i]);
+			newMeshes.push_back(i);
+		}
+	}
+
+	Vector<BufferInfo> buffers(m_alloc);
+	Vector<MeshRange> newRanges(newMeshes.size(), MeshRange(), m_alloc);
+	if(newMeshes.size() > 0)
+	{
+		plan(&newInfos[0], newInfos.size(), MAX_BUFFER_SIZE, buffers, 
+			&newRanges[0]);
+	}
+
+	// Create the buffers
+	GlCommandBufferHandle jobs(&gl);
+	U firstBuffer = m_vertBuffs.size();
+	for(const BufferInfo& b : buffers)
+	{
+		m_vertBuffs.push_back(GlBufferHandle(jobs, GL_ARRAY_BUFFER,
+			PtrSize(b.m_verticesCount) * b.m_vertexSize, 0));
+		m_indicesBuffs.push_back(GlBufferHandle(jobs,
+			GL_ELEMENT_ARRAY_BUFFER, b.m_indicesCount * sizeof(U16), 0));
+		m_buffers.push_back(b);
+		m_bufferBlocks.push_back(0);
+	}
+
+	for(U i = 0; i < newMeshes.size(); i++)
+	{
+		MeshRange& range = ranges[newMeshes[i]];
+		range = newRanges[i];
+		range.m_buffer += firstBuffer;
+	}
+
+	// Copy the meshes
+	Vector<Block*> blocks(meshes.size(), nullptr, m_alloc);
+	for(U i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& mesh = *meshes[i];
+		MeshRange& range = ranges[i];
+
+		Block* block = m_alloc.newInstance<Block>();
+		block->m_range = range;
+		block->m_verticesCount = infos[i].m_verticesCount;
+		block->m_indicesCount = infos[i].m_indicesCount;
+		block->m_users = 0;
+		blocks[i] = block;
+		++m_bufferBlocks[range.m_buffer];
+
+		GlBufferHandle buff;
+		U32 size;
+		GLenum type;
+		U32 stride;
+		U32 offset;
+
+		mesh.getBufferInfo(VertexAttribute::POSITION, buff, size, type,
+			stride, offset);
+		m_vertBuffs[range.m_buffer].copy(jobs, buff, 0,
+			range.m_baseVertex * stride, mesh.getVerticesCount() * stride);
+
+		mesh.getBufferInfo(VertexAttribute::INDICES, buff, size, type,
+			stride, offset);
+		m_indicesBuffs[range.m_buffer].copy(jobs, buff, 0,
+			range.m_firstIndex * sizeof(U16),
+			mesh.getIndicesCount() * sizeof(U16));
+	}
+
+	// The vertex descriptors of the patches. The patches that use the same
+	// buffer and vertex program share them
+	Vector<VertJobsEntry> vertJobsCache(m_alloc);
+
+	for(StaticGeometryPatchNode* node : m_pending)
+	{
+		const ModelPatchBase& mpatch = *node->m_modelPatch;
+		Patch* patch = m_alloc.newInstance<Patch>(m_alloc);
+		m_patches.push_back(patch);
+
+		for(U lod = 0; lod < mpatch.getMeshesCount(); lod++)
+		{
+			RenderingKey key(Pass::COLOR, lod, false);
+			U idx = std::find(meshes.begin(), meshes.end(),
+				&mpatch.getMesh(key)) - meshes.begin();
+			patch->m_ranges.push_back(ranges[idx]);
+
+			Block* block = blocks[idx];
+			if(std::find(patch->m_blocks.begin(), patch->m_blocks.end(),
+				block) == patch->m_blocks.end())
+			{
+				patch->m_blocks.push_back(block);
+				++block->m_users;
+			}
+		}
+
+		U lodsCount = mpatch.getLodsCount();
+		U passesCount = mpatch.getMaterial().getPassesCount();
+		patch->m_vertJobs.resize(lodsCount * passesCount);
+
+		for(U lod = 0; lod < lodsCount; lod++)
+		{
+			U meshLod = std::min<U>(lod, patch->m_ranges.size() - 1);
+			U32 buffer = patch->m_ranges[meshLod].m_buffer;
+
+			for(U pass = 0; pass < passesCount; pass++)
+			{
+				RenderingKey key((Pass)pass, lod, false);
+
+				const Mesh* mesh;
+				GlProgramHandle prog;
+				mpatch.getMeshAndProgram(key, mesh, prog);
+
+				auto it = std::find_if(vertJobsCache.begin(),
+					vertJobsCache.end(), [&](const VertJobsEntry& e) -> Bool
+				{
+					return e.m_buffer == buffer && e.m_prog == prog;
+				});
+
+				if(it == vertJobsCache.end())
+				{
+					VertJobsEntry e;
+					e.m_buffer = buffer;
+					e.m_prog = prog;
+					e.m_vertJobs = GlCommandBufferHandle(&gl);
+					mpatch.createVertexDesc(key, m_vertBuffs[buffer],
+						m_indicesBuffs[buffer], e.m_vertJobs);
+
+					vertJobsCache.push_back(e);
+					it = vertJobsCache.end() - 1;
+				}
+
+				patch->m_vertJobs[mpatch.getVertexDescIdx(key)] =
+					it->m_vertJobs;
+			}
+		}
+
+		// The clusters of the LOD 0
+		const MeshRange& range = patch->m_ranges[0];
+		const Mesh& mesh = mpatch.getMesh(RenderingKey(Pass::COLOR, 0, false));
+
+		Cluster cluster;
+		cluster.m_draw.m_instanceCount = 1;
+		cluster.m_draw.m_baseVertex = range.m_baseVertex;
+		cluster.m_draw.m_baseInstance = 0;
+		cluster.m_buffer = range.m_buffer;
+		cluster.m_node = node;
+
+		if(mesh.getSubMeshesCount() == 0)
+		{
+			cluster.m_draw.m_count = mesh.getIndicesCount();
+			cluster.m_draw.m_firstIndex = range.m_firstIndex;
+			cluster.m_bounds = mesh.getBoundingShape();
+			m_clusters.push_back(cluster);
+		}
+		else
+		{
+			for(U i = 0; i < mesh.getSubMeshesCount(); i++)
+			{
+				U32 offset;
+				cluster.m_draw.m_count = mesh.getIndicesCountSub(i, offset);
+				cluster.m_draw.m_firstIndex =
+					range.m_firstIndex + offset / sizeof(U16);
+				cluster.m_bounds = mesh.getBoundingShapeSub(i);
+				m_clusters.push_back(cluster);
+			}
+		}
+
+		node->m_packed = patch;
+	}
+
+	jobs.finish();
+	m_pending.clear();
+
+	std::stable_sort(m_clusters.begin(), m_clusters.end(),
+		[](const Cluster& a, const Cluster& b) -> Bool
+	{
+		return a.m_buffer < b.m_buffer;
+	});
+}
+
+} // end namespace anki
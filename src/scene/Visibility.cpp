@@ -8,10 +8,16 @@
 #include "anki/scene/FrustumComponent.h"
 #include "anki/scene/Light.h"
 #include "anki/renderer/Renderer.h"
+#include "anki/resource/TextureResource.h"
 #include "anki/core/Logger.h"
+#include "anki/core/Counters.h"
 
 namespace anki {
 
+//==============================================================================
+/// The rect of the whole screen
+static const Vec4 FULL_RECT(-1.0, -1.0, 1.0, 1.0);
+
 //==============================================================================
 class VisibilityTestTask: public Threadpool::Task
 {
@@ -20,6 +26,9 @@ public:
 	SceneGraph* m_scene = nullptr;
 	SceneNode* frustumableSn = nullptr;
 	SceneFrameAllocator<U8> frameAlloc;
+	/// The nodes that the portals show to the camera. If it's null all the
+	/// nodes are tested
+	const SceneFrameVector<PortalVisibleNode>* m_portalNodes = nullptr;
 
 	VisibilityTestResults* cameraVisible; // out
 
@@ -37,22 +46,36 @@ public:
 			testedNode.getComponent<FrustumComponent>();
 
 		// Chose the test range and a few other things
+		SceneFrameVector<PortalVisibleNode> lightPortalNodes(frameAlloc);
+		const SceneFrameVector<PortalVisibleNode>* portalNodes;
 		PtrSize start, end;
 		if(!isLight)
 		{
-			choseStartEnd(threadId, threadsCount, m_nodesCount, start, end);
+			portalNodes = m_portalNodes;
+			choseStartEnd(threadId, threadsCount, 
+				portalNodes ? portalNodes->size() : m_nodesCount, start, end);
 			cameraVisible = visible;
 		}
 		else
 		{
-			// Is light
+			// Is light. It sees through the portals like the camera
+			portalNodes = &lightPortalNodes;
+			if(!m_scene->getSectorGroup().findVisibleNodes(
+				testedFr.getFrustum(), testedFr.getViewProjectionMatrix(), 
+				VB_NONE, lightPortalNodes))
+			{
+				portalNodes = nullptr;
+			}
+
 			start = 0;
-			end = m_nodesCount;
+			end = portalNodes ? portalNodes->size() : m_nodesCount;
 			testedFr.setVisibilityTestResults(visible);
 		}
 
-		// Iterate range of nodes
-		m_scene->iterateSceneNodes(start, end, [&](SceneNode& node)
+		const Mat4& viewProjMat = testedFr.getViewProjectionMatrix();
+
+		// Test a node that the portals show through a rect of the screen
+		auto testNode = [&](SceneNode& node, const Vec4& rect)
 		{
 			FrustumComponent* fr = node.tryGetComponent<FrustumComponent>();
 
@@ -62,6 +85,12 @@ public:
 				return;
 			}
 
+			// The sectors keep the nodes that wait for deletion
+			if(ANKI_UNLIKELY(node.isMarkedForDeletion()))
+			{
+				return;
+			}
+
 			VisibleNode visibleNode;
 			visibleNode.m_node = &node;
 
@@ -78,7 +107,8 @@ public:
 			node.iterateComponentsOfType<SpatialComponent>(
 				[&](SpatialComponent& sp)
 			{
-				if(testedFr.insideFrustum(sp))
+				if(testedFr.insideFrustum(sp)
+					&& insidePortalRect(sp.getAabb(), viewProjMat, rect))
 				{
 					// Inside
 					ANKI_ASSERT(spIdx < MAX_U8);
@@ -120,8 +150,22 @@ public:
 				visibleNode.m_spatialIndices[i] = sps[i].idx;
 			}
 
-			// Do something with the result
+			// The blended spatials are drawn in depth order with the other
+			// blended renderables
 			RenderComponent* r = node.tryGetComponent<RenderComponent>();
+			if(!isLight && r && count > 1
+				&& r->getMaterial().isBlendingEnabled())
+			{
+				visibleNode.m_spatialDistances =
+					frameAlloc.newArray<F32>(count);
+				for(U i = 0; i < count; i++)
+				{
+					visibleNode.m_spatialDistances[i] =
+						(sps[i].sp->getSpatialOrigin() - origin).getLength();
+				}
+			}
+
+			// Do something with the result
 			if(isLight)
 			{
 				if(r && r->getCastsShadow())
@@ -151,7 +195,24 @@ public:
 					}
 				}
 			}
-		}); // end for
+		};
+
+		// Iterate range of nodes
+		if(portalNodes)
+		{
+			for(PtrSize i = start; i < end; i++)
+			{
+				const PortalVisibleNode& pnode = (*portalNodes)[i];
+				testNode(*pnode.m_node, pnode.m_rect);
+			}
+		}
+		else
+		{
+			m_scene->iterateSceneNodes(start, end, [&](SceneNode& node)
+			{
+				testNode(node, FULL_RECT);
+			});
+		}
 	}
 
 	/// Do the tests
@@ -167,6 +228,12 @@ void doVisibilityTests(SceneNode& fsn, SceneGraph& scene,
 {
 	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
 
+	// Walk the portals. If the camera is outside all the sectors every node
+	// is tested
+	SceneFrameVector<PortalVisibleNode> portalNodes(scene.getFrameAllocator());
+	Bool portals = scene.getSectorGroup().findVisibleNodes(fr.getFrustum(),
+		fr.getViewProjectionMatrix(), VB_CAMERA, portalNodes);
+
 	//
 	// Do the tests in parallel
 	//
@@ -178,6 +245,7 @@ void doVisibilityTests(SceneNode& fsn, SceneGraph& scene,
 		jobs[i].m_scene = &scene;
 		jobs[i].frustumableSn = &fsn;
 		jobs[i].frameAlloc = scene.getFrameAllocator();
+		jobs[i].m_portalNodes = portals ? &portalNodes : nullptr;
 
 		threadPool.assignNewTask(i, &jobs[i]);
 	}
@@ -268,4 +336,574 @@ void doVisibilityTests(SceneNode& fsn, SceneGraph& scene,
 	threadPool.waitForAllThreadsToFinish();
 }
 
+//==============================================================================
+/// An occluder that the frustum sees
+class OccluderItem
+{
+public:
+	const OccluderMesh* m_mesh;
+	Mat4 m_mvp;
+};
+
+//==============================================================================
+/// Test the visible spatials of a node against the occlusion buffer
+static Bool isNodeOccluded(VisibleNode& vnode, const OcclusionBuffer& buffer)
+{
+	SceneNode& node = *vnode.m_node;
+
+	// The occluders would hide themselves
+	RenderComponent* r = node.tryGetComponent<RenderComponent>();
+	if(r && r->getOccluder())
+	{
+		return false;
+	}
+
+	Bool occluded = true;
+	U8 spIdx = 0;
+	node.iterateComponentsOfType<SpatialComponent>([&](SpatialComponent& sp)
+	{
+		U8* end = vnode.m_spatialIndices + vnode.m_spatialsCount;
+		if(occluded 
+			&& std::find(vnode.m_spatialIndices, end, spIdx) != end)
+		{
+			occluded = buffer.isOccluded(sp.getAabb());
+		}
+
+		++spIdx;
+	});
+
+	return occluded;
+}
+
+//==============================================================================
+class OcclusionCullingTask: public Threadpool::Task
+{
+public:
+	OcclusionBuffer* m_buffer = nullptr;
+	const OccluderItem* m_occluders = nullptr;
+	U32 m_occludersCount = 0;
+	VisibleNode* const* m_nodes = nullptr;
+	U32 m_nodesCount = 0;
+	Bool8* m_occluded = nullptr; // out
+	Barrier* m_barrier = nullptr;
+
+	void operator()(U32 threadId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+
+		// Set up the triangles of some occluders
+		choseStartEnd(threadId, threadsCount, m_occludersCount, start, end);
+		for(PtrSize i = start; i < end; i++)
+		{
+			const OccluderMesh& mesh = *m_occluders[i].m_mesh;
+			m_buffer->addOccluder(threadId, m_occluders[i].m_mvp, 
+				&mesh.m_positions[0], &mesh.m_indices[0], 
+				mesh.m_indices.size());
+		}
+
+		m_barrier->wait();
+
+		// Rasterize all of them in some rows
+		choseStartEnd(threadId, threadsCount, OcclusionBuffer::HEIGHT, 
+			start, end);
+		m_buffer->rasterize(start, end - start);
+
+		m_barrier->wait();
+
+		if(threadId == 0)
+		{
+			m_buffer->buildHiZ();
+		}
+
+		m_barrier->wait();
+
+		// Test some nodes
+		choseStartEnd(threadId, threadsCount, m_nodesCount, start, end);
+		for(PtrSize i = start; i < end; i++)
+		{
+			m_occluded[i] = isNodeOccluded(*m_nodes[i], *m_buffer);
+		}
+	}
+};
+
+//==============================================================================
+void cullOccludedNodes(SceneNode& fsn, SceneGraph& scene)
+{
+	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
+	VisibilityTestResults& visible = fr.getVisibilityTestResults();
+	SceneFrameAllocator<U8> alloc = scene.getFrameAllocator();
+
+	// The occluders. The renderables are sorted so the closest go first
+	SceneFrameVector<OccluderItem> occluders(alloc);
+	U32 trianglesCount = 0;
+	for(VisibleNode& vnode : visible.m_renderables)
+	{
+		RenderComponent& r = vnode.m_node->getComponent<RenderComponent>();
+		const OccluderMesh* mesh = r.getOccluder();
+		if(!mesh)
+		{
+			continue;
+		}
+
+		trianglesCount += mesh->m_indices.size() / 3;
+		if(trianglesCount > OcclusionBuffer::MAX_TRIANGLES)
+		{
+			break;
+		}
+
+		OccluderItem item;
+		item.m_mesh = mesh;
+		item.m_mvp = fr.getViewProjectionMatrix();
+		if(r.getHasWorldTransforms())
+		{
+			Transform trf;
+			r.getRenderWorldTransform(0, trf);
+			item.m_mvp = item.m_mvp * Mat4(trf);
+		}
+
+		occluders.push_back(item);
+	}
+
+	if(occluders.size() == 0)
+	{
+		return;
+	}
+
+	ANKI_COUNTER_START_TIMER(SCENE_OCCLUSION_TIME);
+
+	// The nodes to test
+	SceneFrameVector<VisibleNode*> nodes(alloc);
+	nodes.reserve(visible.m_renderables.size() + visible.m_lights.size());
+	for(VisibleNode& vnode : visible.m_renderables)
+	{
+		nodes.push_back(&vnode);
+	}
+
+	for(VisibleNode& vnode : visible.m_lights)
+	{
+		nodes.push_back(&vnode);
+	}
+
+	SceneFrameVector<Bool8> occluded(nodes.size(), false, alloc);
+
+	OcclusionBuffer& buffer = scene.getOcclusionBuffer();
+	buffer.clear(fr.getViewProjectionMatrix());
+
+	Threadpool& threadPool = scene._getThreadpool();
+	Barrier barrier(threadPool.getThreadsCount());
+	Array<OcclusionCullingTask, Threadpool::MAX_THREADS> jobs;
+	for(U i = 0; i < threadPool.getThreadsCount(); i++)
+	{
+		jobs[i].m_buffer = &buffer;
+		jobs[i].m_occluders = &occluders[0];
+		jobs[i].m_occludersCount = occluders.size();
+		jobs[i].m_nodes = &nodes[0];
+		jobs[i].m_nodesCount = nodes.size();
+		jobs[i].m_occluded = &occluded[0];
+		jobs[i].m_barrier = &barrier;
+
+		threadPool.assignNewTask(i, &jobs[i]);
+	}
+
+	threadPool.waitForAllThreadsToFinish();
+
+	// Remove the occluded. Keep the order
+	U32 culledCount = 0;
+	auto compact = [&](VisibilityTestResults::Container& container, 
+		const Bool8* occl)
+	{
+		U32 count = 0;
+		for(U32 i = 0; i < container.size(); i++)
+		{
+			if(occl[i])
+			{
+				container[i].m_node->iterateComponentsOfType<
+					SpatialComponent>([](SpatialComponent& sp)
+				{
+					sp.disableBits(SpatialComponent::SF_VISIBLE_CAMERA);
+				});
+				continue;
+			}
+
+			if(count != i)
+			{
+				container[count] = std::move(container[i]);
+			}
+			++count;
+		}
+
+		culledCount += container.size() - count;
+		container.resize(count);
+	};
+
+	U32 renderablesCount = visible.m_renderables.size();
+	compact(visible.m_renderables, &occluded[0]);
+	compact(visible.m_lights, &occluded[renderablesCount]);
+
+	ANKI_COUNTER_INC(SCENE_OCCLUDED_NODES, U64(culledCount));
+	ANKI_COUNTER_STOP_TIMER_INC(SCENE_OCCLUSION_TIME);
+}
+
+//==============================================================================
+void sortBlendedPrimitives(SceneNode& fsn, SceneGraph& scene)
+{
+	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
+	Threadpool& threadPool = scene._getThreadpool();
+
+	for(VisibleNode& vnode : fr.getVisibilityTestResults().m_renderables)
+	{
+		RenderComponent& r = vnode.m_node->getComponent<RenderComponent>();
+
+		if(r.getMaterial().isBlendingEnabled())
+		{
+			r.sortBlendedPrimitives(fr.getViewMatrix(), threadPool);
+		}
+	}
+}
+
+//==============================================================================
+/// The pixels of a unit at a unit of distance
+static F32 getPixelsPerUnit(FrustumComponent& fr, Renderer& renderer)
+{
+	return fr.getProjectionMatrix()(1, 1) * F32(renderer.getHeight()) * 0.5;
+}
+
+//==============================================================================
+/// Get the bounding sphere of a spatial and the distance of its closest
+/// point from the eye. The distance is at least the near plane
+static void getSpatialSphere(SpatialComponent& sp, const Vec4& eye, 
+	F32 near, F32& diameter, F32& dist)
+{
+	const Aabb& aabb = sp.getAabb();
+	Vec4 center = (aabb.getMin() + aabb.getMax()) * 0.5;
+	diameter = (aabb.getMax() - aabb.getMin()).getLength();
+	dist = (center - eye).getLength() - diameter * 0.5;
+	dist = std::max(dist, near);
+}
+
+//==============================================================================
+void requestVisibleTextures(SceneNode& fsn, Renderer& renderer)
+{
+	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
+	const Vec4& eye = fr.getFrustumOrigin();
+	F32 near = fr.getFrustum().getNear();
+	F32 pixelsPerUnit = getPixelsPerUnit(fr, renderer);
+
+	for(VisibleNode& vnode : fr.getVisibilityTestResults().m_renderables)
+	{
+		SceneNode& node = *vnode.m_node;
+
+		// The size on the screen of the bounding sphere of the spatials
+		F32 screenSize = 0.0;
+		node.iterateComponentsOfType<SpatialComponent>(
+			[&](SpatialComponent& sp)
+		{
+			F32 diameter, dist;
+			getSpatialSphere(sp, eye, near, diameter, dist);
+
+			screenSize = 
+				std::max(screenSize, diameter * pixelsPerUnit / dist);
+		});
+
+		RenderComponent& r = node.getComponent<RenderComponent>();
+		auto it = r.getVariablesBegin();
+		auto end = r.getVariablesEnd();
+		for(; it != end; ++it)
+		{
+			RenderComponentVariable* rvar = *it;
+			if(!rvar->isTypeOf<
+				RenderComponentVariableTemplate<TextureResourcePointer>>())
+			{
+				continue;
+			}
+
+			const TextureResourcePointer* tex = 
+				rvar->begin<TextureResourcePointer>();
+			const TextureResourcePointer* texEnd = 
+				rvar->end<TextureResourcePointer>();
+			for(; tex != texEnd; ++tex)
+			{
+				(*tex)->requestScreenSize(screenSize);
+			}
+		}
+	}
+}
+
+//==============================================================================
+F32 selectLod(const F32* lodErrors, U lodsCount, F32 pixelsPerUnit, 
+	F32 maxPixelError, F32 hysteresis, U prevLod)
+{
+	ANKI_ASSERT(lodErrors && lodsCount > 0);
+
+	for(U lod = 1; lod < lodsCount; lod++)
+	{
+		F32 threshold = (lod <= prevLod) 
+			? maxPixelError * (1.0 + hysteresis) 
+			: maxPixelError * (1.0 - hysteresis);
+		F32 screenError = lodErrors[lod] * pixelsPerUnit;
+
+		if(screenError > threshold)
+		{
+			// Stay at the previous. Keep the fraction under one so the
+			// integer part is the LOD
+			F32 fraction = std::min(threshold / screenError, 0.99f);
+			return F32(lod - 1) + fraction;
+		}
+	}
+
+	return F32(lodsCount - 1);
+}
+
+//==============================================================================
+/// Select the LODs of the visible renderables of a frustum as they are seen
+/// from the eye of the camera
+/// @param storeLod Remember the LOD in the renderable for the hysteresis
+static void selectLodsInternal(VisibilityTestResults& visible, 
+	const Vec4& eye, F32 near, F32 pixelsPerUnit, Renderer& renderer, 
+	Bool storeLod)
+{
+	Array<F32, MAX_LODS> errors;
+
+	for(VisibleNode& vnode : visible.m_renderables)
+	{
+		SceneNode& node = *vnode.m_node;
+		RenderComponent& r = node.getComponent<RenderComponent>();
+		U lodsCount = std::min(r.getLodsCount(), MAX_LODS);
+
+		if(lodsCount < 2)
+		{
+			vnode.m_lod = 0.0;
+			continue;
+		}
+
+		// The closest spatial decides
+		F32 minDist = MAX_F32;
+		node.iterateComponentsOfType<SpatialComponent>(
+			[&](SpatialComponent& sp)
+		{
+			F32 diameter, dist;
+			getSpatialSphere(sp, eye, near, diameter, dist);
+			minDist = std::min(minDist, dist);
+		});
+
+		for(U i = 0; i < lodsCount; i++)
+		{
+			errors[i] = r.getLodError(i);
+		}
+
+		vnode.m_lod = selectLod(&errors[0], lodsCount, 
+			pixelsPerUnit / minDist, renderer.getLodMaxPixelError(), 
+			renderer.getLodHysteresis(), r.getLod());
+
+		if(storeLod)
+		{
+			r.setLod(vnode.m_lod);
+		}
+	}
+}
+
+//==============================================================================
+void selectLods(SceneNode& fsn, Renderer& renderer)
+{
+	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
+	const Vec4& eye = fr.getFrustumOrigin();
+	F32 near = fr.getFrustum().getNear();
+	F32 pixelsPerUnit = getPixelsPerUnit(fr, renderer);
+	VisibilityTestResults& visible = fr.getVisibilityTestResults();
+
+	selectLodsInternal(visible, eye, near, pixelsPerUnit, renderer, true);
+
+	// The shadows use the LODs that the camera would. The renderables that
+	// the camera doesn't see don't change their LOD
+	for(VisibleNode& vlight : visible.m_lights)
+	{
+		FrustumComponent* lfr = 
+			vlight.m_node->tryGetComponent<FrustumComponent>();
+		Light* light = staticCastPtr<Light*>(vlight.m_node);
+
+		if(lfr && light->getShadowEnabled())
+		{
+			selectLodsInternal(lfr->getVisibilityTestResults(), eye, near,
+				pixelsPerUnit, renderer, false);
+		}
+	}
+}
+
+//==============================================================================
+U32 getClusterRanges(const MeshCluster* clusters, const U32* visible,
+	U32 visibleCount, U32 maxRanges, IndexRange* ranges)
+{
+	ANKI_ASSERT(maxRanges > 0);
+	U32 rangesCount = 0;
+
+	// Join the ranges with more culled clusters between them until they fit
+	for(U32 maxGap = 0; ; maxGap = maxGap * 2 + 1)
+	{
+		rangesCount = 0;
+		for(U32 i = 0; i < visibleCount; i++)
+		{
+			const MeshCluster& cluster = clusters[visible[i]];
+
+			if(i > 0 && visible[i] - visible[i - 1] - 1 <= maxGap)
+			{
+				IndexRange& range = ranges[rangesCount - 1];
+				range.m_indicesCount = cluster.m_firstIndex 
+					+ cluster.m_indicesCount - range.m_firstIndex;
+			}
+			else
+			{
+				IndexRange& range = ranges[rangesCount++];
+				range.m_firstIndex = cluster.m_firstIndex;
+				range.m_indicesCount = cluster.m_indicesCount;
+			}
+		}
+
+		if(rangesCount <= maxRanges)
+		{
+			break;
+		}
+	}
+
+	return rangesCount;
+}
+
+//==============================================================================
+/// The planes and the eye of a frustum for the clusters
+class ClusterCullingFrustum
+{
+public:
+	Array<Plane, (U)Frustum::PlaneType::COUNT> m_planes;
+	Vec4 m_eye;
+};
+
+//==============================================================================
+/// A visible renderable that has clusters and the frustum that saw it
+class ClusterCullingItem
+{
+public:
+	VisibleNode* m_node;
+	U32 m_frustum;
+};
+
+//==============================================================================
+class ClusterCullingTask: public Threadpool::Task
+{
+public:
+	const ClusterCullingItem* m_items = nullptr;
+	U32 m_itemsCount = 0;
+	const ClusterCullingFrustum* m_frustums = nullptr;
+	SceneFrameAllocator<U8> m_frameAlloc;
+
+	void operator()(U32 threadId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+		choseStartEnd(threadId, threadsCount, m_itemsCount, start, end);
+
+		for(PtrSize i = start; i < end; i++)
+		{
+			VisibleNode& vnode = *m_items[i].m_node;
+			const ClusterCullingFrustum& fr = m_frustums[m_items[i].m_frustum];
+			RenderComponent& r = 
+				vnode.m_node->getComponent<RenderComponent>();
+
+			U32 count;
+			const MeshCluster* clusters = r.getClusters(vnode.m_lod, count);
+			ANKI_ASSERT(clusters && count > 0);
+
+			U32* visible = m_frameAlloc.newArray<U32>(count);
+			U32 visibleCount = cullMeshClusters(clusters, count, 
+				&fr.m_planes[0], fr.m_planes.size(), &fr.m_eye, visible);
+
+			VisibleClusters* out = 
+				m_frameAlloc.newInstance<VisibleClusters>();
+			out->m_ranges = (visibleCount) 
+				? m_frameAlloc.newArray<IndexRange>(visibleCount)
+				: nullptr;
+			out->m_rangesCount = getClusterRanges(clusters, visible, 
+				visibleCount, MAX_CLUSTER_RANGES, out->m_ranges);
+
+			// The indices of the clusters are consecutive
+			U32 indicesCount = clusters[count - 1].m_firstIndex 
+				+ clusters[count - 1].m_indicesCount 
+				- clusters[0].m_firstIndex;
+			for(U32 j = 0; j < out->m_rangesCount; j++)
+			{
+				indicesCount -= out->m_ranges[j].m_indicesCount;
+			}
+			out->m_culledIndicesCount = indicesCount;
+
+			vnode.m_clusters = out;
+		}
+	}
+};
+
+//==============================================================================
+void cullVisibleClusters(SceneNode& fsn, SceneGraph& scene)
+{
+	FrustumComponent& fr = fsn.getComponent<FrustumComponent>();
+	VisibilityTestResults& visible = fr.getVisibilityTestResults();
+	SceneFrameAllocator<U8> alloc = scene.getFrameAllocator();
+
+	SceneFrameVector<ClusterCullingFrustum> frustums(alloc);
+	frustums.reserve(visible.m_lights.size() + 1);
+	SceneFrameVector<ClusterCullingItem> items(alloc);
+
+	// Gather the renderables with clusters of a frustum
+	auto gather = [&](FrustumComponent& fc)
+	{
+		ClusterCullingFrustum cfr;
+		cfr.m_planes = fc.getFrustum().getPlanes();
+		cfr.m_eye = fc.getFrustumOrigin().xyz0();
+		frustums.push_back(cfr);
+
+		for(VisibleNode& vnode : fc.getVisibilityTestResults().m_renderables)
+		{
+			RenderComponent& r = 
+				vnode.m_node->getComponent<RenderComponent>();
+
+			U32 count;
+			r.getClusters(vnode.m_lod, count);
+			if(count > 0)
+			{
+				ANKI_ASSERT(!r.getHasWorldTransforms());
+				items.push_back(
+					ClusterCullingItem{&vnode, U32(frustums.size() - 1)});
+			}
+		}
+	};
+
+	gather(fr);
+
+	for(VisibleNode& vlight : visible.m_lights)
+	{
+		FrustumComponent* lfr = 
+			vlight.m_node->tryGetComponent<FrustumComponent>();
+		Light* light = staticCastPtr<Light*>(vlight.m_node);
+
+		if(lfr && light->getShadowEnabled())
+		{
+			gather(*lfr);
+		}
+	}
+
+	if(items.size() == 0)
+	{
+		return;
+	}
+
+	Threadpool& threadPool = scene._getThreadpool();
+	Array<ClusterCullingTask, Threadpool::MAX_THREADS> jobs;
+	for(U i = 0; i < threadPool.getThreadsCount(); i++)
+	{
+		jobs[i].m_items = &items[0];
+		jobs[i].m_itemsCount = items.size();
+		jobs[i].m_frustums = &frustums[0];
+		jobs[i].m_frameAlloc = alloc;
+
+		threadPool.assignNewTask(i, &jobs[i]);
+	}
+
+	threadPool.waitForAllThreadsToFinish();
+}
+
 } // end namespace anki
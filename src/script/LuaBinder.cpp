@@ -8,24 +8,23 @@
 #include "anki/core/Logger.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 namespace anki {
 
 namespace detail {
 
 //==============================================================================
-void checkArgsCount(lua_State* l, I argsCount)
+void checkArgsCountFailed(lua_State* l, I argsCount)
 {
 	I actualArgsCount = lua_gettop(l);
-	if(argsCount != actualArgsCount)
-	{
-		luaL_error(l, "Expecting %d arguments, got %d", argsCount, 
-			actualArgsCount);
-	}
+	ANKI_ASSERT(argsCount != actualArgsCount);
+	luaL_error(l, "Expecting %d arguments, got %d", argsCount, 
+		actualArgsCount);
 }
 
 //==============================================================================
-void createClass(lua_State* l, const char* className)
+void createClass(lua_State* l, const char* className, const void* key)
 {
 	lua_newtable(l);
 	lua_setglobal(l, className);
@@ -33,6 +32,10 @@ void createClass(lua_State* l, const char* className)
 	lua_pushstring(l, "__index");
 	lua_pushvalue(l, -2);  // pushes the metatable
 	lua_settable(l, -3);  // metatable.__index = metatable
+
+	// Cache the metatable to the registry under the key as well
+	lua_pushvalue(l, -1);
+	lua_rawsetp(l, LUA_REGISTRYINDEX, key);
 }
 
 //==============================================================================
@@ -55,6 +58,10 @@ void pushCFunctionStatic(lua_State* l, const char* className,
 
 } // end namespace lua_detail
 
+//==============================================================================
+/// The block sizes of the size classes of LuaBinder
+static const U16 sizeClassSizes[] = {16, 32, 48, 64, 96, 128, 192, 256};
+
 //==============================================================================
 static int luaPanic(lua_State* l)
 {
@@ -64,7 +71,7 @@ static int luaPanic(lua_State* l)
 }
 
 //==============================================================================
-LuaBinder::LuaBinder(Allocator<U8>& alloc)
+LuaBinder::LuaBinder(const Allocator<U8>& alloc)
 {
 	m_alloc = alloc;
 
@@ -80,46 +87,136 @@ LuaBinder::~LuaBinder()
 {
 	lua_close(m_l);
 
+	Chunk* chunk = m_chunks;
+	while(chunk)
+	{
+		Chunk* next = chunk->m_next;
+		m_alloc.getMemoryPool().free(chunk);
+		chunk = next;
+	}
+
 	ANKI_ASSERT(m_alloc.getMemoryPool().getAllocationsCount() == 0 
 		&& "Leaking memory");
 }
 
+//==============================================================================
+U LuaBinder::getSizeClass(PtrSize size)
+{
+	// Indexed by the size in 16 byte units
+	static const U8 classes[] = {
+		0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7};
+
+	ANKI_ASSERT(size > 0 && size <= MAX_SMALL_SIZE);
+	return classes[(size + 15) >> 4];
+}
+
+//==============================================================================
+void* LuaBinder::allocate(PtrSize size)
+{
+	if(size > MAX_SMALL_SIZE)
+	{
+		return m_alloc.getMemoryPool().allocate(size, ANKI_SAFE_ALIGNMENT);
+	}
+
+	U cls = getSizeClass(size);
+
+	// Recycle
+	FreeBlock* block = m_freeBlocks[cls];
+	if(block)
+	{
+		m_freeBlocks[cls] = block->m_next;
+		return block;
+	}
+
+	// Carve a new block. The rest of a full chunk is left unused
+	PtrSize blockSize = sizeClassSizes[cls];
+	if(m_chunkPos + blockSize > m_chunkEnd)
+	{
+		Chunk* chunk = reinterpret_cast<Chunk*>(
+			m_alloc.getMemoryPool().allocate(CHUNK_SIZE, ANKI_SAFE_ALIGNMENT));
+		if(chunk == nullptr)
+		{
+			return nullptr;
+		}
+
+		chunk->m_next = m_chunks;
+		m_chunks = chunk;
+
+		m_chunkPos = reinterpret_cast<U8*>(chunk) + ANKI_SAFE_ALIGNMENT;
+		m_chunkEnd = reinterpret_cast<U8*>(chunk) + CHUNK_SIZE;
+	}
+
+	void* out = m_chunkPos;
+	m_chunkPos += blockSize;
+	return out;
+}
+
+//==============================================================================
+void LuaBinder::free(void* ptr, PtrSize size)
+{
+	if(size > MAX_SMALL_SIZE)
+	{
+		m_alloc.getMemoryPool().free(ptr);
+		return;
+	}
+
+	U cls = getSizeClass(size);
+	FreeBlock* block = reinterpret_cast<FreeBlock*>(ptr);
+	block->m_next = m_freeBlocks[cls];
+	m_freeBlocks[cls] = block;
+}
+
 //==============================================================================
 void* LuaBinder::luaAllocCallback(
 	void* userData, void* ptr, PtrSize osize, PtrSize nsize)
 {
 	ANKI_ASSERT(userData);
-	
 	LuaBinder& binder = *(LuaBinder*)userData;
-	void* out = nullptr;
 
-	if(nsize == 0) 
+	// On new objects the osize is the type of the object
+	if(ptr == nullptr)
+	{
+		osize = 0;
+	}
+
+	// Free
+	if(nsize == 0)
 	{
 		if(ptr != nullptr)
 		{
-			binder.m_alloc.getMemoryPool().free(ptr);
+			binder.free(ptr, osize);
 		}
+
+		return nullptr;
 	}
-	else
+
+	// Allocate
+	if(ptr == nullptr)
 	{
-		// Should be doing something like realloc
+		return binder.allocate(nsize);
+	}
 
-		if(ptr == nullptr)
-		{
-			out = binder.m_alloc.allocate(nsize);
-		}
-		else if(nsize <= osize)
+	// Realloc in place if the block stays in the same size class or if a big
+	// block doesn't shrink much
+	if(osize <= MAX_SMALL_SIZE && nsize <= MAX_SMALL_SIZE)
+	{
+		if(getSizeClass(osize) == getSizeClass(nsize))
 		{
-			out = ptr;
+			return ptr;
 		}
-		else
-		{
-			// realloc
+	}
+	else if(osize > MAX_SMALL_SIZE && nsize > MAX_SMALL_SIZE
+		&& nsize <= osize && nsize >= osize / 2)
+	{
+		return ptr;
+	}
 
-			out = binder.m_alloc.allocate(nsize);
-			std::memcpy(out, ptr, osize);
-			binder.m_alloc.getMemoryPool().free(ptr);
-		}
+	// Move it. If it fails Lua keeps the old block
+	void* out = binder.allocate(nsize);
+	if(out)
+	{
+		std::memcpy(out, ptr, std::min(osize, nsize));
+		binder.free(ptr, osize);
 	}
 
 	return out;
@@ -119,6 +119,145 @@ ANKI_SCRIPT_WRAP(Vec3)
 	ANKI_LUA_CLASS_END()
 }
 
+//==============================================================================
+/// An array of Vec3s for bulk math. Scripts that process many vectors do it
+/// in a single call instead of a call and a new userdata per vector. The 
+/// elements are stored in the lua userdata right after the array
+class Vec3Array
+{
+public:
+	U32 m_size;
+	Vec3* m_data;
+};
+
+static int vec3ArrayNew(lua_State* l)
+{
+	detail::checkArgsCount(l, 1);
+	const U32 size = luaL_checkunsigned(l, 1);
+	if(size > MAX_U32 / sizeof(Vec3) / 2)
+	{
+		luaL_error(l, "Array too big");
+	}
+
+	PtrSize storage = sizeof(detail::UserData) + sizeof(Vec3Array) 
+		+ alignof(Vec3) - 1 + size * sizeof(Vec3);
+	detail::UserData* d = (detail::UserData*)lua_newuserdata(l, storage);
+	detail::setMetatable<Vec3Array>(l);
+
+	Vec3Array* arr = ::new(d + 1) Vec3Array();
+	storage = reinterpret_cast<PtrSize>(arr + 1);
+	alignRoundUp(alignof(Vec3), storage);
+
+	arr->m_size = size;
+	arr->m_data = reinterpret_cast<Vec3*>(storage);
+	for(U32 i = 0; i < size; i++)
+	{
+		::new(&arr->m_data[i]) Vec3(0.0);
+	}
+
+	d->m_ptr = arr;
+	d->m_gc = false;
+	return 1;
+}
+
+static U32 vec3ArrayGetSize(Vec3Array* self)
+{
+	return self->m_size;
+}
+
+static Vec3 vec3ArrayGetAt(Vec3Array* self, U32 i)
+{
+	ANKI_ASSERT(i < self->m_size);
+	return self->m_data[i];
+}
+
+static void vec3ArraySetAt(Vec3Array* self, U32 i, const Vec3& v)
+{
+	ANKI_ASSERT(i < self->m_size);
+	self->m_data[i] = v;
+}
+
+static void vec3ArrayFill(Vec3Array* self, const Vec3& v)
+{
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] = v;
+	}
+}
+
+static void vec3ArrayAdd(Vec3Array* self, const Vec3Array* b)
+{
+	ANKI_ASSERT(self->m_size == b->m_size);
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] += b->m_data[i];
+	}
+}
+
+static void vec3ArraySub(Vec3Array* self, const Vec3Array* b)
+{
+	ANKI_ASSERT(self->m_size == b->m_size);
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] -= b->m_data[i];
+	}
+}
+
+static void vec3ArrayMul(Vec3Array* self, const Vec3Array* b)
+{
+	ANKI_ASSERT(self->m_size == b->m_size);
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] *= b->m_data[i];
+	}
+}
+
+static void vec3ArrayScale(Vec3Array* self, F32 f)
+{
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] *= f;
+	}
+}
+
+/// self += b * f. For example positions += velocities * dt
+static void vec3ArrayAddScaled(Vec3Array* self, const Vec3Array* b, F32 f)
+{
+	ANKI_ASSERT(self->m_size == b->m_size);
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i] += b->m_data[i] * f;
+	}
+}
+
+static void vec3ArrayNormalize(Vec3Array* self)
+{
+	for(U32 i = 0; i < self->m_size; i++)
+	{
+		self->m_data[i].normalize();
+	}
+}
+
+ANKI_SCRIPT_WRAP(Vec3Array)
+{
+	ANKI_LUA_CLASS_BEGIN(lb, Vec3Array)
+		detail::pushCFunctionStatic(l_, detail::ClassProxy<Class>::getName(),
+			"new", &vec3ArrayNew);
+		// Accessors
+		ANKI_LUA_FUNCTION_AS_METHOD("getSize", &vec3ArrayGetSize)
+		ANKI_LUA_FUNCTION_AS_METHOD("getAt", &vec3ArrayGetAt)
+		ANKI_LUA_FUNCTION_AS_METHOD("setAt", &vec3ArraySetAt)
+		// Bulk ops
+		ANKI_LUA_FUNCTION_AS_METHOD("fill", &vec3ArrayFill)
+		ANKI_LUA_FUNCTION_AS_METHOD("add", &vec3ArrayAdd)
+		ANKI_LUA_FUNCTION_AS_METHOD("sub", &vec3ArraySub)
+		ANKI_LUA_FUNCTION_AS_METHOD("mul", &vec3ArrayMul)
+		ANKI_LUA_FUNCTION_AS_METHOD("scale", &vec3ArrayScale)
+		ANKI_LUA_FUNCTION_AS_METHOD("addScaled", &vec3ArrayAddScaled)
+		ANKI_LUA_FUNCTION_AS_METHOD("normalize", &vec3ArrayNormalize)
+	ANKI_LUA_CLASS_END()
+}
+
 //==============================================================================
 static void vec4SetX(Vec4* self, F32 x)
 {
@@ -7,9 +7,66 @@
 #include "anki/util/Exception.h"
 #include "anki/core/Logger.h"
 #include "anki/script/Common.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/scene/ScriptComponent.h"
 
 namespace anki {
 
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// Run the script components of a range of nodes in the state of a thread
+class UpdateScriptComponentsTask: public Threadpool::Task
+{
+public:
+	ScriptManager* m_manager = nullptr;
+	SceneGraph* m_scene = nullptr;
+	F32 m_prevUpdateTime;
+	F32 m_crntTime;
+
+	void operator()(U32 taskId, PtrSize threadsCount)
+	{
+		PtrSize start, end;
+		choseStartEnd(
+			taskId, threadsCount, m_scene->getSceneNodesCount(), start, end);
+
+		if(start == end)
+		{
+			return;
+		}
+
+		lua_State* l = m_manager->getThreadState(taskId)._getLuaState();
+
+		m_scene->iterateSceneNodes(start, end, [&](SceneNode& node)
+		{
+			ScriptComponent* script = node.tryGetComponent<ScriptComponent>();
+			if(script == nullptr)
+			{
+				return;
+			}
+
+			lua_getglobal(l, &script->getFunction()[0]);
+			detail::PushStack<SceneNode*, BinderFlag::NONE>()(l, &node);
+			lua_pushnumber(l, m_prevUpdateTime);
+			lua_pushnumber(l, m_crntTime);
+
+			// Don't throw from a thread of the threadpool
+			if(lua_pcall(l, 3, 0, 0))
+			{
+				ANKI_LOGE("Script component failed: %s", 
+					lua_tostring(l, -1));
+				lua_pop(l, 1);
+			}
+		});
+	}
+};
+
+//==============================================================================
+// ScriptManager                                                               =
+//==============================================================================
+
 //==============================================================================
 
 /// Dummy class
@@ -42,38 +99,102 @@ ANKI_SCRIPT_WRAP(Anki)
 }
 
 //==============================================================================
-ScriptManager::ScriptManager(HeapAllocator<U8>& alloc)
-	: LuaBinder(alloc)
+ScriptManager::ScriptManager(AllocAlignedCallback allocCb, void* allocCbData,
+	U32 threadStatesCount)
+	: LuaBinder(Allocator<U8>(HeapMemoryPool(allocCb, allocCbData))),
+	m_threadStates(_getAllocator())
 {
 	ANKI_LOGI("Initializing scripting engine...");
 
+	wrapEngine(*this);
+
+	// Every thread state has its own memory pool so it can check for leaks
+	// when it's destroyed
+	HeapAllocator<U8> alloc = _getAllocator();
+	m_threadStates.reserve(threadStatesCount);
+	for(U i = 0; i < threadStatesCount; i++)
+	{
+		Allocator<U8> stateAlloc(HeapMemoryPool(allocCb, allocCbData));
+		LuaBinder* state = alloc.newInstance<LuaBinder>(stateAlloc);
+		m_threadStates.push_back(state);
+		wrapEngine(*state);
+	}
+
+	ANKI_LOGI("Scripting engine initialized");
+}
+
+//==============================================================================
+ScriptManager::~ScriptManager()
+{
+	ANKI_LOGI("Destroying scripting engine...");
+
+	HeapAllocator<U8> alloc = _getAllocator();
+	for(LuaBinder* state : m_threadStates)
+	{
+		alloc.deleteInstance(state);
+	}
+}
+
+//==============================================================================
+void ScriptManager::wrapEngine(LuaBinder& lb)
+{
 	// Global functions
-	ANKI_SCRIPT_CALL_WRAP(Anki);
+	ANKI_SCRIPT_CALL_WRAP(lb, Anki);
 
 	// Math
-	ANKI_SCRIPT_CALL_WRAP(Vec2);
-	ANKI_SCRIPT_CALL_WRAP(Vec3);
-	ANKI_SCRIPT_CALL_WRAP(Vec4);
-	ANKI_SCRIPT_CALL_WRAP(Mat3);
+	ANKI_SCRIPT_CALL_WRAP(lb, Vec2);
+	ANKI_SCRIPT_CALL_WRAP(lb, Vec3);
+	ANKI_SCRIPT_CALL_WRAP(lb, Vec3Array);
+	ANKI_SCRIPT_CALL_WRAP(lb, Vec4);
+	ANKI_SCRIPT_CALL_WRAP(lb, Mat3);
 
 	// Renderer
-	ANKI_SCRIPT_CALL_WRAP(Dbg);
-	ANKI_SCRIPT_CALL_WRAP(MainRenderer);
+	ANKI_SCRIPT_CALL_WRAP(lb, Dbg);
+	ANKI_SCRIPT_CALL_WRAP(lb, MainRenderer);
 
 	// Scene
-	ANKI_SCRIPT_CALL_WRAP(MoveComponent);
-	ANKI_SCRIPT_CALL_WRAP(SceneNode);
-	ANKI_SCRIPT_CALL_WRAP(ModelNode);
-	ANKI_SCRIPT_CALL_WRAP(InstanceNode);
-	ANKI_SCRIPT_CALL_WRAP(SceneGraph);
+	ANKI_SCRIPT_CALL_WRAP(lb, MoveComponent);
+	ANKI_SCRIPT_CALL_WRAP(lb, SceneNode);
+	ANKI_SCRIPT_CALL_WRAP(lb, ModelNode);
+	ANKI_SCRIPT_CALL_WRAP(lb, InstanceNode);
+	ANKI_SCRIPT_CALL_WRAP(lb, SceneGraph);
+}
 
-	ANKI_LOGI("Scripting engine initialized");
+//==============================================================================
+void ScriptManager::evalStringInThreadStates(const char* str)
+{
+	for(LuaBinder* state : m_threadStates)
+	{
+		state->evalString(str);
+	}
 }
 
 //==============================================================================
-ScriptManager::~ScriptManager()
+void ScriptManager::updateScriptComponents(SceneGraph& scene, 
+	F32 prevUpdateTime, F32 crntTime)
 {
-	ANKI_LOGI("Destroying scripting engine...");
+	if(m_threadStates.size() == 0)
+	{
+		return;
+	}
+
+	Threadpool& threadpool = scene._getThreadpool();
+	ANKI_ASSERT(threadpool.getThreadsCount() <= m_threadStates.size()
+		&& "Not enough thread states");
+
+	Array<UpdateScriptComponentsTask, Threadpool::MAX_THREADS> tasks;
+	for(U i = 0; i < threadpool.getThreadsCount(); i++)
+	{
+		UpdateScriptComponentsTask& task = tasks[i];
+		task.m_manager = this;
+		task.m_scene = &scene;
+		task.m_prevUpdateTime = prevUpdateTime;
+		task.m_crntTime = crntTime;
+
+		threadpool.assignNewTask(i, &task);
+	}
+
+	threadpool.waitForAllThreadsToFinish();
 }
 
 } // end namespace anki
@@ -67,11 +67,13 @@ public:
 	}
 
 	/// Assign new task to the thread
-	void assignNewTask(Threadpool::Task* task)
+	/// @param quit If true the thread will quit after the task
+	void assignNewTask(Threadpool::Task* task, Bool quit = false)
 	{
 		m_mutex.lock();
 		ANKI_ASSERT(m_task == nullptr && "Probably forgot to wait for tasks");
 		m_task = task;
+		m_quit = quit;
 		m_mutex.unlock();
 		m_condVar.notifyOne(); // Wake the thread
 	}
@@ -86,11 +88,13 @@ private:
 		Mutex& mtx = self.m_mutex; 
 		const PtrSize threadCount = self.m_threadpool->getThreadsCount();
 
-		while(!self.m_quit)
+		Bool quit = false;
+		while(!quit)
 		{
 			Threadpool::Task* task;
 
-			// Wait for something
+			// Wait for something. Read the quit flag with the task so the
+			// last task always reaches the barrier
 			{
 				LockGuard<Mutex> lock(mtx);
 				while(self.m_task == nullptr)
@@ -99,6 +103,7 @@ private:
 				}
 				task = self.m_task;
 				self.m_task = nullptr;
+				quit = self.m_quit;
 			}
 
 			// Exec
@@ -151,8 +156,7 @@ Threadpool::~Threadpool()
 	{
 		detail::ThreadpoolThread& thread = *m_threads[count];
 
-		thread.m_quit = true;
-		thread.assignNewTask(&m_dummyTask); // Wake it
+		thread.assignNewTask(&m_dummyTask, true); // Wake it
 	}
 
 	waitForAllThreadsToFinish();
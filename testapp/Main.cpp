@@ -28,6 +28,7 @@
 #include "anki/event/MoveEvent.h"
 #include "anki/core/Counters.h"
 #include "anki/core/Config.h"
+#include "anki/core/FramePipeline.h"
 
 using namespace anki;
 
@@ -35,6 +36,7 @@ ModelNode* horse;
 PerspectiveCamera* cam;
 NativeWindow* win;
 HeapAllocator<U8> globAlloc;
+FramePipeline framePipeline;
 
 //==============================================================================
 void initPhysics()
@@ -416,6 +418,15 @@ void mainLoopExtra()
 		l.getComponent<MoveComponent>().setLocalTransform(trf);
 	}*/
 
+	// The keys below change the renderer so wait for it
+	if(in.getKey(KeyCode::F1) == 1 || in.getKey(KeyCode::F2) == 1
+		|| in.getKey(KeyCode::F3) == 1 || in.getKey(KeyCode::F4) == 1
+		|| in.getKey(KeyCode::F5) == 1 || in.getKey(KeyCode::F6) == 1
+		|| in.getKey(KeyCode::F12) == 1)
+	{
+		framePipeline.flush();
+	}
+
 	if(in.getKey(KeyCode::F1) == 1)
 	{
 		MainRendererSingleton::get().getDbg().setEnabled(
@@ -512,13 +523,52 @@ end)");
 	execStdinScpripts();
 }
 
+//==============================================================================
+/// The times of the frame that updates
+struct MainLoopTimes
+{
+	HighRezTimer::Scalar m_prevUpdateTime;
+	HighRezTimer::Scalar m_crntTime;
+};
+
+//==============================================================================
+void* updateFrame(void* userData, U64 /*frame*/)
+{
+	MainLoopTimes& times = *reinterpret_cast<MainLoopTimes*>(userData);
+	times.m_prevUpdateTime = times.m_crntTime;
+	times.m_crntTime = HighRezTimer::getCurrentTime();
+
+	InputSingleton::get().handleEvents();
+	mainLoopExtra();
+
+	SceneGraph& scene = SceneGraphSingleton::get();
+	ScriptManagerSingleton::get().updateScriptComponents(scene,
+		times.m_prevUpdateTime, times.m_crntTime);
+	scene.update(times.m_prevUpdateTime, times.m_crntTime,
+		MainRendererSingleton::get());
+
+	return const_cast<RenderSnapshot*>(&scene.getRenderSnapshot());
+}
+
+//==============================================================================
+void renderFrame(void* /*userData*/, void* snapshot, U64 /*frame*/)
+{
+	MainRendererSingleton::get().render(
+		*reinterpret_cast<const RenderSnapshot*>(snapshot));
+
+	GlManagerSingleton::get().swapBuffers();
+}
+
 //==============================================================================
 void mainLoop()
 {
 	ANKI_LOGI("Entering main loop");
 
-	HighRezTimer::Scalar prevUpdateTime = HighRezTimer::getCurrentTime();
-	HighRezTimer::Scalar crntTime = prevUpdateTime;
+	MainLoopTimes times;
+	times.m_prevUpdateTime = HighRezTimer::getCurrentTime();
+	times.m_crntTime = times.m_prevUpdateTime;
+
+	framePipeline.init(true, updateFrame, renderFrame, &times);
 
 	ANKI_COUNTER_START_TIMER(FPS);
 
@@ -527,25 +577,14 @@ void mainLoop()
 		HighRezTimer timer;
 		timer.start();
 
-		prevUpdateTime = crntTime;
-		crntTime = HighRezTimer::getCurrentTime();
-
-		// Update
-		//
-		InputSingleton::get().handleEvents();
-		mainLoopExtra();
-
-		SceneGraphSingleton::get().update(
-			prevUpdateTime, crntTime, MainRendererSingleton::get());
-		//EventManagerSingleton::get().updateAllEvents(prevUpdateTime, crntTime);
-		MainRendererSingleton::get().render(SceneGraphSingleton::get());
+		// Update this frame while the previous one renders
+		framePipeline.runFrame();
 
 		if(InputSingleton::get().getKey(KeyCode::ESCAPE))
 		{
 			break;
 		}
 
-		GlManagerSingleton::get().swapBuffers();
 		ANKI_COUNTERS_RESOLVE_FRAME();
 
 		// Sleep
@@ -566,6 +605,14 @@ void mainLoop()
 		increaseGlobTimestamp();
 	}
 
+	framePipeline.flush();
+	ANKI_LOGI("Frame time %f ms, latency %f ms, update %f ms, render %f ms, "
+		"overlap %f%%",
+		framePipeline.getAverageFrameTime() * 1000.0,
+		framePipeline.getAverageLatency() * 1000.0,
+		framePipeline.getAverageUpdateTime() * 1000.0,
+		framePipeline.getAverageRenderTime() * 1000.0,
+		framePipeline.getOverlap() * 100.0);
 	
 	GlManagerSingleton::destroy();
 	ANKI_COUNTER_STOP_TIMER_INC(FPS);
@@ -662,7 +709,7 @@ void initSubsystems(int argc, char* argv[])
 	config.set("renderingQuality", 1.0);
 	config.set("width", win->getWidth());
 	config.set("height", win->getHeight());
-	config.set("lodDistance", 20.0);
+	config.set("lodMaxPixelError", 1.0);
 	config.set("samples", 1);
 	config.set("tessellation", false);
 	config.set("tilesXCount", 16);
@@ -678,7 +725,7 @@ void initSubsystems(int argc, char* argv[])
 
 	MainRendererSingleton::init(config);
 
-	ScriptManagerSingleton::init(globAlloc);
+	ScriptManagerSingleton::init(allocAligned, nullptr, getCpuCoresCount());
 
 	SceneGraphSingleton::init(allocAligned, nullptr);
 
@@ -0,0 +1,151 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/core/FramePipeline.h"
+#include <atomic>
+#include <iostream>
+
+namespace anki {
+
+/// A fake engine. The work is simulated with sleeps so the numbers show the
+/// scheduling and not the cores of the machine
+class FakeEngine
+{
+public:
+	HighRezTimer::Scalar m_updateTime = 0.0;
+	HighRezTimer::Scalar m_renderTime = 0.0;
+
+	Array<U64, 2> m_snapshots; ///< Double buffered like the scene's
+	U64 m_lastRenderedFrame = 0;
+	U32 m_errors = 0;
+
+	std::atomic<U32> m_running = {0}; ///< Updates and renders that run now
+	std::atomic<U32> m_maxRunning = {0};
+
+	void enter()
+	{
+		U32 running = m_running.fetch_add(1) + 1;
+		U32 prev = m_maxRunning.load();
+		while(prev < running 
+			&& !m_maxRunning.compare_exchange_weak(prev, running))
+		{}
+	}
+
+	void leave()
+	{
+		m_running.fetch_sub(1);
+	}
+
+	static void* update(void* userData, U64 frame)
+	{
+		FakeEngine& self = *reinterpret_cast<FakeEngine*>(userData);
+		self.enter();
+		HighRezTimer::sleep(self.m_updateTime);
+
+		U64& snapshot = self.m_snapshots[frame % 2];
+		snapshot = frame;
+		self.leave();
+		return &snapshot;
+	}
+
+	static void render(void* userData, void* snapshot, U64 frame)
+	{
+		FakeEngine& self = *reinterpret_cast<FakeEngine*>(userData);
+		self.enter();
+
+		// The snapshot should be of the frame and the frames in order
+		self.m_errors += (*reinterpret_cast<U64*>(snapshot) != frame);
+		self.m_errors += (frame != 0 && frame != self.m_lastRenderedFrame + 1);
+		self.m_lastRenderedFrame = frame;
+
+		HighRezTimer::sleep(self.m_renderTime);
+
+		// The next update shouldn't have touched the snapshot
+		self.m_errors += (*reinterpret_cast<U64*>(snapshot) != frame);
+		self.leave();
+	}
+};
+
+//==============================================================================
+ANKI_TEST(Core, FramePipeline)
+{
+	const U FRAMES = 20;
+
+	for(Bool pipelined : {false, true})
+	{
+		FakeEngine engine;
+		engine.m_updateTime = 0.004;
+		engine.m_renderTime = 0.006;
+
+		{
+			FramePipeline pipeline;
+			pipeline.init(pipelined, FakeEngine::update, FakeEngine::render, 
+				&engine);
+
+			for(U i = 0; i < FRAMES; i++)
+			{
+				pipeline.runFrame();
+			}
+
+			pipeline.flush();
+			ANKI_TEST_EXPECT_EQ(pipeline.getFramesCount(), FRAMES);
+
+			// The update should hide behind the rendering
+			if(pipelined)
+			{
+				ANKI_TEST_EXPECT_EQ(pipeline.getOverlap() > 0.5, true);
+			}
+			else
+			{
+				ANKI_TEST_EXPECT_EQ(pipeline.getOverlap() < 0.25, true);
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(engine.m_errors, 0);
+		ANKI_TEST_EXPECT_EQ(engine.m_lastRenderedFrame, FRAMES - 1);
+		ANKI_TEST_EXPECT_EQ(engine.m_maxRunning.load(), (pipelined) ? 2U : 1U);
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Core, FramePipelineBenchmark)
+{
+	const U FRAMES = 60;
+
+	// Update and render times in ms
+	Array<Array<U32, 2>, 3> workloads = {{{{4, 8}}, {{8, 8}}, {{8, 4}}}};
+
+	for(const Array<U32, 2>& work : workloads)
+	{
+		for(Bool pipelined : {false, true})
+		{
+			FakeEngine engine;
+			engine.m_updateTime = work[0] / 1000.0;
+			engine.m_renderTime = work[1] / 1000.0;
+
+			FramePipeline pipeline;
+			pipeline.init(pipelined, FakeEngine::update, FakeEngine::render, 
+				&engine);
+
+			for(U i = 0; i < FRAMES; i++)
+			{
+				pipeline.runFrame();
+			}
+
+			pipeline.flush();
+
+			std::cout << "FramePipeline: update " << work[0] << "ms, render "
+				<< work[1] << "ms, " << ((pipelined) ? "pipelined" : "serial")
+				<< ": frame " 
+				<< (pipeline.getAverageFrameTime() * 1000.0) << "ms, latency "
+				<< (pipeline.getAverageLatency() * 1000.0) << "ms, overlap "
+				<< (pipeline.getOverlap() * 100.0) << "%"
+				<< std::endl;
+		}
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,162 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/core/Logger.h"
+#include <cstring>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// Counts the messages per line. It runs in the thread of the logger
+class LogCounter
+{
+public:
+	Array<U32, 64> m_lines = {{}};
+	U32 m_count = 0;
+	PtrSize m_maxLength = 0;
+
+	static void handler(void* data, const Logger::Info& info)
+	{
+		LogCounter& self = *reinterpret_cast<LogCounter*>(data);
+
+		if(info.m_line >= 0 && info.m_line < I32(self.m_lines.size()))
+		{
+			++self.m_lines[info.m_line];
+		}
+
+		++self.m_count;
+		self.m_maxLength = std::max(self.m_maxLength, std::strlen(info.m_msg));
+	}
+};
+
+/// Writes a few messages from its own call sites
+class LogTask: public Threadpool::Task
+{
+public:
+	Logger* m_logger;
+
+	void operator()(U32 taskId, PtrSize)
+	{
+		for(U i = 0; i < 4; i++)
+		{
+			I line = taskId * 4 + i;
+			m_logger->writeFormated(ANKI_FILE, line, ANKI_FUNC,
+				Logger::MessageType::NORMAL, "Message %d", line);
+		}
+	}
+};
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Core, Logger)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	LogCounter counter;
+
+	Logger logger(Logger::InitFlags::NONE, alloc);
+	logger.addMessageHandler(&counter, &LogCounter::handler);
+
+	// From many threads
+	{
+		const U THREADS = 4;
+		Threadpool threadpool(THREADS);
+		Array<LogTask, THREADS> tasks;
+
+		for(U i = 0; i < THREADS; i++)
+		{
+			tasks[i].m_logger = &logger;
+			threadpool.assignNewTask(i, &tasks[i]);
+		}
+
+		threadpool.waitForAllThreadsToFinish();
+		logger.flush();
+
+		ANKI_TEST_EXPECT_EQ(counter.m_count, THREADS * 4);
+		for(U i = 0; i < THREADS * 4; i++)
+		{
+			ANKI_TEST_EXPECT_EQ(counter.m_lines[i], 1);
+		}
+	}
+
+	// A message that doesn't fit in a record
+	{
+		Array<char, 1000> msg;
+		std::memset(&msg[0], 'a', msg.size());
+		msg[msg.size() - 1] = '\0';
+
+		logger.write(ANKI_FILE, 32, ANKI_FUNC, Logger::MessageType::ERROR,
+			&msg[0]);
+		logger.flush();
+
+		ANKI_TEST_EXPECT_EQ(counter.m_maxLength, msg.size() - 1);
+	}
+
+	// Rate limiting. The second may change in the loop
+	{
+		const U MESSAGES = 100;
+		const U MAX = Logger::MAX_MESSAGES_PER_SECOND * 2;
+
+		for(U i = 0; i < MESSAGES; i++)
+		{
+			logger.write(ANKI_FILE, 33, ANKI_FUNC,
+				Logger::MessageType::WARNING, "Again");
+		}
+		logger.flush();
+
+		ANKI_TEST_EXPECT_EQ(counter.m_lines[33] <= MAX, true);
+		ANKI_TEST_EXPECT_EQ(counter.m_lines[33]
+			+ logger.getSuppressedMessagesCount(), MESSAGES);
+	}
+
+	// Every call site has its own limit. Many sites don't take from the
+	// limit of the others
+	{
+		const U SITES = 20;
+		U32 suppressed = logger.getSuppressedMessagesCount();
+
+		for(U i = 0; i < SITES; i++)
+		{
+			for(U j = 0; j < Logger::MAX_MESSAGES_PER_SECOND; j++)
+			{
+				logger.write(ANKI_FILE, 40 + i, ANKI_FUNC,
+					Logger::MessageType::WARNING, "Site");
+			}
+		}
+		logger.flush();
+
+		// Each site is at its limit, none over it
+		for(U i = 0; i < SITES; i++)
+		{
+			ANKI_TEST_EXPECT_EQ(counter.m_lines[40 + i],
+				Logger::MAX_MESSAGES_PER_SECOND);
+		}
+		ANKI_TEST_EXPECT_EQ(logger.getSuppressedMessagesCount(), suppressed);
+	}
+
+	// The errors are never rate limited
+	{
+		const U MESSAGES = 100;
+		U32 suppressed = logger.getSuppressedMessagesCount();
+
+		for(U i = 0; i < MESSAGES; i++)
+		{
+			logger.write(ANKI_FILE, 34, ANKI_FUNC,
+				Logger::MessageType::ERROR, "Again");
+		}
+		logger.flush();
+
+		ANKI_TEST_EXPECT_EQ(counter.m_lines[34], MESSAGES);
+		ANKI_TEST_EXPECT_EQ(logger.getSuppressedMessagesCount(), suppressed);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,235 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/event/EventManager.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/util/HighRezTimer.h"
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// Counts its updates and its death
+class CountEvent: public Event
+{
+public:
+	U32 m_updates = 0;
+	U32* m_killed;
+
+	CountEvent(EventManager* manager, F32 startTime, F32 duration,
+		U32* killed)
+	:	Event(manager, startTime, duration),
+		m_killed(killed)
+	{}
+
+	void update(F32, F32) override
+	{
+		++m_updates;
+	}
+
+	Bool onKilled(F32, F32) override
+	{
+		++(*m_killed);
+		return true;
+	}
+};
+
+/// Moves a transform like the MoveEvent
+class TestMoveEvent: public Event
+{
+public:
+	Transform* m_trf;
+	Vec4 m_from;
+	Vec4 m_to;
+
+	TestMoveEvent(EventManager* manager, F32 startTime, F32 duration,
+		Transform* trf)
+	:	Event(manager, startTime, duration),
+		m_trf(trf),
+		m_from(trf->getOrigin()),
+		m_to(m_from + Vec4(1.0, 2.0, 3.0, 0.0))
+	{}
+
+	void update(F32, F32 crntTime) override
+	{
+		F32 factor = sin(getDelta(crntTime) * getPi<F32>());
+		m_trf->getOrigin() = interpolate(m_from, m_to, factor);
+	}
+};
+
+/// Changes a color and a radius like the LightEvent
+class TestLightEvent: public Event
+{
+public:
+	Vec4* m_color;
+	F32* m_radius;
+	Vec4 m_originalColor;
+	F32 m_originalRadius;
+
+	TestLightEvent(EventManager* manager, F32 startTime, F32 duration,
+		Vec4* color, F32* radius)
+	:	Event(manager, startTime, duration),
+		m_color(color),
+		m_radius(radius),
+		m_originalColor(*color),
+		m_originalRadius(*radius)
+	{}
+
+	void update(F32, F32 crntTime) override
+	{
+		F32 factor = sin(getDelta(crntTime) * getPi<F32>());
+		*m_color = m_originalColor + factor * Vec4(0.5);
+		*m_radius = m_originalRadius + factor * 2.0;
+	}
+};
+
+/// Interpolates keyframes and repeats like the AnimationEvent
+class TestAnimationEvent: public Event
+{
+public:
+	static const U KEYS = 4;
+
+	Transform* m_trf;
+	Array<Vec3, KEYS> m_positions;
+	Array<Quat, KEYS> m_rotations;
+
+	TestAnimationEvent(EventManager* manager, F32 startTime, F32 duration,
+		Transform* trf)
+	:	Event(manager, startTime, duration, nullptr, EF_REANIMATE),
+		m_trf(trf)
+	{
+		for(U i = 0; i < KEYS; i++)
+		{
+			m_positions[i] = Vec3(F32(i));
+			m_rotations[i] = Quat(Axisang(F32(i) * 0.5, Vec3(0.0, 1.0, 0.0)));
+		}
+	}
+
+	void update(F32, F32 crntTime) override
+	{
+		F32 u = std::min(getDelta(crntTime), 0.999f) * (KEYS - 1);
+		U key = U(u);
+		u -= F32(key);
+
+		m_trf->setOrigin(
+			interpolate(m_positions[key], m_positions[key + 1], u).xyz0());
+		m_trf->setRotation(
+			Mat3x4(m_rotations[key].slerp(m_rotations[key + 1], u)));
+	}
+};
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Event, EventManager)
+{
+	Threadpool threadpool(1);
+	SceneGraph scene(allocAligned, nullptr, &threadpool);
+	EventManager& events = scene.getEventManager();
+	U32 killed = 0;
+
+	CountEvent* now;
+	CountEvent* later;
+	CountEvent* never;
+	events.newEvent(now, -1.0, 1.5, &killed);
+	events.newEvent(later, 1.0, 1.0, &killed);
+	events.newEvent(never, 10.0, 1.0, &killed);
+	ANKI_TEST_EXPECT_EQ(events.getScheduledEventsCount(), 3);
+
+	// Only the first starts
+	events.updateAllEvents(0.0, 0.5);
+	ANKI_TEST_EXPECT_EQ(events.getScheduledEventsCount(), 2);
+	ANKI_TEST_EXPECT_EQ(events.getActiveEventsCount(), 1);
+	ANKI_TEST_EXPECT_EQ(now->m_updates, 1);
+	ANKI_TEST_EXPECT_EQ(later->m_updates, 0);
+
+	// Remove a scheduled one
+	events.deleteEvent(never);
+	events.deleteEventsMarkedForDeletion();
+	ANKI_TEST_EXPECT_EQ(events.getScheduledEventsCount(), 1);
+
+	events.updateAllEvents(0.5, 1.5);
+	ANKI_TEST_EXPECT_EQ(events.getActiveEventsCount(), 2);
+	ANKI_TEST_EXPECT_EQ(now->m_updates, 2);
+	ANKI_TEST_EXPECT_EQ(later->m_updates, 1);
+
+	// Both die
+	events.updateAllEvents(1.5, 2.5);
+	ANKI_TEST_EXPECT_EQ(killed, 2);
+	events.deleteEventsMarkedForDeletion();
+	ANKI_TEST_EXPECT_EQ(events.getActiveEventsCount(), 0);
+	ANKI_TEST_EXPECT_EQ(events.getScheduledEventsCount(), 0);
+}
+
+//==============================================================================
+ANKI_TEST(Event, EventManagerBenchmark)
+{
+	const U EVENTS = 100000; ///< Active, of 3 types
+	const U SCHEDULED = 100000; ///< That start later
+	const U FRAMES = 20;
+
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Vector<Transform, HeapAllocator<Transform>> trfs(EVENTS, alloc);
+	Vector<Vec4, HeapAllocator<Vec4>> colors(EVENTS, Vec4(1.0), alloc);
+	Vector<F32, HeapAllocator<F32>> radiuses(EVENTS, 1.0, alloc);
+
+	benchmarkThreads(std::to_string(EVENTS) + " events", 
+		[&](Threadpool& threadpool) -> HighRezTimer::Scalar
+	{
+		SceneGraph scene(allocAligned, nullptr, &threadpool);
+		EventManager& events = scene.getEventManager();
+
+		for(U i = 0; i < EVENTS; i++)
+		{
+			switch(i % 3)
+			{
+			case 0:
+				{
+					TestMoveEvent* e;
+					events.newEvent(e, 0.0, 1000.0, &trfs[i]);
+				}
+				break;
+			case 1:
+				{
+					TestLightEvent* e;
+					events.newEvent(e, 0.0, 1000.0, &colors[i], &radiuses[i]);
+				}
+				break;
+			default:
+				{
+					TestAnimationEvent* e;
+					events.newEvent(e, 0.0, 2.0, &trfs[i]);
+				}
+				break;
+			}
+		}
+
+		for(U i = 0; i < SCHEDULED; i++)
+		{
+			TestMoveEvent* e;
+			events.newEvent(e, 1000.0 + F32(i), 1.0, &trfs[i]);
+		}
+
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRAMES; f++)
+		{
+			events.updateAllEvents(F32(f) * 0.1, F32(f + 1) * 0.1);
+		}
+		HighRezTimer::Scalar time = 
+			(HighRezTimer::getCurrentTime() - begin) / FRAMES;
+
+		ANKI_TEST_EXPECT_EQ(events.getActiveEventsCount(), EVENTS);
+		ANKI_TEST_EXPECT_EQ(events.getScheduledEventsCount(), SCHEDULED);
+
+		return time;
+	});
+}
+
+} // end namespace anki
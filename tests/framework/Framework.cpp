@@ -4,6 +4,9 @@
 // http://www.anki3d.org/LICENSE
 
 #include "tests/framework/Framework.h"
+#include "anki/util/Array.h"
+#include "anki/util/Thread.h"
+#include "anki/util/System.h"
 #include <iostream>
 #include <cstring>
 #include <malloc.h>
@@ -239,4 +242,22 @@ void deleteTesterSingleton()
 	}
 }
 
+//==============================================================================
+void benchmarkThreads(const std::string& name, BenchmarkCallback run)
+{
+	const U32 threadsCount = getCpuCoresCount();
+	Array<U32, 2> threads = {{1, threadsCount}};
+	Array<HighRezTimer::Scalar, 2> times;
+
+	for(U i = 0; i < threads.size(); i++)
+	{
+		Threadpool threadpool(threads[i]);
+		times[i] = run(threadpool);
+	}
+
+	std::cout << name << ": 1 thread " << (times[0] * 1000.0) << "ms, " 
+		<< threadsCount << " threads " << (times[1] * 1000.0) 
+		<< "ms per frame" << std::endl;
+}
+
 } // end namespace anki
@@ -8,11 +8,13 @@
 
 #include "anki/util/Vector.h"
 #include "anki/util/Singleton.h"
+#include "anki/util/HighRezTimer.h"
 #include <stdexcept>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <functional>
 
 namespace anki {
 
@@ -20,6 +22,7 @@ namespace anki {
 class TestSuite;
 class Test;
 class Tester;
+class Threadpool;
 
 /// The actual test
 typedef void (*TestCallback)(Test&);
@@ -73,6 +76,15 @@ extern Tester& getTesterSingleton();
 /// Delete the instance to make valgrind a bit happy
 extern void deleteTesterSingleton();
 
+/// The time of a benchmark run in seconds per frame
+typedef std::function<HighRezTimer::Scalar (Threadpool&)> BenchmarkCallback;
+
+/// Run a benchmark with one thread and with all the cores and print the time
+/// per frame of both
+/// @param name Printed before the times
+/// @param run Sets up and runs the benchmark on the given threadpool
+extern void benchmarkThreads(const std::string& name, BenchmarkCallback run);
+
 //==============================================================================
 // Macros
 
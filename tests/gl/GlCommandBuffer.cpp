@@ -0,0 +1,373 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/gl/GlCommandBufferHandle.h"
+#include "anki/gl/GlQueue.h"
+#include "anki/util/HighRezTimer.h"
+#include "anki/util/Functions.h"
+#include <iostream>
+#include <cstddef>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The queue is never started and the device is never accessed so the tests
+/// run without a GL context
+static GlDevice* const fakeDevice = reinterpret_cast<GlDevice*>(0x10);
+
+//==============================================================================
+static GlCommandBufferHandle newCommandBuffer(GlQueue& queue,
+	const GlCommandBufferInitHints& hints = GlCommandBufferInitHints())
+{
+	using Alloc = HeapAllocator<GlCommandBuffer>;
+	Alloc alloc = Alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	GlCommandBufferHandle commands;
+	static_cast<GlCommandBufferHandle::Base&>(commands) =
+		GlCommandBufferHandle::Base(
+		nullptr,
+		alloc,
+		GlHandleDefaultDeleter<GlCommandBuffer, Alloc>(),
+		&queue,
+		hints);
+
+	return commands;
+}
+
+/// A generic command that logs its execution
+class LogCommand: public GlCommand
+{
+public:
+	Vec4 m_pad; ///< Force a big alignment
+	U32 m_value;
+	U32* m_log;
+	U32* m_destroyed;
+
+	LogCommand(U32 value, U32* log, U32* destroyed)
+	:	m_value(value),
+		m_log(log),
+		m_destroyed(destroyed)
+	{}
+
+	~LogCommand()
+	{
+		++(*m_destroyed);
+	}
+
+	void operator()(GlCommandBuffer*)
+	{
+		ANKI_ASSERT(isAligned(alignof(Vec4), &m_pad));
+		m_log[m_value] = m_value;
+	}
+};
+
+/// An empty generic command
+class EmptyCommand: public GlCommand
+{
+public:
+	void operator()(GlCommandBuffer*)
+	{}
+};
+
+/// A generic command that holds a handle like the commands did before the
+/// inline commands
+template<typename T>
+class HandleCommand: public GlCommand
+{
+public:
+	GlHandle<T> m_handle;
+
+	HandleCommand(const GlHandle<T>& handle)
+	:	m_handle(handle)
+	{}
+
+	void operator()(GlCommandBuffer*)
+	{}
+};
+
+static void logCallback(void* data)
+{
+	U32* log = static_cast<U32*>(data);
+	log[log[0]] = log[0];
+	++log[0];
+}
+
+static void emptyCallback(void*)
+{}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Gl, CommandBuffer)
+{
+	GlQueue queue(fakeDevice, allocAligned, nullptr);
+	U32 destroyed = 0;
+
+	// Order of the inline and the generic commands
+	{
+		const U COUNT = 2000; // Enough to span some blocks
+		Array<U32, COUNT + 1> log = {{}};
+		Array<U32, COUNT + 1> callbackLog = {{}};
+		callbackLog[0] = 1;
+
+		GlCommandBufferHandle commands = newCommandBuffer(queue);
+		for(U i = 1; i <= COUNT; i++)
+		{
+			if(i % 2)
+			{
+				commands._pushBackNewCommand<LogCommand>(
+					i, &log[0], &destroyed);
+			}
+			else
+			{
+				commands.pushBackUserCommand(logCallback, &callbackLog[0]);
+			}
+
+			// Cached by the GlState so it will not touch GL
+			commands.setViewport(0, 0, 0, 0);
+		}
+
+		commands._executeAllCommands();
+
+		for(U i = 1; i <= COUNT; i++)
+		{
+			if(i % 2)
+			{
+				ANKI_TEST_EXPECT_EQ(log[i], i);
+			}
+			else
+			{
+				ANKI_TEST_EXPECT_EQ(callbackLog[i / 2], i / 2);
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(destroyed, 0);
+	}
+
+	ANKI_TEST_EXPECT_EQ(destroyed, 1000);
+
+	// References
+	{
+		using Alloc = HeapAllocator<U32>;
+		GlHandle<U32> handle(nullptr, Alloc(HeapMemoryPool(allocAligned,
+			nullptr)), GlHandleDefaultDeleter<U32, Alloc>());
+
+		{
+			GlCommandBufferHandle commands = newCommandBuffer(queue);
+			commands._addReference(handle);
+			commands._addReference(handle);
+			ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 2);
+
+			commands.pushBackUserCommand(emptyCallback, nullptr);
+			commands._executeAllCommands();
+		}
+
+		ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 1);
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Gl, CommandBufferParameters)
+{
+	GlQueue queue(fakeDevice, allocAligned, nullptr);
+	Array<U32, 8> log0 = {{}};
+	Array<U32, 8> log1 = {{}};
+	log0[0] = log1[0] = 1;
+
+	// Record once. The user data of the callback is a parameter
+	GlCommandBufferHandle bundle = newCommandBuffer(queue);
+	bundle.pushBackUserCommand(logCallback, nullptr);
+	bundle.addParameter(0, offsetof(GlUserCallbackCommandData, m_userData), 
+		sizeof(void*));
+	ANKI_TEST_EXPECT_EQ(bundle._get().getParametersSize(), sizeof(void*));
+
+	// Replay it with different values
+	{
+		GlCommandBufferHandle commands = newCommandBuffer(queue);
+
+		U32* param = &log0[0];
+		commands.pushBackOtherCommandBuffer(bundle, &param, sizeof(param));
+		param = &log1[0];
+		commands.pushBackOtherCommandBuffer(bundle, &param, sizeof(param));
+		param = &log0[0];
+		commands.pushBackOtherCommandBuffer(bundle, &param, sizeof(param));
+
+		commands._executeAllCommands();
+	}
+
+	ANKI_TEST_EXPECT_EQ(log0[0], 3);
+	ANKI_TEST_EXPECT_EQ(log0[2], 2);
+	ANKI_TEST_EXPECT_EQ(log1[0], 2);
+	ANKI_TEST_EXPECT_EQ(log1[1], 1);
+}
+
+//==============================================================================
+ANKI_TEST(Gl, FrameReferences)
+{
+	GlQueue queue(fakeDevice, allocAligned, nullptr);
+	GlRetirementList& retirement = queue.getRetirementList();
+
+	using Alloc = HeapAllocator<U32>;
+	GlHandle<U32> handle(nullptr, Alloc(HeapMemoryPool(allocAligned,
+		nullptr)), GlHandleDefaultDeleter<U32, Alloc>());
+
+	GlCommandBufferInitHints hints;
+	hints.setFrameScoped(true);
+
+	{
+		GlCommandBufferHandle a = newCommandBuffer(queue, hints);
+		GlCommandBufferHandle b = newCommandBuffer(queue, hints);
+
+		// Only the first reference of the frame counts
+		a._addReference(handle);
+		a._addReference(handle);
+		b._addReference(handle);
+		ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 2);
+		ANKI_TEST_EXPECT_EQ(retirement.getReferencesCount(), 1);
+
+		a.pushBackUserCommand(emptyCallback, nullptr);
+		b.pushBackUserCommand(emptyCallback, nullptr);
+		a._executeAllCommands();
+		b._executeAllCommands();
+	}
+
+	// The frame keeps it alive after the command buffers are gone
+	ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 2);
+
+	retirement.destroy();
+	ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 1);
+	ANKI_TEST_EXPECT_EQ(retirement.getReferencesCount(), 0);
+}
+
+//==============================================================================
+ANKI_TEST(Gl, FrameReferencesBenchmark)
+{
+	// A frame of some command buffers that use the same objects
+	const U OBJECTS = 500;
+	const U COMMAND_BUFFERS = 8;
+	const U COMMANDS = 2000; ///< Per command buffer
+
+	GlQueue queue(fakeDevice, allocAligned, nullptr);
+
+	using Alloc = HeapAllocator<U32>;
+	Alloc alloc = Alloc(HeapMemoryPool(allocAligned, nullptr));
+	Array<GlHandle<U32>, OBJECTS> handles;
+	for(GlHandle<U32>& handle : handles)
+	{
+		handle = GlHandle<U32>(nullptr, alloc, 
+			GlHandleDefaultDeleter<U32, Alloc>());
+	}
+
+	// 0: Every command holds a handle, 1: Every command buffer holds 
+	// references, 2: The frame holds references
+	Array<U64, 3> atomicOps = {{}};
+	Array<HighRezTimer::Scalar, 3> times = {{}};
+
+	for(U mode = 0; mode < 3; mode++)
+	{
+		GlCommandBufferInitHints hints;
+		hints.setFrameScoped(mode == 2);
+
+#if ANKI_ENABLE_COUNTERS
+		U64 opsBegin = glHandleAtomicOpsCount.load();
+#endif
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+
+		for(U c = 0; c < COMMAND_BUFFERS; c++)
+		{
+			GlCommandBufferHandle commands = newCommandBuffer(queue, hints);
+
+			for(U i = 0; i < COMMANDS; i++)
+			{
+				const GlHandle<U32>& handle = 
+					handles[(i * 7 + c * 13) % OBJECTS];
+
+				if(mode == 0)
+				{
+					commands._pushBackNewCommand<HandleCommand<U32>>(handle);
+				}
+				else
+				{
+					commands._addReference(handle);
+					commands.pushBackUserCommand(emptyCallback, nullptr);
+				}
+			}
+
+			commands._executeAllCommands();
+		}
+
+		// End of the frame
+		queue.getRetirementList().destroy();
+
+		times[mode] = HighRezTimer::getCurrentTime() - begin;
+#if ANKI_ENABLE_COUNTERS
+		atomicOps[mode] = glHandleAtomicOpsCount.load() - opsBegin;
+#endif
+	}
+
+	for(GlHandle<U32>& handle : handles)
+	{
+		ANKI_TEST_EXPECT_EQ(handle.getReferenceCount(), 1);
+	}
+
+	const char* names[] = {"per command", "per command buffer", "per frame"};
+	for(U mode = 0; mode < 3; mode++)
+	{
+		std::cout << "Handle references " << names[mode] << ": "
+			<< (COMMAND_BUFFERS * COMMANDS) << " uses, " 
+			<< atomicOps[mode] << " atomic ops, " 
+			<< (times[mode] * 1000.0) << "ms" << std::endl;
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Gl, CommandBufferBenchmark)
+{
+	const U COMMANDS = 100000;
+	const U ITERATIONS = 10;
+
+	GlQueue queue(fakeDevice, allocAligned, nullptr);
+	HighRezTimer::Scalar recordTime = 0.0;
+	HighRezTimer::Scalar executeTime = 0.0;
+	PtrSize size = 0;
+
+	for(U it = 0; it < ITERATIONS; it++)
+	{
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+
+		GlCommandBufferHandle commands = newCommandBuffer(queue);
+
+		// A mix of inline commands that the GlState caches, user callbacks
+		// and generic commands. None of them touches GL
+		for(U i = 0; i < COMMANDS; i += 4)
+		{
+			commands.setViewport(0, 0, 0, 0);
+			commands.setBlendFunctions(GL_ONE, GL_ZERO);
+			commands.pushBackUserCommand(emptyCallback, nullptr);
+			commands._pushBackNewCommand<EmptyCommand>();
+		}
+
+		HighRezTimer::Scalar recorded = HighRezTimer::getCurrentTime();
+		commands._executeAllCommands();
+		HighRezTimer::Scalar executed = HighRezTimer::getCurrentTime();
+
+		recordTime += recorded - begin;
+		executeTime += executed - recorded;
+		size = commands._getAllocator().getMemoryPool().getAllocatedSize();
+	}
+
+	std::cout << "GlCommandBuffer: " << COMMANDS << " commands, record "
+		<< (recordTime / ITERATIONS * 1000.0) << "ms, execute "
+		<< (executeTime / ITERATIONS * 1000.0) << "ms, memory "
+		<< size << " bytes" << std::endl;
+}
+
+} // end namespace anki
@@ -0,0 +1,188 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/gl/GlRingBuffer.h"
+
+namespace anki {
+
+//==============================================================================
+ANKI_TEST(Gl, RingAllocator)
+{
+	GlRingAllocator ring;
+	ring.create(16, 256);
+	PtrSize offset;
+
+	// Aligned allocations one after the other
+	ANKI_TEST_EXPECT_EQ(ring.allocate(10, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 0);
+	ANKI_TEST_EXPECT_EQ(ring.allocate(10, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 16);
+	ANKI_TEST_EXPECT_EQ(ring.allocate(200, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 32);
+	ANKI_TEST_EXPECT_EQ(ring.getFrameUsedSize(), 232);
+
+	// The frame alone fills the ring
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), false);
+
+	U32 frame = ring.endFrame();
+	ANKI_TEST_EXPECT_EQ(frame, 0);
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount(), 1);
+	ANKI_TEST_EXPECT_EQ(ring.getFrameUsedSize(), 0);
+
+	// The memory comes back only when the GPU is done with the frame
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), false);
+	ring.retireOldestFrame();
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount(), 0);
+
+	// No room at the end so it wraps. The skipped part counts as used
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 0);
+	ANKI_TEST_EXPECT_EQ(ring.getFrameUsedSize(), 64);
+}
+
+//==============================================================================
+ANKI_TEST(Gl, RingAllocatorFrames)
+{
+	const U32 MAX_FRAMES = GlRingAllocator::MAX_FRAMES_IN_FLIGHT;
+
+	GlRingAllocator ring;
+	ring.create(16, 256);
+	PtrSize offset;
+
+	// Fill the frames in flight. The slots go in order
+	for(U32 i = 0; i < MAX_FRAMES; i++)
+	{
+		ANKI_TEST_EXPECT_EQ(ring.allocate(64, offset), true);
+		ANKI_TEST_EXPECT_EQ(offset, i * 64);
+		ANKI_TEST_EXPECT_EQ(ring.endFrame(), i);
+	}
+
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount(), MAX_FRAMES);
+	ANKI_TEST_EXPECT_EQ(ring.getOldestFrame(), 0);
+
+	// The last quarter is free and the rest waits for the oldest fence
+	ANKI_TEST_EXPECT_EQ(ring.allocate(64, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 192);
+	ANKI_TEST_EXPECT_EQ(ring.allocate(64, offset), false);
+
+	ring.retireOldestFrame();
+	ANKI_TEST_EXPECT_EQ(ring.getOldestFrame(), 1);
+	ANKI_TEST_EXPECT_EQ(ring.allocate(64, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 0);
+
+	// The freed slot is reused
+	ANKI_TEST_EXPECT_EQ(ring.endFrame(), 0);
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount(), MAX_FRAMES);
+
+	// Retiring out of the oldest frames frees only what they used
+	ring.retireOldestFrame();
+	ANKI_TEST_EXPECT_EQ(ring.allocate(128, offset), false);
+	ring.retireOldestFrame();
+	ANKI_TEST_EXPECT_EQ(ring.allocate(128, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 64);
+}
+
+//==============================================================================
+ANKI_TEST(Gl, RingAllocatorWaits)
+{
+	// A GPU that lags some frames behind. The client retires the frames
+	// that the GPU finished and waits for the oldest when it's full, like
+	// GlRingBuffer does with the fences
+	const U32 FRAMES = 100;
+	const U32 GPU_LAG = 2;
+	const U32 ALLOCATIONS = 5;
+
+	GlRingAllocator ring;
+	ring.create(256, 4096);
+
+	U32 gpuFrame = 0; ///< The frames that the GPU finished
+	U32 retired = 0; ///< The frames that the client retired
+	U32 waits = 0;
+
+	for(U32 f = 0; f < FRAMES; f++)
+	{
+		for(U32 a = 0; a < ALLOCATIONS; a++)
+		{
+			PtrSize offset;
+			while(!ring.allocate(300, offset))
+			{
+				ANKI_TEST_EXPECT_EQ(ring.getFramesCount() > 0, true);
+
+				if(retired == gpuFrame)
+				{
+					// Wait for the GPU
+					++gpuFrame;
+					++waits;
+				}
+
+				ring.retireOldestFrame();
+				++retired;
+			}
+
+			ANKI_TEST_EXPECT_EQ(offset % 256, 0);
+			ANKI_TEST_EXPECT_EQ(offset + 300 <= 4096, true);
+		}
+
+		// GlRingBuffer::endFrame waits if all the frames are in flight
+		if(ring.getFramesCount() == GlRingAllocator::MAX_FRAMES_IN_FLIGHT)
+		{
+			if(retired == gpuFrame)
+			{
+				++gpuFrame;
+				++waits;
+			}
+
+			ring.retireOldestFrame();
+			++retired;
+		}
+
+		ring.endFrame();
+
+		if(f >= GPU_LAG)
+		{
+			gpuFrame = std::max(gpuFrame, f - GPU_LAG + 1);
+		}
+	}
+
+	// Every frame uses 2560 bytes out of 4096 so the client has to wait
+	// for the previous frame most of the time
+	ANKI_TEST_EXPECT_EQ(waits > 0, true);
+	ANKI_TEST_EXPECT_EQ(retired + ring.getFramesCount(), FRAMES);
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount() <=
+		GlRingAllocator::MAX_FRAMES_IN_FLIGHT, true);
+}
+
+//==============================================================================
+ANKI_TEST(Gl, RingAllocatorGrow)
+{
+	GlRingAllocator ring;
+	ring.create(16, 64);
+	PtrSize offset;
+
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), true);
+
+	// The frame alone doesn't fit and there is nothing to wait for
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), false);
+	ANKI_TEST_EXPECT_EQ(ring.getFramesCount(), 0);
+
+	// The new size fits the whole frame twice
+	PtrSize newSize = ring.getGrowSize(40);
+	ANKI_TEST_EXPECT_EQ(newSize, 160);
+
+	ring.resize(newSize);
+	ANKI_TEST_EXPECT_EQ(ring.getSize(), 160);
+	ANKI_TEST_EXPECT_EQ(ring.allocate(40, offset), true);
+	ANKI_TEST_EXPECT_EQ(offset, 0);
+
+	// The frame used memory from both
+	ANKI_TEST_EXPECT_EQ(ring.getFrameUsedSize(), 80);
+
+	// An allocation bigger than the ring grows it more than twice
+	ANKI_TEST_EXPECT_EQ(ring.allocate(500, offset), false);
+	ANKI_TEST_EXPECT_EQ(ring.getGrowSize(500), 1184);
+}
+
+} // end namespace anki
@@ -0,0 +1,274 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/Math.h"
+#include "anki/math/Batch.h"
+#include "anki/util/HighRezTimer.h"
+#include <iostream>
+#include <vector>
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+static F32 randFloat(F32 min, F32 max)
+{
+	return min + (max - min) * (F32(rand()) / F32(RAND_MAX));
+}
+
+static Quat randQuat()
+{
+	Vec3 axis(randFloat(-1.0, 1.0), randFloat(-1.0, 1.0),
+		randFloat(0.1, 1.0));
+	axis.normalize();
+	return Quat(Axisang(randFloat(0.0, 6.0), axis));
+}
+
+static Transform randTransform()
+{
+	return Transform(
+		Vec4(randFloat(-10.0, 10.0), randFloat(-10.0, 10.0),
+			randFloat(-10.0, 10.0), 0.0),
+		Mat3x4(randQuat()), randFloat(0.5, 2.0));
+}
+
+static Mat4 randMat4()
+{
+	Mat4 m(randTransform());
+	m(3, 0) = randFloat(-0.5, 0.5);
+	m(3, 1) = randFloat(-0.5, 0.5);
+	return m;
+}
+
+/// Time a function per call
+template<typename Func>
+static HighRezTimer::Scalar timeIt(U iterations, Func func)
+{
+	HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+	for(U i = 0; i < iterations; i++)
+	{
+		func();
+	}
+	return (HighRezTimer::getCurrentTime() - begin) / iterations;
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Math, Batch)
+{
+	// Odd counts to go through the remainders
+	const U COUNT = 39;
+	const F32 EPS = 0.0001;
+	srand(0);
+
+	// Points
+	{
+		Mat4 m = randMat4();
+		std::vector<Vec4> in(COUNT), out(COUNT);
+		for(Vec4& p : in)
+		{
+			p = Vec4(randFloat(-10.0, 10.0), randFloat(-10.0, 10.0),
+				randFloat(-10.0, 10.0), 0.0);
+		}
+
+		transformPoints(m, &in[0], &out[0], COUNT);
+
+		for(U i = 0; i < COUNT; i++)
+		{
+			Vec4 expected = m * in[i].xyz1();
+			for(U j = 0; j < 4; j++)
+			{
+				ANKI_TEST_EXPECT_NEAR(out[i][j], expected[j], EPS);
+			}
+		}
+	}
+
+	// Transforms. In place too
+	{
+		std::vector<Transform> a(COUNT), b(COUNT), out(COUNT);
+		for(U i = 0; i < COUNT; i++)
+		{
+			a[i] = randTransform();
+			b[i] = randTransform();
+		}
+
+		combineTransformations(&a[0], &b[0], &out[0], COUNT);
+		std::vector<Transform> inPlace = a;
+		combineTransformations(&inPlace[0], &b[0], &inPlace[0], COUNT);
+
+		for(U i = 0; i < COUNT; i++)
+		{
+			Transform expected = a[i].combineTransformations(b[i]);
+			for(U j = 0; j < 4; j++)
+			{
+				ANKI_TEST_EXPECT_NEAR(
+					out[i].getOrigin()[j], expected.getOrigin()[j], EPS);
+			}
+			for(U j = 0; j < 12; j++)
+			{
+				ANKI_TEST_EXPECT_NEAR(out[i].getRotation()[j],
+					expected.getRotation()[j], EPS);
+				ANKI_TEST_EXPECT_NEAR(inPlace[i].getRotation()[j],
+					expected.getRotation()[j], EPS);
+			}
+			ANKI_TEST_EXPECT_NEAR(out[i].getScale(), expected.getScale(), EPS);
+		}
+	}
+
+	// Quaternions. Some are the same, opposite or close. The methods normalize
+	// with the reciprocal square root estimate so compare loosely
+	{
+		const F32 QUAT_EPS = 0.001;
+		std::vector<Quat> a(COUNT), b(COUNT), out(COUNT);
+		std::vector<F32> u(COUNT);
+		for(U i = 0; i < COUNT; i++)
+		{
+			a[i] = randQuat();
+			u[i] = randFloat(0.0, 1.0);
+
+			switch(i % 4)
+			{
+			case 0:
+				b[i] = a[i];
+				break;
+			case 1:
+				b[i] = -a[i];
+				break;
+			case 2:
+				b[i] = Quat(Axisang(0.0005, Vec3(0.0, 1.0, 0.0)))
+					.combineRotations(a[i]);
+				break;
+			default:
+				b[i] = randQuat();
+			}
+		}
+
+		slerp(&a[0], &b[0], &u[0], &out[0], COUNT);
+
+		for(U i = 0; i < COUNT; i++)
+		{
+			Quat expected = a[i].slerp(b[i], u[i]);
+			for(U j = 0; j < 4; j++)
+			{
+				ANKI_TEST_EXPECT_NEAR(out[i][j], expected[j], QUAT_EPS);
+			}
+		}
+	}
+
+	// Matrices
+	{
+		std::vector<Mat4> in(COUNT), out(COUNT);
+		for(Mat4& m : in)
+		{
+			m = randMat4();
+		}
+
+		invert(&in[0], &out[0], COUNT);
+
+		// The elements of the inverse reach the thousands. The batch and the
+		// Mat4 round differently with fast math so the error is relative
+		for(U i = 0; i < COUNT; i++)
+		{
+			Mat4 expected = in[i].getInverse();
+			for(U j = 0; j < 16; j++)
+			{
+				F32 eps = EPS * std::max(F32(1.0), abs(expected[j]));
+				ANKI_TEST_EXPECT_NEAR(out[i][j], expected[j], eps);
+			}
+		}
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Math, BatchBenchmark)
+{
+	const U COUNT = 10000;
+	const U ITERATIONS = 100;
+	srand(0);
+
+	std::vector<Vec4> points(COUNT), pointsOut(COUNT);
+	std::vector<Transform> trfs(COUNT), trfs2(COUNT), trfsOut(COUNT);
+	std::vector<Quat> quats(COUNT), quats2(COUNT), quatsOut(COUNT);
+	std::vector<F32> u(COUNT);
+	std::vector<Mat4> mats(COUNT), matsOut(COUNT);
+	for(U i = 0; i < COUNT; i++)
+	{
+		points[i] = Vec4(randFloat(-10.0, 10.0), randFloat(-10.0, 10.0),
+			randFloat(-10.0, 10.0), 0.0);
+		trfs[i] = randTransform();
+		trfs2[i] = randTransform();
+		quats[i] = randQuat();
+		quats2[i] = randQuat();
+		u[i] = randFloat(0.0, 1.0);
+		mats[i] = randMat4();
+	}
+	Mat4 m = randMat4();
+
+	// One item at a time with the methods of the classes and then batched
+	Array<Array<HighRezTimer::Scalar, 2>, 4> times;
+
+	times[0][0] = timeIt(ITERATIONS, [&]()
+	{
+		for(U i = 0; i < COUNT; i++)
+		{
+			pointsOut[i] = m * points[i].xyz1();
+		}
+	});
+	times[0][1] = timeIt(ITERATIONS, [&]()
+	{
+		transformPoints(m, &points[0], &pointsOut[0], COUNT);
+	});
+
+	times[1][0] = timeIt(ITERATIONS, [&]()
+	{
+		for(U i = 0; i < COUNT; i++)
+		{
+			trfsOut[i] = trfs[i].combineTransformations(trfs2[i]);
+		}
+	});
+	times[1][1] = timeIt(ITERATIONS, [&]()
+	{
+		combineTransformations(&trfs[0], &trfs2[0], &trfsOut[0], COUNT);
+	});
+
+	times[2][0] = timeIt(ITERATIONS, [&]()
+	{
+		for(U i = 0; i < COUNT; i++)
+		{
+			quatsOut[i] = quats[i].slerp(quats2[i], u[i]);
+		}
+	});
+	times[2][1] = timeIt(ITERATIONS, [&]()
+	{
+		slerp(&quats[0], &quats2[0], &u[0], &quatsOut[0], COUNT);
+	});
+
+	times[3][0] = timeIt(ITERATIONS, [&]()
+	{
+		for(U i = 0; i < COUNT; i++)
+		{
+			matsOut[i] = mats[i].getInverse();
+		}
+	});
+	times[3][1] = timeIt(ITERATIONS, [&]()
+	{
+		invert(&mats[0], &matsOut[0], COUNT);
+	});
+
+	Array<const char*, 4> names = {{"transformPoints",
+		"combineTransformations", "slerp", "invert"}};
+	for(U i = 0; i < names.size(); i++)
+	{
+		std::cout << names[i] << " x" << COUNT << ": one by one "
+			<< (times[i][0] * 1000.0) << "ms, batch "
+			<< (times[i][1] * 1000.0) << "ms" << std::endl;
+	}
+}
@@ -0,0 +1,128 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/Math.h"
+#include "anki/util/HighRezTimer.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+static U32 toBits(F32 f)
+{
+	U32 u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static F32 fromBits(U32 u)
+{
+	F32 f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Math, F16)
+{
+	// All the halfs. Compare the bits since there are NaNs
+	std::vector<F16> halfs(0x10000);
+	std::vector<F32> floats(halfs.size());
+	for(U i = 0; i < halfs.size(); i++)
+	{
+		halfs[i] = F16(U16(i));
+	}
+
+	toF32(&halfs[0], &floats[0], halfs.size());
+
+	for(U i = 0; i < halfs.size(); i++)
+	{
+		ANKI_TEST_EXPECT_EQ(toBits(floats[i]), toBits(halfs[i].toF32()));
+	}
+
+	// Floats around all the finite halfs and the ties between them. The ones
+	// that overflow assert so leave them out
+	std::vector<F32> in;
+	for(U i = 0; i < 0x10000; i++)
+	{
+		if((i & 0x7c00) == 0x7c00)
+		{
+			continue;
+		}
+
+		U32 bits = toBits(F16(U16(i)).toF32());
+		in.push_back(fromBits(bits));
+		in.push_back(fromBits(bits + 1));
+		in.push_back(fromBits(bits - 1));
+
+		if((i & 0x7fff) < 0x7bff)
+		{
+			F32 next = F16(U16(i + 1)).toF32();
+			in.push_back((fromBits(bits) + next) * 0.5);
+		}
+	}
+	in.push_back(fromBits(0x7f800000));
+	in.push_back(fromBits(0xff800000));
+	in.push_back(fromBits(0x7fc00001));
+	in.push_back(1.0e-30);
+	in.push_back(-1.0e-30);
+
+	std::vector<F16> out(in.size());
+	toF16(&in[0], &out[0], in.size());
+
+	for(U i = 0; i < in.size(); i++)
+	{
+		ANKI_TEST_EXPECT_EQ(out[i].toU16(), F16(in[i]).toU16());
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Math, F16Benchmark)
+{
+	const U COUNT = 10000000;
+	srand(0);
+
+	std::vector<F32> floats(COUNT), floatsOut(COUNT);
+	std::vector<F16> halfs(COUNT);
+	for(F32& f : floats)
+	{
+		f = F32(rand()) / F32(RAND_MAX) * 2.0 - 1.0;
+	}
+
+	// One by one and then bulk
+	Array<HighRezTimer::Scalar, 5> t;
+	t[0] = HighRezTimer::getCurrentTime();
+	for(U i = 0; i < COUNT; i++)
+	{
+		halfs[i] = F16(floats[i]);
+	}
+	t[1] = HighRezTimer::getCurrentTime();
+	toF16(&floats[0], &halfs[0], COUNT);
+	t[2] = HighRezTimer::getCurrentTime();
+	for(U i = 0; i < COUNT; i++)
+	{
+		floatsOut[i] = halfs[i].toF32();
+	}
+	t[3] = HighRezTimer::getCurrentTime();
+	toF32(&halfs[0], &floatsOut[0], COUNT);
+	t[4] = HighRezTimer::getCurrentTime();
+
+	std::cout << "toF16 x" << COUNT << ": one by one "
+		<< ((t[1] - t[0]) * 1000.0) << "ms, bulk " << ((t[2] - t[1]) * 1000.0)
+		<< "ms" << std::endl;
+	std::cout << "toF32 x" << COUNT << ": one by one "
+		<< ((t[3] - t[2]) * 1000.0) << "ms, bulk " << ((t[4] - t[3]) * 1000.0)
+		<< "ms" << std::endl;
+}
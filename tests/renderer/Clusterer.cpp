@@ -0,0 +1,242 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/renderer/Clusterer.h"
+#include "anki/util/HighRezTimer.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace anki {
+
+static const F32 NEAR = 0.1;
+static const F32 FAR = 500.0;
+static const F32 TAN_X = 1.0;
+static const F32 TAN_Y = 0.5625;
+
+//==============================================================================
+/// Create random point lights in front of the camera
+static void createLights(U32 count, F32 maxDepth, 
+	Vector<ClustererLight>& lights)
+{
+	srand(0);
+	auto rnd = []() -> F32
+	{
+		return F32(rand()) / F32(RAND_MAX);
+	};
+
+	lights.resize(count);
+	for(U32 i = 0; i < count; i++)
+	{
+		F32 depth = NEAR + rnd() * maxDepth;
+		ClustererLight& l = lights[i];
+		l.m_posRadius = Vec4(
+			(rnd() * 2.0 - 1.0) * TAN_X * depth,
+			(rnd() * 2.0 - 1.0) * TAN_Y * depth,
+			-depth,
+			0.5 + rnd() * 4.0);
+		l.m_index = i;
+		l.m_type = ClustererLightType::POINT;
+	}
+}
+
+//==============================================================================
+/// Check if a sphere is fully on the one side of a tile edge
+static Bool outsideEdge(F32 a, F32 z, F32 radius, F32 t, Bool positive)
+{
+	F32 d = (a + z * t) / sqrt(1.0 + t * t);
+	return (positive) ? d > radius : d < -radius;
+}
+
+//==============================================================================
+/// Test a sphere against the side planes and the AABB of a cluster. If it
+/// passes the cluster should have the light
+static Bool sphereInCluster(const Vec4& sphere, U x, U y, U z,
+	const Clusterer& c)
+{
+	F32 d0 = NEAR * pow(FAR / NEAR, F32(z) / F32(c.getClustersCountZ()));
+	F32 d1 = NEAR * pow(FAR / NEAR, F32(z + 1) / F32(c.getClustersCountZ()));
+
+	auto edge = [](U i, U count, F32 tanHalfFov)
+	{
+		return tanHalfFov * (2.0 * F32(i) / F32(count) - 1.0);
+	};
+
+	F32 tx0 = edge(x, c.getClustersCountX(), TAN_X);
+	F32 tx1 = edge(x + 1, c.getClustersCountX(), TAN_X);
+	F32 ty0 = edge(y, c.getClustersCountY(), TAN_Y);
+	F32 ty1 = edge(y + 1, c.getClustersCountY(), TAN_Y);
+
+	if(outsideEdge(sphere.x(), sphere.z(), sphere.w(), tx0, false)
+		|| outsideEdge(sphere.x(), sphere.z(), sphere.w(), tx1, true)
+		|| outsideEdge(sphere.y(), sphere.z(), sphere.w(), ty0, false)
+		|| outsideEdge(sphere.y(), sphere.z(), sphere.w(), ty1, true))
+	{
+		return false;
+	}
+
+	Vec3 aabbMin(std::min(tx0 * d0, tx0 * d1), std::min(ty0 * d0, ty0 * d1),
+		-d1);
+	Vec3 aabbMax(std::max(tx1 * d0, tx1 * d1), std::max(ty1 * d0, ty1 * d1),
+		-d0);
+
+	Vec3 closest;
+	for(U i = 0; i < 3; i++)
+	{
+		closest[i] = std::min(std::max(sphere[i], aabbMin[i]), aabbMax[i]);
+	}
+
+	return (closest - sphere.xyz()).getLengthSquared()
+		<= sphere.w() * sphere.w();
+}
+
+//==============================================================================
+ANKI_TEST(Renderer, Clusterer)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Threadpool threadpool(4);
+
+	Clusterer c;
+	c.init(alloc, 16, 9, 16, {{0xFFFF, 0xFF, 0xFF}});
+	c.prepare(NEAR, FAR, TAN_X, TAN_Y);
+
+	ANKI_TEST_EXPECT_EQ(c.getSlice(NEAR), 0);
+	ANKI_TEST_EXPECT_EQ(c.getSlice(FAR * 0.999), 15);
+
+	// Every light that touches a cluster should be in it
+	Vector<ClustererLight> lights(alloc);
+	createLights(200, 100.0, lights);
+	c.bin(&lights[0], lights.size(), threadpool);
+
+	U32 missing = 0;
+	for(U z = 0; z < c.getClustersCountZ(); z++)
+	{
+		for(U y = 0; y < c.getClustersCountY(); y++)
+		{
+			for(U x = 0; x < c.getClustersCountX(); x++)
+			{
+				const ClustererCluster& cluster = c.getCluster(x, y, z);
+				const U32* indices = c.getLightIndices() + cluster.m_offset;
+				U32 count = cluster.getCount(ClustererLightType::POINT);
+
+				for(const ClustererLight& l : lights)
+				{
+					if(!sphereInCluster(l.m_posRadius, x, y, z, c))
+					{
+						continue;
+					}
+
+					Bool found = false;
+					for(U32 i = 0; i < count; i++)
+					{
+						found = found || indices[i] == l.m_index;
+					}
+
+					missing += found ? 0 : 1;
+				}
+			}
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(missing, 0);
+
+	// With depth bounds the clusters outside the bounds should be empty
+	Vector<Vec2> bounds(alloc);
+	bounds.resize(c.getClustersCountX() * c.getClustersCountY(), 
+		Vec2(20.0, 30.0));
+	c.setTileDepthBounds(&bounds[0]);
+	c.bin(&lights[0], lights.size(), threadpool);
+	c.setTileDepthBounds(nullptr);
+
+	U32 outside = 0;
+	U32 inside = 0;
+	for(U z = 0; z < c.getClustersCountZ(); z++)
+	{
+		Bool in = z >= c.getSlice(20.0) && z <= c.getSlice(30.0);
+		for(U y = 0; y < c.getClustersCountY(); y++)
+		{
+			for(U x = 0; x < c.getClustersCountX(); x++)
+			{
+				U32 count = 
+					c.getCluster(x, y, z).getCount(ClustererLightType::POINT);
+				outside += (in) ? 0 : count;
+				inside += (in) ? count : 0;
+			}
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(outside, 0);
+	ANKI_TEST_EXPECT_EQ(inside > 0, true);
+
+	// A spot that looks away from the camera shouldn't touch the clusters
+	// behind it
+	ClustererLight spot;
+	spot.m_posRadius = Vec4(0.0, 0.0, -10.0, 5.0);
+	spot.m_dir = Vec4(0.0, 0.0, -1.0, 0.0);
+	spot.m_outerCos = cos(toRad(20.0));
+	spot.m_outerSin = sin(toRad(20.0));
+	spot.m_type = ClustererLightType::SPOT;
+
+	c.bin(&spot, 1, threadpool);
+	U32 z = c.getSlice(7.0);
+	const ClustererCluster& near = c.getCluster(8, 4, z);
+	ANKI_TEST_EXPECT_EQ(near.getCount(ClustererLightType::SPOT), 0);
+	z = c.getSlice(13.0);
+	const ClustererCluster& far = c.getCluster(8, 4, z);
+	ANKI_TEST_EXPECT_EQ(far.getCount(ClustererLightType::SPOT), 1);
+}
+
+//==============================================================================
+ANKI_TEST(Renderer, ClustererBenchmark)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Threadpool threadpool(4);
+
+	Clusterer c;
+	c.init(alloc, 30, 17, 32, {{0xFFFF, 0xFF, 0xFF}});
+	c.prepare(NEAR, FAR, TAN_X, TAN_Y);
+
+	const U ITERATIONS = 10;
+	Vector<ClustererLight> lights(alloc);
+
+	// Fake depth bounds. Every tile has geometry in a random range of a few
+	// meters like a depth buffer would have
+	Vector<Vec2> bounds(alloc);
+	bounds.resize(c.getClustersCountX() * c.getClustersCountY());
+	srand(1);
+	for(Vec2& b : bounds)
+	{
+		F32 depth = 1.0 + F32(rand()) / F32(RAND_MAX) * 250.0;
+		b = Vec2(depth, depth + 5.0 + depth * 0.1);
+	}
+
+	for(U32 count : {1000, 5000, 10000})
+	{
+		createLights(count, 300.0, lights);
+
+		Array<const Vec2*, 2> allBounds = {{nullptr, &bounds[0]}};
+		for(const Vec2* b : allBounds)
+		{
+			c.setTileDepthBounds(b);
+
+			HighRezTimer timer;
+			timer.start();
+			for(U i = 0; i < ITERATIONS; i++)
+			{
+				c.bin(&lights[0], lights.size(), threadpool);
+			}
+			timer.stop();
+
+			std::cout << "Clusterer: " << count << " lights, "
+				<< ((b) ? "with" : "without") << " depth bounds, "
+				<< (F32(c.getLightIndicesCount()) / F32(c.getClustersCount()))
+				<< " lights per cluster, "
+				<< (timer.getElapsedTime() / ITERATIONS * 1000.0) << "ms"
+				<< std::endl;
+		}
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,291 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/renderer/RenderQueue.h"
+#include "anki/scene/RenderComponent.h"
+#include "anki/gl/GlCommandBufferHandle.h"
+#include "anki/gl/GlQueue.h"
+#include "anki/gl/GlProgramPipeline.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The queue is never started and the device is never accessed so the tests
+/// run without a GL context
+static GlDevice* const fakeDevice = reinterpret_cast<GlDevice*>(0x10);
+
+//==============================================================================
+static GlCommandBufferHandle newCommandBuffer(GlQueue& queue)
+{
+	using Alloc = HeapAllocator<GlCommandBuffer>;
+	Alloc alloc = Alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	GlCommandBufferHandle commands;
+	static_cast<GlCommandBufferHandle::Base&>(commands) =
+		GlCommandBufferHandle::Base(
+		nullptr,
+		alloc,
+		GlHandleDefaultDeleter<GlCommandBuffer, Alloc>(),
+		&queue,
+		GlCommandBufferInitHints());
+
+	return commands;
+}
+
+//==============================================================================
+/// A pipeline that has no GL object. It's only compared and referenced
+static GlProgramPipelineHandle newPipeline()
+{
+	using Alloc = HeapAllocator<GlProgramPipeline>;
+	using Handle = GlHandle<GlProgramPipeline>;
+
+	GlProgramPipelineHandle ppline;
+	static_cast<Handle&>(ppline) = Handle(
+		nullptr,
+		Alloc(HeapMemoryPool(allocAligned, nullptr)),
+		GlHandleDefaultDeleter<GlProgramPipeline, Alloc>());
+
+	return ppline;
+}
+
+//==============================================================================
+/// The renderables don't exist. The node pointer is the index of the
+/// element in the order it was pushed
+static VisibleNode* indexToNode(U32 i)
+{
+	return reinterpret_cast<VisibleNode*>(PtrSize(i) + 1);
+}
+
+static U32 nodeToIndex(const VisibleNode* node)
+{
+	return U32(reinterpret_cast<PtrSize>(node) - 1);
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Renderer, RenderQueueKey)
+{
+	RenderingKey color(Pass::COLOR, 0, false);
+	RenderingKey depth(Pass::DEPTH, 0, false);
+
+	// Opaque: pass, pipeline, material, mesh and then front to back
+	U64 a = RenderQueue::computeKey(color, 1, 1, 1, 0.5, false);
+
+	ANKI_TEST_EXPECT_EQ(
+		a < RenderQueue::computeKey(depth, 0, 0, 0, 0.0, false), true);
+	ANKI_TEST_EXPECT_EQ(
+		a < RenderQueue::computeKey(color, 2, 0, 0, 0.0, false), true);
+	ANKI_TEST_EXPECT_EQ(
+		a < RenderQueue::computeKey(color, 1, 2, 0, 0.0, false), true);
+	ANKI_TEST_EXPECT_EQ(
+		a < RenderQueue::computeKey(color, 1, 1, 2, 0.0, false), true);
+	ANKI_TEST_EXPECT_EQ(
+		a < RenderQueue::computeKey(color, 1, 1, 1, 0.75, false), true);
+	ANKI_TEST_EXPECT_EQ(
+		a > RenderQueue::computeKey(color, 1, 1, 1, 0.25, false), true);
+
+	// The LOD and the tessellation are part of the pipeline
+	ANKI_TEST_EXPECT_NEQ(a, RenderQueue::computeKey(
+		RenderingKey(Pass::COLOR, 1, false), 1, 1, 1, 0.5, false));
+	ANKI_TEST_EXPECT_NEQ(a, RenderQueue::computeKey(
+		RenderingKey(Pass::COLOR, 0, true), 1, 1, 1, 0.5, false));
+
+	// The depth is clamped
+	ANKI_TEST_EXPECT_EQ(RenderQueue::computeKey(color, 1, 1, 1, -1.0, false),
+		RenderQueue::computeKey(color, 1, 1, 1, 0.0, false));
+	ANKI_TEST_EXPECT_EQ(RenderQueue::computeKey(color, 1, 1, 1, 2.0, false),
+		RenderQueue::computeKey(color, 1, 1, 1, 1.0, false));
+
+	// Blended: back to front before the state
+	U64 b = RenderQueue::computeKey(color, 1, 1, 1, 0.5, true);
+
+	ANKI_TEST_EXPECT_EQ(
+		b > RenderQueue::computeKey(color, 2, 2, 2, 0.75, true), true);
+	ANKI_TEST_EXPECT_EQ(
+		b < RenderQueue::computeKey(color, 0, 0, 0, 0.25, true), true);
+	ANKI_TEST_EXPECT_EQ(
+		b < RenderQueue::computeKey(color, 2, 0, 0, 0.5, true), true);
+}
+
+//==============================================================================
+ANKI_TEST(Renderer, RenderQueueSort)
+{
+	const U32 COUNT = 5000;
+
+	SceneFrameAllocator<U8> alloc(
+		StackMemoryPool(allocAligned, nullptr, 1024 * 1024));
+	HeapAllocator<U8> heapAlloc(HeapMemoryPool(allocAligned, nullptr));
+	Vector<U64> keys(COUNT, 0, heapAlloc);
+
+	// Few different keys so there are many equal ones. Random bits all over
+	// the key so every digit is sorted
+	srand(0);
+	for(U32 i = 0; i < COUNT; i++)
+	{
+		U64 k = U64(rand() % 64);
+		keys[i] = (k << 58) | (k << 29) | k;
+	}
+
+	RenderQueue queue(alloc, COUNT);
+	for(U32 i = 0; i < COUNT; i++)
+	{
+		queue.pushBack(keys[i], indexToNode(i), 0.0);
+	}
+
+	queue.sort();
+	ANKI_TEST_EXPECT_EQ(queue.getSize(), COUNT);
+
+	// Sorted, the elements kept their keys and the equal keys kept the
+	// order they were pushed in
+	U32 errors = 0;
+	Vector<U8> seen(COUNT, 0, heapAlloc);
+	for(U32 i = 0; i < COUNT; i++)
+	{
+		const RenderQueueElement& el = queue[i];
+		U32 idx = nodeToIndex(el.m_node);
+
+		errors += idx >= COUNT || seen[idx] || keys[idx] != el.m_key;
+		seen[idx] = 1;
+
+		if(i > 0)
+		{
+			const RenderQueueElement& prev = queue[i - 1];
+			errors += prev.m_key > el.m_key;
+			errors += prev.m_key == el.m_key
+				&& nodeToIndex(prev.m_node) > idx;
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(errors, 0);
+
+	// All keys equal skips every digit
+	RenderQueue same(alloc, 3);
+	for(U32 i = 0; i < 3; i++)
+	{
+		same.pushBack(123, indexToNode(i), 0.0);
+	}
+
+	same.sort();
+	ANKI_TEST_EXPECT_EQ(nodeToIndex(same[0].m_node), 0);
+	ANKI_TEST_EXPECT_EQ(nodeToIndex(same[2].m_node), 2);
+}
+
+//==============================================================================
+ANKI_TEST(Renderer, RenderingState)
+{
+	GlQueue glQueue(fakeDevice, allocAligned, nullptr);
+	GlCommandBufferHandle jobs = newCommandBuffer(glQueue);
+
+	GlProgramPipelineHandle ppline0 = newPipeline();
+	GlProgramPipelineHandle ppline1 = newPipeline();
+	GlCommandBufferHandle vert0 = newCommandBuffer(glQueue);
+	GlCommandBufferHandle vert1 = newCommandBuffer(glQueue);
+
+	RenderingState state;
+
+	// The binds of the same objects are skipped
+	state.bindProgramPipeline(ppline0, jobs);
+	state.bindVertexJobs(vert0, jobs);
+	state.bindProgramPipeline(ppline0, jobs);
+	state.bindVertexJobs(vert0, jobs);
+	ANKI_TEST_EXPECT_EQ(state.getStateChangesCount(), 2);
+
+	state.bindVertexJobs(vert1, jobs);
+	state.bindProgramPipeline(ppline1, jobs);
+	state.bindProgramPipeline(ppline0, jobs);
+	ANKI_TEST_EXPECT_EQ(state.getStateChangesCount(), 5);
+
+	// After an invalidate the same vertex jobs are pushed again
+	state.invalidateVertexJobs();
+	state.bindVertexJobs(vert1, jobs);
+	ANKI_TEST_EXPECT_EQ(state.getStateChangesCount(), 7);
+
+	// After a reset everything is bound again
+	state.reset();
+	ANKI_TEST_EXPECT_EQ(state.getStateChangesCount(), 0);
+	state.bindProgramPipeline(ppline0, jobs);
+	state.bindVertexJobs(vert1, jobs);
+	ANKI_TEST_EXPECT_EQ(state.getStateChangesCount(), 2);
+}
+
+//==============================================================================
+ANKI_TEST(Renderer, RenderQueueStateChanges)
+{
+	// Renderables with random pipelines and meshes. Count the binds that
+	// RenderingState doesn't skip in the visibility order and sorted
+	const U32 COUNT = 2000;
+	const U32 PIPELINES = 8;
+	const U32 MESHES = 32;
+
+	SceneFrameAllocator<U8> alloc(
+		StackMemoryPool(allocAligned, nullptr, 1024 * 1024));
+	HeapAllocator<U8> heapAlloc(HeapMemoryPool(allocAligned, nullptr));
+	GlQueue glQueue(fakeDevice, allocAligned, nullptr);
+
+	Vector<GlProgramPipelineHandle> pplines(heapAlloc);
+	for(U32 i = 0; i < PIPELINES; i++)
+	{
+		pplines.push_back(newPipeline());
+	}
+
+	Vector<GlCommandBufferHandle> vertJobs(heapAlloc);
+	for(U32 i = 0; i < MESHES; i++)
+	{
+		vertJobs.push_back(newCommandBuffer(glQueue));
+	}
+
+	srand(0);
+	Vector<U32> pplineIds(COUNT, 0, heapAlloc);
+	Vector<U32> meshIds(COUNT, 0, heapAlloc);
+	RenderQueue queue(alloc, COUNT);
+	for(U32 i = 0; i < COUNT; i++)
+	{
+		pplineIds[i] = rand() % PIPELINES;
+		meshIds[i] = rand() % MESHES;
+		F32 depth = F32(rand()) / F32(RAND_MAX);
+
+		U64 key = RenderQueue::computeKey(RenderingKey(), pplineIds[i],
+			0, meshIds[i], depth, false);
+		queue.pushBack(key, indexToNode(i), 0.0);
+	}
+
+	auto countStateChanges = [&]() -> U32
+	{
+		GlCommandBufferHandle jobs = newCommandBuffer(glQueue);
+		RenderingState state;
+
+		for(const RenderQueueElement& el : queue)
+		{
+			U32 idx = nodeToIndex(el.m_node);
+			state.bindProgramPipeline(pplines[pplineIds[idx]], jobs);
+			state.bindVertexJobs(vertJobs[meshIds[idx]], jobs);
+		}
+
+		return state.getStateChangesCount();
+	};
+
+	U32 unsorted = countStateChanges();
+	queue.sort();
+	U32 sorted = countStateChanges();
+
+	// Sorted every pipeline is bound once and every mesh once per pipeline
+	ANKI_TEST_EXPECT_EQ(sorted <= PIPELINES + PIPELINES * MESHES, true);
+	ANKI_TEST_EXPECT_EQ(sorted < unsorted, true);
+
+	std::cout << "Render queue: " << COUNT << " draw calls, "
+		<< unsorted << " state changes unsorted, " << sorted
+		<< " sorted" << std::endl;
+}
+
+} // end namespace anki
@@ -0,0 +1,157 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/MeshCluster.h"
+#include "anki/collision/Frustum.h"
+#include <algorithm>
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// A terrain on the XY plane. Its normals look to +Z
+static void createTerrain(U size, TempResourceVector<Vec3>& positions,
+	TempResourceVector<U16>& indices)
+{
+	U rowVerts = size + 1;
+	for(U y = 0; y <= size; y++)
+	{
+		for(U x = 0; x <= size; x++)
+		{
+			positions.push_back(Vec3(x, y, sin(x * 0.3) * cos(y * 0.2)));
+		}
+	}
+
+	for(U y = 0; y < size; y++)
+	{
+		for(U x = 0; x < size; x++)
+		{
+			U16 a = y * rowVerts + x;
+			U16 b = a + 1;
+			U16 c = a + rowVerts + 1;
+			U16 d = a + rowVerts;
+
+			indices.insert(indices.end(), {a, b, c, a, c, d});
+		}
+	}
+}
+
+//==============================================================================
+/// The triangles sorted so two meshes can be compared
+static void getSortedTriangles(const TempResourceVector<U16>& indices,
+	TempResourceVector<U64>& tris)
+{
+	for(U i = 0; i < indices.size(); i += 3)
+	{
+		// Rotate the smallest first to keep the winding
+		U j = std::min_element(&indices[i], &indices[i] + 3) - &indices[i];
+		U64 a = indices[i + j];
+		U64 b = indices[i + (j + 1) % 3];
+		U64 c = indices[i + (j + 2) % 3];
+		tris.push_back((a << 32) | (b << 16) | c);
+	}
+
+	std::sort(tris.begin(), tris.end());
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Resource, MeshCluster)
+{
+	TempResourceAllocator<U8> alloc(
+		StackMemoryPool(allocAligned, nullptr, 64 * 1024 * 1024));
+
+	TempResourceVector<Vec3> positions(alloc);
+	TempResourceVector<U16> indices(alloc);
+	createTerrain(128, positions, indices);
+
+	TempResourceVector<U16> original(indices.begin(), indices.end(), alloc);
+	TempResourceVector<MeshCluster> clusters(alloc);
+	buildMeshClusters(alloc, &positions[0], positions.size(), &indices[0],
+		indices.size(), clusters);
+
+	// The same triangles in clusters
+	{
+		TempResourceVector<U64> a(alloc);
+		TempResourceVector<U64> b(alloc);
+		getSortedTriangles(original, a);
+		getSortedTriangles(indices, b);
+		ANKI_TEST_EXPECT_EQ(a == b, true);
+	}
+
+	ANKI_TEST_EXPECT_EQ(clusters.size() >= indices.size() / 3
+		/ MeshCluster::MAX_TRIANGLES, true);
+	ANKI_TEST_EXPECT_EQ(clusters.size() < indices.size() / 3
+		/ MeshCluster::MAX_TRIANGLES * 5 / 4, true);
+
+	U32 nextIndex = 0;
+	for(const MeshCluster& cluster : clusters)
+	{
+		ANKI_TEST_EXPECT_EQ(cluster.m_firstIndex, nextIndex);
+		ANKI_TEST_EXPECT_EQ(
+			cluster.m_indicesCount <= MeshCluster::MAX_TRIANGLES * 3, true);
+		nextIndex += cluster.m_indicesCount;
+
+		// The sphere has the vertices and the terrain is not steep
+		for(U i = 0; i < cluster.m_indicesCount; i++)
+		{
+			Vec3 p = positions[indices[cluster.m_firstIndex + i]];
+			ANKI_TEST_EXPECT_EQ((p - cluster.m_sphere.xyz()).getLength()
+				<= cluster.m_sphere.w() + 0.001, true);
+		}
+
+		ANKI_TEST_EXPECT_EQ(cluster.m_cone.z() > 0.5, true);
+		ANKI_TEST_EXPECT_EQ(cluster.m_cone.w() < 1.0, true);
+	}
+	ANKI_TEST_EXPECT_EQ(nextIndex, indices.size());
+
+	// Standing in the middle of the terrain and looking along it
+	PerspectiveFrustum frustum(toRad(60.0), toRad(45.0), 0.1, 1000.0);
+	frustum.resetTransform(Transform(Vec4(64.0, 64.0, 3.0, 0.0),
+		Mat3x4(Euler(toRad(80.0), 0.0, 0.0)), 1.0));
+	const Vec4 eye = frustum.getTransform().getOrigin();
+	const auto& planes = frustum.getPlanes();
+
+	TempResourceVector<U32> visible(clusters.size(), 0, alloc);
+	U32 visibleCount = cullMeshClusters(&clusters[0], clusters.size(),
+		&planes[0], planes.size(), &eye, &visible[0]);
+
+	U32 visibleIndices = 0;
+	for(U i = 0; i < visibleCount; i++)
+	{
+		visibleIndices += clusters[visible[i]].m_indicesCount;
+	}
+
+	ANKI_TEST_EXPECT_EQ(visibleCount > 0, true);
+	ANKI_TEST_EXPECT_EQ(visibleIndices < indices.size() / 3, true);
+
+	// The SIMD and the scalar paths agree
+	U32 count = 0;
+	for(U i = 0; i < clusters.size(); i++)
+	{
+		U32 v;
+		if(cullMeshClusters(&clusters[i], 1, &planes[0], planes.size(),
+			&eye, &v))
+		{
+			ANKI_TEST_EXPECT_EQ(visible[count], i);
+			++count;
+		}
+	}
+	ANKI_TEST_EXPECT_EQ(count, visibleCount);
+
+	// From under the terrain it shows its back
+	const Vec4 under(64.0, 64.0, -50.0, 0.0);
+	ANKI_TEST_EXPECT_EQ(cullMeshClusters(&clusters[0], clusters.size(),
+		nullptr, 0, &under, &visible[0]), 0);
+	ANKI_TEST_EXPECT_EQ(cullMeshClusters(&clusters[0], clusters.size(),
+		nullptr, 0, nullptr, &visible[0]), clusters.size());
+}
@@ -0,0 +1,250 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/MeshSimplifier.h"
+#include <algorithm>
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+//==============================================================================
+/// A grid on the XY plane. It splits the vertices of the middle column like
+/// a seam of the texture coordinates
+static void createGrid(U size, Bool seam, ResourceVector<Vec3>& positions,
+	ResourceVector<U32>& indices)
+{
+	U rowVerts = size + 1;
+	for(U y = 0; y <= size; y++)
+	{
+		for(U x = 0; x <= size; x++)
+		{
+			positions.push_back(Vec3(x, y, 0.0));
+		}
+	}
+
+	// The copies of the middle column
+	U seamX = size / 2;
+	U32 seamBegin = positions.size();
+	if(seam)
+	{
+		for(U y = 0; y <= size; y++)
+		{
+			positions.push_back(Vec3(seamX, y, 0.0));
+		}
+	}
+
+	auto index = [&](U x, U y, Bool right) -> U32
+	{
+		return (seam && right && x == seamX)
+			? seamBegin + y
+			: y * rowVerts + x;
+	};
+
+	for(U y = 0; y < size; y++)
+	{
+		for(U x = 0; x < size; x++)
+		{
+			Bool right = x >= seamX;
+			U32 a = index(x, y, right);
+			U32 b = index(x + 1, y, right);
+			U32 c = index(x + 1, y + 1, right);
+			U32 d = index(x, y + 1, right);
+
+			indices.insert(indices.end(), {a, b, c, a, c, d});
+		}
+	}
+}
+
+//==============================================================================
+/// A closed sphere without seams
+static void createSphere(U rings, U sectors, ResourceVector<Vec3>& positions,
+	ResourceVector<U32>& indices)
+{
+	positions.push_back(Vec3(0.0, 0.0, 1.0));
+	for(U r = 1; r < rings; r++)
+	{
+		F32 theta = getPi<F32>() * F32(r) / F32(rings);
+		for(U s = 0; s < sectors; s++)
+		{
+			F32 phi = 2.0 * getPi<F32>() * F32(s) / F32(sectors);
+			positions.push_back(Vec3(sin(theta) * cos(phi),
+				sin(theta) * sin(phi), cos(theta)));
+		}
+	}
+	positions.push_back(Vec3(0.0, 0.0, -1.0));
+
+	U32 last = positions.size() - 1;
+	auto ring = [&](U r, U s) -> U32
+	{
+		return 1 + (r - 1) * sectors + (s % sectors);
+	};
+
+	for(U s = 0; s < sectors; s++)
+	{
+		indices.insert(indices.end(), {0, ring(1, s), ring(1, s + 1)});
+		indices.insert(indices.end(),
+			{last, ring(rings - 1, s + 1), ring(rings - 1, s)});
+	}
+
+	for(U r = 1; r < rings - 1; r++)
+	{
+		for(U s = 0; s < sectors; s++)
+		{
+			U32 a = ring(r, s);
+			U32 b = ring(r + 1, s);
+			U32 c = ring(r + 1, s + 1);
+			U32 d = ring(r, s + 1);
+			indices.insert(indices.end(), {a, b, c, a, c, d});
+		}
+	}
+}
+
+//==============================================================================
+/// The area of the triangles projected to the XY plane. Negative if they
+/// face down
+static F32 getProjectedArea(const ResourceVector<Vec3>& positions,
+	const ResourceVector<U32>& indices, F32& minArea)
+{
+	F32 area = 0.0;
+	minArea = MAX_F32;
+	for(U i = 0; i < indices.size(); i += 3)
+	{
+		Vec3 a = positions[indices[i + 1]] - positions[indices[i]];
+		Vec3 b = positions[indices[i + 2]] - positions[indices[i]];
+		F32 triArea = a.cross(b).z() * 0.5;
+		area += triArea;
+		minArea = std::min(minArea, triArea);
+	}
+
+	return area;
+}
+
+//==============================================================================
+static F32 getVolume(const ResourceVector<Vec3>& positions,
+	const ResourceVector<U32>& indices)
+{
+	F32 volume = 0.0;
+	for(U i = 0; i < indices.size(); i += 3)
+	{
+		const Vec3& a = positions[indices[i]];
+		const Vec3& b = positions[indices[i + 1]];
+		const Vec3& c = positions[indices[i + 2]];
+		volume += a.dot(b.cross(c)) / 6.0;
+	}
+
+	return volume;
+}
+
+//==============================================================================
+/// Every edge should be in two triangles with opposite directions
+static Bool isClosed(const ResourceVector<U32>& indices)
+{
+	ResourceVector<U64> edges(indices.get_allocator());
+	for(U i = 0; i < indices.size(); i += 3)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			U64 a = indices[i + j];
+			U64 b = indices[i + (j + 1) % 3];
+			edges.push_back((a << 32) | b);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+	for(U64 e : edges)
+	{
+		U64 twin = (e << 32) | (e >> 32);
+		if(!std::binary_search(edges.begin(), edges.end(), twin)
+			|| std::count(edges.begin(), edges.end(), e) != 1)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Resource, MeshSimplifier)
+{
+	ResourceAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	// A flat grid has no error. The border and the seam stay
+	{
+		ResourceVector<Vec3> positions(alloc);
+		ResourceVector<U32> indices(alloc);
+		createGrid(16, true, positions, indices);
+
+		MeshSimplifier simplifier(alloc, &positions[0], positions.size(),
+			&indices[0], indices.size());
+		simplifier.simplify(0, 0.001);
+		ANKI_TEST_EXPECT_EQ(simplifier.getIndicesCount() < indices.size() / 4,
+			true);
+		ANKI_TEST_EXPECT_NEAR(simplifier.getError(), 0.0, 0.001);
+
+		ResourceVector<U32> newIndices(alloc);
+		simplifier.getIndices(newIndices);
+		ANKI_TEST_EXPECT_EQ(newIndices.size(), simplifier.getIndicesCount());
+
+		F32 minArea;
+		ANKI_TEST_EXPECT_NEAR(getProjectedArea(positions, newIndices, minArea),
+			16.0 * 16.0, 0.01);
+		ANKI_TEST_EXPECT_EQ(minArea > 0.0, true);
+
+		for(U32 v = 17 * 17; v < positions.size(); v++)
+		{
+			ANKI_TEST_EXPECT_EQ(
+				std::count(newIndices.begin(), newIndices.end(), v) > 0, true);
+		}
+	}
+
+	// A chain of LODs of a sphere
+	{
+		ResourceVector<Vec3> positions(alloc);
+		ResourceVector<U32> indices(alloc);
+		createSphere(32, 64, positions, indices);
+		F32 volume = getVolume(positions, indices);
+
+		MeshSimplifier simplifier(alloc, &positions[0], positions.size(),
+			&indices[0], indices.size());
+
+		U32 count1 = simplifier.simplify(indices.size() / 4, 1.0);
+		F32 error1 = simplifier.getError();
+		ANKI_TEST_EXPECT_EQ(count1 <= indices.size() / 4, true);
+		ANKI_TEST_EXPECT_EQ(error1 > 0.0, true);
+
+		U32 count2 = simplifier.simplify(indices.size() / 16, 1.0);
+		F32 error2 = simplifier.getError();
+		ANKI_TEST_EXPECT_EQ(count2 <= indices.size() / 16, true);
+		ANKI_TEST_EXPECT_EQ(error2 >= error1, true);
+
+		ResourceVector<U32> newIndices(alloc);
+		simplifier.getIndices(newIndices);
+		ANKI_TEST_EXPECT_EQ(isClosed(newIndices), true);
+		ANKI_TEST_EXPECT_EQ(
+			getVolume(positions, newIndices) > volume * 0.85, true);
+
+		// The error stops it
+		U32 count3 = simplifier.simplify(0, error2);
+		ANKI_TEST_EXPECT_EQ(count3 > 0, true);
+		ANKI_TEST_EXPECT_EQ(simplifier.getError() <= error2, true);
+
+		// Compact
+		ResourceVector<U32> remap(alloc);
+		MeshSimplifier::compactVertices(newIndices, positions.size(), remap);
+		ANKI_TEST_EXPECT_EQ(remap.size() < positions.size() / 8, true);
+		ANKI_TEST_EXPECT_EQ(
+			*std::max_element(newIndices.begin(), newIndices.end()),
+			remap.size() - 1);
+	}
+}
@@ -0,0 +1,380 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/TextureCompression.h"
+#include "anki/resource/TextureCooker.h"
+#include "anki/util/HighRezTimer.h"
+#include "anki/util/System.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The block compressors are checked against these decoders that follow the
+/// specs
+
+//==============================================================================
+static U32 readBigEndian(const U8* in)
+{
+	return (U32(in[0]) << 24) | (U32(in[1]) << 16) | (U32(in[2]) << 8) | in[3];
+}
+
+//==============================================================================
+static void decodeBc1Colors(const U8* in, U8* out)
+{
+	Array<U16, 2> c = {{U16(in[0] | (in[1] << 8)), U16(in[2] | (in[3] << 8))}};
+	Array<Array<I32, 3>, 4> palette;
+	for(U i = 0; i < 2; i++)
+	{
+		palette[i][0] = ((c[i] >> 11) & 31) * 255 / 31;
+		palette[i][1] = ((c[i] >> 5) & 63) * 255 / 63;
+		palette[i][2] = (c[i] & 31) * 255 / 31;
+	}
+
+	for(U j = 0; j < 3; j++)
+	{
+		if(c[0] > c[1])
+		{
+			palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+			palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+		}
+		else
+		{
+			palette[2][j] = (palette[0][j] + palette[1][j]) / 2;
+			palette[3][j] = 0;
+		}
+	}
+
+	U32 indices = in[4] | (in[5] << 8) | (in[6] << 16) | (U32(in[7]) << 24);
+	for(U i = 0; i < 16; i++)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			out[i * 4 + j] = palette[(indices >> (i * 2)) & 3][j];
+		}
+	}
+}
+
+//==============================================================================
+static void decodeBc3Alpha(const U8* in, U8* out)
+{
+	Array<I32, 8> palette;
+	palette[0] = in[0];
+	palette[1] = in[1];
+	if(palette[0] > palette[1])
+	{
+		for(U i = 1; i < 7; i++)
+		{
+			palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+		}
+	}
+	else
+	{
+		for(U i = 1; i < 5; i++)
+		{
+			palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	U64 indices = 0;
+	for(U i = 0; i < 6; i++)
+	{
+		indices |= U64(in[2 + i]) << (i * 8);
+	}
+
+	for(U i = 0; i < 16; i++)
+	{
+		out[i * 4 + 3] = palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+//==============================================================================
+static void decodeEtcColors(const U8* in, U8* out)
+{
+	static const I32 MODIFIERS[8][2] = {
+		{2, 8}, {5, 17}, {9, 29}, {13, 42},
+		{18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+	U32 high = readBigEndian(in);
+	U32 low = readBigEndian(in + 4);
+	Bool diff = (high >> 1) & 1;
+	Bool flip = high & 1;
+
+	Array<Array<I32, 3>, 2> base;
+	for(U c = 0; c < 3; c++)
+	{
+		U shift = 24 - c * 8;
+		if(diff)
+		{
+			I32 a = (high >> (shift + 3)) & 31;
+			I32 d = (high >> shift) & 7;
+			I32 b = a + ((d >= 4) ? d - 8 : d);
+			ANKI_TEST_EXPECT_EQ(b >= 0 && b < 32, true);
+			base[0][c] = (a << 3) | (a >> 2);
+			base[1][c] = (b << 3) | (b >> 2);
+		}
+		else
+		{
+			I32 a = (high >> (shift + 4)) & 15;
+			I32 b = (high >> shift) & 15;
+			base[0][c] = a * 17;
+			base[1][c] = b * 17;
+		}
+	}
+
+	Array<U, 2> tables = {{(high >> 5) & 7, (high >> 2) & 7}};
+	for(U i = 0; i < 16; i++)
+	{
+		U x = i % 4, y = i / 4;
+		U sub = flip ? (y >= 2) : (x >= 2);
+		U bit = x * 4 + y;
+		U s = (((low >> (16 + bit)) & 1) << 1) | ((low >> bit) & 1);
+		I32 mod = MODIFIERS[tables[sub]][s & 1];
+		mod = (s & 2) ? -mod : mod;
+
+		for(U c = 0; c < 3; c++)
+		{
+			out[i * 4 + c] = std::min(std::max(base[sub][c] + mod, 0), 255);
+		}
+	}
+}
+
+//==============================================================================
+static void decodeEacAlpha(const U8* in, U8* out)
+{
+	static const I32 MODIFIERS[16][8] = {
+		{-3, -6, -9, -15, 2, 5, 8, 14},
+		{-3, -7, -10, -13, 2, 6, 9, 12},
+		{-2, -5, -8, -13, 1, 4, 7, 12},
+		{-2, -4, -6, -13, 1, 3, 5, 12},
+		{-3, -6, -8, -12, 2, 5, 7, 11},
+		{-3, -7, -9, -11, 2, 6, 8, 10},
+		{-4, -7, -8, -11, 3, 6, 7, 10},
+		{-3, -5, -8, -11, 2, 4, 7, 10},
+		{-2, -6, -8, -10, 1, 5, 7, 9},
+		{-2, -5, -8, -10, 1, 4, 7, 9},
+		{-2, -4, -8, -10, 1, 3, 7, 9},
+		{-2, -5, -7, -10, 1, 4, 6, 9},
+		{-3, -4, -7, -10, 2, 3, 6, 9},
+		{-1, -2, -3, -10, 0, 1, 2, 9},
+		{-4, -6, -8, -9, 3, 5, 7, 8},
+		{-3, -5, -7, -9, 2, 4, 6, 8}};
+
+	U64 bits = (U64(readBigEndian(in)) << 32) | readBigEndian(in + 4);
+	I32 base = bits >> 56;
+	I32 mult = (bits >> 52) & 15;
+	U table = (bits >> 48) & 15;
+
+	for(U i = 0; i < 16; i++)
+	{
+		U x = i % 4, y = i / 4;
+		U s = (bits >> (45 - (x * 4 + y) * 3)) & 7;
+		out[i * 4 + 3] = std::min(
+			std::max(base + MODIFIERS[table][s] * mult, 0), 255);
+	}
+}
+
+//==============================================================================
+/// A smooth image with some hard edges and an alpha ramp
+static std::vector<U8> createImage(U width, U height)
+{
+	std::vector<U8> texels(width * height * 4);
+	for(U y = 0; y < height; y++)
+	{
+		for(U x = 0; x < width; x++)
+		{
+			U8* t = &texels[(y * width + x) * 4];
+			t[0] = x * 255 / (width - 1);
+			t[1] = y * 255 / (height - 1);
+			t[2] = ((x / 8 + y / 8) % 2) ? 200 : 40;
+			t[3] = 128 + 127 * std::sin(F32(x + y) * 0.1);
+		}
+	}
+
+	return texels;
+}
+
+//==============================================================================
+/// Compress and decompress all the blocks and return the PSNR of some
+/// components
+static F64 roundTrip(const std::vector<U8>& texels, U width, U height,
+	void (*compress)(const U8*, U8*), void (*decode)(const U8*, U8*),
+	U firstComponent, U lastComponent)
+{
+	F64 error = 0.0;
+	for(U by = 0; by < height / 4; by++)
+	{
+		for(U bx = 0; bx < width / 4; bx++)
+		{
+			Array<U8, 64> block, decoded;
+			for(U y = 0; y < 4; y++)
+			{
+				memcpy(&block[y * 16],
+					&texels[((by * 4 + y) * width + bx * 4) * 4], 16);
+			}
+
+			Array<U8, 16> compressed;
+			compress(&block[0], &compressed[0]);
+			decode(&compressed[0], &decoded[0]);
+
+			for(U i = 0; i < 16; i++)
+			{
+				for(U c = firstComponent; c <= lastComponent; c++)
+				{
+					F64 d = F64(block[i * 4 + c]) - decoded[i * 4 + c];
+					error += d * d;
+				}
+			}
+		}
+	}
+
+	F64 mse = error
+		/ F64(width * height * (lastComponent - firstComponent + 1));
+	return 10.0 * std::log10(255.0 * 255.0 / std::max(mse, 1.0e-6));
+}
+
+static void decodeBc3(const U8* in, U8* out)
+{
+	decodeBc3Alpha(in, out);
+	decodeBc1Colors(in + 8, out);
+}
+
+static void decodeEtc2Eac(const U8* in, U8* out)
+{
+	decodeEacAlpha(in, out);
+	decodeEtcColors(in + 8, out);
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Resource, TextureCompression)
+{
+	const U SIZE = 64;
+	std::vector<U8> texels = createImage(SIZE, SIZE);
+
+	F64 bc1 = roundTrip(
+		texels, SIZE, SIZE, compressBc1Block, decodeBc1Colors, 0, 2);
+	F64 bc3Alpha = roundTrip(
+		texels, SIZE, SIZE, compressBc3Block, decodeBc3, 3, 3);
+	F64 bc3 = roundTrip(texels, SIZE, SIZE, compressBc3Block, decodeBc3, 0, 2);
+	F64 etc = roundTrip(
+		texels, SIZE, SIZE, compressEtc2Block, decodeEtcColors, 0, 2);
+	F64 eacAlpha = roundTrip(
+		texels, SIZE, SIZE, compressEtc2EacBlock, decodeEtc2Eac, 3, 3);
+	F64 eac = roundTrip(
+		texels, SIZE, SIZE, compressEtc2EacBlock, decodeEtc2Eac, 0, 2);
+
+	std::cout << "PSNR: BC1 " << bc1 << "dB, BC3 " << bc3 << "/" << bc3Alpha
+		<< "dB, ETC2 " << etc << "dB, ETC2 EAC " << eac << "/" << eacAlpha
+		<< "dB" << std::endl;
+
+	ANKI_TEST_EXPECT_EQ(bc1 >= 35.0, true);
+	ANKI_TEST_EXPECT_EQ(bc3 >= 35.0, true);
+	ANKI_TEST_EXPECT_EQ(bc3Alpha >= 40.0, true);
+	ANKI_TEST_EXPECT_EQ(etc >= 33.0, true);
+	ANKI_TEST_EXPECT_EQ(eac >= 33.0, true);
+	ANKI_TEST_EXPECT_EQ(eacAlpha >= 40.0, true);
+
+	// Flat blocks should be exact or close to
+	Array<U8, 64> flat, decoded;
+	for(U i = 0; i < 16; i++)
+	{
+		flat[i * 4 + 0] = 255;
+		flat[i * 4 + 1] = 0;
+		flat[i * 4 + 2] = 255;
+		flat[i * 4 + 3] = 77;
+	}
+
+	Array<U8, 16> compressed;
+	compressBc3Block(&flat[0], &compressed[0]);
+	decodeBc3(&compressed[0], &decoded[0]);
+	ANKI_TEST_EXPECT_EQ(decoded[0], 255);
+	ANKI_TEST_EXPECT_EQ(decoded[1], 0);
+	ANKI_TEST_EXPECT_EQ(decoded[2], 255);
+	ANKI_TEST_EXPECT_EQ(decoded[3], 77);
+
+	compressEtc2EacBlock(&flat[0], &compressed[0]);
+	decodeEtc2Eac(&compressed[0], &decoded[0]);
+	ANKI_TEST_EXPECT_EQ(decoded[3], 77);
+}
+
+//==============================================================================
+ANKI_TEST(Resource, TextureCooker)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Threadpool threadpool(4);
+
+	// Half black and half white. The mip should be the linear average
+	const U WIDTH = 16, HEIGHT = 8;
+	std::vector<U8> texels(WIDTH * HEIGHT * 3);
+	for(U i = 0; i < WIDTH * HEIGHT; i++)
+	{
+		U8 c = (i % 2) ? 255 : 0;
+		texels[i * 3 + 0] = texels[i * 3 + 1] = texels[i * 3 + 2] = c;
+	}
+
+	TextureCooker cooker(alloc, threadpool);
+	cooker.addLayer(&texels[0], WIDTH, HEIGHT, Image::ColorFormat::RGB8);
+	cooker.addLayer(&texels[0], WIDTH, HEIGHT, Image::ColorFormat::RGB8);
+
+	try
+	{
+		cooker.addLayer(&texels[0], WIDTH / 2, HEIGHT,
+			Image::ColorFormat::RGB8);
+		ANKI_TEST_EXPECT_EQ(0, 1);
+	}
+	catch(const Exception&)
+	{}
+
+	cooker.cook(Image::TextureType::_2D_ARRAY, false, true);
+	ANKI_TEST_EXPECT_EQ(cooker.getMipLevelsCount(), 2);
+	ANKI_TEST_EXPECT_EQ(cooker.getColorFormat(), Image::ColorFormat::RGB8);
+
+	const ResourceVector<U8>& mip =
+		cooker.getSurfaceData(Image::DataCompression::RAW, 1, 1);
+	ANKI_TEST_EXPECT_EQ(mip.size(), (WIDTH / 2) * (HEIGHT / 2) * 3);
+	for(U8 c : mip)
+	{
+		ANKI_TEST_EXPECT_EQ(c >= 186 && c <= 189, true);
+	}
+
+	ANKI_TEST_EXPECT_EQ(
+		cooker.getSurfaceData(Image::DataCompression::S3TC, 0, 0).size(),
+		(WIDTH / 4) * (HEIGHT / 4) * 8);
+	ANKI_TEST_EXPECT_EQ(
+		cooker.getSurfaceData(Image::DataCompression::ETC, 1, 1).size(),
+		(WIDTH / 8) * (HEIGHT / 8) * 8);
+}
+
+//==============================================================================
+ANKI_TEST(Resource, TextureCookerBenchmark)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Threadpool threadpool(getCpuCoresCount());
+
+	const U SIZE = 1024;
+	std::vector<U8> texels = createImage(SIZE, SIZE);
+
+	HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+	TextureCooker cooker(alloc, threadpool);
+	cooker.addLayer(&texels[0], SIZE, SIZE, Image::ColorFormat::RGBA8);
+	cooker.cook(Image::TextureType::_2D, false, true);
+
+	std::cout << "Cooked a " << SIZE << "x" << SIZE << " RGBA texture with "
+		<< threadpool.getThreadsCount() << " threads in "
+		<< ((HighRezTimer::getCurrentTime() - begin) * 1000.0) << "ms"
+		<< std::endl;
+}
@@ -0,0 +1,211 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/TextureResidency.h"
+#include "anki/resource/AsyncLoader.h"
+
+using namespace anki;
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// The mip sizes of the textures of the tests. Every mip has 4 times the
+/// bytes of the next
+static const PtrSize MIP_SIZES[] = {64, 16, 4, 1};
+
+using Action = TextureResidencyManager::Action;
+
+//==============================================================================
+static void checkAction(const Action& action,
+	TextureResidencyManager::Handle texture, U mip, Bool load)
+{
+	ANKI_TEST_EXPECT_EQ(action.m_texture, texture);
+	ANKI_TEST_EXPECT_EQ(action.m_mip, mip);
+	ANKI_TEST_EXPECT_EQ(action.m_load, load);
+}
+
+//==============================================================================
+/// Append its number to a vector
+class AppendTask: public AsyncLoaderTask
+{
+public:
+	ResourceVector<U>* m_out;
+	U m_n;
+
+	AppendTask(ResourceVector<U>* out, U n)
+	:	m_out(out),
+		m_n(n)
+	{}
+
+	void operator()()
+	{
+		m_out->push_back(m_n);
+	}
+};
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Resource, TextureResidency)
+{
+	ResourceAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	// Budget and eviction
+	{
+		TextureResidencyManager mngr(alloc, 100, 1024);
+		ResourceVector<Action> actions(alloc);
+
+		auto a = mngr.registerTexture(8, 8, MIP_SIZES, 4, 2, nullptr);
+		auto b = mngr.registerTexture(8, 8, MIP_SIZES, 4, 2, nullptr);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 10);
+
+		// A loads. B doesn't fit and it can't evict the pending A
+		mngr.requestMip(a, 0, 10.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 1);
+		checkAction(actions[0], a, 0, true);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 90);
+		ANKI_TEST_EXPECT_EQ(mngr.isPending(a), true);
+		mngr.actionDone(a);
+
+		// B was requested later so it evicts A
+		actions.clear();
+		mngr.requestMip(b, 0, 10.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 2);
+		checkAction(actions[0], b, 0, true);
+		checkAction(actions[1], a, 2, false);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 90);
+		mngr.actionDone(a);
+		mngr.actionDone(b);
+
+		// B now wants less. Its excess mips go first even if it's more
+		// important than C. A still wants its mip 0 from before but only
+		// the mip 1 fits
+		auto c = mngr.registerTexture(8, 8, MIP_SIZES, 4, 2, nullptr);
+		actions.clear();
+		mngr.requestMip(b, 2, 10.0);
+		mngr.requestMip(c, 1, 1.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 3);
+		checkAction(actions[0], c, 1, true);
+		checkAction(actions[1], a, 1, true);
+		checkAction(actions[2], b, 1, false);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 63);
+		mngr.actionDone(a);
+		mngr.actionDone(b);
+		mngr.actionDone(c);
+
+		// The most important evicts the less important
+		actions.clear();
+		mngr.requestMip(a, 0, 10.0);
+		mngr.requestMip(b, 1, 1.0);
+		mngr.requestMip(c, 1, 1.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 3);
+		checkAction(actions[0], a, 0, true);
+		checkAction(actions[1], b, 2, false);
+		checkAction(actions[2], c, 2, false);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 95);
+
+		mngr.actionDone(a);
+		mngr.actionDone(b);
+		mngr.actionDone(c);
+		mngr.unregisterTexture(a);
+		mngr.unregisterTexture(b);
+		mngr.unregisterTexture(c);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 0);
+	}
+
+	// Load limit and failures
+	{
+		TextureResidencyManager mngr(alloc, 1024, 20);
+		ResourceVector<Action> actions(alloc);
+
+		auto a = mngr.registerTexture(8, 8, MIP_SIZES, 4, 2, nullptr);
+		auto b = mngr.registerTexture(8, 8, MIP_SIZES, 4, 2, nullptr);
+
+		// Only the mip 1 of A fits the limit. B waits
+		mngr.requestMip(a, 0, 10.0);
+		mngr.requestMip(b, 0, 1.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 1);
+		checkAction(actions[0], a, 1, true);
+		mngr.actionDone(a);
+
+		// The mip 0 is bigger than the limit but a mip loads anyway
+		actions.clear();
+		mngr.requestMip(a, 0, 10.0);
+		mngr.requestMip(b, 0, 1.0);
+		mngr.update(actions);
+		ANKI_TEST_EXPECT_EQ(actions.size(), 1);
+		checkAction(actions[0], a, 0, true);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 85 + 5);
+
+		// It failed so it goes back
+		mngr.actionDone(a, false);
+		ANKI_TEST_EXPECT_EQ(mngr.isPending(a), false);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentMip(a), 1);
+		ANKI_TEST_EXPECT_EQ(mngr.getResidentBytes(), 21 + 5);
+
+		mngr.unregisterTexture(a);
+		mngr.unregisterTexture(b);
+	}
+
+	// The mip of the screen size
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 9, 256.0), 0);
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 9, 129.0), 0);
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 9, 128.0), 1);
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 9, 1.0), 8);
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 4, 1.0), 3);
+	ANKI_TEST_EXPECT_EQ(
+		TextureResidencyManager::computeMip(256, 128, 9, 0.0), 8);
+}
+
+//==============================================================================
+ANKI_TEST(Resource, AsyncLoader)
+{
+	ResourceAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	ResourceVector<U> out(alloc);
+	const U COUNT = 100;
+
+	// Wait with flush
+	{
+		AsyncLoader loader(alloc);
+
+		for(U i = 0; i < COUNT; i++)
+		{
+			loader.newTask<AppendTask>(&out, i);
+		}
+
+		loader.flush();
+		ANKI_TEST_EXPECT_EQ(out.size(), COUNT);
+	}
+
+	// The destructor runs the rest
+	{
+		AsyncLoader loader(alloc);
+
+		for(U i = COUNT; i < COUNT * 2; i++)
+		{
+			loader.newTask<AppendTask>(&out, i);
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(out.size(), COUNT * 2);
+	for(U i = 0; i < COUNT * 2; i++)
+	{
+		ANKI_TEST_EXPECT_EQ(out[i], i);
+	}
+}
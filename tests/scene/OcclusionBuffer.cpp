@@ -0,0 +1,80 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/scene/OcclusionBuffer.h"
+#include "anki/collision/Frustum.h"
+
+using namespace anki;
+
+//==============================================================================
+ANKI_TEST(Scene, OcclusionBuffer)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	OcclusionBuffer buffer(alloc);
+
+	// The camera is in the origin and looks to -Z
+	PerspectiveFrustum frustum(toRad(60.0), toRad(45.0), 0.1, 1000.0);
+	buffer.clear(frustum.calculateProjectionMatrix());
+
+	// A wall on the left half and a floor that goes behind the camera
+	const Vec3 positions[] = {
+		Vec3(-20.0, -20.0, -10.0), Vec3(0.0, -20.0, -10.0),
+		Vec3(0.0, 20.0, -10.0), Vec3(-20.0, 20.0, -10.0),
+		Vec3(-20.0, -1.0, 10.0), Vec3(20.0, -1.0, 10.0),
+		Vec3(20.0, -1.0, -100.0), Vec3(-20.0, -1.0, -100.0)};
+	const U16 indices[] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7};
+
+	buffer.addOccluder(0, frustum.calculateProjectionMatrix(), positions,
+		indices, 6);
+	buffer.addOccluder(1, frustum.calculateProjectionMatrix(), positions,
+		indices + 6, 6);
+
+	// Two threads
+	buffer.rasterize(0, OcclusionBuffer::HEIGHT / 2);
+	buffer.rasterize(OcclusionBuffer::HEIGHT / 2,
+		OcclusionBuffer::HEIGHT - OcclusionBuffer::HEIGHT / 2);
+	buffer.buildHiZ();
+
+	// The clipped floor is under the camera
+	ANKI_TEST_EXPECT_EQ(
+		buffer.getDepth(OcclusionBuffer::WIDTH * 3 / 4, 0) < 1.0, true);
+	ANKI_TEST_EXPECT_EQ(buffer.getDepth(OcclusionBuffer::WIDTH * 3 / 4,
+		OcclusionBuffer::HEIGHT - 1), 1.0);
+
+	// Behind the wall
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-6.0, -1.0, -20.0, 0.0), Vec4(-4.0, 1.0, -18.0, 0.0))), true);
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-90.0, 0.0, -200.0, 0.0), Vec4(-30.0, 1.0, -150.0, 0.0))),
+		true);
+
+	// On the right
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(4.0, -1.0, -20.0, 0.0), Vec4(6.0, 1.0, -18.0, 0.0))), false);
+
+	// In front of the wall
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-6.0, -1.0, -6.0, 0.0), Vec4(-4.0, 1.0, -4.0, 0.0))), false);
+
+	// Partly behind the wall
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-2.0, -1.0, -20.0, 0.0), Vec4(2.0, 1.0, -18.0, 0.0))), false);
+
+	// It crosses the near plane
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-6.0, -1.0, -20.0, 0.0), Vec4(-4.0, 1.0, 1.0, 0.0))), false);
+
+	// Under the floor
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(4.0, -5.0, -20.0, 0.0), Vec4(6.0, -3.0, -18.0, 0.0))), true);
+
+	// Clear
+	buffer.clear(frustum.calculateProjectionMatrix());
+	buffer.rasterize(0, OcclusionBuffer::HEIGHT);
+	buffer.buildHiZ();
+	ANKI_TEST_EXPECT_EQ(buffer.isOccluded(Aabb(
+		Vec4(-6.0, -1.0, -20.0, 0.0), Vec4(-4.0, 1.0, -18.0, 0.0))), false);
+}
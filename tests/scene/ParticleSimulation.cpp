@@ -0,0 +1,185 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/scene/ParticleSimulation.h"
+#include "anki/util/HighRezTimer.h"
+
+namespace anki {
+
+//==============================================================================
+ANKI_TEST(Scene, ParticleSimulation)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	ParticleEmitterProperties props;
+	props.m_maxNumOfParticles = 10;
+	props.m_particle.m_life = 1.0;
+	props.m_particle.m_gravity = Vec3(0.0, -10.0, 0.0);
+	props.m_particle.m_sizeAnimation = 0.0;
+
+	ParticleSimulation sim(props, alloc);
+
+	// Two groups that die at different times
+	sim.emit(0.0, Vec4(1.0, 2.0, 3.0, 0.0), 6);
+	ANKI_TEST_EXPECT_EQ(sim.getAliveParticlesCount(), 6);
+	sim.emit(0.5, Vec4(0.0), 6);
+	ANKI_TEST_EXPECT_EQ(sim.getAliveParticlesCount(), 10);
+
+	sim.simulate(0.5, 0.75, nullptr);
+	ANKI_TEST_EXPECT_EQ(sim.getVerticesCount(), 10);
+
+	// The first group falls from its origin
+	const F32 fall = -10.0 * 0.25 * 0.25;
+	ANKI_TEST_EXPECT_NEAR(sim.getAabbMax().y(), 2.0 + fall, 0.0001);
+	ANKI_TEST_EXPECT_NEAR(sim.getAabbMin().y(), fall, 0.0001);
+	ANKI_TEST_EXPECT_NEAR(sim.getAabbMax().z(), 3.0, 0.0001);
+
+	const F32* verts = sim.getVertices();
+	for(U i = 0; i < sim.getVerticesCount(); i++)
+	{
+		const F32* vert = verts + i * ParticleSimulation::VERTEX_COMPONENTS;
+		ANKI_TEST_EXPECT_EQ(vert[1] == fall || vert[1] == 2.0 + fall, true);
+		ANKI_TEST_EXPECT_EQ(vert[3], 1.0);
+		ANKI_TEST_EXPECT_EQ(vert[4], 1.0);
+	}
+
+	// The first group dies and the rest are packed
+	sim.simulate(0.75, 1.25, nullptr);
+	ANKI_TEST_EXPECT_EQ(sim.getAliveParticlesCount(), 4);
+	ANKI_TEST_EXPECT_EQ(sim.getVerticesCount(), 4);
+	ANKI_TEST_EXPECT_NEAR(sim.getAabbMax().z(), 0.0, 0.0001);
+
+	sim.simulate(1.25, 1.75, nullptr);
+	ANKI_TEST_EXPECT_EQ(sim.getVerticesCount(), 0);
+}
+
+//==============================================================================
+ANKI_TEST(Scene, ParticleSimulationBenchmark)
+{
+	const U PARTICLES = 1000000;
+	const U FRAMES = 20;
+
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	ParticleEmitterProperties props;
+	props.m_maxNumOfParticles = PARTICLES;
+	props.m_particle.m_life = 10.0;
+	props.m_particle.m_lifeDeviation = 5.0;
+	props.m_particle.m_alphaAnimation = true;
+	props.m_particle.m_gravity = Vec3(0.0, -9.8, 0.0);
+	props.m_particle.m_gravityDeviation = Vec3(1.0);
+	props.m_particle.m_startingPosDeviation = Vec3(10.0);
+
+	benchmarkThreads(std::to_string(PARTICLES) + " particles", 
+		[&](Threadpool& threadpool) -> HighRezTimer::Scalar
+	{
+		ParticleSimulation sim(props, alloc);
+
+		// Half of them die in the frames and they are emitted again
+		sim.emit(0.0, Vec4(0.0), PARTICLES);
+
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRAMES; f++)
+		{
+			F32 prevTime = 5.0 + F32(f) * 0.25;
+			F32 crntTime = prevTime + 0.25;
+
+			sim.simulate(prevTime, crntTime, &threadpool);
+			sim.emit(crntTime, Vec4(0.0), PARTICLES);
+		}
+		HighRezTimer::Scalar time = 
+			(HighRezTimer::getCurrentTime() - begin) / FRAMES;
+
+		ANKI_TEST_EXPECT_EQ(sim.getAliveParticlesCount(), PARTICLES);
+
+		return time;
+	});
+}
+
+//==============================================================================
+ANKI_TEST(Scene, ParticleSort)
+{
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+	Threadpool threadpool(4);
+
+	ParticleEmitterProperties props;
+	props.m_maxNumOfParticles = 20000;
+	props.m_particle.m_startingPosDeviation = Vec3(100.0);
+
+	// Small sorts run in this thread and big ones in the threadpool
+	Array<U32, 2> counts = {{100, 20000}};
+	for(U32 count : counts)
+	{
+		ParticleSimulation sim(props, alloc);
+		sim.emit(0.0, Vec4(0.0), count);
+		sim.simulate(0.0, 0.1, nullptr);
+
+		// A camera at (0, 0, 10) that looks at -z, so the view depth is 10 - z
+		Mat4 viewMat = Mat4::getIdentity();
+		viewMat(2, 3) = -10.0;
+
+		// Twice. The second sorts the sorted
+		for(U k = 0; k < 2; k++)
+		{
+			sim.sortByDepth(viewMat, &threadpool);
+			ANKI_TEST_EXPECT_EQ(sim.getVerticesCount(), count);
+
+			const F32* verts = sim.getVertices();
+			for(U i = 1; i < count; i++)
+			{
+				const F32* prev =
+					verts + (i - 1) * ParticleSimulation::VERTEX_COMPONENTS;
+				const F32* vert =
+					verts + i * ParticleSimulation::VERTEX_COMPONENTS;
+
+				// Back to front
+				ANKI_TEST_EXPECT_EQ(prev[2] <= vert[2], true);
+			}
+		}
+	}
+}
+
+//==============================================================================
+ANKI_TEST(Scene, ParticleSortBenchmark)
+{
+	const U PARTICLES = 100000;
+	const U FRAMES = 20;
+
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	ParticleEmitterProperties props;
+	props.m_maxNumOfParticles = PARTICLES;
+	props.m_particle.m_life = 100.0;
+	props.m_particle.m_gravity = Vec3(0.0, -9.8, 0.0);
+	props.m_particle.m_gravityDeviation = Vec3(5.0);
+	props.m_particle.m_startingPosDeviation = Vec3(50.0);
+
+	benchmarkThreads(std::to_string(PARTICLES) + " sorted particles", 
+		[&](Threadpool& threadpool) -> HighRezTimer::Scalar
+	{
+		ParticleSimulation sim(props, alloc);
+		sim.emit(0.0, Vec4(0.0), PARTICLES);
+
+		HighRezTimer::Scalar sortTime = 0.0;
+		for(U f = 0; f < FRAMES; f++)
+		{
+			sim.simulate(F32(f) * 0.1, F32(f + 1) * 0.1, &threadpool);
+
+			// A camera that turns around the particles
+			Transform trf(Vec4(0.0, 0.0, 100.0, 0.0),
+				Mat3x4(Quat(Axisang(F32(f) * 0.3, Vec3(0.0, 1.0, 0.0)))), 1.0);
+			Mat4 viewMat = Mat4(trf.getInverse());
+
+			HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+			sim.sortByDepth(viewMat, &threadpool);
+			sortTime += HighRezTimer::getCurrentTime() - begin;
+		}
+
+		return sortTime / FRAMES;
+	});
+}
+
+} // end namespace anki
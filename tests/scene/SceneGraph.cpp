@@ -0,0 +1,121 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/scene/InstanceNode.h"
+#include "anki/scene/Visibility.h"
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// A node that adds and removes instance components
+class ComponentsNode: public SceneNode
+{
+public:
+	ComponentsNode(const char* name, SceneGraph* scene)
+	:	SceneNode(name, scene)
+	{}
+
+	InstanceComponent* add()
+	{
+		InstanceComponent* comp = getSceneAllocator().
+			newInstance<InstanceComponent>(this);
+		addComponent(comp);
+		return comp;
+	}
+
+	void remove(InstanceComponent* comp)
+	{
+		removeComponent(comp);
+		getSceneAllocator().deleteInstance(comp);
+	}
+};
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Scene, ComponentRegistry)
+{
+	Threadpool threadpool(1);
+	SceneGraph scene(allocAligned, nullptr, &threadpool);
+	const auto INSTANCE = SceneComponent::INSTANCE_COMPONENT;
+	const auto MOVE = SceneComponent::MOVE_COMPONENT;
+
+	InstanceNode* inode = scene.newSceneNode<InstanceNode>("instance");
+	ComponentsNode* cnode = scene.newSceneNode<ComponentsNode>("components");
+
+	ANKI_TEST_EXPECT_EQ(scene.getComponentsCount(INSTANCE), 1);
+	ANKI_TEST_EXPECT_EQ(scene.getComponentsCount(MOVE), 1);
+	ANKI_TEST_EXPECT_EQ(inode->hasComponent<MoveComponent>(), true);
+	ANKI_TEST_EXPECT_EQ(cnode->hasComponent<MoveComponent>(), false);
+	ANKI_TEST_EXPECT_EQ(cnode->tryGetComponent<MoveComponent>(), nullptr);
+	ANKI_TEST_EXPECT_EQ(&inode->getComponent<MoveComponent>(),
+		static_cast<MoveComponent*>(inode));
+
+	// The first of the type is found
+	InstanceComponent* a = cnode->add();
+	InstanceComponent* b = cnode->add();
+	ANKI_TEST_EXPECT_EQ(scene.getComponentsCount(INSTANCE), 3);
+	ANKI_TEST_EXPECT_EQ(cnode->tryGetComponent<InstanceComponent>(), a);
+
+	// The next takes its place
+	cnode->remove(a);
+	ANKI_TEST_EXPECT_EQ(scene.getComponentsCount(INSTANCE), 2);
+	ANKI_TEST_EXPECT_EQ(cnode->tryGetComponent<InstanceComponent>(), b);
+
+	U count = 0;
+	scene.iterateComponentsOfType<InstanceComponent>(
+		[&](InstanceComponent& comp)
+	{
+		ANKI_TEST_EXPECT_EQ(&comp == b
+			|| &comp == static_cast<InstanceComponent*>(inode), true);
+		++count;
+	});
+	ANKI_TEST_EXPECT_EQ(count, 2);
+
+	cnode->remove(b);
+	ANKI_TEST_EXPECT_EQ(scene.getComponentsCount(INSTANCE), 1);
+	ANKI_TEST_EXPECT_EQ(cnode->hasComponent<InstanceComponent>(), false);
+	ANKI_TEST_EXPECT_EQ(cnode->tryGetComponent<InstanceComponent>(), nullptr);
+}
+
+//==============================================================================
+ANKI_TEST(Scene, LodSelection)
+{
+	// The errors on the screen are the errors times the pixels per unit
+	const F32 errors[] = {0.0, 0.01, 0.04};
+	const F32 MAX_ERROR = 1.0;
+	const F32 HYSTERESIS = 0.2;
+
+	// Close. The fraction is how close the LOD 1 is
+	ANKI_TEST_EXPECT_NEAR(
+		selectLod(errors, 3, 200.0, MAX_ERROR, HYSTERESIS, 0), 0.4, 0.001);
+
+	// Far
+	ANKI_TEST_EXPECT_NEAR(
+		selectLod(errors, 3, 50.0, MAX_ERROR, HYSTERESIS, 0), 1.4, 0.001);
+	ANKI_TEST_EXPECT_NEAR(
+		selectLod(errors, 3, 10.0, MAX_ERROR, HYSTERESIS, 0), 2.0, 0.001);
+
+	// Between the thresholds the previous LOD stays
+	ANKI_TEST_EXPECT_EQ(
+		U(selectLod(errors, 3, 110.0, MAX_ERROR, HYSTERESIS, 0)), 0);
+	ANKI_TEST_EXPECT_EQ(
+		U(selectLod(errors, 3, 110.0, MAX_ERROR, HYSTERESIS, 1)), 1);
+	ANKI_TEST_EXPECT_EQ(
+		U(selectLod(errors, 3, 130.0, MAX_ERROR, HYSTERESIS, 1)), 0);
+
+	// One LOD
+	ANKI_TEST_EXPECT_EQ(
+		selectLod(errors, 1, 10.0, MAX_ERROR, HYSTERESIS, 0), 0.0);
+}
+
+} // end namespace anki
@@ -0,0 +1,325 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/scene/Sector.h"
+#include "anki/util/HighRezTimer.h"
+#include <iostream>
+
+namespace anki {
+
+//==============================================================================
+// Misc                                                                        =
+//==============================================================================
+
+/// A node with a box
+class BoxNode: public SceneNode, public SpatialComponent
+{
+public:
+	Aabb m_box;
+
+	BoxNode(const char* name, SceneGraph* scene, const Aabb& box)
+	:	SceneNode(name, scene),
+		SpatialComponent(this),
+		m_box(box)
+	{
+		addComponent(static_cast<SpatialComponent*>(this));
+
+		// Compute the AABB like the scene update does
+		update(*this, 0.0, 0.0, SceneComponent::ASYNC_UPDATE);
+	}
+
+	const CollisionShape& getSpatialCollisionShape() override
+	{
+		return m_box;
+	}
+
+	Vec4 getSpatialOrigin() override
+	{
+		return (m_box.getMin() + m_box.getMax()) / 2.0;
+	}
+};
+
+//==============================================================================
+/// A frustum at a point that looks to -Z
+static Mat4 setupFrustum(PerspectiveFrustum& frustum, const Vec4& origin)
+{
+	Transform trf(origin, Mat3x4::getIdentity(), 1.0);
+	frustum.resetTransform(trf);
+	return frustum.calculateProjectionMatrix() * Mat4(trf.getInverse());
+}
+
+//==============================================================================
+static const PortalVisibleNode* findNode(
+	const SceneFrameVector<PortalVisibleNode>& nodes, SceneNode* node)
+{
+	for(const PortalVisibleNode& pnode : nodes)
+	{
+		if(pnode.m_node == node)
+		{
+			return &pnode;
+		}
+	}
+
+	return nullptr;
+}
+
+//==============================================================================
+/// A door in a wall that is normal to X or Z
+static Obb createDoor(const Vec4& center, Bool normalToX)
+{
+	Vec4 extend = normalToX
+		? Vec4(0.1, 1.5, 1.0, 0.0) : Vec4(1.0, 1.5, 0.1, 0.0);
+	return Obb(center, Mat3x4::getIdentity(), extend);
+}
+
+//==============================================================================
+static Aabb createBox(const Vec4& center, F32 size)
+{
+	return Aabb(center - Vec4(size, size, size, 0.0),
+		center + Vec4(size, size, size, 0.0));
+}
+
+//==============================================================================
+// Tests                                                                       =
+//==============================================================================
+
+//==============================================================================
+ANKI_TEST(Scene, Sector)
+{
+	Threadpool threadpool(1);
+	SceneGraph scene(allocAligned, nullptr, &threadpool);
+	SectorGroup& group = scene.getSectorGroup();
+	SceneFrameAllocator<U8> alloc(
+		StackMemoryPool(allocAligned, nullptr, 1024 * 1024));
+
+	// A row of rooms to -Z with small doors in the middle and a room on the
+	// side of the first
+	Array<Sector*, 4> rooms;
+	for(U i = 0; i < rooms.getSize(); i++)
+	{
+		F32 z = -10.0 * F32(i);
+		rooms[i] = group.createNewSector(Aabb(Vec4(-5.0, -5.0, z - 10.0, 0.0),
+			Vec4(5.0, 5.0, z, 0.0)));
+	}
+	Sector* side = group.createNewSector(
+		Aabb(Vec4(5.0, -5.0, -10.0, 0.0), Vec4(15.0, 5.0, 0.0, 0.0)));
+
+	Array<Portal*, 3> doors;
+	for(U i = 0; i < doors.getSize(); i++)
+	{
+		doors[i] = group.createNewPortal(rooms[i], rooms[i + 1],
+			createDoor(Vec4(0.0, 0.0, -10.0 * F32(i + 1), 0.0), false));
+	}
+	group.createNewPortal(rooms[0], side,
+		createDoor(Vec4(5.0, 0.0, -5.0, 0.0), true));
+
+	// In front of the doors, on the side of the doors, between two rooms,
+	// in the side room, behind the closed door and outside
+	BoxNode* front = scene.newSceneNode<BoxNode>("front",
+		createBox(Vec4(0.0, 0.0, -25.0, 0.0), 0.5));
+	BoxNode* aside = scene.newSceneNode<BoxNode>("aside",
+		createBox(Vec4(4.0, 0.0, -25.0, 0.0), 0.5));
+	BoxNode* between = scene.newSceneNode<BoxNode>("between",
+		createBox(Vec4(0.0, 0.0, -20.0, 0.0), 2.0));
+	BoxNode* sided = scene.newSceneNode<BoxNode>("sided",
+		createBox(Vec4(10.0, 0.0, -5.0, 0.0), 0.5));
+	BoxNode* closed = scene.newSceneNode<BoxNode>("closed",
+		createBox(Vec4(0.0, 0.0, -35.0, 0.0), 0.5));
+	BoxNode* outside = scene.newSceneNode<BoxNode>("outside",
+		createBox(Vec4(100.0, 0.0, 0.0, 0.0), 0.5));
+
+	group.update();
+	ANKI_TEST_EXPECT_EQ(between->getSectors().size(), 2);
+	ANKI_TEST_EXPECT_EQ(group.getOutsideSpatials().size(), 1);
+	doors[2]->open = false;
+
+	PerspectiveFrustum frustum(toRad(60.0), toRad(45.0), 0.1, 1000.0);
+	Mat4 viewProjMat = setupFrustum(frustum, Vec4(0.0, 0.0, -1.0, 0.0));
+
+	SceneFrameVector<PortalVisibleNode> nodes(alloc);
+	ANKI_TEST_EXPECT_EQ(group.findVisibleNodes(
+		frustum, viewProjMat, VB_CAMERA, nodes), true);
+	ANKI_TEST_EXPECT_EQ(nodes.size(), 4);
+	ANKI_TEST_EXPECT_EQ(rooms[2]->getVisibleByMask(), VB_CAMERA);
+	ANKI_TEST_EXPECT_EQ(rooms[3]->getVisibleByMask(), VB_NONE);
+	ANKI_TEST_EXPECT_EQ(side->getVisibleByMask(), VB_NONE);
+
+	// The doors show the front only
+	const PortalVisibleNode* pnode = findNode(nodes, front);
+	ANKI_TEST_EXPECT_NEQ(pnode, nullptr);
+	ANKI_TEST_EXPECT_EQ(
+		insidePortalRect(front->m_box, viewProjMat, pnode->m_rect), true);
+	pnode = findNode(nodes, aside);
+	ANKI_TEST_EXPECT_NEQ(pnode, nullptr);
+	ANKI_TEST_EXPECT_EQ(frustum.insideFrustum(aside->m_box), true);
+	ANKI_TEST_EXPECT_EQ(
+		insidePortalRect(aside->m_box, viewProjMat, pnode->m_rect), false);
+
+	// Once with the rect of the first room
+	pnode = findNode(nodes, between);
+	ANKI_TEST_EXPECT_NEQ(pnode, nullptr);
+	ANKI_TEST_EXPECT_EQ(pnode->m_rect.z() - pnode->m_rect.x() > 0.3, true);
+
+	pnode = findNode(nodes, outside);
+	ANKI_TEST_EXPECT_NEQ(pnode, nullptr);
+	ANKI_TEST_EXPECT_EQ(pnode->m_rect, Vec4(-1.0, -1.0, 1.0, 1.0));
+
+	ANKI_TEST_EXPECT_EQ(findNode(nodes, sided), nullptr);
+	ANKI_TEST_EXPECT_EQ(findNode(nodes, closed), nullptr);
+
+	// Standing in the first door it doesn't shrink the second room
+	nodes.clear();
+	viewProjMat = setupFrustum(frustum, Vec4(0.0, 0.0, -10.0, 0.0));
+	group.findVisibleNodes(frustum, viewProjMat, VB_NONE, nodes);
+	pnode = findNode(nodes, between);
+	ANKI_TEST_EXPECT_NEQ(pnode, nullptr);
+	ANKI_TEST_EXPECT_EQ(pnode->m_rect, Vec4(-1.0, -1.0, 1.0, 1.0));
+
+	// Moved behind the camera
+	front->m_box = createBox(Vec4(0.0, 0.0, 100.0, 0.0), 0.5);
+	front->markForUpdate();
+	front->update(*front, 0.0, 0.0, SceneComponent::ASYNC_UPDATE);
+	group.update();
+	ANKI_TEST_EXPECT_EQ(group.getOutsideSpatials().size(), 2);
+	ANKI_TEST_EXPECT_EQ(rooms[2]->getSpatials().size(), 2);
+
+	// Outside all the sectors
+	nodes.clear();
+	viewProjMat = setupFrustum(frustum, Vec4(0.0, 0.0, 10.0, 0.0));
+	ANKI_TEST_EXPECT_EQ(group.findVisibleNodes(
+		frustum, viewProjMat, VB_NONE, nodes), false);
+}
+
+//==============================================================================
+ANKI_TEST(Scene, SectorBenchmark)
+{
+	const U ROOMS = 20; // On X and on Z
+	const U NODES_PER_ROOM = 10;
+	const F32 SIZE = 10.0;
+	const U ITERATIONS = 100;
+
+	Threadpool threadpool(1);
+	SceneGraph scene(allocAligned, nullptr, &threadpool);
+	SectorGroup& group = scene.getSectorGroup();
+	SceneFrameAllocator<U8> alloc(
+		StackMemoryPool(allocAligned, nullptr, 16 * 1024 * 1024));
+
+	// A grid of rooms with doors to their neighbours
+	for(U j = 0; j < ROOMS; j++)
+	{
+		for(U i = 0; i < ROOMS; i++)
+		{
+			Vec4 min(F32(i) * SIZE, 0.0, -F32(j + 1) * SIZE, 0.0);
+			group.createNewSector(
+				Aabb(min, min + Vec4(SIZE, 4.0, SIZE, 0.0)));
+		}
+	}
+
+	const auto& sectors = group.getSectors();
+	for(U j = 0; j < ROOMS; j++)
+	{
+		for(U i = 0; i < ROOMS; i++)
+		{
+			Sector* room = sectors[j * ROOMS + i];
+			Vec4 center = (room->getAabb().getMin()
+				+ room->getAabb().getMax()) / 2.0;
+
+			if(i + 1 < ROOMS)
+			{
+				group.createNewPortal(room, sectors[j * ROOMS + i + 1],
+					createDoor(center + Vec4(SIZE / 2.0, -0.5, 0.0, 0.0),
+					true));
+			}
+
+			if(j + 1 < ROOMS)
+			{
+				group.createNewPortal(room, sectors[(j + 1) * ROOMS + i],
+					createDoor(center + Vec4(0.0, -0.5, -SIZE / 2.0, 0.0),
+					false));
+			}
+		}
+	}
+
+	// Some boxes in every room
+	Vector<BoxNode*> boxes(scene.getHeapAllocator());
+	U seed = 1;
+	for(Sector* room : sectors)
+	{
+		for(U n = 0; n < NODES_PER_ROOM; n++)
+		{
+			Vec4 pos = room->getAabb().getMin();
+			for(U k = 0; k < 3; k += 2)
+			{
+				seed = seed * 1103515245 + 12345;
+				pos[k] += 1.0 + F32((seed >> 16) % 800) / 100.0;
+			}
+			pos.y() = 1.0;
+
+			boxes.push_back(scene.newSceneNode<BoxNode>(
+				"box", createBox(pos, 0.5)));
+		}
+	}
+
+	HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+	group.update();
+	HighRezTimer::Scalar placeTime = HighRezTimer::getCurrentTime() - begin;
+
+	// In the middle of the grid looking down the doors
+	PerspectiveFrustum frustum(toRad(60.0), toRad(45.0), 0.1, 1000.0);
+	Mat4 viewProjMat = setupFrustum(frustum,
+		Vec4(SIZE * (ROOMS / 2 + 0.5), 1.5, -SIZE * 2.5, 0.0));
+
+	// Every node with the frustum
+	U frustumCount = 0;
+	begin = HighRezTimer::getCurrentTime();
+	for(U it = 0; it < ITERATIONS; it++)
+	{
+		frustumCount = 0;
+		for(BoxNode* box : boxes)
+		{
+			frustumCount += frustum.insideFrustum(box->getAabb());
+		}
+	}
+	HighRezTimer::Scalar frustumTime =
+		(HighRezTimer::getCurrentTime() - begin) / ITERATIONS;
+
+	// The nodes of the portals with the frustum and their rect
+	U reachedCount = 0;
+	U visibleCount = 0;
+	begin = HighRezTimer::getCurrentTime();
+	for(U it = 0; it < ITERATIONS; it++)
+	{
+		alloc.getMemoryPool().reset();
+		SceneFrameVector<PortalVisibleNode> nodes(alloc);
+		group.findVisibleNodes(frustum, viewProjMat, VB_CAMERA, nodes);
+
+		reachedCount = nodes.size();
+		visibleCount = 0;
+		for(const PortalVisibleNode& pnode : nodes)
+		{
+			BoxNode& box = static_cast<BoxNode&>(*pnode.m_node);
+			visibleCount += frustum.insideFrustum(box.getAabb())
+				&& insidePortalRect(
+				box.getAabb(), viewProjMat, pnode.m_rect);
+		}
+	}
+	HighRezTimer::Scalar portalTime =
+		(HighRezTimer::getCurrentTime() - begin) / ITERATIONS;
+
+	ANKI_TEST_EXPECT_EQ(reachedCount < boxes.size() / 10, true);
+	ANKI_TEST_EXPECT_EQ(visibleCount <= reachedCount, true);
+	ANKI_TEST_EXPECT_EQ(visibleCount < frustumCount, true);
+
+	std::cout << "Sectors: " << sectors.size() << ", nodes: " << boxes.size()
+		<< ", placed in " << (placeTime * 1000.0) << "ms" << std::endl;
+	std::cout << "The frustum passes " << frustumCount << " nodes in "
+		<< (frustumTime * 1000000.0) << "us, the portals reach "
+		<< reachedCount << " and pass " << visibleCount << " in "
+		<< (portalTime * 1000000.0) << "us" << std::endl;
+}
+
+} // end namespace anki
@@ -0,0 +1,70 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/scene/StaticGeometryPack.h"
+
+using namespace anki;
+
+//==============================================================================
+ANKI_TEST(Scene, StaticGeometryPackPlan)
+{
+	typedef StaticGeometryPack::MeshInfo MeshInfo;
+	typedef StaticGeometryPack::MeshRange MeshRange;
+	typedef StaticGeometryPack::BufferInfo BufferInfo;
+
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	// Layout, vertex size, vertices, indices
+	Array<MeshInfo, 5> meshes = {{
+		{0, 32, 100, 300},
+		{1, 40, 10, 30},
+		{0, 32, 200, 600},
+		{0, 32, 300, 900}, // Doesn't fit the first buffer
+		{1, 40, 1000, 3000}}}; // Bigger than the max
+
+	const PtrSize maxSize = 400 * 32;
+
+	Vector<BufferInfo> buffers(alloc);
+	Array<MeshRange, 5> ranges;
+	StaticGeometryPack::plan(&meshes[0], meshes.getSize(), maxSize,
+		buffers, &ranges[0]);
+
+	ANKI_TEST_EXPECT_EQ(buffers.size(), 4);
+
+	// The meshes of the same layout go one after the other
+	ANKI_TEST_EXPECT_EQ(ranges[0].m_buffer, ranges[2].m_buffer);
+	ANKI_TEST_EXPECT_EQ(ranges[0].m_baseVertex, 0);
+	ANKI_TEST_EXPECT_EQ(ranges[0].m_firstIndex, 0);
+	ANKI_TEST_EXPECT_EQ(ranges[2].m_baseVertex, 100);
+	ANKI_TEST_EXPECT_EQ(ranges[2].m_firstIndex, 300);
+
+	// The other layout has its own
+	ANKI_TEST_EXPECT_EQ(ranges[1].m_buffer != ranges[0].m_buffer, true);
+	ANKI_TEST_EXPECT_EQ(ranges[1].m_baseVertex, 0);
+
+	// It starts a new buffer when it doesn't fit
+	ANKI_TEST_EXPECT_EQ(ranges[3].m_buffer != ranges[0].m_buffer, true);
+	ANKI_TEST_EXPECT_EQ(ranges[3].m_baseVertex, 0);
+	ANKI_TEST_EXPECT_EQ(ranges[3].m_firstIndex, 0);
+
+	// The big mesh gets a buffer of its own
+	ANKI_TEST_EXPECT_EQ(ranges[4].m_buffer != ranges[1].m_buffer, true);
+	ANKI_TEST_EXPECT_EQ(ranges[4].m_baseVertex, 0);
+
+	// The sizes
+	const BufferInfo& b = buffers[ranges[0].m_buffer];
+	ANKI_TEST_EXPECT_EQ(b.m_layout, 0);
+	ANKI_TEST_EXPECT_EQ(b.m_vertexSize, 32);
+	ANKI_TEST_EXPECT_EQ(b.m_verticesCount, 300);
+	ANKI_TEST_EXPECT_EQ(b.m_indicesCount, 900);
+
+	U32 vertices = 0;
+	for(const BufferInfo& buff : buffers)
+	{
+		vertices += buff.m_verticesCount;
+	}
+	ANKI_TEST_EXPECT_EQ(vertices, 1610);
+}
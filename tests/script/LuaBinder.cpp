@@ -5,7 +5,12 @@
 
 #include "tests/framework/Framework.h"
 #include "anki/script/ScriptManager.h"
+#include "anki/scene/SceneGraph.h"
+#include "anki/scene/MoveComponent.h"
+#include "anki/scene/ScriptComponent.h"
+#include "anki/util/HighRezTimer.h"
 #include "anki/Math.h"
+#include <iostream>
 
 static const char* script = R"(
 b = Vec2.new(3.0, 4.0)
@@ -14,10 +19,72 @@ v2:copy(v2 * b)
 v3:setZ(0.1)
 )";
 
+static const char* componentScript = R"(
+function update(node, prevTime, crntTime)
+	local move = node:getMoveComponent()
+	local origin = move:getLocalOrigin()
+	origin:setX(origin:getX() + crntTime - prevTime)
+	move:setLocalOrigin(origin)
+end
+)";
+
+static const char* mathBenchmarkScript = R"(
+N = 10000
+SPEED = 0.01
+
+positions = {}
+velocities = {}
+for i = 1, N do
+	positions[i] = Vec3.new()
+	local v = Vec3.new()
+	v:setX(1.0)
+	v:setY(2.0)
+	v:setZ(3.0)
+	velocities[i] = v
+end
+
+speed = Vec3.new()
+speed:setX(SPEED)
+speed:setY(SPEED)
+speed:setZ(SPEED)
+
+bulkPositions = Vec3Array.new(N)
+bulkVelocities = Vec3Array.new(N)
+bulkVelocities:fill(velocities[1])
+
+function perElement()
+	for i = 1, N do
+		positions[i]:copy(positions[i] + velocities[i] * speed)
+	end
+end
+
+function bulk()
+	bulkPositions:addScaled(bulkVelocities, SPEED)
+end
+)";
+
+namespace anki {
+
+/// A node that moves itself from a script
+class ScriptedNode: public SceneNode, public MoveComponent, 
+	public ScriptComponent
+{
+public:
+	ScriptedNode(const char* name, SceneGraph* scene)
+	:	SceneNode(name, scene),
+		MoveComponent(this),
+		ScriptComponent(this, "update")
+	{
+		addComponent(static_cast<MoveComponent*>(this));
+		addComponent(static_cast<ScriptComponent*>(this));
+	}
+};
+
+} // end namespace anki
+
 ANKI_TEST(Script, LuaBinder)
 {
-	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
-	ScriptManager sm(alloc);
+	ScriptManager sm(allocAligned, nullptr);
 	Vec2 v2(2.0, 3.0);
 	Vec3 v3(1.1, 2.2, 3.3);
 
@@ -29,3 +96,78 @@ ANKI_TEST(Script, LuaBinder)
 	ANKI_TEST_EXPECT_EQ(v2, Vec2(6, 12));
 	ANKI_TEST_EXPECT_EQ(v3, Vec3(1.1, 2.2, 0.1));
 }
+
+ANKI_TEST(Script, ScriptComponentsBenchmark)
+{
+	const U NODES = 10000;
+	const U FRAMES = 10;
+	// The default scene stack is too small for that many nodes
+	const PtrSize SCENE_MEMORY = 64 * 1024 * 1024;
+
+	HeapAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+	benchmarkThreads(std::to_string(NODES) + " script components", 
+		[&](Threadpool& threadpool) -> HighRezTimer::Scalar
+	{
+		SceneGraph scene(allocAligned, nullptr, &threadpool, SCENE_MEMORY);
+
+		ScriptManager sm(allocAligned, nullptr, 
+			threadpool.getThreadsCount());
+		sm.evalStringInThreadStates(componentScript);
+
+		Vector<ScriptedNode*> nodes(NODES, nullptr, alloc);
+		for(U n = 0; n < NODES; n++)
+		{
+			nodes[n] = scene.newSceneNode<ScriptedNode>(nullptr);
+		}
+
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRAMES; f++)
+		{
+			sm.updateScriptComponents(scene, F32(f), F32(f + 1));
+		}
+		HighRezTimer::Scalar time = 
+			(HighRezTimer::getCurrentTime() - begin) / FRAMES;
+
+		ANKI_TEST_EXPECT_EQ(nodes[0]->getLocalOrigin().x(), F32(FRAMES));
+		ANKI_TEST_EXPECT_EQ(nodes[NODES - 1]->getLocalOrigin().x(), 
+			F32(FRAMES));
+
+		return time;
+	});
+}
+
+ANKI_TEST(Script, MathBenchmark)
+{
+	const U ITERATIONS = 100;
+
+	ScriptManager sm(allocAligned, nullptr);
+	sm.evalString(mathBenchmarkScript);
+
+	// One call and two temporaries per vector against one call for all
+	Array<const char*, 2> calls = {{"perElement()", "bulk()"}};
+	Array<HighRezTimer::Scalar, 2> times;
+
+	for(U i = 0; i < calls.size(); i++)
+	{
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+		for(U it = 0; it < ITERATIONS; it++)
+		{
+			sm.evalString(calls[i]);
+		}
+		times[i] = (HighRezTimer::getCurrentTime() - begin) / ITERATIONS;
+	}
+
+	Vec3 perElement, bulk;
+	sm.exposeVariable("perElementResult", &perElement);
+	sm.exposeVariable("bulkResult", &bulk);
+	sm.evalString("perElementResult:copy(positions[N]) "
+		"bulkResult:copy(bulkPositions:getAt(N - 1))");
+
+	ANKI_TEST_EXPECT_EQ(perElement, bulk);
+	ANKI_TEST_EXPECT_NEQ(bulk, Vec3(0.0));
+
+	std::cout << "Lua Vec3 math: 10000 vectors, per element " 
+		<< (times[0] * 1000.0) << "ms, bulk " << (times[1] * 1000.0) 
+		<< "ms" << std::endl;
+}
@@ -0,0 +1,417 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/MeshSimplifier.h"
+#include "anki/util/File.h"
+#include "anki/util/Exception.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace anki;
+
+/// The command line options
+struct Options
+{
+	std::string m_input;
+	std::string m_dataPath;
+	U32 m_lodsCount = 2;
+	F32 m_ratio = 0.5;
+	F32 m_maxError = 0.05;
+};
+
+/// The contents of an ankimesh file
+struct MeshData
+{
+	std::string m_name;
+	std::vector<Vec3> m_positions;
+	std::vector<U32> m_indices;
+	std::vector<Vec2> m_texCoords;
+	/// Pairs of bone ID and weight for every vertex
+	std::vector<std::vector<std::pair<U32, F32>>> m_weights;
+};
+
+//==============================================================================
+static void parseCommandLineArgs(int argc, char** argv, Options& opts)
+{
+	static const char* usage = R"(Usage: %s -i model.ankimdl [options]
+Creates the LODs of the meshes of a model and adds them to the model
+Options:
+-d <path>   : The path that the paths of the model are relative to
+-l <number> : Number of LODs to create. Max 2. Default is 2
+-r <number> : The triangles of a LOD relative to the previous. Default 0.5
+-e <number> : The max error relative to the size of the mesh. Default 0.05
+)";
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+		{
+			opts.m_input = argv[++i];
+		}
+		else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+		{
+			opts.m_dataPath = argv[++i];
+			opts.m_dataPath += "/";
+		}
+		else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+		{
+			opts.m_lodsCount = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+		{
+			opts.m_ratio = atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+		{
+			opts.m_maxError = atof(argv[++i]);
+		}
+		else
+		{
+			goto error;
+		}
+	}
+
+	if(opts.m_input.empty()
+		|| opts.m_lodsCount < 1 || opts.m_lodsCount > 2
+		|| opts.m_ratio <= 0.0 || opts.m_ratio >= 1.0)
+	{
+		goto error;
+	}
+
+	return;
+
+error:
+	printf(usage, argv[0]);
+	exit(1);
+}
+
+//==============================================================================
+/// Read it the way MeshLoader does
+static void readMesh(const std::string& filename, MeshData& mesh)
+{
+	File file(filename.c_str(),
+		File::OpenFlag::READ | File::OpenFlag::BINARY
+		| File::OpenFlag::LITTLE_ENDIAN);
+
+	char magic[8];
+	file.read(magic, sizeof(magic));
+	if(std::memcmp(magic, "ANKIMESH", 8))
+	{
+		throw ANKI_EXCEPTION("Incorrect magic word");
+	}
+
+	mesh.m_name.resize(file.readU32());
+	if(mesh.m_name.size())
+	{
+		file.read(&mesh.m_name[0], mesh.m_name.size());
+	}
+
+	mesh.m_positions.resize(file.readU32());
+	for(Vec3& pos : mesh.m_positions)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			pos[j] = file.readF32();
+		}
+	}
+
+	mesh.m_indices.resize(file.readU32() * 3);
+	for(U32& index : mesh.m_indices)
+	{
+		index = file.readU32();
+		if(index >= mesh.m_positions.size())
+		{
+			throw ANKI_EXCEPTION("Vert index out of bounds");
+		}
+	}
+
+	mesh.m_texCoords.resize(file.readU32());
+	for(Vec2& texCoord : mesh.m_texCoords)
+	{
+		for(U j = 0; j < 2; j++)
+		{
+			texCoord[j] = file.readF32();
+		}
+	}
+
+	mesh.m_weights.resize(file.readU32());
+	for(auto& weights : mesh.m_weights)
+	{
+		weights.resize(file.readU32());
+		for(auto& weight : weights)
+		{
+			weight.first = file.readU32();
+			weight.second = file.readF32();
+		}
+	}
+}
+
+//==============================================================================
+static void writeU32(File& file, U32 x)
+{
+	file.write(&x, sizeof(x));
+}
+
+//==============================================================================
+static void writeF32(File& file, F32 x)
+{
+	file.write(&x, sizeof(x));
+}
+
+//==============================================================================
+/// Write the vertices that the remap points to
+static void writeMesh(const std::string& filename, const MeshData& mesh,
+	const ResourceVector<U32>& indices, const ResourceVector<U32>& remap)
+{
+	File file(filename.c_str(),
+		File::OpenFlag::WRITE | File::OpenFlag::BINARY
+		| File::OpenFlag::LITTLE_ENDIAN);
+
+	file.write(const_cast<char*>("ANKIMESH"), 8);
+
+	writeU32(file, mesh.m_name.size());
+	if(mesh.m_name.size())
+	{
+		file.write(const_cast<char*>(&mesh.m_name[0]), mesh.m_name.size());
+	}
+
+	writeU32(file, remap.size());
+	for(U32 v : remap)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			writeF32(file, mesh.m_positions[v][j]);
+		}
+	}
+
+	writeU32(file, indices.size() / 3);
+	for(U32 index : indices)
+	{
+		writeU32(file, index);
+	}
+
+	writeU32(file, mesh.m_texCoords.size() ? remap.size() : 0);
+	for(U i = 0; i < remap.size() && mesh.m_texCoords.size(); i++)
+	{
+		writeF32(file, mesh.m_texCoords[remap[i]].x());
+		writeF32(file, mesh.m_texCoords[remap[i]].y());
+	}
+
+	writeU32(file, mesh.m_weights.size() ? remap.size() : 0);
+	for(U i = 0; i < remap.size() && mesh.m_weights.size(); i++)
+	{
+		const auto& weights = mesh.m_weights[remap[i]];
+		writeU32(file, weights.size());
+		for(const auto& weight : weights)
+		{
+			writeU32(file, weight.first);
+			writeF32(file, weight.second);
+		}
+	}
+}
+
+//==============================================================================
+/// The LOD of a mesh file name: path/to/mesh.ankimesh -> path/to/mesh_lod1.
+/// ankimesh
+static std::string getLodFilename(const std::string& filename, U lod)
+{
+	std::string::size_type dot = filename.rfind('.');
+	std::stringstream ss;
+	ss << filename.substr(0, dot) << "_lod" << lod
+		<< ((dot == std::string::npos) ? "" : filename.substr(dot));
+	return ss.str();
+}
+
+//==============================================================================
+/// Create the LODs of a mesh
+/// @param meshPath The path of the mesh as the model has it.
+/// @param[out] lodPaths The paths of the LODs as the model should have them.
+/// @param[out] lodErrors The errors of the LODs in the units of the mesh.
+/// @param[in,out] trisCounts The triangles of every LOD. Accumulated.
+static void createLods(const Options& opts, ResourceAllocator<U8>& alloc,
+	const std::string& meshPath, std::vector<std::string>& lodPaths,
+	std::vector<F32>& lodErrors, std::vector<U64>& trisCounts)
+{
+	MeshData mesh;
+	readMesh(opts.m_dataPath + meshPath, mesh);
+
+	// The size of the mesh
+	Vec3 min(MAX_F32), max(-MAX_F32);
+	for(const Vec3& pos : mesh.m_positions)
+	{
+		for(U j = 0; j < 3; j++)
+		{
+			min[j] = std::min(min[j], pos[j]);
+			max[j] = std::max(max[j], pos[j]);
+		}
+	}
+	F32 maxError = (max - min).getLength() * 0.5 * opts.m_maxError;
+
+	MeshSimplifier simplifier(alloc, &mesh.m_positions[0],
+		mesh.m_positions.size(), &mesh.m_indices[0], mesh.m_indices.size());
+
+	std::cout << meshPath << ": LOD 0 " << mesh.m_indices.size() / 3
+		<< " triangles";
+	trisCounts[0] += mesh.m_indices.size() / 3;
+
+	U32 prevCount = mesh.m_indices.size();
+	U lod = 1;
+	for(; lod <= opts.m_lodsCount; lod++)
+	{
+		U32 target = U32(F32(prevCount / 3) * opts.m_ratio) * 3;
+		U32 count = simplifier.simplify(target, maxError);
+
+		// Not worth a LOD if it didn't remove much
+		if(F32(count) > F32(prevCount) * 0.9)
+		{
+			break;
+		}
+
+		ResourceVector<U32> indices(alloc);
+		ResourceVector<U32> remap(alloc);
+		simplifier.getIndices(indices);
+		MeshSimplifier::compactVertices(
+			indices, mesh.m_positions.size(), remap);
+
+		std::string lodPath = getLodFilename(meshPath, lod);
+		writeMesh(opts.m_dataPath + lodPath, mesh, indices, remap);
+
+		lodPaths.push_back(lodPath);
+		lodErrors.push_back(simplifier.getError());
+		trisCounts[lod] += count / 3;
+		prevCount = count;
+
+		std::cout << ", LOD " << lod << " " << count / 3
+			<< " triangles (error " << simplifier.getError() << ")";
+	}
+
+	// The missing LODs draw the last
+	for(; lod <= opts.m_lodsCount; lod++)
+	{
+		trisCounts[lod] += prevCount / 3;
+	}
+
+	std::cout << std::endl;
+}
+
+//==============================================================================
+/// Add the LODs to the model patches that have only one mesh
+static void processModel(const Options& opts, ResourceAllocator<U8>& alloc,
+	std::string& model, std::vector<U64>& trisCounts)
+{
+	std::string::size_type pos = 0;
+	while((pos = model.find("<modelPatch>", pos)) != std::string::npos)
+	{
+		std::string::size_type end = model.find("</modelPatch>", pos);
+		if(end == std::string::npos)
+		{
+			throw ANKI_EXCEPTION("Incorrect model");
+		}
+
+		std::string patch = model.substr(pos, end - pos);
+		std::string::size_type meshBegin = patch.find("<mesh>");
+		std::string::size_type meshEnd = patch.find("</mesh>");
+		if(meshBegin == std::string::npos
+			|| patch.find("<mesh1>") != std::string::npos)
+		{
+			pos = end;
+			continue;
+		}
+
+		std::string meshPath = patch.substr(meshBegin + 6,
+			meshEnd - meshBegin - 6);
+
+		std::vector<std::string> lodPaths;
+		std::vector<F32> lodErrors;
+		createLods(opts, alloc, meshPath, lodPaths, lodErrors, trisCounts);
+
+		if(lodPaths.empty())
+		{
+			pos = end;
+			continue;
+		}
+
+		// The indentation of the <mesh>
+		std::string::size_type lineBegin = patch.rfind('\n', meshBegin);
+		std::string indent = (lineBegin == std::string::npos)
+			? ""
+			: patch.substr(lineBegin + 1, meshBegin - lineBegin - 1);
+
+		std::stringstream ss;
+		for(U i = 0; i < lodPaths.size(); i++)
+		{
+			ss << "\n" << indent << "<mesh" << (i + 1) << ">" << lodPaths[i]
+				<< "</mesh" << (i + 1) << ">";
+		}
+
+		ss << "\n" << indent << "<lodErrors>";
+		for(U i = 0; i < lodErrors.size(); i++)
+		{
+			ss << ((i == 0) ? "" : " ") << lodErrors[i];
+		}
+		ss << "</lodErrors>";
+
+		std::string lines = ss.str();
+		model.insert(pos + meshEnd + 7, lines);
+		pos = end + lines.size();
+	}
+}
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+	try
+	{
+		Options opts;
+		parseCommandLineArgs(argc, argv, opts);
+
+		ResourceAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+
+		// Read the model
+		std::string model;
+		{
+			std::ifstream file(opts.m_input);
+			if(!file)
+			{
+				throw ANKI_EXCEPTION("Cannot open %s", opts.m_input.c_str());
+			}
+
+			std::stringstream ss;
+			ss << file.rdbuf();
+			model = ss.str();
+		}
+
+		std::vector<U64> trisCounts(opts.m_lodsCount + 1, 0);
+		processModel(opts, alloc, model, trisCounts);
+
+		// Write it back
+		{
+			std::ofstream file(opts.m_input);
+			file << model;
+		}
+
+		for(U lod = 1; lod <= opts.m_lodsCount && trisCounts[0]; lod++)
+		{
+			std::cout << "LOD " << lod << " has " << trisCounts[lod]
+				<< " of the " << trisCounts[0] << " triangles ("
+				<< (100 - 100 * trisCounts[lod] / trisCounts[0])
+				<< "% saved)" << std::endl;
+		}
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
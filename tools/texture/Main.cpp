@@ -0,0 +1,153 @@
+// Copyright (C) 2014, Panagiotis Christopoulos Charitos.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "anki/resource/TextureCooker.h"
+#include "anki/util/System.h"
+#include "anki/util/HighRezTimer.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace anki;
+
+/// The command line options
+struct Options
+{
+	std::vector<std::string> m_inputs;
+	std::string m_output;
+	Image::TextureType m_type = Image::TextureType::_2D;
+	bool m_normal = false;
+	bool m_alpha = true;
+	U32 m_threads = 0;
+};
+
+//==============================================================================
+static void parseCommandLineArgs(int argc, char** argv, Options& opts)
+{
+	static const char* usage = R"(Usage: %s -i in[:in...] -o out [options]
+Options:
+-t <2D|cube|3D|2DArray> : Type of the texture. Default is 2D
+-n, --normal            : The texture is a normal map
+--no-alpha              : Remove the alpha channel
+-j <number>             : Number of threads. Default is the number of cores
+)";
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+		{
+			std::string inputs = argv[++i];
+			std::string::size_type begin = 0, end;
+			do
+			{
+				end = inputs.find(':', begin);
+				opts.m_inputs.push_back(inputs.substr(begin, end - begin));
+				begin = end + 1;
+			} while(end != std::string::npos);
+		}
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+		{
+			opts.m_output = argv[++i];
+		}
+		else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+		{
+			++i;
+			if(strcmp(argv[i], "2D") == 0)
+			{
+				opts.m_type = Image::TextureType::_2D;
+			}
+			else if(strcmp(argv[i], "cube") == 0)
+			{
+				opts.m_type = Image::TextureType::CUBE;
+			}
+			else if(strcmp(argv[i], "3D") == 0)
+			{
+				opts.m_type = Image::TextureType::_3D;
+			}
+			else if(strcmp(argv[i], "2DArray") == 0)
+			{
+				opts.m_type = Image::TextureType::_2D_ARRAY;
+			}
+			else
+			{
+				goto error;
+			}
+		}
+		else if(strcmp(argv[i], "-n") == 0
+			|| strcmp(argv[i], "--normal") == 0)
+		{
+			opts.m_normal = true;
+		}
+		else if(strcmp(argv[i], "--no-alpha") == 0)
+		{
+			opts.m_alpha = false;
+		}
+		else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+		{
+			opts.m_threads = atoi(argv[++i]);
+		}
+		else
+		{
+			goto error;
+		}
+	}
+
+	if(opts.m_inputs.empty() || opts.m_output.empty())
+	{
+		goto error;
+	}
+
+	if(opts.m_threads == 0)
+	{
+		opts.m_threads = getCpuCoresCount();
+	}
+
+	return;
+
+error:
+	printf(usage, argv[0]);
+	exit(1);
+}
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+	try
+	{
+		Options opts;
+		parseCommandLineArgs(argc, argv, opts);
+
+		ResourceAllocator<U8> alloc(HeapMemoryPool(allocAligned, nullptr));
+		Threadpool threadpool(
+			std::min<U32>(opts.m_threads, Threadpool::MAX_THREADS));
+		HighRezTimer::Scalar begin = HighRezTimer::getCurrentTime();
+
+		TextureCooker cooker(alloc, threadpool);
+		for(const std::string& in : opts.m_inputs)
+		{
+			Image img(alloc);
+			img.load(CString(in.c_str()));
+			cooker.addLayer(img);
+		}
+
+		cooker.cook(opts.m_type, opts.m_normal, opts.m_alpha);
+		cooker.write(CString(opts.m_output.c_str()));
+
+		std::cout << "Wrote " << opts.m_output << " ("
+			<< cooker.getMipLevelsCount() << " mips) in "
+			<< ((HighRezTimer::getCurrentTime() - begin) * 1000.0) << "ms"
+			<< std::endl;
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}